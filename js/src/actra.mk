@@ -26,23 +26,28 @@ CSRCS = prmjtime.c \
 		  jsarray.c \
 		  jsatom.c \
 		  jsbool.c \
+		  jscensus.c \
 		  jscntxt.c \
 		  jsdate.c \
 		  jsdbgapi.c \
+		  jsdtoa.c \
 		  jsemit.c \
 		  jsfun.c \
 		  jsgc.c \
 		  jsinterp.c \
+		  jsjit.c \
 		  jsmath.c \
 		  jsnum.c \
 		  jsobj.c \
 		  jsopcode.c \
 		  jsparse.c \
+		  jsprof.c \
 		  jsregexp.c \
 		  jsscan.c \
 		  jsscope.c \
 		  jsscript.c \
 		  jsstr.c \
+		  jsxdrapi.c \
 		  jslock.c \
 		  $(NULL)
 
@@ -55,10 +60,12 @@ HEADERS = jsapi.h \
 		  jsconfig.h \
 		  jsdate.h \
 		  jsdbgapi.h \
+		  jsdtoa.h \
 		  jsemit.h \
 		  jsfun.h \
 		  jsgc.h \
 		  jsinterp.h \
+		  jsjit.h \
 		  jslock.h \
 		  jsmath.h \
 		  jsnum.h \
@@ -73,6 +80,7 @@ HEADERS = jsapi.h \
 		  jsscope.h \
 		  jsscript.h \
 		  jsstr.h \
+		  jsxdrapi.h \
 		  $(NULL)
 
 ifeq ($(OS_ARCH), WINNT)
@@ -0,0 +1,25 @@
+/*
+ * Array benchmark: fill an array by index and by push, iterate over it,
+ * join it into a string, and sort it, which exercises element storage.
+ */
+function compare_numbers(x, y) {
+    return x - y;
+}
+
+function arrays(n) {
+    var i, a = [], b = [], s = 0, seed = 1;
+    for (i = 0; i < n; i++) {
+	seed = (seed * 1103 + 12345) & 32767;
+	a[i] = seed;
+    }
+    for (i = 0; i < n; i++)
+	b.push(a[i] & 255);
+    for (i = 0; i < n; i++)
+	s += a[i] - b[i];
+    s += b.join(",").length;
+    a.sort(compare_numbers);
+    for (i = 1; i < n; i++)
+	if (a[i - 1] > a[i])
+	    return "unsorted";
+    return s + "/" + a[n >> 1];
+}
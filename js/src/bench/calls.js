@@ -0,0 +1,19 @@
+/*
+ * Call-heavy benchmark: small functions, argument access, recursion.
+ */
+function add(a, b) {
+    return a + b;
+}
+
+function fib(n) {
+    if (n < 2)
+	return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+function calls(n) {
+    var i, s = 0;
+    for (i = 0; i < n; i++)
+	s = add(s, i & 1);
+    return s + fib(20);
+}
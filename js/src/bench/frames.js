@@ -0,0 +1,42 @@
+/*
+ * Frame-heavy benchmark: deep recursion, accessor and method calls, and
+ * calls that leave arguments out, so most time goes to pushing and popping
+ * frames.
+ */
+function fib2(n) {
+    return (n < 2) ? n : fib2(n - 1) + fib2(n - 2);
+}
+
+function Vec(x, y) {
+    this.x = x;
+    this.y = y;
+}
+
+Vec.prototype.getX = function () {
+    return this.x;
+};
+
+Vec.prototype.getY = function () {
+    return this.y;
+};
+
+Vec.prototype.dot = function (p) {
+    return this.getX() * p.getX() + this.getY() * p.getY();
+};
+
+function pick(a, b, c) {
+    var t = c;
+    return (t == null) ? a : b;
+}
+
+function frames(n) {
+    var i, p, q, s = 0;
+
+    p = new Vec(1, 2);
+    q = new Vec(3, 4);
+    for (i = 0; i < n; i++) {
+	s += p.dot(q);
+	s += pick(i, 1);
+    }
+    return s + fib2(22);
+}
@@ -0,0 +1,21 @@
+/*
+ * Lazy compilation benchmark: make a library-sized script out of copies of
+ * the other benchmarks' functions, most of which a page would never call,
+ * and compile it with and without lazy function bodies.  From js/src, run
+ *
+ *	js bench/lazy.js
+ */
+load("bench/loops.js", "bench/calls.js", "bench/props.js",
+     "bench/objects.js", "bench/strings.js", "bench/arrays.js",
+     "bench/numbers.js");
+
+var funs = [loops, add, fib, calls, Point, norm1, props, Node, objects,
+	    strings, compare_numbers, arrays, numbers];
+var text = "";
+for (var i = 0; i < funs.length; i++)
+    text += funs[i].toString();
+
+var source = "";
+for (var i = 0; i < 200; i++)
+    source += text.replace(/function (\w+)\(/g, "function $1_" + i + "(");
+lazybench(source, 5);
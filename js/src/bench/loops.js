@@ -0,0 +1,16 @@
+/*
+ * Loop-heavy benchmark: local arithmetic, comparisons and branches.
+ */
+function loops(n) {
+    var i, j, s = 0;
+    for (i = 0; i < n; i++) {
+	for (j = 0; j < 100; j++) {
+	    if (j < 50)
+		s = s + 1;
+	    else
+		s = s - 1;
+	}
+	s = s + i % 7;
+    }
+    return s;
+}
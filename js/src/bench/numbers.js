@@ -0,0 +1,19 @@
+/*
+ * Number conversion benchmark: serialize rows of integral and fractional
+ * numbers to a comma-separated string, then parse the fields back.  The
+ * same numbers recur, as ids and prices do.
+ */
+function numbers(n) {
+    var i, j, x, s, fields, sum = 0, rows = [];
+    for (i = 0; i < n; i++) {
+	x = (i % 997) / 8 + i / 1000;
+	rows[i % 100] = (i % 5000) + "," + x + "," + (x / 3);
+	if (i % 100 == 99) {
+	    s = rows.join(",");
+	    fields = s.split(",");
+	    for (j = 0; j < fields.length; j++)
+		sum += parseFloat(fields[j]) - fields[j];
+	}
+    }
+    return s.length + "/" + sum;
+}
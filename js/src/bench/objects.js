@@ -0,0 +1,24 @@
+/*
+ * Object benchmark: create objects with a few and with many properties, and
+ * look up properties by name, which exercises scope symbol tables.
+ */
+function Node(value, next) {
+    this.value = value;
+    this.next = next;
+}
+
+function objects(n) {
+    var i, j, o, list = null, s = 0;
+    for (i = 0; i < n; i++) {
+	list = new Node(i, list);
+	list.mark = i & 1;
+	o = new Object();
+	for (j = 0; j < 24; j++)
+	    o["p" + j] = j;
+	for (j = 0; j < 24; j++)
+	    s += o.p0 + o.p11 + o.p23 + o["p" + j];
+    }
+    for (o = list; o; o = o.next)
+	s += o.value + o.mark;
+    return s;
+}
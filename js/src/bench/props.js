@@ -0,0 +1,21 @@
+/*
+ * Property-heavy benchmark: gets and sets of object and this properties.
+ */
+function Point(x, y) {
+    this.x = x;
+    this.y = y;
+}
+
+function norm1() {
+    return this.x + this.y;
+}
+Point.prototype.norm1 = norm1;
+
+function props(n) {
+    var i, p = new Point(1, 2), s = 0;
+    for (i = 0; i < n; i++) {
+	p.x = i & 255;
+	s = s + p.norm1();
+    }
+    return s;
+}
@@ -0,0 +1,25 @@
+/*
+ * Interpreter benchmark driver.  From js/src, run
+ *
+ *	js bench/run.js
+ *
+ * and compare the times of builds made with and without, e.g.,
+ * JS_THREADED_INTERP=0.
+ */
+load("bench/loops.js", "bench/calls.js", "bench/props.js",
+     "bench/objects.js", "bench/strings.js", "bench/arrays.js",
+     "bench/numbers.js", "bench/frames.js");
+
+function time(name, f, n) {
+    var start = new Date(), result = f(n);
+    print(name + ": " + (new Date() - start) + " ms (" + result + ")");
+}
+
+time("loops", loops, 20000);
+time("calls", calls, 300000);
+time("props", props, 300000);
+time("objects", objects, 5000);
+time("strings", strings, 5000);
+time("arrays", arrays, 100000);
+time("numbers", numbers, 100000);
+time("frames", frames, 100000);
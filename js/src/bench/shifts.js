@@ -0,0 +1,36 @@
+/*
+ * Shift regression check.  From js/src, run
+ *
+ *	js -j bench/shifts.js
+ *
+ * Each shift runs in a loop hot enough to be compiled, and its results
+ * must match the interpreter's: >>> of a negative int exceeds JSVAL_INT_MAX.
+ */
+function shifts(x, y) {
+    var i, r = [];
+    for (i = 0; i < 1000; i++)
+	r = [x << y, x >> y, x >>> y, x >>> 0];
+    return r.join(",");
+}
+
+var failures = 0;
+
+function check(x, y) {
+    var old = jit(), compiled, interpreted;
+    compiled = shifts(x, y);
+    jit(false);
+    interpreted = shifts(x, y);
+    jit(old);
+    if (compiled != interpreted) {
+	print("shifts(" + x + ", " + y + "): " + compiled + " != " +
+	      interpreted);
+	failures++;
+    }
+}
+
+check(-1, 0);
+check(-8, 1);
+check(-8, 33);
+check(5, 2);
+check(0x3fffffff, 1);
+print("shifts: " + (failures ? failures + " FAILED" : "ok"));
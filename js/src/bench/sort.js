@@ -0,0 +1,47 @@
+/*
+ * Sort benchmark: sort sorted, reverse-sorted and random arrays of ints and
+ * strings with the default comparator, and of ints with a numeric one.  From
+ * js/src, run
+ *
+ *	js bench/sort.js
+ *
+ * Each line gives the time to sort n elements, and its first and last.
+ */
+var n = 100000;
+
+function compare_numbers(x, y) {
+    return x - y;
+}
+
+function fill(kind, order) {
+    var i, v, a = [], seed = 1;
+    for (i = 0; i < n; i++) {
+	if (order == "sorted") {
+	    v = i;
+	} else if (order == "reversed") {
+	    v = n - i;
+	} else {
+	    seed = (seed * 69069 + 1) % 1073741824;
+	    v = seed >> 8;
+	}
+	a[i] = (kind == "strings") ? "k" + (1000000 + v) : v;
+    }
+    return a;
+}
+
+function time(kind, order, cmp) {
+    var a = fill(kind, order), start = new Date();
+    if (cmp)
+	a.sort(cmp);
+    else
+	a.sort();
+    print(kind + " " + order + ": " + (new Date() - start) + " ms (" +
+	  a[0] + "/" + a[n - 1] + ")");
+}
+
+var orders = ["sorted", "reversed", "random"];
+for (var i = 0; i < orders.length; i++) {
+    time("ints", orders[i]);
+    time("strings", orders[i]);
+    time("numbers", orders[i], compare_numbers);
+}
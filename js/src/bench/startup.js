@@ -0,0 +1,26 @@
+/*
+ * Startup benchmark: load the default preference scripts, which the browser
+ * compiles at every startup.  From js/src, run
+ *
+ *	js bench/startup.js
+ *	js -c /tmp/jscache bench/startup.js
+ *
+ * The first run with -c fills the script cache and later ones decode the
+ * scripts from it instead of compiling them.
+ */
+var prefs = 0;
+function pref(name, value) { prefs++; }
+var config = pref, localDefPref = pref, defaultPref = pref;
+var user_pref = pref, lockPref = pref, unlockPref = pref;
+
+var dir = "../../modules/libpref/src/";
+var files = [dir + "initpref.js", dir + "init/all.js",
+	     dir + "init/editor.js", dir + "init/mailnews.js",
+	     dir + "init/security.js", dir + "init/config.js"];
+
+var start = new Date();
+for (var i = 0; i < 20; i++) {
+    for (var j = 0; j < files.length; j++)
+	load(files[j]);
+}
+print("startup: " + (new Date() - start) + " ms (" + prefs + ")");
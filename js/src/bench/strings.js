@@ -0,0 +1,13 @@
+/*
+ * String building benchmark: append the rows of an HTML table to a document
+ * string one piece at a time, then search it, which reads its chars.
+ */
+function strings(n) {
+    var i, doc = "<html><body><table>\n";
+    for (i = 0; i < n; i++) {
+	doc += "<tr><td>" + i + "</td><td>row " + (i % 10) + "</td>";
+	doc = doc + "<td>" + (i * 3) + "</td></tr>\n";
+    }
+    doc += "</table></body></html>\n";
+    return doc.length + "/" + doc.indexOf("<td>" + (n - 1) + "</td>");
+}
@@ -30,7 +30,10 @@
 #include "plarena.h"
 #endif
 #include "prlog.h"
+#include "prlong.h"
+#include "prdtoa.h"
 #include "prprf.h"
+#include "prmjtime.h"
 #include "jsapi.h"
 #include "jsatom.h"
 #include "jscntxt.h"
@@ -39,6 +42,7 @@
 #include "jsfun.h"
 #include "jsgc.h"
 #include "jslock.h"
+#include "jsnum.h"
 #include "jsobj.h"
 #include "jsparse.h"
 #include "jsscan.h"
@@ -60,18 +64,91 @@
 # error "JSFILE must be defined for this module to work."
 #endif
 
+#ifdef JS_THREADSAFE
+#include "prlock.h"
+#include "prthread.h"
+#include "prinrval.h"
+
+/*
+ * The shell is the embedding, so it supplies the runtime lock hooks declared
+ * in jslock.h.  API entry points lock and then call code that locks again,
+ * so the lock counts recursive entries by its owning thread.
+ */
+typedef struct ShellRuntimeLock {
+    PRLock      *lock;
+    PRThread    *owner;
+    uint32      count;
+} ShellRuntimeLock;
+
+static ShellRuntimeLock shell_runtime_lock;
+
+void
+js_lock_runtime(JSRuntime *rt)
+{
+    ShellRuntimeLock *rl = rt->lockData;
+    PRThread *me = PR_GetCurrentThread();
+
+    if (rl->owner == me) {
+	rl->count++;
+	return;
+    }
+    PR_Lock(rl->lock);
+    PR_ASSERT(rl->count == 0);
+    rl->owner = me;
+    rl->count = 1;
+}
+
+void
+js_unlock_runtime(JSRuntime *rt)
+{
+    ShellRuntimeLock *rl = rt->lockData;
+
+    PR_ASSERT(rl->owner == PR_GetCurrentThread() && rl->count > 0);
+    if (--rl->count == 0) {
+	rl->owner = NULL;
+	PR_Unlock(rl->lock);
+    }
+}
+
+#ifdef DEBUG
+int
+js_is_runtime_locked(JSRuntime *rt)
+{
+    ShellRuntimeLock *rl = rt->lockData;
+
+    return rl->owner == PR_GetCurrentThread();
+}
+#endif
+#endif /* JS_THREADSAFE */
+
 static void
 Process(JSContext *cx, JSObject *obj, char *filename)
 {
     JSScript script;		/* XXX we know all about this struct */
+    JSScript *scriptp;
     JSTokenStream *ts;
     JSCodeGenerator cg;
+    JSBool ok;
     jsval result;
     JSString *str;
 
     memset(&script, 0, sizeof script);
     script.filename = filename;
     if (filename && strcmp(filename, "-") != 0) {
+	if (cx->runtime->scriptCacheDir) {
+	    /* Compile the whole file at once, through the script cache. */
+	    ts = NULL;
+	    errno = 0;
+	    scriptp = JS_CompileFile(cx, obj, filename);
+	    if (!scriptp) {
+		if (errno)
+		    fprintf(stderr, "js: %s: %s\n", filename, strerror(errno));
+		goto out;
+	    }
+	    (void) JS_ExecuteScript(cx, obj, scriptp, &result);
+	    JS_DestroyScript(cx, scriptp);
+	    goto out;
+	}
 	ts = js_NewFileTokenStream(cx, filename);
     } else {
 	ts = js_NewBufferTokenStream(cx, NULL, 0);
@@ -89,7 +166,10 @@ Process(JSContext *cx, JSObject *obj, char *filename)
 	    printf("js> ");
 
 	CG_RESET(&cg);
-	if (!js_Parse(cx, obj, ts, &cg) || CG_OFFSET(&cg) == 0)
+	JS_LOCK(cx);
+	ok = js_Parse(cx, obj, ts, &cg);
+	JS_UNLOCK(cx);
+	if (!ok || CG_OFFSET(&cg) == 0)
 	    continue;
 
 	script.code = cg.base;
@@ -204,7 +284,9 @@ GC(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 #ifdef GC_MARK_DEBUG
     js_DumpGCHeap = stdout;
 #endif
+    JS_LOCK(cx);
     js_ForceGC(cx);
+    JS_UNLOCK(cx);
 #ifdef GC_MARK_DEBUG
     js_DumpGCHeap = NULL;
 #endif
@@ -222,6 +304,833 @@ GC(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     return JS_TRUE;
 }
 
+static JSBool
+GCSlice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    JSRuntime *rt;
+    uint32 budget;
+
+    rt = cx->runtime;
+    if (argc > 0 && JSVAL_IS_INT(argv[0]) && JSVAL_TO_INT(argv[0]) >= 0)
+	budget = JS_SetGCSliceBudget(rt, (uint32)JSVAL_TO_INT(argv[0]));
+    else
+	budget = rt->gcSliceBudget;
+    *rval = INT_TO_JSVAL(budget);
+    return JS_TRUE;
+}
+
+/*
+ * Property access benchmark: loads, stores and prototype method calls on
+ * objects of one shape, too many for the property cache to hold, timed with
+ * and without the inline caches that jsinterp.c keeps for JSOP_GETPROP and
+ * JSOP_SETPROP.
+ */
+static char propbench_source[] =
+    "function Point(x, y) { this.x = x; this.y = y; }\n"
+    "Point.prototype.norm = function () {\n"
+    "    return this.x * this.x + this.y * this.y;\n"
+    "};\n"
+    "var pts = new Array(), sum = 0;\n"
+    "for (var i = 0; i < 1024; i++)\n"
+    "    pts[i] = new Point(i, i + 1);\n"
+    "for (var i = 0; i < n; i++) {\n"
+    "    var p = pts[i & 1023];\n"
+    "    p.x = p.y & 255;\n"
+    "    p.y = p.x + 1;\n"
+    "    sum += p.norm() & 7;\n"
+    "}\n"
+    "sum;\n";
+
+static JSBool
+PropBench(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    int32 n;
+    JSPropertyCache *cache;
+    JSObject *scopeobj;
+    int64 start, now, delta, thousand;
+    uint32 ms[2], tests, misses;
+    jsval v[2];
+    intN i;
+
+    n = 1000000;
+    if (argc > 0 && !JS_ValueToInt32(cx, argv[0], &n))
+	return JS_FALSE;
+    if (n <= 0) {
+	JS_ReportError(cx, "usage: propbench [iterations]");
+	return JS_FALSE;
+    }
+
+    cache = &cx->runtime->propertyCache;
+    tests = misses = 0;
+    for (i = 0; i < 2; i++) {
+	scopeobj = JS_NewObject(cx, &js_ObjectClass, NULL, obj);
+	if (!scopeobj)
+	    return JS_FALSE;
+	*rval = OBJECT_TO_JSVAL(scopeobj);
+	if (!JS_DefineProperty(cx, scopeobj, "n", INT_TO_JSVAL(n),
+			       NULL, NULL, 0)) {
+	    return JS_FALSE;
+	}
+	cache->noInlineCaches = (i == 0);
+	tests = cx->icTests;
+	misses = cx->icMisses;
+	start = PRMJ_Now();
+	if (!JS_EvaluateScript(cx, scopeobj, propbench_source,
+			       sizeof propbench_source - 1, "propbench", 1,
+			       &v[i])) {
+	    cache->noInlineCaches = JS_FALSE;
+	    return JS_FALSE;
+	}
+	now = PRMJ_Now();
+	LL_SUB(delta, now, start);
+	LL_UI2L(thousand, 1000);
+	LL_DIV(delta, delta, thousand);
+	LL_L2UI(ms[i], delta);
+	tests = cx->icTests - tests;
+	misses = cx->icMisses - misses;
+    }
+    cache->noInlineCaches = JS_FALSE;
+
+    printf("propbench: %ld iterations, %lu ms without inline caches, "
+	   "%lu ms with (%lu of %lu accesses hit)\n",
+	   (long)n, (unsigned long)ms[0], (unsigned long)ms[1],
+	   (unsigned long)(tests - misses), (unsigned long)tests);
+    *rval = v[1];
+    return JS_TRUE;
+}
+
+/*
+ * Number conversion benchmark and check: convert random doubles to strings
+ * and random decimal strings to doubles, with js_dtostr and js_strtod and
+ * then with prdtoa.c, and compare the results bit for bit.
+ */
+#define NUMBENCH_STRLEN 40
+
+static uint32 numbench_seed = 0x2545F491;
+
+static uint32
+NumBenchRandom(void)
+{
+    numbench_seed ^= numbench_seed << 13;
+    numbench_seed ^= numbench_seed >> 17;
+    numbench_seed ^= numbench_seed << 5;
+    return numbench_seed;
+}
+
+/* Store a random double: any bit pattern, or a short decimal fraction. */
+static void
+NumBenchDouble(jsdouble *dp)
+{
+    jsdouble d;
+
+    if (NumBenchRandom() & 1) {
+	do {
+	    JSDOUBLE_HI32(d) = NumBenchRandom();
+	    JSDOUBLE_LO32(d) = NumBenchRandom();
+	} while (!JSDOUBLE_IS_FINITE(d));
+    } else {
+	d = (jsdouble)(NumBenchRandom() % 1000000000);
+	d /= (jsdouble)(1 + NumBenchRandom() % 1000000);
+    }
+    *dp = d;
+}
+
+/* Store a random decimal string of up to 22 digits with an exponent. */
+static void
+NumBenchDecimal(char *bp)
+{
+    intN i, n, point;
+
+    if (NumBenchRandom() & 1)
+	*bp++ = '-';
+    n = 1 + NumBenchRandom() % 22;
+    point = NumBenchRandom() % (n + 1);
+    for (i = 0; i < n; i++) {
+	if (i == point)
+	    *bp++ = '.';
+	*bp++ = (char)('0' + NumBenchRandom() % 10);
+    }
+    sprintf(bp, "e%d", (intN)(NumBenchRandom() % 660) - 340);
+}
+
+static uint32
+NumBenchMs(int64 start)
+{
+    int64 now, delta, thousand;
+    uint32 ms;
+
+    now = PRMJ_Now();
+    LL_SUB(delta, now, start);
+    LL_UI2L(thousand, 1000);
+    LL_DIV(delta, delta, thousand);
+    LL_L2UI(ms, delta);
+    return ms;
+}
+
+typedef struct NumBenchItem {
+    jsdouble    d;                      /* random double */
+    char        str[NUMBENCH_STRLEN];   /* d by js_dtostr, or a decimal */
+    char        ref[NUMBENCH_STRLEN];   /* d by PR_cnvtf */
+    jschar      chars[NUMBENCH_STRLEN]; /* str inflated for js_strtod */
+    jsdouble    fast, slow;             /* str by js_strtod and PR_strtod */
+    size_t      fastend, slowend;       /* lengths they parsed */
+    JSBool      ok;                     /* js_strtod's return value */
+    int         err;                    /* errno from PR_strtod */
+} NumBenchItem;
+
+static JSBool
+NumBench(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    int32 n, i, j, bad;
+    NumBenchItem *items, *it;
+    jschar *ep;
+    char *end;
+    int64 start;
+    uint32 ms[4];
+
+    n = 100000;
+    if (argc > 0 && !JS_ValueToInt32(cx, argv[0], &n))
+	return JS_FALSE;
+    if (n <= 0) {
+	JS_ReportError(cx, "usage: numbench [count]");
+	return JS_FALSE;
+    }
+    items = JS_malloc(cx, n * sizeof *items);
+    if (!items)
+	return JS_FALSE;
+
+    for (i = 0; i < n; i++)
+	NumBenchDouble(&items[i].d);
+    start = PRMJ_Now();
+    for (i = 0; i < n; i++)
+	js_dtostr(cx, items[i].str, items[i].d);
+    ms[0] = NumBenchMs(start);
+    start = PRMJ_Now();
+    for (i = 0; i < n; i++)
+	PR_cnvtf(items[i].ref, NUMBENCH_STRLEN, 20, items[i].d);
+    ms[1] = NumBenchMs(start);
+
+    bad = 0;
+    for (i = 0; i < n; i++) {
+	it = &items[i];
+	if (strcmp(it->str, it->ref) != 0 && bad++ < 10) {
+	    printf("numbench: %.17g is %s, prdtoa says %s\n",
+		   it->d, it->str, it->ref);
+	}
+    }
+
+    /* Parse the strings just made, which must round-trip, and decimals. */
+    for (i = 0; i < n; i++) {
+	it = &items[i];
+	if (i & 1)
+	    NumBenchDecimal(it->str);
+	for (j = 0; (it->chars[j] = (jschar)(uint8)it->str[j]) != 0; j++)
+	    continue;
+    }
+    start = PRMJ_Now();
+    for (i = 0; i < n; i++) {
+	it = &items[i];
+	it->ok = js_strtod(it->chars, &ep, &it->fast);
+	it->fastend = ep - it->chars;
+    }
+    ms[2] = NumBenchMs(start);
+    start = PRMJ_Now();
+    for (i = 0; i < n; i++) {
+	it = &items[i];
+	errno = 0;
+	it->slow = PR_strtod(it->str, &end);
+	it->err = errno;
+	it->slowend = end - it->str;
+    }
+    ms[3] = NumBenchMs(start);
+
+    for (i = 0; i < n; i++) {
+	it = &items[i];
+	if (it->err == ERANGE
+	    ? !it->ok
+	    : it->ok && it->fastend == it->slowend &&
+	      JSDOUBLE_HI32(it->fast) == JSDOUBLE_HI32(it->slow) &&
+	      JSDOUBLE_LO32(it->fast) == JSDOUBLE_LO32(it->slow) &&
+	      ((i & 1) || it->fast == it->d)) {
+	    continue;
+	}
+	if (bad++ < 10) {
+	    printf("numbench: %s is %.17g, prdtoa says %.17g\n",
+		   it->str, it->fast, it->slow);
+	}
+    }
+    JS_free(cx, items);
+
+    printf("numbench: %ld numbers, dtoa %lu ms (prdtoa %lu ms), "
+	   "strtod %lu ms (prdtoa %lu ms), %ld mismatches\n",
+	   (long)n, (unsigned long)ms[0], (unsigned long)ms[1],
+	   (unsigned long)ms[2], (unsigned long)ms[3], (long)bad);
+    *rval = INT_TO_JSVAL(bad);
+    return JS_TRUE;
+}
+
+/*
+ * Compile benchmark: compile a script n times with every function body
+ * compiled at once, then with bodies left to compile when first called, and
+ * count the bytes of bytecode, notes, atom maps, and saved source kept.
+ */
+static JSBool
+LazyBenchSize(JSContext *cx, JSScript *script, JSBool compile, size_t *sizep)
+{
+    jssrcnote *sn;
+    jsatomid i;
+    JSAtom *atom;
+    JSObject *funobj;
+    JSFunction *fun;
+    JSLazyFunction *lazy;
+
+    for (sn = script->notes; !SN_IS_TERMINATOR(sn); sn = SN_NEXT(sn))
+	continue;
+    *sizep += sizeof *script + script->length +
+	      (sn - script->notes + 1) * sizeof(jssrcnote) +
+	      script->atomMap.length * sizeof(JSAtom *);
+    for (i = 0; i < script->atomMap.length; i++) {
+	atom = script->atomMap.vector[i];
+	if (!ATOM_IS_OBJECT(atom))
+	    continue;
+	funobj = ATOM_TO_OBJECT(atom);
+	if (!funobj || funobj->map->clasp != &js_FunctionClass)
+	    continue;
+	fun = JS_GetPrivate(cx, funobj);
+	if (compile && !JSFUN_COMPILE(cx, fun))
+	    return JS_FALSE;
+	lazy = fun->lazy;
+	if (lazy) {
+	    *sizep += sizeof *lazy +
+		      lazy->length * (lazy->wide ? sizeof(jschar) : 1);
+	} else if (fun->script) {
+	    if (!LazyBenchSize(cx, fun->script, compile, sizep))
+		return JS_FALSE;
+	}
+    }
+    return JS_TRUE;
+}
+
+static JSBool
+LazyBench(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    JSString *str;
+    int32 n, i;
+    intN lazy;
+    JSBool old, ok;
+    JSObject *scopeobj;
+    int64 start;
+    JSScript *script;
+    uint32 ms[3], t;
+    size_t size[3];
+
+    n = 10;
+    str = NULL;
+    if (argc > 0) {
+	str = JS_ValueToString(cx, argv[0]);
+	if (!str)
+	    return JS_FALSE;
+	argv[0] = STRING_TO_JSVAL(str);
+    }
+    if (argc > 1 && !JS_ValueToInt32(cx, argv[1], &n))
+	return JS_FALSE;
+    if (!str || n <= 0) {
+	JS_ReportError(cx, "usage: lazybench source [n]");
+	return JS_FALSE;
+    }
+
+    ms[0] = ms[1] = ms[2] = (uint32)-1;
+    for (lazy = 0; lazy < 2; lazy++) {
+	for (i = 0; i < n; i++) {
+	    JS_LOCK_VOID(cx, js_ForceGC(cx));
+	    scopeobj = JS_NewObject(cx, &js_ObjectClass, NULL, obj);
+	    if (!scopeobj)
+		return JS_FALSE;
+	    *rval = OBJECT_TO_JSVAL(scopeobj);
+	    old = JS_SetLazyCompile(cx, (JSBool)lazy);
+	    start = PRMJ_Now();
+	    script = JS_CompileUCScript(cx, scopeobj, JS_GetStringChars(str),
+					JS_GetStringLength(str),
+					"lazybench", 1);
+	    t = NumBenchMs(start);
+	    JS_SetLazyCompile(cx, old);
+	    if (!script)
+		return JS_FALSE;
+	    if (t < ms[lazy])
+		ms[lazy] = t;
+	    size[lazy] = 0;
+	    ok = LazyBenchSize(cx, script, JS_FALSE, &size[lazy]);
+	    if (ok && lazy) {
+		/* Compile the bodies left, as calling each function would. */
+		start = PRMJ_Now();
+		size[2] = 0;
+		ok = LazyBenchSize(cx, script, JS_TRUE, &size[2]);
+		t = NumBenchMs(start);
+		if (t < ms[2])
+		    ms[2] = t;
+	    }
+	    JS_DestroyScript(cx, script);
+	    if (!ok)
+		return JS_FALSE;
+	}
+    }
+
+    printf("lazybench: %lu chars, eager %lu ms %lu bytes, "
+	   "lazy %lu ms %lu bytes, then every body %lu ms\n",
+	   (unsigned long)JS_GetStringLength(str),
+	   (unsigned long)ms[0], (unsigned long)size[0],
+	   (unsigned long)ms[1], (unsigned long)size[1],
+	   (unsigned long)ms[2]);
+    *rval = JSVAL_VOID;
+    return JS_TRUE;
+}
+
+/*
+ * Arithmetic benchmark: a function whose loop does integer adds, subtracts,
+ * multiplies, divides, remainders, shifts and bitwise ops on its own vars,
+ * reporting how many results the interpreter computed as ints without going
+ * through jsdouble.
+ */
+static char arithbench_source[] =
+    "function arith(n) {\n"
+    "    var sum = 0, x = 1, y = 7;\n"
+    "    for (var i = 0; i < n; i++) {\n"
+    "        x = (x * 33 + i) & 0xffff;\n"
+    "        y = (y ^ (x << 3)) >>> 1;\n"
+    "        sum = (sum + x % 13 - (y & 252) / 4 + (i >> 2)) & 0xffffff;\n"
+    "    }\n"
+    "    return sum;\n"
+    "}\n"
+    "arith(n);\n";
+
+static JSBool
+ArithBench(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    int32 n;
+    JSObject *scopeobj;
+    int64 start;
+    uint32 ms, ops;
+
+    n = 1000000;
+    if (argc > 0 && !JS_ValueToInt32(cx, argv[0], &n))
+	return JS_FALSE;
+    if (n <= 0) {
+	JS_ReportError(cx, "usage: arithbench [iterations]");
+	return JS_FALSE;
+    }
+
+    scopeobj = JS_NewObject(cx, &js_ObjectClass, NULL, obj);
+    if (!scopeobj)
+	return JS_FALSE;
+    *rval = OBJECT_TO_JSVAL(scopeobj);
+    if (!JS_DefineProperty(cx, scopeobj, "n", INT_TO_JSVAL(n),
+			   NULL, NULL, 0)) {
+	return JS_FALSE;
+    }
+    ops = cx->intArithOps;
+    start = PRMJ_Now();
+    if (!JS_EvaluateScript(cx, scopeobj, arithbench_source,
+			   sizeof arithbench_source - 1, "arithbench", 1,
+			   rval)) {
+	return JS_FALSE;
+    }
+    ms = NumBenchMs(start);
+    ops = cx->intArithOps - ops;
+
+    printf("arithbench: %ld iterations, %lu ms, %lu int results\n",
+	   (long)n, (unsigned long)ms, (unsigned long)ops);
+    return JS_TRUE;
+}
+
+#ifdef JS_THREADSAFE
+
+/*
+ * Allocation benchmark: N threads, each with its own context, allocate GC
+ * things as fast as they can.  Threads allocate in rounds small enough that
+ * no round fills the heap, and the GC runs between rounds once all threads
+ * have joined, so that mostly allocation is timed.
+ */
+#define GCBENCH_ROUND 16384
+
+typedef struct GCBenchThread {
+    JSContext   *cx;
+    uint32      count;
+    JSBool      ok;
+} GCBenchThread;
+
+static void
+GCBenchThreadMain(void *arg)
+{
+    GCBenchThread *bt = arg;
+    uint32 i;
+
+    JS_BeginRequest(bt->cx);
+    for (i = 0; i < bt->count; i++) {
+	if (!js_NewDouble(bt->cx, (jsdouble)i)) {
+	    bt->ok = JS_FALSE;
+	    break;
+	}
+    }
+    JS_EndRequest(bt->cx);
+}
+
+static JSBool
+GCBench(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    int32 nthreads, total;
+    GCBenchThread *bt;
+    PRThread **threads;
+    uint32 i, round, done;
+    PRIntervalTime start, elapsed;
+    JSBool ok;
+    uint32 ms;
+
+    nthreads = 1;
+    total = 1L << 20;
+    if (argc > 0 && !JS_ValueToInt32(cx, argv[0], &nthreads))
+	return JS_FALSE;
+    if (argc > 1 && !JS_ValueToInt32(cx, argv[1], &total))
+	return JS_FALSE;
+    if (nthreads <= 0 || nthreads > 16 || total <= 0) {
+	JS_ReportError(cx, "usage: gcbench [threads] [allocations]");
+	return JS_FALSE;
+    }
+
+    bt = JS_malloc(cx, nthreads * sizeof *bt);
+    threads = JS_malloc(cx, nthreads * sizeof *threads);
+    if (!bt || !threads) {
+	JS_free(cx, bt);
+	JS_free(cx, threads);
+	return JS_FALSE;
+    }
+    ok = JS_TRUE;
+    for (i = 0; i < (uint32)nthreads; i++) {
+	bt[i].cx = JS_NewContext(cx->runtime, 8192);
+	if (!bt[i].cx)
+	    ok = JS_FALSE;
+    }
+
+    elapsed = 0;
+    for (done = 0; ok && done < (uint32)total; done += round) {
+	round = (uint32)total - done;
+	if (round > GCBENCH_ROUND * (uint32)nthreads)
+	    round = GCBENCH_ROUND * (uint32)nthreads;
+	start = PR_IntervalNow();
+	JS_EndRequest(cx);
+	for (i = 0; i < (uint32)nthreads; i++) {
+	    bt[i].count = round / nthreads + (i < round % nthreads);
+	    bt[i].ok = JS_TRUE;
+	    threads[i] = PR_CreateThread(PR_USER_THREAD, GCBenchThreadMain,
+					 &bt[i], PR_PRIORITY_NORMAL,
+					 PR_GLOBAL_THREAD, PR_JOINABLE_THREAD,
+					 0);
+	    if (!threads[i])
+		GCBenchThreadMain(&bt[i]);
+	}
+	for (i = 0; i < (uint32)nthreads; i++) {
+	    if (threads[i])
+		PR_JoinThread(threads[i]);
+	    if (!bt[i].ok)
+		ok = JS_FALSE;
+	}
+	JS_BeginRequest(cx);
+	elapsed += PR_IntervalNow() - start;
+	JS_LOCK(cx);
+	js_ForceGC(cx);
+	JS_UNLOCK(cx);
+    }
+
+    for (i = 0; i < (uint32)nthreads; i++) {
+	if (bt[i].cx)
+	    JS_DestroyContext(bt[i].cx);
+    }
+    JS_free(cx, bt);
+    JS_free(cx, threads);
+    if (!ok)
+	return JS_FALSE;
+
+    ms = PR_IntervalToMilliseconds(elapsed);
+    printf("gcbench: %ld threads, %ld allocations, %lu ms\n",
+	   (long)nthreads, (long)total, (unsigned long)ms);
+    *rval = INT_TO_JSVAL(ms);
+    return JS_TRUE;
+}
+
+/*
+ * Atom benchmark: N threads, each with its own context, atomize and drop
+ * names from a shared set, as API calls that take property names do.  The
+ * names are atomized and held first, so the threads only find atoms and
+ * never allocate GC things.
+ */
+#define ATOMBENCH_NAMES 512
+
+typedef struct AtomBenchThread {
+    JSContext   *cx;
+    char        (*names)[16];
+    uint32      start;
+    uint32      count;
+    JSBool      ok;
+} AtomBenchThread;
+
+static void
+AtomBenchThreadMain(void *arg)
+{
+    AtomBenchThread *bt = arg;
+    uint32 i;
+    char *name;
+    JSAtom *atom;
+
+    JS_BeginRequest(bt->cx);
+    for (i = 0; i < bt->count; i++) {
+	name = bt->names[(bt->start + i) % ATOMBENCH_NAMES];
+	atom = js_Atomize(bt->cx, name, strlen(name), 0);
+	if (!atom) {
+	    bt->ok = JS_FALSE;
+	    break;
+	}
+	js_DropAtom(bt->cx, atom);
+    }
+    JS_EndRequest(bt->cx);
+}
+
+static JSBool
+AtomBench(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    int32 nthreads, total;
+    char (*names)[16];
+    JSAtom **atoms;
+    AtomBenchThread *bt;
+    PRThread **threads;
+    uint32 natoms, n, started, i;
+    PRIntervalTime start;
+    JSBool ok;
+    uint32 ms;
+
+    nthreads = 1;
+    total = 1L << 20;
+    if (argc > 0 && !JS_ValueToInt32(cx, argv[0], &nthreads))
+	return JS_FALSE;
+    if (argc > 1 && !JS_ValueToInt32(cx, argv[1], &total))
+	return JS_FALSE;
+    if (nthreads <= 0 || nthreads > 16 || total <= 0) {
+	JS_ReportError(cx, "usage: atombench [threads] [atomizations]");
+	return JS_FALSE;
+    }
+
+    names = JS_malloc(cx, ATOMBENCH_NAMES * sizeof *names);
+    atoms = JS_malloc(cx, ATOMBENCH_NAMES * sizeof *atoms);
+    bt = JS_malloc(cx, nthreads * sizeof *bt);
+    threads = JS_malloc(cx, nthreads * sizeof *threads);
+    ok = (names && atoms && bt && threads);
+    for (natoms = 0; ok && natoms < ATOMBENCH_NAMES; natoms++) {
+	sprintf(names[natoms], "atombench%lu", (unsigned long)natoms);
+	atoms[natoms] = js_Atomize(cx, names[natoms], strlen(names[natoms]),
+				   0);
+	if (!atoms[natoms])
+	    ok = JS_FALSE;
+    }
+    for (n = 0; ok && n < (uint32)nthreads; n++) {
+	bt[n].cx = JS_NewContext(cx->runtime, 8192);
+	if (!bt[n].cx)
+	    ok = JS_FALSE;
+    }
+
+    start = PR_IntervalNow();
+    JS_EndRequest(cx);
+    for (started = 0; ok && started < n; started++) {
+	i = started;
+	bt[i].names = names;
+	bt[i].start = i * (ATOMBENCH_NAMES / n);
+	bt[i].count = total / n + (i < (uint32)total % n);
+	bt[i].ok = JS_TRUE;
+	threads[i] = PR_CreateThread(PR_USER_THREAD, AtomBenchThreadMain,
+				     &bt[i], PR_PRIORITY_NORMAL,
+				     PR_GLOBAL_THREAD, PR_JOINABLE_THREAD, 0);
+	if (!threads[i])
+	    AtomBenchThreadMain(&bt[i]);
+    }
+    for (i = 0; i < started; i++) {
+	if (threads[i])
+	    PR_JoinThread(threads[i]);
+	if (!bt[i].ok)
+	    ok = JS_FALSE;
+    }
+    JS_BeginRequest(cx);
+    ms = PR_IntervalToMilliseconds(PR_IntervalNow() - start);
+
+    while (n > 0) {
+	if (bt[--n].cx)
+	    JS_DestroyContext(bt[n].cx);
+    }
+    while (natoms > 0) {
+	if (atoms[--natoms])
+	    js_DropAtom(cx, atoms[natoms]);
+    }
+    JS_free(cx, names);
+    JS_free(cx, atoms);
+    JS_free(cx, bt);
+    JS_free(cx, threads);
+    if (!ok)
+	return JS_FALSE;
+
+    printf("atombench: %ld threads, %ld atomizations, %lu ms\n",
+	   (long)nthreads, (long)total, (unsigned long)ms);
+    *rval = INT_TO_JSVAL(ms);
+    return JS_TRUE;
+}
+
+/*
+ * Thread benchmark and stress test: N threads, each in a request on its own
+ * context and global, run the same script.  It gets and sets properties and
+ * dense elements of the thread's own objects, which need no locks, and
+ * allocates as it goes, so threads stop each other for the GC.  It also
+ * reads and bumps properties of one object all threads share, which takes
+ * the thin lock of its scope.  Every thread must get the same result; the
+ * shared count loses updates racing threads make, as it would in any
+ * unsynchronized program.
+ */
+static const char threadbench_source[] =
+    "function run(n) {\n"
+    "    var o = {x: 0, y: 1}, a = [], s = 0, i, t;\n"
+    "    for (i = 0; i < 64; i++)\n"
+    "        a[i] = i;\n"
+    "    for (i = 0; i < n; i++) {\n"
+    "        o.x = o.x + a[i & 63];\n"
+    "        a[i & 63] = (a[i & 63] + o.y) & 1023;\n"
+    "        t = {v: i, w: 'k' + (i & 15)};\n"
+    "        s = (s + t.v + t.w.length + shared.step) & 0xfffff;\n"
+    "        shared.hits = shared.hits + 1;\n"
+    "    }\n"
+    "    return o.x + s;\n"
+    "}\n"
+    "run(n);\n";
+
+typedef struct ThreadBenchThread {
+    JSContext   *cx;
+    JSObject    *global;
+    jsdouble    result;
+    JSBool      ok;
+} ThreadBenchThread;
+
+static void
+ThreadBenchThreadMain(void *arg)
+{
+    ThreadBenchThread *bt = arg;
+    jsval v;
+
+    JS_BeginRequest(bt->cx);
+    bt->ok = JS_EvaluateScript(bt->cx, bt->global, threadbench_source,
+			       sizeof threadbench_source - 1, "threadbench",
+			       1, &v) &&
+	     JS_ValueToNumber(bt->cx, v, &bt->result);
+    JS_EndRequest(bt->cx);
+}
+
+static JSBool
+ThreadBench(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
+	    jsval *rval)
+{
+    int32 nthreads, n;
+    JSObject *shared;
+    ThreadBenchThread *bt;
+    PRThread **threads;
+    uint32 i, started;
+    PRIntervalTime start;
+    JSBool ok;
+    jsval v;
+    uint32 ms;
+
+    nthreads = 4;
+    n = 100000;
+    if (argc > 0 && !JS_ValueToInt32(cx, argv[0], &nthreads))
+	return JS_FALSE;
+    if (argc > 1 && !JS_ValueToInt32(cx, argv[1], &n))
+	return JS_FALSE;
+    if (nthreads <= 0 || nthreads > 16 || n <= 0) {
+	JS_ReportError(cx, "usage: threadbench [threads] [iterations]");
+	return JS_FALSE;
+    }
+
+    shared = JS_NewObject(cx, &js_ObjectClass, NULL, NULL);
+    if (!shared)
+	return JS_FALSE;
+    *rval = OBJECT_TO_JSVAL(shared);
+    if (!JS_DefineProperty(cx, shared, "step", INT_TO_JSVAL(1), NULL, NULL,
+			   JSPROP_ENUMERATE) ||
+	!JS_DefineProperty(cx, shared, "hits", JSVAL_ZERO, NULL, NULL,
+			   JSPROP_ENUMERATE)) {
+	return JS_FALSE;
+    }
+
+    bt = JS_malloc(cx, nthreads * sizeof *bt);
+    threads = JS_malloc(cx, nthreads * sizeof *threads);
+    ok = (bt && threads);
+    if (bt)
+	memset(bt, 0, nthreads * sizeof *bt);
+    for (i = 0; ok && i < (uint32)nthreads; i++) {
+	bt[i].cx = JS_NewContext(cx->runtime, 8192);
+	if (!bt[i].cx) {
+	    ok = JS_FALSE;
+	    break;
+	}
+	bt[i].global = JS_NewObject(bt[i].cx, &js_ObjectClass, NULL, NULL);
+	ok = bt[i].global &&
+	     JS_InitStandardClasses(bt[i].cx, bt[i].global) &&
+	     JS_DefineProperty(bt[i].cx, bt[i].global, "shared",
+			       OBJECT_TO_JSVAL(shared), NULL, NULL, 0) &&
+	     JS_DefineProperty(bt[i].cx, bt[i].global, "n", INT_TO_JSVAL(n),
+			       NULL, NULL, 0);
+	if (ok)
+	    JS_SetErrorReporter(bt[i].cx, cx->errorReporter);
+    }
+
+    start = PR_IntervalNow();
+    JS_EndRequest(cx);
+    for (started = 0; ok && started < (uint32)nthreads; started++) {
+	threads[started] = PR_CreateThread(PR_USER_THREAD,
+					   ThreadBenchThreadMain,
+					   &bt[started], PR_PRIORITY_NORMAL,
+					   PR_GLOBAL_THREAD,
+					   PR_JOINABLE_THREAD, 0);
+	if (!threads[started])
+	    ThreadBenchThreadMain(&bt[started]);
+    }
+    for (i = 0; i < started; i++) {
+	if (threads[i])
+	    PR_JoinThread(threads[i]);
+	if (!bt[i].ok)
+	    ok = JS_FALSE;
+    }
+    JS_BeginRequest(cx);
+    ms = PR_IntervalToMilliseconds(PR_IntervalNow() - start);
+
+    for (i = 1; ok && i < started; i++) {
+	if (bt[i].result != bt[0].result) {
+	    JS_ReportError(cx, "threadbench: thread %lu got %g, not %g",
+			   (unsigned long)i, bt[i].result, bt[0].result);
+	    ok = JS_FALSE;
+	}
+    }
+    if (bt) {
+	for (i = 0; i < (uint32)nthreads && bt[i].cx; i++)
+	    JS_DestroyContext(bt[i].cx);
+    }
+    JS_free(cx, bt);
+    JS_free(cx, threads);
+    if (!ok || !JS_GetProperty(cx, shared, "hits", &v))
+	return JS_FALSE;
+
+    printf("threadbench: %ld threads, %ld iterations, %lu ms, "
+	   "%ld of %ld shared updates kept\n",
+	   (long)nthreads, (long)n, (unsigned long)ms,
+	   (long)(JSVAL_IS_INT(v) ? JSVAL_TO_INT(v) : -1),
+	   (long)nthreads * (long)n);
+    *rval = INT_TO_JSVAL(ms);
+    return JS_TRUE;
+}
+
+#endif /* JS_THREADSAFE */
+
 static JSBool
 GetTrapArgs(JSContext *cx, uintN argc, jsval *argv, JSScript **scriptp,
 	    int32 *ip)
@@ -237,7 +1146,9 @@ GetTrapArgs(JSContext *cx, uintN argc, jsval *argv, JSScript **scriptp,
 	    fun = JS_ValueToFunction(cx, argv[0]);
 	    if (!fun)
 		return JS_FALSE;
-	    *scriptp = fun->script;
+	    *scriptp = JS_GetFunctionScript(cx, fun);
+	    if (!*scriptp)
+		return JS_FALSE;
 	    intarg++;
 	}
 	if (argc > intarg) {
@@ -340,6 +1251,88 @@ PCToLine(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     return JS_TRUE;
 }
 
+static JSBool
+JIT(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    JSBool bval, old;
+
+    if (argc == 0) {
+	old = JS_SetJITEnabled(cx, JS_FALSE);
+	JS_SetJITEnabled(cx, old);
+    } else {
+	if (!JS_ValueToBoolean(cx, argv[0], &bval))
+	    return JS_FALSE;
+	old = JS_SetJITEnabled(cx, bval);
+    }
+    *rval = BOOLEAN_TO_JSVAL(old);
+    return JS_TRUE;
+}
+
+static JSBool
+Lazy(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    JSBool bval, old;
+
+    if (argc == 0) {
+	old = JS_SetLazyCompile(cx, JS_FALSE);
+	JS_SetLazyCompile(cx, old);
+    } else {
+	if (!JS_ValueToBoolean(cx, argv[0], &bval))
+	    return JS_FALSE;
+	old = JS_SetLazyCompile(cx, bval);
+    }
+    *rval = BOOLEAN_TO_JSVAL(old);
+    return JS_TRUE;
+}
+
+static JSBool
+Profile(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    JSString *str;
+    char *cmd;
+    int32 interval;
+
+    if (argc == 0) {
+	JS_DumpProfile(cx, stdout);
+	return JS_TRUE;
+    }
+    str = JS_ValueToString(cx, argv[0]);
+    if (!str)
+	return JS_FALSE;
+    cmd = JS_GetStringBytes(str);
+    interval = 0;
+    if (argc > 1 && !JS_ValueToInt32(cx, argv[1], &interval))
+	return JS_FALSE;
+    if (strcmp(cmd, "sample") == 0)
+	return JS_StartProfiling(cx, JSPROF_SAMPLE, (uint32)interval);
+    if (strcmp(cmd, "count") == 0)
+	return JS_StartProfiling(cx, JSPROF_COUNT, 0);
+    if (strcmp(cmd, "stop") == 0) {
+	JS_StopProfiling(cx);
+    } else if (strcmp(cmd, "dump") == 0) {
+	JS_DumpProfile(cx, stdout);
+    } else if (strcmp(cmd, "clear") == 0) {
+	JS_ClearProfile(cx);
+    } else {
+	fprintf(stderr, "profile: illegal argument %s\n", cmd);
+    }
+    return JS_TRUE;
+}
+
+static JSBool
+Census(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
+{
+    int32 nfiles;
+    JSMemoryCensus census;
+
+    nfiles = 10;
+    if (argc > 0 && !JS_ValueToInt32(cx, argv[0], &nfiles))
+	return JS_FALSE;
+    JS_DumpMemoryCensus(cx, stdout, (uintN)nfiles);
+    JS_GetMemoryCensus(cx, &census);
+    return JS_NewDoubleValue(cx, (jsdouble)census.totalBytes, rval);
+}
+
 #ifdef DEBUG
 
 static void
@@ -398,7 +1391,7 @@ Notes(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 
     for (i = 0; i < argc; i++) {
 	fun = JS_ValueToFunction(cx, argv[i]);
-	if (!fun)
+	if (!fun || !JSFUN_COMPILE(cx, fun))
 	    return JS_FALSE;
 
 	SingleNote(cx, fun);
@@ -423,7 +1416,7 @@ Disassemble(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     }
     for (i = 0; i < argc; i++) {
 	fun = JS_ValueToFunction(cx, argv[i]);
-	if (!fun)
+	if (!fun || !JSFUN_COMPILE(cx, fun))
 	    return JS_FALSE;
 
 	js_Disassemble(cx, fun->script, lines, stdout);
@@ -446,7 +1439,7 @@ DisassWithSrc(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval
 
     for (i = 0; i < argc; i++) {
 	fun = JS_ValueToFunction(cx, argv[i]);
-	if (!fun)
+	if (!fun || !JSFUN_COMPILE(cx, fun))
 	    return JS_FALSE;
 
 	if (! fun->script || ! fun->script->filename ) {
@@ -536,49 +1529,51 @@ DumpAtom(PRHashEntry *he, int i, void *arg)
     return HT_ENUMERATE_NEXT;
 }
 
-int
-DumpSymbol(PRHashEntry *he, int i, void *arg)
+void
+DumpSymbol(JSSymbol *sym, int i, FILE *fp)
 {
-    FILE *fp = arg;
-    JSSymbol *sym = (JSSymbol *)he;
-
-    fprintf(fp, "%3d %08x", i, (uintN)he->keyHash);
+    fprintf(fp, "%3d %08x", i, (uintN)js_HashValue(sym_id(sym)));
     if (JSVAL_IS_INT(sym_id(sym)))
 	fprintf(fp, " [%ld]\n", (long)JSVAL_TO_INT(sym_id(sym)));
     else
 	fprintf(fp, " \"%s\"\n", ATOM_BYTES(sym_atom(sym)));
-    return HT_ENUMERATE_NEXT;
 }
 
-extern JSScopeOps js_list_scope_ops;
-
 void
-DumpScope(JSObject *obj, PRHashEnumerator dump, FILE *fp)
+DumpScope(JSObject *obj, FILE *fp)
 {
     JSScope *scope;
     JSSymbol *sym;
-    int i;
+    JSScopeTable *table;
+    uint32 size, i;
+    JSScopeEntry *e;
 
     fprintf(fp, "\n%s scope contents:\n", obj->map->clasp->name);
     scope = (JSScope *)obj->map;
     if (scope->ops == &js_list_scope_ops) {
-	for (sym = (JSSymbol *)scope->data, i = 0; sym;
-	     sym = (JSSymbol *)sym->entry.next, i++) {
-	    DumpSymbol(&sym->entry, i, fp);
-	}
-    } else {
-	PR_HashTableDump(scope->data, dump, fp);
+	i = 0;
+	for (sym = scope->data; sym; sym = sym->link)
+	    DumpSymbol(sym, (int)i++, fp);
+	return;
+    }
+    table = scope->data;
+    if (scope->ops != &js_table_scope_ops || !table)
+	return;
+    size = SCOPE_TABLE_SIZE(table);
+    for (i = 0, e = table->entries; i < size; i++, e++) {
+	if (SCOPE_ENTRY_IS_LIVE(e))
+	    DumpSymbol(e->sym, (int)i, fp);
     }
 }
 
 /* These are callable from gdb. */
-void Dsym(JSSymbol *sym) { if (sym) DumpSymbol(&sym->entry, 0, stderr); }
+void Dsym(JSSymbol *sym) { if (sym) DumpSymbol(sym, 0, stderr); }
 void Datom(JSAtom *atom) { if (atom) DumpAtom(&atom->entry, 0, stderr); }
 
 static JSBool
 DumpStats(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 {
-    uintN i;
+    uintN i, j;
     JSString *str;
     const char *bytes;
     JSAtom *atom;
@@ -596,9 +1591,12 @@ DumpStats(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 #endif
 	} else if (strcmp(bytes, "atom") == 0) {
 	    printf("\natom table contents:\n");
-	    PR_HashTableDump(cx->runtime->atomState.table, DumpAtom, stdout);
+	    for (j = 0; j < ATOM_STRIPES; j++) {
+		PR_HashTableDump(cx->runtime->atomState.stripes[j].table,
+				 DumpAtom, stdout);
+	    }
 	} else if (strcmp(bytes, "global") == 0) {
-	    DumpScope(cx->globalObject, DumpSymbol, stdout);
+	    DumpScope(cx->globalObject, stdout);
 	} else {
 	    JS_LOCK(cx);
 	    atom = js_Atomize(cx, bytes, JS_GetStringLength(str), 0);
@@ -614,7 +1612,7 @@ DumpStats(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 				bytes);
 		    } else {
 			obj = JSVAL_TO_OBJECT(prop->object->slots[prop->slot]);
-			DumpScope(obj, DumpSymbol, stdout);
+			DumpScope(obj, stdout);
 		    }
 		}
 	    }
@@ -650,6 +1648,7 @@ DoExport(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     if (!prop)
 	return JS_FALSE;
     prop->flags |= JSPROP_EXPORTED;
+    PROPERTY_CHANGED(cx, prop);
     return JS_TRUE;
 }
 #endif
@@ -661,10 +1660,24 @@ static JSFunctionSpec shell_functions[] = {
     {"help",            Help,           0},
     {"quit",            Quit,           0},
     {"gc",              GC,             0},
+    {"gcslice",         GCSlice,        1},
+    {"propbench",       PropBench,      1},
+    {"numbench",        NumBench,       1},
+    {"lazybench",       LazyBench,      2},
+    {"arithbench",      ArithBench,     1},
+#ifdef JS_THREADSAFE
+    {"gcbench",         GCBench,        2},
+    {"atombench",       AtomBench,      2},
+    {"threadbench",     ThreadBench,    2},
+#endif
     {"trap",            Trap,           3},
     {"untrap",          Untrap,         2},
     {"line2pc",         LineToPC,       0},
     {"pc2line",         PCToLine,       0},
+    {"jit",             JIT,            0},
+    {"lazy",            Lazy,           0},
+    {"profile",         Profile,        2},
+    {"census",          Census,         1},
 #ifdef DEBUG
     {"dis",             Disassemble,    1},
     {"dissrc",          DisassWithSrc,  1},
@@ -687,10 +1700,24 @@ static char *shell_help_messages[] = {
     "help [name ...]        Display usage and help messages",
     "quit                   Quit mocha",
     "gc                     Run the garbage collector",
+    "gcslice [usec]         Get or set the GC mark slice budget, 0 for none",
+    "propbench [n]          Time property loops with and without inline caches",
+    "numbench [n]           Check and time n conversions against prdtoa",
+    "lazybench src [n]      Time compiling src with and without lazy bodies",
+    "arithbench [n]         Time an integer arithmetic loop of n iterations",
+#ifdef JS_THREADSAFE
+    "gcbench [n] [count]    Time count GC allocations spread over n threads",
+    "atombench [n] [count]  Time count atomizations spread over n threads",
+    "threadbench [n] [count] Time a script looping count times on n threads",
+#endif
     "trap [fun] [pc] expr   Trap bytecode execution",
     "untrap [fun] [pc]      Remove a trap",
     "line2pc [fun] line     Map line number to PC",
     "pc2line [fun] [pc]     Map PC to line number",
+    "jit [toggle]           Get or set whether scripts run as native code",
+    "lazy [toggle]          Get or set whether function bodies compile lazily",
+    "profile [cmd] [usec]   Profile by 'sample' or 'count', 'stop', 'dump'",
+    "census [nfiles]        Print memory use by kind, class and script file",
 #ifdef DEBUG
     "dis [fun]              Disassemble functions into bytecodes",
     "dissrc [fun]           Disassemble functions with source lines",
@@ -1023,6 +2050,8 @@ main(int argc, char **argv)
 {
     int c, i;
     JSVersion version;
+    JSBool jit, lazy;
+    char *cachedir;
     JSRuntime *rt;
     JSContext *cx;
     JSObject *glob, *it;
@@ -1035,14 +2064,27 @@ main(int argc, char **argv)
 #endif
 
     version = JSVERSION_DEFAULT;
+    jit = JS_FALSE;
+    lazy = JS_FALSE;
+    cachedir = NULL;
 #ifdef XP_UNIX
-    while ((c = getopt(argc, argv, "v:")) != -1) {
+    while ((c = getopt(argc, argv, "c:jv:z")) != -1) {
 	switch (c) {
+	  case 'c':
+	    cachedir = optarg;
+	    break;
+	  case 'j':
+	    jit = JS_TRUE;
+	    break;
 	  case 'v':
 	    version = atoi(optarg);
 	    break;
+	  case 'z':
+	    lazy = JS_TRUE;
+	    break;
 	  default:
-	    fprintf(stderr, "usage: js [-v version]\n");
+	    fprintf(stderr,
+		    "usage: js [-c cachedir] [-j] [-v version] [-z]\n");
 	    return 2;
 	}
     }
@@ -1057,11 +2099,24 @@ main(int argc, char **argv)
     rt = JS_Init(8L * 1024L * 1024L);
     if (!rt)
 	return 1;
+    if (cachedir && !JS_SetScriptCacheDir(rt, cachedir))
+	return 1;
+#ifdef JS_THREADSAFE
+    shell_runtime_lock.lock = PR_NewLock();
+    if (!shell_runtime_lock.lock)
+	return 1;
+    rt->lockData = &shell_runtime_lock;
+#endif
     cx = JS_NewContext(rt, 8192);
     if (!cx)
 	return 1;
+    JS_BeginRequest(cx);
     if (version != JSVERSION_DEFAULT)
 	JS_SetVersion(cx, version);
+    if (jit)
+	JS_SetJITEnabled(cx, JS_TRUE);
+    if (lazy)
+	JS_SetLazyCompile(cx, JS_TRUE);
 
     glob = JS_NewObject(cx, &global_class, NULL, NULL);
     if (!glob)
@@ -1085,6 +2140,7 @@ main(int argc, char **argv)
 	Process(cx, glob, NULL);
     }
 
+    JS_EndRequest(cx);
     JS_DestroyContext(cx);
     JS_Finish(rt);
     return 0;
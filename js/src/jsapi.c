@@ -38,10 +38,12 @@
 #include "jscntxt.h"
 #include "jsconfig.h"
 #include "jsdate.h"
+#include "jsdbgapi.h"
 #include "jsemit.h"
 #include "jsfun.h"
 #include "jsgc.h"
 #include "jsinterp.h"
+#include "jsjit.h"
 #include "jslock.h"
 #include "jsmath.h"
 #include "jsnum.h"
@@ -53,6 +55,7 @@
 #include "jsscope.h"
 #include "jsscript.h"
 #include "jsstr.h"
+#include "jsxdrapi.h"
 
 PR_IMPLEMENT(jsval)
 JS_GetNaNValue(JSContext *cx)
@@ -237,7 +240,15 @@ JS_Init(uint32 maxbytes)
 PR_IMPLEMENT(void)
 JS_Finish(JSRuntime *rt)
 {
+#if JS_HAS_REGEXPS
+    js_FinishRegExpCache(rt);
+#endif
     js_FinishGC(rt);
+    js_FinishProfile(rt);
+    if (rt->shapeTable)
+	PR_HashTableDestroy(rt->shapeTable);
+    if (rt->scriptCacheDir)
+	free(rt->scriptCacheDir);
     free(rt);
 }
 
@@ -267,7 +278,49 @@ JS_NewContext(JSRuntime *rt, size_t stacksize)
 PR_IMPLEMENT(void)
 JS_DestroyContext(JSContext *cx)
 {
-    JS_LOCK_VOID(cx, js_DestroyContext(cx));
+#ifdef JS_THREADSAFE
+    JSRuntime *rt;
+
+    /* Unlock via rt, since js_DestroyContext frees cx. */
+    rt = cx->runtime;
+#endif
+    JS_LOCK(cx);
+    js_DestroyContext(cx);
+    JS_UNLOCK_RUNTIME(rt);
+}
+
+PR_IMPLEMENT(void)
+JS_BeginRequest(JSContext *cx)
+{
+#ifdef JS_THREADSAFE
+    /* Wait for any GC to finish before entering the outermost request. */
+    if (cx->requestDepth == 0) {
+	JS_LOCK_RUNTIME(cx->runtime);
+	cx->thread = PR_GetCurrentThread();
+	cx->requestDepth = 1;
+	JS_UNLOCK_RUNTIME(cx->runtime);
+	return;
+    }
+    cx->requestDepth++;
+#endif
+}
+
+PR_IMPLEMENT(void)
+JS_EndRequest(JSContext *cx)
+{
+#ifdef JS_THREADSAFE
+    PR_ASSERT(cx->requestDepth != 0);
+    cx->requestDepth--;
+#endif
+}
+
+PR_IMPLEMENT(void)
+JS_YieldRequest(JSContext *cx)
+{
+#ifdef JS_THREADSAFE
+    JS_LOCK(cx);
+    JS_UNLOCK(cx);
+#endif
 }
 
 PR_IMPLEMENT(JSRuntime *)
@@ -361,10 +414,10 @@ JS_InitStandardClasses(JSContext *cx, JSObject *obj)
     /* Link the global object and Function.prototype to Object.prototype. */
     proto = OBJ_GET_PROTO(obj);
     if (!proto)
-	OBJ_SET_PROTO(obj, obj_proto);
+	OBJ_SET_PROTO(cx, obj, obj_proto);
     proto = OBJ_GET_PROTO(fun_proto);
     if (!proto)
-	OBJ_SET_PROTO(fun_proto, obj_proto);
+	OBJ_SET_PROTO(cx, fun_proto, obj_proto);
 
     /* Initialize the rest of the standard objects and functions. */
     ok = (array_proto = js_InitArrayClass(cx, obj)) &&
@@ -545,8 +598,6 @@ PR_IMPLEMENT(void)
 JS_GC(JSContext *cx)
 {
     JS_LOCK(cx);
-    if (!cx->fp)
-	PR_FinishArenaPool(&cx->stackPool);
     PR_FinishArenaPool(&cx->codePool);
     PR_FinishArenaPool(&cx->tempPool);
     js_ForceGC(cx);
@@ -560,12 +611,24 @@ JS_MaybeGC(JSContext *cx)
     uint32 bytes, lastBytes;
 
     rt = cx->runtime;
-    JS_LOCK_RUNTIME(rt);
+    JS_LOCK(cx);
     bytes = rt->gcBytes;
     lastBytes = rt->gcLastBytes;
-    if (bytes > 8192 && bytes > lastBytes + lastBytes / 2)
+    if (rt->gcMarking || (bytes > 8192 && bytes > lastBytes + lastBytes / 2))
 	js_GC(cx);
+    JS_UNLOCK(cx);
+}
+
+PR_IMPLEMENT(uint32)
+JS_SetGCSliceBudget(JSRuntime *rt, uint32 usec)
+{
+    uint32 oldBudget;
+
+    JS_LOCK_RUNTIME(rt);
+    oldBudget = rt->gcSliceBudget;
+    rt->gcSliceBudget = usec;
     JS_UNLOCK_RUNTIME(rt);
+    return oldBudget;
 }
 
 /************************************************************************/
@@ -638,7 +701,7 @@ JS_InitClass(JSContext *cx, JSObject *obj, JSObject *parent_proto,
     if (fun->object->map->clasp == clasp) {
 	fun_proto = OBJ_GET_PROTO(fun->object);
 	if (!fun_proto)
-	    OBJ_SET_PROTO(fun->object, proto);
+	    OBJ_SET_PROTO(cx, fun->object, proto);
     }
 
     /* Add properties and methods to the prototype and the constructor. */
@@ -879,6 +942,7 @@ JS_DefineProperties(JSContext *cx, JSObject *obj, JSPropertySpec *ps)
 	}
 	prop->id = INT_TO_JSVAL(ps->tinyid);
 	prop->flags |= JSPROP_TINYIDHACK;
+	PROPERTY_CHANGED(cx, prop);
     }
     JS_UNLOCK(cx);
     return ok;
@@ -905,6 +969,7 @@ JS_DefinePropertyWithTinyId(JSContext *cx, JSObject *obj, const char *name,
     if (prop) {
 	prop->id = INT_TO_JSVAL(tinyid);
 	prop->flags |= JSPROP_TINYIDHACK;
+	PROPERTY_CHANGED(cx, prop);
     }
     JS_UNLOCK(cx);
     return prop != 0;
@@ -984,15 +1049,13 @@ JS_GetProperty(JSContext *cx, JSObject *obj, const char *name, jsval *vp)
     JSAtom *atom;
     JSBool ok;
 
-    JS_LOCK(cx);
     atom = js_Atomize(cx, name, strlen(name), 0);
-    if (!atom) {
-	ok = JS_FALSE;
-    } else {
-	ok = (js_GetProperty(cx, obj, (jsval)atom, vp) != NULL);
-	js_DropAtom(cx, atom);
-    }
+    if (!atom)
+	return JS_FALSE;
+    JS_LOCK(cx);
+    ok = (js_GetProperty(cx, obj, (jsval)atom, vp) != NULL);
     JS_UNLOCK(cx);
+    js_DropAtom(cx, atom);
     return ok;
 }
 
@@ -1002,15 +1065,13 @@ JS_SetProperty(JSContext *cx, JSObject *obj, const char *name, jsval *vp)
     JSAtom *atom;
     JSBool ok;
 
-    JS_LOCK(cx);
     atom = js_Atomize(cx, name, strlen(name), 0);
-    if (!atom) {
-	ok = JS_FALSE;
-    } else {
-	ok = (js_SetProperty(cx, obj, (jsval)atom, vp) != NULL);
-	js_DropAtom(cx, atom);
-    }
+    if (!atom)
+	return JS_FALSE;
+    JS_LOCK(cx);
+    ok = (js_SetProperty(cx, obj, (jsval)atom, vp) != NULL);
     JS_UNLOCK(cx);
+    js_DropAtom(cx, atom);
     return ok;
 }
 
@@ -1021,15 +1082,13 @@ JS_DeleteProperty(JSContext *cx, JSObject *obj, const char *name)
     JSBool ok;
     jsval rval;	/* XXX not in API */
 
-    JS_LOCK(cx);
     atom = js_Atomize(cx, name, strlen(name), 0);
-    if (!atom) {
-	ok = JS_FALSE;
-    } else {
-	ok = js_DeleteProperty(cx, obj, (jsval)atom, &rval);
-	js_DropAtom(cx, atom);
-    }
+    if (!atom)
+	return JS_FALSE;
+    JS_LOCK(cx);
+    ok = js_DeleteProperty(cx, obj, (jsval)atom, &rval);
     JS_UNLOCK(cx);
+    js_DropAtom(cx, atom);
     return ok;
 }
 
@@ -1089,6 +1148,10 @@ JS_AliasElement(JSContext *cx, JSObject *obj, const char *name, jsint alias)
 	ok = JS_FALSE;
 	goto out;
     }
+    if (OBJ_IS_DENSE_ARRAY(obj) && !js_MakeArraySlow(cx, obj)) {
+	ok = JS_FALSE;
+	goto out;
+    }
     scope = js_GetMutableScope(cx, obj);
     if (!scope)
 	ok = JS_FALSE;
@@ -1120,17 +1183,13 @@ JS_LookupElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
 PR_IMPLEMENT(JSBool)
 JS_GetElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
 {
-    JS_LOCK_AND_RETURN_BOOL(cx,
-			    js_GetProperty(cx, obj, INT_TO_JSVAL(index), vp)
-			    != NULL);
+    JS_LOCK_AND_RETURN_BOOL(cx, js_GetArrayElement(cx, obj, index, vp));
 }
 
 PR_IMPLEMENT(JSBool)
 JS_SetElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
 {
-    JS_LOCK_AND_RETURN_BOOL(cx,
-			    js_SetProperty(cx, obj, INT_TO_JSVAL(index), vp)
-			    != NULL);
+    JS_LOCK_AND_RETURN_BOOL(cx, js_SetArrayElement(cx, obj, index, vp));
 }
 
 PR_IMPLEMENT(JSBool)
@@ -1153,6 +1212,12 @@ JS_ClearScope(JSContext *cx, JSObject *obj)
     /* Avoid lots of js_FlushPropertyCacheByProp activity. */
     js_FlushPropertyCache(cx);
 
+    /* Clear dense array elements along with everything else. */
+    if (OBJ_IS_DENSE_ARRAY(obj)) {
+	free(ARRAY_ELEMENTS(obj));
+	obj->slots[JSSLOT_PRIVATE] = JSVAL_VOID;
+    }
+
     scope = (JSScope *)obj->map;
     scope->ops->clear(cx, scope);
 
@@ -1302,34 +1367,118 @@ JS_CompileUCScript(JSContext *cx, JSObject *obj,
 					   filename, lineno);
 }
 
-PR_IMPLEMENT(JSScript *)
-JS_CompileUCScriptForPrincipals(JSContext *cx, JSObject *obj,
-				JSPrincipals *principals,
-				const jschar *chars, size_t length,
-				const char *filename, uintN lineno)
+/*
+ * Compile chars, looking in the script cache first and saving the script
+ * there after if cache is true.
+ */
+static JSScript *
+CompileUCScript(JSContext *cx, JSObject *obj, JSPrincipals *principals,
+		const jschar *chars, size_t length,
+		const char *filename, uintN lineno, JSBool cache)
 {
     void *mark;
     JSTokenStream *ts;
     JSScript *script;
 
     JS_LOCK(cx);
+#ifdef JSFILE
+    if (cache) {
+	script = js_GetCachedScript(cx, obj, principals, chars, length,
+				    filename, lineno);
+	if (script)
+	    goto out;
+    }
+#endif
     mark = PR_ARENA_MARK(&cx->tempPool);
     ts = js_NewTokenStream(cx, chars, length, filename, lineno, principals);
     if (ts)
 	script = CompileTokenStream(cx, obj, ts, mark);
     else
 	script = NULL;
+#ifdef JSFILE
+    if (script && cache)
+	js_CacheScript(cx, obj, principals, script, chars, length, lineno);
+out:
+#endif
     JS_UNLOCK(cx);
     return script;
 }
 
+PR_IMPLEMENT(JSScript *)
+JS_CompileUCScriptForPrincipals(JSContext *cx, JSObject *obj,
+				JSPrincipals *principals,
+				const jschar *chars, size_t length,
+				const char *filename, uintN lineno)
+{
+    /* Don't cache what eval compiles, or other scripts made on the fly. */
+    return CompileUCScript(cx, obj, principals, chars, length, filename,
+			   lineno, cx->fp == NULL);
+}
+
 #ifdef JSFILE
+/*
+ * Read filename into a JS_malloc'ed buffer of chars, returning null with
+ * errno set on failure.
+ */
+static jschar *
+ReadFileChars(JSContext *cx, const char *filename, size_t *lengthp)
+{
+    FILE *fp;
+    char *bytes, *tmp;
+    size_t length, size, n;
+    jschar *chars;
+
+    fp = fopen(filename, "r");
+    if (!fp)
+	return NULL;
+    bytes = NULL;
+    length = size = 0;
+    do {
+	if (length == size) {
+	    size += 8192;
+	    tmp = JS_realloc(cx, bytes, size);
+	    if (!tmp) {
+		JS_free(cx, bytes);
+		fclose(fp);
+		return NULL;
+	    }
+	    bytes = tmp;
+	}
+	n = fread(bytes + length, 1, size - length, fp);
+	length += n;
+    } while (n != 0);
+    if (ferror(fp)) {
+	JS_free(cx, bytes);
+	fclose(fp);
+	return NULL;
+    }
+    fclose(fp);
+    chars = js_InflateString(cx, bytes, length);
+    JS_free(cx, bytes);
+    *lengthp = length;
+    return chars;
+}
+
 PR_IMPLEMENT(JSScript *)
 JS_CompileFile(JSContext *cx, JSObject *obj, const char *filename)
 {
     void *mark;
     JSTokenStream *ts;
     JSScript *script;
+    jschar *chars;
+    size_t length;
+
+    /* With a script cache, read the file so its source can be hashed. */
+    if (cx->runtime->scriptCacheDir &&
+	filename && strcmp(filename, "-") != 0) {
+	chars = ReadFileChars(cx, filename, &length);
+	if (!chars)
+	    return NULL;
+	script = CompileUCScript(cx, obj, NULL, chars, length, filename, 1,
+				 JS_TRUE);
+	JS_free(cx, chars);
+	return script;
+    }
 
     JS_LOCK(cx);
     mark = PR_ARENA_MARK(&cx->tempPool);
@@ -1352,6 +1501,24 @@ out:
     JS_UNLOCK(cx);
     return script;
 }
+
+PR_IMPLEMENT(JSBool)
+JS_SetScriptCacheDir(JSRuntime *rt, const char *dirname)
+{
+    char *dir;
+
+    dir = NULL;
+    if (dirname) {
+	dir = malloc(strlen(dirname) + 1);
+	if (!dir)
+	    return JS_FALSE;
+	strcpy(dir, dirname);
+    }
+    if (rt->scriptCacheDir)
+	free(rt->scriptCacheDir);
+    rt->scriptCacheDir = dir;
+    return JS_TRUE;
+}
 #endif
 
 PR_IMPLEMENT(void)
@@ -1456,6 +1623,7 @@ JS_CompileUCFunctionForPrincipals(JSContext *cx, JSObject *obj,
 	    if (!prop)
 		break;
 	    prop->id = INT_TO_JSVAL(i);
+	    PROPERTY_CHANGED(cx, prop);
 	    arg = prop->symbols;
 	    *argp = arg;
 	    argp = &arg->next;
@@ -1526,6 +1694,8 @@ JS_DecompileFunction(JSContext *cx, JSFunction *fun, uintN indent)
 PR_IMPLEMENT(JSString *)
 JS_DecompileFunctionBody(JSContext *cx, JSFunction *fun, uintN indent)
 {
+    if (!JSFUN_COMPILE(cx, fun))
+	return NULL;
     return JS_DecompileScript(cx, fun->script, JS_GetFunctionName(fun), indent);
 }
 
@@ -1643,6 +1813,28 @@ JS_IsRunning(JSContext *cx)
     return cx->fp != NULL;
 }
 
+PR_IMPLEMENT(JSBool)
+JS_SetJITEnabled(JSContext *cx, JSBool enabled)
+{
+    JSBool old;
+
+    old = cx->jitEnabled;
+#if JS_HAS_JIT
+    cx->jitEnabled = enabled;
+#endif
+    return old;
+}
+
+PR_IMPLEMENT(JSBool)
+JS_SetLazyCompile(JSContext *cx, JSBool lazy)
+{
+    JSBool old;
+
+    old = cx->lazyCompile;
+    cx->lazyCompile = lazy;
+    return old;
+}
+
 /************************************************************************/
 
 PR_IMPLEMENT(JSString *)
@@ -1708,7 +1900,7 @@ JS_InternString(JSContext *cx, const char *s)
 {
     JSAtom *atom;
 
-    JS_LOCK_VOID(cx, atom = js_Atomize(cx, s, strlen(s), 0));
+    atom = js_Atomize(cx, s, strlen(s), 0);
     if (!atom)
 	return NULL;
     return ATOM_TO_STRING(atom);
@@ -1755,6 +1947,8 @@ JS_GetStringBytes(JSString *str)
 PR_IMPLEMENT(jschar *)
 JS_GetStringChars(JSString *str)
 {
+    if (!JSSTRING_FLATTEN(NULL, str))
+	return NULL;
     return str->chars;
 }
 
@@ -1767,6 +1961,11 @@ JS_GetStringLength(JSString *str)
 PR_IMPLEMENT(intN)
 JS_CompareStrings(JSString *str1, JSString *str2)
 {
+    /* XXX out of memory flattening a rope compares it as less */
+    if (!JSSTRING_FLATTEN(NULL, str1))
+	return -1;
+    if (!JSSTRING_FLATTEN(NULL, str2))
+	return 1;
     return js_CompareStrings(str1, str2);
 }
 
@@ -183,6 +183,22 @@ JS_NewContext(JSRuntime *rt, size_t stacksize);
 PR_EXTERN(void)
 JS_DestroyContext(JSContext *cx);
 
+/*
+ * A thread runs code using cx inside a request.  The GC runs only when every
+ * context in a request is stopped at a safe point, so a thread that may run
+ * for long without calling the engine should yield now and then, and one
+ * about to block should end its request first.  Requests nest; they cost
+ * nothing unless JS_THREADSAFE is defined.
+ */
+PR_EXTERN(void)
+JS_BeginRequest(JSContext *cx);
+
+PR_EXTERN(void)
+JS_EndRequest(JSContext *cx);
+
+PR_EXTERN(void)
+JS_YieldRequest(JSContext *cx);
+
 PR_EXTERN(JSRuntime *)
 JS_GetRuntime(JSContext *cx);
 
@@ -257,6 +273,15 @@ JS_GC(JSContext *cx);
 PR_EXTERN(void)
 JS_MaybeGC(JSContext *cx);
 
+/*
+ * Set the most microseconds that one GC call may spend marking, and return
+ * the old budget.  A non-zero budget makes marking incremental: it proceeds
+ * in slices interleaved with allocation and JS_MaybeGC calls.  The default
+ * budget, 0, stops the world for the whole collection.
+ */
+PR_EXTERN(uint32)
+JS_SetGCSliceBudget(JSRuntime *rt, uint32 usec);
+
 /************************************************************************/
 
 /*
@@ -508,6 +533,15 @@ JS_CompileUCScriptForPrincipals(JSContext *cx, JSObject *obj,
 #ifdef JSFILE
 PR_EXTERN(JSScript *)
 JS_CompileFile(JSContext *cx, JSObject *obj, const char *filename);
+
+/*
+ * Keep compiled scripts in dirname, or stop if it's null.  Scripts compiled
+ * from files or while no script is running, without principals, are saved
+ * there, and later compilations of the same source decode them instead of
+ * parsing it again.  Return false if out of memory.
+ */
+PR_EXTERN(JSBool)
+JS_SetScriptCacheDir(JSRuntime *rt, const char *dirname);
 #endif
 
 PR_EXTERN(void)
@@ -596,6 +630,23 @@ JS_SetBranchCallback(JSContext *cx, JSBranchCallback cb);
 PR_EXTERN(JSBool)
 JS_IsRunning(JSContext *cx);
 
+/*
+ * Turn the template JIT on or off for scripts that cx runs from now on, and
+ * return the old setting.  Where there is no JIT, it stays off.
+ */
+PR_EXTERN(JSBool)
+JS_SetJITEnabled(JSContext *cx, JSBool enabled);
+
+/*
+ * Turn lazy compilation on or off for scripts that cx compiles from now on,
+ * and return the old setting.  When it is on, the body of each function that
+ * a script defines is checked for syntax errors and saved as source, and
+ * compiled the first time the function is called (or decompiled, or its
+ * script is asked for).
+ */
+PR_EXTERN(JSBool)
+JS_SetLazyCompile(JSContext *cx, JSBool lazy);
+
 /************************************************************************/
 
 /*
@@ -89,11 +89,361 @@ SetLengthProperty(JSContext *cx, JSObject *obj, jsint length)
 			  &v);
 }
 
+/*
+ * Dense element vector sizing.  A set may grow the vector to at most twice
+ * its capacity plus ARRAY_MAX_GAP; a set any further out would leave a hole
+ * too large to be worth storing, so it converts the array to sparse form.
+ */
+#define ARRAY_MIN_CAPACITY      8       /* smallest non-empty vector */
+#define ARRAY_MAX_GAP           64      /* largest growth beyond doubling */
+#define ARRAY_PREALLOC_MAX      65536   /* largest new Array(n) vector */
+
+/*
+ * Threads loading elements hold only obj's scope lock (js_LoadDenseElement),
+ * so move the vector under it, with realloc rather than JS_realloc, which may
+ * run the GC.
+ */
+static JSBool
+ResizeElements(JSContext *cx, JSObject *obj, jsuint capacity)
+{
+    JSArrayElements *elems;
+    jsuint i, oldcap;
+    JSBool ok;
+
+    if (capacity > ((size_t)-1 - sizeof *elems) / sizeof(jsval))
+	return JS_FALSE;
+    ok = JS_TRUE;
+    JS_LOCK_OBJ(cx, obj);
+    elems = ARRAY_ELEMENTS(obj);
+    oldcap = elems ? elems->capacity : 0;
+    if (capacity == 0) {
+	if (elems)
+	    free(elems);
+	obj->slots[JSSLOT_PRIVATE] = PRIVATE_TO_JSVAL(NULL);
+    } else {
+	elems = realloc(elems, sizeof *elems + (capacity - 1) * sizeof(jsval));
+	if (elems) {
+	    for (i = oldcap; i < capacity; i++)
+		elems->vector[i] = JSVAL_HOLE;
+	    elems->capacity = capacity;
+	    obj->slots[JSSLOT_PRIVATE] = PRIVATE_TO_JSVAL(elems);
+	} else {
+	    ok = JS_FALSE;
+	}
+    }
+    JS_UNLOCK_OBJ(cx, obj);
+    return ok;
+}
+
+static JSBool
+GrowElements(JSContext *cx, JSObject *obj, jsuint index)
+{
+    JSArrayElements *elems;
+    jsuint oldcap, newcap;
+
+    elems = ARRAY_ELEMENTS(obj);
+    oldcap = elems ? elems->capacity : 0;
+    if (index >= 2 * oldcap + ARRAY_MAX_GAP)
+	return JS_FALSE;
+    newcap = 2 * oldcap;
+    if (newcap < ARRAY_MIN_CAPACITY)
+	newcap = ARRAY_MIN_CAPACITY;
+    if (newcap <= index)
+	newcap = index + 1;
+    return ResizeElements(cx, obj, newcap);
+}
+
+/*
+ * Return true if a prototype of obj might have an index property, in which
+ * case a missing element of obj must be looked up the slow way.
+ */
+static JSBool
+ProtoMayHaveElement(JSContext *cx, JSObject *obj, jsint index)
+{
+    jsval id;
+    PRHashNumber hash;
+    JSObject *proto;
+    JSScope *scope;
+
+    id = INT_TO_JSVAL(index);
+    hash = js_HashValue(id);
+    for (proto = OBJ_GET_PROTO(obj); proto; proto = OBJ_GET_PROTO(proto)) {
+	scope = (JSScope *)proto->map;
+	if (scope->map.clasp->resolve != JS_ResolveStub ||
+	    OBJ_IS_DENSE_ARRAY(proto) ||
+	    scope->ops->lookup(cx, scope, id, hash)) {
+	    return JS_TRUE;
+	}
+    }
+    return JS_FALSE;
+}
+
+/*
+ * Emulate js_SetProperty's overloaded assign() hack for an element whose old
+ * value is assignobj.  Return true if assign consumed the new value in *vp.
+ */
+static JSBool
+CallAssignHack(JSContext *cx, JSObject *assignobj, jsval *vp)
+{
+    JSErrorReporter older;
+    jsval aval, rval;
+    JSBool hit;
+
+    older = JS_SetErrorReporter(cx, NULL);
+    hit = js_GetProperty(cx, assignobj,
+			 (jsval)cx->runtime->atomState.assignAtom, &aval) &&
+	  JSVAL_IS_FUNCTION(aval) &&
+	  js_Call(cx, assignobj, aval, 1, vp, &rval);
+    if (hit)
+	*vp = rval;
+    JS_SetErrorReporter(cx, older);
+    return hit;
+}
+
+JSBool
+js_MakeArraySlow(JSContext *cx, JSObject *obj)
+{
+    JSArrayElements *elems;
+    JSScope *scope;
+    JSProperty **oldtail, *lenprop, *first, *last;
+    jsuint i;
+    jsval v;
+
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    PR_ASSERT(OBJ_IS_DENSE_ARRAY(obj));
+    JS_LOCK_OBJ(cx, obj);
+    elems = ARRAY_ELEMENTS(obj);
+    obj->slots[JSSLOT_PRIVATE] = JSVAL_VOID;
+    JS_UNLOCK_OBJ(cx, obj);
+    if (!elems)
+	return JS_TRUE;
+    scope = (JSScope *)obj->map;
+    oldtail = scope->proptail;
+    last = NULL;
+    for (i = 0; i < elems->capacity; i++) {
+	v = elems->vector[i];
+	if (v == JSVAL_HOLE)
+	    continue;
+	last = js_DefineProperty(cx, obj, INT_TO_JSVAL((jsint)i), v,
+				 JS_PropertyStub, JS_PropertyStub,
+				 JSPROP_ENUMERATE);
+	if (!last) {
+	    free(elems);
+	    return JS_FALSE;
+	}
+    }
+    free(elems);
+
+    /*
+     * A sparse array lists its elements, which are usually set before any
+     * named properties, right after length.  Move them there so for/in
+     * order doesn't depend on when the array went sparse.
+     */
+    lenprop = scope->map.props;
+    first = *oldtail;
+    if (last && (JSScope *)obj->map == scope &&
+	lenprop->slot == JSSLOT_ARRAY_LENGTH && lenprop->next != first) {
+	*oldtail = NULL;
+	scope->proptail = oldtail;
+	last->next = lenprop->next;
+	last->next->prevp = &last->next;
+	lenprop->next = first;
+	first->prevp = &lenprop->next;
+    }
+    return JS_TRUE;
+}
+
+JSBool
+js_GetDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
+{
+    JSArrayElements *elems;
+    jsval v, lenval;
+
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    if (index < 0 || !OBJ_IS_DENSE_ARRAY(obj))
+	return JS_FALSE;
+    elems = ARRAY_ELEMENTS(obj);
+    if (elems && (jsuint)index < elems->capacity) {
+	v = elems->vector[index];
+	if (v != JSVAL_HOLE) {
+	    *vp = v;
+	    return JS_TRUE;
+	}
+    }
+    if (ProtoMayHaveElement(cx, obj, index))
+	return JS_FALSE;
+
+    /*
+     * Getting a missing property defines it, so a get past the end of a
+     * sparse array extends length.  Do likewise without making an element.
+     */
+    lenval = obj->slots[JSSLOT_ARRAY_LENGTH];
+    if (!JSVAL_IS_INT(lenval) || index >= JSVAL_INT_MAX)
+	return JS_FALSE;
+    if (index >= JSVAL_TO_INT(lenval))
+	obj->slots[JSSLOT_ARRAY_LENGTH] = INT_TO_JSVAL(index + 1);
+#if JS_BUG_NULL_INDEX_PROPS
+    *vp = JSVAL_NULL;
+#else
+    *vp = JSVAL_VOID;
+#endif
+    return JS_TRUE;
+}
+
+JSBool
+js_SetDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
+{
+    JSArrayElements *elems;
+    jsval pval, lenval;
+
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    if (index < 0 || index >= JSVAL_INT_MAX || !OBJ_IS_DENSE_ARRAY(obj))
+	return JS_FALSE;
+    lenval = obj->slots[JSSLOT_ARRAY_LENGTH];
+    if (!JSVAL_IS_INT(lenval))
+	return JS_FALSE;
+    elems = ARRAY_ELEMENTS(obj);
+    pval = (elems && (jsuint)index < elems->capacity)
+	   ? elems->vector[index]
+	   : JSVAL_HOLE;
+    if (pval == JSVAL_HOLE) {
+	/* A new element would inherit a prototype property's attributes. */
+	if (ProtoMayHaveElement(cx, obj, index))
+	    return JS_FALSE;
+	if (!elems || (jsuint)index >= elems->capacity) {
+	    if (!GrowElements(cx, obj, (jsuint)index))
+		return JS_FALSE;
+	    elems = ARRAY_ELEMENTS(obj);
+	}
+    } else if (JSVAL_IS_OBJECT(pval) && pval != JSVAL_NULL) {
+	if (CallAssignHack(cx, JSVAL_TO_OBJECT(pval), vp))
+	    return JS_TRUE;
+
+	/* Getting assign could have run a getter that changed obj. */
+	if (!OBJ_IS_DENSE_ARRAY(obj))
+	    return JS_FALSE;
+	lenval = obj->slots[JSSLOT_ARRAY_LENGTH];
+	elems = ARRAY_ELEMENTS(obj);
+	if (!JSVAL_IS_INT(lenval) ||
+	    !elems || (jsuint)index >= elems->capacity) {
+	    return JS_FALSE;
+	}
+	pval = elems->vector[index];
+    }
+    GC_POKE(cx, pval);
+    GC_WRITE_BARRIER(cx, obj, *vp);
+    elems->vector[index] = *vp;
+    if (index >= JSVAL_TO_INT(lenval))
+	obj->slots[JSSLOT_ARRAY_LENGTH] = INT_TO_JSVAL(index + 1);
+    return JS_TRUE;
+}
+
+JSBool
+js_LoadDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
+{
+    JSScope *scope;
+    JSArrayElements *elems;
+    jsval v;
+    JSBool ok;
+
+    if (index < 0)
+	return JS_FALSE;
+    ok = JS_FALSE;
+    scope = (JSScope *)obj->map;
+    JS_LOCK_SCOPE(cx, scope);
+    if (obj->map == &scope->map && OBJ_IS_DENSE_ARRAY(obj)) {
+	elems = ARRAY_ELEMENTS(obj);
+	if (elems && (jsuint)index < elems->capacity) {
+	    v = elems->vector[index];
+	    if (v != JSVAL_HOLE) {
+		*vp = v;
+		ok = JS_TRUE;
+	    }
+	}
+    }
+    JS_UNLOCK_SCOPE(cx, scope);
+    return ok;
+}
+
+JSBool
+js_StoreDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
+{
+    JSScope *scope;
+    JSArrayElements *elems;
+    jsval pval;
+    JSBool ok;
+
+    if (index < 0)
+	return JS_FALSE;
+    GC_WRITE_BARRIER(cx, obj, *vp);
+    ok = JS_FALSE;
+    pval = JSVAL_VOID;
+    scope = (JSScope *)obj->map;
+    JS_LOCK_SCOPE(cx, scope);
+    if (obj->map == &scope->map && OBJ_IS_DENSE_ARRAY(obj) &&
+	!GC_NEEDS_BARRIER(cx, obj, *vp)) {
+	elems = ARRAY_ELEMENTS(obj);
+	if (elems && (jsuint)index < elems->capacity) {
+	    /* Filling a hole or assigning to an object takes the lock. */
+	    pval = elems->vector[index];
+	    if (pval != JSVAL_HOLE &&
+		(!JSVAL_IS_OBJECT(pval) || pval == JSVAL_NULL)) {
+		elems->vector[index] = *vp;
+		ok = JS_TRUE;
+	    }
+	}
+    }
+    JS_UNLOCK_SCOPE(cx, scope);
+    if (ok && JSVAL_IS_GCTHING(pval))
+	GC_POKE(cx, pval);
+    return ok;
+}
+
+JSBool
+js_GetArrayElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
+{
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    if (js_GetDenseElement(cx, obj, index, vp))
+	return JS_TRUE;
+    return js_GetProperty(cx, obj, INT_TO_JSVAL(index), vp) != NULL;
+}
+
+JSBool
+js_SetArrayElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp)
+{
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    if (js_SetDenseElement(cx, obj, index, vp))
+	return JS_TRUE;
+    return js_SetProperty(cx, obj, INT_TO_JSVAL(index), vp) != NULL;
+}
+
+/*
+ * Delete obj[index] for pop and shift, which set length themselves.
+ */
+static JSBool
+DeleteArrayElement(JSContext *cx, JSObject *obj, jsint index)
+{
+    JSArrayElements *elems;
+    jsval junk;
+
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    if (OBJ_IS_DENSE_ARRAY(obj) && !ProtoMayHaveElement(cx, obj, index)) {
+	elems = ARRAY_ELEMENTS(obj);
+	if (elems && (jsuint)index < elems->capacity) {
+	    GC_POKE(cx, elems->vector[index]);
+	    elems->vector[index] = JSVAL_HOLE;
+	}
+	return JS_TRUE;
+    }
+    return js_DeleteProperty(cx, obj, INT_TO_JSVAL(index), &junk);
+}
+
 static JSBool
 array_length_setter(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 {
     JSBool ok;
     jsint newlen, oldlen, slot;
+    JSArrayElements *elems;
     jsval junk;
 
     JS_LOCK(cx);
@@ -104,6 +454,21 @@ array_length_setter(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 	ok = JS_FALSE;
 	goto out;
     }
+    if (OBJ_IS_DENSE_ARRAY(obj)) {
+	/* Truncate the vector, shrinking it if it's now mostly empty. */
+	elems = ARRAY_ELEMENTS(obj);
+	if (!elems || newlen >= oldlen || (jsuint)newlen >= elems->capacity)
+	    goto out;
+	if ((jsuint)oldlen > elems->capacity)
+	    oldlen = (jsint)elems->capacity;
+	for (slot = newlen; slot < oldlen; slot++) {
+	    GC_POKE(cx, elems->vector[slot]);
+	    elems->vector[slot] = JSVAL_HOLE;
+	}
+	if ((jsuint)newlen <= elems->capacity / 4)
+	    (void) ResizeElements(cx, obj, (jsuint)newlen);
+	goto out;
+    }
     for (slot = newlen; slot < oldlen; slot++) {
 	ok = js_DeleteProperty(cx, obj, INT_TO_JSVAL(slot), &junk);
 	if (!ok)
@@ -179,11 +544,30 @@ array_convert(JSContext *cx, JSObject *obj, JSType type, jsval *vp)
     }
 }
 
+static JSBool
+array_enumerate(JSContext *cx, JSObject *obj)
+{
+    JSBool ok;
+
+    /* Enumeration walks scope properties, so turn elements into them. */
+    JS_LOCK(cx);
+    ok = !OBJ_IS_DENSE_ARRAY(obj) || js_MakeArraySlow(cx, obj);
+    JS_UNLOCK(cx);
+    return ok;
+}
+
+static void
+array_finalize(JSContext *cx, JSObject *obj)
+{
+    if (obj->slots && OBJ_IS_DENSE_ARRAY(obj) && ARRAY_ELEMENTS(obj))
+	free(ARRAY_ELEMENTS(obj));
+}
+
 JSClass js_ArrayClass = {
     "Array",
-    0,
+    JSCLASS_HAS_PRIVATE,
     array_addProperty, array_delProperty, JS_PropertyStub,   JS_PropertyStub,
-    JS_EnumerateStub,  JS_ResolveStub,    array_convert,     JS_FinalizeStub
+    array_enumerate,   JS_ResolveStub,    array_convert,     array_finalize
 };
 
 static JSBool
@@ -255,7 +639,7 @@ array_join_sub(JSContext *cx, JSObject *obj, JSString *sep, JSBool literalize,
 
     v = JSVAL_NULL;
     for (index = 0; index < length; index++) {
-	ok = JS_GetElement(cx, obj, index, &v);
+	ok = js_GetArrayElement(cx, obj, index, &v);
 	if (!ok)
 	    goto done;
 
@@ -401,16 +785,47 @@ array_nyi(JSContext *cx, const char *what)
 static JSBool
 InitArrayObject(JSContext *cx, JSObject *obj, jsint length, jsval *vector)
 {
+    JSBool fresh;
+    JSProperty *prop;
     jsint index;
+    jsuint capacity;
 
     PR_ASSERT(JS_IS_LOCKED(cx));
-    if (!js_DefineProperty(cx, obj,
-			   (jsval)cx->runtime->atomState.lengthAtom,
-			   INT_TO_JSVAL(length),
-			   JS_PropertyStub, array_length_setter,
-			   JSPROP_PERMANENT)) {
+
+#if !JS_BUG_AUTO_INDEX_PROPS
+    /* Only an array with no properties of its own yet can start dense. */
+    fresh = (obj->map->clasp == &js_ArrayClass &&
+	     obj->slots[JSSLOT_PRIVATE] == JSVAL_VOID &&
+	     ((JSScope *)obj->map)->object != obj);
+#endif
+    prop = js_DefineProperty(cx, obj,
+			     (jsval)cx->runtime->atomState.lengthAtom,
+			     INT_TO_JSVAL(length),
+			     JS_PropertyStub, array_length_setter,
+			     JSPROP_PERMANENT);
+    if (!prop)
 	return JS_FALSE;
+#if !JS_BUG_AUTO_INDEX_PROPS
+    if (fresh && prop->object == obj && prop->slot == JSSLOT_ARRAY_LENGTH) {
+	obj->slots[JSSLOT_PRIVATE] = PRIVATE_TO_JSVAL(NULL);
+	capacity = (jsuint)length;
+	if (!vector && capacity > ARRAY_PREALLOC_MAX)
+	    capacity = 0;
+	if (!ResizeElements(cx, obj, capacity)) {
+	    if (!vector)
+		return JS_TRUE;
+	    JS_ReportOutOfMemory(cx);
+	    return JS_FALSE;
+	}
+	if (vector) {
+	    for (index = 0; index < length; index++) {
+		GC_WRITE_BARRIER(cx, obj, vector[index]);
+		ARRAY_ELEMENTS(obj)->vector[index] = vector[index];
+	    }
+	}
+	return JS_TRUE;
     }
+#endif
     if (!vector)
 	return JS_TRUE;
     for (index = 0; index < length; index++) {
@@ -423,22 +838,70 @@ InitArrayObject(JSContext *cx, JSObject *obj, jsint length, jsval *vector)
     return JS_TRUE;
 }
 
+/*
+ * Make dense array obj's vector hold at least its first len elements, with
+ * undefined in place of any holes, and return it in *vecp.
+ */
+static JSBool
+DenseElementsVector(JSContext *cx, JSObject *obj, jsint len, jsval **vecp)
+{
+    JSArrayElements *elems;
+    jsval *vec;
+    jsint i;
+
+    elems = ARRAY_ELEMENTS(obj);
+    if (len > 0 && (!elems || (jsuint)len > elems->capacity)) {
+	if (!ResizeElements(cx, obj, (jsuint)len)) {
+	    JS_ReportOutOfMemory(cx);
+	    return JS_FALSE;
+	}
+	elems = ARRAY_ELEMENTS(obj);
+    }
+    vec = elems ? elems->vector : NULL;
+    for (i = 0; i < len; i++) {
+	if (vec[i] == JSVAL_HOLE)
+	    vec[i] = JSVAL_VOID;
+    }
+    *vecp = vec;
+    return JS_TRUE;
+}
+
 static JSBool
 array_reverse(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
 	      jsval *rval)
 {
-    jsint len, i;
-    jsval *vec, *vp;
+    jsint len, i, j;
+    jsval *vec, *vp, v;
     JSBool ok;
     JSProperty *prop;
 
     JS_LOCK(cx);
-    if (!GetLengthProperty(cx, obj, &len) ||
-	!(vec = JS_malloc(cx, (size_t) len * sizeof *vec))) {
+    if (!GetLengthProperty(cx, obj, &len)) {
 	ok = JS_FALSE;
 	goto out;
     }
 
+    /* Reverse a dense array in place, defining holes as undefined. */
+    if (OBJ_IS_DENSE_ARRAY(obj)) {
+	if (!DenseElementsVector(cx, obj, len, &vec)) {
+	    ok = JS_FALSE;
+	    goto out;
+	}
+	for (i = 0, j = len - 1; i < j; i++, j--) {
+	    v = vec[i];
+	    vec[i] = vec[j];
+	    vec[j] = v;
+	}
+	*rval = OBJECT_TO_JSVAL(obj);
+	ok = JS_TRUE;
+	goto out;
+    }
+
+    vec = JS_malloc(cx, (size_t) len * sizeof *vec);
+    if (!vec) {
+	ok = JS_FALSE;
+	goto out;
+    }
     for (i = 0; i < len; i++)
 	vec[i] = JSVAL_VOID;
     for (prop = obj->map->props; prop; prop = prop->next) {
@@ -459,67 +922,90 @@ out:
     return ok;
 }
 
-typedef struct QSortArgs {
-    void         *vec;
-    size_t       elsize;
-    void         *pivot;
-    JSComparator cmp;
-    void         *arg;
-} QSortArgs;
+/*
+ * Insertion-sort runs of this many elements, then merge them pairwise.  The
+ * merge skips runs already in order, so sorted input takes linear time.
+ */
+#define MERGE_SORT_RUN  8
 
-static void
-js_qsort_r(QSortArgs *qa, int lo, int hi)
+#define COPY_ELEMENT(dst, src, elsize)                                        \
+    ((elsize) == sizeof(jsval)                                                \
+     ? (void)(*(jsval *)(dst) = *(const jsval *)(src))                       \
+     : (void)memcpy(dst, src, elsize))
+
+PRBool
+js_MergeSort(void *vec, size_t nel, size_t elsize, JSComparator cmp,
+	     void *arg)
 {
-    void *pivot, *a, *b;
-    int i, j;
-
-    pivot = qa->pivot;
-    while (lo < hi) {
-	i = lo;
-	j = hi;
-	a = (char *)qa->vec + i * qa->elsize;
-	memmove(pivot, a, qa->elsize);
-	while (i < j) {
-	    for (;;) {
-		b = (char *)qa->vec + j * qa->elsize;
-		if ((*qa->cmp)(b, pivot, qa->arg) <= 0)
+    char *tmp, *src, *dst, *a, *b, *t;
+    size_t lo, mid, hi, i, j, run;
+
+    if (nel < 2)
+	return PR_TRUE;
+    if (nel > (size_t)-1 / elsize)
+	return PR_FALSE;
+    tmp = malloc(nel * elsize);
+    if (!tmp)
+	return PR_FALSE;
+
+    /* Insertion-sort each run, using tmp to hold the element being placed. */
+    src = vec;
+    for (lo = 0; lo < nel; lo += MERGE_SORT_RUN) {
+	hi = PR_MIN(lo + MERGE_SORT_RUN, nel);
+	for (i = lo + 1; i < hi; i++) {
+	    a = src + i * elsize;
+	    if ((*cmp)(a - elsize, a, arg) <= 0)
+		continue;
+	    COPY_ELEMENT(tmp, a, elsize);
+	    for (j = i; j > lo; j--) {
+		b = src + (j - 1) * elsize;
+		if ((*cmp)(b, tmp, arg) <= 0)
 		    break;
-		j--;
-	    }
-	    memmove(a, b, qa->elsize);
-	    while (i < j && (*qa->cmp)(a, pivot, qa->arg) <= 0) {
-		i++;
-		a = (char *)qa->vec + i * qa->elsize;
+		COPY_ELEMENT(b + elsize, b, elsize);
 	    }
-	    memmove(b, a, qa->elsize);
-	}
-	memmove(a, pivot, qa->elsize);
-	if (i - lo < hi - i) {
-	    js_qsort_r(qa, lo, i - 1);
-	    lo = i + 1;
-	} else {
-	    js_qsort_r(qa, i + 1, hi);
-	    hi = i - 1;
+	    COPY_ELEMENT(src + j * elsize, tmp, elsize);
 	}
     }
-}
 
-PRBool
-js_qsort(void *vec, size_t nel, size_t elsize, JSComparator cmp, void *arg)
-{
-    void *pivot;
-    QSortArgs qa;
-
-    pivot = malloc(elsize);
-    if (!pivot)
-	return PR_FALSE;
-    qa.vec = vec;
-    qa.elsize = elsize;
-    qa.pivot = pivot;
-    qa.cmp = cmp;
-    qa.arg = arg;
-    js_qsort_r(&qa, 0, (int)(nel - 1));
-    free(pivot);
+    /* Merge runs of doubling size, ping-ponging between vec and tmp. */
+    dst = tmp;
+    for (run = MERGE_SORT_RUN; run < nel; run *= 2) {
+	for (lo = 0; lo < nel; lo = hi) {
+	    mid = PR_MIN(lo + run, nel);
+	    hi = PR_MIN(mid + run, nel);
+	    a = src + (mid - 1) * elsize;
+	    if (mid == hi || (*cmp)(a, a + elsize, arg) <= 0) {
+		memcpy(dst + lo * elsize, src + lo * elsize,
+		       (hi - lo) * elsize);
+		continue;
+	    }
+	    i = lo;
+	    j = mid;
+	    t = dst + lo * elsize;
+	    while (i < mid && j < hi) {
+		a = src + i * elsize;
+		b = src + j * elsize;
+		if ((*cmp)(a, b, arg) <= 0) {
+		    COPY_ELEMENT(t, a, elsize);
+		    i++;
+		} else {
+		    COPY_ELEMENT(t, b, elsize);
+		    j++;
+		}
+		t += elsize;
+	    }
+	    if (i < mid)
+		memcpy(t, src + i * elsize, (mid - i) * elsize);
+	    else
+		memcpy(t, src + j * elsize, (hi - j) * elsize);
+	}
+	t = src;
+	src = dst;
+	dst = t;
+    }
+    if (src != vec)
+	memcpy(vec, src, nel * elsize);
+    free(tmp);
     return PR_TRUE;
 }
 
@@ -529,42 +1015,174 @@ typedef struct CompareArgs {
     JSBool     status;
 } CompareArgs;
 
+/* Call the comparison function, stopping at its first error. */
 static int
 sort_compare(const void *a, const void *b, void *arg)
 {
     const jsval *avp = a, *bvp = b;
     CompareArgs *ca = arg;
     JSContext *cx = ca->context;
-    jsdouble cmp = -1;
+    jsdouble cmp = 0;
     jsval fval, argv[2], rval;
     JSBool ok;
 
+    if (!ca->status)
+	return 0;
     fval = ca->fval;
-    if (fval == JSVAL_NULL) {
-	JSString *astr, *bstr;
-
-	if (*avp == *bvp) {
-	    cmp = 0;
-	} else if (*avp == JSVAL_VOID || *bvp == JSVAL_VOID) {
-	    /* Put undefined properties at the end. */
-	    cmp = (*avp == JSVAL_VOID) ? 1 : -1;
-	} else if ((astr = js_ValueToString(cx, *avp)) &&
-		   (bstr = js_ValueToString(cx, *bvp))) {
-	    cmp = js_CompareStrings(astr, bstr);
+    argv[0] = *avp;
+    argv[1] = *bvp;
+    ok = js_Call(cx, OBJ_GET_PARENT(JSVAL_TO_OBJECT(fval)), fval, 2, argv,
+		 &rval);
+    if (ok)
+	ok = js_ValueToNumber(cx, rval, &cmp);
+    if (!ok) {
+	ca->status = ok;
+	return 0;
+    }
+    return (cmp < 0) ? -1 : (cmp > 0) ? 1 : 0;
+}
+
+static const jsuint powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static int
+DecimalDigits(jsuint u)
+{
+    int n;
+
+    for (n = 1; n < 10 && u >= powers_of_ten[n]; n++)
+	;
+    return n;
+}
+
+/*
+ * Compare two ints as the default comparator would compare their decimal
+ * strings, without making the strings.
+ */
+static int
+sort_compare_ints(const void *a, const void *b, void *arg)
+{
+    jsint i = JSVAL_TO_INT(*(const jsval *)a);
+    jsint j = JSVAL_TO_INT(*(const jsval *)b);
+    jsuint u, v;
+    int m, n;
+
+    if (i == j)
+	return 0;
+    if ((i < 0) != (j < 0))
+	return (i < 0) ? -1 : 1;        /* '-' sorts before any digit */
+    u = (i < 0) ? (jsuint)-i : (jsuint)i;
+    v = (j < 0) ? (jsuint)-j : (jsuint)j;
+
+    /* Cut the longer number to the shorter's length; a prefix sorts first. */
+    m = DecimalDigits(u);
+    n = DecimalDigits(v);
+    if (m < n)
+	return (u <= v / powers_of_ten[n - m]) ? -1 : 1;
+    if (m > n)
+	return (u / powers_of_ten[m - n] < v) ? -1 : 1;
+    return (u < v) ? -1 : 1;
+}
+
+static int
+sort_compare_strings(const void *a, const void *b, void *arg)
+{
+    return js_CompareStrings(JSVAL_TO_STRING(*(const jsval *)a),
+			     JSVAL_TO_STRING(*(const jsval *)b));
+}
+
+typedef struct SortKey {
+    JSString    *str;
+    jsval       value;
+} SortKey;
+
+static int
+sort_compare_keys(const void *a, const void *b, void *arg)
+{
+    return js_CompareStrings(((const SortKey *)a)->str,
+			     ((const SortKey *)b)->str);
+}
+
+/*
+ * Sort vec as the default comparator does: by string value, with undefined
+ * last.  Ints and strings are compared as they are; any other values are
+ * converted to strings once, before sorting, and the strings are kept alive
+ * in a rooted array since converting an object can run a GC.
+ */
+static JSBool
+SortByStrings(JSContext *cx, jsval *vec, jsint len)
+{
+    jsint i, n;
+    jsval v;
+    JSBool ints, strings, ok;
+    JSString *str;
+    SortKey *keys;
+    JSObject *holder;
+
+    ints = strings = JS_TRUE;
+    for (i = n = 0; i < len; i++) {
+	v = vec[i];
+	if (v == JSVAL_VOID)
+	    continue;
+	vec[n++] = v;
+	if (!JSVAL_IS_INT(v))
+	    ints = JS_FALSE;
+	if (!JSVAL_IS_STRING(v))
+	    strings = JS_FALSE;
+	else if (!JSSTRING_FLATTEN(cx, JSVAL_TO_STRING(v)))
+	    return JS_FALSE;
+    }
+    for (i = n; i < len; i++)
+	vec[i] = JSVAL_VOID;
+
+    if (ints || strings) {
+	if (!js_MergeSort(vec, (size_t)n, sizeof *vec,
+			  ints ? sort_compare_ints : sort_compare_strings,
+			  NULL)) {
+	    JS_ReportOutOfMemory(cx);
+	    return JS_FALSE;
+	}
+	return JS_TRUE;
+    }
+
+    keys = JS_malloc(cx, (size_t)n * sizeof *keys);
+    if (!keys)
+	return JS_FALSE;
+    holder = js_NewArrayObject(cx, 0, NULL);
+    if (!holder || !js_AddRoot(cx, &holder)) {
+	JS_free(cx, keys);
+	return JS_FALSE;
+    }
+
+    /* Root the values first, as a toString method may change the array. */
+    ok = JS_TRUE;
+    for (i = 0; ok && i < n; i++)
+	ok = js_SetArrayElement(cx, holder, i, &vec[i]);
+    for (i = 0; ok && i < n; i++) {
+	str = js_ValueToString(cx, vec[i]);
+	if (!str) {
+	    ok = JS_FALSE;
+	    break;
+	}
+	keys[i].str = str;
+	keys[i].value = vec[i];
+	v = STRING_TO_JSVAL(str);
+	ok = js_SetArrayElement(cx, holder, n + i, &v);
+    }
+    if (ok) {
+	if (js_MergeSort(keys, (size_t)n, sizeof *keys, sort_compare_keys,
+			 NULL)) {
+	    for (i = 0; i < n; i++)
+		vec[i] = keys[i].value;
 	} else {
-	    ca->status = JS_FALSE;
+	    JS_ReportOutOfMemory(cx);
+	    ok = JS_FALSE;
 	}
-    } else {
-	argv[0] = *avp;
-	argv[1] = *bvp;
-	ok = js_Call(cx, OBJ_GET_PARENT(JSVAL_TO_OBJECT(fval)), fval, 2, argv,
-		     &rval);
-	if (ok)
-	    ok = js_ValueToNumber(cx, rval, &cmp);
-	if (!ok)
-	    ca->status = ok;
     }
-    return (int)cmp;
+    js_RemoveRoot(cx, &holder);
+    JS_free(cx, keys);
+    return ok;
 }
 
 static JSBool
@@ -573,8 +1191,9 @@ array_sort(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     jsval fval;
     CompareArgs ca;
     jsint len, i;
-    jsval *vec;
+    jsval *vec, *dvec;
     JSProperty *prop;
+    JSArrayElements *elems;
 
     if (argc > 0) {
 	if (JS_TypeOfValue(cx, argv[0]) != JSTYPE_FUNCTION) {
@@ -594,26 +1213,49 @@ array_sort(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	goto out;
     }
 
-    for (i = 0; i < len; i++)
-	vec[i] = JSVAL_VOID;
-    for (prop = obj->map->props; prop; prop = prop->next) {
-	if (!(prop->flags & JSPROP_TINYIDHACK) &&
-	    JSVAL_IS_INT(prop->id) &&
-	    (jsuint)(i = JSVAL_TO_INT(prop->id)) < (jsuint)len) {
-	    vec[i] = prop->object->slots[prop->slot];
+    if (OBJ_IS_DENSE_ARRAY(obj)) {
+	if (!DenseElementsVector(cx, obj, len, &dvec)) {
+	    JS_free(cx, vec);
+	    ca.status = JS_FALSE;
+	    goto out;
+	}
+	for (i = 0; i < len; i++)
+	    vec[i] = dvec[i];
+    } else {
+	for (i = 0; i < len; i++)
+	    vec[i] = JSVAL_VOID;
+	for (prop = obj->map->props; prop; prop = prop->next) {
+	    if (!(prop->flags & JSPROP_TINYIDHACK) &&
+		JSVAL_IS_INT(prop->id) &&
+		(jsuint)(i = JSVAL_TO_INT(prop->id)) < (jsuint)len) {
+		vec[i] = prop->object->slots[prop->slot];
+	    }
 	}
     }
 
-    ca.context = cx;
-    ca.fval = fval;
-    ca.status = JS_TRUE;
-    if (!js_qsort(vec, (size_t) len, (size_t) sizeof *vec, sort_compare, &ca)) {
-	JS_ReportOutOfMemory(cx);
-	ca.status = JS_FALSE;
+    if (fval == JSVAL_NULL) {
+	ca.status = SortByStrings(cx, vec, len);
+    } else {
+	ca.context = cx;
+	ca.fval = fval;
+	ca.status = JS_TRUE;
+	if (!js_MergeSort(vec, (size_t)len, sizeof *vec, sort_compare, &ca)) {
+	    JS_ReportOutOfMemory(cx);
+	    ca.status = JS_FALSE;
+	}
     }
 
     if (ca.status) {
-	ca.status = InitArrayObject(cx, obj, len, vec);
+	/* The comparator may have changed obj, so check it again. */
+	elems = OBJ_IS_DENSE_ARRAY(obj) ? ARRAY_ELEMENTS(obj) : NULL;
+	if (elems && (jsuint)len <= elems->capacity) {
+	    for (i = 0; i < len; i++) {
+		GC_WRITE_BARRIER(cx, obj, vec[i]);
+		elems->vector[i] = vec[i];
+	    }
+	} else {
+	    ca.status = InitArrayObject(cx, obj, len, vec);
+	}
 	if (ca.status)
 	    *rval = OBJECT_TO_JSVAL(obj);
     }
@@ -673,15 +1315,13 @@ array_push(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 #if JS_HAS_MORE_PERL_FUN
     jsint length;
     uintN i;
-    jsval id;
     JSBool ok;
 
     JS_LOCK(cx);
     if (!GetLengthProperty(cx, obj, &length))
 	return JS_FALSE;
     for (i = 0; i < argc; i++) {
-	id = INT_TO_JSVAL(length + i);
-	if (!js_SetProperty(cx, obj, id, &argv[i])) {
+	if (!js_SetArrayElement(cx, obj, length + i, &argv[i])) {
 	    ok = JS_FALSE;
 	    goto out;
 	}
@@ -710,8 +1350,6 @@ array_pop(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 #if JS_HAS_MORE_PERL_FUN
     jsint index;
     JSBool ok;
-    jsval id, junk;
-    JSProperty *prop;
 
     JS_LOCK(cx);
     if (!GetLengthProperty(cx, obj, &index)) {
@@ -720,16 +1358,13 @@ array_pop(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	ok = JS_TRUE;
     } else {
 	index--;
-	id = INT_TO_JSVAL(index);
 
-	/* Get the to-be-deleted property's value into rval ASAP. */
-	prop = js_GetProperty(cx, obj, id, rval);
-	if (!prop) {
-	    ok = JS_FALSE;
+	/* Get the to-be-deleted element's value into rval ASAP. */
+	ok = js_GetArrayElement(cx, obj, index, rval);
+	if (!ok)
 	    goto out;
-	}
 
-	ok = js_DeleteProperty2(cx, obj, prop, id, &junk);
+	ok = DeleteArrayElement(cx, obj, index);
 	if (!ok)
 	    goto out;
 	if (!SetLengthProperty(cx, obj, index))
@@ -749,8 +1384,7 @@ array_shift(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 #if JS_HAS_MORE_PERL_FUN
     jsint length, i;
     JSBool ok;
-    jsval id, id2, v, junk;
-    JSProperty *prop;
+    jsval v;
 
     JS_LOCK(cx);
     if (!GetLengthProperty(cx, obj, &length)) {
@@ -759,33 +1393,23 @@ array_shift(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	ok = JS_TRUE;
     } else {
 	length--;
-	id = JSVAL_ZERO;
 
-	/* Get the to-be-deleted property's value into rval ASAP. */
-	prop = js_GetProperty(cx, obj, id, rval);
-	if (!prop) {
-	    ok = JS_FALSE;
+	/* Get the to-be-deleted element's value into rval ASAP. */
+	ok = js_GetArrayElement(cx, obj, 0, rval);
+	if (!ok)
 	    goto out;
-	}
 
-	/*
-	 * Slide down the array above the first element.  Leave prop and
-	 * id set to point to the last element.
-	 */
-	if (length > 0) {
-	    for (i = 1; i <= length; i++) {
-		id = INT_TO_JSVAL(i);
-		id2 = INT_TO_JSVAL(i - 1);
-		prop = js_GetProperty(cx, obj, id, &v);
-		if (!prop || !js_SetProperty(cx, obj, id2, &v)) {
-		    ok = JS_FALSE;
-		    goto out;
-		}
+	/* Slide down the array above the first element. */
+	for (i = 1; i <= length; i++) {
+	    if (!js_GetArrayElement(cx, obj, i, &v) ||
+		!js_SetArrayElement(cx, obj, i - 1, &v)) {
+		ok = JS_FALSE;
+		goto out;
 	    }
 	}
 
 	/* Delete the only or last element. */
-	ok = js_DeleteProperty2(cx, obj, prop, id, &junk);
+	ok = DeleteArrayElement(cx, obj, length);
 	if (!ok)
 	    goto out;
 	if (!SetLengthProperty(cx, obj, length))
@@ -806,8 +1430,7 @@ array_unshift(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
 #if JS_HAS_MORE_PERL_FUN
     jsint length, last;
     uintN i;
-    jsval id, id2, v;
-    JSProperty *prop;
+    jsval v;
     JSBool ok;
 
     JS_LOCK(cx);
@@ -819,10 +1442,8 @@ array_unshift(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
 	/* Slide up the array to make room for argc at the bottom. */
 	if (length > 0) {
 	    for (last = length - 1; last >= 0; last--) {
-		id = INT_TO_JSVAL(last);
-		id2 = INT_TO_JSVAL(last + argc);
-		prop = js_GetProperty(cx, obj, id, &v);
-		if (!prop || !js_SetProperty(cx, obj, id2, &v)) {
+		if (!js_GetArrayElement(cx, obj, last, &v) ||
+		    !js_SetArrayElement(cx, obj, last + argc, &v)) {
 		    ok = JS_FALSE;
 		    goto out;
 		}
@@ -831,8 +1452,7 @@ array_unshift(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
 
 	/* Copy from argv to the bottom of the array. */
 	for (i = 0; i < argc; i++) {
-	    id = INT_TO_JSVAL(i);
-	    if (!js_SetProperty(cx, obj, id, &argv[i])) {
+	    if (!js_SetArrayElement(cx, obj, i, &argv[i])) {
 		ok = JS_FALSE;
 		goto out;
 	    }
@@ -863,9 +1483,8 @@ array_splice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     uintN i;
     JSBool ok;
     jsdouble d;
-    jsval id, id2, v;
+    jsval v;
     JSObject *obj2;
-    JSProperty *prop;
 
     /* Nothing to do if no args.  Otherwise lock and load length. */
     if (argc == 0)
@@ -924,8 +1543,7 @@ array_splice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	     * in [] if necessary.  So JS1.3, default, and other versions all
 	     * return an array of length 1 for uniformity.
 	     */
-	    id = INT_TO_JSVAL(begin);
-	    if (!js_GetProperty(cx, obj, id, rval)) {
+	    if (!js_GetArrayElement(cx, obj, begin, rval)) {
 		ok = JS_FALSE;
 		goto out;
 	    }
@@ -937,10 +1555,8 @@ array_splice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	    }
 	    *rval = OBJECT_TO_JSVAL(obj2);
 	    for (last = begin; last < end; last++) {
-		id = INT_TO_JSVAL(last);
-		id2 = INT_TO_JSVAL(last - begin);
-		if (!js_GetProperty(cx, obj, id, &v) ||
-		    !js_SetProperty(cx, obj2, id2, &v)) {
+		if (!js_GetArrayElement(cx, obj, last, &v) ||
+		    !js_SetArrayElement(cx, obj2, last - begin, &v)) {
 		    ok = JS_FALSE;
 		    goto out;
 		}
@@ -952,20 +1568,16 @@ array_splice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     delta = (jsint)argc - count;
     if (delta > 0) {
 	for (last = length - 1; last >= end; last--) {
-	    id = INT_TO_JSVAL(last);
-	    id2 = INT_TO_JSVAL(last + delta);
-	    prop = js_GetProperty(cx, obj, id, &v);
-	    if (!prop || !js_SetProperty(cx, obj, id2, &v)) {
+	    if (!js_GetArrayElement(cx, obj, last, &v) ||
+		!js_SetArrayElement(cx, obj, last + delta, &v)) {
 		ok = JS_FALSE;
 		goto out;
 	    }
 	}
     } else if (delta < 0) {
 	for (last = end; last < length; last++) {
-	    id = INT_TO_JSVAL(last);
-	    id2 = INT_TO_JSVAL(last + delta);
-	    prop = js_GetProperty(cx, obj, id, &v);
-	    if (!prop || !js_SetProperty(cx, obj, id2, &v)) {
+	    if (!js_GetArrayElement(cx, obj, last, &v) ||
+		!js_SetArrayElement(cx, obj, last + delta, &v)) {
 		ok = JS_FALSE;
 		goto out;
 	    }
@@ -974,8 +1586,7 @@ array_splice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 
     /* Copy from argv into the hole to complete the splice. */
     for (i = 0; i < argc; i++) {
-	id = INT_TO_JSVAL(begin + i);
-	if (!js_SetProperty(cx, obj, id, &argv[i])) {
+	if (!js_SetArrayElement(cx, obj, begin + i, &argv[i])) {
 	    ok = JS_FALSE;
 	    goto out;
 	}
@@ -1002,7 +1613,7 @@ array_concat(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     JSObject *nobj, *aobj;
     JSBool ok;
     jsint slot, length, alength;
-    jsval v, id, id2, lv, *vp;
+    jsval v, lv, *vp;
     JSProperty *prop;
     uintN i;
 
@@ -1017,9 +1628,8 @@ array_concat(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	goto out;
     }
     for (slot = 0; slot < length; slot++) {
-	id = INT_TO_JSVAL(slot);
-	prop = js_GetProperty(cx, obj, id, &v);
-	if (!prop || !js_SetProperty(cx, nobj, id, &v)) {
+	if (!js_GetArrayElement(cx, obj, slot, &v) ||
+	    !js_SetArrayElement(cx, nobj, slot, &v)) {
 	    ok = JS_FALSE;
 	    goto out;
 	}
@@ -1037,15 +1647,14 @@ array_concat(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 				  &lv);
 		if (!ok)
 		    goto out;
+		GC_WRITE_BARRIER(cx, aobj, lv);
 		*vp = lv;
 		ok = ValueToLength(cx, lv, &alength);
 		if (!ok)
 		    goto out;
 		for (slot = 0; slot < alength; slot++) {
-		    id  = INT_TO_JSVAL(slot);
-		    id2 = INT_TO_JSVAL(length + slot);
-		    prop = js_GetProperty(cx, aobj, id, &v);
-		    if (!prop || !js_SetProperty(cx, nobj, id2, &v)) {
+		    if (!js_GetArrayElement(cx, aobj, slot, &v) ||
+			!js_SetArrayElement(cx, nobj, length + slot, &v)) {
 			ok = JS_FALSE;
 			goto out;
 		    }
@@ -1055,8 +1664,7 @@ array_concat(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	    }
 	}
 
-	id = INT_TO_JSVAL(length);
-	if (!js_SetProperty(cx, nobj, id, &v)) {
+	if (!js_SetArrayElement(cx, nobj, length, &v)) {
 	    ok = JS_FALSE;
 	    goto out;
 	}
@@ -1076,8 +1684,7 @@ array_slice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     JSBool ok;
     jsint length, begin, end, slot;
     jsdouble d;
-    jsval v, id, id2;
-    JSProperty *prop;
+    jsval v;
 
     nobj = JS_NewArrayObject(cx, 0, NULL);
     if (!nobj)
@@ -1121,10 +1728,8 @@ array_slice(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     }
 
     for (slot = begin; slot < end; slot++) {
-	id  = INT_TO_JSVAL(slot);
-	id2 = INT_TO_JSVAL(slot - begin);
-	prop = js_GetProperty(cx, obj, id, &v);
-	if (!prop || !js_SetProperty(cx, nobj, id2, &v)) {
+	if (!js_GetArrayElement(cx, obj, slot, &v) ||
+	    !js_SetArrayElement(cx, nobj, slot - begin, &v)) {
 	    ok = JS_FALSE;
 	    goto out;
 	}
@@ -21,6 +21,7 @@
 /*
  * JS Array interface.
  */
+#include "jsobj.h"
 #include "jsprvtd.h"
 #include "jspubtd.h"
 
@@ -28,6 +29,38 @@ PR_BEGIN_EXTERN_C
 
 extern JSClass js_ArrayClass;
 
+/*
+ * Dense arrays.  An array made by the Array constructor, an initialiser, or
+ * js_NewArrayObject keeps its elements in a vector of jsvals hung off its
+ * private slot, rather than in one scope property per index.  Elements that
+ * were never set or were deleted hold JSVAL_HOLE, which never escapes the
+ * vector.  The length property stays an ordinary property whose value lives
+ * in slot JSSLOT_ARRAY_LENGTH, so the dense element paths can update it in
+ * place.
+ *
+ * Indexed gets and sets that the vector can satisfy go straight to it.  Any
+ * path that needs a real JSProperty for an index (js_DefineProperty,
+ * js_LookupProperty, enumeration, watchpoints) first calls js_MakeArraySlow
+ * to turn the elements into ordinary properties, after which the array stays
+ * sparse.  A set that would leave too large a hole does the same.
+ *
+ * A sparse array's private slot holds JSVAL_VOID; a dense array's holds its
+ * JSArrayElements pointer, which is null until the first element is stored.
+ */
+typedef struct JSArrayElements {
+    jsuint      capacity;               /* number of slots in vector */
+    jsval       vector[1];              /* elements, JSVAL_HOLE if missing */
+} JSArrayElements;
+
+#define JSSLOT_ARRAY_LENGTH     (JSSLOT_PRIVATE + 1)
+#define JSVAL_HOLE              BOOLEAN_TO_JSVAL(2)
+
+#define OBJ_IS_DENSE_ARRAY(obj)                                               \
+    ((obj)->map->clasp == &js_ArrayClass &&                                   \
+     (obj)->slots[JSSLOT_PRIVATE] != JSVAL_VOID)
+#define ARRAY_ELEMENTS(obj)                                                   \
+    ((JSArrayElements *)JSVAL_TO_PRIVATE((obj)->slots[JSSLOT_PRIVATE]))
+
 extern JSObject *
 js_InitArrayClass(JSContext *cx, JSObject *obj);
 
@@ -44,12 +77,54 @@ extern JSProperty *
 js_HasLengthProperty(JSContext *cx, JSObject *obj);
 
 /*
- * JS-specific qsort function.
+ * Convert dense array obj to the sparse, property-per-element form.
+ */
+extern JSBool
+js_MakeArraySlow(JSContext *cx, JSObject *obj);
+
+/*
+ * Dense element fast paths.  Each returns true if it got or set obj[index]
+ * directly, and false if obj isn't dense or the access needs the generic
+ * property path.  A false return never means an error has been reported.
+ */
+extern JSBool
+js_GetDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp);
+
+extern JSBool
+js_SetDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp);
+
+/*
+ * Like js_GetDenseElement and js_SetDenseElement, but called without the
+ * runtime lock, holding only obj's scope lock.  They handle only an element
+ * already in obj's vector: a get of a non-hole, or a set that overwrites a
+ * non-hole that isn't an object, so has no assign() hack to call.
+ */
+extern JSBool
+js_LoadDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp);
+
+extern JSBool
+js_StoreDenseElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp);
+
+/*
+ * Get or set obj[index], trying the dense fast paths before js_GetProperty
+ * and js_SetProperty.
+ */
+extern JSBool
+js_GetArrayElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp);
+
+extern JSBool
+js_SetArrayElement(JSContext *cx, JSObject *obj, jsint index, jsval *vp);
+
+/*
+ * Stable merge sort of nel elements of elsize bytes, which doesn't recurse.
+ * Returns false if out of memory for its scratch vector, leaving vec as it
+ * was.
  */
 typedef int (*JSComparator)(const void *a, const void *b, void *arg);
 
 extern PRBool
-js_qsort(void *vec, size_t nel, size_t elsize, JSComparator cmp, void *arg);
+js_MergeSort(void *vec, size_t nel, size_t elsize, JSComparator cmp,
+	     void *arg);
 
 PR_END_EXTERN_C
 
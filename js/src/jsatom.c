@@ -129,7 +129,7 @@ js_free_atom_space(void *priv, void *item)
 PR_STATIC_CALLBACK(PRHashEntry *)
 js_alloc_atom(void *priv, const void *key)
 {
-    JSAtomState *state = priv;
+    JSAtomStripe *stripe = priv;
     JSAtom *atom;
 
     atom = malloc(sizeof(JSAtom));
@@ -141,7 +141,8 @@ js_alloc_atom(void *priv, const void *key)
     atom->flags = 0;
     atom->kwindex = -1;
     atom->index = 0;
-    atom->number = state->number++;
+    atom->number = stripe->number;
+    stripe->number += ATOM_STRIPES;
     return &atom->entry;
 }
 
@@ -159,18 +160,57 @@ static PRHashAllocOps atomAllocOps = {
 
 #define JS_ATOM_HASH_SIZE   1024
 
+/* Pick a stripe by bits the stripe's own table doesn't hash on. */
+#define ATOM_STRIPE(state,keyHash)                                            \
+    (&(state)->stripes[((keyHash) ^ ((keyHash) >> 16)) & (ATOM_STRIPES - 1)])
+
+static void
+js_destroy_atom_stripes(JSAtomState *state)
+{
+    uintN i;
+    JSAtomStripe *stripe;
+
+    for (i = 0; i < ATOM_STRIPES; i++) {
+	stripe = &state->stripes[i];
+	if (stripe->table) {
+	    PR_HashTableDestroy(stripe->table);
+	    stripe->table = NULL;
+	}
+#ifdef JS_THREADSAFE
+	if (stripe->lock) {
+	    PR_DestroyLock(stripe->lock);
+	    stripe->lock = NULL;
+	}
+#endif
+    }
+}
+
 JSBool
 js_InitAtomState(JSContext *cx, JSAtomState *state)
 {
     uintN i;
-
-    state->number = 0;
-    state->table = PR_NewHashTable(JS_ATOM_HASH_SIZE, js_hash_atom_key,
-				   js_compare_atom_keys, js_compare_stub,
-				   &atomAllocOps, state);
-    if (!state->table) {
-	JS_ReportOutOfMemory(cx);
-	return JS_FALSE;
+    JSAtomStripe *stripe;
+
+    for (i = 0; i < ATOM_STRIPES; i++) {
+	stripe = &state->stripes[i];
+	stripe->number = (jsatomid)i;
+	stripe->table = PR_NewHashTable(JS_ATOM_HASH_SIZE / ATOM_STRIPES,
+					js_hash_atom_key,
+					js_compare_atom_keys, js_compare_stub,
+					&atomAllocOps, stripe);
+#ifdef JS_THREADSAFE
+	stripe->lock = PR_NewLock();
+	if (!stripe->lock) {
+	    js_destroy_atom_stripes(state);
+	    JS_ReportOutOfMemory(cx);
+	    return JS_FALSE;
+	}
+#endif
+	if (!stripe->table) {
+	    js_destroy_atom_stripes(state);
+	    JS_ReportOutOfMemory(cx);
+	    return JS_FALSE;
+	}
     }
 
 #define FROB(lval,str) {                                                      \
@@ -223,15 +263,15 @@ js_atom_key_zapper(PRHashEntry *he, intN i, void *arg)
 void
 js_FreeAtomState(JSContext *cx, JSAtomState *state)
 {
-    PRHashTable *table;
+    uintN i;
 
     js_ForceGC(cx);
-    table = state->table;
-    PR_HashTableEnumerateEntries(table, js_atom_key_zapper, NULL);
+    for (i = 0; i < ATOM_STRIPES; i++) {
+	PR_HashTableEnumerateEntries(state->stripes[i].table,
+				     js_atom_key_zapper, NULL);
+    }
     js_ForceGC(cx);
-    PR_HashTableDestroy(table);
-    state->table = NULL;
-    state->number = 0;
+    js_destroy_atom_stripes(state);
 }
 
 typedef struct MarkAtomArgs {
@@ -266,45 +306,58 @@ js_atom_key_marker(PRHashEntry *he, intN i, void *arg)
 void
 js_MarkAtomState(JSRuntime *rt, JSAtomMarker mark)
 {
-    PRHashTable *table;
+    uintN i;
+    JSAtomStripe *stripe;
     MarkAtomArgs args;
 
-    table = rt->atomState.table;
-    if (!table)
-	return;
     args.runtime = rt;
     args.mark = mark;
-    PR_HashTableEnumerateEntries(table, js_atom_key_marker, &args);
+    for (i = 0; i < ATOM_STRIPES; i++) {
+	stripe = &rt->atomState.stripes[i];
+	if (!stripe->table)
+	    continue;
+	JS_ACQUIRE_LOCK(stripe->lock);
+	PR_HashTableEnumerateEntries(stripe->table, js_atom_key_marker, &args);
+	JS_RELEASE_LOCK(stripe->lock);
+    }
 }
 
+/*
+ * Find key's atom in stripe, adding it if add is true, and hold the atom
+ * unless flags has ATOM_NOHOLD.  Return null if key isn't there and add is
+ * false, or if out of memory.
+ */
 static JSAtom *
-js_AtomizeHashedKey(JSContext *cx, jsval key, PRHashNumber keyHash, uintN flags)
+js_LookupHashedKey(JSAtomStripe *stripe, jsval key, PRHashNumber keyHash,
+		   uintN flags, JSBool add)
 {
-    PRHashTable *table;
     PRHashEntry *he, **hep;
     JSAtom *atom;
 
-    PR_ASSERT(JS_IS_LOCKED(cx));
-    table = cx->runtime->atomState.table;
-    hep = PR_HashTableRawLookup(table, keyHash, (void *)key);
-    if ((he = *hep) == NULL) {
-	he = PR_HashTableRawAdd(table, hep, keyHash, (void *)key, NULL);
-	if (!he) {
-	    JS_ReportOutOfMemory(cx);
-	    return NULL;
-	}
+    JS_ACQUIRE_LOCK(stripe->lock);
+    hep = PR_HashTableRawLookup(stripe->table, keyHash, (void *)key);
+    he = *hep;
+    if (!he && add)
+	he = PR_HashTableRawAdd(stripe->table, hep, keyHash, (void *)key, NULL);
+    atom = (JSAtom *)he;
+    if (atom && !(flags & ATOM_NOHOLD)) {
+	atom->nrefs++;
+	PR_ASSERT(atom->nrefs > 0);
     }
+    JS_RELEASE_LOCK(stripe->lock);
+    return atom;
+}
 
-    atom = (JSAtom *)he;
-#ifdef DEBUG_DUPLICATE_ATOMS
-    hep = PR_HashTableRawLookup(table, keyHash, (void *)key);
-    he = *hep;
-    PR_ASSERT(atom == (JSAtom *)he);
-#endif
+static JSAtom *
+js_AtomizeHashedKey(JSContext *cx, jsval key, PRHashNumber keyHash, uintN flags)
+{
+    JSAtom *atom;
 
-    if (flags & ATOM_NOHOLD)
-	return atom;
-    return js_HoldAtom(cx, atom);
+    atom = js_LookupHashedKey(ATOM_STRIPE(&cx->runtime->atomState, keyHash),
+			      key, keyHash, flags, JS_TRUE);
+    if (!atom)
+	JS_ReportOutOfMemory(cx);
+    return atom;
 }
 
 JSAtom *
@@ -341,14 +394,19 @@ js_AtomizeInt(JSContext *cx, jsint i, uintN flags)
     return js_AtomizeHashedKey(cx, key, keyHash, flags);
 }
 
+/*
+ * Doubles and temporary strings need a GC-allocated key before they can be
+ * added, which can't be done with a stripe locked.  So look the key up, and
+ * if it's missing, make the new key and look again, in case another thread
+ * added the same key meanwhile.
+ */
 JSAtom *
 js_AtomizeDouble(JSContext *cx, jsdouble d, uintN flags)
 {
     jsdouble *dp;
-    PRHashTable *table;
+    JSAtomStripe *stripe;
     PRHashNumber keyHash;
     jsval key;
-    PRHashEntry *he, **hep;
     JSAtom *atom;
 
 #if PR_ALIGN_OF_DOUBLE == 8
@@ -360,82 +418,62 @@ js_AtomizeDouble(JSContext *cx, jsdouble d, uintN flags)
     *dp = d;
 #endif
 
-    PR_ASSERT(JS_IS_LOCKED(cx));
-    table = cx->runtime->atomState.table;
     keyHash = HASH_DOUBLE(dp);
     key = DOUBLE_TO_JSVAL(dp);
-    hep = PR_HashTableRawLookup(table, keyHash, (void *)key);
-    if ((he = *hep) == NULL) {
-	if (!js_NewDoubleValue(cx, d, &key))
-	    return NULL;
-	he = PR_HashTableRawAdd(table, hep, keyHash, (void *)key, NULL);
-	if (!he) {
-	    JS_ReportOutOfMemory(cx);
-	    return NULL;
-	}
-    }
-
-    atom = (JSAtom *)he;
-#ifdef DEBUG_DUPLICATE_ATOMS
-    hep = PR_HashTableRawLookup(table, keyHash, (void *)key);
-    he = *hep;
-    PR_ASSERT(atom == (JSAtom *)he);
-#endif
-
-    if (flags & ATOM_NOHOLD)
+    stripe = ATOM_STRIPE(&cx->runtime->atomState, keyHash);
+    atom = js_LookupHashedKey(stripe, key, keyHash, flags, JS_FALSE);
+    if (atom)
 	return atom;
-    return js_HoldAtom(cx, atom);
+    if (!js_NewDoubleValue(cx, d, &key))
+	return NULL;
+    atom = js_LookupHashedKey(stripe, key, keyHash, flags, JS_TRUE);
+    if (!atom)
+	JS_ReportOutOfMemory(cx);
+    return atom;
 }
 
 JSAtom *
 js_AtomizeString(JSContext *cx, JSString *str, uintN flags)
 {
-    PRHashTable *table;
+    JSAtomStripe *stripe;
     PRHashNumber keyHash;
     jsval key;
-    PRHashEntry *he, **hep;
     JSAtom *atom;
 
-    PR_ASSERT(JS_IS_LOCKED(cx));
-    table = cx->runtime->atomState.table;
+    if (!JSSTRING_FLATTEN(cx, str))
+	return NULL;
     keyHash = js_HashString(str);
     key = STRING_TO_JSVAL(str);
-    hep = PR_HashTableRawLookup(table, keyHash, (void *)key);
-    if ((he = *hep) == NULL) {
-	if (flags & ATOM_TMPSTR) {
-	    if (flags & ATOM_NOCOPY)
-		str = js_NewString(cx, str->chars, str->length, 0);
-	    else
-		str = js_NewStringCopyN(cx, str->chars, str->length, 0);
-	    if (!str)
-		return NULL;
-	    key = STRING_TO_JSVAL(str);
-	}
-	he = PR_HashTableRawAdd(table, hep, keyHash, (void *)key, NULL);
-	if (!he) {
-	    JS_ReportOutOfMemory(cx);
+    stripe = ATOM_STRIPE(&cx->runtime->atomState, keyHash);
+    if (flags & ATOM_TMPSTR) {
+	atom = js_LookupHashedKey(stripe, key, keyHash, flags, JS_FALSE);
+	if (atom)
+	    return atom;
+	if (flags & ATOM_NOCOPY)
+	    str = js_NewString(cx, str->chars, str->length, 0);
+	else
+	    str = js_NewStringCopyN(cx, str->chars, str->length, 0);
+	if (!str)
 	    return NULL;
-	}
+	key = STRING_TO_JSVAL(str);
     }
-
-    atom = (JSAtom *)he;
-#ifdef DEBUG_DUPLICATE_ATOMS
-    hep = PR_HashTableRawLookup(table, keyHash, (void *)key);
-    he = *hep;
-    PR_ASSERT(atom == (JSAtom *)he);
-#endif
-
-    if (flags & ATOM_NOHOLD)
-	return atom;
-    return js_HoldAtom(cx, atom);
+    atom = js_LookupHashedKey(stripe, key, keyHash, flags, JS_TRUE);
+    if (!atom)
+	JS_ReportOutOfMemory(cx);
+    return atom;
 }
 
+/* Names shorter than this are inflated on the stack and copied if new. */
+#define ATOMIZE_INFLATE_MAX     64
+
 JS_FRIEND_API(JSAtom *)
 js_Atomize(JSContext *cx, const char *bytes, size_t length, uintN flags)
 {
     jschar *chars;
     JSString *str;
     JSAtom *atom;
+    jschar inflated[ATOMIZE_INFLATE_MAX];
+    size_t i;
 #if PR_ALIGN_OF_DOUBLE == 8
     union { jsdouble d; JSString s; } u;
 
@@ -446,6 +484,13 @@ js_Atomize(JSContext *cx, const char *bytes, size_t length, uintN flags)
     str = (JSString *)&alignbuf[8 - ((pruword)&alignbuf & 7)];
 #endif
 
+    if (length < ATOMIZE_INFLATE_MAX) {
+	for (i = 0; i < length; i++)
+	    inflated[i] = (jschar) bytes[i];
+	str->chars = inflated;
+	str->length = length;
+	return js_AtomizeString(cx, str, ATOM_TMPSTR | flags);
+    }
     chars = js_InflateString(cx, bytes, length);
     if (!chars)
 	return NULL;
@@ -515,56 +560,54 @@ js_IndexAtom(JSContext *cx, JSAtom *atom, JSAtomList *al)
     return atom->index;
 }
 
-JSAtom *
-js_HoldAtom(JSContext *cx, JSAtom *atom)
-{
 #ifdef DEBUG_DUPLICATE_ATOMS
+static void
+js_check_atom(JSAtomStripe *stripe, JSAtom *atom)
+{
     jsval key;
-    PRHashNumber keyHash;
-    PRHashEntry *he, **hep;
+    PRHashEntry **hep;
 
     key = ATOM_KEY(atom);
-    keyHash = js_hash_atom_key((void *)key);
-    hep = PR_HashTableRawLookup(cx->runtime->atomState.table, keyHash,
-				(void*)key);
-    he = *hep;
-    PR_ASSERT(atom == (JSAtom *)he);
+    hep = PR_HashTableRawLookup(stripe->table, js_hash_atom_key((void *)key),
+				(void *)key);
+    PR_ASSERT(atom == (JSAtom *)*hep);
+}
+#else
+#define js_check_atom(stripe, atom) /* nothing */
+#endif
+
+JSAtom *
+js_HoldAtom(JSContext *cx, JSAtom *atom)
+{
+#if defined JS_THREADSAFE || defined DEBUG_DUPLICATE_ATOMS
+    JSAtomStripe *stripe;
+
+    stripe = ATOM_STRIPE(&cx->runtime->atomState, atom->entry.keyHash);
 #endif
-    PR_ASSERT(JS_IS_LOCKED(cx));
+    JS_ACQUIRE_LOCK(stripe->lock);
+    js_check_atom(stripe, atom);
     atom->nrefs++;
     PR_ASSERT(atom->nrefs > 0);
+    JS_RELEASE_LOCK(stripe->lock);
     return atom;
 }
 
 JS_FRIEND_API(JSAtom *)
 js_DropAtom(JSContext *cx, JSAtom *atom)
 {
-#ifdef DEBUG_DUPLICATE_ATOMS
-    jsval key;
-    PRHashNumber keyHash;
-    PRHashEntry *he, **hep;
+    JSAtomStripe *stripe;
 
-    key = ATOM_KEY(atom);
-    keyHash = js_hash_atom_key((void *)key);
-    hep = PR_HashTableRawLookup(cx->runtime->atomState.table, keyHash,
-				(void*)key);
-    he = *hep;
-    PR_ASSERT(atom == (JSAtom *)he);
-#endif
-    PR_ASSERT(JS_IS_LOCKED(cx));
+    stripe = ATOM_STRIPE(&cx->runtime->atomState, atom->entry.keyHash);
+    JS_ACQUIRE_LOCK(stripe->lock);
+    js_check_atom(stripe, atom);
     PR_ASSERT(atom->nrefs > 0);
-    if (atom->nrefs <= 0)
-	return NULL;
-    if (--atom->nrefs == 0) {
-	PR_HashTableRemove(cx->runtime->atomState.table, atom->entry.key);
-#ifdef DEBUG_DUPLICATE_ATOMS
-	hep = PR_HashTableRawLookup(cx->runtime->atomState.table, keyHash,
-				    (void *)key);
-	he = *hep;
-	PR_ASSERT(he == NULL);
-#endif
+    if (atom->nrefs <= 0) {
+	atom = NULL;
+    } else if (--atom->nrefs == 0) {
+	PR_HashTableRemove(stripe->table, atom->entry.key);
 	atom = NULL;
     }
+    JS_RELEASE_LOCK(stripe->lock);
     return atom;
 }
 
@@ -31,6 +31,9 @@
 #include "jsapi.h"
 #include "jsprvtd.h"
 #include "jspubtd.h"
+#ifdef JS_THREADSAFE
+#include "prlock.h"
+#endif
 
 PR_BEGIN_EXTERN_C
 
@@ -75,9 +78,30 @@ struct JSAtomMap {
     jsatomid            length;         /* count of (to-be-)indexed atoms */
 };
 
+/*
+ * The atom table is split by key hash into stripes, each with its own hash
+ * table and, if JS_THREADSAFE, its own lock.  Atomizing, holding and dropping
+ * take only the key's stripe lock, not the runtime lock, so threads working
+ * on different atoms rarely contend.  A stripe lock is never held across an
+ * allocation or GC, so it may be taken with or without the runtime lock.
+ */
+#ifdef JS_THREADSAFE
+#define ATOM_STRIPE_SHIFT       4
+#else
+#define ATOM_STRIPE_SHIFT       0
+#endif
+#define ATOM_STRIPES            PR_BIT(ATOM_STRIPE_SHIFT)
+
+typedef struct JSAtomStripe {
+    PRHashTable         *table;         /* atoms whose keys hash here */
+    jsatomid            number;         /* next atom number, step STRIPES */
+#ifdef JS_THREADSAFE
+    PRLock              *lock;          /* protects table and atom nrefs */
+#endif
+} JSAtomStripe;
+
 struct JSAtomState {
-    PRHashTable         *table;         /* hash table containing all atoms */
-    jsatomid            number;         /* one beyond greatest atom number */
+    JSAtomStripe        stripes[ATOM_STRIPES];
 
     /* Type names and value literals. */
     JSAtom              *typeAtoms[JSTYPE_LIMIT];
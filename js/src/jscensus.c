@@ -0,0 +1,514 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+ * JS memory census.
+ *
+ * The census holds the runtime lock and stops every other request, as the
+ * GC does, then visits each thing in the GC arenas once (see js_MapGCThings)
+ * and adds up the memory it owns: an object's slots, and the scope it owns
+ * if any; a function's struct, lazy body source and script; a regexp's
+ * share of its compiled program; a string's chars or rope node.  Tables
+ * hanging off the runtime and contexts are sized from their headers.  No
+ * memory is allocated unless a dump asks for the per-class and per-file
+ * breakdown, so the census is cheap enough to take periodically.
+ *
+ * Each module whose structures are private sizes them itself: see
+ * js_GetScopeBytes, js_GetRegExpBytes and js_GetDeflatedStringBytes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prtypes.h"
+#ifndef NSPR20
+#include "prarena.h"
+#else
+#include "plarena.h"
+#endif
+#include "prlog.h"
+#ifndef NSPR20
+#include "prhash.h"
+#else
+#include "plhash.h"
+#endif
+#include "jsapi.h"
+#include "jsatom.h"
+#include "jscntxt.h"
+#include "jsdbgapi.h"
+#include "jsemit.h"
+#include "jsfun.h"
+#include "jsgc.h"
+#include "jsinterp.h"
+#include "jsjit.h"
+#include "jslock.h"
+#include "jsobj.h"
+#include "jsparse.h"
+#include "jsregexp.h"
+#include "jsscope.h"
+#include "jsscript.h"
+#include "jsstr.h"
+
+#define CENSUS_TABLE_SIZE       64      /* initial class and file tables */
+
+/* Objects and bytes of one class, or script bytes of one source file. */
+typedef struct CensusBucket {
+    const char      *name;
+    uint32          count;
+    size_t          bytes;
+} CensusBucket;
+
+typedef struct CensusState {
+    JSContext       *cx;
+    JSMemoryCensus  *census;
+    PRHashTable     *classes;           /* buckets by JSClass, or null */
+    PRHashTable     *files;             /* buckets by filename, or null */
+} CensusState;
+
+static PRHashNumber
+census_hash_class(const void *key)
+{
+    return (PRHashNumber)((pruword)key >> 3);
+}
+
+/*
+ * Charge count and nbytes to key's bucket in table, if the caller wants a
+ * breakdown.  Out of memory, the bucket is left short; the census proper
+ * is unaffected.
+ */
+static void
+census_charge(PRHashTable *table, const void *key, const char *name,
+	      uint32 count, size_t nbytes)
+{
+    PRHashNumber keyHash;
+    PRHashEntry **hep;
+    CensusBucket *bucket;
+
+    if (!table)
+	return;
+    keyHash = table->keyHash(key);
+    hep = PR_HashTableRawLookup(table, keyHash, key);
+    if (*hep) {
+	bucket = (*hep)->value;
+    } else {
+	bucket = malloc(sizeof *bucket);
+	if (!bucket)
+	    return;
+	bucket->name = name;
+	bucket->count = 0;
+	bucket->bytes = 0;
+	if (!PR_HashTableRawAdd(table, hep, keyHash, key, bucket)) {
+	    free(bucket);
+	    return;
+	}
+    }
+    bucket->count += count;
+    bucket->bytes += nbytes;
+}
+
+static size_t
+census_script_bytes(JSScript *script)
+{
+    size_t nbytes;
+    jssrcnote *sn;
+
+    nbytes = sizeof(JSScript) + script->length
+	   + script->atomMap.length * sizeof(JSAtom *);
+    if (script->filename)
+	nbytes += strlen(script->filename) + 1;
+    sn = script->notes;
+    if (sn) {
+	while (!SN_IS_TERMINATOR(sn))
+	    sn = SN_NEXT(sn);
+	nbytes += (sn + 1 - script->notes) * sizeof(jssrcnote);
+    }
+    if (script->propertyICs)
+	nbytes += (script->propertyICMask + 1) * sizeof(JSPropertyIC);
+#if JS_HAS_JIT
+    if (script->jit) {
+	nbytes += sizeof(JSJITCode) + script->jit->size;
+	if (script->jit->entries)
+	    nbytes += (script->length + 1) * sizeof(uint32);
+    }
+#endif
+    return nbytes;
+}
+
+static size_t
+census_function(CensusState *state, JSFunction *fun)
+{
+    JSMemoryCensus *census;
+    JSLazyFunction *lazy;
+    size_t nbytes, sbytes;
+
+    census = state->census;
+    census->functions++;
+    nbytes = sizeof *fun;
+    lazy = fun->lazy;
+    if (lazy) {
+	nbytes += sizeof *lazy
+		+ lazy->length * (lazy->wide ? sizeof(jschar) : 1);
+	if (lazy->filename)
+	    nbytes += strlen(lazy->filename) + 1;
+	census_charge(state->files, lazy->filename ? lazy->filename : "",
+		      NULL, 0, nbytes - sizeof *fun);
+    }
+    census->functionBytes += nbytes;
+    if (!fun->script)
+	return nbytes;
+
+    sbytes = census_script_bytes(fun->script);
+    census->scripts++;
+    census->scriptBytes += sbytes;
+    census_charge(state->files,
+		  fun->script->filename ? fun->script->filename : "",
+		  NULL, 1, sbytes);
+    return nbytes + sbytes;
+}
+
+static void
+census_object(CensusState *state, JSObject *obj)
+{
+    JSMemoryCensus *census;
+    JSScope *scope;
+    JSClass *clasp;
+    size_t nbytes, sbytes;
+    jsval v;
+
+    census = state->census;
+    census->objects++;
+    scope = (JSScope *)obj->map;
+    if (!scope)
+	return;
+    clasp = scope->map.clasp;
+
+    nbytes = 0;
+    if (obj->slots) {
+	nbytes = (scope->object == obj)
+		 ? PR_MAX(scope->map.nslots, JS_INITIAL_NSLOTS)
+		 : JS_INITIAL_NSLOTS;
+	nbytes *= sizeof(jsval);
+	census->objectSlotBytes += nbytes;
+    }
+    if (scope->object == obj) {
+	sbytes = js_GetScopeBytes(scope);
+	census->scopes++;
+	census->scopeBytes += sbytes;
+	nbytes += sbytes;
+    }
+
+    if (clasp == &js_FunctionClass || clasp == &js_RegExpClass) {
+	v = js_GetSlot(state->cx, obj, JSSLOT_PRIVATE);
+	if (JSVAL_IS_INT(v) && JSVAL_TO_PRIVATE(v)) {
+	    if (clasp == &js_FunctionClass) {
+		nbytes += census_function(state, JSVAL_TO_PRIVATE(v));
+	    } else {
+		sbytes = js_GetRegExpBytes(JSVAL_TO_PRIVATE(v));
+		census->regexps++;
+		census->regexpBytes += sbytes;
+		nbytes += sbytes;
+	    }
+	}
+    }
+    census_charge(state->classes, clasp, clasp->name, 1, nbytes);
+}
+
+static void
+census_thing(void *thing, uint8 flags, void *arg)
+{
+    CensusState *state;
+    JSMemoryCensus *census;
+    JSString *str;
+
+    state = arg;
+    census = state->census;
+    if (flags & GCF_FINAL) {
+	census->gcFreeThings++;
+	return;
+    }
+    switch (flags & GCF_TYPEMASK) {
+      case GCX_OBJECT:
+	census_object(state, thing);
+	break;
+      case GCX_STRING:
+	str = thing;
+	census->strings++;
+	if (JSSTRING_IS_ROPE(str))
+	    census->stringBytes += sizeof(JSRopeNode);
+	else if (str->chars)
+	    census->stringBytes += (str->length + 1) * sizeof(jschar);
+	break;
+      case GCX_DOUBLE:
+	census->doubles++;
+	break;
+    }
+}
+
+static size_t
+census_hash_table_bytes(PRHashTable *table, size_t entrySize)
+{
+    if (!table)
+	return 0;
+    return sizeof *table
+	   + PR_BIT(32 - table->shift) * sizeof(PRHashEntry *)
+	   + table->nentries * entrySize;
+}
+
+static size_t
+census_arena_pool_bytes(PRArenaPool *pool)
+{
+    PRArena *a;
+    size_t nbytes;
+
+    nbytes = 0;
+    for (a = pool->first.next; a; a = a->next)
+	nbytes += sizeof(PRArena) + (a->limit - a->base);
+    return nbytes;
+}
+
+static void
+census_context(JSContext *acx, JSContextCensus *census)
+{
+    census->contextBytes = sizeof *acx;
+    census->stackBytes = (acx->stackLimit - acx->stackBase) * sizeof(jsval);
+    census->codeBytes = census_arena_pool_bytes(&acx->codePool);
+    census->tempBytes = census_arena_pool_bytes(&acx->tempPool);
+    census->totalBytes = census->contextBytes + census->stackBytes
+		       + census->codeBytes + census->tempBytes;
+}
+
+/*
+ * Take the census with the runtime lock held and other requests stopped.
+ */
+static void
+census_runtime(CensusState *state)
+{
+    JSContext *cx, *acx, *iter;
+    JSRuntime *rt;
+    JSMemoryCensus *census;
+    JSAtomStripe *stripe;
+    uintN i;
+    JSContextCensus ccensus;
+
+    cx = state->cx;
+    rt = cx->runtime;
+    census = state->census;
+    memset(census, 0, sizeof *census);
+    census->gcArenaBytes = js_MapGCThings(rt, census_thing, state);
+
+    for (i = 0; i < ATOM_STRIPES; i++) {
+	stripe = &rt->atomState.stripes[i];
+	if (!stripe->table)
+	    continue;
+#ifdef JS_THREADSAFE
+	JS_ACQUIRE_LOCK(stripe->lock);
+#endif
+	census->atoms += stripe->table->nentries;
+	census->atomBytes += census_hash_table_bytes(stripe->table,
+						     sizeof(JSAtom));
+#ifdef JS_THREADSAFE
+	JS_RELEASE_LOCK(stripe->lock);
+#endif
+    }
+
+    census->regexpBytes += js_GetRegExpCacheBytes(rt);
+    census->stringBytes += js_GetDeflatedStringBytes();
+    census->runtimeBytes = sizeof *rt
+			 + census_hash_table_bytes(rt->gcRootsHash,
+						   sizeof(PRHashEntry))
+			 + js_GetShapeTableBytes(rt)
+			 + rt->gcMarkStackSize * sizeof(JSObject *)
+			 + rt->gcStoreBufferSize * sizeof(JSObject *);
+
+    census->totalBytes = census->gcArenaBytes + census->objectSlotBytes
+		       + census->scopeBytes + census->functionBytes
+		       + census->scriptBytes + census->regexpBytes
+		       + census->stringBytes + census->atomBytes
+		       + census->runtimeBytes;
+    iter = NULL;
+    while ((acx = js_ContextIterator(rt, &iter)) != NULL) {
+	census_context(acx, &ccensus);
+	census->totalBytes += ccensus.totalBytes;
+    }
+}
+
+static void
+census_lock(JSContext *cx)
+{
+    JS_LOCK(cx);
+#ifdef JS_THREADSAFE
+    js_WaitForStop(cx, NULL);
+#endif
+}
+
+PR_IMPLEMENT(void)
+JS_GetMemoryCensus(JSContext *cx, JSMemoryCensus *census)
+{
+    CensusState state;
+
+    state.cx = cx;
+    state.census = census;
+    state.classes = state.files = NULL;
+    census_lock(cx);
+    census_runtime(&state);
+    JS_UNLOCK(cx);
+}
+
+PR_IMPLEMENT(void)
+JS_GetContextCensus(JSContext *cx, JSContext *acx, JSContextCensus *census)
+{
+    census_lock(cx);
+    census_context(acx, census);
+    JS_UNLOCK(cx);
+}
+
+/************************************************************************/
+
+typedef struct CensusVector {
+    CensusBucket    **vector;
+    uint32          length;
+} CensusVector;
+
+PR_STATIC_CALLBACK(intN)
+census_collect(PRHashEntry *he, intN i, void *arg)
+{
+    CensusVector *cv;
+    CensusBucket *bucket;
+
+    cv = arg;
+    bucket = he->value;
+    if (!bucket->name)
+	bucket->name = *(const char *)he->key ? he->key : "(no file)";
+    cv->vector[cv->length++] = bucket;
+    return HT_ENUMERATE_REMOVE;
+}
+
+static int
+census_compare_buckets(const void *p1, const void *p2)
+{
+    const CensusBucket *b1 = *(CensusBucket **)p1;
+    const CensusBucket *b2 = *(CensusBucket **)p2;
+
+    if (b1->bytes != b2->bytes)
+	return (b1->bytes < b2->bytes) ? 1 : -1;
+    return (b1->count < b2->count) ? 1 : (b1->count > b2->count) ? -1 : 0;
+}
+
+/* Print at most limit of table's buckets, biggest first, and free them. */
+static void
+census_dump_table(FILE *fp, PRHashTable *table, const char *title,
+		  const char *unit, uint32 limit)
+{
+    CensusVector cv;
+    uint32 i;
+    CensusBucket *bucket;
+
+    cv.vector = malloc((table->nentries ? table->nentries : 1)
+		       * sizeof(CensusBucket *));
+    if (!cv.vector)
+	return;
+    cv.length = 0;
+    PR_HashTableEnumerateEntries(table, census_collect, &cv);
+    qsort(cv.vector, cv.length, sizeof(CensusBucket *),
+	  census_compare_buckets);
+    fprintf(fp, "\n%-32s %10s %12s\n", title, unit, "bytes");
+    for (i = 0; i < cv.length; i++) {
+	bucket = cv.vector[i];
+	if (i < limit) {
+	    fprintf(fp, "%-32.32s %10lu %12lu\n",
+		    bucket->name, (unsigned long)bucket->count,
+		    (unsigned long)bucket->bytes);
+	}
+	free(bucket);
+    }
+    if (cv.length > limit)
+	fprintf(fp, "(%lu more)\n", (unsigned long)(cv.length - limit));
+    free(cv.vector);
+}
+
+static void
+census_dump_row(FILE *fp, const char *name, uint32 count, size_t nbytes)
+{
+    if (count == (uint32)-1)
+	fprintf(fp, "%-32s %10s %12lu\n", name, "", (unsigned long)nbytes);
+    else
+	fprintf(fp, "%-32s %10lu %12lu\n",
+		name, (unsigned long)count, (unsigned long)nbytes);
+}
+
+PR_IMPLEMENT(void)
+JS_DumpMemoryCensus(JSContext *cx, FILE *fp, uintN nfiles)
+{
+    JSMemoryCensus census;
+    CensusState state;
+    JSContext *acx, *iter;
+    JSContextCensus ccensus;
+    char name[32];
+    uintN n;
+
+    state.cx = cx;
+    state.census = &census;
+    state.classes = PR_NewHashTable(CENSUS_TABLE_SIZE, census_hash_class,
+				    PR_CompareValues, PR_CompareValues,
+				    NULL, NULL);
+    state.files = PR_NewHashTable(CENSUS_TABLE_SIZE, PR_HashString,
+				  PR_CompareStrings, PR_CompareValues,
+				  NULL, NULL);
+    census_lock(cx);
+    census_runtime(&state);
+
+    fprintf(fp, "%-32s %10s %12s\n", "Memory census", "count", "bytes");
+    census_dump_row(fp, "GC arenas", (uint32)-1, census.gcArenaBytes);
+    census_dump_row(fp, "  free things", census.gcFreeThings, 0);
+    census_dump_row(fp, "  objects (slots)", census.objects,
+		    census.objectSlotBytes);
+    census_dump_row(fp, "  strings (chars)", census.strings,
+		    census.stringBytes);
+    census_dump_row(fp, "  doubles", census.doubles, 0);
+    census_dump_row(fp, "scopes", census.scopes, census.scopeBytes);
+    census_dump_row(fp, "functions", census.functions,
+		    census.functionBytes);
+    census_dump_row(fp, "scripts", census.scripts, census.scriptBytes);
+    census_dump_row(fp, "regexps", census.regexps, census.regexpBytes);
+    census_dump_row(fp, "atoms", census.atoms, census.atomBytes);
+    census_dump_row(fp, "runtime tables", (uint32)-1, census.runtimeBytes);
+
+    n = 0;
+    iter = NULL;
+    while ((acx = js_ContextIterator(cx->runtime, &iter)) != NULL) {
+	census_context(acx, &ccensus);
+	sprintf(name, "context %u%s", n++, (acx == cx) ? " (this)" : "");
+	census_dump_row(fp, name, (uint32)-1, ccensus.totalBytes);
+	census_dump_row(fp, "  stack", (uint32)-1, ccensus.stackBytes);
+	census_dump_row(fp, "  code", (uint32)-1, ccensus.codeBytes);
+	census_dump_row(fp, "  temp", (uint32)-1, ccensus.tempBytes);
+    }
+    census_dump_row(fp, "total", (uint32)-1, census.totalBytes);
+
+    /* File buckets are named by their scripts' filenames: dump them locked. */
+    if (state.classes) {
+	census_dump_table(fp, state.classes, "Objects by class", "objects",
+			  (uint32)-1);
+	PR_HashTableDestroy(state.classes);
+    }
+    if (state.files) {
+	census_dump_table(fp, state.files, "Scripts by file", "scripts",
+			  nfiles);
+	PR_HashTableDestroy(state.files);
+    }
+    JS_UNLOCK(cx);
+}
@@ -54,17 +54,30 @@ JSContext *
 js_NewContext(JSRuntime *rt, size_t stacksize)
 {
     JSContext *cx;
+    size_t nslots;
 
     cx = malloc(sizeof *cx);
     if (!cx)
 	return NULL;
     memset(cx, 0, sizeof *cx);
 
+    /* Allocate the whole VM stack now, see jsinterp.h. */
+    nslots = stacksize / sizeof(jsval);
+    if (nslots < JS_MIN_STACK_SLOTS)
+	nslots = JS_MIN_STACK_SLOTS;
+    cx->stackBase = cx->stackTop = malloc(nslots * sizeof(jsval));
+    if (!cx->stackBase) {
+	free(cx);
+	return NULL;
+    }
+    cx->stackLimit = cx->stackBase + nslots;
+
     cx->runtime = rt;
     if (rt->contextList.next == (PRCList *)&rt->contextList) {
 	/* First context on this runtime: initialize atoms and keywords. */
 	if (!js_InitAtomState(cx, &rt->atomState) ||
 	    !js_InitScanner(cx)) {
+	    free(cx->stackBase);
 	    free(cx);
 	    return NULL;
 	}
@@ -74,7 +87,6 @@ js_NewContext(JSRuntime *rt, size_t stacksize)
     cx->version = JSVERSION_DEFAULT;
     cx->jsop_eq = JSOP_EQ;
     cx->jsop_ne = JSOP_NE;
-    PR_InitArenaPool(&cx->stackPool, "stack", stacksize, sizeof(jsval));
     PR_InitArenaPool(&cx->codePool, "code", 1024, sizeof(jsbytecode));
     PR_InitArenaPool(&cx->tempPool, "temp", 1024, sizeof(jsdouble));
 
@@ -117,13 +129,19 @@ js_DestroyContext(JSContext *cx)
 #endif
     js_ForceGC(cx);
 
+    /*
+     * cx is off the context list, so no GC will return the things reserved
+     * for it, and js_ForceGC returns early if another thread's GC is running.
+     */
+    js_ReturnGCFreeList(cx);
+
     if (rtempty) {
 	/* Free atom state now that we've run the GC. */
 	js_FreeAtomState(cx, &rt->atomState);
     }
 
     /* Free the stuff hanging off of cx. */
-    PR_FinishArenaPool(&cx->stackPool);
+    free(cx->stackBase);
     PR_FinishArenaPool(&cx->codePool);
     PR_FinishArenaPool(&cx->tempPool);
     if (cx->lastMessage)
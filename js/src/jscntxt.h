@@ -28,9 +28,13 @@
 #endif
 #include "prclist.h"
 #include "prlong.h"
+#ifdef JS_THREADSAFE
+#include "prthread.h"
+#endif
 #include "jsatom.h"
 #include "jsgc.h"
 #include "jsinterp.h"
+#include "jsnum.h"
 #include "jsobj.h"
 #include "jsprvtd.h"
 #include "jspubtd.h"
@@ -41,15 +45,28 @@ PR_BEGIN_EXTERN_C
 struct JSRuntime {
     /* Garbage collector state, used by jsgc.c. */
     PRArenaPool         gcArenaPool;
-    PRArenaPool         gcFlagsPool;
     PRHashTable         *gcRootsHash;
-    JSGCThing           *gcFreeList;
+    JSGCArenaInfo       *gcFreeArenas;  /* arenas with free things */
+    JSGCArenaInfo       *gcYoungArenas; /* nursery, see jsgc.c */
+    uint32              gcNurseryBytes; /* bytes allocated since last GC */
+    JSObject            **gcStoreBuffer;/* objects stored into since then */
+    uint32              gcStoreBufferDepth;
+    uint32              gcStoreBufferSize;
+    JSBool              gcStoreBufferOverflow;
+    JSObject            *gcStoreFilter[GC_STORE_FILTER_SIZE];
+    PRArena             **gcArenaVector;/* sorted arenas, while marking */
+    uint32              gcArenaCount;
     uint32              gcBytes;
     uint32              gcLastBytes;
     uint32              gcMaxBytes;
     uint32              gcLevel;
     uint32              gcNumber;
     JSBool              gcPoke;
+    JSBool              gcMarking;      /* incremental mark in progress */
+    uint32              gcSliceBudget;  /* usecs per mark slice, 0 for all */
+    JSObject            **gcMarkStack;  /* gray objects awaiting a scan */
+    uint32              gcMarkStackDepth;
+    uint32              gcMarkStackSize;
 #ifdef JS_GCMETER
     JSGCStats           gcStats;
 #endif
@@ -76,6 +93,16 @@ struct JSRuntime {
     /* Weak links to properties, indexed by quickened get/set opcodes. */
     JSPropertyCache     propertyCache;
 
+    /* Scope shape generator and transition table, see jsscope.c. */
+    uint64              shapeGen;
+    PRHashTable         *shapeTable;
+
+    /* Compiled regexps by hash of source and flags, see jsregexp.c. */
+    JSRECode            *regExpCache[REGEXP_CACHE_SIZE];
+
+    /* Directory of compiled scripts, see jsxdrapi.c, or null. */
+    char                *scriptCacheDir;
+
     /* List of active contexts sharing this runtime. */
     PRCList             contextList;
 
@@ -86,14 +113,20 @@ struct JSRuntime {
     void                *newScriptHookProcData;
     void                *destroyScriptHookProc;
     void                *destroyScriptHookProcData;
+    void                *callHook;
+    void                *callHookData;
 
     /* More debugging state, see jsdbgapi.c. */
     PRCList             trapList;
     PRCList             watchPointList;
+    struct JSProfile    *profile;
 
 #ifdef JS_THREADSAFE
     /* Hook for js_lock_runtime/js_unlock_runtime/js_is_runtime_locked. */
     void                *lockData;
+
+    /* Set while a thread waits for contexts to stop, see js_WaitForStop. */
+    JSBool              stopRequested;
 #endif
 };
 
@@ -111,8 +144,10 @@ struct JSContext {
     /* Data shared by threads in an address space. */
     JSRuntime           *runtime;
 
-    /* Stack arena pool and frame pointer register. */
-    PRArenaPool         stackPool;
+    /* Contiguous VM stack, see jsinterp.h, and frame pointer register. */
+    jsval               *stackBase;
+    jsval               *stackLimit;
+    jsval               *stackTop;
     JSStackFrame        *fp;
 
     /* Temporary arena pools used while compiling and decompiling. */
@@ -125,6 +160,16 @@ struct JSContext {
     /* Most recently created things by type, members of the GC's root set. */
     JSGCThing           *newborn[GCX_NTYPES];
 
+    /* Batch of free GC things taken from the runtime, see jsgc.c. */
+    JSGCThing           *gcFreeList;
+
+#ifdef JS_THREADSAFE
+    /* Request nesting and the thread running it, see JS_BeginRequest. */
+    uintN               requestDepth;
+    PRThread            *thread;
+    JSBool              stopped;        /* waiting for the runtime lock */
+#endif
+
     /* Regular expression class statics (XXX not shared globally). */
     JSRegExpStatics     regExpStatics;
 
@@ -137,6 +182,22 @@ struct JSContext {
     void                *tracefp;
 #endif
 
+    /* Whether scripts run as native code, see jsjit.h. */
+    JSBool              jitEnabled;
+
+    /* Whether function bodies compile when first called, see jsparse.h. */
+    JSBool              lazyCompile;
+
+    /* Inline cache meters, kept here so that hits write only to cx. */
+    uint32              icTests;
+    uint32              icMisses;
+
+    /* Arithmetic results computed as ints, without jsdouble. */
+    uint32              intArithOps;
+
+    /* Strings of recently converted numbers, see js_NumberToString. */
+    JSNumberString      numberStrings[NUMBER_STRING_CACHE_SIZE];
+
     /* Per-context optional user callbacks. */
     JSBranchCallback    branchCallback;
     JSErrorReporter     errorReporter;
@@ -1577,7 +1577,7 @@ date_constructor(JSContext *cx, JSObject* obj)
         return NULL;
 
     JS_LOCK(cx);
-    OBJ_SET_SLOT(obj, JSSLOT_PRIVATE, DOUBLE_TO_JSVAL(date));
+    OBJ_SET_SLOT(cx, obj, JSSLOT_PRIVATE, DOUBLE_TO_JSVAL(date));
     JS_UNLOCK(cx);
 
     return date;
@@ -27,8 +27,10 @@
 #include "jsdbgapi.h"
 #include "jsgc.h"
 #include "jsinterp.h"
+#include "jsjit.h"
 #include "jsobj.h"
 #include "jsopcode.h"
+#include "jsparse.h"
 #include "jsscope.h"
 #include "jsscript.h"
 #include "jsstr.h"
@@ -97,6 +99,11 @@ JS_SetTrap(JSContext *cx, JSScript *script, jsbytecode *pc,
     trap->handler = handler;
     trap->closure = closure;
     *pc = JSOP_TRAP;
+#if JS_HAS_JIT
+    /* Native code doesn't see traps, so stop using it for this script. */
+    if (script->jit)
+	script->jit->valid = JS_FALSE;
+#endif
     return JS_TRUE;
 }
 
@@ -227,6 +234,7 @@ DropWatchPoint(JSContext *cx, JSWatchPoint *wp)
     if (--wp->nrefs != 0)
 	return;
     wp->prop->setter = wp->setter;
+    PROPERTY_CHANGED(cx, wp->prop);
     js_DropProperty(cx, wp->prop);
     PR_REMOVE_LINK(&wp->links);
     js_RemoveRoot(cx, &wp->closure);
@@ -364,6 +372,7 @@ JS_SetWatchPoint(JSContext *cx, JSObject *obj, jsval id,
 	wp->prop = js_HoldProperty(cx, prop);
 	wp->setter = prop->setter;
 	prop->setter = js_watch_set;
+	PROPERTY_CHANGED(cx, prop);
 	wp->nrefs = 1;
     }
     wp->handler = handler;
@@ -443,6 +452,8 @@ JS_LineNumberToPC(JSContext *cx, JSScript *script, uintN lineno)
 PR_IMPLEMENT(JSScript *)
 JS_GetFunctionScript(JSContext *cx, JSFunction *fun)
 {
+    if (!JSFUN_COMPILE(cx, fun))
+	return NULL;
     return fun->script;
 }
 
@@ -578,6 +589,13 @@ JS_SetDestroyScriptHookProc(JSRuntime *rt, JSDestroyScriptHookProc hookproc,
     rt->destroyScriptHookProc = hookproc;
 }
 
+PR_IMPLEMENT(void)
+JS_SetCallHook(JSRuntime *rt, JSInterpreterHook hook, void *closure)
+{
+    rt->callHookData = closure;
+    rt->callHook = hook;
+}
+
 /***************************************************************************/
 
 PR_IMPLEMENT(JSBool)
@@ -21,6 +21,7 @@
 /*
  * JS debugger API.
  */
+#include <stdio.h>
 #include "jsapi.h"
 #include "jsopcode.h"
 #include "jsprvtd.h"
@@ -176,6 +177,104 @@ PR_EXTERN(void)
 JS_SetDestroyScriptHookProc(JSRuntime *rt, JSDestroyScriptHookProc hookproc,
 			    void *callerdata);
 
+/*
+ * Called by js_DoCall with before true just before a native or scripted
+ * function runs in frame fp, and with before false just after it returns,
+ * *ok telling whether it succeeded.  The "before" call gets the closure
+ * passed to JS_SetCallHook, and the value it returns is passed as closure to
+ * the matching "after" call, which is made even if the hook was cleared in
+ * between.
+ */
+typedef void *
+(*JSInterpreterHook)(JSContext *cx, JSStackFrame *fp, JSBool before,
+		     JSBool *ok, void *closure);
+
+PR_EXTERN(void)
+JS_SetCallHook(JSRuntime *rt, JSInterpreterHook hook, void *closure);
+
+/************************************************************************/
+
+/*
+ * Script profiler, see jsprof.c.  JSPROF_SAMPLE records the frame chain on
+ * every interval microseconds of running script, at little cost.  JSPROF_COUNT
+ * counts every op executed and every call made, and times calls, at a large
+ * cost.  Starting discards the last profile and fails if an interrupt hook
+ * or call hook is already set; stopping keeps the profile for dumping.
+ */
+typedef enum JSProfileMode {
+    JSPROF_SAMPLE,
+    JSPROF_COUNT
+} JSProfileMode;
+
+PR_EXTERN(JSBool)
+JS_StartProfiling(JSContext *cx, JSProfileMode mode, uint32 interval);
+
+PR_EXTERN(void)
+JS_StopProfiling(JSContext *cx);
+
+/* Print a flat profile, a call tree, and the hottest ops to fp. */
+PR_EXTERN(void)
+JS_DumpProfile(JSContext *cx, FILE *fp);
+
+PR_EXTERN(void)
+JS_ClearProfile(JSContext *cx);
+
+extern void
+js_FinishProfile(JSRuntime *rt);
+
+/************************************************************************/
+
+/*
+ * Memory census, see jscensus.c.  JS_GetMemoryCensus walks the GC heap once
+ * and sums what the things in it own, by kind, in less time than a full GC
+ * takes.  Byte counts are of live allocations, not including malloc's own
+ * overhead.  Scripts are counted through their functions' objects, so the
+ * top-level scripts an embedding holds are missed.  Garbage not yet swept
+ * counts as live: run the GC first for a census of reachable memory only.
+ */
+typedef struct JSMemoryCensus {
+    size_t          gcArenaBytes;       /* GC arenas, for all the things */
+    uint32          gcFreeThings;       /* things free in the arenas */
+    uint32          objects;
+    size_t          objectSlotBytes;    /* objects' slot vectors */
+    uint32          scopes;
+    size_t          scopeBytes;         /* scopes, tables, properties */
+    uint32          functions;
+    size_t          functionBytes;      /* functions and lazy bodies */
+    uint32          scripts;
+    size_t          scriptBytes;        /* code, notes, caches, native code */
+    uint32          regexps;
+    size_t          regexpBytes;        /* regexps and compiled programs */
+    uint32          strings;
+    size_t          stringBytes;        /* chars, ropes, deflated copies */
+    uint32          doubles;
+    uint32          atoms;
+    size_t          atomBytes;          /* atoms and atom tables */
+    size_t          runtimeBytes;       /* runtime and its other tables */
+    size_t          totalBytes;         /* all of the above, and contexts */
+} JSMemoryCensus;
+
+typedef struct JSContextCensus {
+    size_t          contextBytes;       /* the JSContext itself */
+    size_t          stackBytes;         /* interpreter stack arenas */
+    size_t          codeBytes;          /* code generator arenas */
+    size_t          tempBytes;          /* compiler temporary arenas */
+    size_t          totalBytes;
+} JSContextCensus;
+
+PR_EXTERN(void)
+JS_GetMemoryCensus(JSContext *cx, JSMemoryCensus *census);
+
+PR_EXTERN(void)
+JS_GetContextCensus(JSContext *cx, JSContext *acx, JSContextCensus *census);
+
+/*
+ * Print the runtime's census, each context's, the objects and slot bytes of
+ * each class, and the script bytes of the nfiles source files with the most.
+ */
+PR_EXTERN(void)
+JS_DumpMemoryCensus(JSContext *cx, FILE *fp, uintN nfiles);
+
 /************************************************************************/
 
 PR_EXTERN(JSBool)
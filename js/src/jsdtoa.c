@@ -0,0 +1,774 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+ * Fast number conversion, see jsdtoa.h.
+ */
+#include "prtypes.h"
+#include "prlog.h"
+#include "jsapi.h"
+#include "jsdtoa.h"
+
+#if JS_HAS_FAST_DTOA
+
+#include <math.h>
+#include "jsnum.h"
+#include "jsstr.h"
+
+#define U64(hi,lo)      (((uint64)(hi) << 32) | (uint32)(lo))
+#define LO32(x)         ((uint64)(uint32)(x))
+
+#define DBL_HIDDEN_BIT  U64(0x00100000, 0)
+#define DBL_MANT_MASK   U64(0x000fffff, 0xffffffff)
+#define DBL_SIGN_BIT    U64(0x80000000, 0)
+
+typedef union DoubleBits {
+    jsdouble        d;
+    uint64          u;
+} DoubleBits;
+
+/* A "do-it-yourself floating point" number, f * 2^e. */
+typedef struct DiyFp {
+    uint64          f;
+    intN            e;
+} DiyFp;
+
+/*
+ * 10^k as f * 2^e for POW10_MIN <= k <= POW10_MAX, with f truncated to 64
+ * bits and its high bit set.  f is exact for 0 <= k <= 27, and otherwise
+ * is less than the true value by under one unit in its last place.
+ */
+typedef struct PowerOfTen {
+    uint64          f;
+    int16           e;
+} PowerOfTen;
+
+#define POW10_MIN       (-326)
+#define POW10_MAX       324
+#define POW10_EXACT_MAX 27
+
+static const PowerOfTen powers_of_ten[] = {
+    {U64(0x84a57695, 0xfe98746d), -1146}, {U64(0xa5ced43b, 0x7e3e9188), -1143},
+    {U64(0xcf42894a, 0x5dce35ea), -1140}, {U64(0x818995ce, 0x7aa0e1b2), -1136},
+    {U64(0xa1ebfb42, 0x19491a1f), -1133}, {U64(0xca66fa12, 0x9f9b60a6), -1130},
+    {U64(0xfd00b897, 0x478238d0), -1127}, {U64(0x9e20735e, 0x8cb16382), -1123},
+    {U64(0xc5a89036, 0x2fddbc62), -1120}, {U64(0xf712b443, 0xbbd52b7b), -1117},
+    {U64(0x9a6bb0aa, 0x55653b2d), -1113}, {U64(0xc1069cd4, 0xeabe89f8), -1110},
+    {U64(0xf148440a, 0x256e2c76), -1107}, {U64(0x96cd2a86, 0x5764dbca), -1103},
+    {U64(0xbc807527, 0xed3e12bc), -1100}, {U64(0xeba09271, 0xe88d976b), -1097},
+    {U64(0x93445b87, 0x31587ea3), -1093}, {U64(0xb8157268, 0xfdae9e4c), -1090},
+    {U64(0xe61acf03, 0x3d1a45df), -1087}, {U64(0x8fd0c162, 0x06306bab), -1083},
+    {U64(0xb3c4f1ba, 0x87bc8696), -1080}, {U64(0xe0b62e29, 0x29aba83c), -1077},
+    {U64(0x8c71dcd9, 0xba0b4925), -1073}, {U64(0xaf8e5410, 0x288e1b6f), -1070},
+    {U64(0xdb71e914, 0x32b1a24a), -1067}, {U64(0x892731ac, 0x9faf056e), -1063},
+    {U64(0xab70fe17, 0xc79ac6ca), -1060}, {U64(0xd64d3d9d, 0xb981787d), -1057},
+    {U64(0x85f04682, 0x93f0eb4e), -1053}, {U64(0xa76c5823, 0x38ed2621), -1050},
+    {U64(0xd1476e2c, 0x07286faa), -1047}, {U64(0x82cca4db, 0x847945ca), -1043},
+    {U64(0xa37fce12, 0x6597973c), -1040}, {U64(0xcc5fc196, 0xfefd7d0c), -1037},
+    {U64(0xff77b1fc, 0xbebcdc4f), -1034}, {U64(0x9faacf3d, 0xf73609b1), -1030},
+    {U64(0xc795830d, 0x75038c1d), -1027}, {U64(0xf97ae3d0, 0xd2446f25), -1024},
+    {U64(0x9becce62, 0x836ac577), -1020}, {U64(0xc2e801fb, 0x244576d5), -1017},
+    {U64(0xf3a20279, 0xed56d48a), -1014}, {U64(0x9845418c, 0x345644d6), -1010},
+    {U64(0xbe5691ef, 0x416bd60c), -1007}, {U64(0xedec366b, 0x11c6cb8f), -1004},
+    {U64(0x94b3a202, 0xeb1c3f39), -1000}, {U64(0xb9e08a83, 0xa5e34f07),  -997},
+    {U64(0xe858ad24, 0x8f5c22c9),  -994}, {U64(0x91376c36, 0xd99995be),  -990},
+    {U64(0xb5854744, 0x8ffffb2d),  -987}, {U64(0xe2e69915, 0xb3fff9f9),  -984},
+    {U64(0x8dd01fad, 0x907ffc3b),  -980}, {U64(0xb1442798, 0xf49ffb4a),  -977},
+    {U64(0xdd95317f, 0x31c7fa1d),  -974}, {U64(0x8a7d3eef, 0x7f1cfc52),  -970},
+    {U64(0xad1c8eab, 0x5ee43b66),  -967}, {U64(0xd863b256, 0x369d4a40),  -964},
+    {U64(0x873e4f75, 0xe2224e68),  -960}, {U64(0xa90de353, 0x5aaae202),  -957},
+    {U64(0xd3515c28, 0x31559a83),  -954}, {U64(0x8412d999, 0x1ed58091),  -950},
+    {U64(0xa5178fff, 0x668ae0b6),  -947}, {U64(0xce5d73ff, 0x402d98e3),  -944},
+    {U64(0x80fa687f, 0x881c7f8e),  -940}, {U64(0xa139029f, 0x6a239f72),  -937},
+    {U64(0xc9874347, 0x44ac874e),  -934}, {U64(0xfbe91419, 0x15d7a922),  -931},
+    {U64(0x9d71ac8f, 0xada6c9b5),  -927}, {U64(0xc4ce17b3, 0x99107c22),  -924},
+    {U64(0xf6019da0, 0x7f549b2b),  -921}, {U64(0x99c10284, 0x4f94e0fb),  -917},
+    {U64(0xc0314325, 0x637a1939),  -914}, {U64(0xf03d93ee, 0xbc589f88),  -911},
+    {U64(0x96267c75, 0x35b763b5),  -907}, {U64(0xbbb01b92, 0x83253ca2),  -904},
+    {U64(0xea9c2277, 0x23ee8bcb),  -901}, {U64(0x92a1958a, 0x7675175f),  -897},
+    {U64(0xb749faed, 0x14125d36),  -894}, {U64(0xe51c79a8, 0x5916f484),  -891},
+    {U64(0x8f31cc09, 0x37ae58d2),  -887}, {U64(0xb2fe3f0b, 0x8599ef07),  -884},
+    {U64(0xdfbdcece, 0x67006ac9),  -881}, {U64(0x8bd6a141, 0x006042bd),  -877},
+    {U64(0xaecc4991, 0x4078536d),  -874}, {U64(0xda7f5bf5, 0x90966848),  -871},
+    {U64(0x888f9979, 0x7a5e012d),  -867}, {U64(0xaab37fd7, 0xd8f58178),  -864},
+    {U64(0xd5605fcd, 0xcf32e1d6),  -861}, {U64(0x855c3be0, 0xa17fcd26),  -857},
+    {U64(0xa6b34ad8, 0xc9dfc06f),  -854}, {U64(0xd0601d8e, 0xfc57b08b),  -851},
+    {U64(0x823c1279, 0x5db6ce57),  -847}, {U64(0xa2cb1717, 0xb52481ed),  -844},
+    {U64(0xcb7ddcdd, 0xa26da268),  -841}, {U64(0xfe5d5415, 0x0b090b02),  -838},
+    {U64(0x9efa548d, 0x26e5a6e1),  -834}, {U64(0xc6b8e9b0, 0x709f109a),  -831},
+    {U64(0xf867241c, 0x8cc6d4c0),  -828}, {U64(0x9b407691, 0xd7fc44f8),  -824},
+    {U64(0xc2109436, 0x4dfb5636),  -821}, {U64(0xf294b943, 0xe17a2bc4),  -818},
+    {U64(0x979cf3ca, 0x6cec5b5a),  -814}, {U64(0xbd8430bd, 0x08277231),  -811},
+    {U64(0xece53cec, 0x4a314ebd),  -808}, {U64(0x940f4613, 0xae5ed136),  -804},
+    {U64(0xb9131798, 0x99f68584),  -801}, {U64(0xe757dd7e, 0xc07426e5),  -798},
+    {U64(0x9096ea6f, 0x3848984f),  -794}, {U64(0xb4bca50b, 0x065abe63),  -791},
+    {U64(0xe1ebce4d, 0xc7f16dfb),  -788}, {U64(0x8d3360f0, 0x9cf6e4bd),  -784},
+    {U64(0xb080392c, 0xc4349dec),  -781}, {U64(0xdca04777, 0xf541c567),  -778},
+    {U64(0x89e42caa, 0xf9491b60),  -774}, {U64(0xac5d37d5, 0xb79b6239),  -771},
+    {U64(0xd77485cb, 0x25823ac7),  -768}, {U64(0x86a8d39e, 0xf77164bc),  -764},
+    {U64(0xa8530886, 0xb54dbdeb),  -761}, {U64(0xd267caa8, 0x62a12d66),  -758},
+    {U64(0x8380dea9, 0x3da4bc60),  -754}, {U64(0xa4611653, 0x8d0deb78),  -751},
+    {U64(0xcd795be8, 0x70516656),  -748}, {U64(0x806bd971, 0x4632dff6),  -744},
+    {U64(0xa086cfcd, 0x97bf97f3),  -741}, {U64(0xc8a883c0, 0xfdaf7df0),  -738},
+    {U64(0xfad2a4b1, 0x3d1b5d6c),  -735}, {U64(0x9cc3a6ee, 0xc6311a63),  -731},
+    {U64(0xc3f490aa, 0x77bd60fc),  -728}, {U64(0xf4f1b4d5, 0x15acb93b),  -725},
+    {U64(0x99171105, 0x2d8bf3c5),  -721}, {U64(0xbf5cd546, 0x78eef0b6),  -718},
+    {U64(0xef340a98, 0x172aace4),  -715}, {U64(0x9580869f, 0x0e7aac0e),  -711},
+    {U64(0xbae0a846, 0xd2195712),  -708}, {U64(0xe998d258, 0x869facd7),  -705},
+    {U64(0x91ff8377, 0x5423cc06),  -701}, {U64(0xb67f6455, 0x292cbf08),  -698},
+    {U64(0xe41f3d6a, 0x7377eeca),  -695}, {U64(0x8e938662, 0x882af53e),  -691},
+    {U64(0xb23867fb, 0x2a35b28d),  -688}, {U64(0xdec681f9, 0xf4c31f31),  -685},
+    {U64(0x8b3c113c, 0x38f9f37e),  -681}, {U64(0xae0b158b, 0x4738705e),  -678},
+    {U64(0xd98ddaee, 0x19068c76),  -675}, {U64(0x87f8a8d4, 0xcfa417c9),  -671},
+    {U64(0xa9f6d30a, 0x038d1dbc),  -668}, {U64(0xd47487cc, 0x8470652b),  -665},
+    {U64(0x84c8d4df, 0xd2c63f3b),  -661}, {U64(0xa5fb0a17, 0xc777cf09),  -658},
+    {U64(0xcf79cc9d, 0xb955c2cc),  -655}, {U64(0x81ac1fe2, 0x93d599bf),  -651},
+    {U64(0xa21727db, 0x38cb002f),  -648}, {U64(0xca9cf1d2, 0x06fdc03b),  -645},
+    {U64(0xfd442e46, 0x88bd304a),  -642}, {U64(0x9e4a9cec, 0x15763e2e),  -638},
+    {U64(0xc5dd4427, 0x1ad3cdba),  -635}, {U64(0xf7549530, 0xe188c128),  -632},
+    {U64(0x9a94dd3e, 0x8cf578b9),  -628}, {U64(0xc13a148e, 0x3032d6e7),  -625},
+    {U64(0xf18899b1, 0xbc3f8ca1),  -622}, {U64(0x96f5600f, 0x15a7b7e5),  -618},
+    {U64(0xbcb2b812, 0xdb11a5de),  -615}, {U64(0xebdf6617, 0x91d60f56),  -612},
+    {U64(0x936b9fce, 0xbb25c995),  -608}, {U64(0xb84687c2, 0x69ef3bfb),  -605},
+    {U64(0xe65829b3, 0x046b0afa),  -602}, {U64(0x8ff71a0f, 0xe2c2e6dc),  -598},
+    {U64(0xb3f4e093, 0xdb73a093),  -595}, {U64(0xe0f218b8, 0xd25088b8),  -592},
+    {U64(0x8c974f73, 0x83725573),  -588}, {U64(0xafbd2350, 0x644eeacf),  -585},
+    {U64(0xdbac6c24, 0x7d62a583),  -582}, {U64(0x894bc396, 0xce5da772),  -578},
+    {U64(0xab9eb47c, 0x81f5114f),  -575}, {U64(0xd686619b, 0xa27255a2),  -572},
+    {U64(0x8613fd01, 0x45877585),  -568}, {U64(0xa798fc41, 0x96e952e7),  -565},
+    {U64(0xd17f3b51, 0xfca3a7a0),  -562}, {U64(0x82ef8513, 0x3de648c4),  -558},
+    {U64(0xa3ab6658, 0x0d5fdaf5),  -555}, {U64(0xcc963fee, 0x10b7d1b3),  -552},
+    {U64(0xffbbcfe9, 0x94e5c61f),  -549}, {U64(0x9fd561f1, 0xfd0f9bd3),  -545},
+    {U64(0xc7caba6e, 0x7c5382c8),  -542}, {U64(0xf9bd690a, 0x1b68637b),  -539},
+    {U64(0x9c1661a6, 0x51213e2d),  -535}, {U64(0xc31bfa0f, 0xe5698db8),  -532},
+    {U64(0xf3e2f893, 0xdec3f126),  -529}, {U64(0x986ddb5c, 0x6b3a76b7),  -525},
+    {U64(0xbe895233, 0x86091465),  -522}, {U64(0xee2ba6c0, 0x678b597f),  -519},
+    {U64(0x94db4838, 0x40b717ef),  -515}, {U64(0xba121a46, 0x50e4ddeb),  -512},
+    {U64(0xe896a0d7, 0xe51e1566),  -509}, {U64(0x915e2486, 0xef32cd60),  -505},
+    {U64(0xb5b5ada8, 0xaaff80b8),  -502}, {U64(0xe3231912, 0xd5bf60e6),  -499},
+    {U64(0x8df5efab, 0xc5979c8f),  -495}, {U64(0xb1736b96, 0xb6fd83b3),  -492},
+    {U64(0xddd0467c, 0x64bce4a0),  -489}, {U64(0x8aa22c0d, 0xbef60ee4),  -485},
+    {U64(0xad4ab711, 0x2eb3929d),  -482}, {U64(0xd89d64d5, 0x7a607744),  -479},
+    {U64(0x87625f05, 0x6c7c4a8b),  -475}, {U64(0xa93af6c6, 0xc79b5d2d),  -472},
+    {U64(0xd389b478, 0x79823479),  -469}, {U64(0x843610cb, 0x4bf160cb),  -465},
+    {U64(0xa54394fe, 0x1eedb8fe),  -462}, {U64(0xce947a3d, 0xa6a9273e),  -459},
+    {U64(0x811ccc66, 0x8829b887),  -455}, {U64(0xa163ff80, 0x2a3426a8),  -452},
+    {U64(0xc9bcff60, 0x34c13052),  -449}, {U64(0xfc2c3f38, 0x41f17c67),  -446},
+    {U64(0x9d9ba783, 0x2936edc0),  -442}, {U64(0xc5029163, 0xf384a931),  -439},
+    {U64(0xf64335bc, 0xf065d37d),  -436}, {U64(0x99ea0196, 0x163fa42e),  -432},
+    {U64(0xc06481fb, 0x9bcf8d39),  -429}, {U64(0xf07da27a, 0x82c37088),  -426},
+    {U64(0x964e858c, 0x91ba2655),  -422}, {U64(0xbbe226ef, 0xb628afea),  -419},
+    {U64(0xeadab0ab, 0xa3b2dbe5),  -416}, {U64(0x92c8ae6b, 0x464fc96f),  -412},
+    {U64(0xb77ada06, 0x17e3bbcb),  -409}, {U64(0xe5599087, 0x9ddcaabd),  -406},
+    {U64(0x8f57fa54, 0xc2a9eab6),  -402}, {U64(0xb32df8e9, 0xf3546564),  -399},
+    {U64(0xdff97724, 0x70297ebd),  -396}, {U64(0x8bfbea76, 0xc619ef36),  -392},
+    {U64(0xaefae514, 0x77a06b03),  -389}, {U64(0xdab99e59, 0x958885c4),  -386},
+    {U64(0x88b402f7, 0xfd75539b),  -382}, {U64(0xaae103b5, 0xfcd2a881),  -379},
+    {U64(0xd59944a3, 0x7c0752a2),  -376}, {U64(0x857fcae6, 0x2d8493a5),  -372},
+    {U64(0xa6dfbd9f, 0xb8e5b88e),  -369}, {U64(0xd097ad07, 0xa71f26b2),  -366},
+    {U64(0x825ecc24, 0xc873782f),  -362}, {U64(0xa2f67f2d, 0xfa90563b),  -359},
+    {U64(0xcbb41ef9, 0x79346bca),  -356}, {U64(0xfea126b7, 0xd78186bc),  -353},
+    {U64(0x9f24b832, 0xe6b0f436),  -349}, {U64(0xc6ede63f, 0xa05d3143),  -346},
+    {U64(0xf8a95fcf, 0x88747d94),  -343}, {U64(0x9b69dbe1, 0xb548ce7c),  -339},
+    {U64(0xc24452da, 0x229b021b),  -336}, {U64(0xf2d56790, 0xab41c2a2),  -333},
+    {U64(0x97c560ba, 0x6b0919a5),  -329}, {U64(0xbdb6b8e9, 0x05cb600f),  -326},
+    {U64(0xed246723, 0x473e3813),  -323}, {U64(0x9436c076, 0x0c86e30b),  -319},
+    {U64(0xb9447093, 0x8fa89bce),  -316}, {U64(0xe7958cb8, 0x7392c2c2),  -313},
+    {U64(0x90bd77f3, 0x483bb9b9),  -309}, {U64(0xb4ecd5f0, 0x1a4aa828),  -306},
+    {U64(0xe2280b6c, 0x20dd5232),  -303}, {U64(0x8d590723, 0x948a535f),  -299},
+    {U64(0xb0af48ec, 0x79ace837),  -296}, {U64(0xdcdb1b27, 0x98182244),  -293},
+    {U64(0x8a08f0f8, 0xbf0f156b),  -289}, {U64(0xac8b2d36, 0xeed2dac5),  -286},
+    {U64(0xd7adf884, 0xaa879177),  -283}, {U64(0x86ccbb52, 0xea94baea),  -279},
+    {U64(0xa87fea27, 0xa539e9a5),  -276}, {U64(0xd29fe4b1, 0x8e88640e),  -273},
+    {U64(0x83a3eeee, 0xf9153e89),  -269}, {U64(0xa48ceaaa, 0xb75a8e2b),  -266},
+    {U64(0xcdb02555, 0x653131b6),  -263}, {U64(0x808e1755, 0x5f3ebf11),  -259},
+    {U64(0xa0b19d2a, 0xb70e6ed6),  -256}, {U64(0xc8de0475, 0x64d20a8b),  -253},
+    {U64(0xfb158592, 0xbe068d2e),  -250}, {U64(0x9ced737b, 0xb6c4183d),  -246},
+    {U64(0xc428d05a, 0xa4751e4c),  -243}, {U64(0xf5330471, 0x4d9265df),  -240},
+    {U64(0x993fe2c6, 0xd07b7fab),  -236}, {U64(0xbf8fdb78, 0x849a5f96),  -233},
+    {U64(0xef73d256, 0xa5c0f77c),  -230}, {U64(0x95a86376, 0x27989aad),  -226},
+    {U64(0xbb127c53, 0xb17ec159),  -223}, {U64(0xe9d71b68, 0x9dde71af),  -220},
+    {U64(0x92267121, 0x62ab070d),  -216}, {U64(0xb6b00d69, 0xbb55c8d1),  -213},
+    {U64(0xe45c10c4, 0x2a2b3b05),  -210}, {U64(0x8eb98a7a, 0x9a5b04e3),  -206},
+    {U64(0xb267ed19, 0x40f1c61c),  -203}, {U64(0xdf01e85f, 0x912e37a3),  -200},
+    {U64(0x8b61313b, 0xbabce2c6),  -196}, {U64(0xae397d8a, 0xa96c1b77),  -193},
+    {U64(0xd9c7dced, 0x53c72255),  -190}, {U64(0x881cea14, 0x545c7575),  -186},
+    {U64(0xaa242499, 0x697392d2),  -183}, {U64(0xd4ad2dbf, 0xc3d07787),  -180},
+    {U64(0x84ec3c97, 0xda624ab4),  -176}, {U64(0xa6274bbd, 0xd0fadd61),  -173},
+    {U64(0xcfb11ead, 0x453994ba),  -170}, {U64(0x81ceb32c, 0x4b43fcf4),  -166},
+    {U64(0xa2425ff7, 0x5e14fc31),  -163}, {U64(0xcad2f7f5, 0x359a3b3e),  -160},
+    {U64(0xfd87b5f2, 0x8300ca0d),  -157}, {U64(0x9e74d1b7, 0x91e07e48),  -153},
+    {U64(0xc6120625, 0x76589dda),  -150}, {U64(0xf79687ae, 0xd3eec551),  -147},
+    {U64(0x9abe14cd, 0x44753b52),  -143}, {U64(0xc16d9a00, 0x95928a27),  -140},
+    {U64(0xf1c90080, 0xbaf72cb1),  -137}, {U64(0x971da050, 0x74da7bee),  -133},
+    {U64(0xbce50864, 0x92111aea),  -130}, {U64(0xec1e4a7d, 0xb69561a5),  -127},
+    {U64(0x9392ee8e, 0x921d5d07),  -123}, {U64(0xb877aa32, 0x36a4b449),  -120},
+    {U64(0xe69594be, 0xc44de15b),  -117}, {U64(0x901d7cf7, 0x3ab0acd9),  -113},
+    {U64(0xb424dc35, 0x095cd80f),  -110}, {U64(0xe12e1342, 0x4bb40e13),  -107},
+    {U64(0x8cbccc09, 0x6f5088cb),  -103}, {U64(0xafebff0b, 0xcb24aafe),  -100},
+    {U64(0xdbe6fece, 0xbdedd5be),   -97}, {U64(0x89705f41, 0x36b4a597),   -93},
+    {U64(0xabcc7711, 0x8461cefc),   -90}, {U64(0xd6bf94d5, 0xe57a42bc),   -87},
+    {U64(0x8637bd05, 0xaf6c69b5),   -83}, {U64(0xa7c5ac47, 0x1b478423),   -80},
+    {U64(0xd1b71758, 0xe219652b),   -77}, {U64(0x83126e97, 0x8d4fdf3b),   -73},
+    {U64(0xa3d70a3d, 0x70a3d70a),   -70}, {U64(0xcccccccc, 0xcccccccc),   -67},
+    {U64(0x80000000, 0x00000000),   -63}, {U64(0xa0000000, 0x00000000),   -60},
+    {U64(0xc8000000, 0x00000000),   -57}, {U64(0xfa000000, 0x00000000),   -54},
+    {U64(0x9c400000, 0x00000000),   -50}, {U64(0xc3500000, 0x00000000),   -47},
+    {U64(0xf4240000, 0x00000000),   -44}, {U64(0x98968000, 0x00000000),   -40},
+    {U64(0xbebc2000, 0x00000000),   -37}, {U64(0xee6b2800, 0x00000000),   -34},
+    {U64(0x9502f900, 0x00000000),   -30}, {U64(0xba43b740, 0x00000000),   -27},
+    {U64(0xe8d4a510, 0x00000000),   -24}, {U64(0x9184e72a, 0x00000000),   -20},
+    {U64(0xb5e620f4, 0x80000000),   -17}, {U64(0xe35fa931, 0xa0000000),   -14},
+    {U64(0x8e1bc9bf, 0x04000000),   -10}, {U64(0xb1a2bc2e, 0xc5000000),    -7},
+    {U64(0xde0b6b3a, 0x76400000),    -4}, {U64(0x8ac72304, 0x89e80000),     0},
+    {U64(0xad78ebc5, 0xac620000),     3}, {U64(0xd8d726b7, 0x177a8000),     6},
+    {U64(0x87867832, 0x6eac9000),    10}, {U64(0xa968163f, 0x0a57b400),    13},
+    {U64(0xd3c21bce, 0xcceda100),    16}, {U64(0x84595161, 0x401484a0),    20},
+    {U64(0xa56fa5b9, 0x9019a5c8),    23}, {U64(0xcecb8f27, 0xf4200f3a),    26},
+    {U64(0x813f3978, 0xf8940984),    30}, {U64(0xa18f07d7, 0x36b90be5),    33},
+    {U64(0xc9f2c9cd, 0x04674ede),    36}, {U64(0xfc6f7c40, 0x45812296),    39},
+    {U64(0x9dc5ada8, 0x2b70b59d),    43}, {U64(0xc5371912, 0x364ce305),    46},
+    {U64(0xf684df56, 0xc3e01bc6),    49}, {U64(0x9a130b96, 0x3a6c115c),    53},
+    {U64(0xc097ce7b, 0xc90715b3),    56}, {U64(0xf0bdc21a, 0xbb48db20),    59},
+    {U64(0x96769950, 0xb50d88f4),    63}, {U64(0xbc143fa4, 0xe250eb31),    66},
+    {U64(0xeb194f8e, 0x1ae525fd),    69}, {U64(0x92efd1b8, 0xd0cf37be),    73},
+    {U64(0xb7abc627, 0x050305ad),    76}, {U64(0xe596b7b0, 0xc643c719),    79},
+    {U64(0x8f7e32ce, 0x7bea5c6f),    83}, {U64(0xb35dbf82, 0x1ae4f38b),    86},
+    {U64(0xe0352f62, 0xa19e306e),    89}, {U64(0x8c213d9d, 0xa502de45),    93},
+    {U64(0xaf298d05, 0x0e4395d6),    96}, {U64(0xdaf3f046, 0x51d47b4c),    99},
+    {U64(0x88d8762b, 0xf324cd0f),   103}, {U64(0xab0e93b6, 0xefee0053),   106},
+    {U64(0xd5d238a4, 0xabe98068),   109}, {U64(0x85a36366, 0xeb71f041),   113},
+    {U64(0xa70c3c40, 0xa64e6c51),   116}, {U64(0xd0cf4b50, 0xcfe20765),   119},
+    {U64(0x82818f12, 0x81ed449f),   123}, {U64(0xa321f2d7, 0x226895c7),   126},
+    {U64(0xcbea6f8c, 0xeb02bb39),   129}, {U64(0xfee50b70, 0x25c36a08),   132},
+    {U64(0x9f4f2726, 0x179a2245),   136}, {U64(0xc722f0ef, 0x9d80aad6),   139},
+    {U64(0xf8ebad2b, 0x84e0d58b),   142}, {U64(0x9b934c3b, 0x330c8577),   146},
+    {U64(0xc2781f49, 0xffcfa6d5),   149}, {U64(0xf316271c, 0x7fc3908a),   152},
+    {U64(0x97edd871, 0xcfda3a56),   156}, {U64(0xbde94e8e, 0x43d0c8ec),   159},
+    {U64(0xed63a231, 0xd4c4fb27),   162}, {U64(0x945e455f, 0x24fb1cf8),   166},
+    {U64(0xb975d6b6, 0xee39e436),   169}, {U64(0xe7d34c64, 0xa9c85d44),   172},
+    {U64(0x90e40fbe, 0xea1d3a4a),   176}, {U64(0xb51d13ae, 0xa4a488dd),   179},
+    {U64(0xe264589a, 0x4dcdab14),   182}, {U64(0x8d7eb760, 0x70a08aec),   186},
+    {U64(0xb0de6538, 0x8cc8ada8),   189}, {U64(0xdd15fe86, 0xaffad912),   192},
+    {U64(0x8a2dbf14, 0x2dfcc7ab),   196}, {U64(0xacb92ed9, 0x397bf996),   199},
+    {U64(0xd7e77a8f, 0x87daf7fb),   202}, {U64(0x86f0ac99, 0xb4e8dafd),   206},
+    {U64(0xa8acd7c0, 0x222311bc),   209}, {U64(0xd2d80db0, 0x2aabd62b),   212},
+    {U64(0x83c7088e, 0x1aab65db),   216}, {U64(0xa4b8cab1, 0xa1563f52),   219},
+    {U64(0xcde6fd5e, 0x09abcf26),   222}, {U64(0x80b05e5a, 0xc60b6178),   226},
+    {U64(0xa0dc75f1, 0x778e39d6),   229}, {U64(0xc913936d, 0xd571c84c),   232},
+    {U64(0xfb587849, 0x4ace3a5f),   235}, {U64(0x9d174b2d, 0xcec0e47b),   239},
+    {U64(0xc45d1df9, 0x42711d9a),   242}, {U64(0xf5746577, 0x930d6500),   245},
+    {U64(0x9968bf6a, 0xbbe85f20),   249}, {U64(0xbfc2ef45, 0x6ae276e8),   252},
+    {U64(0xefb3ab16, 0xc59b14a2),   255}, {U64(0x95d04aee, 0x3b80ece5),   259},
+    {U64(0xbb445da9, 0xca61281f),   262}, {U64(0xea157514, 0x3cf97226),   265},
+    {U64(0x924d692c, 0xa61be758),   269}, {U64(0xb6e0c377, 0xcfa2e12e),   272},
+    {U64(0xe498f455, 0xc38b997a),   275}, {U64(0x8edf98b5, 0x9a373fec),   279},
+    {U64(0xb2977ee3, 0x00c50fe7),   282}, {U64(0xdf3d5e9b, 0xc0f653e1),   285},
+    {U64(0x8b865b21, 0x5899f46c),   289}, {U64(0xae67f1e9, 0xaec07187),   292},
+    {U64(0xda01ee64, 0x1a708de9),   295}, {U64(0x884134fe, 0x908658b2),   299},
+    {U64(0xaa51823e, 0x34a7eede),   302}, {U64(0xd4e5e2cd, 0xc1d1ea96),   305},
+    {U64(0x850fadc0, 0x9923329e),   309}, {U64(0xa6539930, 0xbf6bff45),   312},
+    {U64(0xcfe87f7c, 0xef46ff16),   315}, {U64(0x81f14fae, 0x158c5f6e),   319},
+    {U64(0xa26da399, 0x9aef7749),   322}, {U64(0xcb090c80, 0x01ab551c),   325},
+    {U64(0xfdcb4fa0, 0x02162a63),   328}, {U64(0x9e9f11c4, 0x014dda7e),   332},
+    {U64(0xc646d635, 0x01a1511d),   335}, {U64(0xf7d88bc2, 0x4209a565),   338},
+    {U64(0x9ae75759, 0x6946075f),   342}, {U64(0xc1a12d2f, 0xc3978937),   345},
+    {U64(0xf209787b, 0xb47d6b84),   348}, {U64(0x9745eb4d, 0x50ce6332),   352},
+    {U64(0xbd176620, 0xa501fbff),   355}, {U64(0xec5d3fa8, 0xce427aff),   358},
+    {U64(0x93ba47c9, 0x80e98cdf),   362}, {U64(0xb8a8d9bb, 0xe123f017),   365},
+    {U64(0xe6d3102a, 0xd96cec1d),   368}, {U64(0x9043ea1a, 0xc7e41392),   372},
+    {U64(0xb454e4a1, 0x79dd1877),   375}, {U64(0xe16a1dc9, 0xd8545e94),   378},
+    {U64(0x8ce2529e, 0x2734bb1d),   382}, {U64(0xb01ae745, 0xb101e9e4),   385},
+    {U64(0xdc21a117, 0x1d42645d),   388}, {U64(0x899504ae, 0x72497eba),   392},
+    {U64(0xabfa45da, 0x0edbde69),   395}, {U64(0xd6f8d750, 0x9292d603),   398},
+    {U64(0x865b8692, 0x5b9bc5c2),   402}, {U64(0xa7f26836, 0xf282b732),   405},
+    {U64(0xd1ef0244, 0xaf2364ff),   408}, {U64(0x8335616a, 0xed761f1f),   412},
+    {U64(0xa402b9c5, 0xa8d3a6e7),   415}, {U64(0xcd036837, 0x130890a1),   418},
+    {U64(0x80222122, 0x6be55a64),   422}, {U64(0xa02aa96b, 0x06deb0fd),   425},
+    {U64(0xc83553c5, 0xc8965d3d),   428}, {U64(0xfa42a8b7, 0x3abbf48c),   431},
+    {U64(0x9c69a972, 0x84b578d7),   435}, {U64(0xc38413cf, 0x25e2d70d),   438},
+    {U64(0xf46518c2, 0xef5b8cd1),   441}, {U64(0x98bf2f79, 0xd5993802),   445},
+    {U64(0xbeeefb58, 0x4aff8603),   448}, {U64(0xeeaaba2e, 0x5dbf6784),   451},
+    {U64(0x952ab45c, 0xfa97a0b2),   455}, {U64(0xba756174, 0x393d88df),   458},
+    {U64(0xe912b9d1, 0x478ceb17),   461}, {U64(0x91abb422, 0xccb812ee),   465},
+    {U64(0xb616a12b, 0x7fe617aa),   468}, {U64(0xe39c4976, 0x5fdf9d94),   471},
+    {U64(0x8e41ade9, 0xfbebc27d),   475}, {U64(0xb1d21964, 0x7ae6b31c),   478},
+    {U64(0xde469fbd, 0x99a05fe3),   481}, {U64(0x8aec23d6, 0x80043bee),   485},
+    {U64(0xada72ccc, 0x20054ae9),   488}, {U64(0xd910f7ff, 0x28069da4),   491},
+    {U64(0x87aa9aff, 0x79042286),   495}, {U64(0xa99541bf, 0x57452b28),   498},
+    {U64(0xd3fa922f, 0x2d1675f2),   501}, {U64(0x847c9b5d, 0x7c2e09b7),   505},
+    {U64(0xa59bc234, 0xdb398c25),   508}, {U64(0xcf02b2c2, 0x1207ef2e),   511},
+    {U64(0x8161afb9, 0x4b44f57d),   515}, {U64(0xa1ba1ba7, 0x9e1632dc),   518},
+    {U64(0xca28a291, 0x859bbf93),   521}, {U64(0xfcb2cb35, 0xe702af78),   524},
+    {U64(0x9defbf01, 0xb061adab),   528}, {U64(0xc56baec2, 0x1c7a1916),   531},
+    {U64(0xf6c69a72, 0xa3989f5b),   534}, {U64(0x9a3c2087, 0xa63f6399),   538},
+    {U64(0xc0cb28a9, 0x8fcf3c7f),   541}, {U64(0xf0fdf2d3, 0xf3c30b9f),   544},
+    {U64(0x969eb7c4, 0x7859e743),   548}, {U64(0xbc4665b5, 0x96706114),   551},
+    {U64(0xeb57ff22, 0xfc0c7959),   554}, {U64(0x9316ff75, 0xdd87cbd8),   558},
+    {U64(0xb7dcbf53, 0x54e9bece),   561}, {U64(0xe5d3ef28, 0x2a242e81),   564},
+    {U64(0x8fa47579, 0x1a569d10),   568}, {U64(0xb38d92d7, 0x60ec4455),   571},
+    {U64(0xe070f78d, 0x3927556a),   574}, {U64(0x8c469ab8, 0x43b89562),   578},
+    {U64(0xaf584166, 0x54a6babb),   581}, {U64(0xdb2e51bf, 0xe9d0696a),   584},
+    {U64(0x88fcf317, 0xf22241e2),   588}, {U64(0xab3c2fdd, 0xeeaad25a),   591},
+    {U64(0xd60b3bd5, 0x6a5586f1),   594}, {U64(0x85c70565, 0x62757456),   598},
+    {U64(0xa738c6be, 0xbb12d16c),   601}, {U64(0xd106f86e, 0x69d785c7),   604},
+    {U64(0x82a45b45, 0x0226b39c),   608}, {U64(0xa34d7216, 0x42b06084),   611},
+    {U64(0xcc20ce9b, 0xd35c78a5),   614}, {U64(0xff290242, 0xc83396ce),   617},
+    {U64(0x9f79a169, 0xbd203e41),   621}, {U64(0xc75809c4, 0x2c684dd1),   624},
+    {U64(0xf92e0c35, 0x37826145),   627}, {U64(0x9bbcc7a1, 0x42b17ccb),   631},
+    {U64(0xc2abf989, 0x935ddbfe),   634}, {U64(0xf356f7eb, 0xf83552fe),   637},
+    {U64(0x98165af3, 0x7b2153de),   641}, {U64(0xbe1bf1b0, 0x59e9a8d6),   644},
+    {U64(0xeda2ee1c, 0x7064130c),   647}, {U64(0x9485d4d1, 0xc63e8be7),   651},
+    {U64(0xb9a74a06, 0x37ce2ee1),   654}, {U64(0xe8111c87, 0xc5c1ba99),   657},
+    {U64(0x910ab1d4, 0xdb9914a0),   661}, {U64(0xb54d5e4a, 0x127f59c8),   664},
+    {U64(0xe2a0b5dc, 0x971f303a),   667}, {U64(0x8da471a9, 0xde737e24),   671},
+    {U64(0xb10d8e14, 0x56105dad),   674}, {U64(0xdd50f199, 0x6b947518),   677},
+    {U64(0x8a5296ff, 0xe33cc92f),   681}, {U64(0xace73cbf, 0xdc0bfb7b),   684},
+    {U64(0xd8210bef, 0xd30efa5a),   687}, {U64(0x8714a775, 0xe3e95c78),   691},
+    {U64(0xa8d9d153, 0x5ce3b396),   694}, {U64(0xd31045a8, 0x341ca07c),   697},
+    {U64(0x83ea2b89, 0x2091e44d),   701}, {U64(0xa4e4b66b, 0x68b65d60),   704},
+    {U64(0xce1de406, 0x42e3f4b9),   707}, {U64(0x80d2ae83, 0xe9ce78f3),   711},
+    {U64(0xa1075a24, 0xe4421730),   714}, {U64(0xc94930ae, 0x1d529cfc),   717},
+    {U64(0xfb9b7cd9, 0xa4a7443c),   720}, {U64(0x9d412e08, 0x06e88aa5),   724},
+    {U64(0xc491798a, 0x08a2ad4e),   727}, {U64(0xf5b5d7ec, 0x8acb58a2),   730},
+    {U64(0x9991a6f3, 0xd6bf1765),   734}, {U64(0xbff610b0, 0xcc6edd3f),   737},
+    {U64(0xeff394dc, 0xff8a948e),   740}, {U64(0x95f83d0a, 0x1fb69cd9),   744},
+    {U64(0xbb764c4c, 0xa7a4440f),   747}, {U64(0xea53df5f, 0xd18d5513),   750},
+    {U64(0x92746b9b, 0xe2f8552c),   754}, {U64(0xb7118682, 0xdbb66a77),   757},
+    {U64(0xe4d5e823, 0x92a40515),   760}, {U64(0x8f05b116, 0x3ba6832d),   764},
+    {U64(0xb2c71d5b, 0xca9023f8),   767}, {U64(0xdf78e4b2, 0xbd342cf6),   770},
+    {U64(0x8bab8eef, 0xb6409c1a),   774}, {U64(0xae9672ab, 0xa3d0c320),   777},
+    {U64(0xda3c0f56, 0x8cc4f3e8),   780}, {U64(0x88658996, 0x17fb1871),   784},
+    {U64(0xaa7eebfb, 0x9df9de8d),   787}, {U64(0xd51ea6fa, 0x85785631),   790},
+    {U64(0x8533285c, 0x936b35de),   794}, {U64(0xa67ff273, 0xb8460356),   797},
+    {U64(0xd01fef10, 0xa657842c),   800}, {U64(0x8213f56a, 0x67f6b29b),   804},
+    {U64(0xa298f2c5, 0x01f45f42),   807}, {U64(0xcb3f2f76, 0x42717713),   810},
+    {U64(0xfe0efb53, 0xd30dd4d7),   813}, {U64(0x9ec95d14, 0x63e8a506),   817},
+    {U64(0xc67bb459, 0x7ce2ce48),   820}, {U64(0xf81aa16f, 0xdc1b81da),   823},
+    {U64(0x9b10a4e5, 0xe9913128),   827}, {U64(0xc1d4ce1f, 0x63f57d72),   830},
+    {U64(0xf24a01a7, 0x3cf2dccf),   833}, {U64(0x976e4108, 0x8617ca01),   837},
+    {U64(0xbd49d14a, 0xa79dbc82),   840}, {U64(0xec9c459d, 0x51852ba2),   843},
+    {U64(0x93e1ab82, 0x52f33b45),   847}, {U64(0xb8da1662, 0xe7b00a17),   850},
+    {U64(0xe7109bfb, 0xa19c0c9d),   853}, {U64(0x906a617d, 0x450187e2),   857},
+    {U64(0xb484f9dc, 0x9641e9da),   860}, {U64(0xe1a63853, 0xbbd26451),   863},
+    {U64(0x8d07e334, 0x55637eb2),   867}, {U64(0xb049dc01, 0x6abc5e5f),   870},
+    {U64(0xdc5c5301, 0xc56b75f7),   873}, {U64(0x89b9b3e1, 0x1b6329ba),   877},
+    {U64(0xac2820d9, 0x623bf429),   880}, {U64(0xd732290f, 0xbacaf133),   883},
+    {U64(0x867f59a9, 0xd4bed6c0),   887}, {U64(0xa81f3014, 0x49ee8c70),   890},
+    {U64(0xd226fc19, 0x5c6a2f8c),   893}, {U64(0x83585d8f, 0xd9c25db7),   897},
+    {U64(0xa42e74f3, 0xd032f525),   900}, {U64(0xcd3a1230, 0xc43fb26f),   903},
+    {U64(0x80444b5e, 0x7aa7cf85),   907}, {U64(0xa0555e36, 0x1951c366),   910},
+    {U64(0xc86ab5c3, 0x9fa63440),   913}, {U64(0xfa856334, 0x878fc150),   916},
+    {U64(0x9c935e00, 0xd4b9d8d2),   920}, {U64(0xc3b83581, 0x09e84f07),   923},
+    {U64(0xf4a642e1, 0x4c6262c8),   926}, {U64(0x98e7e9cc, 0xcfbd7dbd),   930},
+    {U64(0xbf21e440, 0x03acdd2c),   933}, {U64(0xeeea5d50, 0x04981478),   936},
+    {U64(0x95527a52, 0x02df0ccb),   940}, {U64(0xbaa718e6, 0x8396cffd),   943},
+    {U64(0xe950df20, 0x247c83fd),   946}, {U64(0x91d28b74, 0x16cdd27e),   950},
+    {U64(0xb6472e51, 0x1c81471d),   953}, {U64(0xe3d8f9e5, 0x63a198e5),   956},
+    {U64(0x8e679c2f, 0x5e44ff8f),   960}, {U64(0xb201833b, 0x35d63f73),   963},
+    {U64(0xde81e40a, 0x034bcf4f),   966}, {U64(0x8b112e86, 0x420f6191),   970},
+    {U64(0xadd57a27, 0xd29339f6),   973}, {U64(0xd94ad8b1, 0xc7380874),   976},
+    {U64(0x87cec76f, 0x1c830548),   980}, {U64(0xa9c2794a, 0xe3a3c69a),   983},
+    {U64(0xd433179d, 0x9c8cb841),   986}, {U64(0x849feec2, 0x81d7f328),   990},
+    {U64(0xa5c7ea73, 0x224deff3),   993}, {U64(0xcf39e50f, 0xeae16bef),   996},
+    {U64(0x81842f29, 0xf2cce375),  1000}, {U64(0xa1e53af4, 0x6f801c53),  1003},
+    {U64(0xca5e89b1, 0x8b602368),  1006}, {U64(0xfcf62c1d, 0xee382c42),  1009},
+    {U64(0x9e19db92, 0xb4e31ba9),  1013},
+};
+
+/* Return the high 64 bits of a * b, and store the low 64 bits in *lop. */
+static uint64
+MulHigh(uint64 a, uint64 b, uint64 *lop)
+{
+    uint64 ll, lh, hl, hh, mid;
+
+    ll = LO32(a) * LO32(b);
+    lh = LO32(a) * (b >> 32);
+    hl = (a >> 32) * LO32(b);
+    hh = (a >> 32) * (b >> 32);
+    mid = (ll >> 32) + LO32(lh) + LO32(hl);
+    *lop = (mid << 32) | LO32(ll);
+    return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* Multiply x by c, rounding the 128-bit product to its high 64 bits. */
+static DiyFp
+Times(DiyFp x, const PowerOfTen *c)
+{
+    uint64 lo, hi;
+    DiyFp r;
+
+    hi = MulHigh(x.f, c->f, &lo);
+    r.f = hi + (lo >> 63);
+    r.e = x.e + c->e + 64;
+    return r;
+}
+
+static void
+Normalize(DiyFp *x)
+{
+    while (!(x->f & U64(0xffc00000, 0))) {
+	x->f <<= 10;
+	x->e -= 10;
+    }
+    while (!(x->f & DBL_SIGN_BIT)) {
+	x->f <<= 1;
+	x->e--;
+    }
+}
+
+/*
+ * The scaled double w and its boundaries are off from their true values
+ * by less than one unit of rounding in Times, plus w.f times the error in
+ * the truncated power of ten, which is under one unit: less than 1.5 in
+ * all.  Grisu3 calls this error bound "unit".
+ */
+#define GRISU_UNIT      2
+
+/*
+ * Grisu3's RoundWeed: digits[0..n-1] and rest are within the unsafe
+ * interval, which is the true one widened by unit on each side.  Move the
+ * last digit down toward w while that keeps it in the interval and brings
+ * it closer, then fail if the result might not be the closest candidate or
+ * might lie outside the true interval.  Like rest, which is too_high less
+ * the digits' value, distance is measured down from too_high, the top of
+ * the unsafe interval, to w.
+ */
+static JSBool
+RoundWeed(char *digits, intN n, uint64 distance, uint64 unsafe,
+	  uint64 rest, uint64 ten_kappa, uint64 unit)
+{
+    uint64 dlow, dhigh;
+
+    dlow = distance - unit;
+    dhigh = distance + unit;
+    while (rest < dlow &&
+	   unsafe - rest >= ten_kappa &&
+	   (rest + ten_kappa < dlow ||
+	    dlow - rest >= rest + ten_kappa - dlow)) {
+	digits[n - 1]--;
+	rest += ten_kappa;
+    }
+    if (rest < dhigh &&
+	unsafe - rest >= ten_kappa &&
+	(rest + ten_kappa < dhigh ||
+	 dhigh - rest > rest + ten_kappa - dhigh)) {
+	return JS_FALSE;
+    }
+    return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+/*
+ * Grisu3's DigitGen: generate the shortest digits of too_high that leave a
+ * remainder within the unsafe interval, where w.e is in [-60, -32] so that
+ * the integral part of each scaled value fits in 32 bits.
+ */
+static JSBool
+DigitGen(DiyFp lo, DiyFp w, DiyFp hi, char *digits, intN *ndigitsp,
+	 intN *kappap)
+{
+    uint64 scale, unit, too_high, unsafe, one, fractionals, rest;
+    uint32 integrals, divisor;
+    intN shift, kappa, n;
+
+    scale = 1;
+    unit = GRISU_UNIT;
+    if (hi.f + unit < hi.f)
+	return JS_FALSE;
+    too_high = hi.f + unit;
+    unsafe = too_high - (lo.f - unit);
+    shift = -w.e;
+    one = (uint64)1 << shift;
+    integrals = (uint32)(too_high >> shift);
+    fractionals = too_high & (one - 1);
+
+    /* Find the biggest power of ten no greater than integrals. */
+    kappa = 0;
+    divisor = 1;
+    if (integrals != 0) {
+	kappa = 1;
+	while (kappa < 10 && integrals / divisor >= 10) {
+	    divisor *= 10;
+	    kappa++;
+	}
+    }
+
+    n = 0;
+    while (kappa > 0) {
+	digits[n++] = (char)('0' + integrals / divisor);
+	integrals %= divisor;
+	kappa--;
+	rest = ((uint64)integrals << shift) + fractionals;
+	if (rest < unsafe) {
+	    *ndigitsp = n;
+	    *kappap = kappa;
+	    return RoundWeed(digits, n, too_high - w.f, unsafe, rest,
+			     (uint64)divisor << shift, unit);
+	}
+	divisor /= 10;
+    }
+    for (;;) {
+	if (n == JS_DTOA_DIGITS - 1)
+	    return JS_FALSE;
+	fractionals *= 10;
+	scale *= 10;
+	unit *= 10;
+	unsafe *= 10;
+	digits[n++] = (char)('0' + (intN)(fractionals >> shift));
+	fractionals &= one - 1;
+	kappa--;
+	if (fractionals < unsafe) {
+	    *ndigitsp = n;
+	    *kappap = kappa;
+	    return RoundWeed(digits, n, (too_high - w.f) * scale, unsafe,
+			     fractionals, one, unit);
+	}
+    }
+}
+
+JSBool
+js_FastDtoa(jsdouble d, char *digits, intN *ndigitsp, intN *decptp)
+{
+    DoubleBits u;
+    DiyFp w, lo, hi;
+    intN be, mk, n, kappa;
+    const PowerOfTen *c;
+
+    u.d = d;
+    PR_ASSERT(d > 0 && JSDOUBLE_IS_FINITE(d));
+    be = (intN)(u.u >> 52);
+    w.f = u.u & DBL_MANT_MASK;
+    if (be == 0) {
+	w.e = 1 - 1075;
+    } else {
+	w.f |= DBL_HIDDEN_BIT;
+	w.e = be - 1075;
+    }
+
+    /*
+     * The boundaries are halfway to the neighboring doubles.  The lower one
+     * is closer when w.f is a power of two, unless w is the least normal.
+     */
+    hi.f = (w.f << 1) + 1;
+    hi.e = w.e - 1;
+    Normalize(&hi);
+    if (w.f == DBL_HIDDEN_BIT && be > 1) {
+	lo.f = (w.f << 2) - 1;
+	lo.e = w.e - 2;
+    } else {
+	lo.f = (w.f << 1) - 1;
+	lo.e = w.e - 1;
+    }
+    lo.f <<= lo.e - hi.e;
+    lo.e = hi.e;
+    Normalize(&w);
+    PR_ASSERT(w.e == hi.e);
+
+    /* Choose 10^mk to bring the scaled exponent into [-60, -32]. */
+    mk = (intN)ceil((-61 - w.e) * 0.30102999566398114);
+    PR_ASSERT(POW10_MIN <= mk && mk <= POW10_MAX);
+    c = &powers_of_ten[mk - POW10_MIN];
+    w = Times(w, c);
+    PR_ASSERT(-60 <= w.e && w.e <= -32);
+    if (!DigitGen(Times(lo, c), w, Times(hi, c), digits, &n, &kappa))
+	return JS_FALSE;
+
+    /* Weeding can leave a trailing zero; PR_dtoa never does. */
+    while (n > 1 && digits[n - 1] == '0') {
+	n--;
+	kappa++;
+    }
+    if (digits[0] == '0')
+	return JS_FALSE;
+    digits[n] = '\0';
+    *ndigitsp = n;
+    *decptp = n + kappa - mk;
+    return JS_TRUE;
+}
+
+/* Powers of ten exactly representable as doubles. */
+static const jsdouble exact_tens[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define EXACT_TENS_MAX  22
+
+/* PR_strtod does exact double arithmetic for up to DBL_DIG digits. */
+#define DBL_DIG_EXACT   15
+
+#define MAX_SIG_DIGITS  19      /* as many as fit in a uint64 */
+
+#define IS_STRTOD_SPACE(c)                                                    \
+    ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\v' ||               \
+     (c) == '\f' || (c) == '\r')
+
+JSBool
+js_FastStrtod(const jschar *s, jschar **ep, jsdouble *dp)
+{
+    const jschar *cp, *mark;
+    JSBool neg, sawdigit;
+    uint64 w, lo, hi, m;
+    intN nd, q, e10, esign, lz, upper, be;
+    const PowerOfTen *c;
+    DoubleBits u;
+
+    cp = s;
+    while (IS_STRTOD_SPACE(*cp))
+	cp++;
+    neg = (*cp == '-');
+    if (neg || *cp == '+')
+	cp++;
+
+    /*
+     * Accumulate up to MAX_SIG_DIGITS significant digits, not counting
+     * leading zeros, in w, and scale by 10^q.  Zeros past those digits only
+     * scale; other digits need PR_strtod's bignums.
+     */
+    w = 0;
+    nd = q = 0;
+    sawdigit = JS_FALSE;
+    for (; JS7_ISDEC(*cp); cp++) {
+	sawdigit = JS_TRUE;
+	if (w == 0 && *cp == '0')
+	    continue;
+	if (nd == MAX_SIG_DIGITS) {
+	    if (*cp != '0')
+		return JS_FALSE;
+	    q++;
+	    continue;
+	}
+	w = w * 10 + JS7_UNDEC(*cp);
+	nd++;
+    }
+    if (*cp == '.') {
+	for (cp++; JS7_ISDEC(*cp); cp++) {
+	    sawdigit = JS_TRUE;
+	    if (w == 0 && *cp == '0') {
+		q--;
+		continue;
+	    }
+	    if (nd == MAX_SIG_DIGITS) {
+		if (*cp != '0')
+		    return JS_FALSE;
+		continue;
+	    }
+	    q--;
+	    w = w * 10 + JS7_UNDEC(*cp);
+	    nd++;
+	}
+    }
+    if (!sawdigit)
+	return JS_FALSE;
+
+    /* An exponent marker without digits isn't part of the number. */
+    if (*cp == 'e' || *cp == 'E') {
+	mark = cp++;
+	esign = 1;
+	if (*cp == '-') {
+	    esign = -1;
+	    cp++;
+	} else if (*cp == '+') {
+	    cp++;
+	}
+	if (JS7_ISDEC(*cp)) {
+	    e10 = 0;
+	    for (; JS7_ISDEC(*cp); cp++) {
+		if (e10 < 10000)
+		    e10 = e10 * 10 + JS7_UNDEC(*cp);
+	    }
+	    q += esign * e10;
+	} else {
+	    cp = mark;
+	}
+    }
+    *ep = (jschar *)cp;
+
+    if (w == 0) {
+	*dp = 0;
+	if (neg)
+	    *dp = -*dp;
+	return JS_TRUE;
+    }
+
+    /*
+     * With few enough digits, do as PR_strtod does: one correctly rounded
+     * multiply or divide of exactly representable doubles.
+     */
+    if (nd <= DBL_DIG_EXACT && -EXACT_TENS_MAX <= q && q <= EXACT_TENS_MAX) {
+	*dp = (jsdouble)(int64)w;
+	if (q < 0)
+	    *dp /= exact_tens[-q];
+	else
+	    *dp *= exact_tens[q];
+	if (neg)
+	    *dp = -*dp;
+	return JS_TRUE;
+    }
+
+    /* Leave overflow and underflow to PR_strtod, which sets errno. */
+    if (q < POW10_MIN || q > 308)
+	return JS_FALSE;
+
+    /*
+     * Eisel-Lemire: normalize w and take the high 64 bits of w * 10^q, of
+     * which the top 54 are the significand and a rounding bit.  The power
+     * may be short by under one unit, so the true product may exceed the
+     * computed one by less than w.  Give up if that could carry into the
+     * bits we keep.
+     */
+    lz = 0;
+    while (!(w & DBL_SIGN_BIT)) {
+	w <<= 1;
+	lz++;
+    }
+    c = &powers_of_ten[q - POW10_MIN];
+    hi = MulHigh(w, c->f, &lo);
+    if ((q < 0 || q > POW10_EXACT_MAX) &&
+	(hi & 0x1ff) == 0x1ff && lo + w < lo) {
+	return JS_FALSE;
+    }
+    upper = (intN)(hi >> 63);
+    m = hi >> (upper + 9);
+
+    /*
+     * Round half up, or to even when an exact product is a tie.  Inexact
+     * products can't be ties: they're short of a true value that isn't.
+     */
+    if (q >= 0 && q <= POW10_EXACT_MAX && lo == 0 &&
+	(hi & (((uint64)1 << (upper + 9)) - 1)) == 0 && (m & 3) == 1) {
+	m--;
+    }
+    m = (m + (m & 1)) >> 1;
+    be = c->e + 64 + upper + 10 + 52 - lz + 1023;
+    if (m == DBL_HIDDEN_BIT << 1) {
+	m = DBL_HIDDEN_BIT;
+	be++;
+    }
+
+    /* Leave subnormals and infinities to PR_strtod. */
+    if (be <= 0 || be >= 0x7ff)
+	return JS_FALSE;
+    u.u = ((uint64)be << 52) | (m & DBL_MANT_MASK);
+    if (neg)
+	u.u |= DBL_SIGN_BIT;
+    *dp = u.d;
+    return JS_TRUE;
+}
+
+#endif /* JS_HAS_FAST_DTOA */
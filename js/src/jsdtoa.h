@@ -0,0 +1,80 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+#ifndef jsdtoa_h___
+#define jsdtoa_h___
+/*
+ * Fast double-to-decimal and decimal-to-double conversion.
+ *
+ * js_FastDtoa is Grisu3: it scales the double and its rounding boundaries
+ * by a cached power of ten into 64-bit fixed point, and generates the
+ * shortest digit string that lies strictly between the boundaries and is
+ * closest to the double.  js_FastStrtod is the Eisel-Lemire algorithm: it
+ * multiplies a 19-digit decimal significand by a 64-bit power of ten and
+ * rounds the high half of the product.
+ *
+ * Both work in 64-bit integer arithmetic with a known error, and return
+ * false instead of guessing when that error could change the answer (for
+ * about one double in 150, and for subnormals, overflow, and decimals of
+ * over 19 digits).  The caller then uses prdtoa.c, whose exact bignum code
+ * gives the same answer slowly: js_FastDtoa's digits are those of PR_dtoa
+ * mode 1, and js_FastStrtod's double is PR_strtod's.
+ */
+#include "jspubtd.h"
+
+PR_BEGIN_EXTERN_C
+
+#ifndef JS_HAS_FAST_DTOA
+#ifdef HAVE_LONG_LONG
+#define JS_HAS_FAST_DTOA        1
+#else
+#define JS_HAS_FAST_DTOA        0
+#endif
+#endif
+
+/* Enough for the 17 digits of the longest shortest double, and a NUL. */
+#define JS_DTOA_DIGITS          18
+
+#if JS_HAS_FAST_DTOA
+
+/*
+ * Store the shortest decimal digits of positive, finite, nonzero d in the
+ * JS_DTOA_DIGITS chars at digits, NUL terminated, and set *ndigitsp to
+ * their count and *decptp to the position of the decimal point relative to
+ * the first digit, as PR_dtoa(d, 1, ...) does.
+ */
+extern JSBool
+js_FastDtoa(jsdouble d, char *digits, intN *ndigitsp, intN *decptp);
+
+/*
+ * Parse the decimal number at s, after the same leading whitespace as
+ * PR_strtod skips, into *dp, and set *ep to the char after it.
+ */
+extern JSBool
+js_FastStrtod(const jschar *s, jschar **ep, jsdouble *dp);
+
+#else
+
+#define js_FastDtoa(d, digits, ndigitsp, decptp)        JS_FALSE
+#define js_FastStrtod(s, ep, dp)                        JS_FALSE
+
+#endif /* !JS_HAS_FAST_DTOA */
+
+PR_END_EXTERN_C
+
+#endif /* jsdtoa_h___ */
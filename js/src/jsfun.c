@@ -296,6 +296,7 @@ call_reflectArgument(JSContext *cx, JSObject *obj, JSStackFrame *fp,
 	ok = JS_FALSE;
     } else {
 	prop->id = INT_TO_JSVAL(slot);
+	PROPERTY_CHANGED(cx, prop);
 	scope = (JSScope *)obj->map;
 	ok = (scope->ops->add(cx, scope, INT_TO_JSVAL(slot), prop) != NULL);
     }
@@ -318,8 +319,10 @@ call_reflectVariable(JSContext *cx, JSObject *obj, JSStackFrame *fp,
 			     call_getVariable, call_setVariable,
 			     JSPROP_PERMANENT);
     ok = (prop != NULL);
-    if (ok)
+    if (ok) {
 	prop->id = INT_TO_JSVAL(slot);
+	PROPERTY_CHANGED(cx, prop);
+    }
     JS_UNLOCK(cx);
     return ok;
 }
@@ -501,13 +504,13 @@ Closure(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	fun = JS_ValueToFunction(cx, argv[0]);
 	if (!fun)
 	    return JS_FALSE;
-	OBJ_SET_PROTO(obj, fun->object);
+	OBJ_SET_PROTO(cx, obj, fun->object);
 	if (argc > 1) {
 	    if (!JS_ValueToObject(cx, argv[1], &closureParent))
 		return JS_FALSE;
 	}
     }
-    OBJ_SET_PARENT(obj, closureParent);
+    OBJ_SET_PARENT(cx, obj, closureParent);
 
     /* Make sure constructor is not inherited from fun->object. */
     if (!js_DefineProperty(cx, obj,
@@ -693,6 +696,8 @@ fun_finalize(JSContext *cx, JSObject *obj)
 	JS_LOCK_VOID(cx, js_DropAtom(cx, fun->atom));
     if (fun->script)
 	js_DestroyScript(cx, fun->script);
+    if (fun->lazy)
+	js_DestroyLazyFunction(cx, fun->lazy);
     JS_free(cx, fun);
 }
 
@@ -823,7 +828,7 @@ NewFunction(JSContext *cx, JSObject *obj, JSNative call, uintN nargs,
 	    return NULL;
 	}
     } else {
-	OBJ_SET_PARENT(obj, parent);
+	OBJ_SET_PARENT(cx, obj, parent);
     }
 
     /* Link fun to obj and vice versa. */
@@ -844,6 +849,7 @@ NewFunction(JSContext *cx, JSObject *obj, JSNative call, uintN nargs,
     else
 	fun->atom = NULL;
     fun->script = NULL;
+    fun->lazy = NULL;
     return fun;
 }
 
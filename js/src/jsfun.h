@@ -34,6 +34,7 @@ struct JSFunction {
     uint16       nvars;         /* number of local variables */
     JSAtom       *atom;         /* name for diagnostics and decompiling */
     JSScript     *script;       /* interpreted bytecode descriptor or null */
+    JSLazyFunction *lazy;       /* source of a body not yet compiled */
 };
 
 extern JSClass js_CallClass;
@@ -21,8 +21,14 @@
  *
  * This GC allocates only fixed-sized things big enough to contain two words
  * (pointers) on any host architecture.  It allocates from an arena pool (see
- * prarena.h).  It uses a parallel arena-pool array of flag bytes to hold the
- * mark bit, finalizer type index, etc.
+ * prarena.h).  Each arena holds a header and GC_THINGS_PER_ARENA things
+ * followed by their flag bytes, which hold the mark bit, finalizer type
+ * index, etc.
+ *
+ * Free things are kept on per-arena freelists, from which each context takes
+ * batches of GC_FREELIST_BATCH things onto its own freelist, so that
+ * js_AllocGCThing need not lock the runtime in the common case.  Collection
+ * is generational but non-moving, see GC_NURSERY_BYTES.
  *
  * XXX swizzle page to freelist for better locality of reference
  */
@@ -35,12 +41,15 @@
 #include "plarena.h"
 #endif
 #include "prlog.h"
+#include "prlong.h"
+#include "prmjtime.h"
 #ifndef NSPR20
 #include "prhash.h"
 #else
 #include "plhash.h"
 #endif
 #include "jsapi.h"
+#include "jsarray.h"
 #include "jsatom.h"
 #include "jscntxt.h"
 #include "jsgc.h"
@@ -52,14 +61,68 @@
 #include "jsstr.h"
 
 /*
- * Arena sizes, the first must be a multiple of the second so the two arena
- * pools can be maintained (in particular, arenas may be destroyed from the
- * middle of each pool) in parallel.
+ * Arena size and layout: a JSGCArenaInfo header, GC_THINGS_PER_ARENA things,
+ * then one flag byte for each thing.  Each arena in rt->gcArenaPool is
+ * allocated whole, so a->base addresses the header.
  */
-#define GC_ARENA_SIZE	8192		/* 1024 (512 on Alpha) objects */
-#define GC_FLAGS_SIZE	(GC_ARENA_SIZE / sizeof(JSGCThing))
+#define GC_ARENA_SIZE	8192		/* 479 things on LP64, 907 on ILP32 */
+#define GC_THING_BYTES	(sizeof(JSGCThing) + sizeof(uint8))
+#define GC_THINGS_PER_ARENA                                                   \
+    ((GC_ARENA_SIZE - sizeof(JSGCArenaInfo)) / GC_THING_BYTES)
+#define GC_THINGS_SIZE	(GC_THINGS_PER_ARENA * sizeof(JSGCThing))
+#define GC_ARENA_INFO(a)  ((JSGCArenaInfo *)(a)->base)
+#define GC_ARENA_THINGS(a) ((JSGCThing *)((a)->base + sizeof(JSGCArenaInfo)))
+#define GC_ARENA_FLAGS(a) ((uint8 *)(GC_ARENA_THINGS(a) + GC_THINGS_PER_ARENA))
 #define GC_ROOTS_SIZE	256		/* SWAG, small enough to amortize */
 
+/*
+ * Number of things moved from an arena to a context's freelist at once.
+ * Things on a context's freelist are still free, but their flags are set to
+ * GCF_CXFREE so that the sweep phase neither finalizes them (the lock count
+ * is stuck) nor threads them back onto their arena's freelist (they aren't
+ * GCF_FINAL).  Each GC returns every context's reserved things, and
+ * js_DestroyContext returns the things of the context it destroys.
+ */
+#define GC_FREELIST_BATCH 64
+#define GCF_CXFREE	(GCF_FINAL | GCF_LOCKMASK)
+
+/*
+ * Generations: mark bits are sticky.  A major GC clears them all before it
+ * marks and leaves the survivors marked, so a marked thing is old and an
+ * unmarked one young, allocated since the last GC.  A minor GC marks the
+ * young things reachable from the roots and from the objects remembered in
+ * rt->gcStoreBuffer by GC_WRITE_BARRIER, promoting them in place (things
+ * can't move, as native frames hold unrooted pointers to them), and sweeps
+ * only the nursery: the arenas allocated from since the last GC.  It runs
+ * after each GC_NURSERY_BYTES of allocation.
+ */
+#define GC_NURSERY_BYTES    (64 * GC_ARENA_SIZE)
+#define GC_STORE_BUFFER_SIZE 256
+
+/*
+ * Incremental marking: the mark stack's initial size, how many objects to
+ * scan between checks of the slice budget, and whether the heap outside the
+ * nursery has grown enough since the last GC to start a cycle (the
+ * JS_MaybeGC heuristic).
+ */
+#define GC_MARK_STACK_SIZE  256
+#define GC_SLICE_CHECK_MASK 63
+
+/*
+ * Ropes go on the mark stack too, as a concatenation loop builds one too deep
+ * to mark recursively.  Their entries are tagged to tell them from objects.
+ */
+#define GC_MARK_ROPE        ((prword)1)
+#define GC_SCAN_ROPE(rt, str, prev) {                                         \
+    JSRopeNode *_rope = JSSTRING_ROPE(str);                                   \
+    GC_MARK(rt, _rope->left, "left", prev);                                   \
+    GC_MARK(rt, _rope->right, "right", prev);                                 \
+}
+#define GC_TENURED_BYTES(rt) ((rt)->gcBytes - (rt)->gcNurseryBytes)
+#define GC_SHOULD_START(rt)                                                   \
+    (GC_TENURED_BYTES(rt) > GC_ARENA_SIZE &&                                  \
+     GC_TENURED_BYTES(rt) > (rt)->gcLastBytes + (rt)->gcLastBytes / 2)
+
 static PRHashNumber   gc_hash_root(const void *key);
 
 struct JSGCThing {
@@ -67,6 +130,23 @@ struct JSGCThing {
     uint8           *flagp;
 };
 
+/*
+ * Header at the base of each thing arena.  Things at and above bump have
+ * never been allocated, and are carved off in order; free things below bump
+ * are on freeList.  Arenas with any free things are on rt->gcFreeArenas, and
+ * arenas that refilled a context's freelist since the last GC are on
+ * rt->gcYoungArenas.
+ */
+struct JSGCArenaInfo {
+    PRArena         *arena;         /* arena whose base holds this header */
+    JSGCThing       *freeList;      /* free things below bump */
+    JSGCArenaInfo   *nextFree;      /* next arena on rt->gcFreeArenas */
+    JSGCArenaInfo   *nextYoung;     /* next arena on rt->gcYoungArenas */
+    uint32          bump;           /* index of first never-allocated thing */
+    uint16          onFreeList;     /* true if on rt->gcFreeArenas */
+    uint16          young;          /* true if on rt->gcYoungArenas */
+};
+
 typedef void (*GCFinalizeOp)(JSContext *cx, JSGCThing *thing);
 
 static GCFinalizeOp gc_finalizers[GCX_NTYPES];
@@ -88,8 +168,6 @@ js_InitGC(JSRuntime *rt, uint32 maxbytes)
 
     PR_InitArenaPool(&rt->gcArenaPool, "gc-arena", GC_ARENA_SIZE,
 		     sizeof(JSGCThing));
-    PR_InitArenaPool(&rt->gcFlagsPool, "gc-flags", GC_FLAGS_SIZE,
-		     sizeof(uint8));
     rt->gcRootsHash = PR_NewHashTable(GC_ROOTS_SIZE, gc_hash_root,
 				      PR_CompareValues, PR_CompareValues,
 				      NULL, NULL);
@@ -108,6 +186,8 @@ js_DumpGCStats(JSRuntime *rt, FILE *fp)
     fprintf(fp, "                alloc attempts: %lu\n", rt->gcStats.alloc);
     fprintf(fp, "            GC freelist length: %lu\n", rt->gcStats.freelen);
     fprintf(fp, "  recycles through GC freelist: %lu\n", rt->gcStats.recycle);
+    fprintf(fp, " never-used things bump-allocd: %lu\n", rt->gcStats.bump);
+    fprintf(fp, "  context freelist batch fills: %lu\n", rt->gcStats.refill);
     fprintf(fp, "alloc retries after running GC: %lu\n", rt->gcStats.retry);
     fprintf(fp, "           allocation failures: %lu\n", rt->gcStats.fail);
     fprintf(fp, "              valid lock calls: %lu\n", rt->gcStats.lock);
@@ -119,10 +199,17 @@ js_DumpGCStats(JSRuntime *rt, FILE *fp)
     fprintf(fp, "      maximum GC nesting level: %lu\n", rt->gcStats.maxlevel);
     fprintf(fp, "   potentially useful GC calls: %lu\n", rt->gcStats.poke);
     fprintf(fp, "              useless GC calls: %lu\n", rt->gcStats.nopoke);
-    fprintf(fp, "        thing arena corruption: %lu\n", rt->gcStats.badarena);
-    fprintf(fp, "        flags arena corruption: %lu\n", rt->gcStats.badflag);
     fprintf(fp, "     thing arenas freed so far: %lu\n", rt->gcStats.afree);
-    fprintf(fp, "     flags arenas freed so far: %lu\n", rt->gcStats.fafree);
+    fprintf(fp, "           minor (nursery) GCs: %lu\n", rt->gcStats.minor);
+    fprintf(fp, "              major (full) GCs: %lu\n", rt->gcStats.major);
+    fprintf(fp, "   minor GCs promoted to major: %lu\n", rt->gcStats.overflow);
+    fprintf(fp, "   incremental mark slices run: %lu\n", rt->gcStats.slice);
+    fprintf(fp, "     maximum GC pause in usecs: %lu\n", rt->gcStats.maxpause);
+    fprintf(fp, "      GC pauses under 100usecs: %lu\n", rt->gcStats.pause[0]);
+    fprintf(fp, "         GC pauses under 1msec: %lu\n", rt->gcStats.pause[1]);
+    fprintf(fp, "        GC pauses under 10msec: %lu\n", rt->gcStats.pause[2]);
+    fprintf(fp, "       GC pauses under 100msec: %lu\n", rt->gcStats.pause[3]);
+    fprintf(fp, "    GC pauses 100msec and over: %lu\n", rt->gcStats.pause[4]);
 #ifdef PR_ARENAMETER
     PR_DumpArenaStats(fp);
 #endif
@@ -139,11 +226,19 @@ js_FinishGC(JSRuntime *rt)
     js_DumpGCStats(rt, stdout);
 #endif
     PR_FinishArenaPool(&rt->gcArenaPool);
-    PR_FinishArenaPool(&rt->gcFlagsPool);
     PR_ArenaFinish();
+    if (rt->gcMarkStack) {
+	free(rt->gcMarkStack);
+	rt->gcMarkStack = NULL;
+    }
+    if (rt->gcStoreBuffer) {
+	free(rt->gcStoreBuffer);
+	rt->gcStoreBuffer = NULL;
+    }
     PR_HashTableDestroy(rt->gcRootsHash);
     rt->gcRootsHash = NULL;
-    rt->gcFreeList = NULL;
+    rt->gcFreeArenas = NULL;
+    rt->gcYoungArenas = NULL;
 }
 
 JSBool
@@ -173,84 +268,289 @@ js_RemoveRoot(JSContext *cx, void *rp)
     return JS_TRUE;
 }
 
-void *
-js_AllocGCThing(JSContext *cx, uintN flags)
+static void
+gc_run(JSContext *cx, JSBool force);
+
+static void
+gc_minor(JSContext *cx);
+
+/*
+ * Allocate a new arena, all of whose things are free and above its bump
+ * index, and put it on rt->gcFreeArenas.
+ */
+static JSBool
+gc_new_arena(JSRuntime *rt)
+{
+    PRArena *a;
+    JSGCArenaInfo *ainfo;
+    void *p;
+
+    PR_ARENA_ALLOCATE(p, &rt->gcArenaPool, GC_ARENA_SIZE);
+    if (!p)
+	return JS_FALSE;
+    a = rt->gcArenaPool.current;
+    PR_ASSERT(p == (void *)a->base);
+
+    /* Flag every thing free, so marking ignores stale pointers to them. */
+    memset(GC_ARENA_FLAGS(a), GCF_FINAL, GC_THINGS_PER_ARENA);
+    ainfo = GC_ARENA_INFO(a);
+    ainfo->arena = a;
+    ainfo->freeList = NULL;
+    ainfo->nextYoung = NULL;
+    ainfo->bump = 0;
+    ainfo->young = JS_FALSE;
+    ainfo->onFreeList = JS_TRUE;
+    ainfo->nextFree = rt->gcFreeArenas;
+    rt->gcFreeArenas = ainfo;
+    METER(rt->gcStats.freelen += GC_THINGS_PER_ARENA);
+    return JS_TRUE;
+}
+
+/*
+ * Move up to GC_FREELIST_BATCH things from the first arena on
+ * rt->gcFreeArenas to cx's freelist, recycled things first and then never
+ * allocated ones from the arena's bump index, allocating a new arena or
+ * running the GC if the runtime has none to give.  The things are charged to
+ * rt->gcBytes now, and credited back by js_GC if they're still on cx's
+ * freelist when cx runs the GC.
+ */
+static JSBool
+gc_refill_freelist(JSContext *cx)
 {
     JSRuntime *rt;
-    JSGCThing *thing;
+    JSBool tried_gc;
+    JSGCArenaInfo *ainfo;
+    JSGCThing *thing, **flp;
     uint8 *flagp;
-#ifdef TOO_MUCH_GC
-    JSBool tried_gc = JS_TRUE;
-    js_GC(cx);
-#else
-    JSBool tried_gc = JS_FALSE;
-#endif
+    uint32 limit;
+    uintN n;
 
     rt = cx->runtime;
-    JS_LOCK_RUNTIME(rt);
-    METER(rt->gcStats.alloc++);
-retry:
-    thing = rt->gcFreeList;
-    if (thing) {
-	rt->gcFreeList = thing->next;
-	flagp = thing->flagp;
-	METER(rt->gcStats.freelen--);
-	METER(rt->gcStats.recycle++);
-    } else {
-	if (rt->gcBytes < rt->gcMaxBytes) {
-	    PR_ARENA_ALLOCATE(thing, &rt->gcArenaPool, sizeof(JSGCThing));
-	    PR_ARENA_ALLOCATE(flagp, &rt->gcFlagsPool, sizeof(uint8));
-	}
-	if (!thing || !flagp) {
-	    if (thing)
-		PR_ARENA_RELEASE(&rt->gcArenaPool, thing);
-	    if (!tried_gc) {
-		js_GC(cx);
-		tried_gc = JS_TRUE;
-		METER(rt->gcStats.retry++);
-		goto retry;
-	    }
+    JS_LOCK(cx);
+
+    /* Collect the nursery once it has grown enough. */
+    if (rt->gcNurseryBytes >= GC_NURSERY_BYTES)
+	gc_minor(cx);
+
+    /* Pace incremental marking by allocation, starting before we run out. */
+    if (rt->gcMarking ||
+	(rt->gcSliceBudget != 0 && GC_SHOULD_START(rt))) {
+	js_GC(cx);
+    }
+
+    tried_gc = JS_FALSE;
+    while (!rt->gcFreeArenas) {
+	if (rt->gcBytes < rt->gcMaxBytes && gc_new_arena(rt))
+	    break;
+	if (tried_gc) {
 	    JS_ReportOutOfMemory(cx);
 	    METER(rt->gcStats.fail++);
-	    JS_UNLOCK_RUNTIME(rt);
-	    return NULL;
+	    JS_UNLOCK(cx);
+	    return JS_FALSE;
 	}
+
+	/* Try a minor GC before the full one. */
+	if (rt->gcNurseryBytes != 0)
+	    gc_minor(cx);
+	if (!rt->gcFreeArenas)
+	    gc_run(cx, JS_TRUE);
+	tried_gc = JS_TRUE;
+	METER(rt->gcStats.retry++);
+    }
+
+    ainfo = rt->gcFreeArenas;
+    PR_ASSERT(!cx->gcFreeList);
+    flp = &cx->gcFreeList;
+    for (n = 0; n < GC_FREELIST_BATCH && (thing = ainfo->freeList); n++) {
+	ainfo->freeList = thing->next;
+	*thing->flagp = GCF_CXFREE;
+	*flp = thing;
+	flp = &thing->next;
     }
-    *flagp = (uint8)flags;
-    rt->gcBytes += sizeof(JSGCThing) + sizeof(uint8);
+    METER(rt->gcStats.recycle += n);
+    if (n < GC_FREELIST_BATCH) {
+	limit = PR_MIN(GC_THINGS_PER_ARENA, ainfo->bump + GC_FREELIST_BATCH - n);
+	thing = GC_ARENA_THINGS(ainfo->arena) + ainfo->bump;
+	flagp = GC_ARENA_FLAGS(ainfo->arena) + ainfo->bump;
+	METER(rt->gcStats.bump += limit - ainfo->bump);
+	n += limit - ainfo->bump;
+	for (; ainfo->bump < limit; ainfo->bump++, thing++, flagp++) {
+	    *flagp = GCF_CXFREE;
+	    thing->flagp = flagp;
+	    *flp = thing;
+	    flp = &thing->next;
+	}
+    }
+    *flp = NULL;
+    PR_ASSERT(n != 0);
+
+    if (!ainfo->freeList && ainfo->bump == GC_THINGS_PER_ARENA) {
+	rt->gcFreeArenas = ainfo->nextFree;
+	ainfo->onFreeList = JS_FALSE;
+    }
+    if (!ainfo->young) {
+	ainfo->young = JS_TRUE;
+	ainfo->nextYoung = rt->gcYoungArenas;
+	rt->gcYoungArenas = ainfo;
+    }
+    rt->gcBytes += n * GC_THING_BYTES;
+    rt->gcNurseryBytes += n * GC_THING_BYTES;
+    METER(rt->gcStats.freelen -= n);
+    METER(rt->gcStats.refill++);
+    JS_UNLOCK(cx);
+    return JS_TRUE;
+}
+
+/*
+ * Return the things on cx's freelist to the runtime.  They become GCF_FINAL
+ * again, so the sweep phase rebuilds their arenas' freelists with them.
+ */
+void
+js_ReturnGCFreeList(JSContext *cx)
+{
+    JSRuntime *rt;
+    JSGCThing *thing;
+
+    rt = cx->runtime;
+    PR_ASSERT(JS_IS_RUNTIME_LOCKED(rt));
+    for (thing = cx->gcFreeList; thing; thing = thing->next) {
+	PR_ASSERT(*thing->flagp == GCF_CXFREE);
+	*thing->flagp = GCF_FINAL;
+	PR_ASSERT(rt->gcBytes >= GC_THING_BYTES);
+	rt->gcBytes -= GC_THING_BYTES;
+    }
+    cx->gcFreeList = NULL;
+}
+
+/*
+ * Return every context's freelist.  Other threads' requests must be stopped,
+ * so that none of their contexts is allocating.
+ */
+static void
+gc_return_freelists(JSRuntime *rt)
+{
+    JSContext *iter, *acx;
+
+    iter = NULL;
+    while ((acx = js_ContextIterator(rt, &iter)) != NULL)
+	js_ReturnGCFreeList(acx);
+}
+
+/*
+ * Only the thread using cx touches cx->gcFreeList, so the common case here
+ * takes no lock.  The GC waits for other threads' requests to stop before it
+ * scans their stacks or sweeps, so none of them is allocating meanwhile.
+ */
+void *
+js_AllocGCThing(JSContext *cx, uintN flags)
+{
+    JSGCThing *thing;
+
+#ifdef TOO_MUCH_GC
+    JS_LOCK(cx);
+    js_GC(cx);
+    JS_UNLOCK(cx);
+#endif
+    METER(cx->runtime->gcStats.alloc++);
+    thing = cx->gcFreeList;
+    if (!thing) {
+	if (!gc_refill_freelist(cx))
+	    return NULL;
+	thing = cx->gcFreeList;
+    }
+    cx->gcFreeList = thing->next;
+
+    /* Things allocated during incremental marking are born marked. */
+    if (cx->runtime->gcMarking)
+	flags |= GCF_MARK;
+    *thing->flagp = (uint8)flags;
     cx->newborn[flags & GCF_TYPEMASK] = thing;
 
-    /*
-     * Clear thing before unlocking in case a GC run is about to scan it,
-     * finding it via cx->newborn[].
-     */
+    /* Clear thing in case a GC run finds it via cx->newborn[]. */
     thing->next = NULL;
     thing->flagp = NULL;
-    JS_UNLOCK_RUNTIME(rt);
     return thing;
 }
 
+/*
+ * While the GC marks without yielding to the mutator, rt->gcArenaVector holds
+ * the arenas sorted by address, so that gc_find_flags can binary-search it
+ * rather than walk the arena list for each thing marked.  If the vector can't
+ * be allocated, gc_find_flags walks the list.
+ */
+static int
+gc_compare_arenas(const void *p1, const void *p2)
+{
+    pruword base1, base2;
+
+    base1 = (*(PRArena **)p1)->base;
+    base2 = (*(PRArena **)p2)->base;
+    return (base1 < base2) ? -1 : (base1 > base2);
+}
+
+static void
+gc_sort_arenas(JSRuntime *rt)
+{
+    PRArena *a, **vector;
+    uint32 count;
+
+    PR_ASSERT(!rt->gcArenaVector);
+    count = 0;
+    for (a = rt->gcArenaPool.first.next; a; a = a->next)
+	count++;
+    if (count == 0)
+	return;
+    vector = malloc(count * sizeof(PRArena *));
+    if (!vector)
+	return;
+    count = 0;
+    for (a = rt->gcArenaPool.first.next; a; a = a->next)
+	vector[count++] = a;
+    qsort(vector, count, sizeof(PRArena *), gc_compare_arenas);
+    rt->gcArenaVector = vector;
+    rt->gcArenaCount = count;
+}
+
+static void
+gc_unsort_arenas(JSRuntime *rt)
+{
+    if (rt->gcArenaVector) {
+	free(rt->gcArenaVector);
+	rt->gcArenaVector = NULL;
+    }
+}
+
 static uint8 *
 gc_find_flags(JSRuntime *rt, void *thing)
 {
-    pruword index, offset, length;
-    PRArena *a, *fa;
+    pruword offset;
+    PRArena *a;
+    uint32 lo, hi, mid;
 
-    index = 0;
-    for (a = rt->gcArenaPool.first.next; a; a = a->next) {
-	offset = PR_UPTRDIFF(thing, a->base);
-	length = a->avail - a->base;
-	if (offset < length) {
-	    index += offset / sizeof(JSGCThing);
-	    for (fa = rt->gcFlagsPool.first.next; fa; fa = fa->next) {
-		offset = fa->avail - fa->base;
-		if (index < offset)
-		    return (uint8 *)fa->base + index;
-		index -= offset;
+    if (rt->gcArenaVector) {
+	lo = 0;
+	hi = rt->gcArenaCount;
+	while (lo < hi) {
+	    mid = (lo + hi) / 2;
+	    a = rt->gcArenaVector[mid];
+	    if ((pruword)thing < a->base) {
+		hi = mid;
+	    } else if ((pruword)thing >= a->base + GC_ARENA_SIZE) {
+		lo = mid + 1;
+	    } else {
+		offset = PR_UPTRDIFF(thing, GC_ARENA_THINGS(a));
+		if (offset < GC_THINGS_SIZE)
+		    return GC_ARENA_FLAGS(a) + offset / sizeof(JSGCThing);
+		return NULL;
 	    }
-	    return NULL;
 	}
-	index += length / sizeof(JSGCThing);
+	return NULL;
+    }
+
+    for (a = rt->gcArenaPool.first.next; a; a = a->next) {
+	offset = PR_UPTRDIFF(thing, GC_ARENA_THINGS(a));
+	if (offset < GC_THINGS_SIZE)
+	    return GC_ARENA_FLAGS(a) + offset / sizeof(JSGCThing);
     }
     return NULL;
 }
@@ -295,6 +595,28 @@ js_UnlockGCThing(JSContext *cx, void *thing)
     return JS_TRUE;
 }
 
+size_t
+js_MapGCThings(JSRuntime *rt, JSGCThingMapper map, void *arg)
+{
+    PRArena *a;
+    JSGCArenaInfo *ainfo;
+    JSGCThing *thing;
+    uint8 *flagp, *limit;
+    size_t nbytes;
+
+    PR_ASSERT(JS_IS_RUNTIME_LOCKED(rt));
+    nbytes = 0;
+    for (a = rt->gcArenaPool.first.next; a; a = a->next) {
+	nbytes += sizeof(PRArena) + GC_ARENA_SIZE;
+	ainfo = GC_ARENA_INFO(a);
+	thing = GC_ARENA_THINGS(a);
+	flagp = GC_ARENA_FLAGS(a);
+	for (limit = flagp + ainfo->bump; flagp < limit; thing++, flagp++)
+	    map(thing, *flagp, arg);
+    }
+    return nbytes;
+}
+
 #ifdef GC_MARK_DEBUG
 
 #include <stdio.h>
@@ -336,7 +658,10 @@ gc_dump_thing(JSGCThing *thing, uint8 flags, GCMarkNode *prev, FILE *fp)
 	fprintf(fp, "class %s", ((JSObject *)thing)->map->clasp->name);
 	break;
       case GCX_STRING:
-	fprintf(fp, "bytes %s", JS_GetStringBytes((JSString *)thing));
+	if (JSSTRING_IS_ROPE((JSString *)thing))
+	    fprintf(fp, "rope of %ld chars", (long)((JSString *)thing)->length);
+	else
+	    fprintf(fp, "bytes %s", JS_GetStringBytes((JSString *)thing));
 	break;
       case GCX_DOUBLE:
 	fprintf(fp, "value %g", *(jsdouble *)thing);
@@ -367,22 +692,133 @@ gc_mark(JSRuntime *rt, void *thing)
     GC_MARK(rt, thing, "atom", NULL);
 }
 
+#define GC_SCAN(rt, obj, prev)  gc_scan_object(rt, obj, prev)
+
 static void
-gc_mark_node(JSRuntime *rt, void *thing, GCMarkNode *prev)
+gc_scan_object(JSRuntime *rt, JSObject *obj, GCMarkNode *prev)
 
 #else  /* GC_MARK_DEBUG */
 
+static void
+gc_mark(JSRuntime *rt, void *thing);
+
 #define GC_MARK(rt, thing, name, prev)  gc_mark(rt, thing)
+#define GC_SCAN(rt, obj, prev)          gc_scan_object(rt, obj)
 
 static void
-gc_mark(JSRuntime *rt, void *thing)
+gc_scan_object(JSRuntime *rt, JSObject *obj)
 
 #endif /* GC_MARK_DEBUG */
 {
-    uint8 flags, *flagp;
-    JSObject *obj;
     jsval v, *vp, *end;
     JSScope *scope;
+    JSArrayElements *elems;
+
+    vp = obj->slots;
+    if (!vp)
+	return;
+    scope = (JSScope *) obj->map;
+    if (scope->object == obj)
+	end = vp + obj->map->freeslot;
+    else
+	end = vp + JS_INITIAL_NSLOTS;
+    for (; vp < end; vp++) {
+	v = *vp;
+	if (JSVAL_IS_GCTHING(v)) {
+#ifdef GC_MARK_DEBUG
+	    uint32 slot;
+	    JSProperty *prop;
+	    jsval nval;
+	    char name[32];
+
+	    slot = vp - obj->slots;
+	    for (prop = scope->map.props; ; prop = prop->next) {
+		if (!prop) {
+		    switch (slot) {
+		      case JSSLOT_PROTO:
+			strcpy(name, "__proto__");
+			break;
+		      case JSSLOT_PARENT:
+			strcpy(name, "__parent__");
+			break;
+		      case JSSLOT_PRIVATE:
+			strcpy(name, "__private__");
+			break;
+		      default:
+			strcpy(name, "**UNKNOWN SLOT**");
+			break;
+		    }
+		    break;
+		}
+		if (prop->slot == slot) {
+		    nval = prop->symbols
+			   ? js_IdToValue(sym_id(prop->symbols))
+			   : prop->id;
+		    if (JSVAL_IS_INT(nval)) {
+			PR_snprintf(name, sizeof name, "%ld",
+				    (long)JSVAL_TO_INT(nval));
+		    } else if (JSVAL_IS_STRING(nval)) {
+			PR_snprintf(name, sizeof name, "%s",
+				    JS_GetStringBytes(JSVAL_TO_STRING(nval)));
+		    } else {
+			strcpy(name, "**FINALIZED ATOM KEY**");
+		    }
+		    break;
+		}
+	    }
+#endif
+	    GC_MARK(rt, JSVAL_TO_GCTHING(v), name, prev);
+	}
+    }
+
+    /* Dense arrays keep their elements outside the slots. */
+    if (OBJ_IS_DENSE_ARRAY(obj)) {
+	elems = ARRAY_ELEMENTS(obj);
+	if (!elems)
+	    return;
+	vp = elems->vector;
+	for (end = vp + elems->capacity; vp < end; vp++) {
+	    v = *vp;
+	    if (JSVAL_IS_GCTHING(v))
+		GC_MARK(rt, JSVAL_TO_GCTHING(v), "array element", prev);
+	}
+    }
+}
+
+/*
+ * Push a newly marked object, or a rope tagged with GC_MARK_ROPE, onto
+ * rt->gcMarkStack, to have its slots or children scanned by
+ * gc_drain_mark_stack.  Return false if the stack can't grow.
+ */
+static JSBool
+gc_push_object(JSRuntime *rt, JSObject *obj)
+{
+    uint32 size;
+    JSObject **stack;
+
+    if (rt->gcMarkStackDepth == rt->gcMarkStackSize) {
+	size = rt->gcMarkStackSize ? 2 * rt->gcMarkStackSize : GC_MARK_STACK_SIZE;
+	stack = rt->gcMarkStack
+		? realloc(rt->gcMarkStack, size * sizeof(JSObject *))
+		: malloc(size * sizeof(JSObject *));
+	if (!stack)
+	    return JS_FALSE;
+	rt->gcMarkStack = stack;
+	rt->gcMarkStackSize = size;
+    }
+    rt->gcMarkStack[rt->gcMarkStackDepth++] = obj;
+    return JS_TRUE;
+}
+
+#ifdef GC_MARK_DEBUG
+static void
+gc_mark_node(JSRuntime *rt, void *thing, GCMarkNode *prev)
+#else
+static void
+gc_mark(JSRuntime *rt, void *thing)
+#endif
+{
+    uint8 flags, *flagp;
 
     if (!thing)
 	return;
@@ -396,80 +832,92 @@ gc_mark(JSRuntime *rt, void *thing)
 	gc_dump_thing(thing, flags, prev, stderr);
 #endif
 
-    if (flags & GCF_MARK)
+    /* Free things, e.g. found via stale stack words, hold no references. */
+    if (flags & (GCF_MARK | GCF_FINAL))
 	return;
     *flagp |= GCF_MARK;
-    METER(if (++rt->gcStats.depth > rt->gcStats.maxdepth)
-	      rt->gcStats.maxdepth = rt->gcStats.depth);
 
 #ifdef GC_MARK_DEBUG
     if (js_DumpGCHeap)
 	gc_dump_thing(thing, flags, prev, js_DumpGCHeap);
 #endif
 
-    if ((flags & GCF_TYPEMASK) == GCX_OBJECT) {
-	obj = thing;
-	vp = obj->slots;
-	if (vp) {
-	    scope = (JSScope *) obj->map;
-	    if (scope->object == obj)
-		end = vp + obj->map->freeslot;
-	    else
-		end = vp + JS_INITIAL_NSLOTS;
-	    for (; vp < end; vp++) {
-		v = *vp;
-		if (JSVAL_IS_GCTHING(v)) {
-#ifdef GC_MARK_DEBUG
-		    uint32 slot;
-		    JSProperty *prop;
-		    jsval nval;
-		    char name[32];
-
-		    slot = vp - obj->slots;
-		    for (prop = scope->map.props; ; prop = prop->next) {
-			if (!prop) {
-			    switch (slot) {
-			      case JSSLOT_PROTO:
-				strcpy(name, "__proto__");
-				break;
-			      case JSSLOT_PARENT:
-				strcpy(name, "__parent__");
-				break;
-			      case JSSLOT_PRIVATE:
-				strcpy(name, "__private__");
-				break;
-			      default:
-				strcpy(name, "**UNKNOWN SLOT**");
-				break;
-			    }
-			    break;
-			}
-			if (prop->slot == slot) {
-			    nval = prop->symbols
-				   ? js_IdToValue(sym_id(prop->symbols))
-				   : prop->id;
-			    if (JSVAL_IS_INT(nval)) {
-				PR_snprintf(name, sizeof name, "%ld",
-					    (long)JSVAL_TO_INT(nval));
-			    } else if (JSVAL_IS_STRING(nval)) {
-				PR_snprintf(name, sizeof name, "%s",
-					    JS_GetStringBytes(JSVAL_TO_STRING(nval)));
-			    } else {
-				strcpy(name, "**FINALIZED ATOM KEY**");
-			    }
-			    break;
-			}
-		    }
+    if ((flags & GCF_TYPEMASK) == GCX_STRING) {
+	if (JSSTRING_IS_ROPE((JSString *)thing)) {
+#ifndef GC_MARK_DEBUG
+	    if (gc_push_object(rt, (JSObject *)((prword)thing | GC_MARK_ROPE)))
+		return;
 #endif
-		    GC_MARK(rt, JSVAL_TO_GCTHING(v), name, prev);
-		}
-	    }
+	    GC_SCAN_ROPE(rt, (JSString *)thing, prev);
 	}
+	return;
     }
+    if ((flags & GCF_TYPEMASK) != GCX_OBJECT)
+	return;
 
+#ifndef GC_MARK_DEBUG
+    /*
+     * Defer scanning to gc_drain_mark_stack, so marking can be sliced and
+     * doesn't recurse.  Recurse only if out of memory for the stack.
+     */
+    if (gc_push_object(rt, thing))
+	return;
+#endif
+    METER(if (++rt->gcStats.depth > rt->gcStats.maxdepth)
+	      rt->gcStats.maxdepth = rt->gcStats.depth);
+    GC_SCAN(rt, thing, prev);
     METER(rt->gcStats.depth--);
 }
 
+/*
+ * Microseconds elapsed since start, saturating at 2^32-1.
+ */
+static uint32
+gc_elapsed(int64 start)
+{
+    int64 now, delta, max;
+    uint32 usec;
+
+    now = PRMJ_Now();
+    LL_SUB(delta, now, start);
+    LL_UI2L(max, (uint32)-1);
+    if (LL_CMP(delta, >, max))
+	return (uint32)-1;
+    LL_L2UI(usec, delta);
+    return usec;
+}
+
+/*
+ * Scan objects on the mark stack until it is empty, returning true, or until
+ * budget microseconds have passed since start, returning false.  A budget of
+ * 0 means drain the stack completely.
+ */
+static JSBool
+gc_drain_mark_stack(JSRuntime *rt, int64 start, uint32 budget)
+{
+    JSObject *obj;
+    JSString *str;
+    uint32 n;
+
+    for (n = 0; rt->gcMarkStackDepth != 0; n++) {
+	if (budget != 0 &&
+	    (n & GC_SLICE_CHECK_MASK) == GC_SLICE_CHECK_MASK &&
+	    gc_elapsed(start) >= budget) {
+	    return JS_FALSE;
+	}
+	obj = rt->gcMarkStack[--rt->gcMarkStackDepth];
+	if ((prword)obj & GC_MARK_ROPE) {
+	    /* The mutator may have flattened it since it was pushed. */
+	    str = (JSString *)((prword)obj & ~GC_MARK_ROPE);
+	    if (JSSTRING_IS_ROPE(str))
+		GC_SCAN_ROPE(rt, str, NULL);
+	} else {
+	    GC_SCAN(rt, obj, NULL);
+	}
+    }
+    return JS_TRUE;
+}
+
 static PRHashNumber
 gc_hash_root(const void *key)
 {
@@ -488,56 +936,18 @@ gc_root_enumerator(PRHashEntry *he, intN i, void *arg)
     return HT_ENUMERATE_NEXT;
 }
 
-void
-js_ForceGC(JSContext *cx)
-{
-    PR_ASSERT(JS_IS_LOCKED(cx));
-    cx->newborn[GCX_OBJECT] = NULL;
-    cx->newborn[GCX_STRING] = NULL;
-    cx->newborn[GCX_DOUBLE] = NULL;
-    cx->runtime->gcPoke = JS_TRUE;
-    js_GC(cx);
-    PR_ArenaFinish();
-}
-
-void
-js_GC(JSContext *cx)
+/*
+ * Mark the root set: named roots, atoms, and each context's stack, frames,
+ * global object, newborn things, and cached number strings.
+ */
+static void
+gc_mark_roots(JSRuntime *rt)
 {
-    JSRuntime *rt;
     JSContext *iter, *acx;
-    PRArena *a, *fa, **ap, **fap;
-    jsval v, *vp, *sp;
-    pruword begin, end;
+    jsval v, *vp, *sp, *end;
+    uintN i;
     JSStackFrame *fp;
-    uint8 flags, *flagp;
-    JSGCThing *thing, **flp, **oflp;
-    GCFinalizeOp finalizer;
-    JSBool a_all_clear, f_all_clear;
-
-    rt = cx->runtime;
-    PR_ASSERT(JS_IS_RUNTIME_LOCKED(rt));
-
-    /* Do nothing if no assignment has executed since the last GC. */
-    if (!rt->gcPoke) {
-	METER(rt->gcStats.nopoke++);
-	return;
-    }
-    rt->gcPoke = JS_FALSE;
-    METER(rt->gcStats.poke++);
 
-    /* Bump gcLevel and return rather than nest; the outer gc will restart. */
-    rt->gcLevel++;
-    METER(if (rt->gcLevel > rt->gcStats.maxlevel)
-	      rt->gcStats.maxlevel = rt->gcLevel);
-    if (rt->gcLevel > 1)
-	return;
-
-    /* Drop atoms held by the property cache, and clear property weak links. */
-    js_FlushPropertyCache(cx);
-restart:
-    rt->gcNumber++;
-
-    /* Mark phase. */
     PR_HashTableEnumerateEntries(rt->gcRootsHash, gc_root_enumerator, rt);
     js_MarkAtomState(rt, gc_mark);
     iter = NULL;
@@ -546,18 +956,15 @@ restart:
 	if (fp) {
 	    sp = fp->sp;
 	    if (sp) {
-		for (a = acx->stackPool.first.next; a; a = a->next) {
-		    begin = a->base;
-		    end = a->avail;
+		end = acx->stackTop;
 #ifndef JS_THREADSAFE
-		    if (PR_UPTRDIFF(sp, begin) < PR_UPTRDIFF(end, begin))
-			end = (pruword)sp;
+		if (acx->stackBase <= sp && sp < end)
+		    end = sp;
 #endif
-		    for (vp = (jsval *)begin; vp < (jsval *)end; vp++) {
-			v = *vp;
-			if (JSVAL_IS_GCTHING(v))
-			    GC_MARK(rt, JSVAL_TO_GCTHING(v), "stack", NULL);
-		    }
+		for (vp = acx->stackBase; vp < end; vp++) {
+		    v = *vp;
+		    if (JSVAL_IS_GCTHING(v))
+			GC_MARK(rt, JSVAL_TO_GCTHING(v), "stack", NULL);
 		}
 	    }
 	    do {
@@ -577,110 +984,425 @@ restart:
 	GC_MARK(rt, acx->newborn[GCX_OBJECT], "newborn object", NULL);
 	GC_MARK(rt, acx->newborn[GCX_STRING], "newborn string", NULL);
 	GC_MARK(rt, acx->newborn[GCX_DOUBLE], "newborn double", NULL);
+	for (i = 0; i < NUMBER_STRING_CACHE_SIZE; i++) {
+	    GC_MARK(rt, acx->numberStrings[i].string, "number string",
+		    NULL);
+	}
     }
+}
 
-    /* Sweep phase. */
-    fa = rt->gcFlagsPool.first.next;
-    flagp = (uint8 *)fa->base;
-    for (a = rt->gcArenaPool.first.next; a; a = a->next) {
-	for (thing = (JSGCThing *)a->base; thing < (JSGCThing *)a->avail;
-	     thing++) {
-	    if (flagp >= (uint8 *)fa->avail) {
-		fa = fa->next;
-		PR_ASSERT(fa);
-		if (!fa) {
-		    METER(rt->gcStats.badflag++);
-		    goto out;
-		}
-		flagp = (uint8 *)fa->base;
-	    }
-	    flags = *flagp;
-	    if (flags & GCF_MARK) {
-		*flagp &= ~GCF_MARK;
-	    } else if (!(flags & (GCF_LOCKMASK | GCF_FINAL))) {
-		finalizer = gc_finalizers[flags & GCF_TYPEMASK];
-		if (finalizer) {
-		    *flagp |= GCF_FINAL;
-		    finalizer(cx, thing);
-		}
+#ifdef JS_GCMETER
+static void
+gc_meter_pause(JSRuntime *rt, int64 start)
+{
+    uint32 usec, bucket, limit;
 
-		/*
-		 * Set flags to GCF_FINAL, signifying that thing is free,
-		 * but don't thread thing onto rt->gcFreeList.  We rebuild
-		 * the freelist below while looking for free-able arenas.
-		 */
-		*flagp = GCF_FINAL;
-		PR_ASSERT(rt->gcBytes >= sizeof(JSGCThing)+sizeof(uint8));
-		rt->gcBytes -= sizeof(JSGCThing) + sizeof(uint8);
-	    }
-	    flagp++;
+    usec = gc_elapsed(start);
+    if (usec > rt->gcStats.maxpause)
+	rt->gcStats.maxpause = usec;
+    for (bucket = 0, limit = 100; bucket < GC_PAUSE_BUCKETS - 1;
+	 bucket++, limit *= 10) {
+	if (usec < limit)
+	    break;
+    }
+    rt->gcStats.pause[bucket]++;
+}
+#endif
+
+/*
+ * Finalize the unmarked things in use in an arena, which frees them.  Marks
+ * are left set, as survivors are old.
+ */
+static void
+gc_finalize_arena(JSContext *cx, JSGCArenaInfo *ainfo)
+{
+    JSRuntime *rt;
+    uint8 flags, *flagp, *limit;
+    JSGCThing *thing;
+    GCFinalizeOp finalizer;
+
+    rt = cx->runtime;
+    thing = GC_ARENA_THINGS(ainfo->arena);
+    flagp = GC_ARENA_FLAGS(ainfo->arena);
+    for (limit = flagp + ainfo->bump; flagp < limit; thing++, flagp++) {
+	flags = *flagp;
+	if (flags & (GCF_MARK | GCF_LOCKMASK | GCF_FINAL))
+	    continue;
+	finalizer = gc_finalizers[flags & GCF_TYPEMASK];
+	if (finalizer) {
+	    *flagp |= GCF_FINAL;
+	    finalizer(cx, thing);
 	}
+
+	/*
+	 * Set flags to GCF_FINAL, signifying that thing is free, but don't
+	 * thread thing onto the arena's freelist.  Finalizers may allocate,
+	 * so gc_build_freelist runs once all are done.
+	 */
+	*flagp = GCF_FINAL;
+	PR_ASSERT(rt->gcBytes >= GC_THING_BYTES);
+	rt->gcBytes -= GC_THING_BYTES;
     }
+}
 
-    /* Free unused arenas and rebuild the freelist. */
-    ap = &rt->gcArenaPool.first.next;
-    a = *ap;
-    if (!a)
-	goto out;
-    thing = (JSGCThing *)a->base;
-    a_all_clear = f_all_clear = JS_TRUE;
-    flp = oflp = &rt->gcFreeList;
-    *flp = NULL;
-    METER(rt->gcStats.freelen = 0);
+/*
+ * Rebuild an arena's freelist from its free things below bump, and put it on
+ * rt->gcFreeArenas if it has any free things.  Return true if none of its
+ * things is in use.
+ */
+static JSBool
+gc_build_freelist(JSRuntime *rt, JSGCArenaInfo *ainfo)
+{
+    uint8 *flagp, *limit;
+    JSGCThing *thing, **flp;
+    JSBool all_clear;
 
-    fap = &rt->gcFlagsPool.first.next;
-    while ((fa = *fap) != NULL) {
-	/* XXX optimize by unrolling to use word loads */
-	for (flagp = (uint8 *)fa->base; ; flagp++) {
-	    PR_ASSERT(a);
-	    if (!a) {
-		METER(rt->gcStats.badarena++);
-		goto out;
-	    }
-	    if (thing >= (JSGCThing *)a->avail) {
-		if (a_all_clear) {
-		    PR_ARENA_DESTROY(&rt->gcArenaPool, a, ap);
-		    flp = oflp;
-		    METER(rt->gcStats.afree++);
-		} else {
-		    ap = &a->next;
-		    a_all_clear = JS_TRUE;
-		    oflp = flp;
-		}
-		a = *ap;
-		if (!a)
-		    break;
-		thing = (JSGCThing *)a->base;
-	    }
-	    if (flagp >= (uint8 *)fa->avail)
-		break;
-	    if (*flagp != GCF_FINAL) {
-		a_all_clear = f_all_clear = JS_FALSE;
-	    } else {
-		thing->flagp = flagp;
-		*flp = thing;
-		flp = &thing->next;
-		METER(rt->gcStats.freelen++);
-	    }
-	    thing++;
+    all_clear = JS_TRUE;
+    flp = &ainfo->freeList;
+    thing = GC_ARENA_THINGS(ainfo->arena);
+    flagp = GC_ARENA_FLAGS(ainfo->arena);
+    for (limit = flagp + ainfo->bump; flagp < limit; thing++, flagp++) {
+	if (*flagp != GCF_FINAL) {
+	    all_clear = JS_FALSE;
+	} else {
+	    thing->flagp = flagp;
+	    *flp = thing;
+	    flp = &thing->next;
+	    METER(rt->gcStats.freelen++);
 	}
-	if (f_all_clear) {
-	    PR_ARENA_DESTROY(&rt->gcFlagsPool, fa, fap);
-	    METER(rt->gcStats.fafree++);
+    }
+    *flp = NULL;
+
+    if (!ainfo->onFreeList &&
+	(ainfo->freeList || ainfo->bump < GC_THINGS_PER_ARENA)) {
+	ainfo->onFreeList = JS_TRUE;
+	ainfo->nextFree = rt->gcFreeArenas;
+	rt->gcFreeArenas = ainfo;
+    }
+    return all_clear;
+}
+
+/*
+ * Forget the nursery and the store buffer, after a GC has swept them.
+ */
+static void
+gc_reset_nursery(JSRuntime *rt)
+{
+    JSGCArenaInfo *ainfo;
+
+    for (ainfo = rt->gcYoungArenas; ainfo; ainfo = ainfo->nextYoung)
+	ainfo->young = JS_FALSE;
+    rt->gcYoungArenas = NULL;
+    rt->gcNurseryBytes = 0;
+    rt->gcStoreBufferDepth = 0;
+    rt->gcStoreBufferOverflow = JS_FALSE;
+    memset(rt->gcStoreFilter, 0, sizeof rt->gcStoreFilter);
+}
+
+/*
+ * Major sweep: finalize unmarked things, free unused arenas and rebuild the
+ * freelists of the rest.
+ */
+static void
+gc_sweep(JSContext *cx)
+{
+    JSRuntime *rt;
+    PRArena *a, **ap;
+    JSGCArenaInfo *ainfo;
+
+    rt = cx->runtime;
+    for (a = rt->gcArenaPool.first.next; a; a = a->next)
+	gc_finalize_arena(cx, GC_ARENA_INFO(a));
+
+    /* Free unused arenas and rebuild the freelists. */
+    gc_reset_nursery(rt);
+    rt->gcFreeArenas = NULL;
+    METER(rt->gcStats.freelen = 0);
+    ap = &rt->gcArenaPool.first.next;
+    while ((a = *ap) != NULL) {
+	ainfo = GC_ARENA_INFO(a);
+	ainfo->onFreeList = JS_FALSE;
+	if (gc_build_freelist(rt, ainfo)) {
+	    /* Unlink ainfo, which gc_build_freelist just pushed. */
+	    PR_ASSERT(rt->gcFreeArenas == ainfo);
+	    rt->gcFreeArenas = ainfo->nextFree;
+	    METER(rt->gcStats.freelen -= ainfo->bump);
+	    METER(rt->gcStats.afree++);
+	    PR_ARENA_DESTROY(&rt->gcArenaPool, a, ap);
 	} else {
-	    fap = &fa->next;
-	    f_all_clear = JS_TRUE;
+	    METER(rt->gcStats.freelen += GC_THINGS_PER_ARENA - ainfo->bump);
+	    ap = &a->next;
 	}
     }
+}
 
-    /* Terminate the new freelist. */
-    *flp = NULL;
+/*
+ * Minor sweep: finalize the unmarked things in the nursery, and rebuild the
+ * freelists of its arenas.  Arenas stay allocated, for reuse.
+ */
+static void
+gc_sweep_nursery(JSContext *cx)
+{
+    JSRuntime *rt;
+    JSGCArenaInfo *ainfo;
+#ifdef JS_GCMETER
+    JSGCThing *thing;
+#endif
+
+    rt = cx->runtime;
+    for (ainfo = rt->gcYoungArenas; ainfo; ainfo = ainfo->nextYoung)
+	gc_finalize_arena(cx, ainfo);
+    for (ainfo = rt->gcYoungArenas; ainfo; ainfo = ainfo->nextYoung) {
+#ifdef JS_GCMETER
+	for (thing = ainfo->freeList; thing; thing = thing->next)
+	    rt->gcStats.freelen--;
+#endif
+	(void) gc_build_freelist(rt, ainfo);
+    }
+    gc_reset_nursery(rt);
+}
+
+/*
+ * Push obj onto rt->gcStoreBuffer.  Return false if the buffer can't grow.
+ */
+static JSBool
+gc_remember_object(JSRuntime *rt, JSObject *obj)
+{
+    uint32 size;
+    JSObject **buffer;
+
+    if (rt->gcStoreBufferDepth == rt->gcStoreBufferSize) {
+	size = rt->gcStoreBufferSize
+	       ? 2 * rt->gcStoreBufferSize
+	       : GC_STORE_BUFFER_SIZE;
+	buffer = rt->gcStoreBuffer
+		 ? realloc(rt->gcStoreBuffer, size * sizeof(JSObject *))
+		 : malloc(size * sizeof(JSObject *));
+	if (!buffer)
+	    return JS_FALSE;
+	rt->gcStoreBuffer = buffer;
+	rt->gcStoreBufferSize = size;
+    }
+    rt->gcStoreBuffer[rt->gcStoreBufferDepth++] = obj;
+    return JS_TRUE;
+}
+
+/*
+ * Minor GC.  Old objects in the store buffer are scanned as if they were
+ * roots; young objects there are marked from the roots or not at all.
+ * Nothing is done while a major GC is marking or running, and a full store
+ * buffer makes this a major GC.
+ */
+static void
+gc_minor(JSContext *cx)
+{
+    JSRuntime *rt;
+    int64 start;
+    uint32 i;
+    JSObject *obj;
+    uint8 *flagp;
+
+    rt = cx->runtime;
+    PR_ASSERT(JS_IS_RUNTIME_LOCKED(rt));
+    if (rt->gcMarking || rt->gcLevel != 0)
+	return;
+    if (rt->gcStoreBufferOverflow) {
+	METER(rt->gcStats.overflow++);
+	rt->gcPoke = JS_TRUE;
+	gc_run(cx, JS_TRUE);
+	return;
+    }
+#ifdef JS_THREADSAFE
+    js_WaitForStop(cx, NULL);
+#endif
+    start = PRMJ_Now();
+    rt->gcLevel = 1;
+    METER(rt->gcStats.minor++);
+
+    /* Drop atoms held by the property cache, and clear property weak links. */
+    js_FlushPropertyCache(cx);
+
+    /* Let the sweep phase recycle the things reserved by every context. */
+    gc_return_freelists(rt);
+
+    gc_sort_arenas(rt);
+    gc_mark_roots(rt);
+    for (i = 0; i < rt->gcStoreBufferDepth; i++) {
+	obj = rt->gcStoreBuffer[i];
+	flagp = gc_find_flags(rt, obj);
+	if (flagp && (*flagp & (GCF_MARK | GCF_FINAL)) == GCF_MARK)
+	    GC_SCAN(rt, obj, NULL);
+    }
+    (void) gc_drain_mark_stack(rt, start, 0);
+    gc_unsort_arenas(rt);
+    gc_sweep_nursery(cx);
+
+    /* A GC requested by a finalizer will run at the next opportunity. */
+    rt->gcLevel = 0;
+#ifdef JS_GCMETER
+    gc_meter_pause(rt, start);
+#endif
+}
+
+/*
+ * Clear every mark bit, as a major GC starts.
+ */
+static void
+gc_clear_marks(JSRuntime *rt)
+{
+    PRArena *a;
+    uint8 *flagp, *limit;
+
+    for (a = rt->gcArenaPool.first.next; a; a = a->next) {
+	flagp = GC_ARENA_FLAGS(a);
+	for (limit = flagp + GC_ARENA_INFO(a)->bump; flagp < limit; flagp++)
+	    *flagp &= ~GCF_MARK;
+    }
+}
+
+/*
+ * Run the GC.  If rt->gcSliceBudget is non-zero and force is false, marking
+ * is incremental: this call and later calls each mark for at most the budget
+ * before returning to the mutator, and the call that empties the mark stack
+ * finishes the collection.  GC_WRITE_BARRIER keeps stores made between slices
+ * from hiding live things, things allocated while marking are born marked,
+ * and the root set is marked again before sweeping.
+ */
+static void
+gc_run(JSContext *cx, JSBool force)
+{
+    JSRuntime *rt;
+    int64 start;
+    uint32 budget;
+
+    rt = cx->runtime;
+    PR_ASSERT(JS_IS_RUNTIME_LOCKED(rt));
+    start = PRMJ_Now();
+    budget = force ? 0 : rt->gcSliceBudget;
+
+    if (rt->gcMarking) {
+	/* Continue marking, and finish if the mark stack empties. */
+#ifdef JS_THREADSAFE
+	js_WaitForStop(cx, NULL);
+#endif
+	METER(rt->gcStats.slice++);
+	if (!gc_drain_mark_stack(rt, start, budget))
+	    goto pause;
+	rt->gcLevel++;
+	gc_return_freelists(rt);
+	goto finish;
+    }
+
+    /* Do nothing if no assignment has executed since the last GC. */
+    if (!rt->gcPoke) {
+	METER(rt->gcStats.nopoke++);
+	return;
+    }
+    rt->gcPoke = JS_FALSE;
+    METER(rt->gcStats.poke++);
+
+    /* Bump gcLevel and return rather than nest; the outer gc will restart. */
+    rt->gcLevel++;
+    METER(if (rt->gcLevel > rt->gcStats.maxlevel)
+	      rt->gcStats.maxlevel = rt->gcLevel);
+    if (rt->gcLevel > 1)
+	return;
+
+#ifdef JS_THREADSAFE
+    /* Stop other threads' requests before scanning their stacks. */
+    js_WaitForStop(cx, NULL);
+#endif
+
+    /* Drop atoms held by the property cache, and clear property weak links. */
+    js_FlushPropertyCache(cx);
+
+    /* Let the sweep phase recycle the things reserved by every context. */
+    gc_return_freelists(rt);
+restart:
+    rt->gcNumber++;
+    METER(rt->gcStats.major++);
+
+    /* Mark phase, from scratch: survivors of earlier GCs are marked. */
+    gc_clear_marks(rt);
+    if (budget == 0)
+	gc_sort_arenas(rt);
+    gc_mark_roots(rt);
+    if (budget != 0) {
+	rt->gcMarking = JS_TRUE;
+	METER(rt->gcStats.slice++);
+	if (!gc_drain_mark_stack(rt, start, budget)) {
+	    rt->gcLevel = 0;
+	    goto pause;
+	}
+    }
+
+finish:
+    /*
+     * Marking has caught up with the mutator.  Mark the roots again, since
+     * stack and root stores aren't barriered, and drain the stack to finish.
+     */
+    if (rt->gcMarking) {
+	js_FlushPropertyCache(cx);
+	gc_sort_arenas(rt);
+	gc_mark_roots(rt);
+    }
+    (void) gc_drain_mark_stack(rt, start, 0);
+    gc_unsort_arenas(rt);
+    rt->gcMarking = JS_FALSE;
+
+    /* Sweep phase. */
+    gc_sweep(cx);
+    js_SweepScopeShapes(cx);
 
-out:
     if (rt->gcLevel > 1) {
 	rt->gcLevel = 1;
+	budget = 0;
 	goto restart;
     }
     rt->gcLevel = 0;
     rt->gcLastBytes = rt->gcBytes;
+
+pause:
+#ifdef JS_GCMETER
+    gc_meter_pause(rt, start);
+#else
+    ;
+#endif
+}
+
+void
+js_ForceGC(JSContext *cx)
+{
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    cx->newborn[GCX_OBJECT] = NULL;
+    cx->newborn[GCX_STRING] = NULL;
+    cx->newborn[GCX_DOUBLE] = NULL;
+    cx->runtime->gcPoke = JS_TRUE;
+    gc_run(cx, JS_TRUE);
+    PR_ArenaFinish();
+}
+
+void
+js_GC(JSContext *cx)
+{
+    gc_run(cx, JS_FALSE);
+}
+
+void
+js_GCWriteBarrier(JSContext *cx, JSObject *obj, void *thing)
+{
+    JSRuntime *rt;
+
+    if (!thing)
+	return;
+    rt = cx->runtime;
+    JS_LOCK(cx);
+    if (rt->gcMarking) {
+	GC_MARK(rt, thing, "barrier", NULL);
+    } else if (obj && GC_STORE_FILTER(rt, obj) != obj) {
+	if (!gc_remember_object(rt, obj))
+	    rt->gcStoreBufferOverflow = JS_TRUE;
+	GC_STORE_FILTER(rt, obj) = obj;
+    }
+    JS_UNLOCK(cx);
 }
@@ -74,18 +74,74 @@ js_LockGCThing(JSContext *cx, void *thing);
 extern JSBool
 js_UnlockGCThing(JSContext *cx, void *thing);
 
+/*
+ * Return the things js_AllocGCThing has reserved for cx to the runtime, whose
+ * lock the caller must hold.  A destroyed context's things would be lost.
+ */
+extern void
+js_ReturnGCFreeList(JSContext *cx);
+
+/*
+ * Call map on every thing ever allocated in rt's GC arenas, with its flags:
+ * GCF_FINAL is set in those of a free thing.  Return the bytes the arenas
+ * occupy.  The caller must hold the runtime lock and have stopped other
+ * requests (see js_WaitForStop), lest things be allocated meanwhile.
+ */
+typedef void (*JSGCThingMapper)(void *thing, uint8 flags, void *arg);
+
+extern size_t
+js_MapGCThings(JSRuntime *rt, JSGCThingMapper map, void *arg);
+
 extern void
 js_ForceGC(JSContext *cx);
 
 extern void
 js_GC(JSContext *cx);
 
+/*
+ * Write barrier, for each store of a GC thing v into obj's slots.  While
+ * rt->gcMarking, it marks v, lest an object already scanned come to hold the
+ * only reference to an unmarked thing.  Otherwise it remembers obj for the
+ * next minor GC, in case obj is old and v young.  A direct-mapped filter of
+ * recently remembered objects keeps repeated stores into the same objects
+ * out of the store buffer.  The arguments may be evaluated twice.
+ *
+ * js_GCWriteBarrier may be called with a null obj to mark a thing referred to
+ * by a new thing that can't be remembered (see js_ConcatStrings).
+ *
+ * Code that stores holding only obj's scope lock (see jslock.h) runs the
+ * barrier first, then tests GC_NEEDS_BARRIER with the scope lock held and
+ * takes the runtime lock if it's still true, since a GC may have run while
+ * it waited for the scope lock.
+ */
+#define GC_STORE_FILTER_SIZE    64
+#define GC_STORE_FILTER(rt,obj)                                               \
+    ((rt)->gcStoreFilter[((pruword)(obj) >> 3) & (GC_STORE_FILTER_SIZE - 1)])
+
+#define GC_NEEDS_BARRIER(cx,obj,v)                                            \
+    (JSVAL_IS_GCTHING(v) &&                                                   \
+     ((cx)->runtime->gcMarking ||                                             \
+      GC_STORE_FILTER((cx)->runtime, obj) != (obj)))
+
+#define GC_WRITE_BARRIER(cx,obj,v)                                            \
+    (GC_NEEDS_BARRIER(cx, obj, v)                                             \
+     ? js_GCWriteBarrier(cx, obj, JSVAL_TO_GCTHING(v))                        \
+     : (void)0)
+
+extern void
+js_GCWriteBarrier(JSContext *cx, JSObject *obj, void *thing);
+
 #ifdef JS_GCMETER
 
+/* Pause histogram buckets: <100us, <1ms, <10ms, <100ms, and longer. */
+#define GC_PAUSE_BUCKETS 5
+
 typedef struct JSGCStats {
     uint32  alloc;      /* number of allocation attempts */
-    uint32  freelen;    /* gcFreeList length */
-    uint32  recycle;    /* number of things recycled through gcFreeList */
+    uint32  freelen;    /* free things in arenas, not on a context */
+    uint32  recycle;    /* number of things recycled through arena freelists */
+    uint32  bump;       /* number of never-used things bump-allocated */
+    uint32  refill;     /* batches moved from an arena to a context */
     uint32  retry;      /* allocation attempt retries after running the GC */
     uint32  fail;       /* allocation failures */
     uint32  lock;       /* valid lock calls */
@@ -97,10 +153,13 @@ typedef struct JSGCStats {
     uint32  maxlevel;   /* maximum GC nesting (indirect recursion) level */
     uint32  poke;       /* number of potentially useful GC calls */
     uint32  nopoke;     /* useless GC calls where js_PokeGC was not set */
-    uint32  badarena;   /* thing arena corruption */
-    uint32  badflag;    /* flags arena corruption */
     uint32  afree;      /* thing arenas freed so far */
-    uint32  fafree;     /* flags arenas freed so far */
+    uint32  minor;      /* minor GCs, which sweep only the nursery */
+    uint32  major;      /* major GCs, which sweep every arena */
+    uint32  overflow;   /* minor GCs run as major for store buffer overflow */
+    uint32  slice;      /* incremental mark slices run */
+    uint32  maxpause;   /* longest GC pause, in microseconds */
+    uint32  pause[GC_PAUSE_BUCKETS];    /* GC pauses by duration */
 } JSGCStats;
 
 extern void
@@ -20,6 +20,7 @@
  * JavaScript bytecode interpreter.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include "prtypes.h"
@@ -34,10 +35,12 @@
 #include "jsfun.h"
 #include "jsgc.h"
 #include "jsinterp.h"
+#include "jsjit.h"
 #include "jslock.h"
 #include "jsnum.h"
 #include "jsobj.h"
 #include "jsopcode.h"
+#include "jsparse.h"
 #include "jsscope.h"
 #include "jsscript.h"
 #include "jsstr.h"
@@ -94,6 +97,81 @@ js_FlushPropertyCacheByProp(JSContext *cx, JSProperty *prop)
     cache->pflushes++;
 }
 
+void
+js_FillPropertyIC(JSContext *cx, JSScript *script, jsbytecode *pc,
+		  JSObject *obj, JSAtom *atom, JSProperty *prop,
+		  JSBool setting)
+{
+    JSScope *scope, *pscope;
+    JSObject *pobj;
+    uintN log2;
+    JSPropertyIC *ic;
+
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    if (cx->runtime->propertyCache.noInlineCaches)
+	return;
+#ifdef JS_THREADSAFE
+    if (script->ownercx != cx)
+	return;
+#endif
+
+    /* Cache only slots that a hit may load or store without calling out. */
+    if (prop->id != ATOM_KEY(atom))
+	return;
+    if (setting) {
+	if (prop->setter != JS_PropertyStub ||
+	    (prop->flags & (JSPROP_READONLY | JSPROP_ASSIGNHACK)) ||
+	    !(prop->flags & JSPROP_ENUMERATE)) {
+	    return;
+	}
+    } else {
+	if (prop->getter != JS_PropertyStub)
+	    return;
+    }
+
+    /*
+     * The receiver must own its scope.  A prototype hit also needs a class
+     * without a resolve hook, so that the receiver's shape alone says the
+     * id is not found there.
+     */
+    scope = (JSScope *)obj->map;
+    if (scope->object != obj)
+	return;
+    pobj = prop->object;
+    pscope = NULL;
+    if (pobj != obj) {
+	if (setting || !pobj || pobj != OBJ_GET_PROTO(obj) ||
+	    scope->map.clasp->resolve != JS_ResolveStub) {
+	    return;
+	}
+	pscope = (JSScope *)pobj->map;
+	if (pscope->object != pobj)
+	    return;
+    }
+
+    if (!script->propertyICs) {
+	for (log2 = PROPERTY_IC_MIN_LOG2; log2 < PROPERTY_IC_MAX_LOG2; log2++) {
+	    if (PR_BIT(log2) >= script->length)
+		break;
+	}
+	script->propertyICs = calloc(PR_BIT(log2), sizeof(JSPropertyIC));
+	if (!script->propertyICs)
+	    return;
+	script->propertyICMask = PR_BITMASK(log2);
+    }
+    ic = &script->propertyICs[(pc - script->code) & script->propertyICMask];
+    ic->pcoff = (uint32)(pc - script->code);
+    ic->shape = scope->shape;
+    ic->slot = prop->slot;
+    if (pscope) {
+	ic->protoShape = pscope->shape;
+	ic->proto = pobj;
+    } else {
+	LL_UI2L(ic->protoShape, SHAPE_INVALID);
+	ic->proto = NULL;
+    }
+}
+
 /*
  * Class for for/in loop property iterator objects.
  */
@@ -160,14 +238,6 @@ static JSClass prop_iterator_class = {
 	PUSH_OPND(_v);                                                        \
     PR_END_MACRO
 
-#define POP_NUMBER(cx, d)                                                     \
-    PR_BEGIN_MACRO                                                            \
-	jsval _v;                                                             \
-									      \
-	_v = POP();                                                           \
-	VALUE_TO_NUMBER(cx, _v, d);                                           \
-    PR_END_MACRO
-
 /*
  * This POP variant is called only for bitwise operators, so we don't bother
  * to inline it.  The calls in Interpret must therefore SAVE_SP first!
@@ -214,7 +284,7 @@ PopInt(JSContext *cx, jsint *ip, JSBool *validp)
 	    d = *JSVAL_TO_DOUBLE(v);                                          \
 	} else {                                                              \
 	    SAVE_SP(fp);                                                      \
-	    JS_LOCK_RUNTIME_VOID(rt, ok = js_ValueToNumber(cx, v, &d));       \
+	    JS_LOCK_VOID(cx, ok = js_ValueToNumber(cx, v, &d));               \
 	    if (!ok)                                                          \
 		goto out;                                                     \
 	}                                                                     \
@@ -228,7 +298,7 @@ PopInt(JSContext *cx, jsint *ip, JSBool *validp)
 	    b = JSVAL_TO_BOOLEAN(v);                                          \
 	} else {                                                              \
 	    SAVE_SP(fp);                                                      \
-	    JS_LOCK_RUNTIME_VOID(rt, ok = js_ValueToBoolean(cx, v, &b));      \
+	    JS_LOCK_VOID(cx, ok = js_ValueToBoolean(cx, v, &b));              \
 	    if (!ok)                                                          \
 		goto out;                                                     \
 	}                                                                     \
@@ -240,7 +310,7 @@ PopInt(JSContext *cx, jsint *ip, JSBool *validp)
 	    obj = JSVAL_TO_OBJECT(v);                                         \
 	} else {                                                              \
 	    SAVE_SP(fp);                                                      \
-	    JS_LOCK_RUNTIME_VOID(rt, obj = js_ValueToNonNullObject(cx, v));   \
+	    JS_LOCK_VOID(cx, obj = js_ValueToNonNullObject(cx, v));           \
 	    if (!obj) {                                                       \
 		ok = JS_FALSE;                                                \
 		goto out;                                                     \
@@ -289,18 +359,20 @@ PopInt(JSContext *cx, jsint *ip, JSBool *validp)
 	}                                                                     \
     PR_END_MACRO
 
-static jsval *
-AllocStack(JSContext *cx, uintN nslots)
+jsval *
+js_AllocStack(JSContext *cx, uintN nslots)
 {
     jsval *sp;
 
-    PR_ARENA_ALLOCATE(sp, &cx->stackPool, nslots * sizeof(jsval));
-    if (!sp) {
+    sp = cx->stackTop;
+    if ((pruword)(cx->stackLimit - sp) < nslots) {
 	JS_ReportError(cx, "stack overflow in %s",
 		       (cx->fp && cx->fp->fun)
 		       ? JS_GetFunctionName(cx->fp->fun)
 		       : "script");
+	return NULL;
     }
+    cx->stackTop = sp + nslots;
     return sp;
 }
 
@@ -395,13 +467,14 @@ JSBool
 js_DoCall(JSContext *cx, uintN argc)
 {
     JSStackFrame *fp, frame;
-    jsval *sp, *newsp;
+    jsval *sp, *mark;
     jsval *vp, aval;
     JSObject *closure, *funobj, *parent, *thisp;
     JSFunction *fun;
-    void *mark;
-    intN nslots, nalloc, surplus;
+    void *hookData;
+    intN nslots;
     JSBool ok;
+    JSInterpreterHook hook;
 
     /* Reach under our args to find the function ref on the stack. */
     fp = cx->fp;
@@ -416,6 +489,10 @@ js_DoCall(JSContext *cx, uintN argc)
     if (!fun)
 	return JS_FALSE;
 
+    /* Compile fun's body if its compilation was put off, see jsparse.h. */
+    if (!JSFUN_COMPILE(cx, fun))
+	return JS_FALSE;
+
     /* Get the function's parent object in case it's bound or orphaned. */
     funobj = fun->object;
     parent = OBJ_GET_PARENT(funobj);
@@ -448,6 +525,7 @@ js_DoCall(JSContext *cx, uintN argc)
     frame.sharpDepth = 0;
     frame.sharpArray = NULL;
 #endif
+    frame.stackMark = NULL;
 
 #if JS_HAS_LEXICAL_CLOSURE
     /* If calling a closure, set funobj to the call object eagerly. */
@@ -474,73 +552,36 @@ js_DoCall(JSContext *cx, uintN argc)
 
     /* From here on, control must flow through label out: to return. */
     JS_LOCK_VOID(cx, cx->fp = &frame);
-    mark = PR_ARENA_MARK(&cx->stackPool);
+    mark = cx->stackTop;
+    hook = NULL;
+    hookData = NULL;
 
-    /* Check for missing arguments expected by the function. */
+    /*
+     * Push void for missing arguments expected by the function, then for its
+     * local variables, after the actual arguments, see jsinterp.h.
+     */
     nslots = (intN)((argc < fun->nargs) ? fun->nargs - argc : 0);
-    if (nslots) {
-	/* All arguments must be contiguous, so we may have to copy actuals. */
-	nalloc = nslots;
-	if ((pruword)(sp + nslots) > cx->stackPool.current->limit)
-	    nalloc += argc;
-
-	/* Take advantage of the surplus slots in the caller's frame depth. */
-	surplus = (jsval *)mark - sp;
-	PR_ASSERT(surplus >= 0);
-	nalloc -= surplus;
-
-	/* Check whether we have enough space in the caller's frame. */
-	if (nalloc > 0) {
-	    /* Need space for actuals plus missing formals minus surplus. */
-	    newsp = AllocStack(cx, (uintN)nalloc);
-	    if (!newsp) {
-		ok = JS_FALSE;
-		goto out;
-	    }
-
-	    /* If we couldn't allocate contiguous args, copy actuals now. */
-	    if (newsp != mark) {
-		if (argc)
-		    memcpy(newsp, frame.argv, argc * sizeof(jsval));
-		frame.argv = newsp;
-		frame.vars = frame.sp = newsp + argc;
-		RESTORE_SP(&frame);
-	    }
-	}
-
-	/* Advance frame.vars to make room for the missing args. */
-	frame.vars += nslots;
-
-	/* Push void to initialize missing args. */
-	while (--nslots >= 0)
-	    PUSH(JSVAL_VOID);
-    }
-
-    /* Now allocate stack space for local variables. */
-    nslots = (intN)frame.nvars;
-    if (nslots) {
-	surplus = (intN)((jsval *)cx->stackPool.current->avail - frame.vars);
-	if (surplus < nslots) {
-	    newsp = AllocStack(cx, (uintN)nslots);
-	    if (!newsp) {
-		ok = JS_FALSE;
-		goto out;
-	    }
-	    if (newsp != sp) {
-		/* NB: Discontinuity between argv and vars. */
-		frame.vars = frame.sp = newsp;
-		RESTORE_SP(&frame);
-	    }
-	}
-
-	/* Push void to initialize local variables. */
-	while (--nslots >= 0)
-	    PUSH(JSVAL_VOID);
+    frame.vars += nslots;
+    nslots += (intN)frame.nvars;
+    PR_ASSERT(sp <= mark);
+    if (sp + nslots > mark &&
+	!js_AllocStack(cx, (uintN)(sp + nslots - mark))) {
+	ok = JS_FALSE;
+	goto out;
     }
+    while (--nslots >= 0)
+	PUSH(JSVAL_VOID);
 
     /* Store the current sp in frame before calling fun. */
     SAVE_SP(&frame);
 
+    /* Tell the debugger's call hook, if any, that fun is about to run. */
+    hook = (JSInterpreterHook) cx->runtime->callHook;
+    if (hook) {
+	ok = JS_TRUE;
+	hookData = hook(cx, &frame, JS_TRUE, &ok, cx->runtime->callHookData);
+    }
+
     /* Call the function, either a native method or an interpreted script. */
     if (fun->call) {
 	frame.scopeChain = fp->scopeChain;
@@ -557,13 +598,13 @@ js_DoCall(JSContext *cx, uintN argc)
 	    }
 #else
 	    /* Bad old code slams globalObject directly into funobj. */
-	    OBJ_SET_PARENT(funobj, cx->globalObject);
+	    OBJ_SET_PARENT(cx, funobj, cx->globalObject);
 #endif
 	}
 	ok = Interpret(cx, &aval);
 #if !JS_HAS_CALL_OBJECT
 	if (!parent)
-	    OBJ_SET_PARENT(funobj, NULL);
+	    OBJ_SET_PARENT(cx, funobj, NULL);
 #endif
     } else {
 	/* fun might be onerror trying to report a syntax error in itself. */
@@ -572,6 +613,9 @@ js_DoCall(JSContext *cx, uintN argc)
     }
 
 out:
+    if (hook)
+	hook(cx, &frame, JS_FALSE, &ok, hookData);
+
     /*
      * XXX - Checking frame.annotation limits the use of the hook for
      * uses other than releasing annotations, but avoids one C function
@@ -590,7 +634,7 @@ out:
 #endif
 
     /* Pop everything off the stack and store the return value. */
-    PR_ARENA_RELEASE(&cx->stackPool, mark);
+    cx->stackTop = mark;
     JS_LOCK_VOID(cx, cx->fp = fp);
     fp->sp = vp + 1;
     *vp = frame.rval;
@@ -601,22 +645,22 @@ JSBool
 js_Call(JSContext *cx, JSObject *obj, jsval fval, uintN argc, jsval *argv,
 	jsval *rval)
 {
-    void *mark;
     JSStackFrame *fp, *oldfp, frame;
-    jsval *oldsp, *sp;
+    jsval *oldsp, *sp, *mark;
     uintN i;
     JSBool ok;
 
-    mark = PR_ARENA_MARK(&cx->stackPool);
     fp = oldfp = cx->fp;
     if (!fp) {
 	memset(&frame, 0, sizeof frame);
 	JS_LOCK_VOID(cx, cx->fp = fp = &frame);
     }
     oldsp = fp->sp;
-    sp = AllocStack(cx, 2 + argc);
-    if (!sp)
-	return JS_FALSE;
+    sp = mark = js_AllocStack(cx, 2 + argc);
+    if (!sp) {
+	ok = JS_FALSE;
+	goto out;
+    }
     fp->sp = sp;
 
     PUSH(fval);
@@ -629,8 +673,9 @@ js_Call(JSContext *cx, JSObject *obj, jsval fval, uintN argc, jsval *argv,
 	RESTORE_SP(fp);
 	*rval = POP();
     }
+    cx->stackTop = mark;
 
-    PR_ARENA_RELEASE(&cx->stackPool, mark);
+out:
     fp->sp = oldsp;
     if (oldfp != fp)
 	JS_LOCK_VOID(cx, cx->fp = oldfp);
@@ -661,6 +706,7 @@ js_Execute(JSContext *cx, JSObject *chain, JSScript *script, JSStackFrame *down,
     frame.sharpDepth = 0;
     frame.sharpArray = down ? down->sharpArray : NULL;
 #endif
+    frame.stackMark = NULL;
     JS_LOCK_VOID(cx, cx->fp = &frame);
     ok = Interpret(cx, result);
     JS_LOCK_VOID(cx, cx->fp = oldfp);
@@ -741,6 +787,104 @@ ImportProperty(JSContext *cx, JSObject *obj, jsval id)
 #define MAX_INTERP_LEVEL 30
 #endif
 
+/*
+ * Opcode dispatch.  With JS_THREADED_INTERP (the default under GCC), each
+ * op's case ends with its own copy of the code that fetches the next op and
+ * jumps through a table of label addresses to that op's case, so there is an
+ * indirect jump per op rather than one shared by the switch.  The switch is
+ * still used to enter the loop, and to run ops while a debugger interrupt
+ * hook or tracing must see each one.  Build with -DJS_THREADED_INTERP=0 to
+ * get the plain switch interpreter.
+ */
+#ifndef JS_THREADED_INTERP
+#ifdef __GNUC__
+#define JS_THREADED_INTERP 1
+#else
+#define JS_THREADED_INTERP 0
+#endif
+#endif
+
+#ifdef DEBUG
+#define INTERRUPTED     (rt->interruptHandler || cx->tracefp)
+#else
+#define INTERRUPTED     (rt->interruptHandler != NULL)
+#endif
+
+/* Whether the op at pc2 has native code to return to, see jsjit.h. */
+#if JS_HAS_JIT
+#define JIT_ENTRY(pc2)  (jit && jit->entries[(pc2) - script->code])
+#else
+#define JIT_ENTRY(pc2)  0
+#endif
+
+#if JS_THREADED_INTERP
+#define BEGIN_CASE(OP)  case OP: L_##OP:
+#define END_CASE                                                              \
+    {                                                                         \
+	if (INTERRUPTED || pc + len >= endpc || JIT_ENTRY(pc + len))          \
+	    break;                                                            \
+	pc += len;                                                            \
+	fp->pc = pc;                                                          \
+	op = (JSOp) *pc;                                                      \
+	cs = &js_CodeSpec[op];                                                \
+	len = cs->length;                                                     \
+	goto *jumpTable[op];                                                  \
+    }
+#else
+#define BEGIN_CASE(OP)  case OP:
+#define END_CASE        break
+#endif
+
+/*
+ * Superinstructions.  Some ops check whether the next op is one that often
+ * follows them, and if so run it too, entering its case past the code that
+ * pops their result.  That saves a dispatch and a push and pop.  The fused
+ * op skips the interrupt hook and tracing, so no fusing is done while those
+ * are on.  FUSIBLE_NEXT_OP returns JSOP_LIMIT if the next op can't be fused.
+ */
+#define FUSIBLE_NEXT_OP()                                                     \
+    ((pc + len < endpc && !INTERRUPTED) ? (JSOp) pc[len] : JSOP_LIMIT)
+
+#define FUSE_NEXT_OP()                                                        \
+    (pc += len, fp->pc = pc, op = (JSOp) *pc, cs = &js_CodeSpec[op],          \
+     len = cs->length)
+
+/* A compare followed by a conditional jump branches on cond without a push. */
+#define BRANCH_OR_PUSH_COND()                                                 \
+    PR_BEGIN_MACRO                                                            \
+	op2 = FUSIBLE_NEXT_OP();                                              \
+	if (op2 == JSOP_IFEQ || op2 == JSOP_IFNE) {                           \
+	    FUSE_NEXT_OP();                                                   \
+	    if ((cond != JS_FALSE) == (op == JSOP_IFNE)) {                    \
+		len = GET_JUMP_OFFSET(pc);                                    \
+		CHECK_LOOP_BRANCH(len);                                       \
+	    }                                                                 \
+	} else {                                                              \
+	    PUSH_OPND(BOOLEAN_TO_JSVAL(cond));                                \
+	}                                                                     \
+    PR_END_MACRO
+
+/*
+ * Int fast paths.  When an arithmetic or bitwise op's operands are ints, it
+ * computes in jsints, and if the result fits in a jsval INT_RESULT pushes it
+ * and ends the op, without converting to or from jsdouble.  It counts these
+ * results in cx->intArithOps.  An overflow, a -0 or an inexact quotient falls
+ * through to the jsdouble code.  JSVAL_VOID is int-tagged, but isn't an int.
+ */
+#define BOTH_INTS(lval, rval)                                                 \
+    (((lval) & (rval) & JSVAL_INT) &&                                         \
+     (lval) != JSVAL_VOID && (rval) != JSVAL_VOID)
+
+/* Whether the product of ints i and j surely fits in a jsval. */
+#define SMALL_INT(i)            ((jsuint)((i) + 0x7fff) <= 0xfffe)
+
+#define INT_RESULT(k)                                                         \
+    if (INT_FITS_IN_JSVAL(k)) {                                               \
+	cx->intArithOps++;                                                    \
+	PUSH_OPND(INT_TO_JSVAL(k));                                           \
+	END_CASE;                                                             \
+    }
+
 static JSBool
 Interpret(JSContext *cx, jsval *result)
 {
@@ -749,9 +893,9 @@ Interpret(JSContext *cx, jsval *result)
     JSScript *script;
     jsbytecode *pc, *pc2, *endpc;
     JSBranchCallback onbranch;
-    JSBool ok, dropAtom, cond, valid;
-    void *mark;
-    jsval *sp, *newsp;
+    JSBool ok, dropAtom, cond, valid, dense;
+    JSStackFrame *newfp;
+    jsval *mark, *sp, *newsp, *oldtop;
     ptrdiff_t depth, len;
     uintN argc, slot;
     JSOp op, op2;
@@ -762,10 +906,10 @@ Interpret(JSContext *cx, jsval *result)
     JSObject *withobj;
     JSObject *origobj, *propobj, *iterobj;
     JSProperty *prop, *prop2;
+    JSPropertyIC *ic;
     JSString *str, *str2, *str3;
-    size_t length, length2, length3;
-    jschar *chars;
-    jsint i, j;
+    jsint i, j, k;
+    jsuint u;
     jsdouble d, d2;
     JSFunction *fun;
     JSType type;
@@ -781,6 +925,16 @@ Interpret(JSContext *cx, jsval *result)
     JSFunction *fun2;
     JSObject *closure;
 #endif
+#if JS_HAS_JIT
+    JSJITCode *jit;
+#endif
+#if JS_THREADED_INTERP
+    static void *const jumpTable[] = {
+#define OPDEF(op,val,name,token,length,nuses,ndefs,prec,format) &&L_##op,
+#include "jsopcode.def"
+#undef OPDEF
+    };
+#endif
 
     if (cx->interpLevel == MAX_INTERP_LEVEL) {
 	JS_ReportError(cx, "too much recursion");
@@ -798,22 +952,60 @@ Interpret(JSContext *cx, jsval *result)
 
     /*
      * Prepare to call a user-supplied branch handler, and abort the script
-     * if it returns false.
+     * if it returns false.  A backward branch is also where a thread that
+     * wants to run the GC can stop this one, see js_WaitForStop.
      */
     onbranch = cx->branchCallback;
     ok = JS_TRUE;
     dropAtom = JS_FALSE;
+#ifdef JS_THREADSAFE
+#define CHECK_STOP(len) {                                                     \
+    if (len < 0 && rt->stopRequested)                                         \
+	JS_YieldRequest(cx);                                                  \
+}
+#else
+#define CHECK_STOP(len) /* nothing */
+#endif
 #define CHECK_BRANCH(len) {                                                   \
+    CHECK_STOP(len);                                                          \
     if (len < 0 && onbranch && !(ok = (*onbranch)(cx, script)))               \
 	goto out;                                                             \
 }
 
+    /*
+     * A taken backward jump closes a loop.  Compile the script now if it's
+     * still interpreted, since running the loop once has quickened its name
+     * ops (see JSOP_NAME) into ones the JIT compiles.
+     */
+#if JS_HAS_JIT
+#define CHECK_LOOP_BRANCH(len) {                                              \
+    CHECK_BRANCH(len);                                                        \
+    if (len < 0 && !jit && cx->jitEnabled && !script->jit)                    \
+	jit = js_GetJITCode(cx, script);                                      \
+}
+#else
+#define CHECK_LOOP_BRANCH(len) CHECK_BRANCH(len)
+#endif
+
+    /* Compile on a later call, once the first has quickened name ops. */
+#if JS_HAS_JIT
+#define LOAD_JIT_CODE() {                                                     \
+    jit = NULL;                                                               \
+    if (cx->jitEnabled &&                                                     \
+	(script->jit || ++script->useCount >= JS_JIT_HOT_USES)) {             \
+	jit = js_GetJITCode(cx, script);                                      \
+    }                                                                         \
+}
+#else
+#define LOAD_JIT_CODE() /* nothing */
+#endif
+
     /*
      * Allocate operand and pc stack slots for the script's worst-case depth.
      */
-    mark = PR_ARENA_MARK(&cx->stackPool);
+    mark = cx->stackTop;
     depth = (ptrdiff_t)script->depth;
-    newsp = AllocStack(cx, (uintN)(2 * depth));
+    newsp = js_AllocStack(cx, (uintN)(2 * depth));
     if (!newsp) {
 	ok = JS_FALSE;
 	goto out;
@@ -830,8 +1022,27 @@ Interpret(JSContext *cx, jsval *result)
 
     pc = script->code;
     endpc = pc + script->length;
+    LOAD_JIT_CODE();
 
+  resume:
     while (pc < endpc) {
+#if JS_HAS_JIT
+	/*
+	 * Run native code from here to its next exit, then interpret the op
+	 * it exited at.  A trap set in the script since entry clears valid.
+	 */
+	if (JIT_ENTRY(pc) && !INTERRUPTED) {
+	    if (!jit->valid) {
+		jit = NULL;
+	    } else {
+		pc = js_RunJITCode(cx, jit, pc, &sp, &cond);
+		if (cond)
+		    obj = fp->scopeChain;
+		if (pc >= endpc)
+		    break;
+	    }
+	}
+#endif
 	fp->pc = pc;
 	op = *pc;
       do_op:
@@ -882,22 +1093,24 @@ Interpret(JSContext *cx, jsval *result)
 	}
 
 	switch (op) {
-	  case JSOP_NOP:
-	    break;
+	  BEGIN_CASE(JSOP_NOP)
+	    END_CASE;
 
-	  case JSOP_PUSH:
+	  BEGIN_CASE(JSOP_PUSH)
 	    PUSH_OPND(JSVAL_VOID);
-	    break;
+	    END_CASE;
 
-	  case JSOP_POP:
+	  BEGIN_CASE(JSOP_POP)
 	    sp--;
-	    break;
+	    END_CASE;
 
-	  case JSOP_POPV:
-	    *result = POP();
-	    break;
+	  BEGIN_CASE(JSOP_POPV)
+	    rval = POP();
+	    if (!fp->stackMark)
+		*result = rval;
+	    END_CASE;
 
-	  case JSOP_ENTERWITH:
+	  BEGIN_CASE(JSOP_ENTERWITH)
 	    rval = POP();
 	    VALUE_TO_OBJECT(cx, rval, obj);
 	    withobj = js_NewObject(cx, &js_WithClass, obj, fp->scopeChain);
@@ -905,9 +1118,9 @@ Interpret(JSContext *cx, jsval *result)
 		goto out;
 	    fp->scopeChain = withobj;
 	    PUSH(OBJECT_TO_JSVAL(withobj));
-	    break;
+	    END_CASE;
 
-	  case JSOP_LEAVEWITH:
+	  BEGIN_CASE(JSOP_LEAVEWITH)
 	    rval = POP();
 	    PR_ASSERT(JSVAL_IS_OBJECT(rval));
 	    withobj = JSVAL_TO_OBJECT(rval);
@@ -916,70 +1129,70 @@ Interpret(JSContext *cx, jsval *result)
 	    rval = OBJ_GET_SLOT(withobj, JSSLOT_PARENT);
 	    PR_ASSERT(JSVAL_IS_OBJECT(rval));
 	    fp->scopeChain = JSVAL_TO_OBJECT(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_RETURN:
+	  BEGIN_CASE(JSOP_RETURN)
 	    CHECK_BRANCH(-1);
 	    fp->rval = POP();
 	    goto out;
 
-	  case JSOP_GOTO:
+	  BEGIN_CASE(JSOP_GOTO)
 	    len = GET_JUMP_OFFSET(pc);
-	    CHECK_BRANCH(len);
-	    break;
+	    CHECK_LOOP_BRANCH(len);
+	    END_CASE;
 
-	  case JSOP_IFEQ:
+	  BEGIN_CASE(JSOP_IFEQ)
 	    rval = POP();
 	    VALUE_TO_BOOLEAN(cx, rval, cond);
 	    if (cond == JS_FALSE) {
 		len = GET_JUMP_OFFSET(pc);
-		CHECK_BRANCH(len);
+		CHECK_LOOP_BRANCH(len);
 	    }
-	    break;
+	    END_CASE;
 
-	  case JSOP_IFNE:
+	  BEGIN_CASE(JSOP_IFNE)
 	    rval = POP();
 	    VALUE_TO_BOOLEAN(cx, rval, cond);
 	    if (cond != JS_FALSE) {
 		len = GET_JUMP_OFFSET(pc);
-		CHECK_BRANCH(len);
+		CHECK_LOOP_BRANCH(len);
 	    }
-	    break;
+	    END_CASE;
 
 #if !JS_BUG_SHORT_CIRCUIT
-	  case JSOP_OR:
+	  BEGIN_CASE(JSOP_OR)
 	    rval = POP();
 	    VALUE_TO_BOOLEAN(cx, rval, cond);
 	    if (cond == JS_TRUE) {
 		len = GET_JUMP_OFFSET(pc);
 		PUSH_OPND(rval);
 	    }
-	    break;
+	    END_CASE;
 
-	  case JSOP_AND:
+	  BEGIN_CASE(JSOP_AND)
 	    rval = POP();
 	    VALUE_TO_BOOLEAN(cx, rval, cond);
 	    if (cond == JS_FALSE) {
 		len = GET_JUMP_OFFSET(pc);
 		PUSH_OPND(rval);
 	    }
-	    break;
+	    END_CASE;
 #endif
 
-	  case JSOP_FORNAME:
+	  BEGIN_CASE(JSOP_FORNAME)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 	    rval = POP();
 
 	    SAVE_SP(fp);
-	    JS_LOCK_RUNTIME_VOID(rt, ok = js_FindVariable(cx, id, &obj, &prop));
+	    JS_LOCK_VOID(cx, ok = js_FindVariable(cx, id, &obj, &prop));
 	    if (!ok)
 		goto out;
 	    PR_ASSERT(prop);
 	    lval = OBJECT_TO_JSVAL(obj);
 	    goto do_forinloop;
 
-	  case JSOP_FORPROP:
+	  BEGIN_CASE(JSOP_FORPROP)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 	    rval = POP();
@@ -990,7 +1203,7 @@ Interpret(JSContext *cx, jsval *result)
     /* If the index is other than a nonnegative int, atomize it. */           \
     i = JSVAL_IS_INT(id) ? JSVAL_TO_INT(id) : -1;                             \
     if (i < 0) {                                                              \
-	JS_LOCK_RUNTIME_VOID(rt, atom = js_ValueToStringAtom(cx, id));        \
+	JS_LOCK_VOID(cx, atom = js_ValueToStringAtom(cx, id));                \
 	if (!atom) {                                                          \
 	    ok = JS_FALSE;                                                    \
 	    goto out;                                                         \
@@ -1000,7 +1213,7 @@ Interpret(JSContext *cx, jsval *result)
     }                                                                         \
 }
 
-	  case JSOP_FORELEM:
+	  BEGIN_CASE(JSOP_FORELEM)
 	    rval = POP();
 	    id   = POP();
 	    lval = POP();
@@ -1011,10 +1224,10 @@ Interpret(JSContext *cx, jsval *result)
 	  do_forinloop:
 	    /* Lock the entire bytecode's critical section if threadsafe. */
 	    SAVE_SP(fp);
-	    JS_LOCK_RUNTIME(rt);
+	    JS_LOCK(cx);
 	    ok = js_ValueToObject(cx, rval, &obj);
 	    if (!ok) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		goto out;
 	    }
 
@@ -1035,7 +1248,7 @@ Interpret(JSContext *cx, jsval *result)
 		/* Let lazy reflectors be eager so for/in finds everything. */
 		ok = obj->map->clasp->enumerate(cx, obj);
 		if (!ok) {
-		    JS_UNLOCK_RUNTIME(rt);
+		    JS_UNLOCK(cx);
 		    goto out;
 		}
 	    }
@@ -1053,12 +1266,14 @@ Interpret(JSContext *cx, jsval *result)
 		/* Set the iterator to point to the first property. */
 		propobj = js_NewObject(cx, &prop_iterator_class, NULL, NULL);
 		if (!propobj) {
-		    JS_UNLOCK_RUNTIME(rt);
+		    JS_UNLOCK(cx);
 		    ok = JS_FALSE;
 		    goto out;
 		}
-		OBJ_SET_SLOT(propobj, JSSLOT_PROP_OBJECT, OBJECT_TO_JSVAL(obj));
-		OBJ_SET_SLOT(propobj, JSSLOT_PROP_NEXT, PRIVATE_TO_JSVAL(NULL));
+		OBJ_SET_SLOT(cx, propobj, JSSLOT_PROP_OBJECT,
+			     OBJECT_TO_JSVAL(obj));
+		OBJ_SET_SLOT(cx, propobj, JSSLOT_PROP_NEXT,
+			     PRIVATE_TO_JSVAL(NULL));
 
 		/* Rewrite the iterator so we know to do the next case. */
 		*vp = OBJECT_TO_JSVAL(propobj);
@@ -1087,7 +1302,7 @@ Interpret(JSContext *cx, jsval *result)
 					   sym_id(prop->symbols), NULL,
 					   &prop2);
 		    if (!ok) {
-			JS_UNLOCK_RUNTIME(rt);
+			JS_UNLOCK(cx);
 			goto out;
 		    }
 		    if (prop2 == prop) {
@@ -1102,14 +1317,20 @@ Interpret(JSContext *cx, jsval *result)
 		/* Enumerate prototype properties, if there are any. */
 		if (proto) {
 		    obj = proto;
-		    OBJ_SET_SLOT(propobj, JSSLOT_PROP_OBJECT,
+		    if (OBJ_IS_DENSE_ARRAY(obj) &&
+			!js_MakeArraySlow(cx, obj)) {
+			JS_UNLOCK(cx);
+			ok = JS_FALSE;
+			goto out;
+		    }
+		    OBJ_SET_SLOT(cx, propobj, JSSLOT_PROP_OBJECT,
 				 OBJECT_TO_JSVAL(obj));
 		    rval = OBJ_GET_SLOT(propobj, JSSLOT_PROP_NEXT);
 		    prop = JSVAL_TO_PRIVATE(rval);
 		    if (prop)
 			js_DropProperty(cx, prop);
 		    prop = obj->map->props;
-		    OBJ_SET_SLOT(propobj, JSSLOT_PROP_NEXT,
+		    OBJ_SET_SLOT(cx, propobj, JSSLOT_PROP_NEXT,
 				 PRIVATE_TO_JSVAL(prop));
 		    js_HoldProperty(cx, prop);
 		    goto do_forin_again;
@@ -1126,9 +1347,10 @@ Interpret(JSContext *cx, jsval *result)
 	    if (prop2)
 		js_DropProperty(cx, prop2);
 	    prop2 = prop->next;
-	    OBJ_SET_SLOT(propobj, JSSLOT_PROP_NEXT, PRIVATE_TO_JSVAL(prop2));
+	    OBJ_SET_SLOT(cx, propobj, JSSLOT_PROP_NEXT,
+			 PRIVATE_TO_JSVAL(prop2));
 	    if (!ok) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		goto out;
 	    }
 	    js_HoldProperty(cx, prop2);
@@ -1143,7 +1365,7 @@ Interpret(JSContext *cx, jsval *result)
 	    if (cx->version < JSVERSION_1_2 && JSVAL_IS_INT(rval)) {
 		str = js_NumberToString(cx, (jsdouble) JSVAL_TO_INT(rval));
 		if (!str) {
-		    JS_UNLOCK_RUNTIME(rt);
+		    JS_UNLOCK(cx);
 		    ok = JS_FALSE;
 		    goto out;
 		}
@@ -1155,7 +1377,7 @@ Interpret(JSContext *cx, jsval *result)
 	    /* Set the variable obj[id] to refer to rval. */
 	    prop = js_SetProperty(cx, obj, id, &rval);
 	    if (!prop) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		ok = JS_FALSE;
 		goto out;
 	    }
@@ -1168,23 +1390,23 @@ Interpret(JSContext *cx, jsval *result)
 		js_DropAtom(cx, atom);
 		dropAtom = JS_FALSE;
 	    }
-	    JS_UNLOCK_RUNTIME(rt);
+	    JS_UNLOCK(cx);
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_DUP:
+	  BEGIN_CASE(JSOP_DUP)
 	    PR_ASSERT(sp > newsp);
 	    rval = sp[-1];
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_DUP2:
+	  BEGIN_CASE(JSOP_DUP2)
 	    PR_ASSERT(sp - 1 > newsp);
 	    lval = sp[-2];
 	    rval = sp[-1];
 	    PUSH_OPND(lval);
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
 #define PROPERTY_OP(call, result) {                                           \
     /* Pop the left part and resolve it to a non-null object. */              \
@@ -1192,9 +1414,9 @@ Interpret(JSContext *cx, jsval *result)
     VALUE_TO_OBJECT(cx, lval, obj);                                           \
 									      \
     /* Get or set the property, set result zero if error, non-zero if ok. */  \
-    JS_LOCK_RUNTIME(rt);                                                      \
+    JS_LOCK(cx);                                                              \
     call;                                                                     \
-    JS_UNLOCK_RUNTIME(rt);                                                    \
+    JS_UNLOCK(cx);                                                            \
     if (!result) {                                                            \
 	ok = JS_FALSE;                                                        \
 	goto out;                                                             \
@@ -1206,11 +1428,30 @@ Interpret(JSContext *cx, jsval *result)
     FIX_ELEMENT_ID(id);                                                       \
     PROPERTY_OP(call, result);                                                \
     if (dropAtom) {                                                           \
-	JS_LOCK_RUNTIME_VOID(rt, js_DropAtom(cx, atom));                      \
+	JS_LOCK_VOID(cx, js_DropAtom(cx, atom));                              \
 	dropAtom = JS_FALSE;                                                  \
     }                                                                         \
 }
 
+/*
+ * If lval is an array and id an int, try fastop, which is js_LoadDenseElement
+ * or js_StoreDenseElement, then op, which is js_GetDenseElement or
+ * js_SetDenseElement, on obj, id, and rval.  Set dense to whether either did
+ * the element op; if not, the caller takes the generic property path.
+ */
+#define DENSE_ELEMENT_OP(fastop, op) {                                        \
+    dense = JS_FALSE;                                                         \
+    if (JSVAL_IS_INT(id) && JSVAL_IS_OBJECT(lval) && lval != JSVAL_NULL &&    \
+	JSVAL_TO_OBJECT(lval)->map->clasp == &js_ArrayClass) {                \
+	obj = JSVAL_TO_OBJECT(lval);                                          \
+	dense = fastop(cx, obj, JSVAL_TO_INT(id), &rval);                     \
+	if (!dense) {                                                         \
+	    SAVE_SP(fp);                                                      \
+	    JS_LOCK_VOID(cx, dense = op(cx, obj, JSVAL_TO_INT(id), &rval));   \
+	}                                                                     \
+    }                                                                         \
+}
+
 #define CACHED_GET(call) {                                                    \
     PROPERTY_CACHE_TEST(&rt->propertyCache, obj, id, prop);                   \
     if (PROP_FOUND(prop)) {                                                   \
@@ -1218,10 +1459,12 @@ Interpret(JSContext *cx, jsval *result)
 	slot = (uintN)prop->slot;                                             \
 	rval = obj2->slots[slot];                                             \
 	ok = prop->getter(cx, obj, prop->id, &rval);                          \
-	if (ok)                                                               \
+	if (ok) {                                                             \
+	    GC_WRITE_BARRIER(cx, obj2, rval);                                 \
 	    obj2->slots[slot] = rval;                                         \
-	else                                                                  \
+	} else {                                                              \
 	    prop = NULL;                                                      \
+	}                                                                     \
     } else {                                                                  \
 	SAVE_SP(fp);                                                          \
 	prop = call;                                                          \
@@ -1236,7 +1479,11 @@ Interpret(JSContext *cx, jsval *result)
 	!(prop->flags & (JSPROP_READONLY | JSPROP_ASSIGNHACK))) {             \
 	ok = prop->setter(cx, obj, prop->id, &rval);                          \
 	if (ok) {                                                             \
-	    prop->flags |= JSPROP_ENUMERATE;                                  \
+	    if (!(prop->flags & JSPROP_ENUMERATE)) {                          \
+		prop->flags |= JSPROP_ENUMERATE;                              \
+		PROPERTY_CHANGED(cx, prop);                                   \
+	    }                                                                 \
+	    GC_WRITE_BARRIER(cx, prop->object, rval);                         \
 	    prop->object->slots[prop->slot] = rval;                           \
 	} else {                                                              \
 	    prop = NULL;                                                      \
@@ -1248,16 +1495,16 @@ Interpret(JSContext *cx, jsval *result)
     }                                                                         \
 }
 
-	  case JSOP_SETNAME:
+	  BEGIN_CASE(JSOP_SETNAME)
 	    /* Get an immediate atom naming the variable to set. */
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 
 	    SAVE_SP(fp);
-	    JS_LOCK_RUNTIME(rt);
+	    JS_LOCK(cx);
 	    ok = js_FindVariable(cx, id, &obj, &prop);
 	    if (!ok) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		goto out;
 	    }
 
@@ -1267,7 +1514,7 @@ Interpret(JSContext *cx, jsval *result)
 	    /* Try to hit the property cache, FindVariable primes it. */
 	    CACHED_SET(js_SetProperty(cx, obj, id, &rval));
 	    if (!prop) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		ok = JS_FALSE;
 		goto out;
 	    }
@@ -1289,40 +1536,51 @@ Interpret(JSContext *cx, jsval *result)
 		}
 	    }
 
-	    JS_UNLOCK_RUNTIME(rt);
-	    break;
+	    JS_UNLOCK(cx);
+	    END_CASE;
 
-#define INTEGER_OP(OP, EXTRA_CODE, LEFT_CAST) {                               \
+#define POP_INT(i) {                                                          \
+    rval = sp[-1];                                                            \
+    if (JSVAL_IS_INT(rval)) {                                                 \
+	i = JSVAL_TO_INT(rval);                                               \
+	sp--;                                                                 \
+    } else {                                                                  \
+	SAVE_SP(fp);                                                          \
+	ok = PopInt(cx, &i, &valid);                                          \
+	RESTORE_SP(fp);                                                       \
+	if (!ok)                                                              \
+	    goto out;                                                         \
+    }                                                                         \
+}
+
+#define INTEGER_OP(OP, EXTRA_CODE) {                                          \
     valid = JS_TRUE;                                                          \
-    SAVE_SP(fp);                                                              \
-    ok = PopInt(cx, &j, &valid) && PopInt(cx, &i, &valid);                    \
-    RESTORE_SP(fp);                                                           \
-    if (!ok)                                                                  \
-	goto out;                                                             \
+    POP_INT(j);                                                               \
+    POP_INT(i);                                                               \
     EXTRA_CODE                                                                \
     if (!valid) {                                                             \
 	PUSH_OPND(DOUBLE_TO_JSVAL(rt->jsNaN));                                \
     } else {                                                                  \
-	i = LEFT_CAST i OP j;                                                 \
+	i = i OP j;                                                           \
+	INT_RESULT(i);                                                        \
 	PUSH_NUMBER(cx, i);                                                   \
     }                                                                         \
 }
 
-#define BITWISE_OP(OP)		INTEGER_OP(OP, (void) 0;, (jsint))
-#define SIGNED_SHIFT_OP(OP)	INTEGER_OP(OP, j &= 31;, (jsint))
-#define UNSIGNED_SHIFT_OP(OP)	INTEGER_OP(OP, j &= 31;, (jsuint))
+#define BITWISE_OP(OP)		INTEGER_OP(OP, (void) 0;)
+#define SIGNED_SHIFT_OP(OP)	INTEGER_OP(OP, j &= 31;)
 
-	  case JSOP_BITOR:
+	  BEGIN_CASE(JSOP_BITOR)
 	    BITWISE_OP(|);
-	    break;
+	    END_CASE;
 
-	  case JSOP_BITXOR:
+	  BEGIN_CASE(JSOP_BITXOR)
 	    BITWISE_OP(^);
-	    break;
+	    END_CASE;
 
-	  case JSOP_BITAND:
+	  BEGIN_CASE(JSOP_BITAND)
 	    BITWISE_OP(&);
-	    break;
+	    END_CASE;
 
 #ifdef XP_PC
 #define COMPARE_DOUBLES(LVAL, OP, RVAL, IFNAN)                                \
@@ -1333,6 +1591,15 @@ Interpret(JSContext *cx, jsval *result)
 #define COMPARE_DOUBLES(LVAL, OP, RVAL, IFNAN) ((LVAL) OP (RVAL))
 #endif
 
+/* Flatten ropes before comparing them, see jsstr.h. */
+#define FLATTEN_STRINGS(str, str2)                                            \
+    PR_BEGIN_MACRO                                                            \
+	if (!JSSTRING_FLATTEN(cx, str) || !JSSTRING_FLATTEN(cx, str2)) {      \
+	    ok = JS_FALSE;                                                    \
+	    goto out;                                                         \
+	}                                                                     \
+    PR_END_MACRO
+
 #define RELATIONAL_OP(OP) {                                                   \
     rval = POP();                                                             \
     lval = POP();                                                             \
@@ -1354,6 +1621,7 @@ Interpret(JSContext *cx, jsval *result)
 	if (JSVAL_IS_STRING(lval) && JSVAL_IS_STRING(rval)) {                 \
 	    str  = JSVAL_TO_STRING(lval);                                     \
 	    str2 = JSVAL_TO_STRING(rval);                                     \
+	    FLATTEN_STRINGS(str, str2);                                       \
 	    cond = js_CompareStrings(str, str2) OP 0;                         \
 	} else {                                                              \
 	    VALUE_TO_NUMBER(cx, ltmp, d);                                     \
@@ -1361,7 +1629,7 @@ Interpret(JSContext *cx, jsval *result)
 	    cond = COMPARE_DOUBLES(d, OP, d2, JS_FALSE);                      \
 	}                                                                     \
     }                                                                         \
-    PUSH_OPND(BOOLEAN_TO_JSVAL(cond));                                        \
+    BRANCH_OR_PUSH_COND();                                                    \
 }
 
 #define EQUALITY_OP(OP, IFNAN) {                                              \
@@ -1373,6 +1641,7 @@ Interpret(JSContext *cx, jsval *result)
 	if (ltmp == JSVAL_STRING) {                                           \
 	    str  = JSVAL_TO_STRING(lval);                                     \
 	    str2 = JSVAL_TO_STRING(rval);                                     \
+	    FLATTEN_STRINGS(str, str2);                                       \
 	    cond = js_CompareStrings(str, str2) OP 0;                         \
 	} else if (ltmp == JSVAL_DOUBLE) {                                    \
 	    d  = *JSVAL_TO_DOUBLE(lval);                                      \
@@ -1394,6 +1663,7 @@ Interpret(JSContext *cx, jsval *result)
 	    if (JSVAL_IS_STRING(lval) && JSVAL_IS_STRING(rval)) {             \
 		str  = JSVAL_TO_STRING(lval);                                 \
 		str2 = JSVAL_TO_STRING(rval);                                 \
+		FLATTEN_STRINGS(str, str2);                                   \
 		cond = js_CompareStrings(str, str2) OP 0;                     \
 	    } else {                                                          \
 		VALUE_TO_NUMBER(cx, ltmp, d);                                 \
@@ -1402,16 +1672,16 @@ Interpret(JSContext *cx, jsval *result)
 	    }                                                                 \
 	}                                                                     \
     }                                                                         \
-    PUSH_OPND(BOOLEAN_TO_JSVAL(cond));                                        \
+    BRANCH_OR_PUSH_COND();                                                    \
 }
 
-	  case JSOP_EQ:
+	  BEGIN_CASE(JSOP_EQ)
 	    EQUALITY_OP(==, JS_FALSE);
-	    break;
+	    END_CASE;
 
-	  case JSOP_NE:
+	  BEGIN_CASE(JSOP_NE)
 	    EQUALITY_OP(!=, JS_TRUE);
-	    break;
+	    END_CASE;
 
 #if !JS_BUG_FALLIBLE_EQOPS
 #define NEW_EQUALITY_OP(OP, IFNAN) {                                          \
@@ -1423,6 +1693,7 @@ Interpret(JSContext *cx, jsval *result)
 	if (ltmp == JSVAL_STRING) {                                           \
 	    str  = JSVAL_TO_STRING(lval);                                     \
 	    str2 = JSVAL_TO_STRING(rval);                                     \
+	    FLATTEN_STRINGS(str, str2);                                       \
 	    cond = js_CompareStrings(str, str2) OP 0;                         \
 	} else if (ltmp == JSVAL_DOUBLE) {                                    \
 	    d  = *JSVAL_TO_DOUBLE(lval);                                      \
@@ -1444,67 +1715,93 @@ Interpret(JSContext *cx, jsval *result)
 	    cond = lval OP rval;                                              \
 	}                                                                     \
     }                                                                         \
-    PUSH_OPND(BOOLEAN_TO_JSVAL(cond));                                        \
+    BRANCH_OR_PUSH_COND();                                                    \
 }
 
-	  case JSOP_NEW_EQ:
+	  BEGIN_CASE(JSOP_NEW_EQ)
 	    NEW_EQUALITY_OP(==, JS_FALSE);
-	    break;
+	    END_CASE;
 
-	  case JSOP_NEW_NE:
+	  BEGIN_CASE(JSOP_NEW_NE)
 	    NEW_EQUALITY_OP(!=, JS_TRUE);
-	    break;
+	    END_CASE;
 #endif /* !JS_BUG_FALLIBLE_EQOPS */
 
-	  case JSOP_LT:
+	  BEGIN_CASE(JSOP_LT)
 	    RELATIONAL_OP(<);
-	    break;
+	    END_CASE;
 
-	  case JSOP_LE:
+	  BEGIN_CASE(JSOP_LE)
 	    RELATIONAL_OP(<=);
-	    break;
+	    END_CASE;
 
-	  case JSOP_GT:
+	  BEGIN_CASE(JSOP_GT)
 	    RELATIONAL_OP(>);
-	    break;
+	    END_CASE;
 
-	  case JSOP_GE:
+	  BEGIN_CASE(JSOP_GE)
 	    RELATIONAL_OP(>=);
-	    break;
+	    END_CASE;
 
 #undef EQUALITY_OP
 #undef RELATIONAL_OP
 
-	  case JSOP_LSH:
+	  BEGIN_CASE(JSOP_LSH)
 	    SIGNED_SHIFT_OP(<<);
-	    break;
+	    END_CASE;
 
-	  case JSOP_RSH:
+	  BEGIN_CASE(JSOP_RSH)
 	    SIGNED_SHIFT_OP(>>);
-	    break;
+	    END_CASE;
 
-	  case JSOP_URSH:
-	    UNSIGNED_SHIFT_OP(>>);
-	    break;
+	  BEGIN_CASE(JSOP_URSH)
+	    valid = JS_TRUE;
+	    POP_INT(j);
+	    POP_INT(i);
+	    if (!valid) {
+		PUSH_OPND(DOUBLE_TO_JSVAL(rt->jsNaN));
+	    } else {
+		/* Only a zero shift of a negative int can exceed a jsint. */
+		u = (jsuint)i >> (j & 31);
+		if (u <= JSVAL_INT_MAX) {
+		    i = (jsint)u;
+		    INT_RESULT(i);
+		}
+		d = (jsdouble)u;
+		PUSH_NUMBER(cx, d);
+	    }
+	    END_CASE;
 
 #undef INTEGER_OP
 #undef BITWISE_OP
 #undef SIGNED_SHIFT_OP
-#undef UNSIGNED_SHIFT_OP
 
-	  case JSOP_ADD:
-	    rval = rtmp = POP();
-	    lval = ltmp = POP();
+	  BEGIN_CASE(JSOP_ADD)
+	    rval = POP();
+
+	  do_add:
+	    lval = POP();
+	    if (BOTH_INTS(lval, rval)) {
+		i = JSVAL_TO_INT(lval) + JSVAL_TO_INT(rval);
+		INT_RESULT(i);
+	    }
+	    rtmp = rval;
+	    ltmp = lval;
 	    VALUE_TO_PRIMITIVE(cx, lval, &lval);
 	    VALUE_TO_PRIMITIVE(cx, rval, &rval);
 	    if ((cond = JSVAL_IS_STRING(lval)) || JSVAL_IS_STRING(rval)) {
 		if (cond) {
-		    /* Keep a ref to str on the stack so it isn't GC'd. */
 		    str = JSVAL_TO_STRING(lval);
-		    PUSH(STRING_TO_JSVAL(str));
-		    SAVE_SP(fp);
-		    ok = (str2 = JS_ValueToString(cx, rval)) != 0;
-		    (void) POP();
+		    if (JSVAL_IS_STRING(rval)) {
+			/* Don't flatten a rope by converting it, see jsstr.h. */
+			str2 = JSVAL_TO_STRING(rval);
+		    } else {
+			/* Keep a ref to str on the stack so it isn't GC'd. */
+			PUSH(STRING_TO_JSVAL(str));
+			SAVE_SP(fp);
+			ok = (str2 = JS_ValueToString(cx, rval)) != 0;
+			(void) POP();
+		    }
 		} else {
 		    /* Keep a ref to str2 on the stack so it isn't GC'd. */
 		    str2 = JSVAL_TO_STRING(rval);
@@ -1515,26 +1812,16 @@ Interpret(JSContext *cx, jsval *result)
 		}
 		if (!ok)
 		    goto out;
-		if ((length = str->length) == 0) {
-		    str3 = str2;
-		} else if ((length2 = str2->length) == 0) {
-		    str3 = str;
-		} else {
-		    length3 = length + length2;
-		    chars = JS_malloc(cx, (length3 + 1) * sizeof(jschar));
-		    if (!chars) {
-			ok = JS_FALSE;
-			goto out;
-		    }
-		    js_strncpy(chars, str->chars, length);
-		    js_strncpy(chars + length, str2->chars, length2);
-		    chars[length3] = 0;
-		    str3 = js_NewString(cx, chars, length3, 0);
-		    if (!str3) {
-			JS_free(cx, chars);
-			ok = JS_FALSE;
-			goto out;
-		    }
+
+		/* Keep both on the stack while js_ConcatStrings allocates. */
+		PUSH(STRING_TO_JSVAL(str));
+		PUSH(STRING_TO_JSVAL(str2));
+		SAVE_SP(fp);
+		str3 = js_ConcatStrings(cx, str, str2);
+		sp -= 2;
+		if (!str3) {
+		    ok = JS_FALSE;
+		    goto out;
 		}
 		PUSH_OPND(STRING_TO_JSVAL(str3));
 	    } else {
@@ -1543,26 +1830,57 @@ Interpret(JSContext *cx, jsval *result)
 		d += d2;
 		PUSH_NUMBER(cx, d);
 	    }
-	    break;
+	    END_CASE;
 
-#define BINARY_OP(OP) {                                                       \
-    POP_NUMBER(cx, d2);                                                       \
-    POP_NUMBER(cx, d);                                                        \
-    d = d OP d2;                                                              \
-    PUSH_NUMBER(cx, d);                                                       \
-}
+/*
+ * Pop the operands of a binary arithmetic op into lval and rval, and convert
+ * them to d and d2 unless both are ints, which the op tries first.
+ */
+#define POP_OPERANDS()                                                        \
+    rval = POP();                                                             \
+    lval = POP();                                                             \
+    cond = BOTH_INTS(lval, rval);                                             \
+    if (cond) {                                                               \
+	i = JSVAL_TO_INT(lval);                                               \
+	j = JSVAL_TO_INT(rval);                                               \
+    }
 
-	  case JSOP_SUB:
-	    BINARY_OP(-);
-	    break;
+#define CONVERT_OPERANDS() {                                                  \
+    VALUE_TO_NUMBER(cx, rval, d2);                                            \
+    VALUE_TO_NUMBER(cx, lval, d);                                             \
+}
 
-	  case JSOP_MUL:
-	    BINARY_OP(*);
-	    break;
+	  BEGIN_CASE(JSOP_SUB)
+	    POP_OPERANDS();
+	    if (cond) {
+		i -= j;
+		INT_RESULT(i);
+	    }
+	    CONVERT_OPERANDS();
+	    d -= d2;
+	    PUSH_NUMBER(cx, d);
+	    END_CASE;
+
+	  BEGIN_CASE(JSOP_MUL)
+	    POP_OPERANDS();
+	    if (cond && SMALL_INT(i) && SMALL_INT(j)) {
+		/* Zero times a negative number is -0. */
+		k = i * j;
+		if (k != 0 || (i | j) >= 0)
+		    INT_RESULT(k);
+	    }
+	    CONVERT_OPERANDS();
+	    d *= d2;
+	    PUSH_NUMBER(cx, d);
+	    END_CASE;
 
-	  case JSOP_DIV:
-	    POP_NUMBER(cx, d2);
-	    POP_NUMBER(cx, d);
+	  BEGIN_CASE(JSOP_DIV)
+	    POP_OPERANDS();
+	    if (cond && j != 0 && i % j == 0 && (i != 0 || j > 0)) {
+		i /= j;
+		INT_RESULT(i);
+	    }
+	    CONVERT_OPERANDS();
 	    if (d2 == 0) {
 		if (d == 0 || JSDOUBLE_IS_NaN(d))
 		    rval = DOUBLE_TO_JSVAL(rt->jsNaN);
@@ -1575,11 +1893,15 @@ Interpret(JSContext *cx, jsval *result)
 		d /= d2;
 		PUSH_NUMBER(cx, d);
 	    }
-	    break;
+	    END_CASE;
 
-	  case JSOP_MOD:
-	    POP_NUMBER(cx, d2);
-	    POP_NUMBER(cx, d);
+	  BEGIN_CASE(JSOP_MOD)
+	    POP_OPERANDS();
+	    if (cond && i >= 0 && j > 0) {
+		i %= j;
+		INT_RESULT(i);
+	    }
+	    CONVERT_OPERANDS();
 	    if (d2 == 0) {
 		PUSH_OPND(DOUBLE_TO_JSVAL(rt->jsNaN));
 	    } else {
@@ -1590,41 +1912,53 @@ Interpret(JSContext *cx, jsval *result)
 		d = fmod(d, d2);
 		PUSH_NUMBER(cx, d);
 	    }
-	    break;
+	    END_CASE;
+
+#undef POP_OPERANDS
+#undef CONVERT_OPERANDS
 
-	  case JSOP_NOT:
+	  BEGIN_CASE(JSOP_NOT)
 	    rval = POP();
 	    VALUE_TO_BOOLEAN(cx, rval, cond);
 	    PUSH_OPND(BOOLEAN_TO_JSVAL(!cond));
-	    break;
+	    END_CASE;
 
-	  case JSOP_BITNOT:
+	  BEGIN_CASE(JSOP_BITNOT)
 	    valid = JS_TRUE;
-	    SAVE_SP(fp);
-	    ok = PopInt(cx, &i, &valid);
-	    RESTORE_SP(fp);
-	    if (!ok)
-		goto out;
+	    POP_INT(i);
 	    if (!valid) {
 		PUSH_OPND(DOUBLE_TO_JSVAL(rt->jsNaN));
 	    } else {
 		i = ~i;
+		INT_RESULT(i);
 		PUSH_NUMBER(cx, i);
 	    }
-	    break;
+	    END_CASE;
+
+#undef POP_INT
 
-	  case JSOP_NEG:
-	    POP_NUMBER(cx, d);
+	  BEGIN_CASE(JSOP_NEG)
+	    rval = POP();
+	    if (JSVAL_IS_INT(rval) && rval != JSVAL_ZERO) {
+		i = -JSVAL_TO_INT(rval);
+		INT_RESULT(i);
+	    }
+	    VALUE_TO_NUMBER(cx, rval, d);
 	    d = -d;
 	    PUSH_NUMBER(cx, d);
-	    break;
+	    END_CASE;
 
-	  case JSOP_POS:
-	    POP_NUMBER(cx, d);
+	  BEGIN_CASE(JSOP_POS)
+	    rval = POP();
+	    if (JSVAL_IS_INT(rval)) {
+		i = JSVAL_TO_INT(rval);
+		INT_RESULT(i);
+	    }
+	    VALUE_TO_NUMBER(cx, rval, d);
 	    PUSH_NUMBER(cx, d);
-	    break;
+	    END_CASE;
 
-	  case JSOP_NEW:
+	  BEGIN_CASE(JSOP_NEW)
 	    /* Get immediate argc and find the constructor function. */
 	    argc = GET_ARGC(pc);
 
@@ -1634,10 +1968,10 @@ Interpret(JSContext *cx, jsval *result)
 
 	    /* Reset fp->sp so error reports decompile *vp's generator. */
 	    fp->sp = vp;
-	    JS_LOCK_RUNTIME(rt);
+	    JS_LOCK(cx);
 	    fun = js_ValueToFunction(cx, *vp);
 	    if (!fun) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		ok = JS_FALSE;
 		goto out;
 	    }
@@ -1647,7 +1981,7 @@ Interpret(JSContext *cx, jsval *result)
 				  (jsval)rt->atomState.classPrototypeAtom,
 				  &rval);
 	    if (!prop) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		ok = JS_FALSE;
 		goto out;
 	    }
@@ -1659,7 +1993,7 @@ Interpret(JSContext *cx, jsval *result)
 		obj = js_NewObject(cx, &js_ObjectClass, NULL, parent);
 	    else
 		obj = js_NewObject(cx, proto->map->clasp, proto, parent);
-	    JS_UNLOCK_RUNTIME(rt);
+	    JS_UNLOCK(cx);
 	    if (!obj) {
 		ok = JS_FALSE;
 		goto out;
@@ -1684,60 +2018,60 @@ Interpret(JSContext *cx, jsval *result)
 		if (obj2 != obj)
 		    obj = obj2;
 	    }
-	    break;
+	    END_CASE;
 
-	  case JSOP_DELNAME:
+	  BEGIN_CASE(JSOP_DELNAME)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 
-	    JS_LOCK_RUNTIME(rt);
+	    JS_LOCK(cx);
 	    ok = js_FindProperty(cx, id, &obj, &prop);
 	    if (ok && prop) {
 		/* Call js_DeleteProperty2 to avoid id re-lookup. */
 		ok = js_DeleteProperty2(cx, obj, prop, id, &rval);
 	    }
-	    JS_UNLOCK_RUNTIME(rt);
+	    JS_UNLOCK(cx);
 	    if (!ok)
 		goto out;
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_DELPROP:
+	  BEGIN_CASE(JSOP_DELPROP)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 	    SAVE_SP(fp);
 	    PROPERTY_OP(ok = js_DeleteProperty(cx, obj, id, &rval), ok);
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_DELELEM:
+	  BEGIN_CASE(JSOP_DELELEM)
 	    SAVE_SP(fp);
 	    ELEMENT_OP(ok = js_DeleteProperty(cx, obj, id, &rval), ok);
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_TYPEOF:
+	  BEGIN_CASE(JSOP_TYPEOF)
 	    rval = POP();
 	    type = JS_TypeOfValue(cx, rval);
 	    atom = rt->atomState.typeAtoms[type];
 	    str  = ATOM_TO_STRING(atom);
 	    PUSH_OPND(STRING_TO_JSVAL(str));
-	    break;
+	    END_CASE;
 
-	  case JSOP_VOID:
+	  BEGIN_CASE(JSOP_VOID)
 	    (void) POP();
 	    PUSH_OPND(JSVAL_VOID);
-	    break;
+	    END_CASE;
 
-	  case JSOP_INCNAME:
-	  case JSOP_DECNAME:
-	  case JSOP_NAMEINC:
-	  case JSOP_NAMEDEC:
+	  BEGIN_CASE(JSOP_INCNAME)
+	  BEGIN_CASE(JSOP_DECNAME)
+	  BEGIN_CASE(JSOP_NAMEINC)
+	  BEGIN_CASE(JSOP_NAMEDEC)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 
 	    SAVE_SP(fp);
-	    JS_LOCK_RUNTIME_VOID(rt, ok = js_FindVariable(cx, id, &obj, &prop));
+	    JS_LOCK_VOID(cx, ok = js_FindVariable(cx, id, &obj, &prop));
 	    if (!ok)
 		goto out;
 
@@ -1770,19 +2104,19 @@ Interpret(JSContext *cx, jsval *result)
 	    lval = OBJECT_TO_JSVAL(obj);
 	    goto do_incop;
 
-	  case JSOP_INCPROP:
-	  case JSOP_DECPROP:
-	  case JSOP_PROPINC:
-	  case JSOP_PROPDEC:
+	  BEGIN_CASE(JSOP_INCPROP)
+	  BEGIN_CASE(JSOP_DECPROP)
+	  BEGIN_CASE(JSOP_PROPINC)
+	  BEGIN_CASE(JSOP_PROPDEC)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 	    lval = POP();
 	    goto do_incop;
 
-	  case JSOP_INCELEM:
-	  case JSOP_DECELEM:
-	  case JSOP_ELEMINC:
-	  case JSOP_ELEMDEC:
+	  BEGIN_CASE(JSOP_INCELEM)
+	  BEGIN_CASE(JSOP_DECELEM)
+	  BEGIN_CASE(JSOP_ELEMINC)
+	  BEGIN_CASE(JSOP_ELEMDEC)
 	    id   = POP();
 	    lval = POP();
 
@@ -1793,10 +2127,13 @@ Interpret(JSContext *cx, jsval *result)
 	    VALUE_TO_OBJECT(cx, lval, obj);
 
 	    /* The operand must contain a number. */
-	    CACHED_GET(js_GetProperty(cx, obj, id, &rval));
-	    if (!prop) {
-		ok = JS_FALSE;
-		goto out;
+	    DENSE_ELEMENT_OP(js_LoadDenseElement, js_GetDenseElement);
+	    if (!dense) {
+		CACHED_GET(js_GetProperty(cx, obj, id, &rval));
+		if (!prop) {
+		    ok = JS_FALSE;
+		    goto out;
+		}
 	    }
 	    VALUE_TO_NUMBER(cx, rval, d);
 
@@ -1810,26 +2147,39 @@ Interpret(JSContext *cx, jsval *result)
 	    ok = js_NewNumberValue(cx, d, &rval);
 	    if (!ok)
 		goto out;
-	    CACHED_SET(js_SetProperty(cx, obj, id, &rval));
-	    if (!prop) {
-		ok = JS_FALSE;
-		goto out;
+	    DENSE_ELEMENT_OP(js_StoreDenseElement, js_SetDenseElement);
+	    if (!dense) {
+		CACHED_SET(js_SetProperty(cx, obj, id, &rval));
+		if (!prop) {
+		    ok = JS_FALSE;
+		    goto out;
+		}
 	    }
 	    if (dropAtom) {
-		JS_LOCK_RUNTIME_VOID(rt, js_DropAtom(cx, atom));
+		JS_LOCK_VOID(cx, js_DropAtom(cx, atom));
 		dropAtom = JS_FALSE;
 	    }
 	    PUSH_NUMBER(cx, d2);
-	    break;
+	    END_CASE;
 
-	  case JSOP_INCARG:
-	  case JSOP_DECARG:
-	  case JSOP_ARGINC:
-	  case JSOP_ARGDEC:
+	  BEGIN_CASE(JSOP_INCARG)
+	  BEGIN_CASE(JSOP_DECARG)
+	  BEGIN_CASE(JSOP_ARGINC)
+	  BEGIN_CASE(JSOP_ARGDEC)
 	  do_argincop:
 	    slot = (uintN)GET_ARGNO(pc);
 	    PR_ASSERT(slot < fp->fun->nargs);
 	    rval = fp->argv[slot];
+	    if (JSVAL_IS_INT(rval)) {
+		i = JSVAL_TO_INT(rval);
+		k = (cs->format & JOF_INC) ? i + 1 : i - 1;
+		if (INT_FITS_IN_JSVAL(k)) {
+		    fp->argv[slot] = INT_TO_JSVAL(k);
+		    if (!(cs->format & JOF_POST))
+			i = k;
+		    INT_RESULT(i);
+		}
+	    }
 	    VALUE_TO_NUMBER(cx, rval, d);
 
 	    /* Compute the post- or pre-incremented value. */
@@ -1843,16 +2193,26 @@ Interpret(JSContext *cx, jsval *result)
 		goto out;
 	    fp->argv[slot] = rval;
 	    PUSH_NUMBER(cx, d2);
-	    break;
+	    END_CASE;
 
-	  case JSOP_INCVAR:
-	  case JSOP_DECVAR:
-	  case JSOP_VARINC:
-	  case JSOP_VARDEC:
+	  BEGIN_CASE(JSOP_INCVAR)
+	  BEGIN_CASE(JSOP_DECVAR)
+	  BEGIN_CASE(JSOP_VARINC)
+	  BEGIN_CASE(JSOP_VARDEC)
 	  do_varincop:
 	    slot = (uintN)GET_VARNO(pc);
 	    PR_ASSERT(slot < fp->fun->nvars);
 	    rval = fp->vars[slot];
+	    if (JSVAL_IS_INT(rval)) {
+		i = JSVAL_TO_INT(rval);
+		k = (cs->format & JOF_INC) ? i + 1 : i - 1;
+		if (INT_FITS_IN_JSVAL(k)) {
+		    fp->vars[slot] = INT_TO_JSVAL(k);
+		    if (!(cs->format & JOF_POST))
+			i = k;
+		    INT_RESULT(i);
+		}
+	    }
 	    VALUE_TO_NUMBER(cx, rval, d);
 
 	    /* Compute the post- or pre-incremented value. */
@@ -1866,63 +2226,195 @@ Interpret(JSContext *cx, jsval *result)
 		goto out;
 	    fp->vars[slot] = rval;
 	    PUSH_NUMBER(cx, d2);
-	    break;
+	    END_CASE;
+
+	  BEGIN_CASE(JSOP_GETPROP)
+	    lval = POP();
 
-	  case JSOP_GETPROP:
+	  do_getprop:
 	    /* Get an immediate atom naming the property. */
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
-	    PROPERTY_OP(CACHED_GET(js_GetProperty(cx, obj, id, &rval)),
-			prop);
+	    VALUE_TO_OBJECT(cx, lval, obj);
+
+	    /* Try this site's inline cache, then the property cache. */
+	    PROPERTY_IC_TEST(cx, script, pc, obj, ic, obj2);
+	    if (obj2) {
+		rval = obj2->slots[ic->slot];
+		JS_UNLOCK_OBJ(cx, obj2);
+	    } else {
+		JS_LOCK(cx);
+		CACHED_GET(js_GetProperty(cx, obj, id, &rval));
+		if (prop)
+		    js_FillPropertyIC(cx, script, pc, obj, atom, prop, JS_FALSE);
+		JS_UNLOCK(cx);
+		if (!prop) {
+		    ok = JS_FALSE;
+		    goto out;
+		}
+	    }
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_SETPROP:
+	  BEGIN_CASE(JSOP_SETPROP)
 	    /* Pop the right-hand side into rval for js_SetProperty. */
 	    rval = POP();
 
 	    /* Get an immediate atom naming the property. */
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
-	    PROPERTY_OP(CACHED_SET(js_SetProperty(cx, obj, id, &rval)),
-			prop);
+	    lval = POP();
+	    VALUE_TO_OBJECT(cx, lval, obj);
+
+	    /*
+	     * Stores hit only for properties of obj itself, see jsinterp.h.
+	     * Run the write barrier before taking obj's scope lock, and miss
+	     * if a GC while waiting for it means the store needs another.
+	     */
+	    GC_WRITE_BARRIER(cx, obj, rval);
+	    PROPERTY_IC_TEST(cx, script, pc, obj, ic, obj2);
+	    if (obj2 && GC_NEEDS_BARRIER(cx, obj, rval)) {
+		JS_UNLOCK_OBJ(cx, obj2);
+		obj2 = NULL;
+	    }
+	    if (obj2) {
+		PR_ASSERT(obj2 == obj);
+		obj->slots[ic->slot] = rval;
+		JS_UNLOCK_OBJ(cx, obj);
+	    } else {
+		JS_LOCK(cx);
+		CACHED_SET(js_SetProperty(cx, obj, id, &rval));
+		if (prop)
+		    js_FillPropertyIC(cx, script, pc, obj, atom, prop, JS_TRUE);
+		JS_UNLOCK(cx);
+		if (!prop) {
+		    ok = JS_FALSE;
+		    goto out;
+		}
+	    }
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_GETELEM:
-	    ELEMENT_OP(CACHED_GET(js_GetProperty(cx, obj, id, &rval)),
-		       prop);
+	  BEGIN_CASE(JSOP_GETELEM)
+	    lval = sp[-2];
+	    id = sp[-1];
+	    DENSE_ELEMENT_OP(js_LoadDenseElement, js_GetDenseElement);
+	    if (dense) {
+		sp -= 2;
+	    } else {
+		ELEMENT_OP(CACHED_GET(js_GetProperty(cx, obj, id, &rval)),
+			   prop);
+	    }
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_SETELEM:
+	  BEGIN_CASE(JSOP_SETELEM)
 	    rval = POP();
-	    ELEMENT_OP(CACHED_SET(js_SetProperty(cx, obj, id, &rval)),
-		       prop);
+	    lval = sp[-2];
+	    id = sp[-1];
+	    DENSE_ELEMENT_OP(js_StoreDenseElement, js_SetDenseElement);
+	    if (dense) {
+		sp -= 2;
+	    } else {
+		ELEMENT_OP(CACHED_SET(js_SetProperty(cx, obj, id, &rval)),
+			   prop);
+	    }
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_PUSHOBJ:
+	  BEGIN_CASE(JSOP_PUSHOBJ)
 	    PUSH_OPND(OBJECT_TO_JSVAL(obj));
-	    break;
+	    END_CASE;
 
-	  case JSOP_CALL:
+	  BEGIN_CASE(JSOP_CALL)
 	    argc = GET_ARGC(pc);
+	    vp = sp - (2 + argc);
+	    lval = *vp;
+
+	    /*
+	     * Call an interpreted function without recursing: push its frame
+	     * over its arguments, see jsinterp.h, and go on with its first op.
+	     * Leave calls needing more set-up, or a call hook, to js_DoCall.
+	     */
+	    fun = NULL;
+	    if (JSVAL_IS_FUNCTION(lval) && !rt->callHook &&
+		cx->interpLevel < MAX_INTERP_LEVEL) {
+		obj2 = JSVAL_TO_OBJECT(lval);
+		fun = (JSFunction *)
+		      JSVAL_TO_PRIVATE(OBJ_GET_SLOT(obj2, JSSLOT_PRIVATE));
+		if (fun->call || !fun->script ||
+		    (fun->flags & (JSFUN_BOUND_METHOD|JSFUN_GLOBAL_PARENT)) ||
+		    !OBJ_GET_PARENT(fun->object)) {
+		    fun = NULL;
+		}
+	    }
+	    if (fun) {
+		obj2 = fun->object;
+		slot = (argc < fun->nargs) ? fun->nargs - argc : 0;
+		newfp = (JSStackFrame *)(sp + slot + fun->nvars);
+		depth = (ptrdiff_t)fun->script->depth;
+		newsp = (jsval *)newfp + JS_FRAME_SLOTS + depth;
+		oldtop = cx->stackTop;
+		if (newsp + depth > oldtop) {
+		    if (newsp + depth > cx->stackLimit) {
+			JS_ReportError(cx, "stack overflow in %s",
+				       JS_GetFunctionName(fun));
+			ok = JS_FALSE;
+			goto out;
+		    }
+		    cx->stackTop = newsp + depth;
+		}
+
+		/* Push missing arguments and local variables. */
+		SAVE_SP(fp);
+		while (sp < (jsval *)newfp)
+		    PUSH(JSVAL_VOID);
+		*vp = OBJECT_TO_JSVAL(obj2);
+
+		newfp->object = NULL;
+		newfp->script = fun->script;
+		newfp->fun = fun;
+		newfp->thisp = JSVAL_TO_OBJECT(vp[1]);
+		newfp->argc = argc;
+		newfp->argv = vp + 2;
+		newfp->rval = JSVAL_VOID;
+		newfp->nvars = fun->nvars;
+		newfp->vars = sp - fun->nvars;
+		newfp->down = fp;
+		newfp->annotation = NULL;
+		newfp->scopeChain = obj2;
+		newfp->sp = sp = newsp;
+#if JS_HAS_SHARP_VARS
+		newfp->sharpDepth = 0;
+		newfp->sharpArray = NULL;
+#endif
+		newfp->stackMark = oldtop;
+		JS_LOCK_VOID(cx, cx->fp = newfp);
+		cx->interpLevel++;
+
+		fp = newfp;
+		script = fp->script;
+		pc = script->code;
+		endpc = pc + script->length;
+		LOAD_JIT_CODE();
+		continue;
+	    }
+
 	    SAVE_SP(fp);
 	    ok = js_DoCall(cx, argc);
 	    RESTORE_SP(fp);
 	    if (!ok)
 		goto out;
-	    break;
+	    END_CASE;
 
-	  case JSOP_NAME:
+	  BEGIN_CASE(JSOP_NAME)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 
-	    JS_LOCK_RUNTIME(rt);
+	    JS_LOCK(cx);
 	    ok = js_FindProperty(cx, id, &obj, &prop);
 	    if (!ok) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		goto out;
 	    }
 	    if (!prop) {
@@ -1930,14 +2422,14 @@ Interpret(JSContext *cx, jsval *result)
 		for (pc2 = pc + len; pc2 < endpc; pc2++) {
 		    op2 = (JSOp)*pc2;
 		    if (op2 == JSOP_TYPEOF) {
-			JS_UNLOCK_RUNTIME(rt);
+			JS_UNLOCK(cx);
 			PUSH_OPND(JSVAL_VOID);
 			goto advance_pc;
 		    }
 		    if (op2 != JSOP_NOP)
 			break;
 		}
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		js_ReportIsNotDefined(cx, ATOM_BYTES(atom));
 		ok = JS_FALSE;
 		goto out;
@@ -1949,9 +2441,10 @@ Interpret(JSContext *cx, jsval *result)
 	    rval = obj2->slots[slot];
 	    ok = prop->getter(cx, obj, prop->id, &rval);
 	    if (!ok) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		goto out;
 	    }
+	    GC_WRITE_BARRIER(cx, obj2, rval);
 	    obj2->slots[slot] = rval;
 	    PUSH_OPND(rval);
 
@@ -1967,57 +2460,71 @@ Interpret(JSContext *cx, jsval *result)
 		    SET_VARNO(pc, slot);
 		}
 	    }
-	    JS_UNLOCK_RUNTIME(rt);
-	    break;
+	    JS_UNLOCK(cx);
+	    END_CASE;
 
-	  case JSOP_UINT16:
+	  BEGIN_CASE(JSOP_UINT16)
 	    i = (jsint) GET_ATOM_INDEX(pc);
 	    rval = INT_TO_JSVAL(i);
+	    if (FUSIBLE_NEXT_OP() == JSOP_ADD) {
+		FUSE_NEXT_OP();
+		goto do_add;
+	    }
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_NUMBER:
-	  case JSOP_STRING:
+	  BEGIN_CASE(JSOP_NUMBER)
+	  BEGIN_CASE(JSOP_STRING)
 	    atom = GET_ATOM(cx, script, pc);
 	    PUSH_OPND(ATOM_KEY(atom));
-	    break;
+	    END_CASE;
 
-	  case JSOP_OBJECT:
+	  BEGIN_CASE(JSOP_OBJECT)
 	    atom = GET_ATOM(cx, script, pc);
 	    rval = ATOM_KEY(atom);
 	    PR_ASSERT(JSVAL_IS_OBJECT(rval));
 	    obj = NULL;
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 
-	  case JSOP_ZERO:
+	  BEGIN_CASE(JSOP_ZERO)
 	    PUSH_OPND(JSVAL_ZERO);
-	    break;
+	    END_CASE;
 
-	  case JSOP_ONE:
-	    PUSH_OPND(JSVAL_ONE);
-	    break;
+	  BEGIN_CASE(JSOP_ONE)
+	    rval = JSVAL_ONE;
+	    if (FUSIBLE_NEXT_OP() == JSOP_ADD) {
+		FUSE_NEXT_OP();
+		goto do_add;
+	    }
+	    PUSH_OPND(rval);
+	    END_CASE;
 
-	  case JSOP_NULL:
+	  BEGIN_CASE(JSOP_NULL)
 	    obj = NULL;
 	    PUSH_OPND(JSVAL_NULL);
-	    break;
+	    END_CASE;
 
-	  case JSOP_THIS:
+	  BEGIN_CASE(JSOP_THIS)
 	    obj = fp->thisp;
-	    PUSH_OPND(OBJECT_TO_JSVAL(obj));
-	    break;
+	    lval = OBJECT_TO_JSVAL(obj);
+	    if (FUSIBLE_NEXT_OP() == JSOP_GETPROP) {
+		FUSE_NEXT_OP();
+		goto do_getprop;
+	    }
+	    PUSH_OPND(lval);
+	    END_CASE;
 
-	  case JSOP_FALSE:
+	  BEGIN_CASE(JSOP_FALSE)
 	    PUSH_OPND(JSVAL_FALSE);
-	    break;
+	    END_CASE;
 
-	  case JSOP_TRUE:
+	  BEGIN_CASE(JSOP_TRUE)
 	    PUSH_OPND(JSVAL_TRUE);
-	    break;
+	    END_CASE;
 
 #if JS_HAS_SWITCH_STATEMENT
-	  case JSOP_TABLESWITCH:
+	  BEGIN_CASE(JSOP_TABLESWITCH)
 	    valid = JS_TRUE;
 	    SAVE_SP(fp);
 	    ok = PopInt(cx, &i, &valid);
@@ -2042,9 +2549,9 @@ Interpret(JSContext *cx, jsval *result)
 		if (off)
 		    len = off;
 	    }
-	    break;
+	    END_CASE;
 
-	  case JSOP_LOOKUPSWITCH:
+	  BEGIN_CASE(JSOP_LOOKUPSWITCH)
 	    lval = POP();
 	    pc2 = pc;
 	    len = GET_JUMP_OFFSET(pc2);
@@ -2074,6 +2581,10 @@ Interpret(JSContext *cx, jsval *result)
     }
 	    if (JSVAL_IS_STRING(lval)) {
 		str  = JSVAL_TO_STRING(lval);
+		if (!JSSTRING_FLATTEN(cx, str)) {
+		    ok = JS_FALSE;
+		    goto out;
+		}
 		SEARCH_PAIRS(
 		    match = (JSVAL_IS_STRING(rval) &&
 			     ((str2 = JSVAL_TO_STRING(rval)) == str ||
@@ -2091,16 +2602,16 @@ Interpret(JSContext *cx, jsval *result)
 		)
 	    }
 #undef SEARCH_PAIRS
-	    break;
+	    END_CASE;
 #endif /* JS_HAS_SWITCH_STATEMENT */
 
 #if JS_HAS_LEXICAL_CLOSURE
-	  case JSOP_CLOSURE:
+	  BEGIN_CASE(JSOP_CLOSURE)
 	    /*
 	     * If the nearest variable scope is a function, not a call object,
 	     * replace it in the scope chain with its call object.
 	     */
-	    JS_LOCK_RUNTIME_VOID(rt, obj = js_FindVariableScope(cx, &fun));
+	    JS_LOCK_VOID(cx, obj = js_FindVariableScope(cx, &fun));
 	    if (!obj) {
 		ok = JS_FALSE;
 		goto out;
@@ -2151,7 +2662,7 @@ Interpret(JSContext *cx, jsval *result)
 	     * but only if fun2 is not anonymous.
 	     */
 	    if (fun2->atom) {
-		JS_LOCK_RUNTIME_VOID(rt,
+		JS_LOCK_VOID(cx,
 		    prop = js_DefineProperty(cx, obj, (jsval)fun2->atom,
 					     OBJECT_TO_JSVAL(closure),
 					     NULL, NULL, JSPROP_ENUMERATE));
@@ -2162,12 +2673,12 @@ Interpret(JSContext *cx, jsval *result)
 		}
 	    }
 	    PUSH(OBJECT_TO_JSVAL(closure));
-	    break;
+	    END_CASE;
 #endif /* JS_HAS_LEXICAL_CLOSURE */
 
 #if JS_HAS_EXPORT_IMPORT
-	  case JSOP_EXPORTALL:
-	    JS_LOCK_RUNTIME(rt);
+	  BEGIN_CASE(JSOP_EXPORTALL)
+	    JS_LOCK(cx);
 	    obj = js_FindVariableScope(cx, &fun);
 	    if (!obj) {
 		ok = JS_FALSE;
@@ -2180,49 +2691,51 @@ Interpret(JSContext *cx, jsval *result)
 			    if (!ok)
 				break;
 			    prop->flags |= JSPROP_EXPORTED;
+			    PROPERTY_CHANGED(cx, prop);
 			}
 		    }
 		}
 	    }
-	    JS_UNLOCK_RUNTIME(rt);
-	    break;
+	    JS_UNLOCK(cx);
+	    END_CASE;
 
-	  case JSOP_EXPORTNAME:
+	  BEGIN_CASE(JSOP_EXPORTNAME)
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
-	    JS_LOCK_RUNTIME(rt);
+	    JS_LOCK(cx);
 	    obj  = js_FindVariableScope(cx, &fun);
 	    prop = obj ? js_GetProperty(cx, obj, id, &rval) : NULL;
 	    if (!prop) {
-		JS_UNLOCK_RUNTIME(rt);
+		JS_UNLOCK(cx);
 		ok = JS_FALSE;
 		goto out;
 	    }
 	    prop->flags |= JSPROP_EXPORTED;
-	    JS_UNLOCK_RUNTIME(rt);
-	    break;
+	    PROPERTY_CHANGED(cx, prop);
+	    JS_UNLOCK(cx);
+	    END_CASE;
 
-	  case JSOP_IMPORTALL:
+	  BEGIN_CASE(JSOP_IMPORTALL)
 	    id = JSVAL_VOID;
 	    PROPERTY_OP(ok = ImportProperty(cx, obj, id),
 			ok);
-	    break;
+	    END_CASE;
 
-	  case JSOP_IMPORTPROP:
+	  BEGIN_CASE(JSOP_IMPORTPROP)
 	    /* Get an immediate atom naming the property. */
 	    atom = GET_ATOM(cx, script, pc);
 	    id   = (jsval)atom;
 	    PROPERTY_OP(ok = ImportProperty(cx, obj, id),
 			ok);
-	    break;
+	    END_CASE;
 
-	  case JSOP_IMPORTELEM:
+	  BEGIN_CASE(JSOP_IMPORTELEM)
 	    ELEMENT_OP(ok = ImportProperty(cx, obj, id),
 		       ok);
-	    break;
+	    END_CASE;
 #endif /* JS_HAS_EXPORT_IMPORT */
 
-	  case JSOP_TRAP:
+	  BEGIN_CASE(JSOP_TRAP)
 	    switch (JS_HandleTrap(cx, script, pc, &rval)) {
 	      case JSTRAP_ERROR:
 		ok = JS_FALSE;
@@ -2237,56 +2750,66 @@ Interpret(JSContext *cx, jsval *result)
 		goto out;
 	      default:;
 	    }
-	    break;
+	    END_CASE;
 
-	  case JSOP_GETARG:
+	  BEGIN_CASE(JSOP_GETARG)
 	    obj = fp->scopeChain;
 	    slot = (uintN)GET_ARGNO(pc);
 	    PR_ASSERT(slot < fp->fun->nargs);
-	    PUSH_OPND(fp->argv[slot]);
-	    break;
+	    lval = fp->argv[slot];
+	    if (FUSIBLE_NEXT_OP() == JSOP_GETPROP) {
+		FUSE_NEXT_OP();
+		goto do_getprop;
+	    }
+	    PUSH_OPND(lval);
+	    END_CASE;
 
-	  case JSOP_SETARG:
+	  BEGIN_CASE(JSOP_SETARG)
 	    obj = fp->scopeChain;
 	    slot = (uintN)GET_ARGNO(pc);
 	    PR_ASSERT(slot < fp->fun->nargs);
 	    vp = &fp->argv[slot];
 	    GC_POKE(cx, *vp);
 	    *vp = sp[-1];
-	    break;
+	    END_CASE;
 
-	  case JSOP_GETVAR:
+	  BEGIN_CASE(JSOP_GETVAR)
 	    obj = fp->scopeChain;
 	    slot = (uintN)GET_VARNO(pc);
 	    PR_ASSERT(slot < fp->fun->nvars);
-	    PUSH_OPND(fp->vars[slot]);
-	    break;
+	    lval = fp->vars[slot];
+	    if (FUSIBLE_NEXT_OP() == JSOP_GETPROP) {
+		FUSE_NEXT_OP();
+		goto do_getprop;
+	    }
+	    PUSH_OPND(lval);
+	    END_CASE;
 
-	  case JSOP_SETVAR:
+	  BEGIN_CASE(JSOP_SETVAR)
 	    obj = fp->scopeChain;
 	    slot = (uintN)GET_VARNO(pc);
 	    PR_ASSERT(slot < fp->fun->nvars);
 	    vp = &fp->vars[slot];
 	    GC_POKE(cx, *vp);
 	    *vp = sp[-1];
-	    break;
+	    END_CASE;
 
 #ifdef JS_HAS_OBJECT_LITERAL
-	  case JSOP_NEWINIT:
+	  BEGIN_CASE(JSOP_NEWINIT)
 	    argc = 0;
 #if JS_HAS_SHARP_VARS
 	    fp->sharpDepth++;
 #endif
 	    goto do_new;
 
-	  case JSOP_ENDINIT:
+	  BEGIN_CASE(JSOP_ENDINIT)
 #if JS_HAS_SHARP_VARS
 	    if (--fp->sharpDepth == 0)
 		fp->sharpArray = NULL;
 #endif
-	    break;
+	    END_CASE;
 
-	  case JSOP_INITPROP:
+	  BEGIN_CASE(JSOP_INITPROP)
 	    /* Pop the property's value into rval. */
 	    PR_ASSERT(sp - newsp >= 2);
 	    rval = POP();
@@ -2296,7 +2819,7 @@ Interpret(JSContext *cx, jsval *result)
 	    id   = (jsval)atom;
 	    goto do_init;
 
-	  case JSOP_INITELEM:
+	  BEGIN_CASE(JSOP_INITELEM)
 	    /* Pop the element's value into rval. */
 	    PR_ASSERT(sp - newsp >= 3);
 	    rval = POP();
@@ -2312,19 +2835,24 @@ Interpret(JSContext *cx, jsval *result)
 	    obj = JSVAL_TO_OBJECT(lval);
 
 	    /* Set the property named by obj[id] to rval. */
-	    JS_LOCK_RUNTIME_VOID(rt, prop = js_SetProperty(cx, obj, id, &rval));
-	    if (!prop) {
-		ok = JS_FALSE;
-		goto out;
+	    DENSE_ELEMENT_OP(js_StoreDenseElement, js_SetDenseElement);
+	    if (!dense) {
+		JS_LOCK(cx);
+		prop = js_SetProperty(cx, obj, id, &rval);
+		JS_UNLOCK(cx);
+		if (!prop) {
+		    ok = JS_FALSE;
+		    goto out;
+		}
 	    }
 	    if (dropAtom) {
-		JS_LOCK_RUNTIME_VOID(rt, js_DropAtom(cx, atom));
+		JS_LOCK_VOID(cx, js_DropAtom(cx, atom));
 		dropAtom = JS_FALSE;
 	    }
-	    break;
+	    END_CASE;
 
 #if JS_HAS_SHARP_VARS
-	  case JSOP_DEFSHARP:
+	  BEGIN_CASE(JSOP_DEFSHARP)
 	    obj = fp->sharpArray;
 	    if (!obj) {
 		obj = js_NewArrayObject(cx, 0, NULL);
@@ -2338,22 +2866,22 @@ Interpret(JSContext *cx, jsval *result)
 	    id = INT_TO_JSVAL(i);
 	    rval = sp[-1];
 	    PR_ASSERT(JSVAL_IS_OBJECT(rval));
-	    JS_LOCK_RUNTIME_VOID(rt, prop = js_SetProperty(cx, obj, id, &rval));
+	    JS_LOCK_VOID(cx, prop = js_SetProperty(cx, obj, id, &rval));
 	    if (!prop) {
 		ok = JS_FALSE;
 		goto out;
 	    }
-	    break;
+	    END_CASE;
 
-	  case JSOP_USESHARP:
+	  BEGIN_CASE(JSOP_USESHARP)
 	    i = (jsint) GET_ATOM_INDEX(pc);
 	    id = INT_TO_JSVAL(i);
 	    obj = fp->sharpArray;
 	    if (!obj) {
 		rval = JSVAL_VOID;
 	    } else {
-		JS_LOCK_RUNTIME_VOID(rt,
-				     prop = js_GetProperty(cx, obj, id, &rval));
+		JS_LOCK_VOID(cx,
+			     prop = js_GetProperty(cx, obj, id, &rval));
 		if (!prop) {
 		    ok = JS_FALSE;
 		    goto out;
@@ -2365,11 +2893,46 @@ Interpret(JSContext *cx, jsval *result)
 		goto out;
 	    }
 	    PUSH_OPND(rval);
-	    break;
+	    END_CASE;
 #endif /* JS_HAS_SHARP_VARS */
 #endif /* JS_HAS_OBJECT_LITERAL */
 
 	  default:
+#if JS_THREADED_INTERP
+	  /* Labels for the jump table entries of ops not compiled in above. */
+#if JS_BUG_SHORT_CIRCUIT
+	  L_JSOP_OR:
+	  L_JSOP_AND:
+#endif
+#if JS_BUG_FALLIBLE_EQOPS
+	  L_JSOP_NEW_EQ:
+	  L_JSOP_NEW_NE:
+#endif
+#if !JS_HAS_SWITCH_STATEMENT
+	  L_JSOP_TABLESWITCH:
+	  L_JSOP_LOOKUPSWITCH:
+#endif
+#if !JS_HAS_LEXICAL_CLOSURE
+	  L_JSOP_CLOSURE:
+#endif
+#if !JS_HAS_EXPORT_IMPORT
+	  L_JSOP_EXPORTALL:
+	  L_JSOP_EXPORTNAME:
+	  L_JSOP_IMPORTALL:
+	  L_JSOP_IMPORTPROP:
+	  L_JSOP_IMPORTELEM:
+#endif
+#ifndef JS_HAS_OBJECT_LITERAL
+	  L_JSOP_NEWINIT:
+	  L_JSOP_ENDINIT:
+	  L_JSOP_INITPROP:
+	  L_JSOP_INITELEM:
+#endif
+#if !defined JS_HAS_OBJECT_LITERAL || !JS_HAS_SHARP_VARS
+	  L_JSOP_DEFSHARP:
+	  L_JSOP_USESHARP:
+#endif
+#endif /* JS_THREADED_INTERP */
 	    JS_ReportError(cx, "unimplemented JavaScript bytecode %d", op);
 	    ok = JS_FALSE;
 	    goto out;
@@ -2409,16 +2972,52 @@ Interpret(JSContext *cx, jsval *result)
     CHECK_BRANCH(-1);
 
 out:
+    if (dropAtom) {
+	JS_LOCK_VOID(cx, js_DropAtom(cx, atom));
+	dropAtom = JS_FALSE;
+    }
+
     /*
-     * Restore the previous frame's execution state.
+     * Pop a frame that JSOP_CALL pushed, as js_DoCall pops its own, and go
+     * on after the call in its caller, or unwind the caller too on error.
      */
-    PR_ARENA_RELEASE(&cx->stackPool, mark);
+    if (fp->stackMark) {
+	if (fp->annotation &&
+	    js_InterpreterHooks &&
+	    js_InterpreterHooks->destroyFrame) {
+	    js_InterpreterHooks->destroyFrame(cx, fp);
+	}
+#if JS_HAS_CALL_OBJECT
+	if (fp->object)
+	    ok &= js_PutCallObject(cx, fp);
+#endif
+	vp = fp->argv - 2;
+	*vp = fp->rval;
+	cx->stackTop = fp->stackMark;
+	fp = fp->down;
+	JS_LOCK_VOID(cx, cx->fp = fp);
+	cx->interpLevel--;
+	sp = vp + 1;
+	SAVE_SP(fp);
+	if (!ok)
+	    goto out;
 
-    if (dropAtom) {
-	JS_LOCK_RUNTIME_VOID(rt, js_DropAtom(cx, atom));
-	dropAtom = JS_FALSE;
+	script = fp->script;
+	depth = (ptrdiff_t)script->depth;
+	newsp = (fp->stackMark ? (jsval *)fp + JS_FRAME_SLOTS : mark) + depth;
+	pc = fp->pc + js_CodeSpec[JSOP_CALL].length;
+	endpc = script->code + script->length;
+#if JS_HAS_JIT
+	jit = cx->jitEnabled ? script->jit : NULL;
+#endif
+	goto resume;
     }
 
+    /*
+     * Restore the previous frame's execution state.
+     */
+    cx->stackTop = mark;
+
 #ifdef JS_THREADSAFE
     ok &= JS_RemoveRoot(cx, &obj);
 #endif
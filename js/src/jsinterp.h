@@ -25,7 +25,8 @@
 #include "jspubtd.h"
 
 /*
- * JS stack frame, allocated on the C stack.
+ * JS stack frame, allocated on the C stack, or on the VM stack for a frame
+ * that JSOP_CALL pushes inline, which has a non-null stackMark.
  */
 struct JSStackFrame {
     JSObject        *object;        /* object for fun.arguments/fun.caller */
@@ -44,8 +45,29 @@ struct JSStackFrame {
     jsval           *sp;            /* stack pointer */
     uintN           sharpDepth;     /* array/object initializer depth */
     JSObject        *sharpArray;    /* scope for #n= initializer vars */
+    jsval           *stackMark;     /* if inline, cx->stackTop to restore */
 };
 
+/*
+ * Each context has a contiguous VM stack of at least JS_MIN_STACK_SLOTS
+ * jsvals, allocated by js_NewContext, from cx->stackBase up to
+ * cx->stackLimit, whose slots below cx->stackTop are in use.  A call's
+ * arguments are pushed onto the caller's operand stack, and the callee's
+ * frame starts there: missing arguments and local variables are pushed
+ * after the actual ones, so argv and vars are never copied.  A function
+ * that JSOP_CALL calls gets the rest of its frame, the JSStackFrame and its
+ * pc and operand stacks, above its variables, and runs in the caller's
+ * activation of Interpret:
+ *
+ *   fun this args... missing... vars... JSStackFrame pcs[depth] opnds[depth]
+ *   ^vp      ^argv              ^vars                           ^sp
+ */
+#define JS_MIN_STACK_SLOTS      65536
+
+/* Frame size in jsvals, for a JSStackFrame laid out on the VM stack. */
+#define JS_FRAME_SLOTS                                                        \
+    ((sizeof(JSStackFrame) + sizeof(jsval) - 1) / sizeof(jsval))
+
 /*
  * Property cache for quickened get/set property opcodes.
  */
@@ -70,6 +92,7 @@ typedef struct JSPropertyCache {
     uint32               misses;
     uint32               flushes;
     uint32               pflushes;
+    JSBool               noInlineCaches;/* don't fill JSPropertyICs */
 } JSPropertyCache;
 
 #define PROP_NOT_FOUND   ((JSProperty *)1)
@@ -108,12 +131,94 @@ typedef struct JSPropertyCache {
 	}                                                                     \
     PR_END_MACRO
 
+/*
+ * Per-site inline caches for JSOP_GETPROP and JSOP_SETPROP, allocated when
+ * a script first misses.  An entry remembers the receiver's scope shape and
+ * the slot it found, so a later hit loads or stores the slot without any
+ * lookup.  Only properties with stub getters (and for stores, stub setters
+ * and no readonly or assign() hack) are cached.  A get that found the id on
+ * the receiver's prototype also remembers the prototype and its shape.  The
+ * receiver must own its scope, so its shape covers all its properties.
+ */
+#define PROPERTY_IC_MIN_LOG2    4
+#define PROPERTY_IC_MAX_LOG2    8
+
+struct JSPropertyIC {
+    uint32      pcoff;          /* offset of the caching op in script->code */
+    uint32      slot;           /* slot in receiver or prototype */
+    uint64      shape;          /* receiver scope shape, 0 if unused */
+    uint64      protoShape;     /* prototype's shape if proto is non-null */
+    JSObject    *proto;         /* weak link to prototype holding slot */
+};
+
+/*
+ * Set pobj to the object whose slot ic->slot holds the value of the property
+ * named by the op at pc in script, for obj, or to null on a miss.  The caller
+ * need not hold the runtime lock.  On a hit it holds pobj's scope lock, and
+ * must release it with JS_UNLOCK_OBJ(cx, pobj) once done with the slot.  In
+ * a JS_THREADSAFE build, only the context that compiled script uses its
+ * caches, so their entries are never read while being filled.
+ */
+#ifdef JS_THREADSAFE
+#define SCRIPT_PROPERTY_ICS(cx, script)                                       \
+    ((script)->ownercx == (cx) ? (script)->propertyICs : NULL)
+#else
+#define SCRIPT_PROPERTY_ICS(cx, script) ((script)->propertyICs)
+#endif
+
+#define PROPERTY_IC_TEST(cx, script, pc, obj, ic, pobj)                       \
+    PR_BEGIN_MACRO                                                            \
+	JSPropertyIC *_ics = SCRIPT_PROPERTY_ICS(cx, script);                 \
+	JSScope *_scope;                                                      \
+	JSObject *_proto;                                                     \
+	uint32 _pcoff = (uint32)((pc) - (script)->code);                      \
+	(cx)->icTests++;                                                      \
+	pobj = NULL;                                                          \
+	if (_ics) {                                                           \
+	    ic = &_ics[_pcoff & (script)->propertyICMask];                    \
+	    _scope = (JSScope *)(obj)->map;                                   \
+	    JS_LOCK_SCOPE(cx, _scope);                                        \
+	    if (LL_EQ(ic->shape, _scope->shape) && ic->pcoff == _pcoff &&     \
+		_scope->object == (obj)) {                                    \
+		_proto = ic->proto;                                           \
+		if (!_proto) {                                                \
+		    pobj = (obj);                                             \
+		} else if (OBJ_GET_PROTO(obj) == _proto) {                    \
+		    JS_UNLOCK_SCOPE(cx, _scope);                              \
+		    _scope = (JSScope *)_proto->map;                          \
+		    JS_LOCK_SCOPE(cx, _scope);                                \
+		    if (LL_EQ(_scope->shape, ic->protoShape) &&               \
+			_scope->object == _proto) {                           \
+			pobj = _proto;                                        \
+		    }                                                         \
+		}                                                             \
+	    }                                                                 \
+	    if (!pobj)                                                        \
+		JS_UNLOCK_SCOPE(cx, _scope);                                  \
+	}                                                                     \
+	if (!pobj)                                                            \
+	    (cx)->icMisses++;                                                 \
+    PR_END_MACRO
+
+extern void
+js_FillPropertyIC(JSContext *cx, JSScript *script, jsbytecode *pc,
+		  JSObject *obj, JSAtom *atom, JSProperty *prop,
+		  JSBool setting);
+
 extern void
 js_FlushPropertyCache(JSContext *cx);
 
 extern void
 js_FlushPropertyCacheByProp(JSContext *cx, JSProperty *prop);
 
+/*
+ * Push nslots onto cx's VM stack and return the first, or report a stack
+ * overflow and return null if they won't fit.  Pop them, and anything pushed
+ * since, by storing the returned pointer back in cx->stackTop.
+ */
+extern jsval *
+js_AllocStack(JSContext *cx, uintN nslots);
+
 extern JSBool
 js_GetArgument(JSContext *cx, JSObject *obj, jsval id, jsval *vp);
 
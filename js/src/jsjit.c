@@ -0,0 +1,1011 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+ * JS baseline template JIT for x86-64, see jsjit.h.
+ */
+#include "prtypes.h"
+#include "prlog.h"
+#include "jsapi.h"
+#include "jsjit.h"
+
+#if JS_HAS_JIT
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "jsatom.h"
+#include "jsbool.h"
+#include "jscntxt.h"
+#include "jsinterp.h"
+#include "jslock.h"
+#include "jsopcode.h"
+#include "jsscript.h"
+
+/*
+ * Native code is entered through a prologue at offset 0 of the code, called
+ * as a JSJITEntry with the frame state below and the native address of the
+ * op to start at.  Every exit stores sp and the exit pc back into the state.
+ */
+typedef struct JSJITFrame {
+    jsval           *sp;        /* operand stack pointer */
+    jsbytecode      *pc;        /* pc of the op to interpret on exit */
+    JSContext       *cx;
+    jsval           *argv;      /* fp->argv */
+    jsval           *vars;      /* fp->vars */
+    JSBool          setobj;     /* a native op set obj to fp->scopeChain */
+} JSJITFrame;
+
+typedef void (*JSJITEntry)(JSJITFrame *jf, uint8 *start);
+
+/* x86-64 registers, and the ones that hold interpreter state. */
+#define RAX             0
+#define RCX             1
+#define RDX             2
+#define RBX             3
+#define RSP             4
+#define RBP             5
+#define RSI             6
+#define RDI             7
+#define R12             12
+#define R13             13
+#define R14             14
+#define R15             15
+
+#define SP_REG          RBX
+#define JF_REG          R12
+#define VARS_REG        R13
+#define ARGV_REG        R14
+#define CX_REG          R15
+
+/* Condition codes for Jcc and SETcc. */
+#define CC_E            0x4
+#define CC_NE           0x5
+#define CC_A            0x7
+#define CC_S            0x8
+#define CC_L            0xc
+#define CC_GE           0xd
+#define CC_LE           0xe
+#define CC_G            0xf
+#define CC_INVERT(cc)   ((cc) ^ 1)
+
+/* Opcode and /digit values for the integer ALU instructions. */
+#define ALU_ADD         0x01
+#define ALU_OR          0x09
+#define ALU_AND         0x21
+#define ALU_SUB         0x29
+#define ALU_XOR         0x31
+#define ALU_CMP         0x39
+#define ALU_TEST        0x85
+#define ALU_MOV         0x89
+#define ALUI_ADD        0
+#define ALUI_OR         1
+#define ALUI_AND        4
+#define ALUI_SUB        5
+#define ALUI_CMP        7
+#define SHIFT_SHL       4
+#define SHIFT_SHR       5
+#define SHIFT_SAR       7
+
+#define IS_INT8(i)      ((i) >= -128 && (i) <= 127)
+
+typedef struct JITFixup {
+    uint32          pos;        /* offset of a rel32 in the buffer */
+    uint32          pcoff;      /* bytecode offset it refers to */
+} JITFixup;
+
+typedef struct JITFixupList {
+    JITFixup        *vector;
+    uint32          length;
+    uint32          capacity;
+} JITFixupList;
+
+typedef struct JITCompiler {
+    JSContext       *cx;
+    JSScript        *script;
+    JSJITCode       *jit;
+    uint8           *buf;       /* native code under construction */
+    uint32          length;
+    uint32          capacity;
+    JSBool          ok;         /* false after running out of memory */
+    int32           depth;      /* pc stack displacement in bytes */
+    int32           *offsets;   /* native offset by bytecode offset or -1 */
+    JITFixupList    exits;      /* guard jumps to per-op exit stubs */
+    JITFixupList    jumps;      /* jumps to ops' native code */
+    uint32          exitCode;   /* offset of the common exit sequence */
+} JITCompiler;
+
+static void
+Emit1(JITCompiler *jc, uint8 b)
+{
+    uint8 *buf;
+    uint32 capacity;
+
+    if (jc->length == jc->capacity) {
+	if (!jc->ok)
+	    return;
+	capacity = jc->capacity ? 2 * jc->capacity : 1024;
+	buf = JS_realloc(jc->cx, jc->buf, capacity);
+	if (!buf) {
+	    jc->ok = JS_FALSE;
+	    jc->length = 0;
+	    return;
+	}
+	jc->buf = buf;
+	jc->capacity = capacity;
+    }
+    jc->buf[jc->length++] = b;
+}
+
+static void
+Emit4(JITCompiler *jc, int32 i)
+{
+    Emit1(jc, (uint8)i);
+    Emit1(jc, (uint8)(i >> 8));
+    Emit1(jc, (uint8)(i >> 16));
+    Emit1(jc, (uint8)(i >> 24));
+}
+
+static void
+Emit8(JITCompiler *jc, prword w)
+{
+    Emit4(jc, (int32)w);
+    Emit4(jc, (int32)(w >> 32));
+}
+
+/* REX prefix for a 64-bit (w) or 32-bit operation on reg and rm. */
+static void
+EmitRex(JITCompiler *jc, JSBool w, uintN reg, uintN rm)
+{
+    uint8 rex;
+
+    rex = 0x40 | (w ? 8 : 0) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+    if (rex != 0x40)
+	Emit1(jc, rex);
+}
+
+static void
+EmitModRM(JITCompiler *jc, uintN reg, uintN rm)
+{
+    Emit1(jc, (uint8)(0xc0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+/* ModRM, SIB, and displacement for [base + disp]. */
+static void
+EmitMem(JITCompiler *jc, uintN reg, uintN base, int32 disp)
+{
+    uint8 mod;
+
+    mod = IS_INT8(disp) ? 0x40 : 0x80;
+    Emit1(jc, (uint8)(mod | (reg & 7) << 3 | (base & 7)));
+    if ((base & 7) == RSP)
+	Emit1(jc, 0x24);
+    if (mod == 0x40)
+	Emit1(jc, (uint8)disp);
+    else
+	Emit4(jc, disp);
+}
+
+/* mov reg, [base + disp] */
+static void
+EmitLoad(JITCompiler *jc, uintN reg, uintN base, int32 disp)
+{
+    EmitRex(jc, JS_TRUE, reg, base);
+    Emit1(jc, 0x8b);
+    EmitMem(jc, reg, base, disp);
+}
+
+/* mov [base + disp], reg */
+static void
+EmitStore(JITCompiler *jc, uintN base, int32 disp, uintN reg)
+{
+    EmitRex(jc, JS_TRUE, reg, base);
+    Emit1(jc, 0x89);
+    EmitMem(jc, reg, base, disp);
+}
+
+/* mov dword [base + disp], imm */
+static void
+EmitStoreImm32(JITCompiler *jc, uintN base, int32 disp, int32 imm)
+{
+    EmitRex(jc, JS_FALSE, 0, base);
+    Emit1(jc, 0xc7);
+    EmitMem(jc, 0, base, disp);
+    Emit4(jc, imm);
+}
+
+/* cmp qword or dword [base + disp], imm8 */
+static void
+EmitCmpMemImm8(JITCompiler *jc, JSBool w, uintN base, int32 disp, int8 imm)
+{
+    EmitRex(jc, w, 0, base);
+    Emit1(jc, 0x83);
+    EmitMem(jc, ALUI_CMP, base, disp);
+    Emit1(jc, (uint8)imm);
+}
+
+/* lea reg, [base + disp], which unlike add leaves the flags alone */
+static void
+EmitLea(JITCompiler *jc, uintN reg, uintN base, int32 disp)
+{
+    EmitRex(jc, JS_TRUE, reg, base);
+    Emit1(jc, 0x8d);
+    EmitMem(jc, reg, base, disp);
+}
+
+/* mov reg, imm */
+static void
+EmitMovImm(JITCompiler *jc, uintN reg, prword imm)
+{
+    EmitRex(jc, JS_TRUE, 0, reg);
+    if (imm == (prword)(int32)imm) {
+	Emit1(jc, 0xc7);
+	EmitModRM(jc, 0, reg);
+	Emit4(jc, (int32)imm);
+    } else {
+	Emit1(jc, (uint8)(0xb8 + (reg & 7)));
+	Emit8(jc, imm);
+    }
+}
+
+/* op dst, src for the ALU_* opcodes */
+static void
+EmitAlu(JITCompiler *jc, uint8 opcode, uintN dst, uintN src)
+{
+    EmitRex(jc, JS_TRUE, src, dst);
+    Emit1(jc, opcode);
+    EmitModRM(jc, src, dst);
+}
+
+/* op dst, imm for the ALUI_* extensions */
+static void
+EmitAluImm(JITCompiler *jc, uintN ext, uintN dst, int32 imm)
+{
+    EmitRex(jc, JS_TRUE, 0, dst);
+    if (IS_INT8(imm)) {
+	Emit1(jc, 0x83);
+	EmitModRM(jc, ext, dst);
+	Emit1(jc, (uint8)imm);
+    } else {
+	Emit1(jc, 0x81);
+	EmitModRM(jc, ext, dst);
+	Emit4(jc, imm);
+    }
+}
+
+/* test reg32, imm */
+static void
+EmitTestImm(JITCompiler *jc, uintN reg, int32 imm)
+{
+    EmitRex(jc, JS_FALSE, 0, reg);
+    Emit1(jc, 0xf7);
+    EmitModRM(jc, 0, reg);
+    Emit4(jc, imm);
+}
+
+/* shl/shr/sar reg by 1 or by cl, 32 or 64 bits wide */
+static void
+EmitShift(JITCompiler *jc, JSBool w, uintN ext, uintN reg, JSBool bycl)
+{
+    EmitRex(jc, w, 0, reg);
+    Emit1(jc, bycl ? 0xd3 : 0xd1);
+    EmitModRM(jc, ext, reg);
+}
+
+/* movsxd dst, src32 */
+static void
+EmitMovsxd(JITCompiler *jc, uintN dst, uintN src)
+{
+    EmitRex(jc, JS_TRUE, dst, src);
+    Emit1(jc, 0x63);
+    EmitModRM(jc, dst, src);
+}
+
+/* mov dst32, src32, which zeroes the high half of dst */
+static void
+EmitMov32(JITCompiler *jc, uintN dst, uintN src)
+{
+    EmitRex(jc, JS_FALSE, src, dst);
+    Emit1(jc, ALU_MOV);
+    EmitModRM(jc, src, dst);
+}
+
+/* imul dst, src */
+static void
+EmitImul(JITCompiler *jc, uintN dst, uintN src)
+{
+    EmitRex(jc, JS_TRUE, dst, src);
+    Emit1(jc, 0x0f);
+    Emit1(jc, 0xaf);
+    EmitModRM(jc, dst, src);
+}
+
+/* setcc al; movzx eax, al */
+static void
+EmitSetcc(JITCompiler *jc, uintN cc)
+{
+    Emit1(jc, 0x0f);
+    Emit1(jc, (uint8)(0x90 + cc));
+    EmitModRM(jc, 0, RAX);
+    Emit1(jc, 0x0f);
+    Emit1(jc, 0xb6);
+    EmitModRM(jc, RAX, RAX);
+}
+
+static void
+EmitPush(JITCompiler *jc, uintN reg)
+{
+    EmitRex(jc, JS_FALSE, 0, reg);
+    Emit1(jc, (uint8)(0x50 + (reg & 7)));
+}
+
+static void
+EmitPop(JITCompiler *jc, uintN reg)
+{
+    EmitRex(jc, JS_FALSE, 0, reg);
+    Emit1(jc, (uint8)(0x58 + (reg & 7)));
+}
+
+/* Emit jcc or, if cc < 0, jmp with a zero rel32; return the rel32's offset. */
+static uint32
+EmitJump(JITCompiler *jc, intN cc)
+{
+    if (cc < 0) {
+	Emit1(jc, 0xe9);
+    } else {
+	Emit1(jc, 0x0f);
+	Emit1(jc, (uint8)(0x80 + cc));
+    }
+    Emit4(jc, 0);
+    return jc->length - 4;
+}
+
+static void
+PatchJump(JITCompiler *jc, uint32 pos, uint32 target)
+{
+    int32 rel;
+
+    if (!jc->ok)
+	return;
+    rel = (int32)target - (int32)(pos + 4);
+    memcpy(jc->buf + pos, &rel, 4);
+}
+
+#define PATCH_HERE(jc, pos)     PatchJump(jc, pos, (jc)->length)
+
+static void
+AddFixup(JITCompiler *jc, JITFixupList *list, uint32 pos, uint32 pcoff)
+{
+    JITFixup *vector;
+    uint32 capacity;
+
+    if (list->length == list->capacity) {
+	capacity = list->capacity ? 2 * list->capacity : 64;
+	vector = JS_realloc(jc->cx, list->vector, capacity * sizeof *vector);
+	if (!vector) {
+	    jc->ok = JS_FALSE;
+	    return;
+	}
+	list->vector = vector;
+	list->capacity = capacity;
+    }
+    list->vector[list->length].pos = pos;
+    list->vector[list->length].pcoff = pcoff;
+    list->length++;
+}
+
+/* Jump on cc to the exit stub for the op at pcoff. */
+#define EXIT_IF(jc, cc, pcoff)                                                \
+    AddFixup(jc, &(jc)->exits, EmitJump(jc, cc), pcoff)
+
+/* Jump (on cc, or always if cc < 0) to the op at bytecode offset pcoff. */
+#define JUMP_TO(jc, cc, pcoff)                                                \
+    AddFixup(jc, &(jc)->jumps, EmitJump(jc, cc), pcoff)
+
+/* mov rax, pc; jmp exit */
+static void
+EmitExitStub(JITCompiler *jc, uint32 pcoff)
+{
+    EmitMovImm(jc, RAX, (prword)(jc->script->code + pcoff));
+    PatchJump(jc, EmitJump(jc, -1), jc->exitCode);
+}
+
+/*
+ * Store v from reg at sp[slot], and the pc of the op at pcoff at the same
+ * slot of the pc stack, as PUSH_OPND does.  Then set sp to &sp[slot + 1].
+ */
+static void
+EmitStoreOpnd(JITCompiler *jc, uintN reg, int32 slot, uint32 pcoff)
+{
+    PR_ASSERT(reg != RDX);
+    EmitMovImm(jc, RDX, (prword)(jc->script->code + pcoff));
+    EmitStore(jc, SP_REG, slot * (int32)sizeof(jsval) - jc->depth, RDX);
+    EmitStore(jc, SP_REG, slot * (int32)sizeof(jsval), reg);
+    if (slot + 1 != 0)
+	EmitAluImm(jc, ALUI_ADD, SP_REG, (slot + 1) * (int32)sizeof(jsval));
+}
+
+/* Exit unless reg holds an int jsval (not JSVAL_VOID). */
+static void
+EmitGuardInt(JITCompiler *jc, uintN reg, uint32 pcoff)
+{
+    EmitTestImm(jc, reg, JSVAL_INT);
+    EXIT_IF(jc, CC_E, pcoff);
+    EmitAluImm(jc, ALUI_CMP, reg, (int32)JSVAL_VOID);
+    EXIT_IF(jc, CC_E, pcoff);
+}
+
+/* Exit unless rax and rcx both hold int jsvals; voids pass if allowVoid. */
+static void
+EmitGuardInts(JITCompiler *jc, JSBool allowVoid, uint32 pcoff)
+{
+    EmitAlu(jc, ALU_MOV, RDX, RAX);
+    EmitAlu(jc, ALU_AND, RDX, RCX);
+    EmitTestImm(jc, RDX, JSVAL_INT);
+    EXIT_IF(jc, CC_E, pcoff);
+    if (!allowVoid) {
+	EmitAluImm(jc, ALUI_CMP, RAX, (int32)JSVAL_VOID);
+	EXIT_IF(jc, CC_E, pcoff);
+	EmitAluImm(jc, ALUI_CMP, RCX, (int32)JSVAL_VOID);
+	EXIT_IF(jc, CC_E, pcoff);
+    }
+}
+
+/* reg = JSVAL_TO_INT(reg), sign-extended to 64 bits. */
+static void
+EmitUntag(JITCompiler *jc, uintN reg)
+{
+    EmitShift(jc, JS_FALSE, SHIFT_SAR, reg, JS_FALSE);
+    EmitMovsxd(jc, reg, reg);
+}
+
+/* Exit unless INT_FITS_IN_JSVAL(rax), else rax = INT_TO_JSVAL(rax). */
+static void
+EmitRetag(JITCompiler *jc, uint32 pcoff)
+{
+    EmitAlu(jc, ALU_MOV, RDX, RAX);
+    EmitAluImm(jc, ALUI_ADD, RDX, (int32)JSVAL_INT_MAX);
+    EmitAluImm(jc, ALUI_CMP, RDX, (int32)(2 * JSVAL_INT_MAX));
+    EXIT_IF(jc, CC_A, pcoff);
+    EmitAlu(jc, ALU_ADD, RAX, RAX);
+    EmitAluImm(jc, ALUI_OR, RAX, JSVAL_INT);
+}
+
+/*
+ * Before a backward branch, exit to let Interpret call the branch callback
+ * or interrupt hook, run a newly set trap, or stop for another thread's GC.
+ */
+static void
+EmitBranchCheck(JITCompiler *jc, uint32 pcoff)
+{
+    EmitCmpMemImm8(jc, JS_TRUE, CX_REG,
+		   offsetof(JSContext, branchCallback), 0);
+    EXIT_IF(jc, CC_NE, pcoff);
+#ifdef DEBUG
+    EmitCmpMemImm8(jc, JS_TRUE, CX_REG, offsetof(JSContext, tracefp), 0);
+    EXIT_IF(jc, CC_NE, pcoff);
+#endif
+    EmitLoad(jc, RAX, CX_REG, offsetof(JSContext, runtime));
+    EmitCmpMemImm8(jc, JS_TRUE, RAX, offsetof(JSRuntime, interruptHandler), 0);
+    EXIT_IF(jc, CC_NE, pcoff);
+#ifdef JS_THREADSAFE
+    EmitCmpMemImm8(jc, JS_FALSE, RAX, offsetof(JSRuntime, stopRequested), 0);
+    EXIT_IF(jc, CC_NE, pcoff);
+#endif
+    EmitMovImm(jc, RAX, (prword)&jc->jit->valid);
+    EmitCmpMemImm8(jc, JS_FALSE, RAX, 0, 0);
+    EXIT_IF(jc, CC_E, pcoff);
+}
+
+/* Return the length of the op at pc, or 0 if pc isn't a known op. */
+static uintN
+OpLength(jsbytecode *pc, jsbytecode *endpc)
+{
+    JSOp op;
+    intN len;
+    jsbytecode *pc2;
+    jsint low, high;
+
+    op = (JSOp)*pc;
+    if ((uintN)op >= (uintN)JSOP_LIMIT)
+	return 0;
+    len = js_CodeSpec[op].length;
+    if (len > 0)
+	return (uintN)len;
+
+    /* The switches are variable-length, see js_Disassemble1. */
+    pc2 = pc + 2;
+    if (pc2 + 3 > endpc)
+	return 0;
+    if (op == JSOP_TABLESWITCH) {
+	low = GET_JUMP_OFFSET(pc2);
+	pc2 += 2;
+	high = GET_JUMP_OFFSET(pc2);
+	pc2 += 2;
+	if (pc2 + 1 < pc + GET_JUMP_OFFSET(pc))
+	    pc2 += 2 * (high - low + 1);
+    } else {
+	pc2 += 2 + 4 * GET_ATOM_INDEX(pc2);
+    }
+    return (uintN)(1 + pc2 - pc);
+}
+
+/*
+ * Compile the op at pc.  Return false if it has no native code, in which
+ * case the caller emits a plain exit stub for it.
+ */
+static JSBool
+CompileOp(JITCompiler *jc, jsbytecode *pc, jsbytecode *endpc)
+{
+    JSScript *script;
+    uint32 pcoff, target, j1, j2, j3, j4, j5;
+    JSOp op, op2;
+    uintN format, cc, base;
+    int32 slot;
+    JSAtom *atom;
+
+    script = jc->script;
+    pcoff = (uint32)(pc - script->code);
+    op = (JSOp)*pc;
+    format = js_CodeSpec[op].format;
+
+    switch (op) {
+      case JSOP_NOP:
+	break;
+
+      case JSOP_PUSH:
+	EmitMovImm(jc, RAX, JSVAL_VOID);
+	EmitStoreOpnd(jc, RAX, 0, pcoff);
+	break;
+
+      case JSOP_POP:
+	EmitAluImm(jc, ALUI_SUB, SP_REG, sizeof(jsval));
+	break;
+
+      case JSOP_DUP:
+	EmitLoad(jc, RAX, SP_REG, -1 * (int32)sizeof(jsval));
+	EmitStoreOpnd(jc, RAX, 0, pcoff);
+	break;
+
+      case JSOP_DUP2:
+	EmitLoad(jc, RAX, SP_REG, -2 * (int32)sizeof(jsval));
+	EmitLoad(jc, RCX, SP_REG, -1 * (int32)sizeof(jsval));
+	EmitStoreOpnd(jc, RAX, 0, pcoff);
+	EmitStoreOpnd(jc, RCX, 0, pcoff);
+	break;
+
+      case JSOP_ZERO:
+      case JSOP_ONE:
+      case JSOP_UINT16:
+      case JSOP_FALSE:
+      case JSOP_TRUE:
+	EmitMovImm(jc, RAX,
+		   (op == JSOP_ZERO) ? JSVAL_ZERO :
+		   (op == JSOP_ONE) ? JSVAL_ONE :
+		   (op == JSOP_UINT16) ? INT_TO_JSVAL(GET_ATOM_INDEX(pc)) :
+		   (op == JSOP_FALSE) ? JSVAL_FALSE : JSVAL_TRUE);
+	EmitStoreOpnd(jc, RAX, 0, pcoff);
+	break;
+
+      case JSOP_NUMBER:
+      case JSOP_STRING:
+	/* The script's atom map keeps the literal alive. */
+	atom = GET_ATOM(jc->cx, script, pc);
+	EmitMovImm(jc, RAX, ATOM_KEY(atom));
+	EmitStoreOpnd(jc, RAX, 0, pcoff);
+	break;
+
+      case JSOP_GETARG:
+      case JSOP_GETVAR:
+      case JSOP_SETARG:
+      case JSOP_SETVAR:
+	/* Like Interpret, these set obj to the scope chain for JSOP_PUSHOBJ. */
+	EmitStoreImm32(jc, JF_REG, offsetof(JSJITFrame, setobj), JS_TRUE);
+	base = (op == JSOP_GETARG || op == JSOP_SETARG) ? ARGV_REG : VARS_REG;
+	slot = (int32)GET_ARGNO(pc) * (int32)sizeof(jsval);
+	if (format & JOF_SET) {
+	    /* See GC_POKE in jsgc.h. */
+	    EmitMovImm(jc, RAX, (prword)&jc->cx->runtime->gcPoke);
+	    EmitStoreImm32(jc, RAX, 0, JS_TRUE);
+	    EmitLoad(jc, RAX, SP_REG, -1 * (int32)sizeof(jsval));
+	    EmitStore(jc, base, slot, RAX);
+	} else {
+	    EmitLoad(jc, RAX, base, slot);
+	    EmitStoreOpnd(jc, RAX, 0, pcoff);
+	}
+	break;
+
+      case JSOP_INCARG:
+      case JSOP_DECARG:
+      case JSOP_ARGINC:
+      case JSOP_ARGDEC:
+      case JSOP_INCVAR:
+      case JSOP_DECVAR:
+      case JSOP_VARINC:
+      case JSOP_VARDEC:
+	base = ((format & JOF_TYPEMASK) == JOF_QARG) ? ARGV_REG : VARS_REG;
+	slot = (int32)GET_ARGNO(pc) * (int32)sizeof(jsval);
+	EmitLoad(jc, RAX, base, slot);
+	EmitGuardInt(jc, RAX, pcoff);
+	EmitAlu(jc, ALU_MOV, RCX, RAX);
+	EmitUntag(jc, RAX);
+	EmitAluImm(jc, (format & JOF_INC) ? ALUI_ADD : ALUI_SUB, RAX, 1);
+	EmitRetag(jc, pcoff);
+	EmitStore(jc, base, slot, RAX);
+	EmitStoreOpnd(jc, (format & JOF_POST) ? RCX : RAX, 0, pcoff);
+	break;
+
+      case JSOP_ADD:
+      case JSOP_SUB:
+      case JSOP_MUL:
+      case JSOP_BITAND:
+      case JSOP_BITOR:
+      case JSOP_BITXOR:
+      case JSOP_LSH:
+      case JSOP_RSH:
+      case JSOP_URSH:
+	EmitLoad(jc, RAX, SP_REG, -2 * (int32)sizeof(jsval));
+	EmitLoad(jc, RCX, SP_REG, -1 * (int32)sizeof(jsval));
+	EmitGuardInts(jc, JS_FALSE, pcoff);
+	EmitUntag(jc, RAX);
+	EmitUntag(jc, RCX);
+	switch (op) {
+	  case JSOP_ADD:
+	    EmitAlu(jc, ALU_ADD, RAX, RCX);
+	    break;
+	  case JSOP_SUB:
+	    EmitAlu(jc, ALU_SUB, RAX, RCX);
+	    break;
+	  case JSOP_MUL:
+	    /* A zero product with a negative factor is -0, a double. */
+	    EmitAlu(jc, ALU_MOV, RDX, RAX);
+	    EmitAlu(jc, ALU_OR, RDX, RCX);
+	    EmitImul(jc, RAX, RCX);
+	    EmitAlu(jc, ALU_TEST, RAX, RAX);
+	    j1 = EmitJump(jc, CC_NE);
+	    EmitAlu(jc, ALU_TEST, RDX, RDX);
+	    EXIT_IF(jc, CC_S, pcoff);
+	    PATCH_HERE(jc, j1);
+	    break;
+	  case JSOP_BITAND:
+	    EmitAlu(jc, ALU_AND, RAX, RCX);
+	    break;
+	  case JSOP_BITOR:
+	    EmitAlu(jc, ALU_OR, RAX, RCX);
+	    break;
+	  case JSOP_BITXOR:
+	    EmitAlu(jc, ALU_XOR, RAX, RCX);
+	    break;
+	  default:
+	    /* 32-bit shifts mask the count by 31 as Interpret does. */
+	    EmitShift(jc, JS_FALSE,
+		      (op == JSOP_LSH) ? SHIFT_SHL :
+		      (op == JSOP_RSH) ? SHIFT_SAR : SHIFT_SHR,
+		      RAX, JS_TRUE);
+	    /*
+	     * >>> yields an unsigned 32-bit result, so zero-extend it and
+	     * let EmitRetag exit for values beyond JSVAL_INT_MAX.
+	     */
+	    if (op == JSOP_URSH)
+		EmitMov32(jc, RAX, RAX);
+	    else
+		EmitMovsxd(jc, RAX, RAX);
+	    break;
+	}
+	EmitRetag(jc, pcoff);
+	EmitStoreOpnd(jc, RAX, -2, pcoff);
+	break;
+
+      case JSOP_LT:
+      case JSOP_LE:
+      case JSOP_GT:
+      case JSOP_GE:
+      case JSOP_EQ:
+      case JSOP_NE:
+      case JSOP_NEW_EQ:
+      case JSOP_NEW_NE:
+	switch (op) {
+	  case JSOP_LT: cc = CC_L;  break;
+	  case JSOP_LE: cc = CC_LE; break;
+	  case JSOP_GT: cc = CC_G;  break;
+	  case JSOP_GE: cc = CC_GE; break;
+	  case JSOP_EQ:
+	  case JSOP_NEW_EQ: cc = CC_E; break;
+	  default:      cc = CC_NE; break;
+	}
+
+	/* Branch directly if an IFEQ or IFNE follows, as Interpret does. */
+	op2 = (pc + 1 < endpc) ? (JSOp)pc[1] : JSOP_LIMIT;
+	target = 0;
+	if (op2 == JSOP_IFEQ || op2 == JSOP_IFNE) {
+	    target = pcoff + 1 + GET_JUMP_OFFSET(pc + 1);
+	    if (target <= pcoff)
+		EmitBranchCheck(jc, pcoff);
+	}
+
+	/*
+	 * Int jsvals compare as their tagged words do.  For the equality ops,
+	 * two int-tagged words (void included) are equal iff they are the same
+	 * word, see EQUALITY_OP in jsinterp.c.
+	 */
+	EmitLoad(jc, RAX, SP_REG, -2 * (int32)sizeof(jsval));
+	EmitLoad(jc, RCX, SP_REG, -1 * (int32)sizeof(jsval));
+	EmitGuardInts(jc, cc == CC_E || cc == CC_NE, pcoff);
+	EmitAlu(jc, ALU_CMP, RAX, RCX);
+	if (op2 == JSOP_IFEQ || op2 == JSOP_IFNE) {
+	    EmitLea(jc, SP_REG, SP_REG, -2 * (int32)sizeof(jsval));
+	    JUMP_TO(jc, (op2 == JSOP_IFNE) ? cc : CC_INVERT(cc), target);
+	    JUMP_TO(jc, -1, pcoff + 1 + js_CodeSpec[op2].length);
+	} else {
+	    EmitSetcc(jc, cc);
+	    EmitShift(jc, JS_FALSE, SHIFT_SHL, RAX, JS_FALSE);
+	    EmitShift(jc, JS_FALSE, SHIFT_SHL, RAX, JS_FALSE);
+	    EmitShift(jc, JS_FALSE, SHIFT_SHL, RAX, JS_FALSE);
+	    EmitAluImm(jc, ALUI_OR, RAX, JSVAL_BOOLEAN);
+	    EmitStoreOpnd(jc, RAX, -2, pcoff);
+	}
+	break;
+
+      case JSOP_GOTO:
+      case JSOP_IFEQ:
+      case JSOP_IFNE:
+	target = pcoff + GET_JUMP_OFFSET(pc);
+	if (target <= pcoff)
+	    EmitBranchCheck(jc, pcoff);
+	if (op == JSOP_GOTO) {
+	    JUMP_TO(jc, -1, target);
+	    break;
+	}
+
+	/* Decide null, boolean, and int conditions; exit on any other. */
+	EmitLoad(jc, RAX, SP_REG, -1 * (int32)sizeof(jsval));
+	EmitAluImm(jc, ALUI_CMP, RAX, (int32)JSVAL_TRUE);
+	j1 = EmitJump(jc, CC_E);
+	EmitAluImm(jc, ALUI_CMP, RAX, (int32)JSVAL_FALSE);
+	j2 = EmitJump(jc, CC_E);
+	EmitAlu(jc, ALU_TEST, RAX, RAX);
+	j3 = EmitJump(jc, CC_E);
+	EmitTestImm(jc, RAX, JSVAL_INT);
+	EXIT_IF(jc, CC_E, pcoff);
+	EmitAluImm(jc, ALUI_CMP, RAX, (int32)JSVAL_VOID);
+	j4 = EmitJump(jc, CC_E);
+	EmitAluImm(jc, ALUI_CMP, RAX, (int32)JSVAL_ZERO);
+	j5 = EmitJump(jc, CC_E);
+
+	/* True: pop, and jump if IFNE, else go on to the next op. */
+	PATCH_HERE(jc, j1);
+	EmitAluImm(jc, ALUI_SUB, SP_REG, sizeof(jsval));
+	JUMP_TO(jc, -1, (op == JSOP_IFNE) ? target : pcoff + 3);
+
+	/* False: pop, and jump if IFEQ, else fall through to the next op. */
+	PATCH_HERE(jc, j2);
+	PATCH_HERE(jc, j3);
+	PATCH_HERE(jc, j4);
+	PATCH_HERE(jc, j5);
+	EmitAluImm(jc, ALUI_SUB, SP_REG, sizeof(jsval));
+	if (op == JSOP_IFEQ)
+	    JUMP_TO(jc, -1, target);
+	break;
+
+      case JSOP_NOT:
+	EmitLoad(jc, RAX, SP_REG, -1 * (int32)sizeof(jsval));
+	EmitAluImm(jc, ALUI_CMP, RAX, (int32)JSVAL_TRUE);
+	j1 = EmitJump(jc, CC_E);
+	EmitAluImm(jc, ALUI_CMP, RAX, (int32)JSVAL_FALSE);
+	EXIT_IF(jc, CC_NE, pcoff);
+	EmitMovImm(jc, RAX, JSVAL_TRUE);
+	j2 = EmitJump(jc, -1);
+	PATCH_HERE(jc, j1);
+	EmitMovImm(jc, RAX, JSVAL_FALSE);
+	PATCH_HERE(jc, j2);
+	EmitStoreOpnd(jc, RAX, -1, pcoff);
+	break;
+
+      default:
+	return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+static JSBool
+CompileScript(JITCompiler *jc)
+{
+    JSScript *script;
+    JSJITCode *jit;
+    jsbytecode *pc, *endpc;
+    uint32 pcoff, i, start;
+    uintN len, ncompiled;
+    JITFixup *fix;
+    void *code;
+
+    script = jc->script;
+    jit = jc->jit;
+    pc = script->code;
+    endpc = pc + script->length;
+
+    /*
+     * Prologue, entered as a JSJITEntry: save the callee-saved registers,
+     * load the frame state into them, and jump to the start op.  Then the
+     * common exit, which stores sp and the exit pc passed in rax.
+     */
+    EmitPush(jc, RBX);
+    EmitPush(jc, RBP);
+    EmitPush(jc, R12);
+    EmitPush(jc, R13);
+    EmitPush(jc, R14);
+    EmitPush(jc, R15);
+    EmitAlu(jc, ALU_MOV, JF_REG, RDI);
+    EmitLoad(jc, SP_REG, JF_REG, offsetof(JSJITFrame, sp));
+    EmitLoad(jc, CX_REG, JF_REG, offsetof(JSJITFrame, cx));
+    EmitLoad(jc, ARGV_REG, JF_REG, offsetof(JSJITFrame, argv));
+    EmitLoad(jc, VARS_REG, JF_REG, offsetof(JSJITFrame, vars));
+    EmitRex(jc, JS_FALSE, 0, RSI);
+    Emit1(jc, 0xff);
+    EmitModRM(jc, 4, RSI);
+
+    jc->exitCode = jc->length;
+    EmitStore(jc, JF_REG, offsetof(JSJITFrame, pc), RAX);
+    EmitStore(jc, JF_REG, offsetof(JSJITFrame, sp), SP_REG);
+    EmitPop(jc, R15);
+    EmitPop(jc, R14);
+    EmitPop(jc, R13);
+    EmitPop(jc, R12);
+    EmitPop(jc, RBP);
+    EmitPop(jc, RBX);
+    Emit1(jc, 0xc3);
+
+    /* The ops, in bytecode order, then an exit for falling off the end. */
+    ncompiled = 0;
+    while (pc < endpc) {
+	pcoff = (uint32)(pc - script->code);
+	len = OpLength(pc, endpc);
+	if (len == 0 || pc + len > endpc)
+	    return JS_FALSE;
+	jc->offsets[pcoff] = (int32)jc->length;
+	start = jc->length;
+	if (CompileOp(jc, pc, endpc)) {
+	    jit->entries[pcoff] = start;
+	    ncompiled++;
+	} else {
+	    EmitExitStub(jc, pcoff);
+	}
+	pc += len;
+    }
+    jc->offsets[script->length] = (int32)jc->length;
+    EmitExitStub(jc, script->length);
+    if (ncompiled == 0)
+	return JS_FALSE;
+
+    /* Out-of-line exit stubs, one per op with guards. */
+    for (i = 0; i < jc->exits.length; i++) {
+	fix = &jc->exits.vector[i];
+	if (i == 0 || fix->pcoff != fix[-1].pcoff) {
+	    start = jc->length;
+	    EmitExitStub(jc, fix->pcoff);
+	}
+	PatchJump(jc, fix->pos, start);
+    }
+
+    for (i = 0; i < jc->jumps.length; i++) {
+	fix = &jc->jumps.vector[i];
+	if (fix->pcoff > script->length || jc->offsets[fix->pcoff] < 0)
+	    return JS_FALSE;
+	PatchJump(jc, fix->pos, (uint32)jc->offsets[fix->pcoff]);
+    }
+    if (!jc->ok)
+	return JS_FALSE;
+
+    code = mmap(NULL, jc->length, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (code == MAP_FAILED)
+	return JS_FALSE;
+    memcpy(code, jc->buf, jc->length);
+    if (mprotect(code, jc->length, PROT_READ | PROT_EXEC) != 0) {
+	munmap(code, jc->length);
+	return JS_FALSE;
+    }
+    jit->code = code;
+    jit->size = jc->length;
+    return JS_TRUE;
+}
+
+JSJITCode *
+js_GetJITCode(JSContext *cx, JSScript *script)
+{
+    JSJITCode *jit;
+    JITCompiler jc;
+    uint32 i;
+
+    jit = script->jit;
+    if (!jit) {
+	/* Compile under the runtime lock so threads agree on script->jit. */
+	JS_LOCK(cx);
+	jit = script->jit;
+	if (!jit) {
+	    jit = JS_malloc(cx, sizeof *jit);
+	    if (!jit) {
+		JS_UNLOCK(cx);
+		return NULL;
+	    }
+	    memset(jit, 0, sizeof *jit);
+	    jit->entries = JS_malloc(cx, (script->length + 1) * sizeof(uint32));
+	    memset(&jc, 0, sizeof jc);
+	    jc.cx = cx;
+	    jc.script = script;
+	    jc.jit = jit;
+	    jc.ok = JS_TRUE;
+	    jc.depth = (int32)(script->depth * sizeof(jsval));
+	    jc.offsets = JS_malloc(cx, (script->length + 1) * sizeof(int32));
+	    if (jit->entries && jc.offsets) {
+		memset(jit->entries, 0, (script->length + 1) * sizeof(uint32));
+		for (i = 0; i <= script->length; i++)
+		    jc.offsets[i] = -1;
+		jit->valid = CompileScript(&jc);
+	    }
+	    if (!jit->valid && jit->entries) {
+		JS_free(cx, jit->entries);
+		jit->entries = NULL;
+	    }
+	    if (jc.buf)
+		JS_free(cx, jc.buf);
+	    if (jc.offsets)
+		JS_free(cx, jc.offsets);
+	    if (jc.exits.vector)
+		JS_free(cx, jc.exits.vector);
+	    if (jc.jumps.vector)
+		JS_free(cx, jc.jumps.vector);
+	    script->jit = jit;
+	}
+	JS_UNLOCK(cx);
+    }
+    return jit->valid ? jit : NULL;
+}
+
+jsbytecode *
+js_RunJITCode(JSContext *cx, JSJITCode *jit, jsbytecode *pc, jsval **spp,
+	      JSBool *setobjp)
+{
+    JSStackFrame *fp;
+    JSJITFrame jf;
+
+    fp = cx->fp;
+    PR_ASSERT(jit->entries[pc - fp->script->code] != 0);
+    jf.sp = *spp;
+    jf.pc = pc;
+    jf.cx = cx;
+    jf.argv = fp->argv;
+    jf.vars = fp->vars;
+    jf.setobj = JS_FALSE;
+    ((JSJITEntry)jit->code)(&jf,
+			    jit->code + jit->entries[pc - fp->script->code]);
+    *spp = jf.sp;
+    *setobjp = jf.setobj;
+    return jf.pc;
+}
+
+void
+js_DestroyJITCode(JSContext *cx, JSJITCode *jit)
+{
+    if (jit->code)
+	munmap(jit->code, jit->size);
+    if (jit->entries)
+	JS_free(cx, jit->entries);
+    JS_free(cx, jit);
+}
+
+#endif /* JS_HAS_JIT */
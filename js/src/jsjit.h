@@ -0,0 +1,90 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+#ifndef jsjit_h___
+#define jsjit_h___
+/*
+ * JS baseline template JIT.
+ *
+ * A script's bytecode is translated op by op into native code that keeps sp
+ * in a register and works on the interpreter's own stack frame: operand and
+ * pc stacks, fp->argv, and fp->vars.  Local variable and argument access,
+ * constants, stack shuffling, int-tagged arithmetic and compares, and
+ * branches are compiled inline.  Any other op, and any inline op whose
+ * operands fail its int-tag guards, exits to Interpret at that op's pc with
+ * the stack intact, so the interpreter's own code for the op runs and the
+ * results can't differ.  Interpret reenters the native code at the next op
+ * that has an entry point.
+ *
+ * Native code never calls out and so never runs the GC or another script.
+ * Backward branches exit when a branch callback, interrupt hook, or trap
+ * must run; setting a trap in a script invalidates its code for good.
+ */
+#include "jsprvtd.h"
+#include "jspubtd.h"
+
+PR_BEGIN_EXTERN_C
+
+#ifndef JS_HAS_JIT
+#if defined __x86_64__ && defined __GNUC__ && defined XP_UNIX
+#define JS_HAS_JIT      1
+#else
+#define JS_HAS_JIT      0
+#endif
+#endif
+
+#if JS_HAS_JIT
+
+/*
+ * Interpret compiles a script on its JS_JIT_HOT_USES'th call, or when it
+ * first takes a backward jump, whichever comes first.
+ */
+#define JS_JIT_HOT_USES 2
+
+struct JSJITCode {
+    uint8           *code;      /* executable native code, or null */
+    size_t          size;       /* size of the code mapping in bytes */
+    uint32          *entries;   /* native offset by bytecode offset, or 0 */
+    JSBool          valid;      /* false if uncompilable or trapped */
+};
+
+/*
+ * Return script's native code, compiling it on first use, or null if the
+ * script can't or mustn't run natively.
+ */
+extern JSJITCode *
+js_GetJITCode(JSContext *cx, JSScript *script);
+
+/*
+ * Run jit's code for the active frame from pc, which must have an entry, to
+ * the next exit.  Update *spp and return the pc of the op the interpreter
+ * should run next.  Set *setobjp if a native op set Interpret's obj to the
+ * frame's scope chain (see JSOP_GETVAR).
+ */
+extern jsbytecode *
+js_RunJITCode(JSContext *cx, JSJITCode *jit, jsbytecode *pc, jsval **spp,
+	      JSBool *setobjp);
+
+extern void
+js_DestroyJITCode(JSContext *cx, JSJITCode *jit);
+
+#endif /* JS_HAS_JIT */
+
+PR_END_EXTERN_C
+
+#endif /* jsjit_h___ */
@@ -25,96 +25,126 @@
 #include "prlock.h"
 #include "prthread.h"
 #include "prlong.h"
+#include "jsscope.h"
 
-PRLock* js_owner_lock = 0;
-PRThread  *js_owner_thread = 0;
-unsigned  js_owner_count = 0;
+/*
+ * Thin scope locks need an atomic compare-and-swap; elsewhere they fall back
+ * on the runtime lock.
+ */
+#ifndef JS_HAS_THIN_LOCKS
+#if defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+#define JS_HAS_THIN_LOCKS 1
+#else
+#define JS_HAS_THIN_LOCKS 0
+#endif
+#endif
 
 void
-js_lock_task(JSTaskState *task)
+js_LockRuntime(JSContext *cx)
 {
-    PRThread *me = PR_GetCurrentThread();
-
-    if (! js_owner_lock) {
-      js_owner_lock = PR_NewLock();
-    }
-
-    if ( js_owner_thread == me) {
-        PR_ASSERT(js_owner_count > 0);
-        js_owner_count++;
+    if (cx->requestDepth == 0) {
+	js_lock_runtime(cx->runtime);
+	return;
     }
-    else {
-        PR_Lock(js_owner_lock);
-        PR_ASSERT(js_owner_count == 0);
-        js_owner_count = 1;
-        js_owner_thread = me;
-    }
-
+    cx->stopped = JS_TRUE;
+    js_lock_runtime(cx->runtime);
+    cx->stopped = JS_FALSE;
 }
 
 void
-js_unlock_task(JSTaskState *task)
+js_WaitForStop(JSContext *cx, JSContext *acx)
 {
-    if (js_owner_thread != PR_GetCurrentThread())
-        return;
+    JSRuntime *rt;
+    PRThread *me;
+    JSContext *iter, *bcx;
+
+    rt = cx->runtime;
+    PR_ASSERT(JS_IS_RUNTIME_LOCKED(rt));
+    me = PR_GetCurrentThread();
+    rt->stopRequested = JS_TRUE;
+    iter = NULL;
+    while ((bcx = js_ContextIterator(rt, &iter)) != NULL) {
+	if (bcx == cx || (acx && bcx != acx))
+	    continue;
+	while (bcx->requestDepth != 0 && !bcx->stopped && bcx->thread != me)
+	    PR_Sleep(PR_INTERVAL_NO_WAIT);
+    }
+    rt->stopRequested = JS_FALSE;
+}
 
-    if ( --js_owner_count == 0) {
-        js_owner_thread = 0;
-        PR_Unlock(js_owner_lock);
+/*
+ * Make scope shared, with the runtime lock held.  Its owner must be stopped
+ * first, unless it has been destroyed.  A new context at the same address
+ * inherits the scope, which is harmless: it stops like any other owner.
+ */
+static void
+ShareScope(JSContext *cx, JSScope *scope)
+{
+    JSContext *owner, *iter, *acx;
+
+    owner = scope->ownercx;
+    if (!owner)
+	return;
+    iter = NULL;
+    while ((acx = js_ContextIterator(cx->runtime, &iter)) != NULL) {
+	if (acx == owner) {
+	    js_WaitForStop(cx, owner);
+	    break;
+	}
     }
-    PR_ASSERT(js_owner_count >= 0);
+    scope->ownercx = NULL;
 }
 
+#if JS_HAS_THIN_LOCKS
 
-/*
-PRMonitor *js_owner_monitor;
-PRThread  *js_owner_thread;
-unsigned  js_owner_count;
+static JSBool
+CompareAndSwap(prword *w, prword ov, prword nv)
+{
+    prword res;
+
+    __asm__ __volatile__("lock; cmpxchg %2, %1"
+			 : "=a" (res), "+m" (*w)
+			 : "r" (nv), "0" (ov)
+			 : "memory", "cc");
+    return res == ov;
+}
 
 void
-js_lock_task(JSTaskState *task)
+js_LockScope(JSContext *cx, JSScope *scope)
 {
-    PRThread *t = PR_CurrentThread();
-
-    if (!js_owner_monitor)
-        js_owner_monitor = PR_NewNamedMonitor("js-owner-monitor");
-    PR_EnterMonitor(js_owner_monitor);
-
-    if (js_owner_thread == t) {
-        js_owner_count++;
-    } else {
-        do {
-            if (!js_owner_thread) {
-                js_owner_thread = t;
-                break;
-            }
-            PR_Wait(js_owner_monitor, PR_INTERVAL_MAX);
-        } while (js_owner_thread != t);
+    if (scope->ownercx) {
+	JS_LOCK(cx);
+	ShareScope(cx, scope);
+	JS_UNLOCK(cx);
     }
-    PR_ExitMonitor(js_owner_monitor);
+    PR_ASSERT(scope->lock != (prword)cx);
+    while (!CompareAndSwap(&scope->lock, 0, (prword)cx))
+	PR_Sleep(PR_INTERVAL_NO_WAIT);
 }
 
 void
-js_unlock_task(JSTaskState *task)
+js_UnlockScope(JSContext *cx, JSScope *scope)
 {
-    PR_ASSERT(PR_CurrentThread() == js_owner_thread);
-    PR_EnterMonitor(js_owner_monitor);
-    if (js_owner_count) {
-        js_owner_count--;
-    } else {
-        js_owner_thread = NULL;
-        PR_Notify(js_owner_monitor);
-    }
-    PR_ExitMonitor(js_owner_monitor);
+    PR_ASSERT(scope->lock == (prword)cx);
+    __asm__ __volatile__("" : : : "memory");
+    *(volatile prword *)&scope->lock = 0;
 }
-*/
 
-#ifdef DEBUG
-int
-js_is_task_locked(JSTaskState *task)
+#else  /* !JS_HAS_THIN_LOCKS */
+
+void
+js_LockScope(JSContext *cx, JSScope *scope)
 {
-    return (PR_CurrentThread() == js_owner_thread);
+    JS_LOCK(cx);
+    ShareScope(cx, scope);
 }
-#endif
+
+void
+js_UnlockScope(JSContext *cx, JSScope *scope)
+{
+    JS_UNLOCK(cx);
+}
+
+#endif /* !JS_HAS_THIN_LOCKS */
 
 #endif /* JS_THREADSAFE */
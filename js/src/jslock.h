@@ -43,11 +43,48 @@ extern int js_is_runtime_locked(JSRuntime *rt);
 #define JS_IS_RUNTIME_LOCKED(rt) 1
 #endif
 
-#define JS_LOCK_VOID(cx, e)                                                   \
-    PR_BEGIN_MACRO                                                            \
-	JSRuntime *_rt = (cx)->runtime;                                       \
-	JS_LOCK_RUNTIME_VOID(_rt, e);                                         \
-    PR_END_MACRO
+/*
+ * A context in a request (see JS_BeginRequest) must take the runtime lock
+ * with JS_LOCK, which marks it stopped while it waits, so that a thread
+ * holding the lock to run the GC need not wait for it.
+ */
+#define JS_LOCK(cx)             js_LockRuntime(cx)
+#define JS_LOCK_VOID(cx, e)     (JS_LOCK(cx), (void)(e), JS_UNLOCK(cx))
+
+extern void
+js_LockRuntime(JSContext *cx);
+
+/*
+ * Called with the runtime lock held, wait until acx, or every other context
+ * in a request if acx is null, is stopped: waiting for the runtime lock,
+ * polling for a stop request, or running on the calling thread.
+ */
+extern void
+js_WaitForStop(JSContext *cx, JSContext *acx);
+
+/*
+ * Per-scope locks.  A scope belongs to the context that created it, which
+ * reads and writes its object's slots without locking.  The first time
+ * another context locks the scope, it waits for the owner to stop and makes
+ * the scope shared; from then on every context takes the scope's thin lock,
+ * a word swapped from 0 to the context's address.  A thread holds at most
+ * one scope lock at a time, and only briefly: it must not block, allocate
+ * GC things, or take the runtime lock while holding one.  Code that holds
+ * the runtime lock takes a scope lock only to store into what unlocked
+ * readers of the scope's object may load: its shape, slots, or map.
+ */
+#define JS_LOCK_SCOPE(cx, scope)                                              \
+    ((scope)->ownercx == (cx) ? (void)0 : js_LockScope(cx, scope))
+#define JS_UNLOCK_SCOPE(cx, scope)                                            \
+    ((scope)->ownercx == (cx) ? (void)0 : js_UnlockScope(cx, scope))
+#define JS_LOCK_OBJ(cx, obj)    JS_LOCK_SCOPE(cx, (JSScope *)(obj)->map)
+#define JS_UNLOCK_OBJ(cx, obj)  JS_UNLOCK_SCOPE(cx, (JSScope *)(obj)->map)
+
+extern void
+js_LockScope(JSContext *cx, JSScope *scope);
+
+extern void
+js_UnlockScope(JSContext *cx, JSScope *scope);
 
 #else  /* !JS_THREADSAFE */
 
@@ -57,11 +94,16 @@ extern int js_is_runtime_locked(JSRuntime *rt);
 #define JS_LOCK_RUNTIME(rt)     ((void)0)
 #define JS_UNLOCK_RUNTIME(rt)   ((void)0)
 #define JS_IS_RUNTIME_LOCKED(rt) 1
-#define JS_LOCK_VOID(cx, e)     JS_LOCK_RUNTIME_VOID((cx)->runtime, e)
+#define JS_LOCK(cx)             ((void)0)
+#define JS_LOCK_VOID(cx, e)     ((void)(e))
+
+#define JS_LOCK_SCOPE(cx, scope)   ((void)0)
+#define JS_UNLOCK_SCOPE(cx, scope) ((void)0)
+#define JS_LOCK_OBJ(cx, obj)       ((void)0)
+#define JS_UNLOCK_OBJ(cx, obj)     ((void)0)
 
 #endif /* !JS_THREADSAFE */
 
-#define JS_LOCK(cx)             JS_LOCK_RUNTIME((cx)->runtime)
 #define JS_UNLOCK(cx)           JS_UNLOCK_RUNTIME((cx)->runtime)
 #define JS_IS_LOCKED(cx)        JS_IS_RUNTIME_LOCKED((cx)->runtime)
 
@@ -28,11 +28,11 @@
 #include <string.h>
 #include "prtypes.h"
 #include "prdtoa.h"
-#include "prprf.h"
 #include "jsapi.h"
 #include "jsatom.h"
 #include "jscntxt.h"
 #include "jsconfig.h"
+#include "jsdtoa.h"
 #include "jsgc.h"
 #include "jslock.h"
 #include "jsnum.h"
@@ -384,21 +384,125 @@ js_NumberToObject(JSContext *cx, jsdouble d)
     return obj;
 }
 
-/* XXXbe rewrite me to be ECMA-based! */
-JSString *
-js_NumberToString(JSContext *cx, jsdouble d)
+/*
+ * Format the digits and decimal point position of a positive number as
+ * PR_cnvtf(buf, bufsz, 20, d) does: positionally when 10^-6 <= d < 10^21,
+ * else in exponential notation, and with no leading zero when 0.1 <= d < 1.
+ */
+static char *
+FormatDigits(char *bp, const char *digits, intN ndigits, intN decpt)
+{
+    intN e;
+
+    if (decpt > 21 || decpt < -5) {
+	*bp++ = *digits++;
+	if (ndigits != 1) {
+	    *bp++ = '.';
+	    while (*digits != '\0')
+		*bp++ = *digits++;
+	}
+	*bp++ = 'e';
+	e = decpt - 1;
+	if (e < 0) {
+	    *bp++ = '-';
+	    e = -e;
+	} else {
+	    *bp++ = '+';
+	}
+	if (e >= 100)
+	    *bp++ = (char)('0' + e / 100);
+	if (e >= 10)
+	    *bp++ = (char)('0' + e / 10 % 10);
+	*bp++ = (char)('0' + e % 10);
+    } else if (decpt >= 0) {
+	while (decpt-- > 0)
+	    *bp++ = (*digits != '\0') ? *digits++ : '0';
+	if (*digits != '\0') {
+	    *bp++ = '.';
+	    while (*digits != '\0')
+		*bp++ = *digits++;
+	}
+    } else {
+	*bp++ = '0';
+	*bp++ = '.';
+	while (decpt++ < 0)
+	    *bp++ = '0';
+	while (*digits != '\0')
+	    *bp++ = *digits++;
+    }
+    *bp = '\0';
+    return bp;
+}
+
+char *
+js_dtostr(JSContext *cx, char *buf, jsdouble d)
 {
+    char *bp, *end, digits[JS_DTOA_DIGITS];
+    intN ndigits, decpt, sign;
+    PRStatus status;
     jsint i;
-    char buf[32];
+    jsuint u;
 
+    bp = buf;
     i = (jsint)d;
     if (JSDOUBLE_IS_INT(d, i)) {
-	PR_snprintf(buf, sizeof buf, "%ld", (long)i);
-    } else {
+	u = (i < 0) ? 0 - (jsuint)i : (jsuint)i;
+	bp = buf + DTOSTR_BUFSIZE;
+	*--bp = '\0';
+	do {
+	    *--bp = (char)('0' + u % 10);
+	} while ((u /= 10) != 0);
+	if (i < 0)
+	    *--bp = '-';
+	return memmove(buf, bp, buf + DTOSTR_BUFSIZE - bp);
+    }
+    if (JSDOUBLE_IS_NaN(d)) {
+	strcpy(buf, "NaN");
+	return buf;
+    }
+    if (d < 0) {
+	*bp++ = '-';
+	d = -d;
+    }
+    if (!JSDOUBLE_IS_FINITE(d)) {
+	strcpy(bp, "Infinity");
+	return buf;
+    }
+    if (d == 0) {
+	strcpy(buf, "0");
+	return buf;
+    }
+
+    if (!js_FastDtoa(d, digits, &ndigits, &decpt)) {
 	/* XXX lock here because prdtoa.c is not threadsafe yet */
-	JS_LOCK_VOID(cx, PR_cnvtf(buf, sizeof buf, 20, d));
+	JS_LOCK_VOID(cx, status = PR_dtoa_r(d, 1, 0, &decpt, &sign, &end,
+					    digits, sizeof digits));
+	if (status != PR_SUCCESS) {
+	    buf[0] = '\0';
+	    return buf;
+	}
+	ndigits = end - digits;
     }
-    return JS_NewStringCopyZ(cx, buf);
+    FormatDigits(bp, digits, ndigits, decpt);
+    return buf;
+}
+
+JSString *
+js_NumberToString(JSContext *cx, jsdouble d)
+{
+    JSNumberString *ns;
+    char buf[DTOSTR_BUFSIZE];
+    JSString *str;
+
+    ns = &cx->numberStrings[NUMBER_STRING_HASH(d)];
+    if (ns->string && ns->number == d)
+	return ns->string;
+    str = JS_NewStringCopyZ(cx, js_dtostr(cx, buf, d));
+    if (!str)
+	return NULL;
+    ns->number = d;
+    ns->string = str;
+    return str;
 }
 
 JSBool
@@ -424,6 +528,8 @@ js_ValueToNumber(JSContext *cx, jsval v, jsdouble *dp)
 	*dp = *JSVAL_TO_DOUBLE(v);
     } else if (JSVAL_IS_STRING(v)) {
 	str = JSVAL_TO_STRING(v);
+	if (!JSSTRING_FLATTEN(cx, str))
+	    return JS_FALSE;
 	errno = 0;
 	if (!js_strtod(str->chars, &ep, &d) || *ep != 0)
 	    goto badstr;
@@ -513,13 +619,22 @@ js_DoubleToInteger(jsdouble d)
     return neg ? -d : d;
 }
 
-/* XXXbe rewrite me! */
 JSBool
 js_strtod(const jschar *s, jschar **ep, jsdouble *dp)
 {
     size_t i, n;
     char *cstr, *estr;
     jsdouble d;
+    const jschar *cp;
+
+    if (js_FastStrtod(s, ep, dp)) {
+	/* Fail on non-Latin-1 chars anywhere, as the copying code does. */
+	for (cp = *ep; *cp != 0; cp++) {
+	    if (*cp >> 8)
+		return JS_FALSE;
+	}
+	return JS_TRUE;
+    }
 
     n = js_strlen(s);
     cstr = malloc(n + 1);
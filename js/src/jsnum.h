@@ -66,6 +66,24 @@ PR_BEGIN_EXTERN_C
 #define JSDOUBLE_IS_INT(d, i)	JSDOUBLE_IS_INT_2(d, i)
 #endif
 
+/*
+ * Each context caches the strings of the numbers it last converted, since
+ * scripts tend to convert the same few numbers over and over.  The strings
+ * are GC roots until replaced, see gc_mark_roots.
+ */
+#define NUMBER_STRING_CACHE_LOG2    6
+#define NUMBER_STRING_CACHE_SIZE    PR_BIT(NUMBER_STRING_CACHE_LOG2)
+#define NUMBER_STRING_GOLDEN_RATIO  0x9E3779B9U
+
+#define NUMBER_STRING_HASH(d)                                                 \
+    (((JSDOUBLE_HI32(d) ^ JSDOUBLE_LO32(d)) * NUMBER_STRING_GOLDEN_RATIO)     \
+     >> (32 - NUMBER_STRING_CACHE_LOG2))
+
+typedef struct JSNumberString {
+    jsdouble        number;
+    JSString        *string;
+} JSNumberString;
+
 /* Initialize the Number class, returning its prototype object. */
 extern JSObject *
 js_InitNumberClass(JSContext *cx, JSObject *obj);
@@ -91,6 +109,15 @@ js_NumberToObject(JSContext *cx, jsdouble d);
 extern JSString *
 js_NumberToString(JSContext *cx, jsdouble d);
 
+/*
+ * Format d as js_NumberToString does, into buf, which must have room for
+ * DTOSTR_BUFSIZE chars, and return buf.
+ */
+#define DTOSTR_BUFSIZE  32
+
+extern char *
+js_dtostr(JSContext *cx, char *buf, jsdouble d);
+
 /*
  * Convert a value to a number, returning false after reporting any error,
  * otherwise returning true with *dp set.
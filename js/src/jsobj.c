@@ -35,6 +35,7 @@
 #endif
 #include "prprf.h"
 #include "jsapi.h"
+#include "jsarray.h"
 #include "jsatom.h"
 #include "jsbool.h"
 #include "jscntxt.h"
@@ -127,6 +128,10 @@ obj_getCount(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 
     count = 0;
     JS_LOCK(cx);
+    if (OBJ_IS_DENSE_ARRAY(obj) && !js_MakeArraySlow(cx, obj)) {
+	JS_UNLOCK(cx);
+	return JS_FALSE;
+    }
     for (prop = obj->map->props; prop; prop = prop->next)
 	if (prop->flags & JSPROP_ENUMERATE)
 	    count++;
@@ -159,6 +164,8 @@ MarkSharpObjects(JSContext *cx, JSObject *obj)
     jsatomid sharpid;
     JSProperty *prop;
     jsval val;
+    JSArrayElements *elems;
+    jsuint i;
 
     map = &cx->sharpObjectMap;
     table = map->table;
@@ -179,6 +186,12 @@ MarkSharpObjects(JSContext *cx, JSObject *obj)
 	    if (JSVAL_IS_OBJECT(val) && val != JSVAL_NULL)
 		(void) MarkSharpObjects(cx, JSVAL_TO_OBJECT(val));
 	}
+	elems = OBJ_IS_DENSE_ARRAY(obj) ? ARRAY_ELEMENTS(obj) : NULL;
+	for (i = 0; elems && i < elems->capacity; i++) {
+	    val = elems->vector[i];
+	    if (JSVAL_IS_OBJECT(val) && val != JSVAL_NULL)
+		(void) MarkSharpObjects(cx, JSVAL_TO_OBJECT(val));
+	}
     } else {
 	sharpid = (jsatomid) he->value;
 	if (sharpid == 0) {
@@ -278,6 +291,10 @@ js_obj_toString(JSContext *cx, JSObject *obj, uintN argc, jsval *argv,
 
 	/* Early returns after this must unlock, or goto done with ok set. */
 	JS_LOCK(cx);
+	if (OBJ_IS_DENSE_ARRAY(obj) && !js_MakeArraySlow(cx, obj)) {
+	    JS_UNLOCK(cx);
+	    return JS_FALSE;
+	}
 	list = obj->map->props;
 
 #if JS_HAS_SHARP_VARS
@@ -466,6 +483,9 @@ obj_eval(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 	*rval = argv[0];
 	return JS_TRUE;
     }
+    str = JSVAL_TO_STRING(argv[0]);
+    if (!JSSTRING_FLATTEN(cx, str))
+	return JS_FALSE;
 
     fp = cx->fp;
     caller = fp->down;
@@ -496,7 +516,6 @@ obj_eval(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     obj = caller->scopeChain;
 #endif
 
-    str = JSVAL_TO_STRING(argv[0]);
     if (caller->script) {
 	file = caller->script->filename;
 	line = js_PCToLineNumber(caller->script, caller->pc);
@@ -554,7 +573,6 @@ obj_watch(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     JSFunction *fun;
     jsval userid, symid, propid, value;
     JSAtom *atom;
-    JSRuntime *rt;
     JSBool ok;
     JSProperty *prop;
     JSPropertyOp getter, setter;
@@ -569,8 +587,13 @@ obj_watch(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
      * Lock the world while we look in obj.  Be sure to return via goto out
      * on error, so we unlock.
      */
-    rt = cx->runtime;
-    JS_LOCK_RUNTIME(rt);
+    JS_LOCK(cx);
+
+    /* Dense array elements and length updates bypass watchpoints. */
+    if (OBJ_IS_DENSE_ARRAY(obj) && !js_MakeArraySlow(cx, obj)) {
+	ok = JS_FALSE;
+	goto out;
+    }
 
     /* Compute the unique int/atom symbol id needed by js_LookupProperty. */
     userid = argv[0];
@@ -620,7 +643,7 @@ obj_watch(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
     ok = JS_SetWatchPoint(cx, obj, userid, obj_watch_handler, fun->object);
 
 out:
-    JS_UNLOCK_RUNTIME(rt);
+    JS_UNLOCK(cx);
     return ok;
 }
 
@@ -875,6 +898,7 @@ js_SetSlot(JSContext *cx, JSObject *obj, uint32 slot, jsval value)
     }
     if (slot >= obj->map->freeslot)
 	obj->map->freeslot = slot + 1;
+    GC_WRITE_BARRIER(cx, obj, value);
     obj->slots[slot] = value;
     return JS_TRUE;
 }
@@ -907,14 +931,24 @@ js_AllocSlot(JSContext *cx, JSObject *obj, uint32 *slotp)
 	}
 #endif
 
+	/*
+	 * Other threads may load slots holding only obj's scope lock, so move
+	 * them under it, with no last-ditch GC on failure.
+	 */
+	JS_LOCK_OBJ(cx, obj);
 	if (obj->slots)
-	    newslots = JS_realloc(cx, obj->slots, nbytes);
+	    newslots = realloc(obj->slots, nbytes);
 	else
-	    newslots = JS_malloc(cx, nbytes);
-	if (!newslots)
+	    newslots = malloc(nbytes);
+	if (newslots) {
+	    obj->slots = newslots;
+	    map->nslots = nslots;
+	}
+	JS_UNLOCK_OBJ(cx, obj);
+	if (!newslots) {
+	    JS_ReportOutOfMemory(cx);
 	    return JS_FALSE;
-	obj->slots = newslots;
-	map->nslots = nslots;
+	}
     }
 
 #ifdef TOO_MUCH_GC
@@ -942,11 +976,13 @@ js_FreeSlot(JSContext *cx, JSObject *obj, uint32 slot)
 	nslots = map->freeslot;
 	nslots += nslots / 2;
 	nbytes = (size_t)nslots * sizeof(jsval);
-	newslots = JS_realloc(cx, obj->slots, nbytes);
-	if (!newslots)
-	    return;
-	obj->slots = newslots;
-	map->nslots = nslots;
+	JS_LOCK_OBJ(cx, obj);
+	newslots = realloc(obj->slots, nbytes);
+	if (newslots) {
+	    obj->slots = newslots;
+	    map->nslots = nslots;
+	}
+	JS_UNLOCK_OBJ(cx, obj);
     }
 }
 
@@ -997,6 +1033,12 @@ js_DefineProperty(JSContext *cx, JSObject *obj, jsval id, jsval value,
     /* Handle old bug that treated empty string as zero index. */
     CHECK_FOR_FUNNY_INDEX(id);
 
+    /* An index property can't coexist with dense array elements. */
+    if (JSVAL_IS_INT(id) && OBJ_IS_DENSE_ARRAY(obj) &&
+	!js_MakeArraySlow(cx, obj)) {
+	return NULL;
+    }
+
     /* Use the object's class getter and setter by default. */
     if (!getter)
 	getter = obj->map->clasp->getProperty;
@@ -1022,6 +1064,7 @@ js_DefineProperty(JSContext *cx, JSObject *obj, jsval id, jsval value,
     }
 
     PR_ASSERT(prop->slot < obj->map->freeslot);
+    GC_WRITE_BARRIER(cx, obj, value);
     obj->slots[prop->slot] = value;
     return prop;
 }
@@ -1047,6 +1090,12 @@ js_LookupProperty(JSContext *cx, JSObject *obj, jsval id, JSObject **objp,
     hash = js_HashValue(id);
     prevscope = NULL;
     do {
+	if (JSVAL_IS_INT(id) && OBJ_IS_DENSE_ARRAY(obj)) {
+	    /* Search obj's new index properties even if its scope is shared. */
+	    if (!js_MakeArraySlow(cx, obj))
+		return JS_FALSE;
+	    prevscope = NULL;
+	}
 	scope = (JSScope *)obj->map;
 	if (scope == prevscope)
 	    continue;
@@ -1195,7 +1244,7 @@ js_FindVariableScope(JSContext *cx, JSFunction **funp)
 	if (fp) {
 	    obj = js_GetCallObject(cx, fp, parent);
 	    if (withobj)
-		OBJ_SET_PARENT(withobj, obj);
+		OBJ_SET_PARENT(cx, withobj, obj);
 	}
     }
 #endif
@@ -1233,6 +1282,7 @@ js_GetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
     *vp = obj2->slots[slot];
     if (!prop->getter(cx, obj, prop->id, vp))
 	return NULL;
+    GC_WRITE_BARRIER(cx, obj2, *vp);
     obj2->slots[slot] = *vp;
     return prop;
 }
@@ -1266,6 +1316,12 @@ js_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
     /* Handle old bug that treated empty string as zero index. */
     CHECK_FOR_FUNNY_INDEX(id);
 
+    /* Dense elements are set by js_SetArrayElement; here obj goes sparse. */
+    if (JSVAL_IS_INT(id) && OBJ_IS_DENSE_ARRAY(obj) &&
+	!js_MakeArraySlow(cx, obj)) {
+	return NULL;
+    }
+
     hash = js_HashValue(id);
     sym = scope->ops->lookup(cx, scope, id, hash);
     if (sym) {
@@ -1288,6 +1344,10 @@ js_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 	proto = OBJ_GET_PROTO(obj);
 	protoProp = NULL;
 	while (proto) {
+	    if (JSVAL_IS_INT(id) && OBJ_IS_DENSE_ARRAY(proto) &&
+		!js_MakeArraySlow(cx, proto)) {
+		return NULL;
+	    }
 	    protoScope = (JSScope *)proto->map;
 	    protoSym = protoScope->ops->lookup(cx, protoScope, id, hash);
 	    if (protoSym) {
@@ -1323,7 +1383,7 @@ js_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 
 	if (sym) {
 	    /* Null-valued symbol left behind from a delete operation. */
-	    sym->entry.value = js_HoldProperty(cx, prop);
+	    sym->property = js_HoldProperty(cx, prop);
 	}
     }
 
@@ -1362,6 +1422,7 @@ js_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 		*vp = rval;
 		JS_SetErrorReporter(cx, older);
 		prop->flags |= JSPROP_ASSIGNHACK;
+		PROPERTY_CHANGED(cx, prop);
 		return prop;
 	    }
 	    JS_SetErrorReporter(cx, older);
@@ -1384,10 +1445,14 @@ js_SetProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
     if (!prop->setter(cx, obj, prop->id, vp))
 	return NULL;
     GC_POKE(cx, pval);
+    GC_WRITE_BARRIER(cx, obj, *vp);
     obj->slots[slot] = *vp;
 
     /* Setting a property makes it enumerable. */
-    prop->flags |= JSPROP_ENUMERATE;
+    if (!(prop->flags & JSPROP_ENUMERATE)) {
+	prop->flags |= JSPROP_ENUMERATE;
+	PROPERTY_CHANGED(cx, prop);
+    }
     return prop;
 }
 
@@ -1469,7 +1534,7 @@ js_DeleteProperty2(JSContext *cx, JSObject *obj, JSProperty *prop, jsval id,
 		 */
 		for (sym = prop->symbols; sym; sym = sym->next) {
 		    if (sym_id(sym) == id) {
-			sym->entry.value = NULL;
+			sym->property = NULL;
 			prop = js_DropProperty(cx, prop);
 			PR_ASSERT(prop);
 			return JS_TRUE;
@@ -1487,6 +1552,10 @@ js_DeleteProperty2(JSContext *cx, JSObject *obj, JSProperty *prop, jsval id,
     /* Search shared prototype scopes for an inherited property to hide. */
     hash = js_HashValue(id);
     do {
+	if (JSVAL_IS_INT(id) && OBJ_IS_DENSE_ARRAY(proto) &&
+	    !js_MakeArraySlow(cx, proto)) {
+	    return JS_FALSE;
+	}
 	scope = (JSScope *)proto->map;
 	sym = scope->ops->lookup(cx, scope, id, hash);
 	if (sym) {
@@ -1568,7 +1637,7 @@ out:
 JSString *
 js_ObjectToString(JSContext *cx, JSObject *obj)
 {
-    jsval v, *mark, *argv;
+    jsval v, *argv;
     JSString *str;
 
     if (!obj)
@@ -1577,24 +1646,32 @@ js_ObjectToString(JSContext *cx, JSObject *obj)
     if (!obj->map->clasp->convert(cx, obj, JSTYPE_STRING, &v))
 	return NULL;
     if (JSVAL_IS_STRING(v))
-	return JSVAL_TO_STRING(v);
+	goto flatten;
 
     /* Try the toString method if it's defined. */
     js_TryMethod(cx, obj, cx->runtime->atomState.toStringAtom, 0, NULL, &v);
     if (JSVAL_IS_STRING(v))
-	return JSVAL_TO_STRING(v);
+	goto flatten;
 #if JS_BUG_EAGER_TOSTRING
     js_TryValueOf(cx, obj, JSTYPE_STRING, &v);
     if (JSVAL_IS_STRING(v))
-	return JSVAL_TO_STRING(v);
+	goto flatten;
 #endif
-    mark = PR_ARENA_MARK(&cx->stackPool);
-    PR_ARENA_ALLOCATE(argv, &cx->stackPool, OBJ_TOSTRING_NARGS * sizeof(jsval));
-    if (!argv || !js_obj_toString(cx, obj, OBJ_TOSTRING_NARGS, argv, &v))
+    argv = js_AllocStack(cx, OBJ_TOSTRING_NARGS);
+    if (!argv)
+	return NULL;
+    if (!js_obj_toString(cx, obj, OBJ_TOSTRING_NARGS, argv, &v))
 	str = NULL;
     else
 	str = JSVAL_TO_STRING(v);
-    PR_ARENA_RELEASE(&cx->stackPool, mark);
+    cx->stackTop = argv;
+    return str;
+
+flatten:
+    /* A String object or a toString method may give us a rope. */
+    str = JSVAL_TO_STRING(v);
+    if (!JSSTRING_FLATTEN(cx, str))
+	return NULL;
     return str;
 }
 
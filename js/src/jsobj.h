@@ -60,7 +60,8 @@ struct JSObject {
 
 /*
  * Fast get and set macros for well-known slots.  These must be called within
- * JS_LOCK(cx) and JS_UNLOCK(cx).
+ * JS_LOCK(cx) and JS_UNLOCK(cx).  The setters take cx for the incremental GC
+ * write barrier in jsgc.h.
  */
 #ifdef DEBUG
 #define MAP_CHECK_SLOT(m,s) PR_ASSERT(s < PR_MAX((m)->nslots, (m)->freeslot))
@@ -69,11 +70,14 @@ struct JSObject {
 #define OBJ_CHECK_SLOT(o,s) ((void)0)
 #endif
 #define OBJ_GET_SLOT(o,s)   (OBJ_CHECK_SLOT(o,s), (o)->slots[s])
-#define OBJ_SET_SLOT(o,s,v) (OBJ_CHECK_SLOT(o,s), (o)->slots[s] = (v))
+#define OBJ_SET_SLOT(cx,o,s,v)                                                \
+    (OBJ_CHECK_SLOT(o,s), GC_WRITE_BARRIER(cx,o,v), (o)->slots[s] = (v))
 #define OBJ_GET_PROTO(o)    JSVAL_TO_OBJECT(OBJ_GET_SLOT(o,JSSLOT_PROTO))
-#define OBJ_SET_PROTO(o,p)  OBJ_SET_SLOT(o,JSSLOT_PROTO,OBJECT_TO_JSVAL(p))
+#define OBJ_SET_PROTO(cx,o,p)                                                 \
+    OBJ_SET_SLOT(cx,o,JSSLOT_PROTO,OBJECT_TO_JSVAL(p))
 #define OBJ_GET_PARENT(o)   JSVAL_TO_OBJECT(OBJ_GET_SLOT(o,JSSLOT_PARENT))
-#define OBJ_SET_PARENT(o,p) OBJ_SET_SLOT(o,JSSLOT_PARENT,OBJECT_TO_JSVAL(p))
+#define OBJ_SET_PARENT(cx,o,p)                                                \
+    OBJ_SET_SLOT(cx,o,JSSLOT_PARENT,OBJECT_TO_JSVAL(p))
 
 extern JSClass js_ObjectClass;
 extern JSClass js_WithClass;
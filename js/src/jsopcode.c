@@ -31,7 +31,6 @@
 #include "plarena.h"
 #endif
 #include "prlog.h"
-#include "prdtoa.h"
 #include "prprf.h"
 #include "jsapi.h"
 #include "jsarray.h"
@@ -42,8 +41,10 @@
 #include "jsemit.h"
 #include "jsfun.h"
 #include "jslock.h"
+#include "jsnum.h"
 #include "jsobj.h"
 #include "jsopcode.h"
+#include "jsparse.h"
 #include "jsscope.h"
 #include "jsscript.h"
 #include "jsstr.h"
@@ -370,6 +371,8 @@ js_EscapeString(JSContext *cx, JSString *str, jschar quote)
     char *bytes;
     JSString *escstr;
 
+    if (!JSSTRING_FLATTEN(cx, str))
+	return NULL;
     mark = PR_ARENA_MARK(&cx->tempPool);
     INIT_SPRINTER(cx, &sprinter, &cx->tempPool, 0);
     bytes = EscapeString(&sprinter, str, quote);
@@ -1358,8 +1361,8 @@ Decompile(SprintStack *ss, jsbytecode *pc, intN nb)
 		    long ival = (long)JSVAL_TO_INT(key);
 		    todo = Sprint(&ss->sprinter, "%ld", ival);
 		} else if (JSVAL_IS_DOUBLE(key)) {
-		    char buf[32];
-		    PR_cnvtf(buf, sizeof buf, 20, *JSVAL_TO_DOUBLE(key));
+		    char buf[DTOSTR_BUFSIZE];
+		    js_dtostr(cx, buf, *JSVAL_TO_DOUBLE(key));
 		    todo = Sprint(&ss->sprinter, buf);
 		} else if (JSVAL_IS_STRING(key)) {
 		    rval = EscapeString(&ss->sprinter, ATOM_TO_STRING(atom),
@@ -1413,7 +1416,8 @@ Decompile(SprintStack *ss, jsbytecode *pc, intN nb)
 			}
 		    }
 		}
-		js_qsort(table, (size_t)j, sizeof *table, CompareOffsets, NULL);
+		js_MergeSort(table, (size_t)j, sizeof *table, CompareOffsets,
+			     NULL);
 
 		ok = DecompileSwitch(ss, table, (uintN)j, pc, len, off);
 		JS_free(cx, table);
@@ -1704,6 +1708,8 @@ js_DecompileFunction(JSPrinter *jp, JSFunction *fun, JSBool newlines)
     uintN indent;
 
     PR_ASSERT(JS_IS_LOCKED(jp->sprinter.context));
+    if (!JSFUN_COMPILE(jp->sprinter.context, fun))
+	return JS_FALSE;
     if (newlines) {
 	js_puts(jp, "\n");
 	js_printf(jp, "\t");
@@ -1758,7 +1764,7 @@ js_ValueToSource(JSContext *cx, jsval v)
 
     /* Don't look on the stack for element ops, the index will throw us. */
     if (mode != JOF_ELEM) {
-	limit = (jsval *)cx->stackPool.current->avail;
+	limit = cx->stackTop;
 	depth = (intN)script->depth;
 	if (fp->sp < limit && fp->sp[0] == v)
 	    pc = (jsbytecode *)fp->sp[0 - depth];
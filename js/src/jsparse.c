@@ -176,26 +176,93 @@ js_Parse(JSContext *cx, JSObject *chain, JSTokenStream *ts, JSCodeGenerator *cg)
     return ok;
 }
 
+JSBool
+js_CompileLazyFunction(JSContext *cx, JSFunction *fun)
+{
+    JSLazyFunction *lazy;
+    void *mark, *codemark;
+    jschar *chars;
+    size_t i;
+    JSVersion version;
+    JSTokenStream *ts;
+    JSBool ok;
+
+    JS_LOCK(cx);
+    lazy = fun->lazy;
+    if (!lazy) {
+	/* Another thread compiled fun while this one waited for the lock. */
+	JS_UNLOCK(cx);
+	return JS_TRUE;
+    }
+
+    mark = PR_ARENA_MARK(&cx->tempPool);
+    if (lazy->wide) {
+	chars = lazy->chars;
+    } else {
+	PR_ARENA_ALLOCATE(chars, &cx->tempPool,
+			  (lazy->length + 1) * sizeof(jschar));
+	if (!chars) {
+	    JS_ReportOutOfMemory(cx);
+	    ok = JS_FALSE;
+	    goto out;
+	}
+	for (i = 0; i < lazy->length; i++)
+	    chars[i] = (jschar) ((unsigned char *)lazy->chars)[i];
+    }
+
+    version = cx->version;
+    if (lazy->version != version)
+	JS_SetVersion(cx, lazy->version);
+    ts = js_NewTokenStream(cx, chars, lazy->length, lazy->filename,
+			   lazy->lineno, lazy->principals);
+    if (!ts) {
+	ok = JS_FALSE;
+    } else {
+	codemark = PR_ARENA_MARK(&cx->codePool);
+	ok = js_ParseFunctionBody(cx, ts, fun, lazy->args);
+	PR_ARENA_RELEASE(&cx->codePool, codemark);
+	(void) js_CloseTokenStream(cx, ts);
+    }
+    if (lazy->version != version)
+	JS_SetVersion(cx, version);
+
+    /* On error keep lazy, so that the next call reports the error again. */
+    if (ok) {
+	fun->script->depth += fun->nvars;
+	fun->lazy = NULL;
+	js_DestroyLazyFunction(cx, lazy);
+    }
+
+out:
+    PR_ARENA_RELEASE(&cx->tempPool, mark);
+    JS_UNLOCK(cx);
+    return ok;
+}
+
+void
+js_DestroyLazyFunction(JSContext *cx, JSLazyFunction *lazy)
+{
+    JS_free(cx, lazy->chars);
+    if (lazy->filename)
+	JS_free(cx, lazy->filename);
+    if (lazy->principals)
+	JSPRINCIPALS_DROP(cx, lazy->principals);
+    JS_free(cx, lazy);
+}
+
 /*
- * Parse a JS function body, which might appear as the value of an event
- * handler attribute in a HTML <INPUT> tag.
+ * Parse the body of fun up to its closing brace, generating code into funcg
+ * with fun->object as the variable object.
  */
-JSBool
-js_ParseFunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun,
-		     JSSymbol *args)
+static JSBool
+FunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun,
+	     JSCodeGenerator *funcg)
 {
-    uintN lineno, oldflags;
-    JSCodeGenerator funcg;
     JSStackFrame *fp, frame;
+    uintN oldflags;
     JSBool ok;
     jsbytecode *pc;
 
-    PR_ASSERT(JS_IS_LOCKED(cx));
-
-    lineno = ts->lineno;
-    if (!js_InitCodeGenerator(cx, &funcg, &cx->codePool))
-	return JS_FALSE;
-
     fp = cx->fp;
     if (!fp || fp->scopeChain != fun->object) {
 	memset(&frame, 0, sizeof frame);
@@ -207,11 +274,11 @@ js_ParseFunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun,
     oldflags = ts->flags;
     ts->flags &= ~(TSF_RETURN_EXPR | TSF_RETURN_VOID);
     ts->flags |= TSF_FUNCTION;
-    ok = Statements(cx, ts, &funcg);
+    ok = Statements(cx, ts, funcg);
 
     /* Check for falling off the end of a function that returns a value. */
     if (ok && (ts->flags & TSF_RETURN_EXPR)) {
-	for (pc = CG_CODE(&funcg,funcg.lastCodeOffset);
+	for (pc = CG_CODE(funcg,funcg->lastCodeOffset);
 	     *pc == JSOP_NOP || *pc == JSOP_LEAVEWITH;
 	     pc--) {
 	    /* nothing */;
@@ -222,9 +289,140 @@ js_ParseFunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun,
 	    ok = JS_FALSE;
 	}
     }
-    ts->flags = oldflags;
+
+    /* Keep a capture failure in the body for js_StopCapture to report. */
+    ts->flags = oldflags | (ts->flags & TSF_CAPTURE_OOM);
     cx->fp = fp;
+    return ok;
+}
+
+/*
+ * Parse the body of fun into a code generator whose code is thrown away, so
+ * that its syntax errors are reported now even though it is compiled later.
+ */
+static JSBool
+CheckFunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun)
+{
+    void *mark;
+    JSCodeGenerator funcg;
+    JSBool ok;
+
+    mark = PR_ARENA_MARK(&cx->codePool);
+    if (!js_InitCodeGenerator(cx, &funcg, &cx->codePool))
+	return JS_FALSE;
+    ok = FunctionBody(cx, ts, fun, &funcg);
+    if (ok)
+	ok = js_FlushNewlines(cx, ts, &funcg);
+    if (!ok)
+	CLEAR_PUSHBACK(ts);
+    js_DropUnmappedAtoms(cx, &funcg.atomList);
+    PR_ARENA_RELEASE(&cx->codePool, mark);
+    return ok;
+}
 
+/*
+ * Check the body of fun, from after its { through its }, and save the source
+ * between the braces in fun->lazy for js_CompileLazyFunction.  The check is
+ * made on a scratch function, so that the body's variables and functions are
+ * not defined on fun until it is compiled.
+ */
+static JSBool
+SaveFunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun,
+		 JSSymbol *args)
+{
+    uintN lineno;
+    JSFunction *scratch;
+    JSBool ok;
+    jschar *chars;
+    size_t length, i;
+    JSLazyFunction *lazy;
+    unsigned char *bytes;
+
+    lineno = ts->lineno;
+    scratch = js_NewFunction(cx, NULL, 0, 0, OBJ_GET_PARENT(fun->object),
+			     NULL);
+    if (!scratch)
+	return JS_FALSE;
+    js_StartCapture(ts);
+    ok = CheckFunctionBody(cx, ts, scratch);
+    if (ok && js_GetToken(cx, ts, NULL) != TOK_RC) {
+	js_ReportCompileError(cx, ts, "missing } after function body");
+	ok = JS_FALSE;
+    }
+    chars = js_StopCapture(cx, ts, &length);
+    if (!chars)
+	return JS_FALSE;
+    if (!ok)
+	goto bad;
+
+    /* Leave out the closing brace. */
+    PR_ASSERT(length != 0 && chars[length-1] == '}');
+    length--;
+
+    lazy = JS_malloc(cx, sizeof *lazy);
+    if (!lazy)
+	goto bad;
+    lazy->chars = chars;
+    lazy->length = length;
+    lazy->wide = JS_FALSE;
+    for (i = 0; i < length; i++) {
+	if (chars[i] > 0xff) {
+	    lazy->wide = JS_TRUE;
+	    break;
+	}
+    }
+    if (!lazy->wide) {
+	/* Most source is Latin-1: keep it at half the size. */
+	bytes = JS_malloc(cx, length + 1);
+	if (!bytes) {
+	    JS_free(cx, lazy);
+	    goto bad;
+	}
+	for (i = 0; i < length; i++)
+	    bytes[i] = (unsigned char) chars[i];
+	JS_free(cx, chars);
+	lazy->chars = bytes;
+    }
+    lazy->filename = NULL;
+    if (ts->filename) {
+	lazy->filename = JS_strdup(cx, ts->filename);
+	if (!lazy->filename) {
+	    js_DestroyLazyFunction(cx, lazy);
+	    return JS_FALSE;
+	}
+    }
+    lazy->lineno = lineno;
+    if (ts->principals)
+	JSPRINCIPALS_HOLD(cx, ts->principals);
+    lazy->principals = ts->principals;
+    lazy->version = cx->version;
+    lazy->args = args;
+    fun->lazy = lazy;
+    return JS_TRUE;
+
+bad:
+    JS_free(cx, chars);
+    return JS_FALSE;
+}
+
+/*
+ * Parse a JS function body, which might appear as the value of an event
+ * handler attribute in a HTML <INPUT> tag.
+ */
+JSBool
+js_ParseFunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun,
+		     JSSymbol *args)
+{
+    uintN lineno;
+    JSCodeGenerator funcg;
+    JSBool ok;
+
+    PR_ASSERT(JS_IS_LOCKED(cx));
+
+    lineno = ts->lineno;
+    if (!js_InitCodeGenerator(cx, &funcg, &cx->codePool))
+	return JS_FALSE;
+    ok = FunctionBody(cx, ts, fun, &funcg);
     if (ok)
 	ok = js_FlushNewlines(cx, ts, &funcg);
     if (!ok) {
@@ -261,7 +459,7 @@ FunctionDef(JSContext *cx, JSTokenStream *ts, JSCodeGenerator *cg, JSBool expr)
     JSAtom *funAtom, *argAtom;
     JSObject *parent;
     JSFunction *fun, *outerFun;
-    JSBool ok, named;
+    JSBool lazy, ok, named;
     JSSymbol *arg, *args, **argp;
     JSObject *pobj;
     JSProperty *prop;
@@ -269,9 +467,17 @@ FunctionDef(JSContext *cx, JSTokenStream *ts, JSCodeGenerator *cg, JSBool expr)
     jsval junk;
     uint32 i;
 
-    /* Save atoms indexed but not mapped for the top-level script. */
-    if (!js_InitAtomMap(cx, &map, &cg->atomList))
+    /*
+     * Save atoms indexed but not mapped for the top-level script, unless the
+     * body will not be compiled now and so cannot reindex them.
+     */
+    lazy = cx->lazyCompile;
+    if (lazy) {
+	map.vector = NULL;
+	map.length = 0;
+    } else if (!js_InitAtomMap(cx, &map, &cg->atomList)) {
 	return JS_FALSE;
+    }
 
     if (js_MatchToken(cx, ts, cg, TOK_NAME))
 	funAtom = js_HoldAtom(cx, ts->token.u.atom);
@@ -329,6 +535,7 @@ FunctionDef(JSContext *cx, JSTokenStream *ts, JSCodeGenerator *cg, JSBool expr)
 		prop->getter = js_GetArgument;
 		prop->setter = js_SetArgument;
 		prop->flags |= JSPROP_ENUMERATE | JSPROP_PERMANENT;
+		PROPERTY_CHANGED(cx, prop);
 	    } else {
 		prop = js_DefineProperty(cx, fun->object,
 					 (jsval)argAtom, JSVAL_VOID,
@@ -353,18 +560,31 @@ FunctionDef(JSContext *cx, JSTokenStream *ts, JSCodeGenerator *cg, JSBool expr)
 
     MUST_MATCH_TOKEN_THROW(TOK_LC, "missing { before function body",
 			   ok = JS_FALSE; goto out);
-    mark = PR_ARENA_MARK(&cx->codePool);
-    ok = js_ParseFunctionBody(cx, ts, fun, args);
-    if (ok) {
-	MUST_MATCH_TOKEN_THROW(TOK_RC, "missing } after function body",
-			       ok = JS_FALSE; goto out);
-	fun->script->depth += fun->nvars;
+    if (lazy && (ts->flags & TSF_CAPTURE)) {
+	/* In a body being saved, whose functions are thrown away: check. */
+	ok = CheckFunctionBody(cx, ts, fun);
+	if (ok) {
+	    MUST_MATCH_TOKEN_THROW(TOK_RC, "missing } after function body",
+				   ok = JS_FALSE; goto out);
+	}
+    } else if (lazy) {
+	ok = SaveFunctionBody(cx, ts, fun, args);
+    } else {
+	mark = PR_ARENA_MARK(&cx->codePool);
+	ok = js_ParseFunctionBody(cx, ts, fun, args);
+	if (ok) {
+	    MUST_MATCH_TOKEN_THROW(TOK_RC, "missing } after function body",
+				   ok = JS_FALSE; goto out);
+	    fun->script->depth += fun->nvars;
+	}
+	PR_ARENA_RELEASE(&cx->codePool, mark);
+    }
 
-	/* Generate a setline note for script that follows this function. */
-	if (js_NewSrcNote2(cx, cg, SRC_SETLINE, (ptrdiff_t)TRUE_LINENO(ts)) < 0)
-	    ok = JS_FALSE;
+    /* Generate a setline note for script that follows this function. */
+    if (ok &&
+	js_NewSrcNote2(cx, cg, SRC_SETLINE, (ptrdiff_t)TRUE_LINENO(ts)) < 0) {
+	ok = JS_FALSE;
     }
-    PR_ARENA_RELEASE(&cx->codePool, mark);
 
 out:
     if (!ok && named)
@@ -397,6 +617,17 @@ out:
 	}
     }
 #endif
+
+    /*
+     * Map a function defined on parent even if no op refers to it, so that
+     * decoding an encoded script can define it again (see jsxdrapi.c).
+     */
+    if (ok && named) {
+	funAtom = js_AtomizeObject(cx, fun->object, ATOM_NOHOLD);
+	if (!funAtom)
+	    return JS_FALSE;
+	(void) js_IndexAtom(cx, funAtom, &cg->atomList);
+    }
     return ok;
 }
 
@@ -1490,6 +1721,7 @@ Variables(JSContext *cx, JSTokenStream *ts, JSCodeGenerator *cg)
 		prop->setter = setter;
 		prop->flags |= JSPROP_ENUMERATE | JSPROP_PERMANENT;
 		prop->flags &= ~JSPROP_READONLY;
+		PROPERTY_CHANGED(cx, prop);
 	    }
 	} else {
 	    prop = js_DefineProperty(cx, obj, (jsval)atom, JSVAL_VOID,
@@ -34,6 +34,34 @@ extern JSBool
 js_ParseFunctionBody(JSContext *cx, JSTokenStream *ts, JSFunction *fun,
 		     JSSymbol *args);
 
+/*
+ * A function defined while cx->lazyCompile is set has its body parsed only
+ * to report its errors: fun->script stays null and fun->lazy holds the body's
+ * source until something needs the script.  Callers that use fun->script must
+ * first compile it with JSFUN_COMPILE, which can still fail, e.g. for lack of
+ * memory.
+ */
+struct JSLazyFunction {
+    void            *chars;         /* body between { and }, as bytes if
+                                       every char fits in one, else jschars */
+    size_t          length;         /* length of chars in chars */
+    JSBool          wide;           /* chars are jschars */
+    char            *filename;      /* source file for diagnostics, or null */
+    uintN           lineno;         /* line number of the char after { */
+    JSPrincipals    *principals;    /* principals of the defining script */
+    JSVersion       version;        /* cx->version when fun was defined */
+    JSSymbol        *args;          /* formal arguments, for fun->script */
+};
+
+#define JSFUN_COMPILE(cx,fun)   (!(fun)->lazy ||                              \
+				 js_CompileLazyFunction(cx, fun))
+
+extern JSBool
+js_CompileLazyFunction(JSContext *cx, JSFunction *fun);
+
+extern void
+js_DestroyLazyFunction(JSContext *cx, JSLazyFunction *lazy);
+
 PR_END_EXTERN_C
 
 #endif /* jsparse_h___ */
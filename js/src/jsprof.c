@@ -0,0 +1,951 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+ * JS script profiler, built on the debugger API's interrupt, call and
+ * destroy-script hooks.
+ *
+ * Sampling mode starts a thread that sets a one-shot interrupt hook every
+ * interval.  The interpreter calls the hook before its next op (native code
+ * exits to the interpreter at its next backward branch), and the hook walks
+ * the frame chain, counting a sample against the innermost function as self
+ * time, against every function on the chain as total time, and against the
+ * path from the outermost frame as a call tree node.  Between samples the
+ * interpreter and native code run at full speed.  Time spent in a native
+ * that doesn't call back into script is charged to the op after the call.
+ *
+ * Counting mode sets the interrupt hook for good, so every op is counted,
+ * and a call hook that counts and times every call.  The hooks keep the
+ * interpreter out of native code and superinstructions, and times include
+ * the hooks' own cost, so they are only good relative to one another.
+ *
+ * A profile entry describes a function or top-level script, copying its
+ * name, location, bytecode and line table when first seen so that it can be
+ * dumped after the script is gone.  Entries are found by script, or by
+ * native for native functions, in a table whose keys are removed when their
+ * scripts are destroyed so that a new script at the same address can't be
+ * mistaken for an old one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prtypes.h"
+#include "prlog.h"
+#include "prlong.h"
+#include "prmjtime.h"
+#include "prclist.h"
+#include "prthread.h"
+#ifdef JS_THREADSAFE
+#include "prlock.h"
+#endif
+#ifndef NSPR20
+#include "prhash.h"
+#else
+#include "plhash.h"
+#endif
+#include "jsapi.h"
+#include "jsatom.h"
+#include "jscntxt.h"
+#include "jsdbgapi.h"
+#include "jsemit.h"
+#include "jsfun.h"
+#include "jsopcode.h"
+#include "jsscript.h"
+#include "jsstr.h"
+
+#define PROF_DEFAULT_INTERVAL   1000    /* microseconds between samples */
+#define PROF_MAX_DEPTH          256     /* deeper frames are not sampled */
+#define PROF_TABLE_SIZE         64      /* initial entry table size */
+#define PROF_HOT_OPS            20      /* number of hottest ops dumped */
+#define PROF_TREE_CUTOFF        1000    /* omit nodes under 1/1000 of all */
+
+typedef struct JSProfEntry JSProfEntry;
+typedef struct JSProfNode JSProfNode;
+typedef struct JSProfCall JSProfCall;
+typedef struct JSProfile JSProfile;
+
+struct JSProfEntry {
+    JSProfEntry     *next;          /* next entry in order of first sight */
+    const void      *key;           /* script or native, null once gone */
+    char            *name;          /* function name or "(top level)" */
+    char            *filename;      /* script filename or null */
+    uintN           lineno;         /* first line of script */
+    uint32          self;           /* samples with this innermost */
+    uint32          total;          /* samples with this on the chain */
+    uint32          lastSample;     /* sample that last counted total */
+    uint32          calls;          /* calls counted */
+    uintN           active;         /* calls counted but not returned */
+    int64           selfTime;       /* microseconds less callees' */
+    int64           totalTime;      /* microseconds in outermost calls */
+    uint32          length;         /* bytecode length, 0 for a native */
+    uint32          *counts;        /* samples or executions per pc */
+    uint32          *lines;         /* line number of each pc */
+    jsbytecode      *code;          /* copy of the script's bytecode */
+};
+
+struct JSProfNode {
+    JSProfEntry     *entry;         /* function called, null at the root */
+    JSProfNode      *kids;          /* functions called from this path */
+    JSProfNode      *next;          /* next sibling */
+    uint32          self;           /* samples ending at this node */
+    uint32          total;          /* samples through this node */
+    uint32          calls;          /* calls counted down this path */
+    int64           time;           /* microseconds in those calls */
+};
+
+struct JSProfCall {
+    PRCList         links;          /* in JSProfile.calls, innermost last */
+    JSContext       *cx;            /* context making the call */
+    JSProfEntry     *entry;         /* callee, null if profile reset */
+    JSProfNode      *node;          /* call tree node for this call */
+    JSProfCall      *caller;        /* innermost call in cx when made */
+    int64           start;          /* when the call was made */
+    int64           childTime;      /* microseconds spent in callees */
+};
+
+struct JSProfile {
+    JSRuntime       *runtime;
+    JSProfileMode   mode;
+    JSBool          running;
+    uint32          interval;       /* microseconds between samples */
+    PRThread        *sampler;       /* thread setting the interrupt hook */
+    JSBool          stopSampler;    /* tells sampler to exit */
+    uint32          samples;        /* samples taken */
+    uint32          missed;         /* intervals with the hook still set */
+    uint32          ops;            /* ops counted */
+    int64           startTime;
+    int64           elapsed;        /* microseconds profiled, once stopped */
+    PRHashTable     *table;         /* entry by key, while running */
+    JSProfEntry     *entries;       /* all entries in order of first sight */
+    JSProfEntry     **entryTail;
+    uint32          nentries;
+    JSProfNode      root;           /* call tree root */
+    PRCList         calls;          /* calls in progress, see JSProfCall */
+    JSProfCall      *freeCalls;     /* recycled JSProfCall records */
+    JSScript        *lastScript;    /* counting mode's one-entry cache */
+    JSProfEntry     *lastEntry;
+    JSDestroyScriptHookProc oldDestroyHook;
+    void            *oldDestroyHookData;
+#ifdef JS_THREADSAFE
+    PRLock          *lock;
+#endif
+};
+
+#ifdef JS_THREADSAFE
+#define PROF_LOCK(prof)         PR_Lock((prof)->lock)
+#define PROF_UNLOCK(prof)       PR_Unlock((prof)->lock)
+#else
+#define PROF_LOCK(prof)         ((void)0)
+#define PROF_UNLOCK(prof)       ((void)0)
+#endif
+
+static PRHashNumber
+prof_hash_key(const void *key)
+{
+    return (PRHashNumber)((prword)key >> 2);
+}
+
+static char *
+prof_strdup(const char *s)
+{
+    char *t;
+
+    t = malloc(strlen(s) + 1);
+    if (t)
+	strcpy(t, s);
+    return t;
+}
+
+/*
+ * Copy fun's name, chopping its chars to bytes without JS_GetFunctionName's
+ * deflated string cache entry, which would outlive the profile.
+ */
+static char *
+prof_function_name(JSFunction *fun)
+{
+    JSString *str;
+    char *name;
+    size_t i;
+
+    if (!fun->atom)
+	return prof_strdup(js_anonymous_str);
+    str = ATOM_TO_STRING(fun->atom);
+    name = malloc(str->length + 1);
+    if (!name)
+	return NULL;
+    for (i = 0; i < str->length; i++)
+	name[i] = (char) str->chars[i];
+    name[i] = 0;
+    return name;
+}
+
+/*
+ * Fill lines with the line number of each pc in script, walking its source
+ * notes once as js_PCToLineNumber would for every pc.
+ */
+static void
+prof_fill_lines(JSScript *script, uint32 *lines)
+{
+    jssrcnote *sn;
+    uint32 i, lineno;
+    ptrdiff_t offset;
+    JSSrcNoteType type;
+
+    i = 0;
+    lineno = script->lineno;
+    sn = script->notes;
+    if (sn) {
+	for (offset = 0; !SN_IS_TERMINATOR(sn); sn = SN_NEXT(sn)) {
+	    offset += SN_DELTA(sn);
+	    while (i < script->length && (ptrdiff_t)i < offset)
+		lines[i++] = lineno;
+	    type = SN_TYPE(sn);
+	    if (type == SRC_SETLINE)
+		lineno = (uint32) js_GetSrcNoteOffset(sn, 0);
+	    else if (type == SRC_NEWLINE)
+		lineno++;
+	}
+    }
+    while (i < script->length)
+	lines[i++] = lineno;
+}
+
+static void
+prof_destroy_entry(JSProfEntry *entry)
+{
+    free(entry->name);
+    if (entry->filename)
+	free(entry->filename);
+    if (entry->counts)
+	free(entry->counts);
+    free(entry);
+}
+
+/*
+ * Find or make the entry for the function or script running in a frame that
+ * has the given script, or else fun, which must then be native.  Return null
+ * for a frame with neither, when the profile has stopped, or when out of
+ * memory, in which case the frame simply isn't profiled.
+ */
+static JSProfEntry *
+prof_get_entry(JSProfile *prof, JSScript *script, JSFunction *fun)
+{
+    const void *key;
+    PRHashNumber keyHash;
+    PRHashEntry **hep;
+    JSProfEntry *entry;
+    size_t length;
+
+    if (script)
+	key = script;
+    else if (fun && fun->call)
+	key = (const void *)fun->call;
+    else
+	return NULL;
+    if (!prof->table)
+	return NULL;
+    keyHash = prof_hash_key(key);
+    hep = PR_HashTableRawLookup(prof->table, keyHash, key);
+    if (*hep)
+	return (*hep)->value;
+
+    entry = calloc(1, sizeof *entry);
+    if (!entry)
+	return NULL;
+    entry->name = fun ? prof_function_name(fun) : prof_strdup("(top level)");
+    if (!entry->name)
+	goto bad;
+    if (script) {
+	if (script->filename) {
+	    entry->filename = prof_strdup(script->filename);
+	    if (!entry->filename)
+		goto bad;
+	}
+	entry->lineno = script->lineno;
+	length = script->length;
+	entry->counts = calloc(length ? length : 1, 2 * sizeof(uint32) + 1);
+	if (!entry->counts)
+	    goto bad;
+	entry->lines = entry->counts + length;
+	entry->code = (jsbytecode *)(entry->lines + length);
+	entry->length = (uint32)length;
+	prof_fill_lines(script, entry->lines);
+	memcpy(entry->code, script->code, length);
+    }
+    if (!PR_HashTableRawAdd(prof->table, hep, keyHash, key, entry))
+	goto bad;
+    entry->key = key;
+    *prof->entryTail = entry;
+    prof->entryTail = &entry->next;
+    prof->nentries++;
+    return entry;
+
+  bad:
+    prof_destroy_entry(entry);
+    return NULL;
+}
+
+/* Find or make the child of node for calls of entry. */
+static JSProfNode *
+prof_get_node(JSProfNode *node, JSProfEntry *entry)
+{
+    JSProfNode *kid;
+
+    for (kid = node->kids; kid; kid = kid->next) {
+	if (kid->entry == entry)
+	    return kid;
+    }
+    kid = calloc(1, sizeof *kid);
+    if (!kid)
+	return NULL;
+    kid->entry = entry;
+    kid->next = node->kids;
+    node->kids = kid;
+    return kid;
+}
+
+static void
+prof_destroy_kids(JSProfNode *node)
+{
+    JSProfNode *kid, *next;
+
+    for (kid = node->kids; kid; kid = next) {
+	next = kid->next;
+	prof_destroy_kids(kid);
+	free(kid);
+    }
+    node->kids = NULL;
+}
+
+/*
+ * Take a sample, called by the interpreter when the sampler thread has set
+ * the interrupt hook.  Clear the hook first so a slow sample can't miss the
+ * next interval's.
+ */
+static JSTrapStatus
+prof_sample(JSContext *cx, JSScript *script, jsbytecode *pc, jsval *rval,
+	    void *closure)
+{
+    JSProfile *prof;
+    JSStackFrame *fp, *iter;
+    JSProfEntry *stack[PROF_MAX_DEPTH], *entry;
+    JSProfNode *node;
+    uintN n, i;
+    uint32 serial;
+
+    prof = cx->runtime->profile;
+    JS_ClearInterrupt(cx->runtime, NULL, NULL);
+    PROF_LOCK(prof);
+    n = 0;
+    iter = NULL;
+    while (n < PROF_MAX_DEPTH &&
+	   (fp = JS_FrameIterator(cx, &iter)) != NULL) {
+	entry = prof_get_entry(prof, JS_GetFrameScript(cx, fp),
+			       JS_GetFrameFunction(cx, fp));
+	if (entry)
+	    stack[n++] = entry;
+    }
+    if (n == 0)
+	goto out;
+
+    serial = ++prof->samples;
+    entry = stack[0];
+    entry->self++;
+    if (entry->key == script && (uint32)(pc - script->code) < entry->length)
+	entry->counts[pc - script->code]++;
+    node = &prof->root;
+    node->total++;
+    for (i = n; i > 0; i--) {
+	entry = stack[i - 1];
+	if (entry->lastSample != serial) {
+	    entry->lastSample = serial;
+	    entry->total++;
+	}
+	if (node) {
+	    node = prof_get_node(node, entry);
+	    if (node)
+		node->total++;
+	}
+    }
+    if (node)
+	node->self++;
+
+  out:
+    PROF_UNLOCK(prof);
+    return JSTRAP_CONTINUE;
+}
+
+/* Count an op, called by the interpreter before every op in counting mode. */
+static JSTrapStatus
+prof_count(JSContext *cx, JSScript *script, jsbytecode *pc, jsval *rval,
+	   void *closure)
+{
+    JSProfile *prof;
+    JSProfEntry *entry;
+
+    prof = cx->runtime->profile;
+    PROF_LOCK(prof);
+    if (script == prof->lastScript) {
+	entry = prof->lastEntry;
+    } else {
+	entry = prof_get_entry(prof, script, JS_GetFrameFunction(cx, cx->fp));
+	if (entry) {
+	    prof->lastScript = script;
+	    prof->lastEntry = entry;
+	}
+    }
+    if (entry && (uint32)(pc - script->code) < entry->length) {
+	entry->counts[pc - script->code]++;
+	prof->ops++;
+    }
+    PROF_UNLOCK(prof);
+    return JSTRAP_CONTINUE;
+}
+
+/*
+ * Count and time a call in counting mode.  Calls in progress are recorded
+ * innermost last, so the caller of a call is the innermost one on the same
+ * context.  A record outlives a profile reset, losing its entry, because
+ * js_DoCall passes it back however long the call takes.
+ */
+static void *
+prof_call(JSContext *cx, JSStackFrame *fp, JSBool before, JSBool *ok,
+	  void *closure)
+{
+    JSProfile *prof;
+    JSProfCall *call, *caller;
+    JSProfEntry *entry;
+    JSProfNode *node;
+    PRCList *link;
+    int64 now, elapsed;
+
+    prof = cx->runtime->profile;
+    now = PRMJ_Now();
+    PROF_LOCK(prof);
+    if (before) {
+	call = NULL;
+	entry = prof_get_entry(prof, JS_GetFrameScript(cx, fp),
+			       JS_GetFrameFunction(cx, fp));
+	if (!entry)
+	    goto out;
+	caller = NULL;
+	for (link = PR_LIST_TAIL(&prof->calls); link != &prof->calls;
+	     link = link->prev) {
+	    if (((JSProfCall *)link)->cx == cx) {
+		caller = (JSProfCall *)link;
+		break;
+	    }
+	}
+	node = prof_get_node((caller && caller->entry)
+			     ? caller->node
+			     : &prof->root,
+			     entry);
+	if (!node)
+	    goto out;
+	call = prof->freeCalls;
+	if (call) {
+	    prof->freeCalls = (JSProfCall *)call->links.next;
+	} else {
+	    call = malloc(sizeof *call);
+	    if (!call)
+		goto out;
+	}
+	call->cx = cx;
+	call->entry = entry;
+	call->node = node;
+	call->caller = caller;
+	call->start = now;
+	LL_I2L(call->childTime, 0);
+	PR_APPEND_LINK(&call->links, &prof->calls);
+	entry->calls++;
+	entry->active++;
+	node->calls++;
+    } else {
+	call = closure;
+	if (!call)
+	    goto out;
+	entry = call->entry;
+	if (entry) {
+	    LL_SUB(elapsed, now, call->start);
+	    if (--entry->active == 0)
+		LL_ADD(entry->totalTime, entry->totalTime, elapsed);
+	    LL_ADD(entry->selfTime, entry->selfTime, elapsed);
+	    LL_SUB(entry->selfTime, entry->selfTime, call->childTime);
+	    LL_ADD(call->node->time, call->node->time, elapsed);
+	    caller = call->caller;
+	    if (caller && caller->entry)
+		LL_ADD(caller->childTime, caller->childTime, elapsed);
+	}
+	PR_REMOVE_LINK(&call->links);
+	call->links.next = (PRCList *)prof->freeCalls;
+	prof->freeCalls = call;
+	call = NULL;
+    }
+  out:
+    PROF_UNLOCK(prof);
+    return call;
+}
+
+/* Forget a dying script's key, then pass the news on to the old hook. */
+static void
+prof_destroy_script(JSContext *cx, JSScript *script, void *callerdata)
+{
+    JSProfile *prof;
+    PRHashEntry **hep;
+    JSProfEntry *entry;
+
+    prof = callerdata;
+    PROF_LOCK(prof);
+    if (prof->table) {
+	hep = PR_HashTableRawLookup(prof->table, prof_hash_key(script),
+				    script);
+	if (*hep) {
+	    entry = (*hep)->value;
+	    entry->key = NULL;
+	    PR_HashTableRawRemove(prof->table, hep, *hep);
+	}
+    }
+    if (prof->lastScript == script)
+	prof->lastScript = NULL;
+    PROF_UNLOCK(prof);
+    if (prof->oldDestroyHook)
+	prof->oldDestroyHook(cx, script, prof->oldDestroyHookData);
+}
+
+static void
+prof_sampler(void *arg)
+{
+    JSProfile *prof;
+    JSRuntime *rt;
+    PRIntervalTime ticks;
+
+    prof = arg;
+    rt = prof->runtime;
+    ticks = PR_MicrosecondsToInterval(prof->interval);
+    if (ticks == 0)
+	ticks = 1;
+    while (!prof->stopSampler) {
+	PR_Sleep(ticks);
+	if (rt->interruptHandler)
+	    prof->missed++;
+	else
+	    JS_SetInterrupt(rt, prof_sample, prof);
+    }
+}
+
+/* Forget all entries and samples, keeping calls in progress as records. */
+static void
+prof_reset(JSProfile *prof)
+{
+    JSProfEntry *entry, *next;
+    PRCList *link;
+
+    if (prof->table) {
+	PR_HashTableDestroy(prof->table);
+	prof->table = NULL;
+    }
+    for (entry = prof->entries; entry; entry = next) {
+	next = entry->next;
+	prof_destroy_entry(entry);
+    }
+    prof->entries = NULL;
+    prof->entryTail = &prof->entries;
+    prof->nentries = 0;
+    prof_destroy_kids(&prof->root);
+    memset(&prof->root, 0, sizeof prof->root);
+    for (link = PR_LIST_HEAD(&prof->calls); link != &prof->calls;
+	 link = PR_NEXT_LINK(link)) {
+	((JSProfCall *)link)->entry = NULL;
+    }
+    prof->samples = prof->missed = prof->ops = 0;
+    prof->lastScript = NULL;
+    prof->lastEntry = NULL;
+    LL_I2L(prof->elapsed, 0);
+}
+
+static void
+prof_stop(JSProfile *prof)
+{
+    JSRuntime *rt;
+    int64 now;
+
+    rt = prof->runtime;
+    if (prof->mode == JSPROF_SAMPLE) {
+	prof->stopSampler = JS_TRUE;
+	PR_JoinThread(prof->sampler);
+	prof->sampler = NULL;
+	if (rt->interruptHandler == (void *)prof_sample)
+	    JS_ClearInterrupt(rt, NULL, NULL);
+    } else {
+	JS_ClearInterrupt(rt, NULL, NULL);
+	JS_SetCallHook(rt, NULL, NULL);
+    }
+    JS_SetDestroyScriptHookProc(rt, prof->oldDestroyHook,
+				prof->oldDestroyHookData);
+
+    /* Scripts are no longer watched, so their keys must go. */
+    PROF_LOCK(prof);
+    if (prof->table) {
+	PR_HashTableDestroy(prof->table);
+	prof->table = NULL;
+    }
+    prof->lastScript = NULL;
+    PROF_UNLOCK(prof);
+    now = PRMJ_Now();
+    LL_SUB(prof->elapsed, now, prof->startTime);
+    prof->running = JS_FALSE;
+}
+
+PR_IMPLEMENT(JSBool)
+JS_StartProfiling(JSContext *cx, JSProfileMode mode, uint32 interval)
+{
+    JSRuntime *rt;
+    JSProfile *prof;
+
+    rt = cx->runtime;
+    prof = rt->profile;
+    if (prof && prof->running) {
+	JS_ReportError(cx, "profiler is already running");
+	return JS_FALSE;
+    }
+    if (rt->interruptHandler || rt->callHook) {
+	JS_ReportError(cx, "profiler can't run with another debugger hook");
+	return JS_FALSE;
+    }
+    if (!prof) {
+	prof = calloc(1, sizeof *prof);
+	if (!prof) {
+	    JS_ReportOutOfMemory(cx);
+	    return JS_FALSE;
+	}
+#ifdef JS_THREADSAFE
+	prof->lock = PR_NewLock();
+	if (!prof->lock) {
+	    free(prof);
+	    JS_ReportOutOfMemory(cx);
+	    return JS_FALSE;
+	}
+#endif
+	prof->runtime = rt;
+	prof->entryTail = &prof->entries;
+	PR_INIT_CLIST(&prof->calls);
+	rt->profile = prof;
+    }
+
+    PROF_LOCK(prof);
+    prof_reset(prof);
+    prof->table = PR_NewHashTable(PROF_TABLE_SIZE, prof_hash_key,
+				  PR_CompareValues, PR_CompareValues,
+				  NULL, NULL);
+    PROF_UNLOCK(prof);
+    if (!prof->table) {
+	JS_ReportOutOfMemory(cx);
+	return JS_FALSE;
+    }
+    prof->mode = mode;
+    prof->interval = interval ? interval : PROF_DEFAULT_INTERVAL;
+    prof->oldDestroyHook = (JSDestroyScriptHookProc) rt->destroyScriptHookProc;
+    prof->oldDestroyHookData = rt->destroyScriptHookProcData;
+    JS_SetDestroyScriptHookProc(rt, prof_destroy_script, prof);
+    prof->startTime = PRMJ_Now();
+
+    if (mode == JSPROF_SAMPLE) {
+	prof->stopSampler = JS_FALSE;
+	prof->sampler = PR_CreateThread(PR_USER_THREAD, prof_sampler, prof,
+					PR_PRIORITY_HIGH, PR_GLOBAL_THREAD,
+					PR_JOINABLE_THREAD, 0);
+	if (!prof->sampler) {
+	    JS_SetDestroyScriptHookProc(rt, prof->oldDestroyHook,
+					prof->oldDestroyHookData);
+	    JS_ReportError(cx, "can't start the profiler's sampling thread");
+	    return JS_FALSE;
+	}
+    } else {
+	JS_SetInterrupt(rt, prof_count, prof);
+	JS_SetCallHook(rt, prof_call, prof);
+    }
+    prof->running = JS_TRUE;
+    return JS_TRUE;
+}
+
+PR_IMPLEMENT(void)
+JS_StopProfiling(JSContext *cx)
+{
+    JSProfile *prof;
+
+    prof = cx->runtime->profile;
+    if (prof && prof->running)
+	prof_stop(prof);
+}
+
+/************************************************************************/
+
+static double
+prof_ms(int64 usec)
+{
+    double d;
+
+    LL_L2D(d, usec);
+    return d / 1000;
+}
+
+static double
+prof_percent(uint32 part, uint32 whole)
+{
+    return whole ? 100.0 * part / whole : 0;
+}
+
+static void
+prof_print_name(FILE *fp, JSProfEntry *entry)
+{
+    if (!entry->length)
+	fprintf(fp, "%s (native)\n", entry->name);
+    else
+	fprintf(fp, "%s (%s:%u)\n", entry->name,
+		entry->filename ? entry->filename : "", entry->lineno);
+}
+
+static int
+prof_compare_entries(const void *p1, const void *p2)
+{
+    JSProfEntry *e1 = *(JSProfEntry **)p1, *e2 = *(JSProfEntry **)p2;
+
+    if (e1->self != e2->self)
+	return (e1->self < e2->self) ? 1 : -1;
+    if (e1->total != e2->total)
+	return (e1->total < e2->total) ? 1 : -1;
+    if (!LL_EQ(e1->selfTime, e2->selfTime))
+	return LL_CMP(e1->selfTime, <, e2->selfTime) ? 1 : -1;
+    return (e1->calls < e2->calls) ? 1 : (e1->calls > e2->calls) ? -1 : 0;
+}
+
+static int
+prof_compare_nodes(const void *p1, const void *p2)
+{
+    JSProfNode *n1 = *(JSProfNode **)p1, *n2 = *(JSProfNode **)p2;
+
+    if (n1->total != n2->total)
+	return (n1->total < n2->total) ? 1 : -1;
+    if (!LL_EQ(n1->time, n2->time))
+	return LL_CMP(n1->time, <, n2->time) ? 1 : -1;
+    return (n1->calls < n2->calls) ? 1 : (n1->calls > n2->calls) ? -1 : 0;
+}
+
+static void
+prof_dump_node(JSProfile *prof, FILE *fp, JSProfNode *node, uintN depth)
+{
+    JSProfNode *kid, **vec;
+    size_t n, i;
+
+    if (node->entry) {
+	if (prof->mode == JSPROF_SAMPLE) {
+	    fprintf(fp, "%6.1f%% %8u %8u  ",
+		    prof_percent(node->total, prof->samples),
+		    node->total, node->self);
+	} else {
+	    fprintf(fp, "%10u %11.3f  ", node->calls, prof_ms(node->time));
+	}
+	fprintf(fp, "%*s", (int)(2 * depth), "");
+	prof_print_name(fp, node->entry);
+	depth++;
+    }
+
+    n = 0;
+    for (kid = node->kids; kid; kid = kid->next)
+	n++;
+    if (n == 0)
+	return;
+    vec = malloc(n * sizeof *vec);
+    if (!vec)
+	return;
+    n = 0;
+    for (kid = node->kids; kid; kid = kid->next) {
+	if (prof->mode == JSPROF_SAMPLE &&
+	    (uint32)kid->total * PROF_TREE_CUTOFF < prof->samples) {
+	    continue;
+	}
+	vec[n++] = kid;
+    }
+    qsort(vec, n, sizeof *vec, prof_compare_nodes);
+    for (i = 0; i < n; i++)
+	prof_dump_node(prof, fp, vec[i], depth);
+    free(vec);
+}
+
+typedef struct JSProfHotOp {
+    JSProfEntry     *entry;
+    uint32          pcoff;
+    uint32          count;
+} JSProfHotOp;
+
+static void
+prof_dump_hot_ops(JSProfile *prof, FILE *fp)
+{
+    JSProfHotOp hot[PROF_HOT_OPS];
+    JSProfEntry *entry;
+    uint32 i, count;
+    uintN n, j;
+    JSOp op;
+
+    n = 0;
+    for (entry = prof->entries; entry; entry = entry->next) {
+	for (i = 0; i < entry->length; i++) {
+	    count = entry->counts[i];
+	    if (count == 0 || (n == PROF_HOT_OPS && count <= hot[n-1].count))
+		continue;
+	    if (n < PROF_HOT_OPS)
+		n++;
+	    for (j = n - 1; j > 0 && hot[j-1].count < count; j--)
+		hot[j] = hot[j-1];
+	    hot[j].entry = entry;
+	    hot[j].pcoff = i;
+	    hot[j].count = count;
+	}
+    }
+    if (n == 0)
+	return;
+
+    fprintf(fp, "\nHottest ops:\n");
+    fprintf(fp, "%10s %7s  %-12s %s\n", "count", "pc", "op", "line");
+    for (j = 0; j < n; j++) {
+	entry = hot[j].entry;
+	op = (JSOp) entry->code[hot[j].pcoff];
+	fprintf(fp, "%10u %7u  %-12s %s:%u in %s\n",
+		hot[j].count, hot[j].pcoff,
+		((uintN)op < (uintN)JSOP_LIMIT) ? js_CodeSpec[op].name : "?",
+		entry->filename ? entry->filename : "",
+		entry->lines[hot[j].pcoff], entry->name);
+    }
+}
+
+PR_IMPLEMENT(void)
+JS_DumpProfile(JSContext *cx, FILE *fp)
+{
+    JSProfile *prof;
+    JSProfEntry *entry, **vec;
+    uint32 i, n, calls;
+    int64 now, elapsed;
+
+    prof = cx->runtime->profile;
+    if (!prof) {
+	fprintf(fp, "No profile.\n");
+	return;
+    }
+    PROF_LOCK(prof);
+    if (prof->running) {
+	now = PRMJ_Now();
+	LL_SUB(elapsed, now, prof->startTime);
+    } else {
+	elapsed = prof->elapsed;
+    }
+    vec = malloc((prof->nentries ? prof->nentries : 1) * sizeof *vec);
+    if (!vec) {
+	PROF_UNLOCK(prof);
+	return;
+    }
+    n = 0;
+    calls = 0;
+    for (entry = prof->entries; entry; entry = entry->next) {
+	calls += entry->calls;
+	vec[n++] = entry;
+    }
+    qsort(vec, n, sizeof *vec, prof_compare_entries);
+
+    if (prof->mode == JSPROF_SAMPLE) {
+	fprintf(fp, "Sampled profile: %u samples every %uus, %u missed, "
+		"%.3f ms\n",
+		prof->samples, prof->interval, prof->missed,
+		prof_ms(elapsed));
+	fprintf(fp, "\nFlat profile:\n");
+	fprintf(fp, "%7s %8s %7s %8s  %s\n",
+		"self%", "self", "total%", "total", "function");
+	for (i = 0; i < n; i++) {
+	    entry = vec[i];
+	    if (entry->total == 0)
+		continue;
+	    fprintf(fp, "%6.1f%% %8u %6.1f%% %8u  ",
+		    prof_percent(entry->self, prof->samples), entry->self,
+		    prof_percent(entry->total, prof->samples), entry->total);
+	    prof_print_name(fp, entry);
+	}
+	fprintf(fp, "\nCall tree:\n");
+	fprintf(fp, "%7s %8s %8s  %s\n", "total%", "total", "self",
+		"function");
+    } else {
+	fprintf(fp, "Counted profile: %u ops, %u calls, %.3f ms\n",
+		prof->ops, calls, prof_ms(elapsed));
+	fprintf(fp, "\nFlat profile:\n");
+	fprintf(fp, "%10s %11s %11s  %s\n",
+		"calls", "self ms", "total ms", "function");
+	for (i = 0; i < n; i++) {
+	    entry = vec[i];
+	    if (entry->calls == 0)
+		continue;
+	    fprintf(fp, "%10u %11.3f %11.3f  ", entry->calls,
+		    prof_ms(entry->selfTime), prof_ms(entry->totalTime));
+	    prof_print_name(fp, entry);
+	}
+	fprintf(fp, "\nCall tree:\n");
+	fprintf(fp, "%10s %11s  %s\n", "calls", "total ms", "function");
+    }
+    free(vec);
+    prof_dump_node(prof, fp, &prof->root, 0);
+    prof_dump_hot_ops(prof, fp);
+    PROF_UNLOCK(prof);
+}
+
+PR_IMPLEMENT(void)
+JS_ClearProfile(JSContext *cx)
+{
+    JSProfile *prof;
+
+    prof = cx->runtime->profile;
+    if (!prof || prof->running)
+	return;
+    PROF_LOCK(prof);
+    prof_reset(prof);
+    PROF_UNLOCK(prof);
+}
+
+void
+js_FinishProfile(JSRuntime *rt)
+{
+    JSProfile *prof;
+    JSProfCall *call;
+    PRCList *link;
+
+    prof = rt->profile;
+    if (!prof)
+	return;
+    if (prof->running)
+	prof_stop(prof);
+    prof_reset(prof);
+    while ((link = PR_LIST_HEAD(&prof->calls)) != &prof->calls) {
+	PR_REMOVE_LINK(link);
+	free(link);
+    }
+    while ((call = prof->freeCalls) != NULL) {
+	prof->freeCalls = (JSProfCall *)call->links.next;
+	free(call);
+    }
+#ifdef JS_THREADSAFE
+    PR_DestroyLock(prof->lock);
+#endif
+    free(prof);
+    rt->profile = NULL;
+}
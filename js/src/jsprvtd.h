@@ -41,6 +41,7 @@ typedef uint32 jsatomid;
 
 /* Struct typedefs. */
 typedef struct JSCodeGenerator  JSCodeGenerator;
+typedef struct JSGCArenaInfo    JSGCArenaInfo;
 typedef struct JSGCThing        JSGCThing;
 typedef struct JSToken          JSToken;
 typedef struct JSTokenStream    JSTokenStream;
@@ -51,10 +52,15 @@ typedef struct JSAtomList       JSAtomList;
 typedef struct JSAtomMap        JSAtomMap;
 typedef struct JSAtomState      JSAtomState;
 typedef struct JSCodeSpec       JSCodeSpec;
+typedef struct JSJITCode        JSJITCode;
+typedef struct JSLazyFunction   JSLazyFunction;
 typedef struct JSPrinter        JSPrinter;
 typedef struct JSProperty       JSProperty;
+typedef struct JSPropertyIC     JSPropertyIC;
+typedef struct JSRECode         JSRECode;
 typedef struct JSRegExp         JSRegExp;
 typedef struct JSRegExpStatics  JSRegExpStatics;
+typedef struct JSRopeNode       JSRopeNode;
 typedef struct JSScope          JSScope;
 typedef struct JSScopeOps       JSScopeOps;
 typedef struct JSStackFrame     JSStackFrame;
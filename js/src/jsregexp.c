@@ -1601,8 +1601,33 @@ OptimizeRegExp(CompilerState *state, RENode *ren)
     return JS_TRUE;
 }
 
+typedef struct REDFA REDFA;
+
+/*
+ * Compiled code for a regular expression, shared by all JSRegExps that have
+ * the same source and flags.  A program whose unanchored part starts with a
+ * literal string keeps it in prefix, so js_ExecuteRegExp can skip to where
+ * it occurs with js_BoyerMooreHorspool.  A program without backreferences
+ * also gets a DFA, built lazily the first time it is executed.
+ */
+struct JSRECode {
+    uint32          nrefs;          /* JSRegExps and cache slot using this */
+    PRHashNumber    hash;           /* hash of source and flags */
+    jschar          *source;        /* copy of source chars, for the cache */
+    size_t          sourceLength;
+    uintN           flags;          /* flags, see jsapi.h */
+    uintN           parenCount;     /* number of parenthesized submatches */
+    size_t          anchorLength;   /* length of leading ANCHOR or ANCHOR1 */
+    jschar          *prefix;        /* literal that starts every match */
+    size_t          prefixLength;
+    REDFA           *dfa;           /* DFA if built, see below */
+    JSBool          noDFA;          /* program has ops the DFA can't handle */
+    size_t          length;         /* program length in bytes */
+    jsbytecode      program[1];     /* regular expression bytecode */
+};
+
 static JSBool
-EmitRegExp(CompilerState *state, RENode *ren, JSRegExp *re)
+EmitRegExp(CompilerState *state, RENode *ren, JSRECode *code)
 {
     REOp op;
     jsbytecode *pc, fill;
@@ -1617,7 +1642,7 @@ EmitRegExp(CompilerState *state, RENode *ren, JSRegExp *re)
 	if (op == REOP_END)
 	    return JS_TRUE;
 
-	pc = &re->program[state->progLength];
+	pc = &code->program[state->progLength];
 	state->progLength += reopsize[ren->op];
 	pc[0] = ren->op;
 	next = ren->next;
@@ -1626,7 +1651,7 @@ EmitRegExp(CompilerState *state, RENode *ren, JSRegExp *re)
 	  case REOP_ALT:
 	    diff = next->offset - ren->offset;
 	    SET_JUMP_OFFSET(pc, diff);
-	    if (!EmitRegExp(state, ren->kid, re))
+	    if (!EmitRegExp(state, ren->kid, code))
 		return JS_FALSE;
 	    break;
 
@@ -1637,7 +1662,7 @@ EmitRegExp(CompilerState *state, RENode *ren, JSRegExp *re)
 	    SET_ARGNO(pc, ren->u.range.min);
 	    pc += 2;
 	    SET_ARGNO(pc, ren->u.range.max);
-	    if (!EmitRegExp(state, ren->kid, re))
+	    if (!EmitRegExp(state, ren->kid, code))
 		return JS_FALSE;
 	    break;
 
@@ -1645,13 +1670,13 @@ EmitRegExp(CompilerState *state, RENode *ren, JSRegExp *re)
 	  case REOP_PLUS:
 	  case REOP_OPT:
 	  case REOP_ANCHOR1:
-	    if (!EmitRegExp(state, ren->kid, re))
+	    if (!EmitRegExp(state, ren->kid, code))
 		return JS_FALSE;
 	    break;
 
 	  case REOP_LPAREN:
 	    SET_ARGNO(pc, ren->u.num);
-	    if (!EmitRegExp(state, ren->kid, re))
+	    if (!EmitRegExp(state, ren->kid, code))
 		return JS_FALSE;
 	    break;
 
@@ -1928,16 +1953,111 @@ EmitRegExp(CompilerState *state, RENode *ren, JSRegExp *re)
     return JS_TRUE;
 }
 
-JSRegExp *
-js_NewRegExp(JSContext *cx, JSString *str, uintN flags)
+#ifdef JS_THREADSAFE
+static PRLock *regexp_lock;     /* protects caches and lazily built DFAs */
+#endif
+
+/*
+ * Return the length of the op at pc, including its immediate operands.
+ */
+static size_t
+OpLength(jsbytecode *pc)
 {
-    JSRegExp *re;
+    switch ((REOp)*pc) {
+      case REOP_FLAT:
+      case REOP_FLATi:
+	return reopsize[*pc] + pc[1];
+      case REOP_UCFLAT:
+      case REOP_UCFLATi:
+	return reopsize[*pc] + 2 * pc[1];
+      case REOP_UCCLASS:
+      case REOP_NUCCLASS:
+	return reopsize[*pc] + ((pc[1] << 8) | pc[2]);
+      default:
+	return reopsize[*pc];
+    }
+}
+
+/*
+ * Note whether code's program can have a DFA (see NewDFA), and find the
+ * literal that every match starts with if the program is unanchored.  Such
+ * a program begins with ANCHOR or ANCHOR1, which MatchRegExp uses to try the
+ * rest of the program at each position in turn.
+ */
+static JSBool
+AnalyzeRegExp(JSContext *cx, JSRECode *code)
+{
+    jsbytecode *pc, *pcend;
+    size_t i, n;
+
+    pcend = code->program + code->length;
+    for (pc = code->program; pc < pcend; pc += OpLength(pc)) {
+	switch ((REOp)*pc) {
+	  case REOP_BACKREF:
+	  case REOP_BACKREFi:
+	  case REOP_UCFLATi:
+	    code->noDFA = JS_TRUE;
+	    break;
+	  default:;
+	}
+    }
+
+    pc = code->program;
+    if (pc == pcend)
+	return JS_TRUE;
+    if ((REOp)*pc == REOP_ANCHOR)
+	pc++;
+    else if ((REOp)*pc == REOP_ANCHOR1)
+	pc += 1 + OpLength(pc + 1);
+    else
+	return JS_TRUE;
+    code->anchorLength = pc - code->program;
+
+    while (pc < pcend && (REOp)*pc == REOP_LPAREN)
+	pc += reopsize[REOP_LPAREN];
+    if (pc == pcend || (REOp)*pc != REOP_FLAT)
+	return JS_TRUE;
+    n = pc[1];
+    code->prefix = JS_malloc(cx, n * sizeof(jschar));
+    if (!code->prefix)
+	return JS_FALSE;
+    for (i = 0; i < n; i++)
+	code->prefix[i] = (jschar)pc[2 + i];
+    code->prefixLength = n;
+    return JS_TRUE;
+}
+
+static void
+DestroyDFA(REDFA *dfa);
+
+static void
+DestroyRECode(JSRECode *code)
+{
+    if (code->dfa)
+	DestroyDFA(code->dfa);
+    if (code->prefix)
+	free(code->prefix);
+    free(code->source);
+    free(code);
+}
+
+/* The caller must hold regexp_lock. */
+#define DROP_RECODE(code)                                                     \
+    PR_BEGIN_MACRO                                                            \
+	if (--(code)->nrefs == 0)                                             \
+	    DestroyRECode(code);                                              \
+    PR_END_MACRO
+
+static JSRECode *
+CompileRegExp(JSContext *cx, JSString *str, uintN flags, PRHashNumber hash)
+{
+    JSRECode *code;
     void *mark;
     CompilerState state;
     RENode *ren, *end;
     size_t resize;
 
-    re = NULL;
+    code = NULL;
     mark = PR_ARENA_MARK(&cx->tempPool);
 
     state.context = cx;
@@ -1964,27 +2084,90 @@ js_NewRegExp(JSContext *cx, JSString *str, uintN flags)
 	goto out;
 #endif
 
-    resize = sizeof *re + state.progLength - 1;
-    re = JS_malloc(cx, PR_ROUNDUP(resize, sizeof(prword)));
-    if (!re)
+    resize = sizeof *code + state.progLength - 1;
+    code = JS_malloc(cx, PR_ROUNDUP(resize, sizeof(prword)));
+    if (!code)
 	goto out;
-    re->source = str;
-    re->length = state.progLength;
-    re->lastIndex = 0;
-    re->parenCount = state.parenCount;
-    re->flags = flags;
+    memset(code, 0, sizeof *code);
+    code->nrefs = 1;
+    code->hash = hash;
+    code->flags = flags;
+    code->parenCount = state.parenCount;
+    code->length = state.progLength;
+
+    code->source = JS_malloc(cx, (str->length + 1) * sizeof(jschar));
+    if (!code->source) {
+	JS_free(cx, code);
+	code = NULL;
+	goto out;
+    }
+    js_strncpy(code->source, str->chars, str->length);
+    code->sourceLength = str->length;
 
     state.progLength = 0;
-    if (!EmitRegExp(&state, ren, re)) {
-	js_DestroyRegExp(cx, re);
-	re = NULL;
-	goto out;
+    if (!EmitRegExp(&state, ren, code) || !AnalyzeRegExp(cx, code)) {
+	DestroyRECode(code);
+	code = NULL;
+    }
+out:
+    PR_ARENA_RELEASE(&cx->tempPool, mark);
+    return code;
+}
+
+JSRegExp *
+js_NewRegExp(JSContext *cx, JSString *str, uintN flags)
+{
+    PRHashNumber hash;
+    const jschar *cp, *end;
+    JSRECode **slotp, *code;
+    JSRegExp *re;
+
+    hash = flags;
+    end = str->chars + str->length;
+    for (cp = str->chars; cp < end; cp++)
+	hash = (hash >> 28) ^ (hash << 4) ^ *cp;
+    slotp = &cx->runtime->regExpCache[hash & (REGEXP_CACHE_SIZE - 1)];
+
+    JS_ACQUIRE_LOCK(regexp_lock);
+    code = *slotp;
+    if (code &&
+	code->hash == hash &&
+	code->flags == flags &&
+	code->sourceLength == str->length &&
+	!memcmp(code->source, str->chars, str->length * sizeof(jschar))) {
+	code->nrefs++;
+    } else {
+	code = NULL;
     }
+    JS_RELEASE_LOCK(regexp_lock);
+
+    if (!code) {
+	code = CompileRegExp(cx, str, flags, hash);
+	if (!code)
+	    return NULL;
+	JS_ACQUIRE_LOCK(regexp_lock);
+	if (*slotp)
+	    DROP_RECODE(*slotp);
+	*slotp = code;
+	code->nrefs++;
+	JS_RELEASE_LOCK(regexp_lock);
+    }
+
+    re = JS_malloc(cx, sizeof *re);
+    if (!re) {
+	JS_ACQUIRE_LOCK(regexp_lock);
+	DROP_RECODE(code);
+	JS_RELEASE_LOCK(regexp_lock);
+	return NULL;
+    }
+    re->source = str;
+    re->lastIndex = 0;
+    re->parenCount = code->parenCount;
+    re->flags = flags;
+    re->code = code;
 
     /* Success: lock re->source string. */
     (void) js_LockGCThing(cx, str);
-out:
-    PR_ARENA_RELEASE(&cx->tempPool, mark);
     return re;
 }
 
@@ -2018,9 +2201,29 @@ void
 js_DestroyRegExp(JSContext *cx, JSRegExp *re)
 {
     js_UnlockGCThing(cx, re->source);
+    JS_ACQUIRE_LOCK(regexp_lock);
+    DROP_RECODE(re->code);
+    JS_RELEASE_LOCK(regexp_lock);
     JS_free(cx, re);
 }
 
+void
+js_FinishRegExpCache(JSRuntime *rt)
+{
+    uintN i;
+    JSRECode *code;
+
+    JS_ACQUIRE_LOCK(regexp_lock);
+    for (i = 0; i < REGEXP_CACHE_SIZE; i++) {
+	code = rt->regExpCache[i];
+	if (code) {
+	    rt->regExpCache[i] = NULL;
+	    DROP_RECODE(code);
+	}
+    }
+    JS_RELEASE_LOCK(regexp_lock);
+}
+
 typedef struct MatchState {
     JSContext       *context;           /* for access to regExpStatics */
     JSBool          anchoring;          /* true if multiline anchoring ^/$ */
@@ -2031,8 +2234,12 @@ typedef struct MatchState {
     uintN           parenCount;         /* number of paren substring matches */
     JSSubString     *maybeParens;       /* possible paren substring pointers */
     JSSubString     *parens;            /* certain paren substring matches */
+    size_t          budget;             /* calls left before giving up */
 } MatchState;
 
+/* MatchRegExp's budget of calls for length chars, see js_ExecuteRegExp. */
+#define REGEXP_BUDGET(length)   (1024 + 16 * (size_t)(length))
+
 /*
  * Returns updated cp on match, null on mismatch.
  */
@@ -2051,6 +2258,11 @@ MatchRegExp(MatchState *state, jsbytecode *pc, const jschar *cp)
     jschar c, c2;
     uintN bit, byte, size;
 
+    /* Give up if backtracking too much, see js_ExecuteRegExp. */
+    if (state->budget == 0)
+	return NULL;
+    state->budget--;
+
     pcend = state->pcend;
     cpbegin = state->cpbegin;
     cpend = state->cpend;
@@ -2511,7 +2723,6 @@ MatchRegExp(MatchState *state, jsbytecode *pc, const jschar *cp)
 	    }
 	    return NULL;
 
-#undef MATCH_CHARS_IGNORING_CASE
 #undef SINGLE_CASES
 #undef NONDOT_SINGLE_CASES
 
@@ -2533,11 +2744,919 @@ MatchRegExp(MatchState *state, jsbytecode *pc, const jschar *cp)
     return cp;
 }
 
+/*
+ * Linear-time matching.  A program without backreferences also describes a
+ * nondeterministic automaton, whose positions are program offsets doubled to
+ * make room for a second state per op: inside a PLUS after its first match,
+ * or skipping ahead for ANCHOR, ANCHOR1, BOL and EOLONLY.  The chars of FLAT
+ * ops are positions too, at the offsets of their immediate operands.
+ *
+ * The automaton accepts a superset of what MatchRegExp matches, because it
+ * ignores quantifier bounds and lets each search-like op skip ahead anywhere
+ * -- so when it finds no match, MatchRegExp would find none either.  When it
+ * does, it tells MatchRegExp the leftmost position from which a match can
+ * start, and MatchRegExp redoes the match from there to get the substrings
+ * its backtracking order picks.  Most matches take MatchRegExp less time than
+ * that, so js_ExecuteRegExp uses the DFA only once MatchRegExp has spent its
+ * budget of calls.
+ *
+ * DFA states are built lazily, each from the positions the automaton enters
+ * on a char and the context its assertions need about the previous char.
+ * Transitions are cached per class of ISO-Latin-1 chars that every matcher
+ * in the program treats alike, and computed afresh for other chars.  If the
+ * number of states grows past REDFA_MAX_STATES, all are flushed.
+ */
+#define REDFA_OPCODE        0       /* program byte starts an op */
+#define REDFA_FLATCHAR      1       /* program byte is a FLAT char */
+#define REDFA_FLATCHARi     2       /* program byte is a FLATi char */
+#define REDFA_UCFLATCHAR    3       /* program byte starts a UCFLAT char */
+#define REDFA_OPERAND       4       /* program byte is another operand */
+
+#define REDFA_AT_START      0x01    /* at the start of input */
+#define REDFA_PREV_NL       0x02    /* previous char is a newline */
+#define REDFA_PREV_WORD     0x04    /* previous char is a word char */
+#define REDFA_MULTILINE     0x08    /* RegExp.multiline is true */
+#define REDFA_NFLAGS        0x10    /* number of flags combinations */
+
+#define REDFA_MAP_SIZE      256     /* chars with cached transitions */
+#define REDFA_HASH_LOG2     6
+#define REDFA_HASH_SIZE     PR_BIT(REDFA_HASH_LOG2)
+#define REDFA_MAX_STATES    256
+
+#define REDFA_POS(off,bit)  (((uint32)(off) << 1) | (bit))
+#define REDFA_POS_OFF(pos)  ((pos) >> 1)
+#define REDFA_POS_BIT(pos)  ((pos) & 1)
+
+typedef struct REDFAState REDFAState;
+
+struct REDFAState {
+    REDFAState      *link;          /* next state in hash chain */
+    PRHashNumber    hash;           /* hash of flags and positions */
+    uintN           flags;          /* REDFA_* context flags */
+    intN            acceptEnd;      /* match at end of input, -1 if unknown */
+    REDFAState      **next;         /* successor by char class, or null */
+    uint8           *accept;        /* whether a match ends before the char */
+    uint32          npos;           /* number of positions */
+    uint32          pos[1];         /* sorted positions entered on last char */
+};
+
+typedef struct REQuant {
+    uint32          kid;            /* offset of quantified kid's first op */
+    uint32          end;            /* offset after the kid, to loop from */
+} REQuant;
+
+struct REDFA {
+    uint32          npos;           /* number of automaton positions */
+    uint8           *kind;          /* REDFA_OPCODE, etc., per program byte */
+    REQuant         *quants;        /* vector of quantifiers */
+    uintN           nquants;
+    uintN           nclasses;       /* number of char classes */
+    uint8           classMap[REDFA_MAP_SIZE];
+    REDFAState      *table[REDFA_HASH_SIZE];
+    REDFAState      *starts[2][REDFA_NFLAGS];   /* start states, by whether
+						   the program's anchor is
+						   skipped and by flags */
+    uintN           nstates;
+    uint32          generation;     /* current mark, to visit positions once */
+    uint32          *mark;          /* generation in which position was seen */
+    uint32          *stack;         /* positions to close over */
+    uint32          *cons;          /* closure's positions that consume chars */
+    uint32          ncons;
+    uint32          *kernel;        /* positions for the next state */
+};
+
+/*
+ * Return whether the single char matching op at pc matches c, as MatchRegExp
+ * would.  MatchRegExp indexes past a CCLASS bitmap for c > 255, so take any
+ * such c to match one.
+ */
+static JSBool
+MatchSingle(jsbytecode *pc, jschar c)
+{
+    jschar c2;
+    uintN byte, size;
+
+    switch ((REOp)*pc) {
+      case REOP_DOT:
+	return c != '\n';
+      case REOP_CCLASS:
+	if (c >= CCLASS_CHARSET_SIZE)
+	    return JS_TRUE;
+	return (pc[1 + (c >> 3)] & (1 << (c & 7))) != 0;
+      case REOP_DIGIT:
+	return JS_ISDIGIT(c);
+      case REOP_NONDIGIT:
+	return !JS_ISDIGIT(c);
+      case REOP_ALNUM:
+	return JS_ISWORD(c);
+      case REOP_NONALNUM:
+	return !JS_ISWORD(c);
+      case REOP_SPACE:
+	return JS_ISSPACE(c);
+      case REOP_NONSPACE:
+	return !JS_ISSPACE(c);
+      case REOP_FLAT1:
+	return c == (jschar)pc[1];
+      case REOP_FLAT1i:
+	c2 = (jschar)pc[1];
+	return MATCH_CHARS_IGNORING_CASE(c, c2);
+      case REOP_UCFLAT1:
+	return c == ((pc[1] << 8) | pc[2]);
+      case REOP_UCFLAT1i:
+	c2 = (pc[1] << 8) | pc[2];
+	return MATCH_CHARS_IGNORING_CASE(c, c2);
+      case REOP_UCCLASS:
+      case REOP_NUCCLASS:
+	size = (pc[1] << 8) | pc[2];
+	byte = (uintN)c >> 3;
+	if (byte >= size)
+	    return (REOp)*pc == REOP_NUCCLASS;
+	return (pc[3 + byte] & (1 << (c & 7))) != 0;
+      default:
+	PR_ASSERT(0);
+	return JS_FALSE;
+    }
+}
+
+static uint32
+NextGeneration(REDFA *dfa)
+{
+    if (++dfa->generation == 0) {
+	memset(dfa->mark, 0, dfa->npos * sizeof(uint32));
+	dfa->generation = 1;
+    }
+    return dfa->generation;
+}
+
+/*
+ * Compute the closure of the n positions in kernel, in the context given by
+ * flags and by the next char c (or end of input, if atEnd).  Leave the
+ * positions that consume a char in dfa->cons, and return whether the closure
+ * reaches the end of the program.
+ *
+ * At end of input, MatchRegExp lets a single char matcher that matches NUL
+ * step past the terminator, and from there its assertions read garbage; so
+ * treat such matchers as empty, and all but BOL as true, to stay a superset.
+ */
+static JSBool
+Closure(JSRECode *code, REDFA *dfa, const uint32 *kernel, uint32 n,
+	uintN flags, jschar c, JSBool atEnd)
+{
+    uint32 *stack, *mark, gen, top, pos, off, i;
+    jsbytecode *pc;
+    ptrdiff_t jmp;
+    REOp op;
+    JSBool multiline, prevNonWord, nextNonWord, accept;
+
+#define PUSH_POS(p)                                                           \
+    PR_BEGIN_MACRO                                                            \
+	uint32 _p = (p);                                                      \
+	if (mark[_p] != gen) {                                                \
+	    mark[_p] = gen;                                                   \
+	    stack[top++] = _p;                                                \
+	}                                                                     \
+    PR_END_MACRO
+
+#define ADD_CONS(p)                                                           \
+    PR_BEGIN_MACRO                                                            \
+	if (!atEnd)                                                           \
+	    dfa->cons[dfa->ncons++] = (p);                                    \
+    PR_END_MACRO
+
+    stack = dfa->stack;
+    mark = dfa->mark;
+    gen = NextGeneration(dfa);
+    multiline = (flags & REDFA_MULTILINE) != 0;
+    prevNonWord = (flags & REDFA_AT_START) || !(flags & REDFA_PREV_WORD);
+    nextNonWord = atEnd || !JS_ISWORD(c);
+    accept = JS_FALSE;
+    dfa->ncons = 0;
+    top = 0;
+    for (i = 0; i < n; i++)
+	PUSH_POS(kernel[i]);
+
+    while (top != 0) {
+	pos = stack[--top];
+	off = REDFA_POS_OFF(pos);
+	if (REDFA_POS_BIT(pos) == 0) {
+	    /* Entering the op after a quantified kid may begin another kid. */
+	    for (i = 0; i < dfa->nquants; i++) {
+		if (dfa->quants[i].end == off)
+		    PUSH_POS(REDFA_POS(dfa->quants[i].kid, 0));
+	    }
+	}
+	if (off == code->length) {
+	    accept = JS_TRUE;
+	    continue;
+	}
+	if (dfa->kind[off] != REDFA_OPCODE) {
+	    ADD_CONS(pos);
+	    continue;
+	}
+
+	pc = &code->program[off];
+	op = (REOp)*pc;
+	switch (op) {
+	  case REOP_EMPTY:
+	    PUSH_POS(REDFA_POS(off + 1, 0));
+	    break;
+
+	  case REOP_ALT:
+	    jmp = GET_JUMP_OFFSET(pc);
+	    PUSH_POS(REDFA_POS(off + reopsize[op], 0));
+	    if ((REOp)pc[jmp] == REOP_ALT)
+		PUSH_POS(REDFA_POS(off + jmp, 0));
+	    break;
+
+	  case REOP_JUMP:
+	    PUSH_POS(REDFA_POS(off + GET_JUMP_OFFSET(pc), 0));
+	    break;
+
+	  case REOP_LPAREN:
+	  case REOP_RPAREN:
+	    PUSH_POS(REDFA_POS(off + reopsize[op], 0));
+	    break;
+
+	  case REOP_BOL:
+	    if (REDFA_POS_BIT(pos)) {
+		ADD_CONS(pos);
+		break;
+	    }
+	    if ((flags & REDFA_AT_START) ||
+		(multiline && (flags & REDFA_PREV_NL))) {
+		PUSH_POS(REDFA_POS(off + 1, 0));
+	    }
+	    if (multiline)
+		PUSH_POS(REDFA_POS(off, 1));
+	    break;
+
+	  case REOP_EOL:
+	    if (atEnd || (multiline && c == '\n'))
+		PUSH_POS(REDFA_POS(off + 1, 0));
+	    break;
+
+	  case REOP_EOLONLY:
+	    if (REDFA_POS_BIT(pos)) {
+		ADD_CONS(pos);
+		break;
+	    }
+	    if (atEnd || (multiline && c == '\n'))
+		PUSH_POS(REDFA_POS(off + 1, 0));
+	    PUSH_POS(REDFA_POS(off, 1));
+	    break;
+
+	  case REOP_WBDRY:
+	    if (atEnd || prevNonWord != nextNonWord)
+		PUSH_POS(REDFA_POS(off + 1, 0));
+	    break;
+
+	  case REOP_WNONBDRY:
+	    if (atEnd || prevNonWord == nextNonWord)
+		PUSH_POS(REDFA_POS(off + 1, 0));
+	    break;
+
+	  case REOP_QUANT:
+	    PUSH_POS(REDFA_POS(off + reopsize[op], 0));
+	    if (GET_ARGNO(pc + 2) == 0)
+		PUSH_POS(REDFA_POS(off + GET_JUMP_OFFSET(pc), 0));
+	    break;
+
+	  case REOP_PLUS:
+	    ADD_CONS(pos);
+	    if (REDFA_POS_BIT(pos))
+		PUSH_POS(REDFA_POS(off + 1 + OpLength(pc + 1), 0));
+	    break;
+
+	  case REOP_STAR:
+	  case REOP_OPT:
+	    ADD_CONS(pos);
+	    PUSH_POS(REDFA_POS(off + 1 + OpLength(pc + 1), 0));
+	    break;
+
+	  case REOP_DOTSTAR:
+	    ADD_CONS(pos);
+	    PUSH_POS(REDFA_POS(off + 1, 0));
+	    break;
+
+	  case REOP_ANCHOR:
+	  case REOP_ANCHOR1:
+	    if (REDFA_POS_BIT(pos)) {
+		ADD_CONS(pos);
+		break;
+	    }
+	    jmp = 1;
+	    if (op == REOP_ANCHOR1)
+		jmp += OpLength(pc + 1);
+	    PUSH_POS(REDFA_POS(off + jmp, 0));
+	    PUSH_POS(REDFA_POS(off, 1));
+	    break;
+
+	  case REOP_FLAT:
+	  case REOP_FLATi:
+	  case REOP_UCFLAT:
+	    PUSH_POS(REDFA_POS(off + 2, 0));
+	    break;
+
+	  default:
+	    if (!atEnd)
+		ADD_CONS(pos);
+	    else if (op != REOP_DOT && MatchSingle(pc, 0))
+		PUSH_POS(REDFA_POS(off + OpLength(pc), 0));
+	    break;
+	}
+    }
+
+#undef PUSH_POS
+#undef ADD_CONS
+
+    return accept;
+}
+
+/*
+ * Step the consuming positions left in dfa->cons by Closure over c, putting
+ * the positions entered in dfa->kernel and returning their number.
+ */
+static uint32
+Step(JSRECode *code, REDFA *dfa, jschar c)
+{
+    uint32 *mark, gen, n, i, pos, off;
+    jsbytecode *pc;
+    jschar c1, c2;
+
+#define ADD_POS(p)                                                            \
+    PR_BEGIN_MACRO                                                            \
+	uint32 _p = (p);                                                      \
+	if (mark[_p] != gen) {                                                \
+	    mark[_p] = gen;                                                   \
+	    dfa->kernel[n++] = _p;                                            \
+	}                                                                     \
+    PR_END_MACRO
+
+    mark = dfa->mark;
+    gen = NextGeneration(dfa);
+    n = 0;
+    for (i = 0; i < dfa->ncons; i++) {
+	pos = dfa->cons[i];
+	off = REDFA_POS_OFF(pos);
+	pc = &code->program[off];
+	switch (dfa->kind[off]) {
+	  case REDFA_FLATCHAR:
+	    if (c == (jschar)*pc)
+		ADD_POS(REDFA_POS(off + 1, 0));
+	    continue;
+
+	  case REDFA_FLATCHARi:
+	    c1 = c;
+	    c2 = (jschar)*pc;
+	    if (MATCH_CHARS_IGNORING_CASE(c1, c2))
+		ADD_POS(REDFA_POS(off + 1, 0));
+	    continue;
+
+	  case REDFA_UCFLATCHAR:
+#if IS_BIG_ENDIAN
+	    c2 = (pc[0] << 8) | pc[1];
+#endif
+#if IS_LITTLE_ENDIAN
+	    c2 = pc[0] | (pc[1] << 8);
+#endif
+	    if (c == c2)
+		ADD_POS(REDFA_POS(off + 2, 0));
+	    continue;
+	}
+
+	switch ((REOp)*pc) {
+	  case REOP_BOL:
+	  case REOP_EOLONLY:
+	  case REOP_ANCHOR:
+	  case REOP_ANCHOR1:
+	    /* Skipping ahead: any char leads back to the op. */
+	    ADD_POS(REDFA_POS(off, 0));
+	    break;
+
+	  case REOP_STAR:
+	    if (MatchSingle(pc + 1, c))
+		ADD_POS(REDFA_POS(off, 0));
+	    break;
+
+	  case REOP_PLUS:
+	    if (MatchSingle(pc + 1, c))
+		ADD_POS(REDFA_POS(off, 1));
+	    break;
+
+	  case REOP_OPT:
+	    if (MatchSingle(pc + 1, c))
+		ADD_POS(REDFA_POS(off + 1 + OpLength(pc + 1), 0));
+	    break;
+
+	  case REOP_DOTSTAR:
+	    if (c != '\n')
+		ADD_POS(REDFA_POS(off, 0));
+	    break;
+
+	  default:
+	    if (MatchSingle(pc, c))
+		ADD_POS(REDFA_POS(off + OpLength(pc), 0));
+	    break;
+	}
+    }
+
+#undef ADD_POS
+
+    return n;
+}
+
+static int
+ComparePositions(const void *a, const void *b)
+{
+    uint32 p1 = *(const uint32 *)a, p2 = *(const uint32 *)b;
+
+    return (p1 < p2) ? -1 : (p1 > p2);
+}
+
+static void
+FlushDFA(REDFA *dfa)
+{
+    uintN i;
+    REDFAState *state, *next;
+
+    for (i = 0; i < REDFA_HASH_SIZE; i++) {
+	for (state = dfa->table[i]; state; state = next) {
+	    next = state->link;
+	    free(state);
+	}
+	dfa->table[i] = NULL;
+    }
+    memset(dfa->starts, 0, sizeof dfa->starts);
+    dfa->nstates = 0;
+}
+
+static void
+DestroyDFA(REDFA *dfa)
+{
+    FlushDFA(dfa);
+    free(dfa);
+}
+
+/*
+ * Find or create the state for flags and the n positions in kernel, which
+ * this function sorts.  The caller must flush dfa if it is full.
+ */
+static REDFAState *
+GetState(JSContext *cx, REDFA *dfa, uint32 *kernel, uint32 n, uintN flags)
+{
+    PRHashNumber hash;
+    uint32 i;
+    REDFAState **hp, *state;
+    size_t nbytes;
+
+    PR_ASSERT(dfa->nstates < REDFA_MAX_STATES);
+    if (n > 1)
+	qsort(kernel, n, sizeof(uint32), ComparePositions);
+    hash = flags;
+    for (i = 0; i < n; i++)
+	hash = (hash >> 28) ^ (hash << 4) ^ kernel[i];
+
+    hp = &dfa->table[hash & (REDFA_HASH_SIZE - 1)];
+    for (state = *hp; state; state = state->link) {
+	if (state->hash == hash &&
+	    state->flags == flags &&
+	    state->npos == n &&
+	    !memcmp(state->pos, kernel, n * sizeof(uint32))) {
+	    return state;
+	}
+    }
+
+    nbytes = sizeof *state;
+    if (n > 1)
+	nbytes += (n - 1) * sizeof(uint32);
+    nbytes = PR_ROUNDUP(nbytes, sizeof(REDFAState *));
+    state = JS_malloc(cx, nbytes + dfa->nclasses * (sizeof(REDFAState *) + 1));
+    if (!state)
+	return NULL;
+    state->hash = hash;
+    state->flags = flags;
+    state->acceptEnd = -1;
+    state->next = (REDFAState **)((char *)state + nbytes);
+    state->accept = (uint8 *)(state->next + dfa->nclasses);
+    memset(state->next, 0, dfa->nclasses * sizeof(REDFAState *));
+    state->npos = n;
+    memcpy(state->pos, kernel, n * sizeof(uint32));
+    state->link = *hp;
+    *hp = state;
+    dfa->nstates++;
+    return state;
+}
+
+/*
+ * Compute state's successor on c, which the caller has found no cached
+ * transition for, setting *acceptp to whether a match ends before c.  Return
+ * null on out of memory.
+ */
+static REDFAState *
+NextState(JSContext *cx, JSRECode *code, REDFA *dfa, REDFAState *state,
+	  jschar c, JSBool *acceptp)
+{
+    uintN cls, flags;
+    REDFAState *next;
+    JSBool accept;
+    uint32 n;
+
+    cls = (c < REDFA_MAP_SIZE) ? dfa->classMap[c] : 0;
+    accept = Closure(code, dfa, state->pos, state->npos, state->flags, c,
+		     JS_FALSE);
+    n = Step(code, dfa, c);
+    flags = state->flags & REDFA_MULTILINE;
+    if (c == '\n')
+	flags |= REDFA_PREV_NL;
+    if (JS_ISWORD(c))
+	flags |= REDFA_PREV_WORD;
+    if (dfa->nstates == REDFA_MAX_STATES) {
+	FlushDFA(dfa);
+	state = NULL;
+    }
+    next = GetState(cx, dfa, dfa->kernel, n, flags);
+    if (!next)
+	return NULL;
+    if (state && c < REDFA_MAP_SIZE) {
+	state->next[cls] = next;
+	state->accept[cls] = (uint8)accept;
+    }
+    *acceptp = accept;
+    return next;
+}
+
+/*
+ * Build code's DFA.  Programs with backreferences can't have one, and nor
+ * can those with UCFLATi ops, which MatchRegExp advances over by half their
+ * length; AnalyzeRegExp sets code->noDFA for both.
+ */
+static JSBool
+NewDFA(JSContext *cx, JSRECode *code)
+{
+    jsbytecode *program, *pc, *pcend;
+    size_t off, len, i, ntests, nbytes, sigbytes;
+    uintN nquants, c, c2;
+    uint32 npos, *tests;
+    uint8 *kind, *sigs, *sig;
+    jschar c1, c3;
+    REDFA *dfa;
+    REQuant *quant;
+
+    program = code->program;
+    pcend = program + code->length;
+    nquants = ntests = 0;
+    PR_ASSERT(!code->noDFA);
+    for (pc = program; pc < pcend; pc += OpLength(pc)) {
+	switch ((REOp)*pc) {
+	  case REOP_QUANT:
+	    nquants++;
+	    break;
+	  case REOP_FLAT:
+	  case REOP_FLATi:
+	  case REOP_UCFLAT:
+	    ntests += pc[1];
+	    break;
+	  default:
+	    ntests++;
+	    break;
+	}
+    }
+
+    /*
+     * Allocate the DFA and its vectors together: kind, then the uint32
+     * vectors, then quants.
+     */
+    npos = REDFA_POS(code->length + 1, 0);
+    nbytes = PR_ROUNDUP(sizeof *dfa + code->length, sizeof(uint32));
+    dfa = JS_malloc(cx, nbytes + 4 * npos * sizeof(uint32)
+			    + nquants * sizeof(REQuant));
+    if (!dfa)
+	return JS_FALSE;
+    memset(dfa, 0, sizeof *dfa);
+    dfa->npos = npos;
+    dfa->kind = kind = (uint8 *)(dfa + 1);
+    dfa->mark = (uint32 *)((char *)dfa + nbytes);
+    dfa->stack = dfa->mark + npos;
+    dfa->cons = dfa->stack + npos;
+    dfa->kernel = dfa->cons + npos;
+    dfa->quants = quant = (REQuant *)(dfa->kernel + npos);
+    dfa->nquants = nquants;
+    memset(dfa->mark, 0, npos * sizeof(uint32));
+
+    /*
+     * Classify each program byte, and note the offsets of char matchers to
+     * test in order to group chars into classes.
+     */
+    sigbytes = (ntests + 2 + 7) / 8;
+    tests = JS_malloc(cx, ntests * sizeof(uint32)
+			  + REDFA_MAP_SIZE * sigbytes + 1);
+    if (!tests) {
+	free(dfa);
+	return JS_FALSE;
+    }
+    sigs = (uint8 *)(tests + ntests);
+    memset(kind, REDFA_OPERAND, code->length);
+    ntests = 0;
+    for (pc = program; pc < pcend; pc += len) {
+	off = pc - program;
+	len = OpLength(pc);
+	kind[off] = REDFA_OPCODE;
+	switch ((REOp)*pc) {
+	  case REOP_QUANT:
+	    quant->kid = off + reopsize[REOP_QUANT];
+	    quant->end = off + GET_JUMP_OFFSET(pc);
+	    quant++;
+	    break;
+	  case REOP_FLAT:
+	  case REOP_FLATi:
+	    for (i = 0; i < pc[1]; i++) {
+		kind[off + 2 + i] = ((REOp)*pc == REOP_FLAT)
+				    ? REDFA_FLATCHAR
+				    : REDFA_FLATCHARi;
+		tests[ntests++] = off + 2 + i;
+	    }
+	    break;
+	  case REOP_UCFLAT:
+	    for (i = 0; i < pc[1]; i++) {
+		kind[off + 2 + 2 * i] = REDFA_UCFLATCHAR;
+		tests[ntests++] = off + 2 + 2 * i;
+	    }
+	    break;
+	  case REOP_DOT:
+	  case REOP_CCLASS:
+	  case REOP_DIGIT:
+	  case REOP_NONDIGIT:
+	  case REOP_ALNUM:
+	  case REOP_NONALNUM:
+	  case REOP_SPACE:
+	  case REOP_NONSPACE:
+	  case REOP_FLAT1:
+	  case REOP_FLAT1i:
+	  case REOP_UCFLAT1:
+	  case REOP_UCFLAT1i:
+	  case REOP_UCCLASS:
+	  case REOP_NUCCLASS:
+	    tests[ntests++] = off;
+	    break;
+	  default:;
+	}
+    }
+
+    /*
+     * Two chars are in the same class if every matcher and assertion in the
+     * program treats them alike.  Step works out FLAT chars itself, so here
+     * a FLAT char's test is whether it equals the char, ignoring case when
+     * the program does.
+     */
+    memset(sigs, 0, REDFA_MAP_SIZE * sigbytes);
+    for (c = 0; c < REDFA_MAP_SIZE; c++) {
+	sig = sigs + c * sigbytes;
+	for (i = 0; i < ntests; i++) {
+	    pc = program + tests[i];
+	    switch (kind[tests[i]]) {
+	      case REDFA_FLATCHAR:
+		c2 = (c == *pc);
+		break;
+	      case REDFA_FLATCHARi:
+		c1 = (jschar)c;
+		c3 = (jschar)*pc;
+		c2 = MATCH_CHARS_IGNORING_CASE(c1, c3);
+		break;
+	      case REDFA_UCFLATCHAR:
+#if IS_BIG_ENDIAN
+		c2 = (c == (uintN)((pc[0] << 8) | pc[1]));
+#endif
+#if IS_LITTLE_ENDIAN
+		c2 = (c == (uintN)(pc[0] | (pc[1] << 8)));
+#endif
+		break;
+	      default:
+		c2 = MatchSingle(pc, (jschar)c);
+		break;
+	    }
+	    if (c2)
+		sig[i >> 3] |= 1 << (i & 7);
+	}
+	if (c == '\n')
+	    sig[ntests >> 3] |= 1 << (ntests & 7);
+	if (JS_ISWORD(c))
+	    sig[(ntests + 1) >> 3] |= 1 << ((ntests + 1) & 7);
+
+	for (c2 = 0; c2 < c; c2++) {
+	    if (!memcmp(sigs + c2 * sigbytes, sig, sigbytes))
+		break;
+	}
+	dfa->classMap[c] = (c2 < c) ? dfa->classMap[c2] : dfa->nclasses++;
+    }
+    JS_free(cx, tests);
+
+    code->dfa = dfa;
+    return JS_TRUE;
+}
+
+/*
+ * Return the bytes code and its DFA occupy, divided among the JSRegExps and
+ * cache slot that share it, for the memory census (see jscensus.c).
+ */
+static size_t
+RECodeBytes(JSRECode *code)
+{
+    size_t nbytes, n;
+    REDFA *dfa;
+    uintN i;
+    REDFAState *state;
+
+    nbytes = PR_ROUNDUP(sizeof *code + code->length - 1, sizeof(prword))
+	   + (code->sourceLength + 1 + code->prefixLength) * sizeof(jschar);
+    dfa = code->dfa;
+    if (dfa) {
+	nbytes += PR_ROUNDUP(sizeof *dfa + code->length, sizeof(uint32))
+		+ 4 * dfa->npos * sizeof(uint32)
+		+ dfa->nquants * sizeof(REQuant);
+	for (i = 0; i < REDFA_HASH_SIZE; i++) {
+	    for (state = dfa->table[i]; state; state = state->link) {
+		n = sizeof *state;
+		if (state->npos > 1)
+		    n += (state->npos - 1) * sizeof(uint32);
+		nbytes += PR_ROUNDUP(n, sizeof(REDFAState *))
+			+ dfa->nclasses * (sizeof(REDFAState *) + 1);
+	    }
+	}
+    }
+    return nbytes / code->nrefs;
+}
+
+size_t
+js_GetRegExpBytes(JSRegExp *re)
+{
+    return sizeof *re + RECodeBytes(re->code);
+}
+
+size_t
+js_GetRegExpCacheBytes(JSRuntime *rt)
+{
+    size_t nbytes;
+    uintN i;
+
+    nbytes = 0;
+    for (i = 0; i < REGEXP_CACHE_SIZE; i++) {
+	if (rt->regExpCache[i])
+	    nbytes += RECodeBytes(rt->regExpCache[i]);
+    }
+    return nbytes;
+}
+
+/*
+ * Run code's DFA from program offset off over [cp, cpend), setting *endp to
+ * where the first match found ends, or to null if no match can start at cp
+ * (or, if off is 0 and the program is unanchored, anywhere after cp).
+ */
+static JSBool
+RunDFA(JSContext *cx, JSRECode *code, uint32 off, const jschar *cpbegin,
+       const jschar *cp, const jschar *cpend, JSBool multiline,
+       const jschar **endp)
+{
+    REDFA *dfa;
+    uintN flags, cls;
+    uint32 pos;
+    REDFAState *state, *next;
+    JSBool accept;
+    jschar c;
+
+    dfa = code->dfa;
+    flags = multiline ? REDFA_MULTILINE : 0;
+    if (cp == cpbegin) {
+	flags |= REDFA_AT_START;
+    } else {
+	if (cp[-1] == '\n')
+	    flags |= REDFA_PREV_NL;
+	if (JS_ISWORD(cp[-1]))
+	    flags |= REDFA_PREV_WORD;
+    }
+    state = dfa->starts[off != 0][flags];
+    if (!state) {
+	if (dfa->nstates == REDFA_MAX_STATES)
+	    FlushDFA(dfa);
+	pos = REDFA_POS(off, 0);
+	state = GetState(cx, dfa, &pos, 1, flags);
+	if (!state)
+	    return JS_FALSE;
+	dfa->starts[off != 0][flags] = state;
+    }
+
+    for (; cp < cpend; cp++) {
+	c = *cp;
+	next = NULL;
+	if (c < REDFA_MAP_SIZE) {
+	    cls = dfa->classMap[c];
+	    next = state->next[cls];
+	    accept = state->accept[cls];
+	}
+	if (!next) {
+	    next = NextState(cx, code, dfa, state, c, &accept);
+	    if (!next)
+		return JS_FALSE;
+	}
+	state = next;
+	if (accept) {
+	    *endp = cp;
+	    return JS_TRUE;
+	}
+	if (state->npos == 0) {
+	    *endp = NULL;
+	    return JS_TRUE;
+	}
+    }
+    if (state->acceptEnd < 0) {
+	state->acceptEnd = Closure(code, dfa, state->pos, state->npos,
+				   state->flags, 0, JS_TRUE);
+    }
+    *endp = state->acceptEnd ? cpend : NULL;
+    return JS_TRUE;
+}
+
+/*
+ * Return where code's literal prefix next occurs in [cp, cpend), or null.
+ */
+static const jschar *
+FindPrefix(JSRECode *code, const jschar *cpbegin, const jschar *cp,
+	   const jschar *cpend)
+{
+    jsint i;
+
+    i = js_BoyerMooreHorspool(cpbegin, cpend - cpbegin,
+			      code->prefix, (jsint)code->prefixLength,
+			      cp - cpbegin);
+    return (i < 0) ? NULL : cpbegin + i;
+}
+
+/*
+ * Advance *cpp past text where no match of code's program can start, using
+ * its DFA, or set *cpp to null if no match can start at or after *cpp.  Then
+ * MatchRegExp can begin from *cpp with the result it would have had from the
+ * original *cpp.
+ */
+static JSBool
+SkipToMatch(JSContext *cx, JSRECode *code, const jschar *cpbegin,
+	    const jschar **cpp, const jschar *cpend, JSBool multiline)
+{
+    const jschar *cp, *cp2, *ep, *ep2;
+    JSBool ok;
+
+    PR_ASSERT(!code->noDFA);
+    cp = *cpp;
+    JS_ACQUIRE_LOCK(regexp_lock);
+    ok = code->dfa || NewDFA(cx, code);
+    if (!ok)
+	goto out;
+    ok = RunDFA(cx, code, 0, cpbegin, cp, cpend, multiline, &ep);
+    if (!ok)
+	goto out;
+    if (!ep) {
+	cp = NULL;
+	goto out;
+    }
+
+    /*
+     * A match ends at ep, so one starts at or before it.  For an unanchored
+     * program, find the leftmost place where the rest of the program after
+     * its ANCHOR or ANCHOR1 can match, skipping places where its prefix or
+     * the char ANCHOR1 tests for can't.
+     */
+    if (code->anchorLength) {
+	for (cp2 = cp; cp2 <= ep; cp2++) {
+	    if (code->prefix) {
+		cp2 = FindPrefix(code, cpbegin, cp2, cpend);
+		if (!cp2 || cp2 > ep)
+		    break;
+	    }
+	    if (code->program[0] == REOP_ANCHOR1 &&
+		(cp2 == cpend || !MatchSingle(code->program + 1, *cp2))) {
+		continue;
+	    }
+	    ok = RunDFA(cx, code, code->anchorLength, cpbegin, cp2, cpend,
+			multiline, &ep2);
+	    if (!ok)
+		goto out;
+	    if (ep2) {
+		cp = cp2;
+		break;
+	    }
+	}
+    }
+
+out:
+    JS_RELEASE_LOCK(regexp_lock);
+    *cpp = cp;
+    return ok;
+}
+
 JSBool
 js_ExecuteRegExp(JSContext *cx, JSRegExp *re, JSString *str, size_t *indexp,
 		 JSBool test, jsval *rval)
 {
     size_t i, length, start;
+    JSRECode *code;
     MatchState state;
     jsbytecode *pc;
     const jschar *cp, *ep;
@@ -2551,13 +3670,18 @@ js_ExecuteRegExp(JSContext *cx, JSRegExp *re, JSString *str, size_t *indexp,
     JSObject *obj;
     JSProperty *prop;
 
+    /* Copy str's chars if it's a rope, as matching reads them in place. */
+    if (!JSSTRING_FLATTEN(cx, str))
+	return JS_FALSE;
+
     /*
      * Initialize a state struct to minimize recursive argument traffic.
      */
+    code = re->code;
     state.context = cx;
     state.anchoring = JS_FALSE;
-    pc = re->program;
-    state.pcend = pc + re->length;
+    pc = code->program;
+    state.pcend = pc + code->length;
 
     /*
      * It's safe to load from cp because JSStrings have a zero at the end,
@@ -2569,9 +3693,22 @@ js_ExecuteRegExp(JSContext *cx, JSRegExp *re, JSString *str, size_t *indexp,
     cp = str->chars + start;
     state.cpbegin = str->chars;
     state.cpend = str->chars + str->length;
-    state.start = start;
     state.skipped = 0;
 
+    /*
+     * Skip to where the program's literal prefix occurs, if it has one.
+     * MatchRegExp will then count chars it skips from the new start, so add
+     * this jump to state.skipped later.
+     */
+    if (code->prefix) {
+	cp = FindPrefix(code, state.cpbegin, cp, state.cpend);
+	if (!cp) {
+	    *rval = JSVAL_NULL;
+	    return JS_TRUE;
+	}
+    }
+    state.start = cp - state.cpbegin;
+
     /*
      * Use the temporary arena pool to grab space for parenthetical matches.
      * After the PR_ARENA_ALLOCATE early return on error, goto out to be sure
@@ -2593,12 +3730,40 @@ js_ExecuteRegExp(JSContext *cx, JSRegExp *re, JSString *str, size_t *indexp,
     /*
      * Call the recursive matcher to do the real work.  Return null on mismatch
      * whether testing or not.  On match, return an extended Array object.
+     *
+     * Backtracking can take time exponential in the length of str, so unless
+     * the program needs it for backreferences, give MatchRegExp a budget of
+     * calls.  If it spends them all, its result is unreliable: ask the DFA
+     * where a match starts, if one does, and run MatchRegExp from there.
      */
-    cp = MatchRegExp(&state, pc, cp);
+    state.budget = code->noDFA
+		   ? (size_t)-1
+		   : REGEXP_BUDGET(state.cpend - cp);
+    ep = MatchRegExp(&state, pc, cp);
+    if (state.budget == 0) {
+	if (!SkipToMatch(cx, code, state.cpbegin, &cp, state.cpend,
+			 cx->regExpStatics.multiline)) {
+	    ok = JS_FALSE;
+	    goto out;
+	}
+	ep = NULL;
+	if (cp) {
+	    memset(parsub, 0, length);
+	    state.anchoring = JS_FALSE;
+	    state.pcend = pc + code->length;
+	    state.start = cp - state.cpbegin;
+	    state.skipped = 0;
+	    state.parenCount = 0;
+	    state.budget = (size_t)-1;
+	    ep = MatchRegExp(&state, pc, cp);
+	}
+    }
+    cp = ep;
     if (!cp) {
 	*rval = JSVAL_NULL;
 	goto out;
     }
+    state.skipped += state.start - start;
     i = cp - state.cpbegin;
     *indexp = i;
     matchlen = i - (start + state.skipped);
@@ -2626,9 +3791,11 @@ js_ExecuteRegExp(JSContext *cx, JSRegExp *re, JSString *str, size_t *indexp,
 	*rval = OBJECT_TO_JSVAL(obj);
 
 #define DEFVAL(val, id) {                                                     \
-    if (!js_DefineProperty(cx, obj, id, val,                                  \
-			   JS_PropertyStub, JS_PropertyStub,                  \
-			   JSPROP_ENUMERATE)) {                               \
+    JS_LOCK_VOID(cx, prop = js_DefineProperty(cx, obj, id, val,               \
+					      JS_PropertyStub,                \
+					      JS_PropertyStub,                \
+					      JSPROP_ENUMERATE));             \
+    if (!prop) {                                                              \
 	cx->newborn[GCX_OBJECT] = NULL;                                       \
 	cx->newborn[GCX_STRING] = NULL;                                       \
 	ok = JS_FALSE;                                                        \
@@ -2684,9 +3851,10 @@ js_ExecuteRegExp(JSContext *cx, JSRegExp *re, JSString *str, size_t *indexp,
 		ok = JS_FALSE;
 		goto out;
 	    }
-	    prop = js_DefineProperty(cx, obj, INT_TO_JSVAL(num + 1),
-				     STRING_TO_JSVAL(parstr), NULL, NULL,
-				     JSPROP_ENUMERATE);
+	    JS_LOCK_VOID(cx,
+		prop = js_DefineProperty(cx, obj, INT_TO_JSVAL(num + 1),
+					 STRING_TO_JSVAL(parstr), NULL, NULL,
+					 JSPROP_ENUMERATE));
 	    if (!prop) {
 		cx->newborn[GCX_OBJECT] = NULL;
 		cx->newborn[GCX_STRING] = NULL;
@@ -3169,6 +4337,15 @@ js_InitRegExpClass(JSContext *cx, JSObject *obj)
     JSFunction *fun;
     JSObject *proto, *ctor;
 
+#ifdef JS_THREADSAFE
+    /* Must come through here once in primordial thread to init safely! */
+    if (!regexp_lock) {
+	regexp_lock = PR_NewLock();
+	if (!regexp_lock)
+	    return NULL;
+    }
+#endif
+
     fun = JS_NewFunction(cx, regexp_execWrapper, 0, 0, NULL, "execWrapper");
     if (!fun)
 	return NULL;
@@ -51,15 +51,21 @@ struct JSRegExpStatics {
        : &(res)->moreParens[(num) - 9]                                        \
      : &js_EmptySubString)
 
+/*
+ * A JSRegExp's compiled program lives in a JSRECode that is shared by every
+ * regexp with the same source and flags, through a per-runtime cache.
+ */
 struct JSRegExp {
     JSString    *source;        /* locked source string, sans // */
-    size_t      length;         /* program length in bytes */
     size_t      lastIndex;      /* index after last match, for //g iterator */
     uintN       parenCount;     /* number of parenthesized submatches */
     uint8       flags;          /* flags, see jsapi.h */
-    jsbytecode  program[1];     /* regular expression bytecode */
+    JSRECode    *code;          /* shared program, see jsregexp.c */
 };
 
+#define REGEXP_CACHE_LOG2   6
+#define REGEXP_CACHE_SIZE   PR_BIT(REGEXP_CACHE_LOG2)
+
 extern JSRegExp *
 js_NewRegExp(JSContext *cx, JSString *str, uintN flags);
 
@@ -69,6 +75,22 @@ js_NewRegExpOpt(JSContext *cx, JSString *str, JSString *opt);
 extern void
 js_DestroyRegExp(JSContext *cx, JSRegExp *re);
 
+/*
+ * Release the compiled programs held by rt's regexp cache.
+ */
+extern void
+js_FinishRegExpCache(JSRuntime *rt);
+
+/*
+ * Return the malloc'd bytes re uses, or rt's regexp cache holds, counting
+ * an equal share of each compiled program for every user.
+ */
+extern size_t
+js_GetRegExpBytes(JSRegExp *re);
+
+extern size_t
+js_GetRegExpCacheBytes(JSRuntime *rt);
+
 /*
  * Execute re on input str at *indexp, returning null in *rval on mismatch.
  * On match, return true if test is true, otherwise return an array object.
@@ -209,6 +209,8 @@ js_CloseTokenStream(JSContext *cx, JSTokenStream *ts)
 {
     if (ts->principals)
         JSPRINCIPALS_DROP(cx, ts->principals);
+    if (ts->capturebuf.base)
+	free(ts->capturebuf.base);
 #ifdef JSFILE
     return !ts->file || fclose(ts->file) == 0;
 #else
@@ -216,6 +218,64 @@ js_CloseTokenStream(JSContext *cx, JSTokenStream *ts)
 #endif
 }
 
+#define CBINCR         256
+
+static void
+CaptureChar(JSTokenStream *ts, jschar c)
+{
+    JSTokenBuf *cb;
+    ptrdiff_t length;
+    jschar *base;
+
+    cb = &ts->capturebuf;
+    if (cb->ptr == cb->limit) {
+	length = cb->limit - cb->base;
+	length = length ? 2 * length : CBINCR;
+	base = realloc(cb->base, length * sizeof(jschar));
+	if (!base) {
+	    ts->flags &= ~TSF_CAPTURE;
+	    ts->flags |= TSF_CAPTURE_OOM;
+	    return;
+	}
+	cb->ptr = base + (cb->ptr - cb->base);
+	cb->base = base;
+	cb->limit = base + length;
+    }
+    *cb->ptr++ = c;
+}
+
+void
+js_StartCapture(JSTokenStream *ts)
+{
+    PR_ASSERT(!(ts->flags & (TSF_CAPTURE | TSF_CAPTURE_OOM)));
+    ts->capturebuf.ptr = ts->capturebuf.base;
+    ts->flags |= TSF_CAPTURE;
+}
+
+jschar *
+js_StopCapture(JSContext *cx, JSTokenStream *ts, size_t *lengthp)
+{
+    jschar *chars;
+
+    if (ts->flags & TSF_CAPTURE_OOM) {
+	ts->flags &= ~TSF_CAPTURE_OOM;
+	JS_ReportOutOfMemory(cx);
+	return NULL;
+    }
+    ts->flags &= ~TSF_CAPTURE;
+    chars = ts->capturebuf.base;
+    if (!chars) {
+	chars = malloc(sizeof(jschar));
+	if (!chars) {
+	    JS_ReportOutOfMemory(cx);
+	    return NULL;
+	}
+    }
+    *lengthp = ts->capturebuf.ptr - chars;
+    ts->capturebuf.base = ts->capturebuf.limit = ts->capturebuf.ptr = NULL;
+    return chars;
+}
+
 static int32
 GetChar(JSTokenStream *ts)
 {
@@ -298,6 +358,8 @@ GetChar(JSTokenStream *ts)
     }
     if (c == '\n')
 	ts->lineno++;
+    if (ts->flags & TSF_CAPTURE)
+	CaptureChar(ts, (jschar)c);
     return c;
 }
 
@@ -309,6 +371,10 @@ UngetChar(JSTokenStream *ts, int32 c)
     PR_ASSERT(ts->ungetpos < sizeof ts->ungetbuf / sizeof ts->ungetbuf[0]);
     if (c == '\n')
 	ts->lineno--;
+    if (ts->flags & TSF_CAPTURE) {
+	PR_ASSERT(ts->capturebuf.ptr > ts->capturebuf.base);
+	ts->capturebuf.ptr--;
+    }
     ts->ungetbuf[ts->ungetpos++] = (jschar)c;
 }
 
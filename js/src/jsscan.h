@@ -116,6 +116,8 @@ struct JSTokenStream {
     JSTokenBuf          linebuf;        /* line buffer for diagnostics */
     JSTokenBuf          userbuf;        /* user input buffer if !file */
     JSTokenBuf          tokenbuf;       /* current token string buffer */
+    JSTokenBuf          capturebuf;     /* malloc'd copy of chars scanned
+                                           while TSF_CAPTURE is set */
     const char          *filename;      /* input filename or null */
 #ifdef JSFILE
     FILE                *file;          /* stdio stream if reading from file */
@@ -134,6 +136,8 @@ struct JSTokenStream {
 #define TSF_COMMAND     0x0080          /* command parsing mode */
 #define TSF_LOOKAHEAD   0x0100          /* looking ahead for a token */
 #define TSF_REGEXP      0x0200          /* looking for a regular expression */
+#define TSF_CAPTURE     0x0400          /* copying chars into capturebuf */
+#define TSF_CAPTURE_OOM 0x0800          /* capturebuf could not grow */
 
 /*
  * At most one non-EOF token can be pushed back onto a TokenStream between
@@ -177,6 +181,18 @@ js_NewFileTokenStream(JSContext *cx, const char *filename);
 extern JS_FRIEND_API(JSBool)
 js_CloseTokenStream(JSContext *cx, JSTokenStream *ts);
 
+/*
+ * Start copying the chars that ts scans into a malloc'd buffer, or stop and
+ * return the buffer, storing its length in *lengthp.  js_StopCapture reports
+ * and returns null if the buffer could not grow; else the caller must free
+ * the chars.  Only one capture may be active at a time.
+ */
+extern void
+js_StartCapture(JSTokenStream *ts);
+
+extern jschar *
+js_StopCapture(JSContext *cx, JSTokenStream *ts, size_t *lengthp);
+
 /*
  * Initialize the scanner, installing JS keywords into cx's global scope.
  */
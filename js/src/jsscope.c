@@ -19,6 +19,7 @@
 /*
  * JS symbol tables.
  */
+#include <stdlib.h>
 #include <string.h>
 #include "prtypes.h"
 #include "prlog.h"
@@ -44,239 +45,559 @@ js_hash_id(const void *key)
     return atom->number;
 }
 
-PR_STATIC_CALLBACK(void *)
-js_alloc_scope_space(void *priv, size_t size)
-{
-    return JS_malloc(priv, size);
-}
-
-PR_STATIC_CALLBACK(void)
-js_free_scope_space(void *priv, void *item)
+static JSSymbol *
+js_NewSymbol(JSContext *cx, JSScope *scope, jsval id)
 {
-    JS_free(priv, item);
-}
-
-PR_STATIC_CALLBACK(PRHashEntry *)
-js_alloc_symbol(void *priv, const void *key)
-{
-    JSContext *cx;
     JSSymbol *sym;
-    JSAtom *atom;
 
-    cx = priv;
     PR_ASSERT(JS_IS_LOCKED(cx));
     sym = JS_malloc(cx, sizeof(JSSymbol));
     if (!sym)
 	return NULL;
-    sym->entry.key = key;
-    if (!JSVAL_IS_INT((jsval)key)) {
-	atom = (JSAtom *)key;
-	js_HoldAtom(cx, atom);
-    }
-    return &sym->entry;
+    sym->id = id;
+    sym->property = NULL;
+    sym->scope = scope;
+    sym->next = NULL;
+    sym->link = NULL;
+    if (!JSVAL_IS_INT(id))
+	js_HoldAtom(cx, (JSAtom *)id);
+    return sym;
 }
 
-PR_STATIC_CALLBACK(void)
-js_free_symbol(void *priv, PRHashEntry *he, uintN flag)
+/*
+ * Unbind sym from its property, if any, and if destroy is true, free it.
+ */
+static void
+js_FreeSymbol(JSContext *cx, JSSymbol *sym, JSBool destroy)
 {
-    JSContext *cx;
-    JSSymbol *sym, **sp;
+    JSSymbol **sp;
     JSProperty *prop;
 
-    cx = priv;
     PR_ASSERT(JS_IS_LOCKED(cx));
-    sym = (JSSymbol *)he;
-    prop = sym->entry.value;
+    prop = sym->property;
     if (prop) {
-	sym->entry.value = NULL;
+	sym->property = NULL;
 	prop = js_DropProperty(cx, prop);
 	if (prop) {
 	    for (sp = &prop->symbols; *sp; sp = &(*sp)->next) {
 		if (*sp == sym) {
 		    *sp = sym->next;
-		    if (!*sp)
-			break;
+		    break;
 		}
 	    }
 	    sym->next = NULL;
 	}
     }
 
-    if (flag == HT_FREE_ENTRY) {
+    if (destroy) {
 	if (!JSVAL_IS_INT(sym_id(sym)))
 	    JS_LOCK_VOID(cx, js_DropAtom(cx, sym_atom(sym)));
-	JS_free(cx, he);
+	JS_free(cx, sym);
     }
 }
 
-static PRHashAllocOps hash_scope_alloc_ops = {
-    js_alloc_scope_space, js_free_scope_space,
-    js_alloc_symbol, js_free_symbol
+/************************************************************************/
+
+/*
+ * Shape transition table, mapping (parent shape, added property) to the
+ * child shape.  Entries are malloc'd rather than JS_malloc'd so the table
+ * can be destroyed by JS_Finish without a context.
+ */
+#define SHAPE_TABLE_LOG2        8
+#define SHAPE_TABLE_LIMIT       PR_BIT(14)
+
+typedef struct JSShapeEntry {
+    PRHashEntry     entry;
+    uint64          parent;             /* shape before the add */
+    jsval           id;                 /* symbol id, or class for an empty
+					   scope's base shape */
+    jsval           propid;             /* id passed to getter and setter */
+    JSPropertyOp    getter;
+    JSPropertyOp    setter;
+    uint32          slot;
+    uintN           flags;
+    uint64          shape;              /* shape after the add */
+} JSShapeEntry;
+
+PR_STATIC_CALLBACK(PRHashNumber)
+js_hash_shape(const void *key)
+{
+    const JSShapeEntry *se = key;
+    uint64 high;
+    PRHashNumber lo, hi;
+
+    LL_SHR(high, se->parent, 32);
+    LL_L2UI(hi, high);
+    LL_L2UI(lo, se->parent);
+    return (lo << 8) ^ (lo >> 24) ^ hi ^ (PRHashNumber)se->id
+	   ^ (se->slot << 4) ^ se->flags;
+}
+
+PR_STATIC_CALLBACK(intN)
+js_compare_shapes(const void *v1, const void *v2)
+{
+    const JSShapeEntry *se1 = v1, *se2 = v2;
+
+    return LL_EQ(se1->parent, se2->parent) &&
+	   se1->id == se2->id &&
+	   se1->propid == se2->propid &&
+	   se1->getter == se2->getter &&
+	   se1->setter == se2->setter &&
+	   se1->slot == se2->slot &&
+	   se1->flags == se2->flags;
+}
+
+PR_STATIC_CALLBACK(void *)
+js_alloc_shape_space(void *priv, size_t size)
+{
+    return malloc(size);
+}
+
+PR_STATIC_CALLBACK(void)
+js_free_shape_space(void *priv, void *item)
+{
+    free(item);
+}
+
+PR_STATIC_CALLBACK(PRHashEntry *)
+js_alloc_shape(void *priv, const void *key)
+{
+    JSShapeEntry *se;
+
+    se = malloc(sizeof(JSShapeEntry));
+    if (!se)
+	return NULL;
+    *se = *(const JSShapeEntry *)key;
+    return &se->entry;
+}
+
+PR_STATIC_CALLBACK(void)
+js_free_shape(void *priv, PRHashEntry *he, uintN flag)
+{
+    if (flag == HT_FREE_ENTRY)
+	free(he);
+}
+
+static PRHashAllocOps shape_table_alloc_ops = {
+    js_alloc_shape_space, js_free_shape_space,
+    js_alloc_shape, js_free_shape
 };
 
-/************************************************************************/
+static uint64
+js_NewShape(JSRuntime *rt)
+{
+    uint64 one;
 
-PR_STATIC_CALLBACK(JSSymbol *)
-js_hash_scope_lookup(JSContext *cx, JSScope *scope, jsval id, PRHashNumber hash)
+    LL_UI2L(one, 1);
+    LL_ADD(rt->shapeGen, rt->shapeGen, one);
+    return rt->shapeGen;
+}
+
+/*
+ * Return the shape of a scope with shape parent after adding a symbol for id
+ * bound to prop, which may be null.
+ */
+static uint64
+js_ExtendShape(JSContext *cx, uint64 parent, jsval id, JSProperty *prop)
 {
-    PRHashTable *table = scope->data;
-    PRHashEntry **hep;
-    JSSymbol *sym;
+    JSRuntime *rt;
+    JSShapeEntry key;
+    PRHashNumber keyHash;
+    PRHashEntry **hep, *he;
+
+    PR_ASSERT(JS_IS_LOCKED(cx));
+    rt = cx->runtime;
+    if (!rt->shapeTable) {
+	rt->shapeTable = PR_NewHashTable(PR_BIT(SHAPE_TABLE_LOG2),
+					 js_hash_shape, js_compare_shapes,
+					 PR_CompareValues,
+					 &shape_table_alloc_ops, NULL);
+	if (!rt->shapeTable)
+	    return js_NewShape(rt);
+    }
+
+    key.parent = parent;
+    key.id = id;
+    if (prop) {
+	key.propid = prop->id;
+	key.getter = prop->getter;
+	key.setter = prop->setter;
+	key.slot = prop->slot;
+	key.flags = prop->flags;
+    } else {
+	key.propid = JSVAL_VOID;
+	key.getter = key.setter = NULL;
+	key.slot = 0;
+	key.flags = 0;
+    }
+    keyHash = js_hash_shape(&key);
+    hep = PR_HashTableRawLookup(rt->shapeTable, keyHash, &key);
+    he = *hep;
+    if (he)
+	return ((JSShapeEntry *)he)->shape;
+
+    key.shape = js_NewShape(rt);
+    he = PR_HashTableRawAdd(rt->shapeTable, hep, keyHash, &key, NULL);
+    if (he)
+	he->key = he;
+    return key.shape;
+}
 
-    hep = PR_HashTableRawLookup(table, hash, (const void *)id);
-    sym = (JSSymbol *) *hep;
+void
+js_ChangeScopeShape(JSContext *cx, JSScope *scope)
+{
+    uint64 shape;
+
+    shape = js_NewShape(cx->runtime);
+    JS_LOCK_SCOPE(cx, scope);
+    scope->shape = shape;
+    JS_UNLOCK_SCOPE(cx, scope);
+}
+
+/*
+ * Called by the GC.  Scopes keep their shapes, but once the table is big
+ * enough, scopes built later get new shapes rather than sharing those.
+ */
+void
+js_SweepScopeShapes(JSContext *cx)
+{
+    JSRuntime *rt;
+
+    rt = cx->runtime;
+    if (rt->shapeTable && rt->shapeTable->nentries >= SHAPE_TABLE_LIMIT) {
+	PR_HashTableDestroy(rt->shapeTable);
+	rt->shapeTable = NULL;
+    }
+}
+
+/* Give scope the shape it has after adding a symbol for id bound to prop. */
+static void
+js_ExtendScopeShape(JSContext *cx, JSScope *scope, jsval id, JSProperty *prop)
+{
+    uint64 shape;
+
+    shape = js_ExtendShape(cx, scope->shape, id, prop);
+    JS_LOCK_SCOPE(cx, scope);
+    scope->shape = shape;
+    JS_UNLOCK_SCOPE(cx, scope);
+}
+
+/* Bind sym, which has no property, to prop, which may be null. */
+static JSSymbol *
+js_BindSymbol(JSContext *cx, JSSymbol *sym, JSProperty *prop)
+{
+    JSSymbol **sp;
+
+    if (prop) {
+	sym->property = js_HoldProperty(cx, prop);
+	for (sp = &prop->symbols; *sp; sp = &(*sp)->next)
+	    ;
+	*sp = sym;
+    } else {
+	sym->property = NULL;
+    }
     return sym;
 }
 
-#define SCOPE_ADD(CLASS_SPECIFIC_CODE)                                        \
-    PR_BEGIN_MACRO                                                            \
-	if (sym) {                                                            \
-	    if (sym->entry.value == prop)                                     \
-		return sym;                                                   \
-	    if (sym->entry.value)                                             \
-		js_free_symbol(cx, &sym->entry, HT_FREE_VALUE);               \
-	} else {                                                              \
-	    CLASS_SPECIFIC_CODE                                               \
-	    sym->scope = scope;                                               \
-	    sym->next = NULL;                                                 \
-	}                                                                     \
-	if (prop) {                                                           \
-	    sym->entry.value = js_HoldProperty(cx, prop);                     \
-	    for (sp = &prop->symbols; *sp; sp = &(*sp)->next)                 \
-		;                                                             \
-	    *sp = sym;                                                        \
-	} else {                                                              \
-	    sym->entry.value = NULL;                                          \
-	}                                                                     \
-    PR_END_MACRO
+/* Rebind sym, already in scope, to prop unless it is bound to prop. */
+static JSSymbol *
+js_RebindSymbol(JSContext *cx, JSScope *scope, JSSymbol *sym,
+		JSProperty *prop)
+{
+    if (sym->property == prop)
+	return sym;
+    if (sym->property)
+	js_FreeSymbol(cx, sym, JS_FALSE);
+    js_ChangeScopeShape(cx, scope);
+    return js_BindSymbol(cx, sym, prop);
+}
+
+/************************************************************************/
+
+#define SCOPE_GOLDEN_RATIO      0x9E3779B9U
+#define SCOPE_MIN_SIZE_LOG2     3
+#define SCOPE_MAX_SIZE_LOG2     24
+
+/* Grow or compress when live plus removed entries fill 3/4 of the table. */
+#define SCOPE_OVERLOADED(table, size)                                         \
+    ((table)->entryCount + (table)->removedCount >= (size) - ((size) >> 2))
+
+/* Shrink when no more than 1/4 of the table is live. */
+#define SCOPE_UNDERLOADED(table, size)                                        \
+    ((size) > PR_BIT(SCOPE_MIN_SIZE_LOG2) &&                                  \
+     (table)->entryCount <= ((size) >> 2))
+
+/*
+ * Find the entry for id in table, probing by double hashing.  If there's no
+ * such entry, return the free one that ends its probe sequence, or when
+ * adding, the first removed entry along the sequence, if any.
+ *
+ * Ids hash to int indexes or atom numbers, which are mostly small and dense,
+ * so the first probe uses the low bits of keyHash unscrambled: sequential
+ * ids fill adjacent entries without colliding.  The probe step is taken from
+ * the golden-ratio scrambled hash, so ids that collide because they share
+ * low bits, e.g. indexes with a power-of-two stride, go separate ways.
+ */
+static JSScopeEntry *
+js_SearchScopeTable(JSScopeTable *table, jsval id, PRHashNumber keyHash,
+		    JSBool adding)
+{
+    intN hashShift, sizeLog2;
+    PRHashNumber hash1, hash2;
+    uint32 sizeMask;
+    JSScopeEntry *e, *firstRemoved;
+
+    hashShift = table->hashShift;
+    sizeLog2 = 32 - hashShift;
+    sizeMask = PR_BITMASK(sizeLog2);
+    hash1 = keyHash & sizeMask;
+    e = &table->entries[hash1];
+    if (!e->sym || e->id == id)
+	return e;
+
+    hash2 = ((keyHash * SCOPE_GOLDEN_RATIO) >> hashShift) | 1;
+    firstRemoved = NULL;
+    for (;;) {
+	if (adding && e->sym == SYM_REMOVED && !firstRemoved)
+	    firstRemoved = e;
+	hash1 = (hash1 - hash2) & sizeMask;
+	e = &table->entries[hash1];
+	if (!e->sym)
+	    return firstRemoved ? firstRemoved : e;
+	if (e->id == id)
+	    return e;
+    }
+}
+
+static JSScopeTable *
+js_NewScopeTable(JSContext *cx, intN sizeLog2)
+{
+    size_t nbytes;
+    JSScopeTable *table;
+
+    nbytes = sizeof(JSScopeTable)
+	   + (PR_BIT(sizeLog2) - 1) * sizeof(JSScopeEntry);
+    table = JS_malloc(cx, nbytes);
+    if (!table)
+	return NULL;
+    memset(table, 0, nbytes);
+    table->hashShift = (int16)(32 - sizeLog2);
+    return table;
+}
+
+/*
+ * Rebuild scope's table with deltaLog2 times as many entries, dropping any
+ * removed ones.  The symbols don't move, so pointers to them stay valid.
+ */
+static JSBool
+js_ChangeScopeTable(JSContext *cx, JSScope *scope, intN deltaLog2)
+{
+    JSScopeTable *oldtable, *newtable;
+    uint32 oldsize, i;
+    JSScopeEntry *olde, *newe;
+
+    oldtable = scope->data;
+    oldsize = SCOPE_TABLE_SIZE(oldtable);
+    newtable = js_NewScopeTable(cx, 32 - oldtable->hashShift + deltaLog2);
+    if (!newtable)
+	return JS_FALSE;
+    newtable->entryCount = oldtable->entryCount;
+    for (i = 0, olde = oldtable->entries; i < oldsize; i++, olde++) {
+	if (SCOPE_ENTRY_IS_LIVE(olde)) {
+	    newe = js_SearchScopeTable(newtable, olde->id, olde->keyHash,
+				       JS_FALSE);
+	    *newe = *olde;
+	}
+    }
+    scope->data = newtable;
+    JS_free(cx, oldtable);
+    return JS_TRUE;
+}
 
 PR_STATIC_CALLBACK(JSSymbol *)
-js_hash_scope_add(JSContext *cx, JSScope *scope, jsval id, JSProperty *prop)
+js_table_scope_lookup(JSContext *cx, JSScope *scope, jsval id,
+		      PRHashNumber hash)
 {
-    PRHashTable *table = scope->data;
-    const void *key;
+    JSScopeTable *table = scope->data;
+    JSScopeEntry *e;
+
+    if (!table)
+	return NULL;
+    e = js_SearchScopeTable(table, id, hash, JS_FALSE);
+    return e->sym;
+}
+
+PR_STATIC_CALLBACK(JSSymbol *)
+js_table_scope_add(JSContext *cx, JSScope *scope, jsval id, JSProperty *prop)
+{
+    JSScopeTable *table;
     PRHashNumber keyHash;
-    PRHashEntry **hep;
-    JSSymbol *sym, **sp;
+    JSScopeEntry *e;
+    uint32 size;
+    intN deltaLog2;
+    JSSymbol *sym;
 
     PR_ASSERT(JS_IS_LOCKED(cx));
-    table->allocPriv = cx;
-    key = (const void *)id;
-    keyHash = js_hash_id(key);
-    hep = PR_HashTableRawLookup(table, keyHash, key);
-    sym = (JSSymbol *) *hep;
-    SCOPE_ADD(
-	sym = (JSSymbol *) PR_HashTableRawAdd(table, hep, keyHash, key, NULL);
-	if (!sym)
+    table = scope->data;
+    if (!table) {
+	table = js_NewScopeTable(cx, SCOPE_MIN_SIZE_LOG2);
+	if (!table)
 	    return NULL;
-    );
-    return sym;
+	scope->data = table;
+    }
+
+    keyHash = js_hash_id((const void *)id);
+    e = js_SearchScopeTable(table, id, keyHash, JS_TRUE);
+    sym = e->sym;
+    if (SCOPE_ENTRY_IS_LIVE(e))
+	return js_RebindSymbol(cx, scope, sym, prop);
+
+    /* Make room before adding, compressing if enough entries are free. */
+    if (!sym) {
+	size = SCOPE_TABLE_SIZE(table);
+	if (SCOPE_OVERLOADED(table, size)) {
+	    deltaLog2 = (table->removedCount >= (size >> 2)) ? 0 : 1;
+	    if (deltaLog2 && 32 - table->hashShift >= SCOPE_MAX_SIZE_LOG2) {
+		JS_ReportOutOfMemory(cx);
+		return NULL;
+	    }
+	    if (!js_ChangeScopeTable(cx, scope, deltaLog2))
+		return NULL;
+	    table = scope->data;
+	    e = js_SearchScopeTable(table, id, keyHash, JS_TRUE);
+	}
+    }
+    sym = js_NewSymbol(cx, scope, id);
+    if (!sym)
+	return NULL;
+    if (e->sym == SYM_REMOVED)
+	table->removedCount--;
+    e->keyHash = keyHash;
+    e->id = id;
+    e->sym = sym;
+    table->entryCount++;
+    js_ExtendScopeShape(cx, scope, id, prop);
+    return js_BindSymbol(cx, sym, prop);
 }
 
 PR_STATIC_CALLBACK(JSBool)
-js_hash_scope_remove(JSContext *cx, JSScope *scope, jsval id)
+js_table_scope_remove(JSContext *cx, JSScope *scope, jsval id)
 {
-    PRHashTable *table = scope->data;
+    JSScopeTable *table = scope->data;
+    JSScopeEntry *e;
+    JSSymbol *sym;
+    uint32 size;
 
     PR_ASSERT(JS_IS_LOCKED(cx));
-    table->allocPriv = cx;
-    return PR_HashTableRemove(table, (const void *)id);
+    if (!table)
+	return JS_FALSE;
+    e = js_SearchScopeTable(table, id,
+			    js_hash_id((const void *)id),
+			    JS_FALSE);
+    if (!SCOPE_ENTRY_IS_LIVE(e))
+	return JS_FALSE;
+    sym = e->sym;
+    e->id = 0;
+    e->sym = SYM_REMOVED;
+    table->entryCount--;
+    table->removedCount++;
+    js_FreeSymbol(cx, sym, JS_TRUE);
+    js_ChangeScopeShape(cx, scope);
+
+    /* Shrink if mostly empty; failure just leaves the table as it was. */
+    size = SCOPE_TABLE_SIZE(table);
+    if (SCOPE_UNDERLOADED(table, size))
+	(void) js_ChangeScopeTable(cx, scope, -1);
+    return JS_TRUE;
 }
 
-/* Forward declaration for use by js_hash_scope_clear(). */
-extern JSScopeOps js_list_scope_ops;
-
 PR_STATIC_CALLBACK(void)
-js_hash_scope_clear(JSContext *cx, JSScope *scope)
+js_table_scope_clear(JSContext *cx, JSScope *scope)
 {
-    PRHashTable *table = scope->data;
+    JSScopeTable *table = scope->data;
+    uint32 size, i;
+    JSScopeEntry *e;
 
     PR_ASSERT(JS_IS_LOCKED(cx));
-    table->allocPriv = cx;
-    PR_HashTableDestroy(table);
+    if (table) {
+	size = SCOPE_TABLE_SIZE(table);
+	for (i = 0, e = table->entries; i < size; i++, e++) {
+	    if (SCOPE_ENTRY_IS_LIVE(e))
+		js_FreeSymbol(cx, e->sym, JS_TRUE);
+	}
+	scope->data = NULL;
+	JS_free(cx, table);
+    }
     scope->ops = &js_list_scope_ops;
-    scope->data = NULL;
+    js_ChangeScopeShape(cx, scope);
 }
 
-JSScopeOps js_hash_scope_ops = {
-    js_hash_scope_lookup,
-    js_hash_scope_add,
-    js_hash_scope_remove,
-    js_hash_scope_clear
+JSScopeOps js_table_scope_ops = {
+    js_table_scope_lookup,
+    js_table_scope_add,
+    js_table_scope_remove,
+    js_table_scope_clear
 };
 
 /************************************************************************/
 
 PR_STATIC_CALLBACK(JSSymbol *)
-js_list_scope_lookup(JSContext *cx, JSScope *scope, jsval id, PRHashNumber hash)
+js_list_scope_lookup(JSContext *cx, JSScope *scope, jsval id,
+		     PRHashNumber hash)
 {
-    JSSymbol *sym, **sp;
+    JSSymbol *sym;
 
-    for (sp = (JSSymbol **)&scope->data; (sym = *sp) != 0;
-	 sp = (JSSymbol **)&sym->entry.next) {
-	if (sym_id(sym) == id) {
-	    /* Move sym to the front for shorter searches. */
-	    *sp = (JSSymbol *)sym->entry.next;
-	    sym->entry.next = scope->data;
-	    scope->data = sym;
+    for (sym = scope->data; sym; sym = sym->link) {
+	if (sym_id(sym) == id)
 	    return sym;
-	}
     }
     return NULL;
 }
 
-#define HASH_THRESHOLD	5
-
 PR_STATIC_CALLBACK(JSSymbol *)
 js_list_scope_add(JSContext *cx, JSScope *scope, jsval id, JSProperty *prop)
 {
-    JSSymbol *list = scope->data;
     uint32 nsyms;
-    JSSymbol *sym, *next, **sp;
-    PRHashTable *table;
-    PRHashEntry **hep;
+    JSSymbol *sym, *next;
+    JSScopeTable *table;
+    PRHashNumber keyHash;
+    JSScopeEntry *e;
 
     PR_ASSERT(JS_IS_LOCKED(cx));
     nsyms = 0;
-    for (sym = list; sym; sym = (JSSymbol *)sym->entry.next) {
+    for (sym = scope->data; sym; sym = sym->link) {
 	if (sym_id(sym) == id)
-	    break;
+	    return js_RebindSymbol(cx, scope, sym, prop);
 	nsyms++;
     }
 
-    if (nsyms >= HASH_THRESHOLD) {
-	table = PR_NewHashTable(nsyms, js_hash_id,
-			        PR_CompareValues, PR_CompareValues,
-			        &hash_scope_alloc_ops, cx);
-	if (table) {
-	    for (sym = list; sym; sym = next) {
-		/* Save next for loop update, before it changes in lookup. */
-		next = (JSSymbol *)sym->entry.next;
-
-		/* Now compute missing keyHash fields. */
-		sym->entry.keyHash = js_hash_id(sym->entry.key);
-		sym->entry.next = NULL;
-		hep = PR_HashTableRawLookup(table,
-					    sym->entry.keyHash,
-					    sym->entry.key);
-		*hep = &sym->entry;
-	    }
-	    table->nentries = nsyms;
-	    scope->ops = &js_hash_scope_ops;
-	    scope->data = table;
-	    return scope->ops->add(cx, scope, id, prop);
+    /* The smallest table holds SCOPE_LIST_MAX + 1 symbols without growing. */
+    if (nsyms >= SCOPE_LIST_MAX) {
+	table = js_NewScopeTable(cx, SCOPE_MIN_SIZE_LOG2);
+	if (!table)
+	    return NULL;
+	for (sym = scope->data; sym; sym = next) {
+	    next = sym->link;
+	    sym->link = NULL;
+	    keyHash = js_hash_id((const void *)sym_id(sym));
+	    e = js_SearchScopeTable(table, sym_id(sym), keyHash, JS_FALSE);
+	    e->keyHash = keyHash;
+	    e->id = sym_id(sym);
+	    e->sym = sym;
 	}
+	table->entryCount = nsyms;
+	scope->ops = &js_table_scope_ops;
+	scope->data = table;
+	return js_table_scope_add(cx, scope, id, prop);
     }
 
-    SCOPE_ADD(
-	sym = (JSSymbol *)js_alloc_symbol(cx, (const void *)id);
-	if (!sym)
-	    return NULL;
-	/* Don't set keyHash until we know we need it, above. */
-	sym->entry.next = scope->data;
-	scope->data = sym;
-    );
-    return sym;
+    sym = js_NewSymbol(cx, scope, id);
+    if (!sym)
+	return NULL;
+    sym->link = scope->data;
+    scope->data = sym;
+    js_ExtendScopeShape(cx, scope, id, prop);
+    return js_BindSymbol(cx, sym, prop);
 }
 
 PR_STATIC_CALLBACK(JSBool)
@@ -285,11 +606,12 @@ js_list_scope_remove(JSContext *cx, JSScope *scope, jsval id)
     JSSymbol *sym, **sp;
 
     PR_ASSERT(JS_IS_LOCKED(cx));
-    for (sp = (JSSymbol **)&scope->data; (sym = *sp) != 0;
-	 sp = (JSSymbol **)&sym->entry.next) {
+    for (sp = (JSSymbol **)&scope->data; (sym = *sp) != NULL;
+	 sp = &sym->link) {
 	if (sym_id(sym) == id) {
-	    *sp = (JSSymbol *)sym->entry.next;
-	    js_free_symbol(cx, &sym->entry, HT_FREE_ENTRY);
+	    *sp = sym->link;
+	    js_FreeSymbol(cx, sym, JS_TRUE);
+	    js_ChangeScopeShape(cx, scope);
 	    return JS_TRUE;
 	}
     }
@@ -303,9 +625,10 @@ js_list_scope_clear(JSContext *cx, JSScope *scope)
 
     PR_ASSERT(JS_IS_LOCKED(cx));
     while ((sym = scope->data) != NULL) {
-	scope->data = sym->entry.next;
-	js_free_symbol(cx, &sym->entry, HT_FREE_ENTRY);
+	scope->data = sym->link;
+	js_FreeSymbol(cx, sym, JS_TRUE);
     }
+    js_ChangeScopeShape(cx, scope);
 }
 
 JSScopeOps js_list_scope_ops = {
@@ -329,7 +652,9 @@ js_GetMutableScope(JSContext *cx, JSObject *obj)
     newscope = js_NewScope(cx, obj->map->clasp, obj);
     if (!newscope)
 	return NULL;
+    JS_LOCK_SCOPE(cx, scope);
     obj->map = (JSObjectMap *)js_HoldScope(cx, newscope);
+    JS_UNLOCK_SCOPE(cx, scope);
     js_DropScope(cx, scope);
     return newscope;
 }
@@ -349,6 +674,18 @@ js_scope_compare(const void *v1, const void *v2)
 {
 }
 
+PR_STATIC_CALLBACK(void *)
+js_alloc_scope_space(void *priv, size_t size)
+{
+    return JS_malloc(priv, size);
+}
+
+PR_STATIC_CALLBACK(void)
+js_free_scope_space(void *priv, void *item)
+{
+    JS_free(priv, item);
+}
+
 PR_STATIC_CALLBACK(PRHashEntry *)
 js_alloc_scope(void *priv, const void *key)
 {
@@ -390,6 +727,7 @@ JSScope *
 js_NewScope(JSContext *cx, JSClass *clasp, JSObject *obj)
 {
     JSScope *scope;
+    uint64 noshape;
 #if SCOPE_TABLE
     PRHashEntry *he, **hep;
 
@@ -424,6 +762,13 @@ js_NewScope(JSContext *cx, JSClass *clasp, JSObject *obj)
     scope->proptail = &scope->map.props;
     scope->ops = &js_list_scope_ops;
     scope->data = NULL;
+#ifdef JS_THREADSAFE
+    scope->ownercx = cx;
+    scope->lock = 0;
+#endif
+    LL_UI2L(noshape, SHAPE_INVALID);
+    JS_LOCK_VOID(cx, scope->shape = js_ExtendShape(cx, noshape,
+						  (jsval)clasp, NULL));
     return scope;
 }
 
@@ -463,6 +808,44 @@ js_DropScope(JSContext *cx, JSScope *scope)
     return scope;
 }
 
+size_t
+js_GetScopeBytes(JSScope *scope)
+{
+    size_t nbytes;
+    JSScopeTable *table;
+    JSSymbol *sym;
+    JSProperty *prop;
+
+    nbytes = sizeof(JSScope);
+    if (scope->ops == &js_list_scope_ops) {
+	for (sym = scope->data; sym; sym = sym->link)
+	    nbytes += sizeof(JSSymbol);
+    } else if (scope->ops == &js_table_scope_ops) {
+	table = scope->data;
+	if (table) {
+	    nbytes += sizeof(JSScopeTable)
+		    + (SCOPE_TABLE_SIZE(table) - 1) * sizeof(JSScopeEntry)
+		    + table->entryCount * sizeof(JSSymbol);
+	}
+    }
+    for (prop = scope->map.props; prop; prop = prop->next)
+	nbytes += sizeof(JSProperty);
+    return nbytes;
+}
+
+size_t
+js_GetShapeTableBytes(JSRuntime *rt)
+{
+    PRHashTable *table;
+
+    table = rt->shapeTable;
+    if (!table)
+	return 0;
+    return sizeof *table
+	   + PR_BIT(32 - table->shift) * sizeof(PRHashEntry *)
+	   + table->nentries * sizeof(JSShapeEntry);
+}
+
 PRHashNumber
 js_HashValue(jsval v)
 {
@@ -22,6 +22,7 @@
  * JS symbol tables.
  */
 #include "prtypes.h"
+#include "prlong.h"
 #ifndef NSPR20
 #include "prhash.h"
 #else
@@ -46,20 +47,67 @@ struct JSScope {
     JSProperty      **proptail;         /* pointer to pointer to last prop */
     JSScopeOps      *ops;               /* virtual operations */
     void            *data;              /* private data specific to ops */
+    uint64          shape;              /* property layout identity */
+#ifdef JS_THREADSAFE
+    JSContext       *ownercx;           /* creator, or null once shared */
+    prword          lock;               /* thin lock, see jslock.h */
+#endif
 #if SCOPE_TABLE
     PRHashEntry     entry;
 #endif
 };
 
 struct JSSymbol {
-    PRHashEntry     entry;              /* base class state */
+    jsval           id;                 /* int-tagged index or JSAtom * */
+    JSProperty      *property;          /* null if deleted but watched */
     JSScope         *scope;             /* pointer to owning scope */
     JSSymbol        *next;              /* next in type-specific list */
+    JSSymbol        *link;              /* next in a small scope's list */
 };
 
-#define sym_id(sym)             ((jsval)(sym)->entry.key)
-#define sym_atom(sym)           ((JSAtom *)(sym)->entry.key)
-#define sym_property(sym)       ((JSProperty *)(sym)->entry.value)
+#define sym_id(sym)             ((sym)->id)
+#define sym_atom(sym)           ((JSAtom *)(sym)->id)
+#define sym_property(sym)       ((sym)->property)
+
+/*
+ * A new scope keeps its symbols in a list linked through sym->link, which
+ * costs nothing to create and is searched no slower than a table while it
+ * holds at most SCOPE_LIST_MAX symbols.  Adding one more moves the symbols
+ * to a table and switches the scope's ops to js_table_scope_ops, until the
+ * scope is cleared.
+ */
+#define SCOPE_LIST_MAX          5
+
+extern JSScopeOps js_list_scope_ops;
+
+/*
+ * The table scope ops keep symbols in an open-addressed hash table, whose
+ * entries hold each symbol's id and hash code next to the symbol pointer, so
+ * a lookup probes one vector and loads only the symbol it finds.  The table
+ * has a power-of-two number of entries, and grows and shrinks by doubling
+ * and halving.  A free entry has a null sym; a removed one has the id 0,
+ * which no atom or int-tagged index can be, and sym SYM_REMOVED.
+ */
+typedef struct JSScopeEntry {
+    PRHashNumber    keyHash;            /* js_HashValue(id) */
+    jsval           id;                 /* sym_id(sym) if sym is live */
+    JSSymbol        *sym;               /* null, SYM_REMOVED, or live */
+} JSScopeEntry;
+
+#define SYM_REMOVED             ((JSSymbol *)1)
+#define SCOPE_ENTRY_IS_LIVE(e)  ((pruword)(e)->sym > (pruword)SYM_REMOVED)
+
+typedef struct JSScopeTable {
+    int16           hashShift;          /* 32 - log2(number of entries) */
+    uint16          spare;              /* reserved for future use */
+    uint32          entryCount;         /* number of live entries */
+    uint32          removedCount;       /* number of removed entries */
+    JSScopeEntry    entries[1];         /* really PR_BIT(32 - hashShift) */
+} JSScopeTable;
+
+#define SCOPE_TABLE_SIZE(table) PR_BIT(32 - (table)->hashShift)
+
+extern JSScopeOps js_table_scope_ops;
 
 struct JSProperty {
     jsrefcount      nrefs;              /* number of referencing symbols */
@@ -75,6 +123,32 @@ struct JSProperty {
     JSProperty      **prevp;
 };
 
+/*
+ * Scope shapes.  Two scopes with equal shape numbers hold the same ids, in
+ * the same order, with the same slots, getters, setters and flags, and were
+ * created for the same class.  Adding a symbol takes a transition from the
+ * old shape to a shape shared by all scopes that added the same property to
+ * the same layout; removing a symbol, or changing a property in place, gives
+ * the scope a fresh shape that no other scope has.  Shape numbers are 64 bits
+ * wide so that rt->shapeGen can't wrap (at a billion new shapes a second it
+ * would take centuries), and are never reused, so inline caches may hold them
+ * across GCs.  Use the LL_* macros on them, as uint64 may be a struct.
+ */
+#define SHAPE_INVALID           0
+
+extern void
+js_ChangeScopeShape(JSContext *cx, JSScope *scope);
+
+/* Give prop's scope a fresh shape after changing prop in place. */
+#define PROPERTY_CHANGED(cx, prop)                                            \
+    PR_BEGIN_MACRO                                                            \
+	if ((prop)->object && (prop)->object->map)                            \
+	    js_ChangeScopeShape(cx, (JSScope *)(prop)->object->map);          \
+    PR_END_MACRO
+
+extern void
+js_SweepScopeShapes(JSContext *cx);
+
 extern JSScope *
 js_GetMutableScope(JSContext *cx, JSObject *obj);
 
@@ -95,6 +169,16 @@ js_HoldScope(JSContext *cx, JSScope *scope);
 extern JSScope *
 js_DropScope(JSContext *cx, JSScope *scope);
 
+/*
+ * Return the malloc'd bytes scope uses for itself, its table, symbols and
+ * properties, or rt uses for its shape table, for the memory census.
+ */
+extern size_t
+js_GetScopeBytes(JSScope *scope);
+
+extern size_t
+js_GetShapeTableBytes(JSRuntime *rt);
+
 extern PRHashNumber
 js_HashValue(jsval v);
 
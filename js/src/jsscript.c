@@ -25,6 +25,7 @@
 #include "jscntxt.h"
 #include "jsdbgapi.h"
 #include "jsemit.h"
+#include "jsjit.h"
 #include "jsscript.h"
 
 JSScript *
@@ -33,7 +34,6 @@ js_NewScript(JSContext *cx, JSCodeGenerator *cg, const char *filename,
 {
     JSScript *script;
     ptrdiff_t length;
-    JSNewScriptHookProc hookproc;
 
     length = CG_OFFSET(cg);
     script = JS_malloc(cx, sizeof(JSScript) + length);
@@ -67,14 +67,23 @@ js_NewScript(JSContext *cx, JSCodeGenerator *cg, const char *filename,
     if (principals)
         JSPRINCIPALS_HOLD(cx, principals);
     script->principals = principals;
+#ifdef JS_THREADSAFE
+    script->ownercx = cx;
+#endif
+    js_CallNewScriptHook(cx, script, fun);
+    return script;
+}
+
+void
+js_CallNewScriptHook(JSContext *cx, JSScript *script, JSFunction *fun)
+{
+    JSNewScriptHookProc hookproc;
 
     hookproc = (JSNewScriptHookProc)cx->runtime->newScriptHookProc;
     if (hookproc) {
-        (*hookproc)(cx, filename, lineno, script, fun,
+        (*hookproc)(cx, script->filename, script->lineno, script, fun,
 		    cx->runtime->newScriptHookProcData);
     }
-
-    return script;
 }
 
 void
@@ -96,6 +105,12 @@ js_DestroyScript(JSContext *cx, JSScript *script)
         JS_free(cx, script->notes);
     if (script->principals)
         JSPRINCIPALS_DROP(cx, script->principals);
+    if (script->propertyICs)
+        JS_free(cx, script->propertyICs);
+#if JS_HAS_JIT
+    if (script->jit)
+        js_DestroyJITCode(cx, script->jit);
+#endif
     JS_free(cx, script);
 }
 
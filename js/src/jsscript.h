@@ -38,12 +38,23 @@ struct JSScript {
     JSSymbol     *vars;         /* local variable list */
     JSPrincipals *principals;	/* principals for this script */
     void         *javaData;     /* extra data used by jsjava.c */
+    JSPropertyIC *propertyICs;  /* get/set inline caches, see jsinterp.h */
+    uint32       propertyICMask;
+    JSJITCode    *jit;          /* native code, see jsjit.h */
+    uint32       useCount;      /* calls made with the JIT on */
+#ifdef JS_THREADSAFE
+    JSContext    *ownercx;      /* the only context using propertyICs */
+#endif
 };
 
 extern JSScript *
 js_NewScript(JSContext *cx, JSCodeGenerator *cg, const char *filename,
 	     uintN lineno, JSPrincipals *principals, JSFunction *fun);
 
+/* Tell the debugger about a new script, the body of fun if not null. */
+extern void
+js_CallNewScriptHook(JSContext *cx, JSScript *script, JSFunction *fun);
+
 extern void
 js_DestroyScript(JSContext *cx, JSScript *script);
 
@@ -81,6 +81,26 @@ static JSPropertySpec string_props[] = {
     {0}
 };
 
+/*
+ * Return the string that String object obj wraps, without flattening it if
+ * it's a rope, for callers that don't read its chars.  Any other object is
+ * converted to a flat string.
+ */
+static JSString *
+str_unflattened(JSContext *cx, JSObject *obj)
+{
+    jsval v;
+    JSString *str;
+
+    if (obj && obj->map->clasp == &string_class) {
+	JS_LOCK_VOID(cx, v = js_GetSlot(cx, obj, JSSLOT_PRIVATE));
+	if (JSVAL_IS_STRING(v))
+	    return JSVAL_TO_STRING(v);
+    }
+    JS_LOCK_VOID(cx, str = js_ObjectToString(cx, obj));
+    return str;
+}
+
 static JSBool
 str_getProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 {
@@ -88,7 +108,7 @@ str_getProperty(JSContext *cx, JSObject *obj, jsval id, jsval *vp)
 
     if (!JSVAL_IS_INT(id))
 	return JS_TRUE;
-    JS_LOCK_VOID(cx, str = js_ObjectToString(cx, obj));
+    str = str_unflattened(cx, obj);
     if (!str)
 	return JS_FALSE;
     if (JSVAL_TO_INT(id) == STRING_LENGTH)
@@ -607,9 +627,7 @@ match_glob(JSContext *cx, jsint count, GlobData *data)
     if (!matchstr)
 	return JS_FALSE;
     v = STRING_TO_JSVAL(matchstr);
-    if (!js_SetProperty(cx, arrayobj, INT_TO_JSVAL(count), &v))
-	return JS_FALSE;
-    return JS_TRUE;
+    return js_SetArrayElement(cx, arrayobj, count, &v);
 }
 #endif /* JS_HAS_REGEXPS */
 
@@ -722,9 +740,8 @@ find_replen(JSContext *cx, ReplaceData *rdata, size_t *sizep)
 
     lambda = rdata->lambda;
     if (lambda) {
-    	void *mark;
     	uintN argc, i, j, m, n, p;
-    	jsval *sp, *oldsp, rval;
+    	jsval *mark, *sp, *oldsp, rval;
 	JSStackFrame *fp;
     	JSBool ok;
 
@@ -736,14 +753,11 @@ find_replen(JSContext *cx, ReplaceData *rdata, size_t *sizep)
 	 * For $&, etc., we must create string jsvals from cx->regExpStatics.
 	 * We grab up stack space to keep the newborn strings GC-rooted.	 * XXXbe should use Call here and avoid re-pushing args
 	 */
-	mark = PR_ARENA_MARK(&cx->stackPool);
     	p = rdata->base.regexp->parenCount;
     	argc = 1 + p + 2;
-	PR_ARENA_ALLOCATE(sp, &cx->stackPool, (2 + argc) * sizeof(jsval));
-	if (!sp) {
-	    JS_ReportOutOfMemory(cx);
+	sp = mark = js_AllocStack(cx, 2 + argc);
+	if (!sp)
 	    return JS_FALSE;
-	}
 
 	/* Push lambda and its 'this' parameter. */
 	*sp++ = OBJECT_TO_JSVAL(lambda);
@@ -806,7 +820,7 @@ find_replen(JSContext *cx, ReplaceData *rdata, size_t *sizep)
 	}
 
       lambda_out:
-    	PR_ARENA_RELEASE(&cx->stackPool, mark);
+	cx->stackTop = mark;
     	return ok;
     }
 #endif /* JS_HAS_REPLACE_LAMBDA */
@@ -1338,54 +1352,33 @@ static JSBool
 str_concat(JSContext *cx, JSObject *obj, uintN argc, jsval *argv, jsval *rval)
 {
     JSString *str, *str2;
-    JSBool ok;
-    size_t length, length2, newlength;
-    jschar *chars, *newchars;
     uintN i;
 
     if (argc == 0)
 	return JS_TRUE;
 
-    JS_LOCK_VOID(cx, str = js_ObjectToString(cx, obj));
+    str = str_unflattened(cx, obj);
     if (!str)
 	return JS_FALSE;
     argv[-1] = STRING_TO_JSVAL(str);
 
-    length = str->length;
-    chars = JS_malloc(cx, (length + 1) * sizeof(jschar));
-    if (!chars)
-	return JS_FALSE;
-    js_strncpy(chars, str->chars, length);
-
-    ok = JS_TRUE;
+    /* Root each partial result in *rval while converting the next arg. */
     for (i = 0; i < argc; i++) {
-	str2 = JS_ValueToString(cx, argv[i]);
-	if (!str2) {
-	    ok = JS_FALSE;
-	    goto out;
-	}
-	length2 = str2->length;
-	newlength = length + length2;
-	newchars = JS_realloc(cx, chars, (newlength + 1) * sizeof(jschar));
-	if (!newchars) {
-	    ok = JS_FALSE;
-	    goto out;
+	if (JSVAL_IS_STRING(argv[i])) {
+	    str2 = JSVAL_TO_STRING(argv[i]);
+	} else {
+	    *rval = STRING_TO_JSVAL(str);
+	    str2 = JS_ValueToString(cx, argv[i]);
+	    if (!str2)
+		return JS_FALSE;
+	    argv[i] = STRING_TO_JSVAL(str2);
 	}
-	chars = newchars;
-	js_strncpy(chars + length, str2->chars, length2);
-	length = newlength;
-    }
-
-    chars[length] = 0;
-    str = js_NewString(cx, chars, length, 0);
-    if (!str)
-	ok = JS_FALSE;
-out:
-    if (ok)
+	str = js_ConcatStrings(cx, str, str2);
+	if (!str)
+	    return JS_FALSE;
 	*rval = STRING_TO_JSVAL(str);
-    else
-	JS_free(cx, chars);
-    return ok;
+    }
+    return JS_TRUE;
 }
 
 static JSBool
@@ -1702,6 +1695,7 @@ static PRHashTable *deflated_string_cache;
 static uint32 deflated_string_cache_bytes;
 #ifdef JS_THREADSAFE
 static PRLock *deflated_string_cache_lock;
+static PRLock *rope_lock;
 #endif
 
 JSObject *
@@ -1727,6 +1721,11 @@ js_InitStringClass(JSContext *cx, JSObject *obj)
 	    if (!deflated_string_cache_lock)
 		return NULL;
 	}
+	if (!rope_lock) {
+	    rope_lock = PR_NewLock();
+	    if (!rope_lock)
+		return NULL;
+	}
 #endif
     }
     proto = JS_InitClass(cx, obj, NULL, &string_class, String, 1,
@@ -1788,10 +1787,151 @@ js_NewStringCopyZ(JSContext *cx, const jschar *s, uintN gcflag)
     return str;
 }
 
+JSString *
+js_ConcatStrings(JSContext *cx, JSString *left, JSString *right)
+{
+    size_t leftlen, rightlen, length;
+    jschar *chars;
+    JSRopeNode *node;
+    JSString *str;
+    JSRuntime *rt;
+
+    leftlen = left->length;
+    if (leftlen == 0)
+	return right;
+    rightlen = right->length;
+    if (rightlen == 0)
+	return left;
+    length = leftlen + rightlen;
+
+    if (length < JSSTRING_ROPE_MIN) {
+	if (!JSSTRING_FLATTEN(cx, left) || !JSSTRING_FLATTEN(cx, right))
+	    return NULL;
+	chars = JS_malloc(cx, (length + 1) * sizeof(jschar));
+	if (!chars)
+	    return NULL;
+	js_strncpy(chars, left->chars, leftlen);
+	js_strncpy(chars + leftlen, right->chars, rightlen);
+	chars[length] = 0;
+	str = js_NewString(cx, chars, length, 0);
+	if (!str)
+	    JS_free(cx, chars);
+	return str;
+    }
+
+    node = JS_malloc(cx, sizeof(JSRopeNode));
+    if (!node)
+	return NULL;
+    node->left = left;
+    node->right = right;
+    str = js_NewString(cx, (jschar *)((prword)node | JSSTRFLAG_ROPE), length,
+		       0);
+    if (!str) {
+	JS_free(cx, node);
+	return NULL;
+    }
+
+    /*
+     * A rope allocated while an incremental GC is marking is born marked, so
+     * the GC won't scan it for its children: mark them here.
+     */
+    rt = cx->runtime;
+    if (rt->gcMarking) {
+	js_GCWriteBarrier(cx, NULL, left);
+	js_GCWriteBarrier(cx, NULL, right);
+    }
+    return str;
+}
+
+/*
+ * Depth of the stack js_FlattenString keeps of left children it has yet to
+ * copy, before it must malloc a bigger one.  Only ropes built by prepending
+ * nest to the right deeply enough to need more.
+ */
+#define ROPE_STACK_SIZE 64
+
+JSBool
+js_FlattenString(JSContext *cx, JSString *str)
+{
+    JSString *stackbuf[ROPE_STACK_SIZE], **stack, **newstack, *s;
+    size_t depth, size, length, pos;
+    jschar *chars;
+    JSRopeNode *node;
+    JSBool ok;
+
+    JS_ACQUIRE_LOCK(rope_lock);
+
+    /* Another thread may have flattened str while we waited for the lock. */
+    ok = JS_TRUE;
+    if (!JSSTRING_IS_ROPE(str))
+	goto out;
+
+    ok = JS_FALSE;
+    length = str->length;
+    chars = cx
+	    ? JS_malloc(cx, (length + 1) * sizeof(jschar))
+	    : malloc((length + 1) * sizeof(jschar));
+    if (!chars)
+	goto out;
+
+    /*
+     * Copy leaves right to left, from the end of chars back, descending the
+     * right spine of each rope and stacking its left children for later.
+     */
+    stack = stackbuf;
+    size = ROPE_STACK_SIZE;
+    depth = 0;
+    pos = length;
+    s = str;
+    for (;;) {
+	while (JSSTRING_IS_ROPE(s)) {
+	    node = JSSTRING_ROPE(s);
+	    if (depth == size) {
+		newstack = malloc(2 * size * sizeof(JSString *));
+		if (!newstack) {
+		    if (cx)
+			JS_ReportOutOfMemory(cx);
+		    free(chars);
+		    goto out_stack;
+		}
+		memcpy(newstack, stack, size * sizeof(JSString *));
+		if (stack != stackbuf)
+		    free(stack);
+		stack = newstack;
+		size *= 2;
+	    }
+	    stack[depth++] = node->left;
+	    s = node->right;
+	}
+	pos -= s->length;
+	js_strncpy(chars + pos, s->chars, s->length);
+	if (depth == 0)
+	    break;
+	s = stack[--depth];
+    }
+    PR_ASSERT(pos == 0);
+    chars[length] = 0;
+
+    node = JSSTRING_ROPE(str);
+    str->chars = chars;
+    free(node);
+    ok = JS_TRUE;
+
+out_stack:
+    if (stack != stackbuf)
+	free(stack);
+out:
+    JS_RELEASE_LOCK(rope_lock);
+    return ok;
+}
+
 void
 js_FinalizeString(JSContext *cx, JSString *str)
 {
-    if (str->chars) {
+    if (JSSTRING_IS_ROPE(str)) {
+	JS_free(cx, JSSTRING_ROPE(str));
+	str->chars = NULL;
+    } else if (str->chars) {
 	JS_free(cx, str->chars);
 	str->chars = NULL;
 	if (deflated_string_cache) {
@@ -1837,6 +1977,8 @@ js_ValueToString(JSContext *cx, jsval v)
     } else {
 	str = ATOM_TO_STRING(cx->runtime->atomState.typeAtoms[JSTYPE_VOID]);
     }
+    if (str && !JSSTRING_FLATTEN(cx, str))
+	return NULL;
     return str;
 }
 
@@ -1847,6 +1989,7 @@ js_HashString(const JSString *str)
     size_t n, m;
     const jschar *s;
 
+    PR_ASSERT(!JSSTRING_IS_ROPE(str));
     h = 0;
     n = str->length;
     s = str->chars;
@@ -1869,6 +2012,7 @@ js_CompareStrings(const JSString *str1, const JSString *str2)
     const jschar *s1, *s2;
     intN cmp;
 
+    PR_ASSERT(!JSSTRING_IS_ROPE(str1) && !JSSTRING_IS_ROPE(str2));
     l1 = str1->length, l2 = str2->length;
     s1 = str1->chars,  s2 = str2->chars;
     n = PR_MIN(l1, l2);
@@ -2011,6 +2155,8 @@ js_GetStringBytes(JSString *str)
 	he = *hep;
 	if (he) {
 	    bytes = he->value;
+	} else if (!JSSTRING_FLATTEN(NULL, str)) {
+	    bytes = NULL;
 	} else {
 	    bytes = js_DeflateString(NULL, str->chars, str->length);
 	    if (bytes) {
@@ -2028,6 +2174,25 @@ js_GetStringBytes(JSString *str)
     return bytes;
 }
 
+size_t
+js_GetDeflatedStringBytes(void)
+{
+    PRHashTable *cache;
+    size_t nbytes;
+
+    /* The cache is made with its lock held, so the lock exists if it does. */
+    cache = deflated_string_cache;
+    if (!cache)
+	return 0;
+    JS_ACQUIRE_LOCK(deflated_string_cache_lock);
+    nbytes = sizeof *cache
+	   + PR_BIT(32 - cache->shift) * sizeof(PRHashEntry *)
+	   + cache->nentries * (sizeof(PRHashEntry) + 1)
+	   + deflated_string_cache_bytes;
+    JS_RELEASE_LOCK(deflated_string_cache_lock);
+    return nbytes;
+}
+
 /*
  * From java.lang.Character.java:
  *
@@ -29,6 +29,14 @@
  * When a string is treated as an object (by following it with . or []), the
  * runtime wraps it with a JSObject whose valueOf method returns the unwrapped
  * string header.
+ *
+ * A rope is a string made by concatenation whose chars haven't been copied
+ * yet.  Its chars member, tagged with JSSTRFLAG_ROPE, points at a malloc'ed
+ * JSRopeNode naming the two strings it joins, either of which may itself be
+ * a rope.  A rope's length is valid, but its chars must not be read until it
+ * has been flattened in place, by js_FlattenString.  Atoms are never ropes,
+ * and js_ValueToString and js_ObjectToString return flat strings, so only
+ * code that takes a string straight out of a jsval need flatten it.
  */
 #include <ctype.h>
 #include "jspubtd.h"
@@ -41,6 +49,23 @@ struct JSString {
     jschar          *chars;
 };
 
+struct JSRopeNode {
+    JSString        *left;
+    JSString        *right;
+};
+
+#define JSSTRFLAG_ROPE          ((prword)1)
+#define JSSTRING_IS_ROPE(str)   (((prword)(str)->chars & JSSTRFLAG_ROPE) != 0)
+#define JSSTRING_ROPE(str)                                                    \
+    ((JSRopeNode *)((prword)(str)->chars & ~JSSTRFLAG_ROPE))
+
+/* Flatten str if it's a rope, evaluating to false on out of memory. */
+#define JSSTRING_FLATTEN(cx,str)                                              \
+    (!JSSTRING_IS_ROPE(str) || js_FlattenString(cx, str))
+
+/* Concatenations shorter than this are copied rather than made into ropes. */
+#define JSSTRING_ROPE_MIN       32
+
 struct JSSubString {
     size_t          length;
     const jschar    *chars;
@@ -162,6 +187,21 @@ js_NewStringCopyN(JSContext *cx, const jschar *s, size_t n, uintN gcflag);
 extern JSString *
 js_NewStringCopyZ(JSContext *cx, const jschar *s, uintN gcflag);
 
+/*
+ * Concatenate left and right, which the caller must keep rooted, returning a
+ * rope unless the result is short or one of them is empty.
+ */
+extern JSString *
+js_ConcatStrings(JSContext *cx, JSString *left, JSString *right);
+
+/*
+ * Copy rope str's chars into a new buffer that replaces its node, releasing
+ * its children.  Return false on out of memory, after reporting it unless cx
+ * is null.
+ */
+extern JSBool
+js_FlattenString(JSContext *cx, JSString *str);
+
 /* Free the chars held by str when it is finalized by the GC. */
 extern void
 js_FinalizeString(JSContext *cx, JSString *str);
@@ -179,7 +219,7 @@ js_ValueToString(JSContext *cx, jsval v);
 
 #ifdef HT_ENUMERATE_NEXT	/* XXX don't require prhash.h */
 /*
- * Compute a hash function from str.
+ * Compute a hash function from str, which must be flat.
  */
 extern PRHashNumber
 js_HashString(const JSString *str);
@@ -187,7 +227,7 @@ js_HashString(const JSString *str);
 
 /*
  * Return less than, equal to, or greater than zero depending on whether
- * str1 is less than, equal to, or greater than str2.
+ * str1 is less than, equal to, or greater than str2, which must be flat.
  */
 extern intN
 js_CompareStrings(const JSString *str1, const JSString *str2);
@@ -243,6 +283,13 @@ js_SetStringBytes(JSString *str, char *bytes, size_t length);
 extern char *
 js_GetStringBytes(JSString *str);
 
+/*
+ * Return the malloc'd bytes the deflated string cache holds, for the memory
+ * census.  The cache is shared by all runtimes.
+ */
+extern size_t
+js_GetDeflatedStringBytes(void);
+
 PR_END_EXTERN_C
 
 #endif /* jsstr_h___ */
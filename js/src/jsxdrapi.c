@@ -0,0 +1,829 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+ * JS script serialization and compiled script cache.
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "prtypes.h"
+#include "prlog.h"
+#include "jsapi.h"
+#include "jsatom.h"
+#include "jscntxt.h"
+#include "jsconfig.h"
+#include "jsemit.h"
+#include "jsfun.h"
+#include "jsinterp.h"
+#include "jslock.h"
+#include "jsobj.h"
+#include "jsopcode.h"
+#include "jsparse.h"
+#include "jsregexp.h"
+#include "jsscope.h"
+#include "jsscript.h"
+#include "jsstr.h"
+#include "jsxdrapi.h"
+
+/*
+ * Encoded data is a sequence of uint32s, with each run of bytes or chars
+ * padded to a multiple of four bytes.
+ */
+typedef struct JSXDRState {
+    JSContext       *cx;
+    uint8           *base;          /* data, malloc'ed when encoding */
+    uint32          offset;         /* where to encode or decode next */
+    uint32          limit;          /* allocated or valid length of data */
+} JSXDRState;
+
+#define XDR_ROUNDUP(n)  (((n) + 3) & ~(uint32)3)
+#define XDR_CHUNK       1024
+
+/* Literal tags. */
+#define XDR_STRING      0
+#define XDR_INT         1
+#define XDR_DOUBLE      2
+#define XDR_BOOLEAN     3
+#define XDR_NULL        4
+#define XDR_REGEXP      5
+#define XDR_FUNCTION    6
+
+static JSBool
+EncodeBytes(JSXDRState *xdr, const void *p, uint32 n)
+{
+    uint32 padded, limit;
+    uint8 *base;
+
+    padded = XDR_ROUNDUP(n);
+    if (xdr->offset + padded > xdr->limit) {
+	limit = xdr->limit + PR_MAX(padded, XDR_CHUNK);
+	base = realloc(xdr->base, limit);
+	if (!base) {
+	    JS_ReportOutOfMemory(xdr->cx);
+	    return JS_FALSE;
+	}
+	xdr->base = base;
+	xdr->limit = limit;
+    }
+    memcpy(xdr->base + xdr->offset, p, n);
+    memset(xdr->base + xdr->offset + n, 0, padded - n);
+    xdr->offset += padded;
+    return JS_TRUE;
+}
+
+static JSBool
+EncodeUint32(JSXDRState *xdr, uint32 u)
+{
+    return EncodeBytes(xdr, &u, sizeof u);
+}
+
+static JSBool
+EncodeChars(JSXDRState *xdr, const jschar *chars, size_t length)
+{
+    return EncodeUint32(xdr, (uint32)length) &&
+	   EncodeBytes(xdr, chars, (uint32)(length * sizeof(jschar)));
+}
+
+/*
+ * Encode the names of the symbols on list, which the compiler built by adding
+ * each new symbol at the front, in the order they were declared.
+ */
+static JSBool
+EncodeDeclarations(JSXDRState *xdr, JSSymbol *list)
+{
+    JSSymbol *sym, **vector;
+    uint32 i, n;
+    JSString *str;
+    JSBool ok;
+
+    n = 0;
+    for (sym = list; sym; sym = sym->next)
+	n++;
+    if (!EncodeUint32(xdr, n))
+	return JS_FALSE;
+    if (n == 0)
+	return JS_TRUE;
+    vector = JS_malloc(xdr->cx, n * sizeof *vector);
+    if (!vector)
+	return JS_FALSE;
+    for (sym = list, i = n; sym; sym = sym->next)
+	vector[--i] = sym;
+    ok = JS_TRUE;
+    for (i = 0; i < n; i++) {
+	str = ATOM_TO_STRING(sym_atom(vector[i]));
+	ok = EncodeChars(xdr, str->chars, str->length);
+	if (!ok)
+	    break;
+    }
+    JS_free(xdr->cx, vector);
+    return ok;
+}
+
+static JSBool
+EncodeScript(JSXDRState *xdr, JSScript *script);
+
+static JSBool
+EncodeFunction(JSXDRState *xdr, JSFunction *fun)
+{
+    JSString *str;
+    JSSymbol *arg;
+    uintN i;
+
+    if (!JSFUN_COMPILE(xdr->cx, fun) || !fun->script)
+	return JS_FALSE;
+    if (!EncodeUint32(xdr, fun->flags))
+	return JS_FALSE;
+    if (fun->atom) {
+	str = ATOM_TO_STRING(fun->atom);
+	if (!EncodeUint32(xdr, 1) ||
+	    !EncodeChars(xdr, str->chars, str->length)) {
+	    return JS_FALSE;
+	}
+    } else {
+	if (!EncodeUint32(xdr, 0))
+	    return JS_FALSE;
+    }
+
+    /* Arguments are listed in order, and the list may not be terminated. */
+    if (!EncodeUint32(xdr, fun->nargs))
+	return JS_FALSE;
+    arg = fun->script->args;
+    for (i = 0; i < fun->nargs; i++, arg = arg->next) {
+	str = ATOM_TO_STRING(sym_atom(arg));
+	if (!EncodeChars(xdr, str->chars, str->length))
+	    return JS_FALSE;
+    }
+    return EncodeScript(xdr, fun->script);
+}
+
+static JSBool
+EncodeAtom(JSXDRState *xdr, JSAtom *atom)
+{
+    jsval key;
+    JSObject *obj;
+    JSClass *clasp;
+    JSString *str;
+    JSRegExp *re;
+
+    key = ATOM_KEY(atom);
+    if (JSVAL_IS_STRING(key)) {
+	str = JSVAL_TO_STRING(key);
+	return EncodeUint32(xdr, XDR_STRING) &&
+	       EncodeChars(xdr, str->chars, str->length);
+    }
+    if (JSVAL_IS_INT(key)) {
+	return EncodeUint32(xdr, XDR_INT) &&
+	       EncodeUint32(xdr, (uint32)JSVAL_TO_INT(key));
+    }
+    if (JSVAL_IS_DOUBLE(key)) {
+	return EncodeUint32(xdr, XDR_DOUBLE) &&
+	       EncodeBytes(xdr, JSVAL_TO_DOUBLE(key), sizeof(jsdouble));
+    }
+    if (JSVAL_IS_BOOLEAN(key)) {
+	return EncodeUint32(xdr, XDR_BOOLEAN) &&
+	       EncodeUint32(xdr, (uint32)JSVAL_TO_BOOLEAN(key));
+    }
+
+    PR_ASSERT(JSVAL_IS_OBJECT(key));
+    obj = JSVAL_TO_OBJECT(key);
+    if (!obj)
+	return EncodeUint32(xdr, XDR_NULL);
+    clasp = obj->map->clasp;
+#if JS_HAS_REGEXPS
+    if (clasp == &js_RegExpClass) {
+	re = JS_GetPrivate(xdr->cx, obj);
+	if (!re)
+	    return JS_FALSE;
+	str = re->source;
+	return EncodeUint32(xdr, XDR_REGEXP) &&
+	       EncodeUint32(xdr, re->flags) &&
+	       EncodeChars(xdr, str->chars, str->length);
+    }
+#endif
+    if (clasp == &js_FunctionClass) {
+	return EncodeUint32(xdr, XDR_FUNCTION) &&
+	       EncodeFunction(xdr, JS_GetPrivate(xdr->cx, obj));
+    }
+
+    /* Any other object literal can't be encoded. */
+    return JS_FALSE;
+}
+
+/*
+ * A script is encoded as the variables it declares, then its code, notes,
+ * and literals.
+ */
+static JSBool
+EncodeScript(JSXDRState *xdr, JSScript *script)
+{
+    jssrcnote *sn;
+    uint32 i, nnotes;
+
+    if (!EncodeDeclarations(xdr, script->vars))
+	return JS_FALSE;
+    if (!EncodeUint32(xdr, script->length) ||
+	!EncodeBytes(xdr, script->code, script->length) ||
+	!EncodeUint32(xdr, script->lineno) ||
+	!EncodeUint32(xdr, script->depth)) {
+	return JS_FALSE;
+    }
+
+    nnotes = 0;
+    if (script->notes) {
+	for (sn = script->notes; !SN_IS_TERMINATOR(sn); sn = SN_NEXT(sn))
+	    ;
+	nnotes = sn - script->notes + 1;
+    }
+    if (!EncodeUint32(xdr, nnotes) ||
+	!EncodeBytes(xdr, script->notes, nnotes * sizeof(jssrcnote))) {
+	return JS_FALSE;
+    }
+
+    if (!EncodeUint32(xdr, script->atomMap.length))
+	return JS_FALSE;
+    for (i = 0; i < script->atomMap.length; i++) {
+	if (!EncodeAtom(xdr, script->atomMap.vector[i]))
+	    return JS_FALSE;
+    }
+    return JS_TRUE;
+}
+
+PR_IMPLEMENT(void *)
+JS_EncodeScript(JSContext *cx, JSScript *script, uint32 *lengthp)
+{
+    JSXDRState xdr;
+    JSBool ok;
+
+    PR_ASSERT(!script->principals);
+    xdr.cx = cx;
+    xdr.base = NULL;
+    xdr.offset = xdr.limit = 0;
+    JS_LOCK(cx);
+    ok = EncodeUint32(&xdr, JSXDR_MAGIC) &&
+	 EncodeUint32(&xdr, JSXDR_VERSION) &&
+	 EncodeUint32(&xdr, JSOP_LIMIT) &&
+	 EncodeScript(&xdr, script);
+    JS_UNLOCK(cx);
+    if (!ok) {
+	JS_free(cx, xdr.base);
+	return NULL;
+    }
+    *lengthp = xdr.offset;
+    return xdr.base;
+}
+
+/*
+ * Decoding functions return false without reporting an error if the data is
+ * malformed.
+ */
+static const void *
+DecodeBytes(JSXDRState *xdr, uint32 n)
+{
+    uint32 padded;
+    const void *p;
+
+    padded = XDR_ROUNDUP(n);
+    if (padded < n || padded > xdr->limit - xdr->offset)
+	return NULL;
+    p = xdr->base + xdr->offset;
+    xdr->offset += padded;
+    return p;
+}
+
+static JSBool
+DecodeUint32(JSXDRState *xdr, uint32 *up)
+{
+    const uint32 *p;
+
+    p = DecodeBytes(xdr, sizeof *up);
+    if (!p)
+	return JS_FALSE;
+    *up = *p;
+    return JS_TRUE;
+}
+
+static const jschar *
+DecodeChars(JSXDRState *xdr, size_t *lengthp)
+{
+    uint32 length;
+
+    if (!DecodeUint32(xdr, &length) || length > PR_BIT(30))
+	return NULL;
+    *lengthp = length;
+    return DecodeBytes(xdr, length * sizeof(jschar));
+}
+
+static JSAtom *
+DecodeStringAtom(JSXDRState *xdr)
+{
+    const jschar *chars;
+    size_t length;
+
+    chars = DecodeChars(xdr, &length);
+    if (!chars)
+	return NULL;
+    return js_AtomizeChars(xdr->cx, chars, length, 0);
+}
+
+/*
+ * Redeclare a variable the way Variables in jsparse.c declares it, adding
+ * its symbol to *varsp if the declaration makes a new property.
+ */
+static JSBool
+DeclareVariable(JSContext *cx, JSObject *obj, JSFunction *fun, JSAtom *atom,
+		JSSymbol **varsp)
+{
+    JSClass *clasp;
+    JSPropertyOp getter, setter;
+    JSObject *pobj;
+    JSProperty *prop;
+    JSSymbol *var;
+
+    clasp = obj->map->clasp;
+    if (fun) {
+	getter = js_GetLocalVariable;
+	setter = js_SetLocalVariable;
+    } else {
+	getter = clasp->getProperty;
+	setter = clasp->setProperty;
+    }
+
+    pobj = NULL;
+    if (!js_LookupProperty(cx, obj, (jsval)atom, &pobj, &prop))
+	return JS_FALSE;
+    if (prop && prop->object == obj) {
+	if (prop->getter != js_GetArgument) {
+	    if (!fun)
+		prop->id = ATOM_KEY(atom);
+	    prop->getter = getter;
+	    prop->setter = setter;
+	    prop->flags |= JSPROP_ENUMERATE | JSPROP_PERMANENT;
+	    prop->flags &= ~JSPROP_READONLY;
+	    PROPERTY_CHANGED(cx, prop);
+	}
+	return JS_TRUE;
+    }
+
+    prop = js_DefineProperty(cx, obj, (jsval)atom, JSVAL_VOID, getter, setter,
+			     JSPROP_ENUMERATE | JSPROP_PERMANENT);
+    if (!prop)
+	return JS_FALSE;
+    if (fun)
+	prop->id = INT_TO_JSVAL(fun->nvars++);
+    var = prop->symbols;
+    var->next = *varsp;
+    *varsp = var;
+    return JS_TRUE;
+}
+
+/*
+ * Redeclare a formal argument the way FunctionDef in jsparse.c does, adding
+ * its symbol at **argpp.
+ */
+static JSBool
+DeclareArgument(JSContext *cx, JSFunction *fun, JSAtom *atom,
+		JSSymbol ***argpp)
+{
+    JSObject *pobj;
+    JSProperty *prop;
+    JSSymbol *arg;
+
+    pobj = NULL;
+    if (!js_LookupProperty(cx, fun->object, (jsval)atom, &pobj, &prop))
+	return JS_FALSE;
+    if (prop && prop->object == fun->object) {
+	prop->getter = js_GetArgument;
+	prop->setter = js_SetArgument;
+	prop->flags |= JSPROP_ENUMERATE | JSPROP_PERMANENT;
+	PROPERTY_CHANGED(cx, prop);
+    } else {
+	prop = js_DefineProperty(cx, fun->object, (jsval)atom, JSVAL_VOID,
+				 js_GetArgument, js_SetArgument,
+				 JSPROP_ENUMERATE | JSPROP_PERMANENT);
+	if (!prop)
+	    return JS_FALSE;
+    }
+    prop->id = INT_TO_JSVAL(fun->nargs++);
+    arg = prop->symbols;
+    **argpp = arg;
+    *argpp = &arg->next;
+    return JS_TRUE;
+}
+
+static JSScript *
+DecodeScript(JSXDRState *xdr, JSObject *obj, JSFunction *fun, JSSymbol *args,
+	     const char *filename);
+
+/*
+ * Decode a function defined in a script compiled against parent, which is
+ * either the object the top-level script was compiled against or the object
+ * of the function whose script defines this one.
+ */
+static JSFunction *
+DecodeFunction(JSXDRState *xdr, JSObject *parent, const char *filename)
+{
+    JSContext *cx;
+    uint32 flags, named, nargs, i;
+    JSAtom *atom;
+    JSFunction *fun;
+    JSSymbol *args, **argp;
+    JSBool ok;
+
+    cx = xdr->cx;
+    if (!DecodeUint32(xdr, &flags) || !DecodeUint32(xdr, &named))
+	return NULL;
+    atom = NULL;
+    if (named) {
+	atom = DecodeStringAtom(xdr);
+	if (!atom)
+	    return NULL;
+    }
+
+    /*
+     * FunctionDef defines a function on parent with JSPROP_ENUMERATE, which
+     * js_DefineFunction also stores in its flags.  Other functions are just
+     * made with parent as their parent.
+     */
+    if (flags & JSPROP_ENUMERATE) {
+	fun = atom ? js_DefineFunction(cx, parent, atom, NULL, 0, flags)
+		   : NULL;
+    } else {
+	fun = js_NewFunction(cx, NULL, 0, flags, parent, atom);
+    }
+    if (atom)
+	js_DropAtom(cx, atom);
+    if (!fun)
+	return NULL;
+
+    args = NULL;
+    argp = &args;
+    if (!DecodeUint32(xdr, &nargs))
+	return NULL;
+    for (i = 0; i < nargs; i++) {
+	atom = DecodeStringAtom(xdr);
+	if (!atom)
+	    return NULL;
+	ok = DeclareArgument(cx, fun, atom, &argp);
+	js_DropAtom(cx, atom);
+	if (!ok)
+	    return NULL;
+    }
+
+    fun->script = DecodeScript(xdr, fun->object, fun, args, filename);
+    if (!fun->script)
+	return NULL;
+    return fun;
+}
+
+static JSAtom *
+DecodeAtom(JSXDRState *xdr, JSObject *obj, const char *filename)
+{
+    JSContext *cx;
+    uint32 tag, u;
+    const jsdouble *dp;
+    jsdouble d;
+    const jschar *chars;
+    size_t length;
+    JSObject *literal;
+    JSFunction *fun;
+
+    cx = xdr->cx;
+    if (!DecodeUint32(xdr, &tag))
+	return NULL;
+    switch (tag) {
+      case XDR_STRING:
+	return DecodeStringAtom(xdr);
+      case XDR_INT:
+	if (!DecodeUint32(xdr, &u))
+	    return NULL;
+	return js_AtomizeInt(cx, (jsint)u, 0);
+      case XDR_DOUBLE:
+	dp = DecodeBytes(xdr, sizeof *dp);
+	if (!dp)
+	    return NULL;
+	memcpy(&d, dp, sizeof d);
+	return js_AtomizeDouble(cx, d, 0);
+      case XDR_BOOLEAN:
+	if (!DecodeUint32(xdr, &u))
+	    return NULL;
+	return js_AtomizeBoolean(cx, (JSBool)u, 0);
+      case XDR_NULL:
+	return js_AtomizeObject(cx, NULL, 0);
+#if JS_HAS_REGEXPS
+      case XDR_REGEXP:
+	if (!DecodeUint32(xdr, &u))
+	    return NULL;
+	chars = DecodeChars(xdr, &length);
+	if (!chars)
+	    return NULL;
+	literal = js_NewRegExpObject(cx, (jschar *)chars, length, u);
+	if (!literal)
+	    return NULL;
+	return js_AtomizeObject(cx, literal, 0);
+#endif
+      case XDR_FUNCTION:
+	fun = DecodeFunction(xdr, obj, filename);
+	if (!fun)
+	    return NULL;
+	return js_AtomizeObject(cx, fun->object, 0);
+      default:
+	return NULL;
+    }
+}
+
+/*
+ * Decode a script compiled against obj, as the body of fun if it isn't null.
+ */
+static JSScript *
+DecodeScript(JSXDRState *xdr, JSObject *obj, JSFunction *fun, JSSymbol *args,
+	     const char *filename)
+{
+    JSContext *cx;
+    uint32 nvars, length, lineno, depth, nnotes, natoms, i;
+    JSAtom *atom;
+    JSSymbol *vars;
+    JSBool ok;
+    const void *p;
+    JSScript *script;
+
+    cx = xdr->cx;
+    if (!DecodeUint32(xdr, &nvars))
+	return NULL;
+    vars = NULL;
+    for (i = 0; i < nvars; i++) {
+	atom = DecodeStringAtom(xdr);
+	if (!atom)
+	    return NULL;
+	ok = DeclareVariable(cx, obj, fun, atom, &vars);
+	js_DropAtom(cx, atom);
+	if (!ok)
+	    return NULL;
+    }
+
+    if (!DecodeUint32(xdr, &length) || length == 0)
+	return NULL;
+    p = DecodeBytes(xdr, length);
+    if (!p)
+	return NULL;
+    script = JS_malloc(cx, sizeof(JSScript) + length);
+    if (!script)
+	return NULL;
+    memset(script, 0, sizeof(JSScript));
+#ifdef JS_THREADSAFE
+    script->ownercx = cx;
+#endif
+    script->code = (jsbytecode *)(script + 1);
+    memcpy(script->code, p, length);
+    script->length = length;
+    if (!DecodeUint32(xdr, &lineno) || !DecodeUint32(xdr, &depth))
+	goto bad;
+    script->lineno = lineno;
+    script->depth = depth;
+
+    if (!DecodeUint32(xdr, &nnotes))
+	goto bad;
+    if (nnotes) {
+	p = DecodeBytes(xdr, nnotes * sizeof(jssrcnote));
+	if (!p)
+	    goto bad;
+	script->notes = JS_malloc(cx, nnotes * sizeof(jssrcnote));
+	if (!script->notes)
+	    goto bad;
+	memcpy(script->notes, p, nnotes * sizeof(jssrcnote));
+	if (!SN_IS_TERMINATOR(&script->notes[nnotes - 1]))
+	    goto bad;
+    }
+
+    /* Count atoms as they're decoded, so js_DestroyScript drops them. */
+    if (!DecodeUint32(xdr, &natoms) || natoms >= ATOM_INDEX_LIMIT)
+	goto bad;
+    if (natoms) {
+	script->atomMap.vector = JS_malloc(cx, natoms * sizeof(JSAtom *));
+	if (!script->atomMap.vector)
+	    goto bad;
+	for (i = 0; i < natoms; i++) {
+	    atom = DecodeAtom(xdr, obj, filename);
+	    if (!atom)
+		goto bad;
+	    script->atomMap.vector[i] = atom;
+	    script->atomMap.length = i + 1;
+	}
+    }
+
+    if (filename) {
+	script->filename = JS_strdup(cx, filename);
+	if (!script->filename)
+	    goto bad;
+    }
+    script->args = args;
+    script->vars = vars;
+    js_CallNewScriptHook(cx, script, fun);
+    return script;
+
+bad:
+    js_DestroyScript(cx, script);
+    return NULL;
+}
+
+PR_IMPLEMENT(JSScript *)
+JS_DecodeScript(JSContext *cx, JSObject *obj, const void *data, uint32 length,
+		const char *filename)
+{
+    JSXDRState xdr;
+    uint32 magic, version, oplimit;
+    JSScript *script;
+
+    xdr.cx = cx;
+    xdr.base = (uint8 *)data;
+    xdr.offset = 0;
+    xdr.limit = length;
+    if (!DecodeUint32(&xdr, &magic) || magic != JSXDR_MAGIC ||
+	!DecodeUint32(&xdr, &version) || version != JSXDR_VERSION ||
+	!DecodeUint32(&xdr, &oplimit) || oplimit != JSOP_LIMIT) {
+	return NULL;
+    }
+    JS_LOCK(cx);
+    script = DecodeScript(&xdr, obj, NULL, NULL, filename);
+    if (script && xdr.offset != xdr.limit) {
+	js_DestroyScript(cx, script);
+	script = NULL;
+    }
+    JS_UNLOCK(cx);
+    return script;
+}
+
+#ifdef JSFILE
+
+/*
+ * A cache file is named after two hashes of the source chars, seeded with
+ * the first line number and the version, which affect the code compiled.
+ * It holds a header checked against the source, then the encoded script.
+ */
+typedef struct CacheHeader {
+    uint32          hash1;
+    uint32          hash2;
+    uint32          sourceLength;
+    uint32          lineno;
+    uint32          version;
+    uint32          length;         /* length of encoded script */
+    uint32          checksum;       /* checksum of encoded script */
+} CacheHeader;
+
+/* Compare headers up to, not including, the length of the encoded script. */
+#define CACHE_KEY_SIZE  offsetof(CacheHeader, length)
+
+static char *
+GetCacheFileName(JSContext *cx, JSObject *obj, JSPrincipals *principals,
+		 const jschar *chars, size_t length, uintN lineno,
+		 CacheHeader *hdr)
+{
+    const char *dir;
+    JSClass *clasp;
+    uint32 h1, h2;
+    size_t i;
+    char *name;
+
+    /*
+     * Only scripts compiled against an object that declares variables by
+     * defining properties on itself can be cached.
+     */
+    dir = cx->runtime->scriptCacheDir;
+    if (!dir || principals)
+	return NULL;
+    clasp = obj->map->clasp;
+    if (clasp == &js_FunctionClass || clasp == &js_WithClass
+#if JS_HAS_CALL_OBJECT
+	|| clasp == &js_CallClass
+#endif
+	) {
+	return NULL;
+    }
+
+    h1 = (uint32)lineno;
+    h2 = 0x811c9dc5 ^ (uint32)cx->version;
+    for (i = 0; i < length; i++) {
+	h1 = (h1 >> 28) ^ (h1 << 4) ^ chars[i];
+	h2 = (h2 ^ chars[i]) * 0x01000193;
+    }
+    memset(hdr, 0, sizeof *hdr);
+    hdr->hash1 = h1;
+    hdr->hash2 = h2;
+    hdr->sourceLength = (uint32)length;
+    hdr->lineno = (uint32)lineno;
+    hdr->version = (uint32)cx->version;
+
+    name = malloc(strlen(dir) + 22);
+    if (!name)
+	return NULL;
+    sprintf(name, "%s/%08lx%08lx.jsc", dir, (unsigned long)h1,
+	    (unsigned long)h2);
+    return name;
+}
+
+static uint32
+Checksum(const uint8 *p, uint32 n)
+{
+    uint32 sum;
+
+    for (sum = 0; n != 0; n--)
+	sum = (sum >> 28) ^ (sum << 4) ^ *p++;
+    return sum;
+}
+
+JSScript *
+js_GetCachedScript(JSContext *cx, JSObject *obj, JSPrincipals *principals,
+		   const jschar *chars, size_t length, const char *filename,
+		   uintN lineno)
+{
+    CacheHeader key, hdr;
+    char *name;
+    FILE *fp;
+    uint8 *data;
+    JSScript *script;
+
+    name = GetCacheFileName(cx, obj, principals, chars, length, lineno, &key);
+    if (!name)
+	return NULL;
+    fp = fopen(name, "rb");
+    free(name);
+    if (!fp)
+	return NULL;
+
+    data = NULL;
+    script = NULL;
+    if (fread(&hdr, sizeof hdr, 1, fp) != 1 ||
+	memcmp(&hdr, &key, CACHE_KEY_SIZE) != 0 ||
+	hdr.length > PR_BIT(30)) {
+	goto out;
+    }
+    data = malloc(hdr.length);
+    if (!data ||
+	fread(data, hdr.length, 1, fp) != 1 ||
+	Checksum(data, hdr.length) != hdr.checksum) {
+	goto out;
+    }
+    script = JS_DecodeScript(cx, obj, data, hdr.length, filename);
+out:
+    free(data);
+    fclose(fp);
+    return script;
+}
+
+void
+js_CacheScript(JSContext *cx, JSObject *obj, JSPrincipals *principals,
+	       JSScript *script, const jschar *chars, size_t length,
+	       uintN lineno)
+{
+    CacheHeader hdr;
+    char *name, *tmpname;
+    void *data;
+    FILE *fp;
+    JSBool ok;
+
+    name = GetCacheFileName(cx, obj, principals, chars, length, lineno, &hdr);
+    if (!name)
+	return;
+    data = JS_EncodeScript(cx, script, &hdr.length);
+    if (!data) {
+	free(name);
+	return;
+    }
+    hdr.checksum = Checksum(data, hdr.length);
+
+    /* Write a temporary file and rename it, so readers never see part. */
+    tmpname = malloc(strlen(name) + 5);
+    if (tmpname) {
+	sprintf(tmpname, "%s.tmp", name);
+	fp = fopen(tmpname, "wb");
+	if (fp) {
+	    ok = fwrite(&hdr, sizeof hdr, 1, fp) == 1 &&
+		 fwrite(data, hdr.length, 1, fp) == 1;
+	    if (fclose(fp) != 0)
+		ok = JS_FALSE;
+	    if (!ok || rename(tmpname, name) != 0)
+		remove(tmpname);
+	}
+	free(tmpname);
+    }
+    JS_free(cx, data);
+    free(name);
+}
+
+#endif /* JSFILE */
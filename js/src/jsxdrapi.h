@@ -0,0 +1,84 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+#ifndef jsxdrapi_h___
+#define jsxdrapi_h___
+/*
+ * JS script serialization (XDR) and the on-disk compiled script cache.
+ *
+ * An encoded script holds its bytecode, source notes, and atom map, whose
+ * literals may be strings, numbers, booleans, regular expressions, or the
+ * functions the script defines, each encoded with its argument and local
+ * variable names and its own script.  Compiling a script has side effects
+ * on the object it's compiled against: top-level functions and variables
+ * are defined on it.  Decoding repeats them, so executing a decoded script
+ * has the same effect as executing the one it was encoded from.
+ *
+ * Data is in native byte order, and starts with a magic number that decoding
+ * checks, so a cache can't be shared between different machine types.
+ */
+#include "jspubtd.h"
+#include "jsprvtd.h"
+
+PR_BEGIN_EXTERN_C
+
+#define JSXDR_MAGIC     0x4a535844      /* "JSXD" in big-endian order */
+#define JSXDR_VERSION   1               /* bump when bytecode changes */
+
+/*
+ * Encode script, which must have been compiled without principals and not
+ * yet run or had traps set, into a JS_malloc'ed buffer, storing its length
+ * in *lengthp.  Return null after reporting an error, or with no error if
+ * script has a literal that can't be encoded.
+ */
+PR_EXTERN(void *)
+JS_EncodeScript(JSContext *cx, JSScript *script, uint32 *lengthp);
+
+/*
+ * Decode a script encoded by JS_EncodeScript, defining its functions and
+ * variables on obj as compiling it against obj would have.  Return null if
+ * data is malformed, or after reporting an error.
+ */
+PR_EXTERN(JSScript *)
+JS_DecodeScript(JSContext *cx, JSObject *obj, const void *data, uint32 length,
+		const char *filename);
+
+#ifdef JSFILE
+/*
+ * Look in the runtime's script cache, if it has one, for a script compiled
+ * from chars against obj, and decode it.  Return null on a miss or if the
+ * compilation can't be cached.
+ */
+extern JSScript *
+js_GetCachedScript(JSContext *cx, JSObject *obj, JSPrincipals *principals,
+		   const jschar *chars, size_t length, const char *filename,
+		   uintN lineno);
+
+/*
+ * Store script, just compiled from chars against obj, in the runtime's
+ * script cache if it has one.  Failure to do so isn't an error.
+ */
+extern void
+js_CacheScript(JSContext *cx, JSObject *obj, JSPrincipals *principals,
+	       JSScript *script, const jschar *chars, size_t length,
+	       uintN lineno);
+#endif
+
+PR_END_EXTERN_C
+
+#endif /* jsxdrapi_h___ */
@@ -0,0 +1,73 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ * 
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ * 
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+ * Lock-free queue for many producers and one consumer.  Producers link
+ * onto the head with an atomic exchange and then point the previous
+ * head at the new element; the consumer follows 'next' from the tail.
+ * A stub element, put back whenever the consumer is about to take the
+ * last real one, means the queue never goes empty and 'head' and
+ * 'tail' never have to be changed together.
+ */
+#include "plqueue.h"
+#include "pratom.h"
+
+PR_IMPLEMENT(void)
+PL_InitQueue(PLQueue *queue)
+{
+    queue->stub.next = NULL;
+    queue->head = queue->tail = &queue->stub;
+}
+
+PR_IMPLEMENT(void)
+PL_QueuePut(PLQueue *queue, PLQueueElem *elem)
+{
+    PLQueueElem *prev;
+
+    elem->next = NULL;
+    prev = (PLQueueElem *)PR_AtomicSetPtr((void **)&queue->head, elem);
+    /* between these two, the consumer can't see past prev */
+    prev->next = elem;
+}
+
+PR_IMPLEMENT(PLQueueElem *)
+PL_QueueGet(PLQueue *queue)
+{
+    PLQueueElem *tail = queue->tail;
+    PLQueueElem *next = tail->next;
+
+    if (tail == &queue->stub) {
+        if (next == NULL)
+            return NULL;
+        queue->tail = tail = next;
+        next = next->next;
+    }
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+    if (tail != queue->head)
+        return NULL;            /* a put is part way done */
+    PL_QueuePut(queue, &queue->stub);
+    next = tail->next;
+    if (next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
@@ -0,0 +1,63 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ * 
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ * 
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+#ifndef plqueue_h___
+#define plqueue_h___
+/*
+ * A lock-free FIFO queue of caller-supplied elements for many producers
+ * and one consumer, built on PR_AtomicSetPtr().  Put a PLQueueElem at
+ * the start of whatever is to be queued, as is done with PRCList.
+ *
+ * A put is a single atomic exchange and never waits on anything.  Any
+ * number of threads may put at once, but only one thread at a time may
+ * get.  A get can return NULL while a put that has started is still
+ * finishing, so a consumer that waits for elements needs its own way
+ * to be woken and should not take NULL to mean the queue is empty for
+ * good.
+ */
+#include "prtypes.h"
+
+PR_BEGIN_EXTERN_C
+
+typedef struct PLQueueElem      PLQueueElem;
+typedef struct PLQueue          PLQueue;
+
+struct PLQueueElem {
+    PLQueueElem *next;          /* next element to be got */
+};
+
+struct PLQueue {
+    PLQueueElem *head;          /* most recently put; producers swap it */
+    PLQueueElem *tail;          /* next to be got; the consumer's alone */
+    PLQueueElem stub;           /* keeps the queue from ever being empty */
+};
+
+PR_EXTERN(void)
+PL_InitQueue(PLQueue *queue);
+
+/* Put elem at the end of the queue.  Any thread may call this. */
+PR_EXTERN(void)
+PL_QueuePut(PLQueue *queue, PLQueueElem *elem);
+
+/* Get the element at the front of the queue, or NULL (see above). */
+PR_EXTERN(PLQueueElem *)
+PL_QueueGet(PLQueue *queue);
+
+PR_END_EXTERN_C
+
+#endif /* plqueue_h___ */
@@ -0,0 +1,57 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ * 
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ * 
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+ * Lock-free LIFO stack.
+ */
+#include "plstack.h"
+#include "pratom.h"
+
+PR_IMPLEMENT(void)
+PL_StackPush(PLStack *stack, PLStackElem *elem)
+{
+    PLStackElem *head;
+
+    do {
+        head = stack->head;
+        elem->next = head;
+    } while (!PR_AtomicCompareAndSwapPtr(
+        (void **)&stack->head, head, elem));
+}
+
+PR_IMPLEMENT(PLStackElem *)
+PL_StackPop(PLStack *stack)
+{
+    PLStackElem *head, *next;
+
+    do {
+        head = stack->head;
+        if (head == NULL)
+            return NULL;
+        next = head->next;
+    } while (!PR_AtomicCompareAndSwapPtr(
+        (void **)&stack->head, head, next));
+    head->next = NULL;
+    return head;
+}
+
+PR_IMPLEMENT(PLStackElem *)
+PL_StackPopAll(PLStack *stack)
+{
+    return (PLStackElem *)PR_AtomicSetPtr((void **)&stack->head, NULL);
+}
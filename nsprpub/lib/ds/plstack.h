@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ * 
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ * 
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+#ifndef plstack_h___
+#define plstack_h___
+/*
+ * A lock-free LIFO stack of caller-supplied elements, built on
+ * PR_AtomicCompareAndSwapPtr().  Put a PLStackElem at the start of
+ * whatever is to be stacked, as is done with PRCList.
+ *
+ * Any number of threads may push at once.  Popping is only safe from
+ * one thread at a time (a second popper could see an element popped
+ * and pushed again underneath it, and pop a stale successor), except
+ * that any number of threads may take the lot with PL_StackPopAll()
+ * as long as none uses PL_StackPop().
+ */
+#include "prtypes.h"
+
+PR_BEGIN_EXTERN_C
+
+typedef struct PLStackElem      PLStackElem;
+typedef struct PLStack          PLStack;
+
+struct PLStackElem {
+    PLStackElem *next;          /* next element down the stack */
+};
+
+struct PLStack {
+    PLStackElem *head;          /* top of the stack, or NULL */
+};
+
+#define PL_INIT_STACK(_stack)   ((_stack)->head = NULL)
+#define PL_STACK_IS_EMPTY(_stack) (NULL == (_stack)->head)
+
+/* Push elem onto the stack. */
+PR_EXTERN(void)
+PL_StackPush(PLStack *stack, PLStackElem *elem);
+
+/* Pop the top element off the stack, or return NULL if it's empty. */
+PR_EXTERN(PLStackElem *)
+PL_StackPop(PLStack *stack);
+
+/*
+ * Empty the stack, returning its elements linked through 'next' from
+ * the most recently pushed down, or NULL if it was empty.
+ */
+PR_EXTERN(PLStackElem *)
+PL_StackPopAll(PLStack *stack);
+
+PR_END_EXTERN_C
+
+#endif /* plstack_h___ */
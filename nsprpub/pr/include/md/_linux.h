@@ -60,6 +60,49 @@
 #define _PR_NEED_FAKE_POLL
 #endif
 
+/*
+ * epoll and eventfd came with Linux 2.6 and glibc 2.8.  Where we have
+ * them, the pthreads I/O continuation thread waits with epoll.
+ */
+#if defined(__GLIBC__) \
+    && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 8))
+#define _PR_HAVE_EPOLL
+#endif
+
+/*
+ * sendfile() takes any file and splice() (glibc 2.5) moves socket data
+ * into a file through a pipe, so the pthreads PR_TransmitFile,
+ * PR_SendFile and PR_RecvFile need not copy through user space.
+ */
+#if defined(__GLIBC__) \
+    && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 5))
+#define _PR_HAVE_SENDFILE
+#define _PR_HAVE_SPLICE
+#endif
+
+/*
+ * gcc's __sync builtins (gcc 4.1 and later) are native atomic
+ * operations, compare-and-swap included, on every Linux target.
+ * __sync_lock_test_and_set() is only an acquire barrier, so the
+ * set operations put a full barrier in front of it.
+ */
+#if defined(__GNUC__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#define _PR_HAVE_ATOMIC_OPS
+#define _PR_HAVE_ATOMIC_CAS
+
+#define _MD_INIT_ATOMIC()
+#define _MD_ATOMIC_INCREMENT(val)   __sync_add_and_fetch((val), 1)
+#define _MD_ATOMIC_DECREMENT(val)   __sync_sub_and_fetch((val), 1)
+#define _MD_ATOMIC_ADD(ptr, val)    __sync_add_and_fetch((ptr), (val))
+#define _MD_ATOMIC_SET(val, newval) \
+    (__sync_synchronize(), __sync_lock_test_and_set((val), (newval)))
+#define _MD_ATOMIC_CAS(ptr, oldval, newval) \
+    __sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#define _MD_ATOMIC_SETPTR           _MD_ATOMIC_SET
+#define _MD_ATOMIC_CASPTR           _MD_ATOMIC_CAS
+#endif
+
 #define USE_SETJMP
 
 #ifdef _PR_PTHREADS
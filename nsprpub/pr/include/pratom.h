@@ -62,6 +62,66 @@ PR_EXTERN(PRInt32)	PR_AtomicDecrement(PRInt32 *val);
 */
 PR_EXTERN(PRInt32) PR_AtomicSet(PRInt32 *val, PRInt32 newval);
 
+/*
+** FUNCTION: PR_AtomicAdd
+** DESCRIPTION:
+**    Atomically add to a 32 bit value.
+** INPUTS:
+**    ptr:  a pointer to the value to add to
+**    val:  the amount to add, which may be negative
+** RETURN:
+**    the resulting value
+*/
+PR_EXTERN(PRInt32) PR_AtomicAdd(PRInt32 *ptr, PRInt32 val);
+
+/*
+** FUNCTION: PR_AtomicCompareAndSwap
+** DESCRIPTION:
+**    Atomically set a 32 bit value, if and only if it still holds the
+**    value the caller expects.
+** INPUTS:
+**    ptr: A pointer to a 32 bit value to be set
+**    oldval: The value *ptr is expected to hold
+**    newval: The new value to assign to *ptr
+** RETURN:
+**    PR_TRUE if *ptr held oldval and has been set to newval,
+**    PR_FALSE if *ptr held something else and was left alone.
+*/
+PR_EXTERN(PRBool) PR_AtomicCompareAndSwap(
+    PRInt32 *ptr, PRInt32 oldval, PRInt32 newval);
+
+/*
+** FUNCTION: PR_AtomicSetPtr
+** DESCRIPTION:
+**    Atomically set a pointer.
+** INPUTS:
+**    ptr: A pointer to the pointer to be set
+**    newval: The new value to assign to *ptr
+** RETURN:
+**    Returns the prior value
+*/
+PR_EXTERN(void*) PR_AtomicSetPtr(void **ptr, void *newval);
+
+/*
+** FUNCTION: PR_AtomicCompareAndSwapPtr
+** DESCRIPTION:
+**    The pointer width counterpart of PR_AtomicCompareAndSwap.
+** RETURN:
+**    PR_TRUE if *ptr held oldval and has been set to newval,
+**    PR_FALSE if *ptr held something else and was left alone.
+*/
+PR_EXTERN(PRBool) PR_AtomicCompareAndSwapPtr(
+    void **ptr, void *oldval, void *newval);
+
+/*
+** All of the above are full memory barriers. A few platforms have
+** native increment, decrement and set but no compare-and-swap; there
+** PR_AtomicAdd, the compare-and-swap and the pointer operations are
+** emulated with a lock, and a variable used with them should not also
+** be changed with PR_AtomicIncrement, PR_AtomicDecrement or
+** PR_AtomicSet.
+*/
+
 PR_END_EXTERN_C
 
 #endif /* pratom_h___ */
@@ -82,6 +82,25 @@ typedef enum PRTransmitFileFlags {
                                        * is transmitted. */
 } PRTransmitFileFlags;
 
+/*
+***************************************************************************
+** PRSendFileData
+**
+** Describes what PR_SendFile sends: an optional header, 'file_nbytes'
+** bytes of 'fd' starting at 'file_offset', and an optional trailer.
+** A 'file_nbytes' of zero sends the file from 'file_offset' to its end.
+***************************************************************************
+*/
+typedef struct PRSendFileData {
+    PRFileDesc *fd;             /* file to send                          */
+    PRUint32 file_offset;       /* file offset to send from              */
+    PRSize file_nbytes;         /* bytes of the file to send, or 0       */
+    const void *header;         /* sent before the file, may be NULL     */
+    PRInt32 hlen;               /* length of header                      */
+    const void *trailer;        /* sent after the file, may be NULL      */
+    PRInt32 tlen;               /* length of trailer                     */
+} PRSendFileData;
+
 /*
 **************************************************************************
 ** A network address
@@ -292,6 +311,12 @@ typedef PRStatus (PR_CALLBACK *PRGetsocketoptionFN)(
     PRFileDesc *fd, PRSocketOptionData *data);
 typedef PRStatus (PR_CALLBACK *PRSetsocketoptionFN)(
     PRFileDesc *fd, const PRSocketOptionData *data);
+typedef PRInt32 (PR_CALLBACK *PRSendfileFN)(
+    PRFileDesc *networkSocket, PRSendFileData *sendData,
+    PRTransmitFileFlags flags, PRIntervalTime timeout);
+typedef PRInt32 (PR_CALLBACK *PRRecvfileFN)(
+    PRFileDesc *networkSocket, PRFileDesc *file, PRInt32 amount,
+    PRIntervalTime timeout);
 
 struct PRIOMethods {
     PRDescType file_type;           /* Type of file represented (tos)           */
@@ -326,6 +351,8 @@ struct PRIOMethods {
                                     /* Get current setting of specified option  */
     PRSetsocketoptionFN setsocketoption;
                                     /* Set value of specified option            */
+    PRSendfileFN sendfile;          /* Send a (partial) file with header/trailer*/
+    PRRecvfileFN recvfile;          /* Receive socket data straight into a file */
 };
 
 /*
@@ -1337,6 +1364,71 @@ PR_EXTERN(PRInt32) PR_TransmitFile(
     PRFileDesc *networkSocket, PRFileDesc *sourceFile,
     const void *headers, PRInt32 hlen, PRTransmitFileFlags flags,
     PRIntervalTime timeout);
+
+/*
+*************************************************************************
+** FUNCTION: PR_SendFile
+** DESCRIPTION:
+**    SendFile sends a header, a range of a file and a trailer across a
+**    socket (networkSocket), as described by sendData. Where the
+**    platform can, the file data goes from the file to the socket
+**    without being copied through user space.
+**
+**    The PR_TRANSMITFILE_CLOSE_SOCKET flag has the same meaning as it
+**    does for PR_TransmitFile.
+**
+** INPUTS:
+**    PRFileDesc *networkSocket
+**        The socket to send data over
+**    PRSendFileData *sendData
+**        What to send (see PRSendFileData)
+**    PRTransmitFileFlags       flags
+**        Whether to close the socket after a successful transfer
+**    PRIntervalTime timeout
+**        Time limit for completion of the send operation.
+**
+** RETURNS:
+**    Returns the number of bytes written or -1 if the operation failed.
+**    The reason for the failure is obtained by calling PR_GetError().
+**************************************************************************
+*/
+
+PR_EXTERN(PRInt32) PR_SendFile(
+    PRFileDesc *networkSocket, PRSendFileData *sendData,
+    PRTransmitFileFlags flags, PRIntervalTime timeout);
+
+/*
+*************************************************************************
+** FUNCTION: PR_RecvFile
+** DESCRIPTION:
+**    RecvFile receives 'amount' bytes from a socket (networkSocket) and
+**    writes them to a file at the file's current position. It stops
+**    short only if the peer closes the connection. Where the platform
+**    can, the data goes from the socket to the file without being
+**    copied through user space.
+**
+** INPUTS:
+**    PRFileDesc *networkSocket
+**        The socket to receive data from
+**    PRFileDesc *file
+**        The file to write the data to
+**    PRInt32 amount
+**        The number of bytes to receive
+**    PRIntervalTime timeout
+**        Time limit for each wait on the socket.
+**
+** RETURNS:
+**    Returns the number of bytes written to the file, which is less
+**    than 'amount' only at end of stream (or, on a non-blocking socket,
+**    when no more data has arrived), or -1 if the operation failed.
+**    The reason for the failure is obtained by calling
+**    PR_GetError().
+**************************************************************************
+*/
+
+PR_EXTERN(PRInt32) PR_RecvFile(
+    PRFileDesc *networkSocket, PRFileDesc *file, PRInt32 amount,
+    PRIntervalTime timeout);
 /*
 *************************************************************************
 ** FUNCTION: PR_AcceptRead
@@ -1187,6 +1187,15 @@ extern PRInt64 _PR_InvalidInt64(void);
 extern PRStatus _PR_InvalidStatus(void);
 extern PRFileDesc *_PR_InvalidDesc(void);
 
+/*
+** Send and receive file methods built on the other methods, for
+** sockets that can't move file data any better (priometh.c).
+*/
+extern PRInt32 _PR_EmulateSendFile(PRFileDesc *sd, PRSendFileData *sfd,
+    PRTransmitFileFlags flags, PRIntervalTime timeout);
+extern PRInt32 _PR_EmulateRecvFile(PRFileDesc *sd, PRFileDesc *fd,
+    PRInt32 amount, PRIntervalTime timeout);
+
 extern PRStatus _PR_MapOptionName(
     PRSockOption optname, PRInt32 *level, PRInt32 *name);
 extern void _PR_InitThreads(
@@ -1536,6 +1545,18 @@ PR_EXTERN(void) _PR_MD_ATOMIC_DECREMENT(PRInt32 *);
 PR_EXTERN(void) _PR_MD_ATOMIC_SET(PRInt32 *, PRInt32);
 #define    _PR_MD_ATOMIC_SET _MD_ATOMIC_SET
 
+PR_EXTERN(PRInt32) _PR_MD_ATOMIC_ADD(PRInt32 *, PRInt32);
+#define    _PR_MD_ATOMIC_ADD _MD_ATOMIC_ADD
+
+PR_EXTERN(PRBool) _PR_MD_ATOMIC_CAS(PRInt32 *, PRInt32, PRInt32);
+#define    _PR_MD_ATOMIC_CAS _MD_ATOMIC_CAS
+
+PR_EXTERN(void*) _PR_MD_ATOMIC_SETPTR(void **, void *);
+#define    _PR_MD_ATOMIC_SETPTR _MD_ATOMIC_SETPTR
+
+PR_EXTERN(PRBool) _PR_MD_ATOMIC_CASPTR(void **, void *, void *);
+#define    _PR_MD_ATOMIC_CASPTR _MD_ATOMIC_CASPTR
+
 /* Segment related */
 PR_EXTERN(PRStatus) _PR_MD_ALLOC_SEGMENT(PRSegment *seg, PRUint32 size, void *vaddr);
 #define    _PR_MD_ALLOC_SEGMENT _MD_ALLOC_SEGMENT
@@ -67,6 +67,11 @@ PR_EXTERN(PRInt32) PR_GetPageSize(void);
 */
 PR_EXTERN(PRInt32) PR_GetPageShift(void);
 
+/*
+** Return the number of processors online, or 1 if it can't be told
+*/
+PR_EXTERN(PRInt32) PR_GetNumberOfProcessors(void);
+
 PR_END_EXTERN_C
 
 #endif /* prsystem_h___ */
@@ -0,0 +1,185 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+#ifndef prtpool_h___
+#define prtpool_h___
+
+#include "prtypes.h"
+#include "prmwait.h"
+
+PR_BEGIN_EXTERN_C
+
+/*
+** STRUCTURE:   PRThreadPool
+** DESCRIPTION:
+**      A thread pool is a fixed set of worker threads that run jobs.
+**      Each worker keeps its own queue of jobs. A worker takes the job
+**      it queued most recently first, and a worker with nothing to do
+**      takes the oldest job from another worker's queue. Jobs are
+**      taken by priority across the whole pool, highest first.
+*/
+typedef struct PRThreadPool PRThreadPool;
+
+/*
+** STRUCTURE:   PRJob
+** DESCRIPTION:
+**      A job is one call of a PRJobFn on a worker thread. A joinable
+**      job's handle stays valid until it is given to PR_JoinJob().
+*/
+typedef struct PRJob PRJob;
+
+typedef void (PR_CALLBACK *PRJobFn)(void *arg);
+
+/*
+** ENUMERATION: PRJobPriority
+** DESCRIPTION:
+**      A worker looks for a job of each priority in turn, highest
+**      first, in its own queue and then in the other workers' queues.
+**      Jobs of the same priority have no ordering.
+*/
+typedef enum PRJobPriority
+{
+    PR_JOB_PRIORITY_LOW,
+    PR_JOB_PRIORITY_NORMAL,
+    PR_JOB_PRIORITY_HIGH
+} PRJobPriority;
+
+/*
+** FUNCTION:    PR_CreateThreadPool
+** DESCRIPTION:
+**      Create a pool of 'threads' worker threads. If 'threads' is zero
+**      or less the pool gets one worker for each processor. The workers
+**      are global threads with stacks of 'stackSize' bytes (zero
+**      for the default).
+**
+**  RETURN
+**      PRThreadPool*   The new pool, or NULL with the reason available
+**                      from PR_GetError().
+*/
+PR_EXTERN(PRThreadPool*) PR_CreateThreadPool(
+    PRInt32 threads, PRUint32 stackSize);
+
+/*
+** FUNCTION:    PR_QueueJob
+** DESCRIPTION:
+**      Queue a call of 'fn' with 'arg'. A job queued from one of the
+**      pool's own workers goes to that worker's queue; others are
+**      spread over the workers in turn.
+**
+**      The result of queueing a job that is not 'joinable' only tells
+**      of success. That job frees itself when it has run, and the
+**      pointer must not be used.
+**
+**  RETURN
+**      PRJob*          The job, or NULL with the reason available from
+**                      PR_GetError().
+**  ERRORS
+**      PR_INVALID_STATE_ERROR
+**                      The pool is being shut down.
+**      PR_OUT_OF_MEMORY_ERROR
+*/
+PR_EXTERN(PRJob*) PR_QueueJob(
+    PRThreadPool *tpool, PRJobFn fn, void *arg,
+    PRJobPriority priority, PRBool joinable);
+
+/*
+** FUNCTION:    PR_QueueRecvJob
+** DESCRIPTION:
+**      Queue a call of 'fn' with 'arg' for when the receive wait 'desc'
+**      completes. The pool waits for the descriptor in a wait group
+**      of its own (see prmwait.h), so no worker is held up while
+**      the I/O is pending.
+**
+**      The pool copies 'fd', 'timeout' and 'buffer' from 'desc'.
+**      Before 'fn' is called, the pool sets 'outcome' and 'bytesRecv'
+**      in 'desc', and if the wait failed, sets the worker's error to
+**      the reason. 'desc' must remain valid until then. A wait cut
+**      short by PR_ShutdownThreadPool() still runs 'fn', with an
+**      outcome of PR_MW_INTERRUPT.
+**
+**  RETURN
+**      PRJob*          As for PR_QueueJob().
+**  ERRORS
+**      As for PR_QueueJob() and PR_AddWaitFileDesc().
+*/
+PR_EXTERN(PRJob*) PR_QueueRecvJob(
+    PRThreadPool *tpool, PRRecvWait *desc, PRJobFn fn, void *arg,
+    PRJobPriority priority, PRBool joinable);
+
+/*
+** FUNCTION:    PR_CancelJob
+** DESCRIPTION:
+**      Cancel a joinable job that has not started to run. A job waiting
+**      for I/O has its wait cancelled. The job must still be joined.
+**
+**  RETURN
+**      PRStatus        PR_SUCCESS if the job will not run.
+**  ERRORS
+**      PR_INVALID_ARGUMENT_ERROR
+**                      The job is not joinable.
+**      PR_INVALID_STATE_ERROR
+**                      The job has already started or finished.
+*/
+PR_EXTERN(PRStatus) PR_CancelJob(PRJob *job);
+
+/*
+** FUNCTION:    PR_JoinJob
+** DESCRIPTION:
+**      Wait for a joinable job to finish or be cancelled, then free it.
+**      A job of the same pool that joins another runs queued jobs
+**      while it waits, so jobs may fork and join jobs of their own.
+**
+**  RETURN
+**      PRStatus        PR_SUCCESS if the job ran.
+**  ERRORS
+**      PR_INVALID_ARGUMENT_ERROR
+**                      The job is not joinable.
+**      PR_PENDING_INTERRUPT_ERROR
+**                      The job was cancelled.
+*/
+PR_EXTERN(PRStatus) PR_JoinJob(PRJob *job);
+
+/*
+** FUNCTION:    PR_ShutdownThreadPool
+** DESCRIPTION:
+**      Stop the pool taking new jobs, cut short any job still waiting
+**      for I/O, run every job already queued and wait for the workers
+**      to exit. Handles of joinable jobs remain valid. It must not be
+**      called from one of the pool's jobs.
+**
+**  ERRORS
+**      PR_INVALID_STATE_ERROR
+**                      The pool has already been shut down.
+*/
+PR_EXTERN(PRStatus) PR_ShutdownThreadPool(PRThreadPool *tpool);
+
+/*
+** FUNCTION:    PR_DestroyThreadPool
+** DESCRIPTION:
+**      Free a pool that has been shut down and whose joinable jobs
+**      have all been joined.
+**
+**  ERRORS
+**      PR_INVALID_STATE_ERROR
+**                      The pool is running or has jobs to be joined.
+*/
+PR_EXTERN(PRStatus) PR_DestroyThreadPool(PRThreadPool *tpool);
+
+PR_END_EXTERN_C
+
+#endif /* prtpool_h___ */
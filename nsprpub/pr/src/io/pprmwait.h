@@ -25,14 +25,29 @@
 #include "prclist.h"
 #include "prthread.h"
 
-#define _PR_HASH_OFFSET 75013
 #define MAX_POLLING_INTERVAL 100
 #define _PR_POLL_COUNT_FUDGE 64
 #define MAX_POLLING_INTERVAL 100
 #define _PR_DEFAULT_HASH_LENGTH 59
 
-#define _MW_REHASH(a, i, m) _MW_HASH((PRUint32)(a) + (i) + _PR_HASH_OFFSET, m)
-#define _MW_HASH(a, m) ((((PRUint32)(a) >> 4) ^ ((PRUint32)(a) >> 10)) % (m))
+/*
+** Where the pthreads runtime has epoll, a group keeps its descriptors
+** registered with an epoll instance of its own rather than handing the
+** whole set to PR_Poll() each time one of them is wanted.
+*/
+#if defined(_PR_PTHREADS) && defined(_PR_HAVE_EPOLL)
+#define _PR_MW_EPOLL
+#define _PR_MW_EPOLL_BATCH 64
+#endif
+
+/*
+** The table lengths are all prime, so stepping through the table by
+** any amount from 1 to length - 1 will eventually visit every slot.
+*/
+#define _MW_REHASH(a, i, m) \
+    (((i) + 1 + ((PRUptrdiff)(a) >> 4) % ((m) - 1)) % (m))
+#define _MW_HASH(a, m) \
+    ((((PRUptrdiff)(a) >> 4) ^ ((PRUptrdiff)(a) >> 10)) % (m))
 #define _MW_ABORTED(_rv) \
     ((PR_FAILURE == (_rv)) && (PR_PENDING_INTERRUPT_ERROR == PR_GetError()))
 
@@ -64,6 +79,11 @@ struct PRWaitGroup
     PRPollDesc *polling_list;   /* list poller builds for polling */
     PRIntervalTime last_poll;   /* last time we polled */
     _PRWaiterHash *waiter;      /* pointer to hash table of wait receive objects */
+#if defined(_PR_MW_EPOLL)
+    PRIntn epfd;                /* epoll instance, or -1 to use PR_Poll() */
+    PRIntn wakefd;              /* eventfd used to wake the poller */
+    PRCList timed;              /* waiters with a timeout, by deadline */
+#endif
 };
 
 typedef struct _PRGlobalState
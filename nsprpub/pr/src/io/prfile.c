@@ -231,6 +231,8 @@ PRIOMethods _pr_fileMethods = {
     (PRSetsockoptFN)_PR_InvalidStatus,	
     (PRGetsocketoptionFN)_PR_InvalidStatus,	
     (PRSetsocketoptionFN)_PR_InvalidStatus,	
+    (PRSendfileFN)_PR_InvalidInt,
+    (PRRecvfileFN)_PR_InvalidInt,
 };
 
 PR_IMPLEMENT(PRIOMethods*) PR_GetFileMethods(void)
@@ -180,6 +180,19 @@ PR_IMPLEMENT(PRInt32) PR_TransmitFile(
 	return((sd->methods->transmitfile)(sd,fd,hdr,hlen,flags,timeout));
 }
 
+PR_IMPLEMENT(PRInt32) PR_SendFile(
+    PRFileDesc *sd, PRSendFileData *sfd,
+    PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+	return((sd->methods->sendfile)(sd,sfd,flags,timeout));
+}
+
+PR_IMPLEMENT(PRInt32) PR_RecvFile(
+    PRFileDesc *sd, PRFileDesc *fd, PRInt32 amount, PRIntervalTime timeout)
+{
+	return((sd->methods->recvfile)(sd,fd,amount,timeout));
+}
+
 PR_IMPLEMENT(PRInt32) PR_AcceptRead(
     PRFileDesc *sd, PRFileDesc **nd, PRNetAddr **raddr,
     void *buf, PRInt32 amount, PRIntervalTime timeout)
@@ -229,4 +242,135 @@ PR_IMPLEMENT(PRStatus) PR_SetSocketOption(
 	return((fd->methods->setsocketoption)(fd, data));
 }
 
+/*
+ * Send all 'amount' bytes of 'buf', however many sends that takes.
+ */
+static PRInt32 SendAll(
+    PRFileDesc *sd, const char *buf, PRInt32 amount, PRIntervalTime timeout)
+{
+    PRInt32 rv, count = 0;
+
+    while (count < amount) {
+        rv = PR_Send(sd, buf + count, amount - count, 0, timeout);
+        if (rv < 0) return -1;  /* PR_Send() has invoked PR_SetError() */
+        count += rv;
+    }
+    return count;
+}  /* SendAll */
+
+#define _SENDFILE_BUFSIZE	(16 * 1024)
+
+/*
+ * _PR_EmulateSendFile
+ *
+ *	Send the header, the file range and the trailer that 'sfd'
+ *	describes with ordinary reads and sends, for sockets that have
+ *	no way to send straight from a file.
+ *
+ *	return number of bytes sent or -1 on error
+ */
+PRInt32 _PR_EmulateSendFile(
+    PRFileDesc *sd, PRSendFileData *sfd,
+    PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+    PRInt32 rv = -1, count = 0, rlen, want;
+    PRSize left = sfd->file_nbytes;
+    PRFileInfo info;
+    char *buf = NULL;
+
+    if (0 == sfd->file_nbytes) {
+        if (PR_GetOpenFileInfo(sfd->fd, &info) == PR_FAILURE)
+            return -1;
+        if ((PRUint32)info.size < sfd->file_offset) {
+            PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+            return -1;
+        }
+    }
+
+    if (sfd->hlen > 0) {
+        if (SendAll(sd, (const char*)sfd->header, sfd->hlen, timeout) < 0)
+            goto done;
+        count += sfd->hlen;
+    }
+
+    if (PR_Seek(sfd->fd, sfd->file_offset, PR_SEEK_SET) < 0)
+        goto done;
+    buf = (char*)PR_MALLOC(_SENDFILE_BUFSIZE);
+    if (buf == NULL) {
+        PR_SetError(PR_OUT_OF_MEMORY_ERROR, 0);
+        goto done;
+    }
+    /* a 'file_nbytes' of zero means send up to the end of the file */
+    while ((0 == sfd->file_nbytes) || (left > 0)) {
+        want = ((0 == sfd->file_nbytes) || (left > _SENDFILE_BUFSIZE)) ?
+            _SENDFILE_BUFSIZE : (PRInt32)left;
+        rlen = PR_Read(sfd->fd, buf, want);
+        if (rlen < 0) goto done;  /* PR_Read() has invoked PR_SetError() */
+        if (rlen == 0) {
+            if (0 == sfd->file_nbytes) break;
+            PR_SetError(PR_END_OF_FILE_ERROR, 0);
+            goto done;
+        }
+        if (SendAll(sd, buf, rlen, timeout) < 0)
+            goto done;
+        count += rlen;
+        left -= rlen;
+    }
+
+    if (sfd->tlen > 0) {
+        if (SendAll(sd, (const char*)sfd->trailer, sfd->tlen, timeout) < 0)
+            goto done;
+        count += sfd->tlen;
+    }
+
+    if (flags & PR_TRANSMITFILE_CLOSE_SOCKET)
+        PR_Close(sd);
+    rv = count;
+
+done:
+    if (buf)
+        PR_DELETE(buf);
+    return rv;
+}  /* _PR_EmulateSendFile */
+
+/*
+ * _PR_EmulateRecvFile
+ *
+ *	Receive 'amount' bytes from socket sd and write them to fd, with
+ *	ordinary receives and writes.
+ *
+ *	return number of bytes written, which is short only at end of
+ *	stream, or -1 on error
+ */
+PRInt32 _PR_EmulateRecvFile(
+    PRFileDesc *sd, PRFileDesc *fd, PRInt32 amount, PRIntervalTime timeout)
+{
+    PRInt32 rv = -1, count = 0, rlen, wlen;
+    char *buf;
+
+    buf = (char*)PR_MALLOC(_SENDFILE_BUFSIZE);
+    if (buf == NULL) {
+        PR_SetError(PR_OUT_OF_MEMORY_ERROR, 0);
+        return -1;
+    }
+    while (count < amount) {
+        rlen = PR_Recv(sd, buf,
+            (amount - count > _SENDFILE_BUFSIZE) ?
+                _SENDFILE_BUFSIZE : amount - count, 0, timeout);
+        if (rlen < 0) goto done;  /* PR_Recv() has invoked PR_SetError() */
+        if (rlen == 0) break;  /* end of stream */
+        for (wlen = 0; wlen < rlen; ) {
+            rv = PR_Write(fd, buf + wlen, rlen - wlen);
+            if (rv < 0) goto done;
+            wlen += rv;
+        }
+        count += rlen;
+    }
+    rv = count;
+
+done:
+    PR_DELETE(buf);
+    return rv;
+}  /* _PR_EmulateRecvFile */
+
 /* priometh.c */
@@ -316,6 +316,25 @@ static PRStatus PR_CALLBACK pl_DefSetsocketoption (
     return (fd->lower->methods->setsocketoption)(fd->lower, data);
 }
 
+static PRInt32 PR_CALLBACK pl_DefSendfile (
+    PRFileDesc *sd, PRSendFileData *sfd,
+    PRTransmitFileFlags flags, PRIntervalTime t)
+{
+    PR_ASSERT(sd != NULL);
+    PR_ASSERT(sd->lower != NULL);
+
+    return sd->lower->methods->sendfile(sd->lower, sfd, flags, t);
+}
+
+static PRInt32 PR_CALLBACK pl_DefRecvfile (
+    PRFileDesc *sd, PRFileDesc *fd, PRInt32 amount, PRIntervalTime t)
+{
+    PR_ASSERT(sd != NULL);
+    PR_ASSERT(sd->lower != NULL);
+
+    return sd->lower->methods->recvfile(sd->lower, fd, amount, t);
+}
+
 /* Methods for the top of the stack.  Just call down to the next fd. */
 static struct PRIOMethods pl_methods = {
     PR_DESC_LAYERED,
@@ -347,7 +366,9 @@ static struct PRIOMethods pl_methods = {
     pl_DefGetsockopt,
     pl_DefSetsockopt,
     pl_DefGetsocketoption,
-    pl_DefSetsocketoption
+    pl_DefSetsocketoption,
+    pl_DefSendfile,
+    pl_DefRecvfile
 };
 
 PR_IMPLEMENT(PRIOMethods const*) PR_GetDefaultIOMethods()
@@ -23,11 +23,24 @@
 #include "prerror.h"
 #include "pprmwait.h"
 
+#if defined(_PR_MW_EPOLL)
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 static PRLock *mw_lock = NULL;
 static _PRGlobalState *mw_state = NULL;
 
 static PRIntervalTime max_polling_interval;
 
+static const PRUint16 prime_number[] = {
+    _PR_DEFAULT_HASH_LENGTH, 179, 521, 907, 1427,
+    2711, 3917, 5021, 8219, 11549, 18911, 26711, 33749, 44771};
+
 /******************************************************************/
 /******************************************************************/
 /************************ The private portion *********************/
@@ -134,52 +147,108 @@ static _PR_HashStory MW_AddHashInternal(PRRecvWait *desc, _PRWaiterHash *hash)
 static _PR_HashStory MW_ExpandHashInternal(PRWaitGroup *group)
 {
     PRRecvWait **desc;
-    PRUint32 pidx, length = 0;
+    PRUint32 pidx, length;
     _PRWaiterHash *newHash, *oldHash = group->waiter;
-    
-
-    static const PRInt32 prime_number[] = {
-        _PR_DEFAULT_HASH_LENGTH, 179, 521, 907, 1427,
-        2711, 3917, 5021, 8219, 11549, 18911, 26711, 33749, 44771};
-    PRUintn primes = (sizeof(prime_number) / sizeof(PRIntn));
+    PRUintn primes = (sizeof(prime_number) / sizeof(prime_number[0]));
 
     /* look up the next size we'd like to use for the hash table */
     for (pidx = 0; pidx < primes; ++pidx)
     {
-        if (prime_number[pidx] == oldHash->length)
-        {
-            length = prime_number[pidx + 1];
-            break;
-        }
+        if (prime_number[pidx] == oldHash->length) break;
     }
-    if (0 == length)
+
+    while (++pidx < primes)
     {
-        PR_SetError(PR_OUT_OF_MEMORY_ERROR, 0);
-        return _prmw_error;  /* we're hosed */
-    }
+        length = prime_number[pidx];
 
-    /* allocate the new hash table and fill it in with the old */
-    newHash = (_PRWaiterHash*)PR_CALLOC(
-        sizeof(_PRWaiterHash) + (length * sizeof(PRRecvWait*)));
+        /* allocate the new hash table and fill it in with the old */
+        newHash = (_PRWaiterHash*)PR_CALLOC(
+            sizeof(_PRWaiterHash) + (length * sizeof(PRRecvWait*)));
+        if (NULL == newHash) break;
 
-    newHash->length = length;
-    for (desc = &oldHash->recv_wait; newHash->count < oldHash->count; ++desc)
-    {
-        if (NULL != *desc)
+        newHash->length = length;
+        desc = &oldHash->recv_wait;
+        for (; newHash->count < oldHash->count; ++desc)
         {
-            if (_prmw_success != MW_AddHashInternal(*desc, newHash))
+            if (NULL != *desc)
             {
-                PR_ASSERT(!"But, but, but ...");
-                PR_DELETE(newHash);
-                return _prmw_error;
+                if (_prmw_success != MW_AddHashInternal(*desc, newHash))
+                    break;
             }
         }
+        if (newHash->count == oldHash->count)
+        {
+            PR_DELETE(group->waiter);
+            group->waiter = newHash;
+            return _prmw_success;
+        }
+        PR_DELETE(newHash);  /* unlucky; try the next size up */
     }
-    PR_DELETE(group->waiter);
-    group->waiter = newHash;
-    return _prmw_success;
+
+    PR_SetError(PR_OUT_OF_MEMORY_ERROR, 0);
+    return _prmw_error;  /* we're hosed */
 }  /* MW_ExpandHashInternal */
 
+#if defined(_PR_MW_EPOLL)
+static PRIntn _MW_EpollOsfd(PRFileDesc *fd)
+{
+    while (NULL != fd->lower) fd = fd->lower;
+    return fd->secret->md.osfd;
+}  /* _MW_EpollOsfd */
+
+static PRStatus _MW_EpollArm(PRWaitGroup *group, PRRecvWait *desc)
+{
+    /*
+    ** Each descriptor is armed for a single readiness event. Once that
+    ** has been reported the kernel disarms it, so an event can only be
+    ** handed to one waiting thread. Re-adding a descriptor that's been
+    ** in the group before only needs to re-arm it.
+    */
+    struct epoll_event ev;
+    PRIntn osfd = _MW_EpollOsfd(desc->fd);
+
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = desc->fd;
+    if (0 == epoll_ctl(group->epfd, EPOLL_CTL_MOD, osfd, &ev))
+        return PR_SUCCESS;
+    if ((ENOENT == errno)
+    && (0 == epoll_ctl(group->epfd, EPOLL_CTL_ADD, osfd, &ev)))
+        return PR_SUCCESS;
+    return PR_FAILURE;
+}  /* _MW_EpollArm */
+
+static void _MW_EpollWake(PRWaitGroup *group)
+{
+    PRUint64 one = 1;
+    if (NULL != group->poller)
+        (void)write(group->wakefd, &one, sizeof(one));
+}  /* _MW_EpollWake */
+
+static void _MW_EpollDone(
+    PRWaitGroup *group, PRRecvWait *desc, PRMWStatus outcome)
+{
+    /*
+    ** A descriptor that completed for any reason other than readiness
+    ** is still armed and has to be taken out of the epoll set. If it
+    ** was timed, it comes off the deadline list and is left holding
+    ** whatever time it had remaining.
+    */
+    if (PR_MW_SUCCESS != outcome)
+    {
+        struct epoll_event ev;
+        (void)epoll_ctl(
+            group->epfd, EPOLL_CTL_DEL, _MW_EpollOsfd(desc->fd), &ev);
+    }
+    if (!PR_CLIST_IS_EMPTY(&desc->internal))
+    {
+        PRInt32 remaining = (PRInt32)(desc->timeout - PR_IntervalNow());
+        PR_REMOVE_LINK(&desc->internal);
+        desc->timeout = (remaining > 0) ?
+            (PRIntervalTime)remaining : PR_INTERVAL_NO_WAIT;
+    }
+}  /* _MW_EpollDone */
+#endif /* defined(_PR_MW_EPOLL) */
+
 static void _MW_DoneInternal(
     PRWaitGroup *group, PRRecvWait **waiter, PRMWStatus outcome)
 {
@@ -192,6 +261,9 @@ static void _MW_DoneInternal(
 
 #if 0
     printf("Removing 0x%x->0x%x\n", *waiter, (*waiter)->fd);
+#endif
+#if defined(_PR_MW_EPOLL)
+    if (-1 != group->epfd) _MW_EpollDone(group, *waiter, outcome);
 #endif
     (*waiter)->outcome = outcome;
     PR_APPEND_LINK(&((*waiter)->internal), &group->io_ready);
@@ -221,6 +293,150 @@ static PRRecvWait **_MW_LookupInternal(PRWaitGroup *group, PRFileDesc *fd)
     return NULL;
 }  /* _MW_LookupInternal */
 
+#if defined(_PR_MW_EPOLL)
+static PRRecvWait **_MW_LookupDescInternal(
+    PRWaitGroup *group, PRRecvWait *desc)
+{
+    /*
+    ** Like _MW_LookupInternal(), but finds this particular receive
+    ** wait object even if another one shares its file descriptor.
+    */
+    PRRecvWait **slot;
+    PRIntn rehash = 11;
+    _PRWaiterHash *hash = group->waiter;
+    PRUintn hidx = _MW_HASH(desc->fd, hash->length);
+
+    while (rehash-- > 0)
+    {
+        slot = (&hash->recv_wait) + hidx;
+        if (*slot == desc) return slot;
+        hidx = _MW_REHASH(desc->fd, hidx, hash->length);
+    }
+    return NULL;
+}  /* _MW_LookupDescInternal */
+
+static PRStatus _MW_EpollInternal(PRWaitGroup *group)
+{
+    /*
+    ** The calling thread is the group's poller for one round. It
+    ** collects a batch of readiness events, moves each descriptor
+    ** reported onto the I/O ready list (notifying one waiting thread
+    ** per descriptor), expires those whose deadlines have passed and
+    ** then returns, so that one of the notified threads takes over
+    ** polling while this one goes off to run its completion.
+    **
+    ** Nothing here is done in proportion to the size of the group.
+    */
+    PRIntn count, index, msecs;
+    PRIntervalTime now, wait = max_polling_interval;
+    PRThread *me = PR_GetCurrentThread();
+    struct epoll_event events[_PR_MW_EPOLL_BATCH];
+
+    group->poller = me;
+
+    if (!PR_CLIST_IS_EMPTY(&group->timed))
+    {
+        PRRecvWait *first = (PRRecvWait*)PR_LIST_HEAD(&group->timed);
+        PRInt32 remaining = (PRInt32)(first->timeout - PR_IntervalNow());
+        if (remaining <= 0) wait = PR_INTERVAL_NO_WAIT;
+        else if ((PRIntervalTime)remaining < wait) wait = remaining;
+    }
+    /* round up so we don't wake just short of the deadline */
+    msecs = (PRIntn)PR_IntervalToMilliseconds(wait);
+    if (PR_MillisecondsToInterval(msecs) < wait) msecs += 1;
+
+    PR_Unlock(group->ml);
+    count = epoll_wait(group->epfd, events, _PR_MW_EPOLL_BATCH, msecs);
+    PR_Lock(group->ml);
+
+    group->poller = NULL;
+
+    for (index = 0; index < count; ++index)
+    {
+        PRFileDesc *fd = (PRFileDesc*)events[index].data.ptr;
+        if (NULL == fd)
+        {
+            PRUint64 wakeups;
+            (void)read(group->wakefd, &wakeups, sizeof(wakeups));
+        }
+        else if (events[index].events & (EPOLLIN | EPOLLERR))
+        {
+            /*
+            ** A hang up alone isn't readiness (PR_Poll() doesn't count
+            ** it either). It's what an unconnected socket reports, so
+            ** leave such a descriptor disarmed, waiting on its timeout.
+            */
+            PRRecvWait **waiter = _MW_LookupInternal(group, fd);
+            if (NULL != waiter)
+                _MW_DoneInternal(group, waiter, PR_MW_SUCCESS);
+        }
+    }
+
+    now = PR_IntervalNow();
+    while (!PR_CLIST_IS_EMPTY(&group->timed))
+    {
+        PRRecvWait *first = (PRRecvWait*)PR_LIST_HEAD(&group->timed);
+        if ((PRInt32)(first->timeout - now) > 0) break;
+        _MW_DoneInternal(
+            group, _MW_LookupDescInternal(group, first), PR_MW_TIMEOUT);
+    }
+
+    /*
+    ** The poller isn't waiting on a condition, so PR_Interrupt() can't
+    ** reach it. It notices the next time it comes up for air, which is
+    ** never more than max_polling_interval.
+    */
+    if (me->state & PT_THREAD_ABORTED)
+    {
+        me->state &= ~PT_THREAD_ABORTED;
+        PR_SetError(PR_PENDING_INTERRUPT_ERROR, 0);
+        return PR_FAILURE;
+    }
+    if ((-1 == count) && (EINTR != errno))
+    {
+        _PR_MD_MAP_SELECT_ERROR(errno);
+        return PR_FAILURE;
+    }
+    return PR_SUCCESS;  /* we return with the lock held */
+}  /* _MW_EpollInternal */
+
+static void _MW_EpollAddInternal(PRWaitGroup *group, PRRecvWait *desc)
+{
+    /*
+    ** A timed descriptor goes on the group's deadline list, holding its
+    ** deadline in place of the timeout until it completes. Descriptors
+    ** tend to be added with the same timeout, so look from the tail.
+    */
+    PR_INIT_CLIST(&desc->internal);
+    if (PR_INTERVAL_NO_TIMEOUT != desc->timeout)
+    {
+        PRCList *link;
+        desc->timeout += PR_IntervalNow();
+        for (link = PR_LIST_TAIL(&group->timed);
+        link != &group->timed; link = link->prev)
+        {
+            if ((PRInt32)(((PRRecvWait*)link)->timeout - desc->timeout) <= 0)
+                break;
+        }
+        PR_INSERT_AFTER(&desc->internal, link);
+        if (link == &group->timed)
+            _MW_EpollWake(group);  /* the poller's sleeping too long */
+    }
+
+    if (PR_FAILURE == _MW_EpollArm(group, desc))
+    {
+        /*
+        ** epoll won't have it (a regular file, say). PR_Poll() would
+        ** call that readable, so complete it now and let the initial
+        ** receive report whatever is wrong with it.
+        */
+        _MW_DoneInternal(
+            group, _MW_LookupDescInternal(group, desc), PR_MW_SUCCESS);
+        _MW_EpollWake(group);
+    }
+}  /* _MW_EpollAddInternal */
+#endif /* defined(_PR_MW_EPOLL) */
+
 static PRStatus _MW_PollInternal(PRWaitGroup *group)
 {
     PRRecvWait **waiter;
@@ -408,6 +624,11 @@ PR_IMPLEMENT(PRStatus) PR_AddWaitFileDesc(
         if (_prmw_success != hrv) break;
     } while (PR_TRUE);
 
+#if defined(_PR_MW_EPOLL)
+    if ((_prmw_success == hrv) && (-1 != group->epfd))
+        _MW_EpollAddInternal(group, desc);
+#endif
+
     PR_NotifyCondVar(group->new_business);  /* tell the world */
     rv = (_prmw_success == hrv) ? PR_SUCCESS : PR_FAILURE;
     
@@ -447,7 +668,10 @@ PR_IMPLEMENT(PRRecvWait*) PR_WaitRecvReady(PRWaitGroup *group)
                 if (_prmw_running != group->state) goto aborted;
                 rv = PR_WaitCondVar(group->new_business, PR_INTERVAL_NO_TIMEOUT);
                 if (_MW_ABORTED(rv)) goto aborted;
+                /* it may have been added and cancelled meanwhile */
+                if (!PR_CLIST_IS_EMPTY(&group->io_ready)) break;
             }
+            if (!PR_CLIST_IS_EMPTY(&group->io_ready)) continue;
 
             /*
             ** Is there a polling thread yet? If not, grab this thread
@@ -455,6 +679,20 @@ PR_IMPLEMENT(PRRecvWait*) PR_WaitRecvReady(PRWaitGroup *group)
             */
             if (NULL == group->poller)
             {
+#if defined(_PR_MW_EPOLL)
+                if (-1 != group->epfd)
+                {
+                    /*
+                    ** Poll for one batch, then take what's ready (or
+                    ** poll again). Threads notified by the poll take
+                    ** the rest, and one of them will poll next.
+                    */
+                    if (_prmw_running != group->state) goto aborted;
+                    if (PR_FAILURE == _MW_EpollInternal(group))
+                        goto failed_poll;
+                    continue;
+                }
+#endif
                 /*
                 ** This thread will stay do polling until it becomes the only one
                 ** left to service a completion. Then it will return and there will
@@ -463,6 +701,7 @@ PR_IMPLEMENT(PRRecvWait*) PR_WaitRecvReady(PRWaitGroup *group)
                 ** The polling function should only return w/ failure or
                 ** with some I/O ready.
                 */
+                if (_prmw_running != group->state) goto aborted;
                 if (PR_FAILURE == _MW_PollInternal(group)) goto failed_poll;
                 if (PR_CLIST_IS_EMPTY(&group->io_ready)) continue;  /* timeout */
             }
@@ -470,9 +709,13 @@ PR_IMPLEMENT(PRRecvWait*) PR_WaitRecvReady(PRWaitGroup *group)
             {
                 while (PR_CLIST_IS_EMPTY(&group->io_ready))
                 {
+                    /* if the poller has gone, take its place */
+                    if (NULL == group->poller) break;
+                    if (_prmw_running != group->state) goto aborted;
                     rv = PR_WaitCondVar(group->io_complete, PR_INTERVAL_NO_TIMEOUT);
                     if (_MW_ABORTED(rv)) goto aborted;
                 }
+                if (PR_CLIST_IS_EMPTY(&group->io_ready)) continue;
             }
         }
         io_ready = PR_LIST_HEAD(&group->io_ready);
@@ -480,6 +723,15 @@ PR_IMPLEMENT(PRRecvWait*) PR_WaitRecvReady(PRWaitGroup *group)
         PR_ASSERT(io_ready != NULL);
         PR_REMOVE_LINK(io_ready);
 
+        /*
+        ** If that emptied the list and nobody is polling, hand the job
+        ** to one of the threads still waiting for a completion.
+        */
+        if (PR_CLIST_IS_EMPTY(&group->io_ready)
+        && (NULL == group->poller) && (group->waiting_threads > 1)
+        && (0 != group->waiter->count))
+            PR_NotifyCondVar(group->io_complete);
+
         /* If the operation failed, record the reason why */
         switch (((PRRecvWait*)io_ready)->outcome)
         {
@@ -487,7 +739,13 @@ PR_IMPLEMENT(PRRecvWait*) PR_WaitRecvReady(PRWaitGroup *group)
                 PR_ASSERT(PR_MW_PENDING != ((PRRecvWait*)io_ready)->outcome);
                 break;
             case PR_MW_SUCCESS:
+                /*
+                ** The descriptor belongs to this thread now, so do the
+                ** receive without holding up the rest of the group.
+                */
+                PR_Unlock(group->ml);
                 _MW_InitialRecv(io_ready);
+                PR_Lock(group->ml);
                 break;
             case PR_MW_TIMEOUT:
                 PR_SetError(PR_IO_TIMEOUT_ERROR, 0);
@@ -502,6 +760,8 @@ PR_IMPLEMENT(PRRecvWait*) PR_WaitRecvReady(PRWaitGroup *group)
 aborted:
 failed_poll:
     group->waiting_threads -= 1;
+    if ((_prmw_stopping == group->state) && (0 == group->waiting_threads))
+        PR_NotifyAllCondVar(group->mw_manage);  /* the canceller waits */
 invalid_state:
     (void)MW_TestForShutdownInternal(group);
     PR_Unlock(group->ml);
@@ -537,6 +797,11 @@ PR_IMPLEMENT(PRStatus) PR_CancelWaitFileDesc(PRWaitGroup *group, PRRecvWait *des
     {
         /* it was in the wait table */
         _MW_DoneInternal(group, recv_wait, PR_MW_INTERRUPT);
+        /* a thread waiting for business may be the only one there is */
+        PR_NotifyCondVar(group->new_business);
+#if defined(_PR_MW_EPOLL)
+        if (-1 != group->epfd) _MW_EpollWake(group);
+#endif
         goto found;
     }
     if (!PR_CLIST_IS_EMPTY(&group->io_ready))
@@ -583,8 +848,22 @@ PR_IMPLEMENT(PRRecvWait*) PR_CancelWaitGroup(PRWaitGroup *group)
             group->state = _prmw_stopping;  /* so nothing new comes in */
         if (0 == group->waiting_threads)  /* is there anybody else? */
             group->state = _prmw_stopped;  /* we can stop right now */
-        while (_prmw_stopped != group->state)
+        else
+        {
+            /* get the waiting threads to notice */
+            PR_NotifyAllCondVar(group->io_complete);
+            PR_NotifyAllCondVar(group->new_business);
+#if defined(_PR_MW_EPOLL)
+            if (-1 != group->epfd) _MW_EpollWake(group);
+#endif
+        }
+        /*
+        ** The group stops when the last of them leaves, though there
+        ** may still be receive wait objects in it. Those are ours.
+        */
+        while (0 != group->waiting_threads)
             (void)PR_WaitCondVar(group->mw_manage, PR_INTERVAL_NO_TIMEOUT);
+        group->state = _prmw_stopped;
 
         /* make all the existing descriptors look done/interrupted */
         for (desc = &group->waiter->recv_wait; group->waiter->count > 0; ++desc)
@@ -610,11 +889,17 @@ PR_IMPLEMENT(PRRecvWait*) PR_CancelWaitGroup(PRWaitGroup *group)
     return recv_wait;
 }  /* PR_CancelWaitGroup */
 
-PR_IMPLEMENT(PRWaitGroup*) PR_CreateWaitGroup(PRInt32 size /* ignored */)
+PR_IMPLEMENT(PRWaitGroup*) PR_CreateWaitGroup(PRInt32 size)
 {
+    PRUintn pidx;
     PRWaitGroup *wg = NULL;
+    PRUintn primes = (sizeof(prime_number) / sizeof(prime_number[0]));
     if (PR_FAILURE == MW_Init()) goto failed;
 
+    /* start the hash table at the first size that will hold 'size' */
+    for (pidx = 0; pidx + 1 < primes; ++pidx)
+        if (prime_number[pidx] >= size) break;
+
     if (NULL == (wg = PR_NEWZAP(PRWaitGroup))) goto failed;
     /* the wait group itself */
     wg->ml = PR_NewLock();
@@ -634,10 +919,38 @@ PR_IMPLEMENT(PRWaitGroup*) PR_CreateWaitGroup(PRInt32 size /* ignored */)
     /* the waiters sequence */
     wg->waiter = (_PRWaiterHash*)PR_CALLOC(
         sizeof(_PRWaiterHash) +
-        (_PR_DEFAULT_HASH_LENGTH * sizeof(PRRecvWait*)));
+        (prime_number[pidx] * sizeof(PRRecvWait*)));
     if (NULL == wg->waiter) goto failed_waiter;
     wg->waiter->count = 0;
-    wg->waiter->length = _PR_DEFAULT_HASH_LENGTH;
+    wg->waiter->length = prime_number[pidx];
+
+#if defined(_PR_MW_EPOLL)
+    /*
+    ** Use epoll unless the kernel hasn't got it, or NSPR_NO_EPOLL is
+    ** set in the environment. The group's eventfd is registered with a
+    ** null pointer, which no receive wait object can have for its fd.
+    */
+    PR_INIT_CLIST(&wg->timed);
+    wg->wakefd = wg->epfd = -1;
+    if (NULL == getenv("NSPR_NO_EPOLL"))
+        wg->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (-1 != wg->epfd)
+    {
+        struct epoll_event ev;
+
+        memset(&ev, 0, sizeof(ev));
+        wg->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if ((-1 == wg->wakefd)
+        || (0 != epoll_ctl(wg->epfd, EPOLL_CTL_ADD, wg->wakefd, &ev)))
+        {
+            if (-1 != wg->wakefd) (void)close(wg->wakefd);
+            (void)close(wg->epfd);
+            wg->wakefd = wg->epfd = -1;
+        }
+    }
+#endif
 
     PR_Lock(mw_lock);
     PR_APPEND_LINK(&wg->group_link, &mw_state->group_list);
@@ -689,6 +1002,13 @@ PR_IMPLEMENT(PRStatus) PR_DestroyWaitGroup(PRWaitGroup *group)
         PR_Unlock(mw_lock);
 
         PR_DELETE(group->waiter);
+#if defined(_PR_MW_EPOLL)
+        if (-1 != group->epfd)
+        {
+            (void)close(group->wakefd);
+            (void)close(group->epfd);
+        }
+#endif
         PR_DestroyCondVar(group->new_business);
         PR_DestroyCondVar(group->io_complete);
         PR_DestroyCondVar(group->io_taken);
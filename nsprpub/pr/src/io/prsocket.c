@@ -787,6 +787,40 @@ PRIntervalTime timeout)
 	return rv;
 }
 
+static PRInt32 PR_CALLBACK SocketSendFile(PRFileDesc *sd,
+PRSendFileData *sfd, PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+	PRThread *me = _PR_MD_CURRENT_THREAD();
+
+	if (_PR_PENDING_INTERRUPT(me)) {
+		me->flags &= ~_PR_INTERRUPT;
+		PR_SetError(PR_PENDING_INTERRUPT_ERROR, 0);
+		return -1;
+	}
+	if (_PR_IO_PENDING(me)) {
+		PR_SetError(PR_IO_PENDING_ERROR, 0);
+		return -1;
+	}
+	return _PR_EmulateSendFile(sd, sfd, flags, timeout);
+}
+
+static PRInt32 PR_CALLBACK SocketRecvFile(PRFileDesc *sd, PRFileDesc *fd,
+PRInt32 amount, PRIntervalTime timeout)
+{
+	PRThread *me = _PR_MD_CURRENT_THREAD();
+
+	if (_PR_PENDING_INTERRUPT(me)) {
+		me->flags &= ~_PR_INTERRUPT;
+		PR_SetError(PR_PENDING_INTERRUPT_ERROR, 0);
+		return -1;
+	}
+	if (_PR_IO_PENDING(me)) {
+		PR_SetError(PR_IO_PENDING_ERROR, 0);
+		return -1;
+	}
+	return _PR_EmulateRecvFile(sd, fd, amount, timeout);
+}
+
 static PRStatus PR_CALLBACK SocketGetName(PRFileDesc *fd, PRNetAddr *addr)
 {
 	PRInt32 result;
@@ -955,7 +989,9 @@ static PRIOMethods tcpMethods = {
 	SocketGetSockOpt,
 	SocketSetSockOpt,
 	_PR_SocketGetSocketOption,
-	_PR_SocketSetSocketOption
+	_PR_SocketSetSocketOption,
+	SocketSendFile,
+	SocketRecvFile
 };
 
 static PRIOMethods udpMethods = {
@@ -988,7 +1024,9 @@ static PRIOMethods udpMethods = {
 	SocketGetSockOpt,
 	SocketSetSockOpt,
 	_PR_SocketGetSocketOption,
-	_PR_SocketSetSocketOption
+	_PR_SocketSetSocketOption,
+	(PRSendfileFN)_PR_InvalidInt,
+	(PRRecvfileFN)_PR_InvalidInt
 };
 
 PR_IMPLEMENT(PRIOMethods*) PR_GetTCPMethods()
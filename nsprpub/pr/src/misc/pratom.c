@@ -32,7 +32,7 @@
  * the following will not be compiled in.
  */
 
-#ifndef _PR_HAVE_ATOMIC_OPS
+#if !defined(_PR_HAVE_ATOMIC_OPS) || !defined(_PR_HAVE_ATOMIC_CAS)
 
 /*
  * We use a single lock for all the emulated atomic operations.
@@ -40,6 +40,11 @@
  */
 
 static PRLock *monitor = NULL;
+
+#endif
+
+#ifndef _PR_HAVE_ATOMIC_OPS
+
 void _PR_MD_INIT_ATOMIC()
 {
     if (monitor == NULL) {
@@ -80,9 +85,66 @@ _PR_MD_ATOMIC_SET(PRInt32 *val, PRInt32 newval)
 
 #endif  /* !_PR_HAVE_ATOMIC_OPS */
 
+/*
+ * Platforms that have native atomic operations but no compare-and-swap
+ * still emulate the ones built on compare-and-swap, with the same lock.
+ */
+
+#ifndef _PR_HAVE_ATOMIC_CAS
+
+PR_IMPLEMENT(PRInt32)
+_PR_MD_ATOMIC_ADD(PRInt32 *ptr, PRInt32 val)
+{
+    PRInt32 rv;
+    PR_Lock(monitor);
+    rv = (*ptr += val);
+    PR_Unlock(monitor);
+    return rv;
+}
+
+PR_IMPLEMENT(PRBool)
+_PR_MD_ATOMIC_CAS(PRInt32 *ptr, PRInt32 oldval, PRInt32 newval)
+{
+    PRBool rv;
+    PR_Lock(monitor);
+    rv = (*ptr == oldval) ? PR_TRUE : PR_FALSE;
+    if (rv) *ptr = newval;
+    PR_Unlock(monitor);
+    return rv;
+}
+
+PR_IMPLEMENT(void*)
+_PR_MD_ATOMIC_SETPTR(void **ptr, void *newval)
+{
+    void *rv;
+    PR_Lock(monitor);
+    rv = *ptr;
+    *ptr = newval;
+    PR_Unlock(monitor);
+    return rv;
+}
+
+PR_IMPLEMENT(PRBool)
+_PR_MD_ATOMIC_CASPTR(void **ptr, void *oldval, void *newval)
+{
+    PRBool rv;
+    PR_Lock(monitor);
+    rv = (*ptr == oldval) ? PR_TRUE : PR_FALSE;
+    if (rv) *ptr = newval;
+    PR_Unlock(monitor);
+    return rv;
+}
+
+#endif  /* !_PR_HAVE_ATOMIC_CAS */
+
 void _PR_InitAtomic(void)
 {
     _PR_MD_INIT_ATOMIC();
+#if defined(_PR_HAVE_ATOMIC_OPS) && !defined(_PR_HAVE_ATOMIC_CAS)
+    if (monitor == NULL) {
+        monitor = PR_NewLock();
+    }
+#endif
 }
 
 PR_IMPLEMENT(PRInt32)
@@ -103,3 +165,26 @@ PR_AtomicSet(PRInt32 *val, PRInt32 newval)
     return _PR_MD_ATOMIC_SET(val, newval);
 }
 
+PR_IMPLEMENT(PRInt32)
+PR_AtomicAdd(PRInt32 *ptr, PRInt32 val)
+{
+    return _PR_MD_ATOMIC_ADD(ptr, val);
+}
+
+PR_IMPLEMENT(PRBool)
+PR_AtomicCompareAndSwap(PRInt32 *ptr, PRInt32 oldval, PRInt32 newval)
+{
+    return _PR_MD_ATOMIC_CAS(ptr, oldval, newval) ? PR_TRUE : PR_FALSE;
+}
+
+PR_IMPLEMENT(void*)
+PR_AtomicSetPtr(void **ptr, void *newval)
+{
+    return _PR_MD_ATOMIC_SETPTR(ptr, newval);
+}
+
+PR_IMPLEMENT(PRBool)
+PR_AtomicCompareAndSwapPtr(void **ptr, void *oldval, void *newval)
+{
+    return _PR_MD_ATOMIC_CASPTR(ptr, oldval, newval) ? PR_TRUE : PR_FALSE;
+}
@@ -74,3 +74,17 @@ PR_IMPLEMENT(PRStatus) PR_GetSystemInfo(PRSysInfo cmd, char *buf, PRUint32 bufle
     }
     return PR_SUCCESS;
 }
+
+PR_IMPLEMENT(PRInt32) PR_GetNumberOfProcessors(void)
+{
+    PRInt32 numCpus = 1;
+#if defined(XP_UNIX) && defined(_SC_NPROCESSORS_ONLN)
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online > 0) numCpus = (PRInt32)online;
+#elif defined(WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    numCpus = (PRInt32)info.dwNumberOfProcessors;
+#endif
+    return numCpus;
+}  /* PR_GetNumberOfProcessors */
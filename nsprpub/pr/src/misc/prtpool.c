@@ -0,0 +1,670 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+#include "primpl.h"
+#include "prtpool.h"
+
+/**********************************************************************/
+/***************************** THREAD POOL ****************************/
+/**********************************************************************/
+
+/*
+ * Each worker owns a deque of jobs for each priority, under a lock of
+ * its own. The owner pushes and pops at the head, so it runs the job
+ * it queued last while that job's data is still in its cache. A worker
+ * that runs dry steals from the tail of the others' deques, where the
+ * oldest (and generally biggest) pieces of work are. The pool lock is
+ * only taken to sleep, to finish a joinable job and to change state.
+ *
+ * The pool counts the jobs queued at each priority and the workers
+ * that are asleep. A worker counts itself asleep before it makes a last
+ * check of the queued counts, and a submitter counts its job before it
+ * looks for sleepers, so one of them always sees the other.
+ *
+ * Lock order is the pool lock, then a worker's lock or the pool's wait
+ * group. Nothing holding one of the latter takes the pool lock.
+ */
+
+#define _PR_JOB_PRIORITIES (PR_JOB_PRIORITY_HIGH + 1)
+
+typedef enum _PRJobState
+{
+    _pr_job_waiting,                     /* in the pool's wait group     */
+    _pr_job_queued,                      /* on a worker's deque          */
+    _pr_job_running,
+    _pr_job_done,
+    _pr_job_cancelled
+} _PRJobState;
+
+typedef enum _PRTPoolState
+{
+    _pr_tp_running,
+    _pr_tp_shutdown,                     /* no new jobs, I/O cut short   */
+    _pr_tp_draining,                     /* workers exit when idle       */
+    _pr_tp_stopped                       /* workers have exited          */
+} _PRTPoolState;
+
+typedef struct _PRTPWorker
+{
+    PRLock *ml;                          /* protects the deques          */
+    PRCList deque[_PR_JOB_PRIORITIES];   /* owner at head, thieves tail  */
+    PRThreadPool *tpool;                 /* the pool it works for        */
+    PRThread *thread;                    /* the worker thread            */
+    PRUintn index;                       /* position in pool's workers   */
+} _PRTPWorker;
+
+struct PRJob {                           /* typedef'd in prtpool.h       */
+    PRRecvWait iod;                      /* first, so a wait finds job   */
+    PRThreadPool *tpool;                 /* pool it was queued to        */
+    PRJobFn fn;                          /* function to call             */
+    void *arg;                           /* opaque client context        */
+    PRJobPriority priority;              /* which deques it goes on      */
+    _PRJobState state;                   /* see above                    */
+    PRBool joinable;                     /* freed by PR_JoinJob()        */
+    PRBool cancelled;                    /* cancelled while waiting      */
+    _PRTPWorker *worker;                 /* whose deque it's on          */
+    PRRecvWait *desc;                    /* client's wait, for I/O jobs  */
+    PRErrorCode error;                   /* why the wait failed          */
+    PRInt32 oserror;                     /* ... and the OS's reason      */
+};
+
+/*
+ * A job's deque linkage is its wait object's. That belongs to the wait
+ * group only while the job is waiting, and then the job is on no deque.
+ */
+#define _PR_JOB_LINKS(_job) (&(_job)->iod.internal)
+#define _PR_JOB_PTR(_qp) ((PRJob*)(_qp))
+
+struct PRThreadPool {                    /* typedef'd in prtpool.h       */
+    PRLock *ml;                          /* protects state and joins     */
+    PRCondVar *work;                     /* idle workers wait on this    */
+    PRCondVar *joins;                    /* joiners wait on this         */
+    _PRTPoolState state;                 /* see above                    */
+    PRInt32 queued[_PR_JOB_PRIORITIES];  /* jobs on deques (atomic)      */
+    PRInt32 idle;                        /* sleeping workers (atomic)    */
+    PRInt32 next;                        /* round robin count (atomic)   */
+    PRInt32 unjoined;                    /* joinable jobs alive (atomic) */
+    PRUintn threads;                     /* number of workers            */
+    _PRTPWorker **workers;               /* each allocated on its own    */
+    PRWaitGroup *group;                  /* made for the first I/O job   */
+    PRThread *io;                        /* thread waiting on 'group'    */
+    PRUint32 stackSize;                  /* for the threads we create    */
+};
+
+static PRCallOnceType tp_once;
+static PRUintn tp_worker_index;          /* thread private _PRTPWorker*  */
+
+static PRStatus PR_CALLBACK tp_InitOnce(void)
+{
+    return PR_NewThreadPrivateIndex(&tp_worker_index, NULL);
+}  /* tp_InitOnce */
+
+/* the calling thread's worker if it is one of this pool's */
+static _PRTPWorker *tp_Self(PRThreadPool *tp)
+{
+    _PRTPWorker *self = (_PRTPWorker*)PR_GetThreadPrivate(tp_worker_index);
+    return ((NULL != self) && (tp == self->tpool)) ? self : NULL;
+}  /* tp_Self */
+
+/*
+ * Is anything queued? The atomic read pairs with the idle count; see
+ * the comment at the top of the file.
+ */
+static PRBool tp_Pending(PRThreadPool *tp)
+{
+    PRIntn priority;
+    for (priority = 0; priority < _PR_JOB_PRIORITIES; ++priority)
+    {
+        if (PR_AtomicAdd(&tp->queued[priority], 0) > 0) return PR_TRUE;
+    }
+    return PR_FALSE;
+}  /* tp_Pending */
+
+/*
+ * Put the job on the deque of 'worker' or, if that's NULL, of the next
+ * worker in turn. Returns whether a sleeping worker should be woken.
+ */
+static PRBool tp_Enqueue(PRThreadPool *tp, _PRTPWorker *worker, PRJob *job)
+{
+    if (NULL == worker)
+    {
+        PRUint32 turn = (PRUint32)PR_AtomicIncrement(&tp->next);
+        worker = tp->workers[turn % tp->threads];
+    }
+
+    PR_Lock(worker->ml);
+    job->worker = worker;
+    job->state = _pr_job_queued;
+    PR_INSERT_LINK(_PR_JOB_LINKS(job), &worker->deque[job->priority]);
+    PR_Unlock(worker->ml);
+
+    (void)PR_AtomicIncrement(&tp->queued[job->priority]);
+    return (PR_AtomicAdd(&tp->idle, 0) > 0) ? PR_TRUE : PR_FALSE;
+}  /* tp_Enqueue */
+
+/* take a job from the head of our own deque or the tail of another's */
+static PRJob *tp_Dequeue(_PRTPWorker *from, PRIntn priority, PRBool own)
+{
+    PRJob *job = NULL;
+    PRCList *deque = &from->deque[priority];
+
+    if (PR_CLIST_IS_EMPTY(deque)) return NULL;  /* don't bother locking */
+    PR_Lock(from->ml);
+    if (!PR_CLIST_IS_EMPTY(deque))
+    {
+        PRCList *link = own ? PR_LIST_HEAD(deque) : PR_LIST_TAIL(deque);
+        PR_REMOVE_LINK(link);
+        job = _PR_JOB_PTR(link);
+        job->state = _pr_job_running;
+    }
+    PR_Unlock(from->ml);
+
+    if (NULL != job) (void)PR_AtomicDecrement(&from->tpool->queued[priority]);
+    return job;
+}  /* tp_Dequeue */
+
+static PRJob *tp_FindJob(_PRTPWorker *self)
+{
+    PRJob *job;
+    PRUintn victim;
+    PRIntn priority;
+    PRThreadPool *tp = self->tpool;
+
+    for (priority = PR_JOB_PRIORITY_HIGH;
+         priority >= PR_JOB_PRIORITY_LOW; --priority)
+    {
+        if (tp->queued[priority] <= 0) continue;  /* only a hint */
+        job = tp_Dequeue(self, priority, PR_TRUE);
+        if (NULL != job) return job;
+        for (victim = 1; victim < tp->threads; ++victim)
+        {
+            _PRTPWorker *from =
+                tp->workers[(self->index + victim) % tp->threads];
+            job = tp_Dequeue(from, priority, PR_FALSE);
+            if (NULL != job) return job;
+        }
+    }
+    return NULL;
+}  /* tp_FindJob */
+
+static void tp_RunJob(PRJob *job)
+{
+    PRThreadPool *tp = job->tpool;
+
+    if ((NULL != job->desc) && (PR_MW_SUCCESS != job->desc->outcome))
+        PR_SetError(job->error, job->oserror);
+    job->fn(job->arg);
+
+    if (job->joinable)
+    {
+        PR_Lock(tp->ml);
+        job->state = _pr_job_done;
+        PR_NotifyAllCondVar(tp->joins);
+        PR_Unlock(tp->ml);
+    }
+    else PR_DELETE(job);
+}  /* tp_RunJob */
+
+static void PR_CALLBACK tp_Worker(void *arg)
+{
+    PRJob *job;
+    PRBool exiting = PR_FALSE;
+    _PRTPWorker *self = (_PRTPWorker*)arg;
+    PRThreadPool *tp = self->tpool;
+
+    (void)PR_SetThreadPrivate(tp_worker_index, self);
+    while (!exiting)
+    {
+        job = tp_FindJob(self);
+        if (NULL != job)
+        {
+            tp_RunJob(job);
+            continue;
+        }
+
+        PR_Lock(tp->ml);
+        (void)PR_AtomicIncrement(&tp->idle);
+        if (!tp_Pending(tp))
+        {
+            if (_pr_tp_draining == tp->state) exiting = PR_TRUE;
+            else (void)PR_WaitCondVar(tp->work, PR_INTERVAL_NO_TIMEOUT);
+        }
+        (void)PR_AtomicDecrement(&tp->idle);
+        PR_Unlock(tp->ml);
+    }
+    (void)PR_SetThreadPrivate(tp_worker_index, NULL);
+}  /* tp_Worker */
+
+/*
+ * A job's wait has come back from the wait group. Unless the job was
+ * cancelled, pass on the results and queue it to run.
+ */
+static void tp_IODone(PRThreadPool *tp, PRJob *job)
+{
+    switch (job->iod.outcome)
+    {
+        case PR_MW_FAILURE:
+            job->error = PR_GetError();
+            job->oserror = PR_GetOSError();
+            break;
+        case PR_MW_TIMEOUT:
+            job->error = PR_IO_TIMEOUT_ERROR;
+            break;
+        case PR_MW_INTERRUPT:
+            job->error = PR_PENDING_INTERRUPT_ERROR;
+            break;
+        default: break;
+    }
+
+    PR_Lock(tp->ml);
+    if (job->cancelled)
+    {
+        job->state = _pr_job_cancelled;
+        PR_NotifyAllCondVar(tp->joins);
+    }
+    else
+    {
+        job->desc->outcome = job->iod.outcome;
+        job->desc->bytesRecv = job->iod.bytesRecv;
+        if (tp_Enqueue(tp, NULL, job)) PR_NotifyCondVar(tp->work);
+    }
+    PR_Unlock(tp->ml);
+}  /* tp_IODone */
+
+static void PR_CALLBACK tp_IOWaiter(void *arg)
+{
+    PRRecvWait *desc;
+    PRThreadPool *tp = (PRThreadPool*)arg;
+
+    while (PR_TRUE)
+    {
+        desc = PR_WaitRecvReady(tp->group);
+        if (NULL != desc) tp_IODone(tp, (PRJob*)desc);
+        else if ((PR_INVALID_STATE_ERROR == PR_GetError())
+        || (_pr_tp_running != tp->state)) break;  /* group cancelled */
+    }
+}  /* tp_IOWaiter */
+
+static PRJob *tp_NewJob(
+    PRThreadPool *tp, PRJobFn fn, void *arg,
+    PRJobPriority priority, PRBool joinable)
+{
+    PRJob *job;
+
+    if ((NULL == fn) || (priority < PR_JOB_PRIORITY_LOW)
+    || (priority > PR_JOB_PRIORITY_HIGH))
+    {
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return NULL;
+    }
+    job = PR_NEWZAP(PRJob);
+    if (NULL == job)
+    {
+        PR_SetError(PR_OUT_OF_MEMORY_ERROR, 0);
+        return NULL;
+    }
+    PR_INIT_CLIST(_PR_JOB_LINKS(job));
+    job->tpool = tp;
+    job->fn = fn;
+    job->arg = arg;
+    job->priority = priority;
+    job->joinable = joinable;
+    if (joinable) (void)PR_AtomicIncrement(&tp->unjoined);
+    return job;
+}  /* tp_NewJob */
+
+static void tp_FreeJob(PRJob *job)
+{
+    if (job->joinable) (void)PR_AtomicDecrement(&job->tpool->unjoined);
+    PR_DELETE(job);
+}  /* tp_FreeJob */
+
+/* let go of whatever has been built, whether or not it all was */
+static void tp_Free(PRThreadPool *tp)
+{
+    PRUintn index;
+
+    if (NULL != tp->group) (void)PR_DestroyWaitGroup(tp->group);
+    if (NULL != tp->workers)
+    {
+        for (index = 0; index < tp->threads; ++index)
+        {
+            _PRTPWorker *worker = tp->workers[index];
+            if (NULL == worker) continue;
+            if (NULL != worker->ml) PR_DestroyLock(worker->ml);
+            PR_DELETE(worker);
+        }
+        PR_DELETE(tp->workers);
+    }
+    if (NULL != tp->joins) PR_DestroyCondVar(tp->joins);
+    if (NULL != tp->work) PR_DestroyCondVar(tp->work);
+    if (NULL != tp->ml) PR_DestroyLock(tp->ml);
+    PR_DELETE(tp);
+}  /* tp_Free */
+
+/* tell the workers to exit once nothing is queued, and wait for them */
+static void tp_StopWorkers(PRThreadPool *tp)
+{
+    PRUintn index;
+
+    PR_Lock(tp->ml);
+    tp->state = _pr_tp_draining;
+    PR_NotifyAllCondVar(tp->work);
+    PR_Unlock(tp->ml);
+
+    for (index = 0; index < tp->threads; ++index)
+    {
+        if (NULL != tp->workers[index]->thread)
+            (void)PR_JoinThread(tp->workers[index]->thread);
+    }
+
+    PR_Lock(tp->ml);
+    tp->state = _pr_tp_stopped;
+    PR_Unlock(tp->ml);
+}  /* tp_StopWorkers */
+
+PR_IMPLEMENT(PRThreadPool*) PR_CreateThreadPool(
+    PRInt32 threads, PRUint32 stackSize)
+{
+    PRUintn index;
+    PRIntn priority;
+    PRThreadPool *tp;
+
+    if (!_pr_initialized) _PR_ImplicitInitialization();
+    if (PR_FAILURE == PR_CallOnce(&tp_once, tp_InitOnce)) return NULL;
+    if (threads <= 0) threads = PR_GetNumberOfProcessors();
+
+    tp = PR_NEWZAP(PRThreadPool);
+    if (NULL == tp) goto nomem;
+    tp->threads = (PRUintn)threads;
+    tp->stackSize = stackSize;
+    tp->state = _pr_tp_running;
+    if (NULL == (tp->ml = PR_NewLock())) goto nomem;
+    if (NULL == (tp->work = PR_NewCondVar(tp->ml))) goto nomem;
+    if (NULL == (tp->joins = PR_NewCondVar(tp->ml))) goto nomem;
+    tp->workers = (_PRTPWorker**)PR_CALLOC(
+        tp->threads * sizeof(_PRTPWorker*));
+    if (NULL == tp->workers) goto nomem;
+
+    for (index = 0; index < tp->threads; ++index)
+    {
+        _PRTPWorker *worker = PR_NEWZAP(_PRTPWorker);
+        if (NULL == worker) goto nomem;
+        tp->workers[index] = worker;
+        if (NULL == (worker->ml = PR_NewLock())) goto nomem;
+        for (priority = 0; priority < _PR_JOB_PRIORITIES; ++priority)
+            PR_INIT_CLIST(&worker->deque[priority]);
+        worker->tpool = tp;
+        worker->index = index;
+    }
+
+    /* all the workers must exist before any of them can steal */
+    for (index = 0; index < tp->threads; ++index)
+    {
+        _PRTPWorker *worker = tp->workers[index];
+        worker->thread = PR_CreateThread(
+            PR_USER_THREAD, tp_Worker, worker, PR_PRIORITY_NORMAL,
+            PR_GLOBAL_THREAD, PR_JOINABLE_THREAD, stackSize);
+        if (NULL == worker->thread)
+        {
+            tp_StopWorkers(tp);
+            goto failed;
+        }
+    }
+    return tp;
+
+nomem:
+    PR_SetError(PR_OUT_OF_MEMORY_ERROR, 0);
+failed:
+    if (NULL != tp) tp_Free(tp);
+    return NULL;
+}  /* PR_CreateThreadPool */
+
+PR_IMPLEMENT(PRJob*) PR_QueueJob(
+    PRThreadPool *tpool, PRJobFn fn, void *arg,
+    PRJobPriority priority, PRBool joinable)
+{
+    _PRTPWorker *self;
+    PRJob *job = tp_NewJob(tpool, fn, arg, priority, joinable);
+    if (NULL == job) return NULL;
+
+    /*
+     * A worker's own deque needs no pool lock. The worker will look at
+     * it again before it can exit, even if the pool is being shut down.
+     */
+    self = tp_Self(tpool);
+    if (NULL != self)
+    {
+        if (tp_Enqueue(tpool, self, job))
+        {
+            PR_Lock(tpool->ml);
+            PR_NotifyCondVar(tpool->work);
+            PR_Unlock(tpool->ml);
+        }
+        return job;
+    }
+
+    /* others hold the lock so the workers can't stop in the meantime */
+    PR_Lock(tpool->ml);
+    if (_pr_tp_running != tpool->state)
+    {
+        PR_Unlock(tpool->ml);
+        tp_FreeJob(job);
+        PR_SetError(PR_INVALID_STATE_ERROR, 0);
+        return NULL;
+    }
+    if (tp_Enqueue(tpool, NULL, job)) PR_NotifyCondVar(tpool->work);
+    PR_Unlock(tpool->ml);
+    return job;
+}  /* PR_QueueJob */
+
+PR_IMPLEMENT(PRJob*) PR_QueueRecvJob(
+    PRThreadPool *tpool, PRRecvWait *desc, PRJobFn fn, void *arg,
+    PRJobPriority priority, PRBool joinable)
+{
+    PRJob *job;
+
+    if (NULL == desc)
+    {
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return NULL;
+    }
+    job = tp_NewJob(tpool, fn, arg, priority, joinable);
+    if (NULL == job) return NULL;
+    job->desc = desc;
+    job->iod.fd = desc->fd;
+    job->iod.timeout = desc->timeout;
+    job->iod.buffer = desc->buffer;
+    job->state = _pr_job_waiting;
+
+    /* the first I/O job brings up the wait group and its thread */
+    PR_Lock(tpool->ml);
+    if (_pr_tp_running != tpool->state)
+    {
+        PR_SetError(PR_INVALID_STATE_ERROR, 0);
+        goto failed;
+    }
+    if (NULL == tpool->group)
+    {
+        tpool->group = PR_CreateWaitGroup(0);
+        if (NULL == tpool->group) goto failed;
+        tpool->io = PR_CreateThread(
+            PR_USER_THREAD, tp_IOWaiter, tpool, PR_PRIORITY_NORMAL,
+            PR_GLOBAL_THREAD, PR_JOINABLE_THREAD, tpool->stackSize);
+        if (NULL == tpool->io)
+        {
+            (void)PR_DestroyWaitGroup(tpool->group);
+            tpool->group = NULL;
+            goto failed;
+        }
+    }
+    PR_Unlock(tpool->ml);
+
+    /*
+     * If the pool is shut down meanwhile, either the group has been
+     * cancelled and this fails, or cancelling it hands the job back.
+     */
+    if (PR_SUCCESS == PR_AddWaitFileDesc(tpool->group, &job->iod))
+        return job;
+    tp_FreeJob(job);
+    return NULL;
+
+failed:
+    PR_Unlock(tpool->ml);
+    tp_FreeJob(job);
+    return NULL;
+}  /* PR_QueueRecvJob */
+
+PR_IMPLEMENT(PRStatus) PR_CancelJob(PRJob *job)
+{
+    PRThreadPool *tp = job->tpool;
+    PRStatus rv = PR_FAILURE;
+
+    if (!job->joinable)
+    {
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return PR_FAILURE;
+    }
+
+    PR_Lock(tp->ml);
+    if (_pr_job_waiting == job->state)
+    {
+        /*
+         * The I/O waiter looks at 'cancelled' under the pool lock, so
+         * the job won't run even if its wait completes anyway. It
+         * can't be freed until we let go of the lock.
+         */
+        job->cancelled = PR_TRUE;
+        (void)PR_CancelWaitFileDesc(tp->group, &job->iod);
+        rv = PR_SUCCESS;
+    }
+    else if (_pr_job_queued == job->state)
+    {
+        /* a worker may take it first: that is under the deque's lock */
+        _PRTPWorker *worker = job->worker;
+        PR_Lock(worker->ml);
+        if (_pr_job_queued == job->state)
+        {
+            PR_REMOVE_AND_INIT_LINK(_PR_JOB_LINKS(job));
+            job->state = _pr_job_cancelled;
+            rv = PR_SUCCESS;
+        }
+        PR_Unlock(worker->ml);
+        if (PR_SUCCESS == rv)
+        {
+            (void)PR_AtomicDecrement(&tp->queued[job->priority]);
+            PR_NotifyAllCondVar(tp->joins);
+        }
+    }
+    PR_Unlock(tp->ml);
+
+    if (PR_FAILURE == rv) PR_SetError(PR_INVALID_STATE_ERROR, 0);
+    return rv;
+}  /* PR_CancelJob */
+
+PR_IMPLEMENT(PRStatus) PR_JoinJob(PRJob *job)
+{
+    PRJob *other;
+    PRStatus rv;
+    PRThreadPool *tp = job->tpool;
+    _PRTPWorker *self = tp_Self(tp);
+
+    if (!job->joinable)
+    {
+        PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+        return PR_FAILURE;
+    }
+
+    PR_Lock(tp->ml);
+    while ((_pr_job_done != job->state) && (_pr_job_cancelled != job->state))
+    {
+        /*
+         * A worker helps out rather than sleep. The job it's waiting for
+         * can't be left on a deque, or it would have found it, so the
+         * job is running and will wake us when it's done.
+         */
+        if (NULL != self)
+        {
+            PR_Unlock(tp->ml);
+            other = tp_FindJob(self);
+            if (NULL != other) tp_RunJob(other);
+            PR_Lock(tp->ml);
+            if (NULL != other) continue;
+            if ((_pr_job_done == job->state)
+            || (_pr_job_cancelled == job->state)) break;
+        }
+        (void)PR_WaitCondVar(tp->joins, PR_INTERVAL_NO_TIMEOUT);
+    }
+    rv = (_pr_job_done == job->state) ? PR_SUCCESS : PR_FAILURE;
+    PR_Unlock(tp->ml);
+
+    tp_FreeJob(job);
+    if (PR_FAILURE == rv) PR_SetError(PR_PENDING_INTERRUPT_ERROR, 0);
+    return rv;
+}  /* PR_JoinJob */
+
+PR_IMPLEMENT(PRStatus) PR_ShutdownThreadPool(PRThreadPool *tpool)
+{
+    PRRecvWait *desc;
+
+    PR_Lock(tpool->ml);
+    if (_pr_tp_running != tpool->state)
+    {
+        PR_Unlock(tpool->ml);
+        PR_SetError(PR_INVALID_STATE_ERROR, 0);
+        return PR_FAILURE;
+    }
+    tpool->state = _pr_tp_shutdown;
+    PR_Unlock(tpool->ml);
+
+    /*
+     * No group can be made now. Cancelling it hands every wait back,
+     * either here or to the I/O waiter, and the workers are still there
+     * to run them.
+     */
+    if (NULL != tpool->group)
+    {
+        while (NULL != (desc = PR_CancelWaitGroup(tpool->group)))
+            tp_IODone(tpool, (PRJob*)desc);
+        (void)PR_JoinThread(tpool->io);
+        tpool->io = NULL;
+    }
+
+    tp_StopWorkers(tpool);
+    return PR_SUCCESS;
+}  /* PR_ShutdownThreadPool */
+
+PR_IMPLEMENT(PRStatus) PR_DestroyThreadPool(PRThreadPool *tpool)
+{
+    PRBool busy;
+
+    PR_Lock(tpool->ml);
+    busy = ((_pr_tp_stopped != tpool->state)
+        || (PR_AtomicAdd(&tpool->unjoined, 0) > 0)) ? PR_TRUE : PR_FALSE;
+    PR_Unlock(tpool->ml);
+    if (busy)
+    {
+        PR_SetError(PR_INVALID_STATE_ERROR, 0);
+        return PR_FAILURE;
+    }
+
+    tp_Free(tpool);
+    return PR_SUCCESS;
+}  /* PR_DestroyThreadPool */
+
+/* prtpool.c */
@@ -24,6 +24,10 @@
 
 #if defined(_PR_PTHREADS)
 
+#if defined(LINUX) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  /* for splice() */
+#endif
+
 #include <string.h>  /* for memset() */
 #include <sys/types.h>
 #include <dirent.h>
@@ -63,6 +67,14 @@
 
 #include "primpl.h"
 
+#ifdef _PR_HAVE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+#ifdef _PR_HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
 /* On Alpha Linux, these are already defined in sys/socket.h */
 #if !(defined(LINUX) && defined(__alpha))
 #include <netinet/tcp.h>  /* TCP_NODELAY, TCP_MAXSEG */
@@ -165,7 +177,6 @@ finished:
 static void pt_Putfd(PRFileDesc *fd)
 {
     PR_ASSERT(_PR_FILEDESC_CLOSED == fd->secret->state);
-    PR_ASSERT(pt_fd_cache.count < pt_fd_cache.limit);
 
     fd->secret->state = _PR_FILEDESC_FREED;
     if (pt_fd_cache.count > pt_fd_cache.limit)
@@ -189,10 +200,15 @@ static void pt_Putfd(PRFileDesc *fd)
 
 /*
  * The polling interval defines the maximum amount of time that a thread
- * might hang up before an interrupt is noticed.
+ * might hang up before an interrupt is noticed.  The epoll continuation
+ * thread is woken when an operation is interrupted, and doesn't poll.
  */
 #define PT_DEFAULT_POLL_MSEC 100
 
+#ifdef _PR_HAVE_EPOLL
+#define PT_EPOLL_EVENTS 256                 /* events taken per epoll_wait() */
+#endif
+
 /*
  * Latest POSIX defines this type as socklen_t.  It may also be
  * size_t or int.
@@ -229,7 +245,7 @@ struct pt_Continuation
     union {
         PRSize amount;                      /* #3 - size of 'buffer', or */
         pt_SockLen *addr_len;                  /*    - length of address */
-#ifdef HPUX11
+#if defined(HPUX11) || defined(_PR_HAVE_SENDFILE)
         /*
          * For sendfile()
          */
@@ -239,13 +255,18 @@ struct pt_Continuation
     union { PRIntn flags; } arg4;           /* #4 - read/write flags */
     union { PRNetAddr *addr; } arg5;        /* #5 - send/recv address */
 
-#ifdef HPUX11
+#if defined(HPUX11) || defined(_PR_HAVE_SENDFILE) || defined(_PR_HAVE_SPLICE)
     /*
-     * For sendfile()
+     * For sendfile() and splice()
      */
-    int filedesc;                           /* descriptor of file to send */
+    int filedesc;                           /* file to send, or pipe to fill */
+#endif
+#ifdef HPUX11
     int nbytes_to_send;                     /* size of header and file */
 #endif  /* HPUX11 */
+#ifdef _PR_HAVE_SENDFILE
+    PRSize file_nbytes;                     /* file bytes left to send */
+#endif
     
     PRIntervalTime timeout;                 /* client (relative) timeout */
     PRIntervalTime absolute;                /* internal (absolute) timeout */
@@ -262,8 +283,26 @@ struct pt_Continuation
     PRIntn syserrno;                        /* in case it failed, why (errno) */
     pr_ContuationStatus status;             /* the status of the operation */
     PRCondVar complete;                     /* to notify the initiating thread */
+
+#ifdef _PR_HAVE_EPOLL
+    pt_Continuation *fdnext;                /* next op waiting on arg1.osfd */
+    pt_Continuation *attn;                  /* next op on pt_tq.attn list */
+    PRBool attention;                       /* whether on pt_tq.attn list */
+#endif
 };
 
+#ifdef _PR_HAVE_EPOLL
+/*
+ * The ops waiting on one file descriptor, and the events the epoll
+ * instance has registered for it: the union of the ops' events.
+ */
+typedef struct pt_EpollFd
+{
+    pt_Continuation *ops;                   /* linked through 'fdnext' */
+    PRInt16 events;                         /* 0 if not registered */
+} pt_EpollFd;
+#endif
+
 static struct pt_TimedQueue
 {
     PRCallOnceType once;                    /* controls the initialization
@@ -277,6 +316,15 @@ static struct pt_TimedQueue
     pt_Continuation *op;                    /* timed operation furthest in future */
     PRBool exitFlag;                        /* a Boolean flag for signaling the
                                              * continuation thread to exit */
+#ifdef _PR_HAVE_EPOLL
+    PRIntn epfd;                            /* epoll instance, or -1 to poll */
+    PRIntn wakefd;                          /* eventfd that wakes the thread */
+    pt_Continuation *attn;                  /* new and aborted operations */
+
+    /* Owned by the continuation thread, so not protected by 'ml' */
+    pt_EpollFd *fds;                        /* indexed by file descriptor */
+    PRIntn fds_size;                        /* # entries in 'fds' */
+#endif
 } pt_tq;
 
 #if defined(DEBUG)
@@ -415,6 +463,17 @@ static pt_Continuation *pt_FinishTimedInternal(pt_Continuation *op)
     /* did we happen to hit the timed op? */
     if (op == pt_tq.op) pt_tq.op = op->prev;
 
+#ifdef _PR_HAVE_EPOLL
+    /* it may have been interrupted just as it completed */
+    if (op->attention)
+    {
+        pt_Continuation **opp = &pt_tq.attn;
+        while (*opp != op) opp = &(*opp)->attn;
+        *opp = op->attn;
+        op->attention = PR_FALSE;
+    }
+#endif
+
     next = op->next;
     op->next = op->prev = NULL;
     op->status = pt_continuation_done;
@@ -634,6 +693,265 @@ static void ContinuationThread(void *arg)
     if (NULL != pollingList) PR_DELETE(pollingList);
 }  /* ContinuationThread */
 
+#ifdef _PR_HAVE_EPOLL
+
+/*
+ * The epoll continuation thread.
+ *
+ * Rather than build a polling list from pt_tq on every pass, it keeps
+ * each file descriptor that operations wait on registered with the epoll
+ * instance pt_tq.epfd, for the union of their events, and sleeps in
+ * epoll_wait() until one is ready or the earliest timed operation
+ * expires.  A thread starting an operation, or interrupted while waiting
+ * for one, puts the operation on the pt_tq.attn list and writes the
+ * eventfd pt_tq.wakefd if the list was empty.  So the thread never
+ * wakes just to look for interrupts, and a pass costs time in proportion
+ * to the descriptors that are ready, not to those that wait.
+ *
+ * poll() and epoll use the same event bits on Linux, so 'op->event' is
+ * registered as it is, and the continuation functions see the same
+ * 'revents' as from poll().
+ */
+
+/*
+ * Wake the epoll continuation thread. Called with the pt_tq.ml lock held,
+ * by pt_AttentionInternal, or when telling the thread to exit.
+ */
+static void pt_Wake(void)
+{
+    PRUint64 one = 1;
+    (void)write(pt_tq.wakefd, &one, sizeof(one));
+}  /* pt_Wake */
+
+/*
+ * Put 'op' on the attention list, with the pt_tq.ml lock held.  The
+ * thread reads pt_tq.wakefd before it takes ops off the list, so writing
+ * it only when the list goes from empty to not empty loses no wakeups.
+ */
+static void pt_AttentionInternal(pt_Continuation *op)
+{
+    if (op->attention) return;
+    op->attention = PR_TRUE;
+    op->attn = pt_tq.attn;
+    if (NULL == pt_tq.attn) pt_Wake();
+    pt_tq.attn = op;
+}  /* pt_AttentionInternal */
+
+/*
+ * Register 'osfd' for the events its ops wait for, if they differ from
+ * those registered or 'force' is set.  A descriptor stays registered
+ * when its last op finishes, since another op is likely to follow, but
+ * closing the descriptor unregisters it behind our back; so the first op
+ * to wait on a descriptor forces the update, and an EPOLL_CTL_MOD that
+ * finds the descriptor gone becomes an EPOLL_CTL_ADD.
+ */
+static PRIntn pt_EpollUpdate(PRIntn osfd, PRBool force)
+{
+    PRIntn rv, ctl;
+    PRInt16 events = 0;
+    pt_Continuation *op;
+    struct epoll_event ev;
+    pt_EpollFd *efd = &pt_tq.fds[osfd];
+
+    for (op = efd->ops; NULL != op; op = op->fdnext)
+        events |= op->event;
+    PR_ASSERT(0 != events);
+    if (!force && (events == efd->events)) return 0;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = osfd;
+    ctl = (0 == efd->events) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    rv = epoll_ctl(pt_tq.epfd, ctl, osfd, &ev);
+    if ((-1 == rv) && (EPOLL_CTL_MOD == ctl) && (ENOENT == errno))
+        rv = epoll_ctl(pt_tq.epfd, EPOLL_CTL_ADD, osfd, &ev);
+    else if ((-1 == rv) && (EPOLL_CTL_ADD == ctl) && (EEXIST == errno))
+        rv = epoll_ctl(pt_tq.epfd, EPOLL_CTL_MOD, osfd, &ev);
+    if (0 == rv) efd->events = events;
+    return rv;
+}  /* pt_EpollUpdate */
+
+/*
+ * Start waiting for a new operation's descriptor.  If epoll won't have
+ * it (it refuses regular files, for instance), set the op's error and
+ * return PR_FALSE so the caller can finish it.
+ */
+static PRBool pt_EpollAdd(pt_Continuation *op)
+{
+    PRIntn osfd = op->arg1.osfd;
+    pt_EpollFd *efd;
+
+    if (osfd >= pt_tq.fds_size)
+    {
+        PRIntn size = (0 == pt_tq.fds_size) ? 64 : 2 * pt_tq.fds_size;
+        pt_EpollFd *fds;
+
+        while (osfd >= size) size *= 2;
+        fds = (pt_EpollFd*)PR_REALLOC(pt_tq.fds, size * sizeof(pt_EpollFd));
+        if (NULL == fds)
+        {
+            op->syserrno = ENOMEM;
+            return PR_FALSE;
+        }
+        memset(&fds[pt_tq.fds_size], 0,
+            (size - pt_tq.fds_size) * sizeof(pt_EpollFd));
+        pt_tq.fds = fds;
+        pt_tq.fds_size = size;
+    }
+
+    efd = &pt_tq.fds[osfd];
+    op->fdnext = efd->ops;
+    efd->ops = op;
+    if (-1 == pt_EpollUpdate(osfd, (PRBool)(NULL == op->fdnext)))
+    {
+        op->syserrno = errno;
+        efd->ops = op->fdnext;
+        op->fdnext = NULL;
+        return PR_FALSE;
+    }
+    op->status = pt_continuation_inprogress;
+    return PR_TRUE;
+}  /* pt_EpollAdd */
+
+/* Stop waiting for a finished operation's descriptor. */
+static void pt_EpollRemove(pt_Continuation *op)
+{
+    PRIntn osfd = op->arg1.osfd;
+    pt_Continuation **opp;
+
+    if (osfd >= pt_tq.fds_size) return;
+    for (opp = &pt_tq.fds[osfd].ops; NULL != *opp; opp = &(*opp)->fdnext)
+    {
+        if (*opp == op)
+        {
+            *opp = op->fdnext;
+            op->fdnext = NULL;
+            if (NULL != pt_tq.fds[osfd].ops)
+                (void)pt_EpollUpdate(osfd, PR_FALSE);
+            return;
+        }
+    }
+}  /* pt_EpollRemove */
+
+static void EpollContinuationThread(void *arg)
+{
+    PRIntn rv, index, osfd;
+    PRInt32 msecs, timeout;
+    PRIntervalTime now;
+    PRInt16 revents;
+    PRUint64 count;
+    pt_Continuation *op, *next;
+    struct epoll_event events[PT_EPOLL_EVENTS];
+
+    while (PR_TRUE)
+    {
+        PR_Lock(pt_tq.ml);
+
+        /* Start new operations, and finish those that were interrupted */
+        while (NULL != (op = pt_tq.attn))
+        {
+            pt_tq.attn = op->attn;
+            op->attention = PR_FALSE;
+            if (pt_continuation_abort == op->status)
+            {
+                pt_EpollRemove(op);
+                op->result.code = -1;
+                op->syserrno = EINTR;
+                (void)pt_FinishTimedInternal(op);
+            }
+            else if ((pt_continuation_sumbitted == op->status)
+            && !pt_EpollAdd(op))
+            {
+                op->result.code = -1;
+                (void)pt_FinishTimedInternal(op);
+            }
+        }
+
+        /* Time out the timed operations whose time has come */
+        now = PR_IntervalNow();
+        while ((NULL != pt_tq.head)
+        && (PR_INTERVAL_NO_TIMEOUT != pt_tq.head->timeout)
+        && ((PRInt32)(pt_tq.head->absolute - now) <= 0))
+        {
+            op = pt_tq.head;
+            pt_EpollRemove(op);
+            op->result.code = -1;
+            op->syserrno = ETIMEDOUT;
+            (void)pt_FinishTimedInternal(op);
+        }
+
+        /* Okay. We're history */
+        if (pt_tq.exitFlag)
+        {
+            PR_Unlock(pt_tq.ml);
+            break;
+        }
+
+        /*
+         * Untimed operations can wait forever, since an interrupt will
+         * wake us.  Otherwise wait until the earliest timeout, rounding
+         * up so as not to wake just before it and spin.
+         */
+        if ((NULL == pt_tq.head)
+        || (PR_INTERVAL_NO_TIMEOUT == pt_tq.head->timeout))
+            msecs = -1;
+        else
+        {
+            timeout = pt_tq.head->absolute - now;
+            msecs = (PRInt32)PR_IntervalToMilliseconds(timeout) + 1;
+        }
+        PR_Unlock(pt_tq.ml);
+
+        rv = epoll_wait(pt_tq.epfd, events, PT_EPOLL_EVENTS, msecs);
+
+        for (index = 0; index < rv; ++index)
+        {
+            osfd = events[index].data.fd;
+            if (osfd == pt_tq.wakefd)
+            {
+                (void)read(pt_tq.wakefd, &count, sizeof(count));
+                continue;
+            }
+
+            /*
+             * Only this thread adds and removes the ops waiting on a
+             * descriptor, so the list can be walked without the lock.
+             */
+            if ((osfd >= pt_tq.fds_size) || (NULL == pt_tq.fds[osfd].ops))
+            {
+                /* it's ready and nobody cares, so stop hearing about it */
+                (void)epoll_ctl(
+                    pt_tq.epfd, EPOLL_CTL_DEL, osfd, &events[index]);
+                if (osfd < pt_tq.fds_size) pt_tq.fds[osfd].events = 0;
+                continue;
+            }
+            for (op = pt_tq.fds[osfd].ops; NULL != op; op = next)
+            {
+                next = op->fdnext;
+                revents = (PRInt16)events[index].events
+                    & (op->event | POLLERR | POLLHUP | POLLNVAL);
+                if ((0 != revents)
+                && (pt_continuation_inprogress == op->status)
+                && (op->function(op, revents)))
+                {
+                    PR_Lock(pt_tq.ml);
+                    pt_EpollRemove(op);
+                    (void)pt_FinishTimedInternal(op);
+                    PR_Unlock(pt_tq.ml);
+                }
+            }
+        }
+    }
+
+    (void)close(pt_tq.wakefd);
+    (void)close(pt_tq.epfd);
+    pt_tq.wakefd = pt_tq.epfd = -1;
+    if (NULL != pt_tq.fds) PR_DELETE(pt_tq.fds);
+    pt_tq.fds_size = 0;
+}  /* EpollContinuationThread */
+
+#endif  /* _PR_HAVE_EPOLL */
+
 static PRIntn pt_Continue(pt_Continuation *op)
 {
     PRIntn rc;
@@ -649,10 +967,19 @@ static PRIntn pt_Continue(pt_Continuation *op)
     op->complete.lock = pt_tq.ml;
     rc = PTHREAD_COND_INIT(op->complete.cv, _pt_cvar_attr);  PR_ASSERT(0 == rc);
     op->status = pt_continuation_sumbitted;
+#ifdef _PR_HAVE_EPOLL
+    op->fdnext = NULL;
+    op->attention = PR_FALSE;
+#endif
     PR_Lock(pt_tq.ml);  /* we provide the locking */
 
     pt_InsertTimedInternal(op);  /* insert in the structure */
 
+#ifdef _PR_HAVE_EPOLL
+    if (-1 != pt_tq.epfd)
+        pt_AttentionInternal(op);  /* wake the continuation thread */
+    else
+#endif
     PR_NotifyCondVar(pt_tq.new_op);  /* notify the continuation thread */
 
     while (pt_continuation_done != op->status)  /* wait for completion */
@@ -666,7 +993,9 @@ static PRIntn pt_Continue(pt_Continuation *op)
          *
          * Don't call interrupt on the continuation thread. That'll just
          * irritate him. He's cycling around at least every mx_poll_ticks
-         * anyhow and should notice the request in there.
+         * anyhow and should notice the request in there.  The epoll
+         * continuation thread doesn't cycle, so it gets the op on its
+         * attention list instead.
          */
         if ((PR_FAILURE == rv)
         && (PR_PENDING_INTERRUPT_ERROR == PR_GetError()))
@@ -678,6 +1007,9 @@ static PRIntn pt_Continue(pt_Continuation *op)
             {
                 /* tell the continuation thread to abort the operation */
                 op->status = pt_continuation_abort;
+#ifdef _PR_HAVE_EPOLL
+                if (-1 != pt_tq.epfd) pt_AttentionInternal(op);
+#endif
             }
             else
             {
@@ -921,6 +1253,83 @@ static PRBool pt_hpux_transmitfile_cont(pt_Continuation *op, PRInt16 revents)
 }
 #endif  /* HPUX11 */
 
+#ifdef _PR_HAVE_SENDFILE
+static PRBool pt_linux_sendfile_cont(pt_Continuation *op, PRInt16 revents)
+{
+    /*
+     * Send what's left of the header (hdtrl[0]), the file and the
+     * trailer (hdtrl[1]), in that order. The header goes out with
+     * MSG_MORE so it shares segments with the start of the file;
+     * sendfile() itself holds back all but its last partial segment.
+     * A file that comes up short fails the operation with syserrno 0.
+     */
+    struct iovec *hdtrl = (struct iovec*)op->arg2.buffer;
+    ssize_t count;
+
+    for (;;)
+    {
+        if (0 != hdtrl[0].iov_len)
+            count = send(
+                op->arg1.osfd, hdtrl[0].iov_base, hdtrl[0].iov_len,
+                ((0 != op->file_nbytes) || (0 != hdtrl[1].iov_len)) ?
+                    MSG_MORE : 0);
+        else if (0 != op->file_nbytes)
+        {
+            count = sendfile(
+                op->arg1.osfd, op->filedesc, &op->arg3.offset,
+                op->file_nbytes);
+            if (0 == count)
+            {
+                op->syserrno = 0;
+                op->result.code = -1;
+                return PR_TRUE;
+            }
+        }
+        else if (0 != hdtrl[1].iov_len)
+            count = send(
+                op->arg1.osfd, hdtrl[1].iov_base, hdtrl[1].iov_len, 0);
+        else return PR_TRUE;  /* all sent */
+
+        if (-1 == count)
+        {
+            op->syserrno = errno;
+            if (EINTR == op->syserrno) continue;
+            if (EWOULDBLOCK == op->syserrno || EAGAIN == op->syserrno)
+                return PR_FALSE;
+            op->result.code = -1;
+            return PR_TRUE;
+        }
+
+        op->result.code += count;  /* accumulate the number sent */
+        if (0 != hdtrl[0].iov_len)
+        {
+            hdtrl[0].iov_base = (char*)hdtrl[0].iov_base + count;
+            hdtrl[0].iov_len -= count;
+        }
+        else if (0 != op->file_nbytes)
+            op->file_nbytes -= count;  /* sendfile() moved the offset */
+        else
+        {
+            hdtrl[1].iov_base = (char*)hdtrl[1].iov_base + count;
+            hdtrl[1].iov_len -= count;
+        }
+    }
+}  /* pt_linux_sendfile_cont */
+#endif  /* _PR_HAVE_SENDFILE */
+
+#ifdef _PR_HAVE_SPLICE
+static PRBool pt_splice_cont(pt_Continuation *op, PRInt16 revents)
+{
+    op->result.code = splice(
+        op->arg1.osfd, NULL, op->filedesc, NULL, op->arg3.amount,
+        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    op->syserrno = errno;
+    return ((-1 == op->result.code) &&
+            (EWOULDBLOCK == op->syserrno || EAGAIN == op->syserrno)) ?
+        PR_FALSE : PR_TRUE;
+}  /* pt_splice_cont */
+#endif  /* _PR_HAVE_SPLICE */
+
 #if !defined(PT_NO_ATFORK)
 
 static void pt_BeforeFork()
@@ -944,6 +1353,14 @@ static void pt_BeforeFork()
             && (NULL == pt_tq.tail)
             && (NULL == pt_tq.op));
         pt_tq.exitFlag = PR_TRUE;
+#ifdef _PR_HAVE_EPOLL
+        if (-1 != pt_tq.epfd)
+        {
+            PR_Lock(pt_tq.ml);
+            pt_Wake();
+            PR_Unlock(pt_tq.ml);
+        }
+#endif
         rv = PR_Interrupt(thred);
         PR_ASSERT(PR_SUCCESS == rv);
         rv = PR_JoinThread(thred);
@@ -992,6 +1409,7 @@ void _PR_InitIO()
 static PRStatus pt_InitIOContinuation()
 {
     PRIntn rv;
+    void (*start)(void *) = ContinuationThread;
 
     PR_ASSERT((0 == pt_tq.op_count)
         && (NULL == pt_tq.head)
@@ -1016,8 +1434,37 @@ static PRStatus pt_InitIOContinuation()
 #endif
     }
 
+#ifdef _PR_HAVE_EPOLL
+    /*
+     * Use epoll unless the kernel hasn't got it, or NSPR_NO_EPOLL is
+     * set in the environment.
+     */
+    pt_tq.attn = NULL;
+    pt_tq.wakefd = pt_tq.epfd = -1;
+    if (NULL == getenv("NSPR_NO_EPOLL"))
+        pt_tq.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (-1 != pt_tq.epfd)
+    {
+        struct epoll_event ev;
+
+        memset(&ev, 0, sizeof(ev));
+        pt_tq.wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        ev.events = EPOLLIN;
+        ev.data.fd = pt_tq.wakefd;
+        if ((-1 != pt_tq.wakefd)
+        && (0 == epoll_ctl(pt_tq.epfd, EPOLL_CTL_ADD, pt_tq.wakefd, &ev)))
+            start = EpollContinuationThread;
+        else
+        {
+            if (-1 != pt_tq.wakefd) (void)close(pt_tq.wakefd);
+            (void)close(pt_tq.epfd);
+            pt_tq.wakefd = pt_tq.epfd = -1;
+        }
+    }
+#endif
+
     pt_tq.thread = PR_CreateThread(
-        PR_SYSTEM_THREAD, ContinuationThread, NULL,
+        PR_SYSTEM_THREAD, start, NULL,
         PR_PRIORITY_URGENT, PR_LOCAL_THREAD, PR_JOINABLE_THREAD, 0);
     PR_ASSERT(NULL != pt_tq.thread);
 
@@ -1840,19 +2287,261 @@ static PRInt32 pt_HPUXTransmitFile(PRFileDesc *sd, PRFileDesc *fd,
 }
 #endif  /* HPUX11 */
 
+#ifdef _PR_HAVE_SENDFILE
+/*
+ * pt_LinuxSendFile
+ *
+ *	Send the header, file range and trailer that 'sfd' describes
+ *	across socket sd, the file part with sendfile() so that it is
+ *	never copied through user space.
+ *
+ *	return number of bytes sent or -1 on error
+ */
+static PRInt32 pt_LinuxSendFile(PRFileDesc *sd, PRSendFileData *sfd,
+        PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+    struct stat statbuf;
+    struct iovec hdtrl[2];  /* optional header and trailer buffers */
+    pt_Continuation op;
+    PRInt32 count, hlen = (sfd->hlen > 0) ? sfd->hlen : 0;
+    int syserrno;
+
+    if (PR_DESC_FILE != sfd->fd->methods->file_type)
+        return _PR_EmulateSendFile(sd, sfd, flags, timeout);
+
+    op.file_nbytes = sfd->file_nbytes;
+    if (0 == op.file_nbytes)
+    {
+        if (fstat(sfd->fd->secret->md.osfd, &statbuf) == -1)
+        {
+            _PR_MD_MAP_FSTAT_ERROR(errno);
+            return -1;
+        }
+        if (statbuf.st_size < sfd->file_offset)
+        {
+            PR_SetError(PR_INVALID_ARGUMENT_ERROR, 0);
+            return -1;
+        }
+        op.file_nbytes = statbuf.st_size - sfd->file_offset;
+    }
+
+    hdtrl[0].iov_base = (void*)sfd->header;  /* cast away the 'const' */
+    hdtrl[0].iov_len = hlen;
+    hdtrl[1].iov_base = (void*)sfd->trailer;
+    hdtrl[1].iov_len = (sfd->tlen > 0) ? sfd->tlen : 0;
+
+    op.arg1.osfd = sd->secret->md.osfd;
+    op.arg2.buffer = hdtrl;
+    op.arg3.offset = sfd->file_offset;
+    op.filedesc = sfd->fd->secret->md.osfd;
+    op.result.code = 0;
+    op.syserrno = 0;
+
+    if (!pt_linux_sendfile_cont(&op, 0))
+    {
+        /* the socket filled up */
+        if (sd->secret->nonblocking)
+        {
+            if (0 == op.result.code)
+            {
+                pt_MapError(_PR_MD_MAP_SEND_ERROR, op.syserrno);
+                return -1;
+            }
+            return op.result.code;  /* a partial send */
+        }
+        if (PR_INTERVAL_NO_WAIT == timeout)
+        {
+            op.result.code = -1;
+            op.syserrno = ETIMEDOUT;
+        }
+        else
+        {
+            op.timeout = timeout;
+            op.function = pt_linux_sendfile_cont;
+            op.event = POLLOUT | POLLPRI;
+            (void)pt_Continue(&op);
+        }
+    }
+    count = op.result.code;
+    syserrno = op.syserrno;
+
+    if ((-1 == count) && (EINVAL == syserrno || ENOSYS == syserrno)
+    && (0 == hdtrl[0].iov_len) && (0 != op.file_nbytes))
+    {
+        /*
+         * sendfile() can't read from this file. Nothing of it has gone
+         * yet, so copy it and the trailer the old way.
+         */
+        PRSendFileData rest;
+        rest.fd = sfd->fd;
+        rest.file_offset = op.arg3.offset;
+        rest.file_nbytes = op.file_nbytes;
+        rest.header = NULL;
+        rest.hlen = 0;
+        rest.trailer = hdtrl[1].iov_base;
+        rest.tlen = hdtrl[1].iov_len;
+        count = _PR_EmulateSendFile(sd, &rest, flags, timeout);
+        return (-1 == count) ? -1 : count + hlen;
+    }
+
+    if (-1 == count)
+    {
+        if (0 == syserrno) PR_SetError(PR_END_OF_FILE_ERROR, 0);
+        else pt_MapError(_PR_MD_MAP_SEND_ERROR, syserrno);
+        return -1;
+    }
+    if (flags & PR_TRANSMITFILE_CLOSE_SOCKET)
+        PR_Close(sd);
+    return count;
+}  /* pt_LinuxSendFile */
+#endif  /* _PR_HAVE_SENDFILE */
+
 static PRInt32 pt_TransmitFile(
     PRFileDesc *sd, PRFileDesc *fd, const void *headers,
     PRInt32 hlen, PRTransmitFileFlags flags, PRIntervalTime timeout)
 {
+#ifdef _PR_HAVE_SENDFILE
+    PRSendFileData sfd;
+#endif
+
     if (pt_TestAbort()) return -1;
 
-#ifdef HPUX11
+#if defined(HPUX11)
     return pt_HPUXTransmitFile(sd, fd, headers, hlen, flags, timeout);
+#elif defined(_PR_HAVE_SENDFILE)
+    sfd.fd = fd;
+    sfd.file_offset = 0;
+    sfd.file_nbytes = 0;
+    sfd.header = headers;
+    sfd.hlen = hlen;
+    sfd.trailer = NULL;
+    sfd.tlen = 0;
+    return pt_LinuxSendFile(sd, &sfd, flags, timeout);
 #else
     return _PR_UnixTransmitFile(sd, fd, headers, hlen, flags, timeout);
 #endif
 }  /* pt_TransmitFile */
 
+static PRInt32 pt_SendFile(
+    PRFileDesc *sd, PRSendFileData *sfd,
+    PRTransmitFileFlags flags, PRIntervalTime timeout)
+{
+    if (pt_TestAbort()) return -1;
+
+#ifdef _PR_HAVE_SENDFILE
+    return pt_LinuxSendFile(sd, sfd, flags, timeout);
+#else
+    return _PR_EmulateSendFile(sd, sfd, flags, timeout);
+#endif
+}  /* pt_SendFile */
+
+#ifdef _PR_HAVE_SPLICE
+/*
+ * A splice() from the socket moves no more than the pipe holds, so the
+ * pipe is grown (where the kernel allows it) to take this much at once.
+ */
+#define PT_SPLICE_CHUNK (1024 * 1024)
+
+/*
+ * pt_LinuxRecvFile
+ *
+ *	Receive 'amount' bytes from socket sd into file fd by splicing
+ *	them through a pipe, so that they are never copied through user
+ *	space.
+ *
+ *	return number of bytes written, short only at end of stream (or
+ *	when a non-blocking socket runs dry), or -1 on error
+ */
+static PRInt32 pt_LinuxRecvFile(
+    PRFileDesc *sd, PRFileDesc *fd, PRInt32 amount, PRIntervalTime timeout)
+{
+    int pipefd[2];
+    PRInt32 count = 0;
+    ssize_t moved, drained, rv;
+    int syserrno;
+
+    /* splice() won't write to a file opened for appending */
+    if ((PR_DESC_FILE != fd->methods->file_type)
+    || (fcntl(fd->secret->md.osfd, F_GETFL) & O_APPEND)
+    || (-1 == pipe(pipefd)))
+        return _PR_EmulateRecvFile(sd, fd, amount, timeout);
+#ifdef F_SETPIPE_SZ
+    (void)fcntl(pipefd[1], F_SETPIPE_SZ, PT_SPLICE_CHUNK);
+#endif
+
+    while (count < amount)
+    {
+        moved = splice(
+            sd->secret->md.osfd, NULL, pipefd[1], NULL,
+            PR_MIN(amount - count, PT_SPLICE_CHUNK),
+            SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        syserrno = errno;
+        if ((-1 == moved) && (EWOULDBLOCK == syserrno || EAGAIN == syserrno))
+        {
+            if (sd->secret->nonblocking)
+            {
+                if (0 != count) break;  /* return what we have */
+            }
+            else if (PR_INTERVAL_NO_WAIT == timeout) syserrno = ETIMEDOUT;
+            else
+            {
+                pt_Continuation op;
+                op.arg1.osfd = sd->secret->md.osfd;
+                op.arg3.amount = PR_MIN(amount - count, PT_SPLICE_CHUNK);
+                op.filedesc = pipefd[1];
+                op.timeout = timeout;
+                op.function = pt_splice_cont;
+                op.event = POLLIN | POLLPRI;
+                moved = pt_Continue(&op);
+                syserrno = op.syserrno;
+            }
+        }
+        if (-1 == moved)
+        {
+            pt_MapError(_PR_MD_MAP_RECV_ERROR, syserrno);
+            count = -1;
+            break;
+        }
+        if (0 == moved) break;  /* end of stream */
+
+        for (drained = 0; drained < moved; drained += rv)
+        {
+            rv = splice(
+                pipefd[0], NULL, fd->secret->md.osfd, NULL,
+                moved - drained, SPLICE_F_MOVE);
+            if (-1 == rv)
+            {
+                if (EINTR == errno) rv = 0;
+                else break;
+            }
+        }
+        if (drained < moved)
+        {
+            _PR_MD_MAP_WRITE_ERROR(errno);
+            count = -1;
+            break;
+        }
+        count += moved;
+    }
+
+    (void)close(pipefd[0]);
+    (void)close(pipefd[1]);
+    return count;
+}  /* pt_LinuxRecvFile */
+#endif  /* _PR_HAVE_SPLICE */
+
+static PRInt32 pt_RecvFile(
+    PRFileDesc *sd, PRFileDesc *fd, PRInt32 amount, PRIntervalTime timeout)
+{
+    if (pt_TestAbort()) return -1;
+
+#ifdef _PR_HAVE_SPLICE
+    return pt_LinuxRecvFile(sd, fd, amount, timeout);
+#else
+    return _PR_EmulateRecvFile(sd, fd, amount, timeout);
+#endif
+}  /* pt_RecvFile */
+
 /*
  * XXX: When IPv6 is running, we need to see if this code works
  * with a PRNetAddr structure that supports both IPv4 and IPv6.
@@ -2312,6 +3001,10 @@ static PRIOMethods _pr_file_methods = {
     (PRGetpeernameFN)_PR_InvalidStatus,	
     (PRGetsockoptFN)_PR_InvalidStatus,	
     (PRSetsockoptFN)_PR_InvalidStatus,	
+    (PRGetsocketoptionFN)_PR_InvalidStatus,
+    (PRSetsocketoptionFN)_PR_InvalidStatus,
+    (PRSendfileFN)_PR_InvalidInt,
+    (PRRecvfileFN)_PR_InvalidInt
 };
 
 static PRIOMethods _pr_tcp_methods = {
@@ -2344,7 +3037,9 @@ static PRIOMethods _pr_tcp_methods = {
     pt_GetSockOpt,
     pt_SetSockOpt,
     pt_GetSocketOption,
-    pt_SetSocketOption
+    pt_SetSocketOption,
+    pt_SendFile,
+    pt_RecvFile
 };
 
 static PRIOMethods _pr_udp_methods = {
@@ -2377,7 +3072,9 @@ static PRIOMethods _pr_udp_methods = {
     pt_GetSockOpt,
     pt_SetSockOpt,
     pt_GetSocketOption,
-    pt_SetSocketOption
+    pt_SetSocketOption,
+	(PRSendfileFN)_PR_InvalidInt,
+	(PRRecvfileFN)_PR_InvalidInt
 };
 
 #if defined(_PR_FCNTL_FLAGS)
@@ -19,11 +19,119 @@
 #include "prio.h"
 #include "prprf.h"
 #include "pratom.h"
+#include "prlock.h"
+#include "prmem.h"
+#include "prthread.h"
+#include "prinrval.h"
+
+#include "plgetopt.h"
+
+#include <stdlib.h>
+
+/*
+** After the single threaded tests, each of the operations below is
+** timed with 'threads' threads all hammering one counter, 'iterations'
+** times each. The counter has to come out right for the test to pass.
+*/
+static PRInt32 counter;
+static PRLock *ml = NULL;
+static PRIntn threads = 4, iterations = 1000000;
+
+static void PR_CALLBACK Locked(void *arg)
+{
+    PRIntn index;
+    for (index = 0; index < iterations; ++index)
+    {
+        PR_Lock(ml);
+        counter += 1;
+        PR_Unlock(ml);
+    }
+}  /* Locked */
+
+static void PR_CALLBACK Increment(void *arg)
+{
+    PRIntn index;
+    for (index = 0; index < iterations; ++index)
+        (void)PR_AtomicIncrement(&counter);
+}  /* Increment */
+
+static void PR_CALLBACK Add(void *arg)
+{
+    PRIntn index;
+    for (index = 0; index < iterations; ++index)
+        (void)PR_AtomicAdd(&counter, 1);
+}  /* Add */
+
+static void PR_CALLBACK CompareAndSwap(void *arg)
+{
+    PRIntn index;
+    PRInt32 old;
+    for (index = 0; index < iterations; ++index)
+    {
+        do
+        {
+            old = counter;
+        } while (!PR_AtomicCompareAndSwap(&counter, old, old + 1));
+    }
+}  /* CompareAndSwap */
+
+static PRInt32 Contend(
+    PRFileDesc *output, const char *name, void (PR_CALLBACK *func)(void*))
+{
+    PRIntn index;
+    PRUint32 msecs;
+    PRIntervalTime elapsed;
+    PRThread **thread;
+    PRInt32 result, expected = threads * iterations;
+
+    thread = (PRThread**)PR_Malloc(threads * sizeof(PRThread*));
+    counter = 0;
+    elapsed = PR_IntervalNow();
+    for (index = 0; index < threads; ++index)
+    {
+        thread[index] = PR_CreateThread(
+            PR_USER_THREAD, func, NULL, PR_PRIORITY_NORMAL,
+            PR_GLOBAL_THREAD, PR_JOINABLE_THREAD, 0);
+    }
+    for (index = 0; index < threads; ++index)
+        (void)PR_JoinThread(thread[index]);
+    elapsed = PR_IntervalNow() - elapsed;
+    PR_Free(thread);
+
+    msecs = PR_IntervalToMilliseconds(elapsed);
+    result = (counter == expected) ? 0 : 1;
+    PR_fprintf(
+        output, "%-24s %d threads: %6u msecs %7.1f nsecs/op: %s\n",
+        name, threads, msecs, (double)msecs * 1000000.0 / expected,
+        (result == 0) ? "PASSED" : "FAILED");
+    return result;
+}  /* Contend */
 
 PRIntn main(PRIntn argc, char **argv)
 {
+    PLOptStatus os;
+    void *ptr, *ptrrv;
+    PRBool swapped;
     PRInt32 rv, test, result = 0;
     PRFileDesc *output = PR_GetSpecialFD(PR_StandardOutput);
+    PLOptState *opt = PL_CreateOptState(argc, argv, "t:i:");
+
+    while (PL_OPT_EOL != (os = PL_GetNextOpt(opt)))
+    {
+        if (PL_OPT_BAD == os) continue;
+        switch (opt->option)
+        {
+        case 't':  /* number of contending threads */
+            threads = atoi(opt->value);
+            break;
+        case 'i':  /* iterations per thread */
+            iterations = atoi(opt->value);
+            break;
+        default:
+            break;
+        }
+    }
+    PL_DestroyOptState(opt);
 
     test = -2;
     rv = PR_AtomicIncrement(&test);
@@ -66,6 +174,49 @@ PRIntn main(PRIntn argc, char **argv)
         output, "PR_AtomicSet(%d) == %d: %s\n",
         test, rv, ((rv == -2) && (test == 2)) ? "PASSED" : "FAILED");
 
+    test = 2;
+    rv = PR_AtomicAdd(&test, -5);
+    result = result | (((rv == -3) && (test == -3)) ? 0 : 1);
+    PR_fprintf(
+        output, "PR_AtomicAdd(%d) == %d: %s\n",
+        test, rv, ((rv == -3) && (test == -3)) ? "PASSED" : "FAILED");
+
+    test = 2;
+    swapped = PR_AtomicCompareAndSwap(&test, 2, 7);
+    result = result | ((swapped && (test == 7)) ? 0 : 1);
+    PR_fprintf(
+        output, "PR_AtomicCompareAndSwap(%d) == %d: %s\n",
+        test, swapped, (swapped && (test == 7)) ? "PASSED" : "FAILED");
+    swapped = PR_AtomicCompareAndSwap(&test, 2, 9);
+    result = result | ((!swapped && (test == 7)) ? 0 : 1);
+    PR_fprintf(
+        output, "PR_AtomicCompareAndSwap(%d) == %d: %s\n",
+        test, swapped, (!swapped && (test == 7)) ? "PASSED" : "FAILED");
+
+    ptr = &test;
+    ptrrv = PR_AtomicSetPtr(&ptr, &rv);
+    result = result | (((ptrrv == &test) && (ptr == &rv)) ? 0 : 1);
+    PR_fprintf(
+        output, "PR_AtomicSetPtr(0x%p) == 0x%p: %s\n", ptr, ptrrv,
+        ((ptrrv == &test) && (ptr == &rv)) ? "PASSED" : "FAILED");
+    swapped = PR_AtomicCompareAndSwapPtr(&ptr, &rv, NULL);
+    result = result | ((swapped && (ptr == NULL)) ? 0 : 1);
+    PR_fprintf(
+        output, "PR_AtomicCompareAndSwapPtr(0x%p) == %d: %s\n", ptr,
+        swapped, (swapped && (ptr == NULL)) ? "PASSED" : "FAILED");
+    swapped = PR_AtomicCompareAndSwapPtr(&ptr, &rv, &test);
+    result = result | ((!swapped && (ptr == NULL)) ? 0 : 1);
+    PR_fprintf(
+        output, "PR_AtomicCompareAndSwapPtr(0x%p) == %d: %s\n", ptr,
+        swapped, (!swapped && (ptr == NULL)) ? "PASSED" : "FAILED");
+
+    ml = PR_NewLock();
+    result |= Contend(output, "PR_Lock/PR_Unlock", Locked);
+    result |= Contend(output, "PR_AtomicIncrement", Increment);
+    result |= Contend(output, "PR_AtomicAdd", Add);
+    result |= Contend(output, "PR_AtomicCompareAndSwap", CompareAndSwap);
+    PR_DestroyLock(ml);
+
     PR_fprintf(
         output, "Atomic operations test %s\n",
         (result == 0) ? "PASSED" : "FAILED");
@@ -51,6 +51,8 @@ static enum Verbosity verbosity = quiet;
 static PRInt32 ops_required = 1000, ops_done = 0;
 static PRThreadScope thread_scope = PR_LOCAL_THREAD;
 static PRIntn client_threads = 20, worker_threads = 2, wait_objects = 50;
+static PRIntn throughput_objects = 10000, throughput_window = 64;
+static PRBool draining = PR_FALSE;
 
 #if defined(DEBUG)
 #define MW_ASSERT(_expr) \
@@ -579,6 +581,136 @@ static void RealOneGroupIO(Shared *shared)
     MW_ASSERT(PR_SUCCESS == rv);
 }  /* RealOneGroupIO */
 
+static void PR_CALLBACK DrainThread(void *arg)
+{
+    PRStatus rv;
+    PRRecvWait *desc_out;
+    Shared *shared = (Shared*)arg;
+    do  /* until interrupted */
+    {
+        desc_out = PR_WaitRecvReady(shared->group);
+        if (NULL == desc_out)
+        {
+            MW_ASSERT(PR_PENDING_INTERRUPT_ERROR == PR_GetError());
+            break;
+        }
+        MW_ASSERT(PR_MW_SUCCESS == desc_out->outcome);
+        MW_ASSERT(desc_out->bytesRecv > 0);
+
+        PR_Lock(shared->list_lock);
+        if (draining) DestroyRecvWait(shared, desc_out);
+        else
+        {
+            ops_done += desc_out->bytesRecv;
+            rv = PR_AddWaitFileDesc(shared->group, desc_out);
+            MW_ASSERT(PR_SUCCESS == rv);
+        }
+        PR_Unlock(shared->list_lock);
+    } while (PR_TRUE);
+}  /* DrainThread */
+
+static void Throughput(Shared *shared)
+{
+    /*
+    ** Put a large number of connections in one group, all idle but for
+    ** a trickle of single byte messages spread across them, and time
+    ** how quickly worker_threads threads can take them out again.
+    */
+    PRStatus rv;
+    PRInt32 bytes, sent;
+    PRIntn descs, index;
+    PRThread **thread;
+    PRRecvWait *desc_in;
+    PRFileDesc **writer, *pair[2];
+    PRIntervalTime elapsed;
+    PRUint32 msecs;
+    char byte = 'x';
+
+    writer = (PRFileDesc**)PR_CALLOC(sizeof(PRFileDesc*) * throughput_objects);
+
+    if (verbosity > quiet)
+        PR_fprintf(
+            debug, "%s: adding %d descs\n", shared->title, throughput_objects);
+    for (descs = 0; descs < throughput_objects; ++descs)
+    {
+        if (PR_FAILURE == PR_NewTCPSocketPair(pair)) break;
+        writer[descs] = pair[0];
+        desc_in = CreateRecvWait(pair[1], PR_INTERVAL_NO_TIMEOUT);
+        rv = PR_AddWaitFileDesc(shared->group, desc_in);
+        MW_ASSERT(PR_SUCCESS == rv);
+    }
+    MW_ASSERT(descs > 0);
+    if ((descs < throughput_objects) && (verbosity > silent))
+        PR_fprintf(
+            debug, "%s: ran out of descriptors after %d\n",
+            shared->title, descs);
+
+    thread = (PRThread**)PR_CALLOC(sizeof(PRThread*) * worker_threads);
+    for (index = 0; index < worker_threads; ++index)
+    {
+        thread[index] = PR_CreateThread(
+            PR_USER_THREAD, DrainThread, shared,
+            PR_PRIORITY_HIGH, thread_scope,
+            PR_JOINABLE_THREAD, 16 * 1024);
+    }
+
+    /* don't get more than throughput_window messages ahead */
+    elapsed = PR_IntervalNow();
+    for (sent = 0; sent < ops_required; ++sent)
+    {
+        while (sent - ops_done >= throughput_window)
+            PR_Sleep(PR_INTERVAL_NO_WAIT);
+        bytes = PR_Send(
+            writer[sent % descs], &byte, 1, 0, PR_INTERVAL_NO_TIMEOUT);
+        MW_ASSERT(1 == bytes);
+    }
+    while (ops_done < ops_required) PR_Sleep(PR_INTERVAL_NO_WAIT);
+    elapsed = PR_IntervalNow() - elapsed;
+
+    /*
+    ** A thread polling the group isn't necessarily interruptible, so
+    ** rather than interrupt the threads out of a full group, send one
+    ** more message to every desc and have the threads destroy them.
+    */
+    PR_Lock(shared->list_lock);
+    draining = PR_TRUE;
+    PR_Unlock(shared->list_lock);
+    for (index = 0; index < descs; ++index)
+    {
+        bytes = PR_Send(writer[index], &byte, 1, 0, PR_INTERVAL_NO_TIMEOUT);
+        MW_ASSERT(1 == bytes);
+    }
+    while (desc_allocated > 0) PR_Sleep(PR_INTERVAL_NO_WAIT);
+
+    msecs = PR_IntervalToMilliseconds(elapsed);
+    if (verbosity > silent)
+        PR_fprintf(
+            debug, "%s: %d descs, %d messages in %u msecs (%u/sec)\n",
+            shared->title, descs, ops_done, msecs,
+            (0 == msecs) ? 0 : (PRUint32)ops_done * 1000 / msecs);
+
+    if (verbosity > quiet)
+        PR_fprintf(debug, "%s: interrupting/joining threads\n", shared->title);
+    for (index = 0; index < worker_threads; ++index)
+    {
+        rv = PR_Interrupt(thread[index]);
+        MW_ASSERT(PR_SUCCESS == rv);
+        rv = PR_JoinThread(thread[index]);
+        MW_ASSERT(PR_SUCCESS == rv);
+    }
+    PR_DELETE(thread);
+    draining = PR_FALSE;
+
+    CancelGroup(shared);
+
+    for (index = 0; index < descs; ++index)
+    {
+        rv = PR_Close(writer[index]);
+        MW_ASSERT(PR_SUCCESS == rv);
+    }
+    PR_DELETE(writer);
+}  /* Throughput */
+
 static void RunThisOne(
     void (*func)(Shared*), const char *name, const char *test_name)
 {
@@ -605,7 +737,7 @@ PRIntn main(PRIntn argc, char **argv)
 {
     PLOptStatus os;
     const char *test_name = NULL;
-    PLOptState *opt = PL_CreateOptState(argc, argv, "dqGc:o:p:t:w:");
+    PLOptState *opt = PL_CreateOptState(argc, argv, "dqGc:n:o:p:t:w:");
 
     while (PL_OPT_EOL != (os = PL_GetNextOpt(opt)))
     {
@@ -629,6 +761,9 @@ PRIntn main(PRIntn argc, char **argv)
         case 'c':  /* number of client threads */
             client_threads = atoi(opt->value);
             break;
+        case 'n':  /* number of descs for Throughput */
+            throughput_objects = atoi(opt->value);
+            break;
         case 'o':  /* operations to compelete */
             ops_required = atoi(opt->value);
             break;
@@ -655,6 +790,7 @@ PRIntn main(PRIntn argc, char **argv)
     RunThisOne(ManyOpOneThread, "ManyOpOneThread", test_name);
     RunThisOne(SomeOpsSomeThreads, "SomeOpsSomeThreads", test_name);
     RunThisOne(RealOneGroupIO, "RealOneGroupIO", test_name);
+    RunThisOne(Throughput, "Throughput", test_name);
     return 0;
 }  /* main */
 
@@ -0,0 +1,381 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+** File:        sendfile.c
+** Description: Checks PR_TransmitFile, PR_SendFile and PR_RecvFile
+**              over a loopback connection, and compares the rate and
+**              CPU cost of each with copying the same data through a
+**              user buffer with PR_Read/PR_Send and PR_Recv/PR_Write.
+*/
+
+#include "nspr.h"
+
+#include "plgetopt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef XP_UNIX
+#include <sys/time.h>
+#include <sys/resource.h>
+#endif
+
+#define FILE_NAME "sendfile.tst"
+#define COPY_BUFSIZE (16 * 1024)
+
+static const char header[] = "HTTP/1.0 200 OK\r\nServer: sendfile\r\n\r\n";
+static const char trailer[] = "\r\n--end--\r\n";
+
+typedef enum Method
+{
+    by_copy, by_transmitfile, by_sendfile, by_recvfile
+} Method;
+
+static const char *method_name[] = {
+    "copy", "PR_TransmitFile", "PR_SendFile", "PR_RecvFile"};
+
+static PRBool debug_mode = PR_FALSE;
+static PRInt32 file_size = 4096 * 1024;
+static PRIntn rounds = 16;
+static PRFileDesc *listener = NULL;
+static char *content = NULL;
+
+typedef struct Peer
+{
+    Method method;
+    PRInt32 hlen, tlen;         /* framing of each round */
+    PRBool failed;
+} Peer;
+
+/* the byte at 'offset' in a round of 'hlen' header, the file and trailer */
+static char Expected(PRInt32 offset, PRInt32 hlen)
+{
+    if (offset < hlen) return header[offset];
+    offset -= hlen;
+    if (offset < file_size) return content[offset];
+    return trailer[offset - file_size];
+}  /* Expected */
+
+static PRUint32 CpuMsecs(void)
+{
+#ifdef XP_UNIX
+    struct rusage ru;
+    (void)getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000
+        + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+#else
+    return 0;  /* not measured */
+#endif
+}  /* CpuMsecs */
+
+/*
+** Accepts one connection and reads it to the end. The first round is
+** checked byte for byte; after that only the total is.
+*/
+static void PR_CALLBACK Sink(void *arg)
+{
+    Peer *peer = (Peer*)arg;
+    PRInt32 bytes, index, total = 0;
+    PRInt32 round_length = peer->hlen + file_size + peer->tlen;
+    PRFileDesc *sock;
+    char *buf = (char*)PR_Malloc(COPY_BUFSIZE);
+
+    sock = PR_Accept(listener, NULL, PR_INTERVAL_NO_TIMEOUT);
+    if (NULL == sock)
+    {
+        peer->failed = PR_TRUE;
+        PR_Free(buf);
+        return;
+    }
+    while ((bytes = PR_Recv(
+        sock, buf, COPY_BUFSIZE, 0, PR_INTERVAL_NO_TIMEOUT)) > 0)
+    {
+        for (index = 0; (index < bytes) && (total < round_length); ++index)
+        {
+            if (buf[index] != Expected(total, peer->hlen))
+                peer->failed = PR_TRUE;
+            total += 1;
+        }
+        total += bytes - index;
+    }
+    if ((bytes < 0) || (total != round_length * rounds))
+    {
+        if (debug_mode) PR_fprintf(
+            PR_STDERR, "Sink received %d of %d bytes\n",
+            total, round_length * rounds);
+        peer->failed = PR_TRUE;
+    }
+    PR_Close(sock);
+    PR_Free(buf);
+}  /* Sink */
+
+/*
+** Connects and sends 'rounds' copies of the content from memory, for
+** PR_RecvFile and its copying equivalent to receive.
+*/
+static void PR_CALLBACK Source(void *arg)
+{
+    Peer *peer = (Peer*)arg;
+    PRNetAddr addr;
+    PRIntn round;
+    PRFileDesc *sock = PR_NewTCPSocket();
+
+    (void)PR_GetSockName(listener, &addr);
+    if (PR_FAILURE == PR_Connect(sock, &addr, PR_INTERVAL_NO_TIMEOUT))
+        peer->failed = PR_TRUE;
+    else for (round = 0; round < rounds; ++round)
+    {
+        if (PR_Send(sock, content, file_size, 0, PR_INTERVAL_NO_TIMEOUT)
+            != file_size)
+        {
+            peer->failed = PR_TRUE;
+            break;
+        }
+    }
+    PR_Close(sock);
+}  /* Source */
+
+static PRBool SendFileCopying(
+    PRFileDesc *sock, PRFileDesc *file, const Peer *peer)
+{
+    char buf[COPY_BUFSIZE];
+    PRInt32 bytes;
+
+    if (PR_Send(sock, header, peer->hlen, 0, PR_INTERVAL_NO_TIMEOUT)
+        != peer->hlen) return PR_FALSE;
+    if (PR_Seek(file, 0, PR_SEEK_SET) != 0) return PR_FALSE;
+    while ((bytes = PR_Read(file, buf, sizeof(buf))) > 0)
+    {
+        if (PR_Send(sock, buf, bytes, 0, PR_INTERVAL_NO_TIMEOUT) != bytes)
+            return PR_FALSE;
+    }
+    if (bytes < 0) return PR_FALSE;
+    return (PR_Send(sock, trailer, peer->tlen, 0, PR_INTERVAL_NO_TIMEOUT)
+        == peer->tlen) ? PR_TRUE : PR_FALSE;
+}  /* SendFileCopying */
+
+static PRBool RecvFileCopying(PRFileDesc *sock, PRFileDesc *file)
+{
+    char buf[COPY_BUFSIZE];
+    PRInt32 bytes, total = 0;
+
+    while (total < file_size)
+    {
+        bytes = PR_Recv(
+            sock, buf, PR_MIN(sizeof(buf), file_size - total), 0,
+            PR_INTERVAL_NO_TIMEOUT);
+        if (bytes <= 0) return PR_FALSE;
+        if (PR_Write(file, buf, bytes) != bytes) return PR_FALSE;
+        total += bytes;
+    }
+    return PR_TRUE;
+}  /* RecvFileCopying */
+
+/* the file must hold 'rounds' copies of the content */
+static PRBool CheckReceived(void)
+{
+    PRInt32 bytes, total = 0;
+    char *buf = (char*)PR_Malloc(COPY_BUFSIZE);
+    PRFileDesc *file = PR_Open(FILE_NAME ".in", PR_RDONLY, 0);
+
+    if (NULL == file) return PR_FALSE;
+    while ((bytes = PR_Read(file, buf, COPY_BUFSIZE)) > 0)
+    {
+        if (memcmp(buf, content + (total % file_size), bytes) != 0) break;
+        total += bytes;
+    }
+    PR_Close(file);
+    PR_Free(buf);
+    return (total == file_size * rounds) ? PR_TRUE : PR_FALSE;
+}  /* CheckReceived */
+
+static PRBool Run(PRFileDesc *file, Method method, PRBool receiving)
+{
+    Peer peer;
+    PRNetAddr addr;
+    PRThread *thread;
+    PRIntn round;
+    PRBool ok = PR_TRUE;
+    PRFileDesc *sock, *out = NULL;
+    PRUint32 msecs, cpu;
+    PRIntervalTime elapsed;
+    PRSendFileData sfd;
+
+    /* truncating what the last run received isn't part of this one */
+    if (receiving) out = PR_Open(
+        FILE_NAME ".in", PR_WRONLY | PR_CREATE_FILE | PR_TRUNCATE, 0666);
+    cpu = CpuMsecs();
+    elapsed = PR_IntervalNow();
+
+    peer.method = method;
+    peer.hlen = strlen(header);
+    peer.tlen = (by_transmitfile == method) ? 0 : strlen(trailer);
+    peer.failed = PR_FALSE;
+    thread = PR_CreateThread(
+        PR_USER_THREAD, receiving ? Source : Sink, &peer,
+        PR_PRIORITY_NORMAL, PR_GLOBAL_THREAD, PR_JOINABLE_THREAD, 0);
+
+    if (receiving)
+    {
+        sock = PR_Accept(listener, NULL, PR_INTERVAL_NO_TIMEOUT);
+        if ((NULL == out) || (NULL == sock)) ok = PR_FALSE;
+        for (round = 0; ok && (round < rounds); ++round)
+        {
+            if (by_recvfile == method)
+                ok = (PR_RecvFile(sock, out, file_size,
+                    PR_INTERVAL_NO_TIMEOUT) == file_size) ? PR_TRUE : PR_FALSE;
+            else ok = RecvFileCopying(sock, out);
+        }
+    }
+    else
+    {
+        sock = PR_NewTCPSocket();
+        (void)PR_GetSockName(listener, &addr);
+        ok = (PR_SUCCESS == PR_Connect(sock, &addr, PR_INTERVAL_NO_TIMEOUT))
+            ? PR_TRUE : PR_FALSE;
+        sfd.fd = file;
+        sfd.file_offset = 0;
+        sfd.file_nbytes = 0;
+        sfd.header = header;
+        sfd.hlen = peer.hlen;
+        sfd.trailer = trailer;
+        sfd.tlen = peer.tlen;
+        for (round = 0; ok && (round < rounds); ++round)
+        {
+            switch (method)
+            {
+            case by_transmitfile:
+                ok = (PR_TransmitFile(sock, file, header, peer.hlen,
+                    PR_TRANSMITFILE_KEEP_OPEN, PR_INTERVAL_NO_TIMEOUT)
+                    == peer.hlen + file_size) ? PR_TRUE : PR_FALSE;
+                break;
+            case by_sendfile:
+                ok = (PR_SendFile(sock, &sfd, PR_TRANSMITFILE_KEEP_OPEN,
+                    PR_INTERVAL_NO_TIMEOUT)
+                    == peer.hlen + file_size + peer.tlen) ? PR_TRUE : PR_FALSE;
+                break;
+            default:
+                ok = SendFileCopying(sock, file, &peer);
+                break;
+            }
+        }
+    }
+    if (!ok && debug_mode)
+        PR_fprintf(PR_STDERR, "%s failed: %d\n", method_name[method],
+            PR_GetError());
+
+    if (NULL != sock) PR_Close(sock);
+    (void)PR_JoinThread(thread);
+    elapsed = PR_IntervalNow() - elapsed;
+    cpu = CpuMsecs() - cpu;
+    if (NULL != out) PR_Close(out);
+    if (peer.failed) ok = PR_FALSE;
+    if (ok && receiving) ok = CheckReceived();
+
+    msecs = PR_IntervalToMilliseconds(elapsed);
+    if (0 == msecs) msecs = 1;
+    PR_fprintf(
+        PR_STDOUT, "%-8s %-16s %5u msecs %8.1f MB/s %5u msecs cpu: %s\n",
+        receiving ? "receive" : "send", method_name[method], msecs,
+        ((double)file_size * rounds / (1024 * 1024)) * 1000.0 / msecs,
+        cpu, ok ? "PASSED" : "FAILED");
+    return ok;
+}  /* Run */
+
+static PRIntn PR_CALLBACK RealMain(PRIntn argc, char **argv)
+{
+    PRInt32 index;
+    PRNetAddr addr;
+    PRBool passed = PR_TRUE;
+    PRFileDesc *file;
+    PLOptStatus os;
+    PLOptState *opt = PL_CreateOptState(argc, argv, "ds:r:");
+
+    /*
+     * USAGE
+     * -d       debug mode
+     * -s       size of the file in KB                  (default = 4096)
+     * -r       times to send it over one connection    (default = 16)
+     */
+    while (PL_OPT_EOL != (os = PL_GetNextOpt(opt)))
+    {
+        if (PL_OPT_BAD == os) continue;
+        switch (opt->option)
+        {
+        case 'd':  /* debug mode */
+            debug_mode = PR_TRUE;
+            break;
+        case 's':  /* file size in KB */
+            file_size = atoi(opt->value) * 1024;
+            break;
+        case 'r':  /* rounds per connection */
+            rounds = atoi(opt->value);
+            break;
+        default:
+            break;
+        }
+    }
+    PL_DestroyOptState(opt);
+
+    content = (char*)PR_Malloc(file_size);
+    for (index = 0; index < file_size; ++index)
+        content[index] = (char)(index % 251);
+    file = PR_Open(
+        FILE_NAME, PR_RDWR | PR_CREATE_FILE | PR_TRUNCATE, 0666);
+    if ((NULL == file)
+    || (PR_Write(file, content, file_size) != file_size))
+    {
+        PR_fprintf(PR_STDERR, "Can't create %s\n", FILE_NAME);
+        return 1;
+    }
+
+    listener = PR_NewTCPSocket();
+    (void)PR_InitializeNetAddr(PR_IpAddrLoopback, 0, &addr);
+    if ((PR_FAILURE == PR_Bind(listener, &addr))
+    || (PR_FAILURE == PR_Listen(listener, 2)))
+    {
+        PR_fprintf(PR_STDERR, "Can't listen on the loopback address\n");
+        return 1;
+    }
+
+    PR_fprintf(
+        PR_STDOUT, "%d KB x %d rounds\n", file_size / 1024, rounds);
+    passed &= Run(file, by_copy, PR_FALSE);
+    passed &= Run(file, by_transmitfile, PR_FALSE);
+    passed &= Run(file, by_sendfile, PR_FALSE);
+    passed &= Run(file, by_copy, PR_TRUE);
+    passed &= Run(file, by_recvfile, PR_TRUE);
+
+    PR_Close(listener);
+    PR_Close(file);
+    (void)PR_Delete(FILE_NAME);
+    (void)PR_Delete(FILE_NAME ".in");
+    PR_Free(content);
+
+    PR_fprintf(PR_STDOUT, "%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}  /* RealMain */
+
+PRIntn main(PRIntn argc, char **argv)
+{
+    PRIntn rv;
+    PR_STDIO_INIT();
+    rv = PR_Initialize(RealMain, argc, argv, 0);
+    return rv;
+}  /* main */
@@ -24,6 +24,13 @@
 ** Note:        Requires a server machine and an aribitrary number of
 **              clients to bang on it. Trust the numbers on the server
 **              more than those being displayed by the various clients.
+**
+**              With -i <n>, this machine is both client and server. It
+**              holds n idle connections, each with a thread blocked
+**              receiving on it, and reports the CPU time spent while
+**              they idle, the round trip time over one more connection,
+**              and how long an interrupted receive takes to return.
+**              The process needs 2n + 10 or so file descriptors.
 */
 
 #include "prerror.h"
@@ -31,20 +38,27 @@
 #include "prinit.h"
 #include "prio.h"
 #include "prlock.h"
+#include "prlong.h"
 #include "prmem.h"
 #include "prnetdb.h"
 #include "prprf.h"
 #include "prthread.h"
+#include "prtime.h"
 
 #include "pprio.h"
 
 #include "plerror.h"
 #include "plgetopt.h"
 
+#include <stdlib.h>
+#include <time.h>  /* clock(), for the CPU time of the idle test */
+
 #define ADDR_BUFFER 100
 #define PORT_NUMBER 51877
 #define SAMPLING_INTERVAL 10
 #define BUFFER_SIZE (32 * 1024)
+#define IDLE_SECONDS 5
+#define ROUND_TRIPS 1000
 
 static PRInt32 domain = AF_INET;
 static PRInt32 protocol = 6;  /* TCP */
@@ -54,6 +68,7 @@ static PRInt32 xport_buffer = -1;
 static PRInt32 initial_streams = 1;
 static PRInt32 buffer_size = BUFFER_SIZE;
 static PRThreadScope thread_scope = PR_LOCAL_THREAD;
+static PRIntn idle_connections = 0;
 
 typedef struct Shared
 {
@@ -285,6 +300,176 @@ static void Server(void)
     }
 }  /* Server */
 
+static void PR_CALLBACK Idler(void *arg)
+{
+    char byte;
+    PRFileDesc *xport = (PRFileDesc*)arg;
+
+    /* until the client closes the connection, or we're interrupted */
+    (void)PR_Recv(xport, &byte, 1, 0, PR_INTERVAL_NO_TIMEOUT);
+}  /* Idler */
+
+static void PR_CALLBACK Echo(void *arg)
+{
+    char byte;
+    PRFileDesc *xport = (PRFileDesc*)arg;
+
+    while (1 == PR_Recv(xport, &byte, 1, 0, PR_INTERVAL_NO_TIMEOUT))
+    {
+        if (1 != PR_Send(xport, &byte, 1, 0, PR_INTERVAL_NO_TIMEOUT))
+            break;
+    }
+}  /* Echo */
+
+static PRUint32 CPUMilliseconds(clock_t since)
+{
+    return (PRUint32)((clock() - since) * 1000.0 / CLOCKS_PER_SEC);
+}  /* CPUMilliseconds */
+
+/* Intervals may be too coarse for a round trip, so use PR_Now() */
+static PRUint32 Microseconds(PRTime since)
+{
+    PRUint32 us;
+    PRTime elapsed, now = PR_Now();
+    LL_SUB(elapsed, now, since);
+    LL_L2UI(us, elapsed);
+    return us;
+}  /* Microseconds */
+
+static void Idle(void)
+{
+    PRStatus rv;
+    PRIntn index, opened = 0;
+    char byte = 'x';
+    clock_t cpu;
+    PRTime start;
+    PRUint32 us, us_max = 0, us_total = 0;
+    PRIntervalTime timein;
+    PRNetAddr server_address;
+    PRFileDesc *listener, **clients, **servers;
+    PRThread **threads;
+    PRIntn connections = idle_connections + 1;  /* the last one echoes */
+
+    clients = (PRFileDesc**)PR_CALLOC(connections * sizeof(PRFileDesc*));
+    servers = (PRFileDesc**)PR_CALLOC(connections * sizeof(PRFileDesc*));
+    threads = (PRThread**)PR_CALLOC(connections * sizeof(PRThread*));
+
+    listener = PR_Socket(domain, SOCK_STREAM, protocol);
+    if (NULL == listener)
+    {
+        PL_FPrintError(err, "PR_Socket");
+        return;
+    }
+    rv = PR_InitializeNetAddr(PR_IpAddrLoopback, 0, &server_address);
+    if (PR_SUCCESS == rv) rv = PR_Bind(listener, &server_address);
+    if (PR_SUCCESS == rv) rv = PR_Listen(listener, 128);
+    if (PR_SUCCESS == rv) rv = PR_GetSockName(listener, &server_address);
+    if (PR_FAILURE == rv)
+    {
+        PL_FPrintError(err, "Setting up the listener");
+        goto done;
+    }
+
+    timein = PR_IntervalNow();
+    for (index = 0; index < connections; ++index)
+    {
+        clients[index] = PR_Socket(domain, SOCK_STREAM, protocol);
+        if (NULL == clients[index])
+        {
+            PL_FPrintError(err, "PR_Socket");
+            goto done;
+        }
+        rv = PR_Connect(
+            clients[index], &server_address, PR_INTERVAL_NO_TIMEOUT);
+        if (PR_FAILURE == rv)
+        {
+            PL_FPrintError(err, "PR_Connect");
+            goto done;
+        }
+        servers[index] = PR_Accept(listener, NULL, PR_INTERVAL_NO_TIMEOUT);
+        if (NULL == servers[index])
+        {
+            PL_FPrintError(err, "PR_Accept");
+            goto done;
+        }
+        threads[index] = PR_CreateThread(
+            PR_USER_THREAD, (index < idle_connections) ? Idler : Echo,
+            servers[index], PR_PRIORITY_NORMAL, thread_scope,
+            PR_JOINABLE_THREAD, 16 * 1024);
+        if (NULL == threads[index])
+        {
+            PL_FPrintError(err, "PR_CreateThread");
+            goto done;
+        }
+        opened += 1;
+    }
+    PR_fprintf(err, "%d idle connections opened in %u msec\n",
+        idle_connections,
+        PR_IntervalToMilliseconds(PR_IntervalNow() - timein));
+
+    /* let them all get settled into their receives */
+    PR_Sleep(PR_SecondsToInterval(1));
+
+    cpu = clock();
+    PR_Sleep(PR_SecondsToInterval(IDLE_SECONDS));
+    PR_fprintf(err, "%u msec CPU while idle for %u seconds\n",
+        CPUMilliseconds(cpu), IDLE_SECONDS);
+
+    cpu = clock();
+    for (index = 0; index < ROUND_TRIPS; ++index)
+    {
+        start = PR_Now();
+        if ((1 != PR_Send(clients[idle_connections], &byte, 1, 0,
+                PR_INTERVAL_NO_TIMEOUT))
+        || (1 != PR_Recv(clients[idle_connections], &byte, 1, 0,
+                PR_INTERVAL_NO_TIMEOUT)))
+        {
+            PL_FPrintError(err, "Round trip");
+            goto done;
+        }
+        us = Microseconds(start);
+        us_total += us;
+        if (us > us_max) us_max = us;
+    }
+    PR_fprintf(err,
+        "%u round trips: average %u usec, worst %u usec, %u msec CPU\n",
+        ROUND_TRIPS, us_total / ROUND_TRIPS,
+        us_max, CPUMilliseconds(cpu));
+
+    if (idle_connections > 0)
+    {
+        start = PR_Now();
+        rv = PR_Interrupt(threads[0]);
+        if (PR_SUCCESS == rv) rv = PR_JoinThread(threads[0]);
+        if (PR_FAILURE == rv) PL_FPrintError(err, "Interrupting");
+        else
+        {
+            threads[0] = NULL;
+            PR_fprintf(err, "Interrupted receive returned in %u usec\n",
+                Microseconds(start));
+        }
+    }
+
+done:
+    /* closing the clients' ends lets the servers' threads finish */
+    for (index = 0; index < connections; ++index)
+    {
+        if (NULL != clients[index]) PR_Close(clients[index]);
+    }
+    for (index = 0; index < opened; ++index)
+    {
+        if (NULL != threads[index]) (void)PR_JoinThread(threads[index]);
+    }
+    for (index = 0; index < connections; ++index)
+    {
+        if (NULL != servers[index]) PR_Close(servers[index]);
+    }
+    PR_Close(listener);
+    PR_DELETE(threads);
+    PR_DELETE(servers);
+    PR_DELETE(clients);
+}  /* Idle */
+
 static void Help(void)
 {
     PR_fprintf(err, "Usage: [-h] [<server>]\n");
@@ -293,6 +478,7 @@ static void Help(void)
     PR_fprintf(err, "\t-b <nK>  Client buffer size              (default: 32k)\n");
     PR_fprintf(err, "\t-B <nK>  Transport recv/send buffer size (default: sys)\n");
     PR_fprintf(err, "\t-G       Use GLOBAL threads              (default: LOCAL)\n");
+    PR_fprintf(err, "\t-i <n>   Time n idle local connections   (default: 0)\n");
     PR_fprintf(err, "\t-X       Use XTP transport               (default: TCP)\n");
 #ifdef _PR_INET6
     PR_fprintf(err, "\t-6       Use IPv6                        (default: IPv4)\n");
@@ -307,7 +493,7 @@ PRIntn main(PRIntn argc, char **argv)
 {
     PLOptStatus os;
     const char *server_name = NULL;
-    PLOptState *opt = PL_CreateOptState(argc, argv, "hGX6C:b:s:B:");
+    PLOptState *opt = PL_CreateOptState(argc, argv, "hGX6C:b:s:B:i:");
 
     err = PR_GetSpecialFD(PR_StandardError);
 
@@ -343,6 +529,9 @@ PRIntn main(PRIntn argc, char **argv)
         case 'B':  /* buffer size */
             xport_buffer = 1024 * atoi(opt->value);
             break;
+        case 'i':  /* idle connections */
+            idle_connections = atoi(opt->value);
+            break;
         case 'h':  /* user wants some guidance */
         default:
             Help();  /* so give him an earful */
@@ -356,6 +545,7 @@ PRIntn main(PRIntn argc, char **argv)
 
     PR_fprintf(err,
         "This machine is %s\n",
+        (0 != idle_connections) ? "the CLIENT and SERVER" :
         (NULL == server_name) ? "the SERVER" : "a CLIENT");
 
     PR_fprintf(err,
@@ -389,7 +579,8 @@ PRIntn main(PRIntn argc, char **argv)
         err, "Transport send & receive buffer size will be %u\n", xport_buffer);
     
 
-    if (NULL == server_name) Server();
+    if (0 != idle_connections) Idle();
+    else if (NULL == server_name) Server();
     else Client(server_name);
 
 }  /* main */
@@ -0,0 +1,444 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+ * The contents of this file are subject to the Netscape Public License
+ * Version 1.0 (the "NPL"); you may not use this file except in
+ * compliance with the NPL.  You may obtain a copy of the NPL at
+ * http://www.mozilla.org/NPL/
+ *
+ * Software distributed under the NPL is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the NPL
+ * for the specific language governing rights and limitations under the
+ * NPL.
+ *
+ * The Initial Developer of this code under the NPL is Netscape
+ * Communications Corporation.  Portions created by Netscape are
+ * Copyright (C) 1998 Netscape Communications Corporation.  All Rights
+ * Reserved.
+ */
+
+/*
+** File:        tpool.c
+** Description: Checks the priorities, cancellation, joins and receive
+**              jobs of a thread pool, then times CPU-bound jobs on pools
+**              of one worker up to one for each processor. The jobs are
+**              queued from outside the pool, and forked and joined by
+**              the jobs themselves.
+*/
+
+#include "nspr.h"
+#include "prtpool.h"
+
+#include "plgetopt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static PRBool debug_mode = PR_FALSE;
+static PRIntn jobs = 1024;
+static PRIntn work = 50000;
+static PRIntn max_threads = 0;
+static PRBool failed = PR_FALSE;
+
+#define CHECK(cond) \
+    if (!(cond)) { \
+        failed = PR_TRUE; \
+        PR_fprintf(PR_STDERR, "line %d: %s failed\n", __LINE__, #cond); \
+    }
+
+/***********************************************************************
+** The CPU-bound work
+***********************************************************************/
+
+static PRUint32 Crunch(PRUint32 seed)
+{
+    PRIntn i;
+    PRUint32 x = seed;
+    for (i = 0; i < work; ++i) x = (x * 1103515245 + 12345) ^ (x >> 16);
+    return x;
+}  /* Crunch */
+
+typedef struct Range
+{
+    PRThreadPool *tp;
+    PRIntn low, high;           /* jobs [low, high) */
+    PRUint32 *results;
+} Range;
+
+static void PR_CALLBACK FlatJob(void *arg)
+{
+    PRUint32 *result = (PRUint32*)arg;
+    *result = Crunch(*result);
+}  /* FlatJob */
+
+/* split the range in two, queue one half, do the other and join */
+static void PR_CALLBACK ForkJob(void *arg)
+{
+    PRJob *job;
+    Range *range = (Range*)arg;
+    Range left, right;
+
+    if (range->high - range->low == 1)
+    {
+        range->results[range->low] = Crunch(range->results[range->low]);
+        return;
+    }
+    left = right = *range;
+    left.high = right.low = range->low + (range->high - range->low) / 2;
+    job = PR_QueueJob(
+        range->tp, ForkJob, &left, PR_JOB_PRIORITY_NORMAL, PR_TRUE);
+    CHECK(NULL != job);
+    ForkJob(&right);
+    if (NULL != job) CHECK(PR_SUCCESS == PR_JoinJob(job));
+}  /* ForkJob */
+
+static PRUint32 Expected(void)
+{
+    PRIntn index;
+    PRUint32 sum = 0;
+    for (index = 0; index < jobs; ++index)
+        sum += Crunch((PRUint32)index);
+    return sum;
+}  /* Expected */
+
+static PRUint32 Sum(PRUint32 *results)
+{
+    PRIntn index;
+    PRUint32 sum = 0;
+    for (index = 0; index < jobs; ++index) sum += results[index];
+    return sum;
+}  /* Sum */
+
+static PRUint32 Measure(PRIntn threads, PRBool fork, PRUint32 *results)
+{
+    PRIntn index;
+    PRIntervalTime elapsed;
+    PRJob **handles = (PRJob**)PR_Calloc(jobs, sizeof(PRJob*));
+    PRThreadPool *tp = PR_CreateThreadPool(threads, 0);
+    Range all;
+
+    CHECK(NULL != tp);
+    if (NULL == tp) return 1;
+    for (index = 0; index < jobs; ++index) results[index] = index;
+
+    elapsed = PR_IntervalNow();
+    if (fork)
+    {
+        all.tp = tp;
+        all.low = 0;
+        all.high = jobs;
+        all.results = results;
+        handles[0] = PR_QueueJob(
+            tp, ForkJob, &all, PR_JOB_PRIORITY_NORMAL, PR_TRUE);
+        CHECK(PR_SUCCESS == PR_JoinJob(handles[0]));
+    }
+    else
+    {
+        for (index = 0; index < jobs; ++index)
+            handles[index] = PR_QueueJob(
+                tp, FlatJob, &results[index], PR_JOB_PRIORITY_NORMAL,
+                PR_TRUE);
+        for (index = 0; index < jobs; ++index)
+            CHECK(PR_SUCCESS == PR_JoinJob(handles[index]));
+    }
+    elapsed = PR_IntervalNow() - elapsed;
+
+    CHECK(PR_SUCCESS == PR_ShutdownThreadPool(tp));
+    CHECK(PR_SUCCESS == PR_DestroyThreadPool(tp));
+    PR_Free(handles);
+    return PR_IntervalToMilliseconds(elapsed) + 1;
+}  /* Measure */
+
+static void Scaling(void)
+{
+    PRIntn threads;
+    PRUint32 expected, msecs, base[2];
+    PRUint32 *results = (PRUint32*)PR_Calloc(jobs, sizeof(PRUint32));
+    PRIntn fork;
+
+    expected = Expected();
+    PR_fprintf(
+        PR_STDOUT, "%d jobs of %d iterations, %d processors\n",
+        jobs, work, PR_GetNumberOfProcessors());
+    for (threads = 1; threads <= max_threads; threads *= 2)
+    {
+        for (fork = 0; fork < 2; ++fork)
+        {
+            msecs = Measure(threads, (PRBool)fork, results);
+            CHECK(Sum(results) == expected);
+            if (1 == threads) base[fork] = msecs;
+            PR_fprintf(
+                PR_STDOUT, "%-5s %3d threads %6u msecs speedup %5.2f\n",
+                fork ? "fork" : "flat", threads, msecs,
+                (double)base[fork] / msecs);
+        }
+        if ((threads < max_threads) && (threads * 2 > max_threads))
+            threads = max_threads / 2;  /* end on max_threads */
+    }
+    PR_Free(results);
+}  /* Scaling */
+
+/***********************************************************************
+** Priorities and cancellation, behind a job holding the one worker
+***********************************************************************/
+
+typedef struct Gate
+{
+    PRLock *ml;
+    PRCondVar *cv;
+    PRBool started, open;
+    PRIntn order[8];
+    PRIntn count;
+} Gate;
+
+static Gate gate;
+
+static void PR_CALLBACK GateJob(void *arg)
+{
+    PR_Lock(gate.ml);
+    gate.started = PR_TRUE;
+    PR_NotifyAllCondVar(gate.cv);
+    while (!gate.open) PR_WaitCondVar(gate.cv, PR_INTERVAL_NO_TIMEOUT);
+    PR_Unlock(gate.ml);
+}  /* GateJob */
+
+static void PR_CALLBACK OrderJob(void *arg)
+{
+    PR_Lock(gate.ml);
+    gate.order[gate.count++] = (PRIntn)(PRWord)arg;
+    PR_Unlock(gate.ml);
+}  /* OrderJob */
+
+static PRJob *CloseGate(PRThreadPool *tp)
+{
+    PRJob *job;
+
+    gate.started = gate.open = PR_FALSE;
+    gate.count = 0;
+    job = PR_QueueJob(tp, GateJob, NULL, PR_JOB_PRIORITY_NORMAL, PR_TRUE);
+    PR_Lock(gate.ml);
+    while (!gate.started) PR_WaitCondVar(gate.cv, PR_INTERVAL_NO_TIMEOUT);
+    PR_Unlock(gate.ml);
+    return job;
+}  /* CloseGate */
+
+static void OpenGate(PRJob *job)
+{
+    PR_Lock(gate.ml);
+    gate.open = PR_TRUE;
+    PR_NotifyAllCondVar(gate.cv);
+    PR_Unlock(gate.ml);
+    CHECK(PR_SUCCESS == PR_JoinJob(job));
+}  /* OpenGate */
+
+static void Priorities(void)
+{
+    PRIntn index;
+    PRJob *blocker, *handles[5];
+    static const PRJobPriority queued[5] = {
+        PR_JOB_PRIORITY_LOW, PR_JOB_PRIORITY_NORMAL, PR_JOB_PRIORITY_HIGH,
+        PR_JOB_PRIORITY_LOW, PR_JOB_PRIORITY_HIGH};
+    static const PRIntn ran[5] = {
+        PR_JOB_PRIORITY_HIGH, PR_JOB_PRIORITY_HIGH, PR_JOB_PRIORITY_NORMAL,
+        PR_JOB_PRIORITY_LOW, PR_JOB_PRIORITY_LOW};
+    PRThreadPool *tp = PR_CreateThreadPool(1, 0);
+
+    blocker = CloseGate(tp);
+    for (index = 0; index < 5; ++index)
+        handles[index] = PR_QueueJob(
+            tp, OrderJob, (void*)(PRWord)queued[index], queued[index],
+            PR_TRUE);
+    OpenGate(blocker);
+    for (index = 0; index < 5; ++index)
+        CHECK(PR_SUCCESS == PR_JoinJob(handles[index]));
+    for (index = 0; index < 5; ++index)
+        CHECK(ran[index] == gate.order[index]);
+
+    CHECK(PR_SUCCESS == PR_ShutdownThreadPool(tp));
+    CHECK(PR_SUCCESS == PR_DestroyThreadPool(tp));
+    if (debug_mode) PR_fprintf(PR_STDOUT, "priorities checked\n");
+}  /* Priorities */
+
+static void Cancellation(void)
+{
+    PRJob *blocker, *cancelled, *ran;
+    PRThreadPool *tp = PR_CreateThreadPool(1, 0);
+
+    blocker = CloseGate(tp);
+    cancelled = PR_QueueJob(
+        tp, OrderJob, (void*)1, PR_JOB_PRIORITY_NORMAL, PR_TRUE);
+    ran = PR_QueueJob(tp, OrderJob, (void*)2, PR_JOB_PRIORITY_LOW, PR_TRUE);
+    CHECK(PR_SUCCESS == PR_CancelJob(cancelled));
+    CHECK(PR_FAILURE == PR_CancelJob(cancelled));
+    CHECK(PR_INVALID_STATE_ERROR == PR_GetError());
+    OpenGate(blocker);
+
+    CHECK(PR_FAILURE == PR_JoinJob(cancelled));
+    CHECK(PR_PENDING_INTERRUPT_ERROR == PR_GetError());
+    while (0 == gate.count) PR_Sleep(PR_MillisecondsToInterval(1));
+    CHECK(PR_FAILURE == PR_CancelJob(ran));
+    CHECK(PR_SUCCESS == PR_JoinJob(ran));
+    CHECK((1 == gate.count) && (2 == gate.order[0]));
+
+    /* a running pool can't be destroyed, nor can one with jobs to join */
+    ran = PR_QueueJob(tp, OrderJob, (void*)3, PR_JOB_PRIORITY_LOW, PR_TRUE);
+    CHECK(PR_FAILURE == PR_DestroyThreadPool(tp));
+    CHECK(PR_SUCCESS == PR_ShutdownThreadPool(tp));
+    CHECK(PR_FAILURE == PR_ShutdownThreadPool(tp));
+    CHECK(NULL == PR_QueueJob(
+        tp, OrderJob, (void*)4, PR_JOB_PRIORITY_LOW, PR_FALSE));
+    CHECK(PR_INVALID_STATE_ERROR == PR_GetError());
+    CHECK(PR_FAILURE == PR_DestroyThreadPool(tp));
+    CHECK(PR_SUCCESS == PR_JoinJob(ran));
+    CHECK((2 == gate.count) && (3 == gate.order[1]));
+    CHECK(PR_SUCCESS == PR_DestroyThreadPool(tp));
+    if (debug_mode) PR_fprintf(PR_STDOUT, "cancellation checked\n");
+}  /* Cancellation */
+
+/***********************************************************************
+** Receive jobs
+***********************************************************************/
+
+typedef struct Receiver
+{
+    PRRecvWait desc;
+    char buffer[64];
+    PRBool ran;
+    PRErrorCode error;
+} Receiver;
+
+static void PR_CALLBACK RecvJob(void *arg)
+{
+    Receiver *receiver = (Receiver*)arg;
+    receiver->ran = PR_TRUE;
+    if (PR_MW_SUCCESS != receiver->desc.outcome)
+        receiver->error = PR_GetError();
+}  /* RecvJob */
+
+static void Arm(Receiver *receiver, PRFileDesc *fd, PRIntervalTime timeout)
+{
+    memset(receiver, 0, sizeof(*receiver));
+    receiver->desc.fd = fd;
+    receiver->desc.timeout = timeout;
+    receiver->desc.buffer.start = receiver->buffer;
+    receiver->desc.buffer.length = sizeof(receiver->buffer);
+}  /* Arm */
+
+static void Receives(void)
+{
+    PRJob *job;
+    PRFileDesc *fds[2];
+    Receiver receiver, late;
+    PRThreadPool *tp = PR_CreateThreadPool(2, 0);
+
+    if (PR_FAILURE == PR_NewTCPSocketPair(fds))
+    {
+        PR_fprintf(PR_STDERR, "Can't make a socket pair\n");
+        failed = PR_TRUE;
+        return;
+    }
+
+    /* data arrives after the job is queued */
+    Arm(&receiver, fds[0], PR_SecondsToInterval(10));
+    job = PR_QueueRecvJob(
+        tp, &receiver.desc, RecvJob, &receiver, PR_JOB_PRIORITY_HIGH,
+        PR_TRUE);
+    CHECK(NULL != job);
+    PR_Sleep(PR_MillisecondsToInterval(20));
+    CHECK(!receiver.ran);
+    CHECK(5 == PR_Send(fds[1], "hello", 5, 0, PR_INTERVAL_NO_TIMEOUT));
+    CHECK(PR_SUCCESS == PR_JoinJob(job));
+    CHECK(receiver.ran && (PR_MW_SUCCESS == receiver.desc.outcome));
+    CHECK((5 == receiver.desc.bytesRecv)
+        && (0 == memcmp(receiver.buffer, "hello", 5)));
+
+    /* a job cancelled while it waits never runs */
+    Arm(&receiver, fds[0], PR_SecondsToInterval(10));
+    job = PR_QueueRecvJob(
+        tp, &receiver.desc, RecvJob, &receiver, PR_JOB_PRIORITY_HIGH,
+        PR_TRUE);
+    CHECK(PR_SUCCESS == PR_CancelJob(job));
+    CHECK(PR_FAILURE == PR_JoinJob(job));
+    CHECK(!receiver.ran);
+
+    /* a timeout runs the job with the reason */
+    Arm(&receiver, fds[0], PR_MillisecondsToInterval(50));
+    job = PR_QueueRecvJob(
+        tp, &receiver.desc, RecvJob, &receiver, PR_JOB_PRIORITY_HIGH,
+        PR_TRUE);
+    CHECK(PR_SUCCESS == PR_JoinJob(job));
+    CHECK(receiver.ran && (PR_MW_TIMEOUT == receiver.desc.outcome));
+    CHECK(PR_IO_TIMEOUT_ERROR == receiver.error);
+
+    /* shutting down runs a job that is still waiting */
+    Arm(&late, fds[0], PR_INTERVAL_NO_TIMEOUT);
+    CHECK(NULL != PR_QueueRecvJob(
+        tp, &late.desc, RecvJob, &late, PR_JOB_PRIORITY_LOW, PR_FALSE));
+    CHECK(PR_SUCCESS == PR_ShutdownThreadPool(tp));
+    CHECK(late.ran && (PR_MW_INTERRUPT == late.desc.outcome));
+    CHECK(PR_PENDING_INTERRUPT_ERROR == late.error);
+    CHECK(PR_SUCCESS == PR_DestroyThreadPool(tp));
+
+    PR_Close(fds[0]);
+    PR_Close(fds[1]);
+    if (debug_mode) PR_fprintf(PR_STDOUT, "receives checked\n");
+}  /* Receives */
+
+static PRIntn PR_CALLBACK RealMain(PRIntn argc, char **argv)
+{
+    PLOptStatus os;
+    PLOptState *opt = PL_CreateOptState(argc, argv, "dj:w:t:");
+
+    /*
+     * USAGE
+     * -d       debug mode
+     * -j       number of jobs                          (default = 1024)
+     * -w       iterations of work in each job          (default = 50000)
+     * -t       most worker threads                 (default = processors)
+     */
+    while (PL_OPT_EOL != (os = PL_GetNextOpt(opt)))
+    {
+        if (PL_OPT_BAD == os) continue;
+        switch (opt->option)
+        {
+        case 'd':  /* debug mode */
+            debug_mode = PR_TRUE;
+            break;
+        case 'j':  /* number of jobs */
+            jobs = atoi(opt->value);
+            break;
+        case 'w':  /* work per job */
+            work = atoi(opt->value);
+            break;
+        case 't':  /* most worker threads */
+            max_threads = atoi(opt->value);
+            break;
+        default:
+            break;
+        }
+    }
+    PL_DestroyOptState(opt);
+    if (jobs < 1) jobs = 1;
+    if (max_threads < 1) max_threads = PR_GetNumberOfProcessors();
+
+    gate.ml = PR_NewLock();
+    gate.cv = PR_NewCondVar(gate.ml);
+
+    Priorities();
+    Cancellation();
+    Receives();
+    Scaling();
+
+    PR_DestroyCondVar(gate.cv);
+    PR_DestroyLock(gate.ml);
+
+    PR_fprintf(PR_STDOUT, "%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}  /* RealMain */
+
+PRIntn main(PRIntn argc, char **argv)
+{
+    PRIntn rv;
+    PR_STDIO_INIT();
+    rv = PR_Initialize(RealMain, argc, argv, 0);
+    return rv;
+}  /* main */